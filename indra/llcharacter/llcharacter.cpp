@@ -197,6 +197,21 @@ void LLCharacter::updateMotions(e_update_t update_type)
 	}
 }
 
+//-----------------------------------------------------------------------------
+// updateMotionsConcurrent()
+//-----------------------------------------------------------------------------
+void LLCharacter::updateMotionsConcurrent(e_update_t update_type)
+{
+	llassert(update_type != HIDDEN_UPDATE);
+
+	if (mMotionController.isPaused() && mPauseRequest->getNumRefs() == 1)
+	{
+		mMotionController.unpauseAllMotions();
+	}
+	bool force_update = (update_type == FORCE_UPDATE);
+	mMotionController.updateMotionsConcurrent(force_update);
+}
+
 
 //-----------------------------------------------------------------------------
 // deactivateAllMotions()
@@ -245,7 +260,7 @@ void LLCharacter::dumpCharacter( LLJoint* joint )
 //-----------------------------------------------------------------------------
 // setAnimationData()
 //-----------------------------------------------------------------------------
-void LLCharacter::setAnimationData(std::string name, void *data)
+void LLCharacter::setAnimationData(const std::string& name, void *data)
 {
 	mAnimationData[name] = data;
 }
@@ -253,7 +268,7 @@ void LLCharacter::setAnimationData(std::string name, void *data)
 //-----------------------------------------------------------------------------
 // getAnimationData()
 //-----------------------------------------------------------------------------
-void* LLCharacter::getAnimationData(std::string name)
+void* LLCharacter::getAnimationData(const std::string& name)
 {
 	return get_if_there(mAnimationData, name, (void*)NULL);
 }
@@ -261,7 +276,7 @@ void* LLCharacter::getAnimationData(std::string name)
 //-----------------------------------------------------------------------------
 // removeAnimationData()
 //-----------------------------------------------------------------------------
-void LLCharacter::removeAnimationData(std::string name)
+void LLCharacter::removeAnimationData(const std::string& name)
 {
 	mAnimationData.erase(name);
 }
@@ -0,0 +1,406 @@
+/** 
+ * @file llflatskeleton.cpp
+ * @brief A flattened, structure-of-arrays view of an LLJoint hierarchy.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ * 
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ * 
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ * 
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+//-----------------------------------------------------------------------------
+// Header Files
+//-----------------------------------------------------------------------------
+#include "linden_common.h"
+
+#include "llflatskeleton.h"
+
+#include "lljoint.h"
+#include "llv4math.h"	// for LL_VECTORIZE
+
+// Fills the components directly, so nothing is done to the values that
+// LLXformMatrix::update() would not do.
+static inline LLQuaternion raw_quaternion(F32 x, F32 y, F32 z, F32 w)
+{
+	LLQuaternion q;
+	q.mQ[VX] = x;
+	q.mQ[VY] = y;
+	q.mQ[VZ] = z;
+	q.mQ[VW] = w;
+	return q;
+}
+
+//-----------------------------------------------------------------------------
+// LLFlatSkeleton()
+//-----------------------------------------------------------------------------
+LLFlatSkeleton::LLFlatSkeleton()
+:	mRoot(NULL),
+	mHierarchyVersion(0),
+	mStride(0)
+{
+}
+
+//-----------------------------------------------------------------------------
+// ~LLFlatSkeleton()
+//-----------------------------------------------------------------------------
+LLFlatSkeleton::~LLFlatSkeleton()
+{
+}
+
+//-----------------------------------------------------------------------------
+// build()
+//-----------------------------------------------------------------------------
+void LLFlatSkeleton::build(LLJoint* root)
+{
+	clear();
+	if (!root)
+	{
+		return;
+	}
+
+	mRoot = root;
+	mHierarchyVersion = root->getNumHierarchyChanges();
+
+	// breadth first, so each depth level is one contiguous run
+	mJoints.push_back(root);
+	mParents.push_back(-1);
+	mLevelStarts.push_back(0);
+
+	S32 level_start = 0;
+	while (level_start < (S32)mJoints.size())
+	{
+		S32 level_end = (S32)mJoints.size();
+		for (S32 i = level_start; i < level_end; i++)
+		{
+			LLJoint* joint = mJoints[i];
+			for (LLJoint::child_list_t::iterator iter = joint->mChildren.begin();
+				 iter != joint->mChildren.end(); ++iter)
+			{
+				mJoints.push_back(*iter);
+				mParents.push_back(i);
+			}
+		}
+		mLevelStarts.push_back(level_end);
+		level_start = level_end;
+	}
+
+	S32 num_joints = (S32)mJoints.size();
+	mActive.resize(num_joints, FALSE);
+	mState.resize(num_joints + 4, JOINT_SKIP);
+	mStride = (num_joints + 7) & ~3;
+	mChannels.resize(NUM_CHANNELS * mStride, 0.f);
+}
+
+//-----------------------------------------------------------------------------
+// clear()
+//-----------------------------------------------------------------------------
+void LLFlatSkeleton::clear()
+{
+	mRoot = NULL;
+	mJoints.clear();
+	mParents.clear();
+	mLevelStarts.clear();
+	mActive.clear();
+	mState.clear();
+	mChannels.clear();
+	mStride = 0;
+}
+
+//-----------------------------------------------------------------------------
+// updateWorldMatrices()
+//-----------------------------------------------------------------------------
+void LLFlatSkeleton::updateWorldMatrices()
+{
+	if (!mRoot)
+	{
+		return;
+	}
+
+	if (mHierarchyVersion != mRoot->getNumHierarchyChanges())
+	{
+		build(mRoot);
+	}
+
+	gatherJoints();
+
+	S32 num_levels = getNumLevels();
+	for (S32 level = 0; level < num_levels; level++)
+	{
+		updateLevel(mLevelStarts[level], mLevelStarts[level + 1]);
+	}
+}
+
+//-----------------------------------------------------------------------------
+// getWorldPosition()
+//-----------------------------------------------------------------------------
+LLVector3 LLFlatSkeleton::getWorldPosition(S32 index) const
+{
+	return LLVector3(getChannel(WORLD_POS_X)[index],
+					 getChannel(WORLD_POS_Y)[index],
+					 getChannel(WORLD_POS_Z)[index]);
+}
+
+//-----------------------------------------------------------------------------
+// getWorldRotation()
+//-----------------------------------------------------------------------------
+LLQuaternion LLFlatSkeleton::getWorldRotation(S32 index) const
+{
+	return raw_quaternion(getChannel(WORLD_ROT_X)[index],
+						  getChannel(WORLD_ROT_Y)[index],
+						  getChannel(WORLD_ROT_Z)[index],
+						  getChannel(WORLD_ROT_W)[index]);
+}
+
+//-----------------------------------------------------------------------------
+// storeWorld()
+//-----------------------------------------------------------------------------
+void LLFlatSkeleton::storeWorld(S32 index, const LLVector3& pos, const LLQuaternion& rot)
+{
+	getChannel(WORLD_POS_X)[index] = pos.mV[VX];
+	getChannel(WORLD_POS_Y)[index] = pos.mV[VY];
+	getChannel(WORLD_POS_Z)[index] = pos.mV[VZ];
+	getChannel(WORLD_ROT_X)[index] = rot.mQ[VX];
+	getChannel(WORLD_ROT_Y)[index] = rot.mQ[VY];
+	getChannel(WORLD_ROT_Z)[index] = rot.mQ[VZ];
+	getChannel(WORLD_ROT_W)[index] = rot.mQ[VW];
+}
+
+//-----------------------------------------------------------------------------
+// gatherJoints()
+// Decides which joints need work this update and copies their inputs into
+// the flat arrays. Clean joints contribute their current world transform so
+// their children can read it.
+//-----------------------------------------------------------------------------
+void LLFlatSkeleton::gatherJoints()
+{
+	F32* local_pos[3] = { getChannel(LOCAL_POS_X), getChannel(LOCAL_POS_Y), getChannel(LOCAL_POS_Z) };
+	F32* local_rot[4] = { getChannel(LOCAL_ROT_X), getChannel(LOCAL_ROT_Y), getChannel(LOCAL_ROT_Z), getChannel(LOCAL_ROT_W) };
+
+	S32 num_joints = getNumJoints();
+	for (S32 i = 0; i < num_joints; i++)
+	{
+		LLJoint* joint = mJoints[i];
+		S32 parent = mParents[i];
+
+		// updateWorldMatrixChildren() stops at the first joint that doesn't
+		// update its transform, taking its whole subtree with it
+		mActive[i] = joint->mUpdateXform && (parent < 0 || mActive[parent]);
+		if (!mActive[i])
+		{
+			mState[i] = JOINT_SKIP;
+			continue;
+		}
+
+		LLXformMatrix* xform = joint->getXform();
+		if (!(joint->mDirtyFlags & LLJoint::MATRIX_DIRTY))
+		{
+			mState[i] = JOINT_SKIP;
+			storeWorld(i, xform->getWorldPosition(), xform->getWorldRotation());
+			continue;
+		}
+
+		LLXform* parent_xform = xform->getParent();
+		if (parent < 0 || parent_xform != mJoints[parent]->getXform())
+		{
+			mState[i] = JOINT_SCALAR;
+			continue;
+		}
+
+		// same as LLXformMatrix::update()
+		LLVector3 pos = xform->getPosition();
+		if (parent_xform->getScaleChildOffset())
+		{
+			pos.scaleVec(parent_xform->getScale());
+		}
+		const LLQuaternion& rot = xform->getRotation();
+
+		local_pos[VX][i] = pos.mV[VX];
+		local_pos[VY][i] = pos.mV[VY];
+		local_pos[VZ][i] = pos.mV[VZ];
+		local_rot[VX][i] = rot.mQ[VX];
+		local_rot[VY][i] = rot.mQ[VY];
+		local_rot[VZ][i] = rot.mQ[VZ];
+		local_rot[VW][i] = rot.mQ[VW];
+		mState[i] = JOINT_BATCH;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// updateLevel()
+// Composes every batched joint in [start, end) with its parent's world
+// transform, then writes the results back to the joints. All parents live in
+// earlier levels, so their world values are final by now.
+//-----------------------------------------------------------------------------
+void LLFlatSkeleton::updateLevel(S32 start, S32 end)
+{
+	F32* local_pos[3] = { getChannel(LOCAL_POS_X), getChannel(LOCAL_POS_Y), getChannel(LOCAL_POS_Z) };
+	F32* local_rot[4] = { getChannel(LOCAL_ROT_X), getChannel(LOCAL_ROT_Y), getChannel(LOCAL_ROT_Z), getChannel(LOCAL_ROT_W) };
+	F32* world_pos[3] = { getChannel(WORLD_POS_X), getChannel(WORLD_POS_Y), getChannel(WORLD_POS_Z) };
+	F32* world_rot[4] = { getChannel(WORLD_ROT_X), getChannel(WORLD_ROT_Y), getChannel(WORLD_ROT_Z), getChannel(WORLD_ROT_W) };
+
+#if LL_VECTORIZE
+	// The operations below follow operator*=(LLVector3&, const LLQuaternion&)
+	// and operator*(const LLQuaternion&, const LLQuaternion&) term for term,
+	// so the batched results match the scalar path bit for bit.
+	const __m128 sign = _mm_set1_ps(-0.f);
+	for (S32 i = start; i < end; i += 4)
+	{
+		F32 parent_pos[3][4];
+		F32 parent_rot[4][4];
+		S32 num_batched = 0;
+		for (S32 lane = 0; lane < 4; lane++)
+		{
+			S32 index = i + lane;
+			if (index < end && mState[index] == JOINT_BATCH)
+			{
+				S32 parent = mParents[index];
+				for (S32 c = 0; c < 3; c++)
+				{
+					parent_pos[c][lane] = world_pos[c][parent];
+				}
+				for (S32 c = 0; c < 4; c++)
+				{
+					parent_rot[c][lane] = world_rot[c][parent];
+				}
+				num_batched++;
+			}
+			else
+			{
+				parent_pos[VX][lane] = parent_pos[VY][lane] = parent_pos[VZ][lane] = 0.f;
+				parent_rot[VX][lane] = parent_rot[VY][lane] = parent_rot[VZ][lane] = 0.f;
+				parent_rot[VW][lane] = 1.f;
+			}
+		}
+		if (!num_batched)
+		{
+			continue;
+		}
+
+		const __m128 qx = _mm_loadu_ps(parent_rot[VX]);
+		const __m128 qy = _mm_loadu_ps(parent_rot[VY]);
+		const __m128 qz = _mm_loadu_ps(parent_rot[VZ]);
+		const __m128 qw = _mm_loadu_ps(parent_rot[VW]);
+
+		// world position = local position * parent rotation + parent position
+		const __m128 ax = _mm_loadu_ps(local_pos[VX] + i);
+		const __m128 ay = _mm_loadu_ps(local_pos[VY] + i);
+		const __m128 az = _mm_loadu_ps(local_pos[VZ] + i);
+
+		const __m128 rw = _mm_sub_ps(_mm_sub_ps(_mm_mul_ps(_mm_xor_ps(qx, sign), ax), _mm_mul_ps(qy, ay)), _mm_mul_ps(qz, az));
+		const __m128 rx = _mm_sub_ps(_mm_add_ps(_mm_mul_ps(qw, ax), _mm_mul_ps(qy, az)), _mm_mul_ps(qz, ay));
+		const __m128 ry = _mm_sub_ps(_mm_add_ps(_mm_mul_ps(qw, ay), _mm_mul_ps(qz, ax)), _mm_mul_ps(qx, az));
+		const __m128 rz = _mm_sub_ps(_mm_add_ps(_mm_mul_ps(qw, az), _mm_mul_ps(qx, ay)), _mm_mul_ps(qy, ax));
+		const __m128 nrw = _mm_xor_ps(rw, sign);
+
+		__m128 px = _mm_add_ps(_mm_sub_ps(_mm_add_ps(_mm_mul_ps(nrw, qx), _mm_mul_ps(rx, qw)), _mm_mul_ps(ry, qz)), _mm_mul_ps(rz, qy));
+		__m128 py = _mm_add_ps(_mm_sub_ps(_mm_add_ps(_mm_mul_ps(nrw, qy), _mm_mul_ps(ry, qw)), _mm_mul_ps(rz, qx)), _mm_mul_ps(rx, qz));
+		__m128 pz = _mm_add_ps(_mm_sub_ps(_mm_add_ps(_mm_mul_ps(nrw, qz), _mm_mul_ps(rz, qw)), _mm_mul_ps(rx, qy)), _mm_mul_ps(ry, qx));
+		px = _mm_add_ps(px, _mm_loadu_ps(parent_pos[VX]));
+		py = _mm_add_ps(py, _mm_loadu_ps(parent_pos[VY]));
+		pz = _mm_add_ps(pz, _mm_loadu_ps(parent_pos[VZ]));
+
+		// world rotation = local rotation * parent rotation
+		const __m128 lx = _mm_loadu_ps(local_rot[VX] + i);
+		const __m128 ly = _mm_loadu_ps(local_rot[VY] + i);
+		const __m128 lz = _mm_loadu_ps(local_rot[VZ] + i);
+		const __m128 lw = _mm_loadu_ps(local_rot[VW] + i);
+
+		const __m128 ox = _mm_sub_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(qw, lx), _mm_mul_ps(qx, lw)), _mm_mul_ps(qy, lz)), _mm_mul_ps(qz, ly));
+		const __m128 oy = _mm_sub_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(qw, ly), _mm_mul_ps(qy, lw)), _mm_mul_ps(qz, lx)), _mm_mul_ps(qx, lz));
+		const __m128 oz = _mm_sub_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(qw, lz), _mm_mul_ps(qz, lw)), _mm_mul_ps(qx, ly)), _mm_mul_ps(qy, lx));
+		const __m128 ow = _mm_sub_ps(_mm_sub_ps(_mm_sub_ps(_mm_mul_ps(qw, lw), _mm_mul_ps(qx, lx)), _mm_mul_ps(qy, ly)), _mm_mul_ps(qz, lz));
+
+		if (num_batched == 4)
+		{
+			_mm_storeu_ps(world_pos[VX] + i, px);
+			_mm_storeu_ps(world_pos[VY] + i, py);
+			_mm_storeu_ps(world_pos[VZ] + i, pz);
+			_mm_storeu_ps(world_rot[VX] + i, ox);
+			_mm_storeu_ps(world_rot[VY] + i, oy);
+			_mm_storeu_ps(world_rot[VZ] + i, oz);
+			_mm_storeu_ps(world_rot[VW] + i, ow);
+		}
+		else
+		{
+			// partial batch, leave the other lanes' world values alone
+			F32 out[7][4];
+			_mm_storeu_ps(out[0], px);
+			_mm_storeu_ps(out[1], py);
+			_mm_storeu_ps(out[2], pz);
+			_mm_storeu_ps(out[3], ox);
+			_mm_storeu_ps(out[4], oy);
+			_mm_storeu_ps(out[5], oz);
+			_mm_storeu_ps(out[6], ow);
+			for (S32 lane = 0; lane < 4; lane++)
+			{
+				S32 index = i + lane;
+				if (index < end && mState[index] == JOINT_BATCH)
+				{
+					for (S32 c = 0; c < 3; c++)
+					{
+						world_pos[c][index] = out[c][lane];
+					}
+					for (S32 c = 0; c < 4; c++)
+					{
+						world_rot[c][index] = out[3 + c][lane];
+					}
+				}
+			}
+		}
+	}
+#else
+	for (S32 i = start; i < end; i++)
+	{
+		if (mState[i] != JOINT_BATCH)
+		{
+			continue;
+		}
+
+		S32 parent = mParents[i];
+		LLVector3 parent_pos(world_pos[VX][parent], world_pos[VY][parent], world_pos[VZ][parent]);
+		LLQuaternion parent_rot = raw_quaternion(world_rot[VX][parent], world_rot[VY][parent], world_rot[VZ][parent], world_rot[VW][parent]);
+
+		LLVector3 pos(local_pos[VX][i], local_pos[VY][i], local_pos[VZ][i]);
+		pos *= parent_rot;
+		pos += parent_pos;
+		LLQuaternion rot = raw_quaternion(local_rot[VX][i], local_rot[VY][i], local_rot[VZ][i], local_rot[VW][i]) * parent_rot;
+		storeWorld(i, pos, rot);
+	}
+#endif
+
+	S32 num_updates = 0;
+	for (S32 i = start; i < end; i++)
+	{
+		LLJoint* joint = mJoints[i];
+		if (mState[i] == JOINT_BATCH)
+		{
+			// same bookkeeping as LLJoint::updateWorldMatrix()
+			joint->getXform()->setWorldTransform(getWorldPosition(i), getWorldRotation(i));
+			joint->mDirtyFlags = 0x0;
+			num_updates++;
+		}
+		else if (mState[i] == JOINT_SCALAR)
+		{
+			joint->updateWorldMatrix();
+			LLXformMatrix* xform = joint->getXform();
+			storeWorld(i, xform->getWorldPosition(), xform->getWorldRotation());
+		}
+	}
+	LLJoint::addUpdates(num_updates);
+}
@@ -0,0 +1,115 @@
+/** 
+ * @file llflatskeleton.h
+ * @brief A flattened, structure-of-arrays view of an LLJoint hierarchy.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ * 
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ * 
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ * 
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLFLATSKELETON_H
+#define LL_LLFLATSKELETON_H
+
+#include <vector>
+
+#include "v3math.h"
+#include "llquaternion.h"
+
+class LLJoint;
+
+//-----------------------------------------------------------------------------
+// class LLFlatSkeleton
+//
+// Mirrors a joint tree as flat arrays: joints sorted breadth first so that
+// every parent comes before its children, a parent index per joint, and the
+// local and world position/rotation of each joint stored channel by channel.
+// updateWorldMatrices() produces exactly what root->updateWorldMatrixChildren()
+// would, one depth level at a time, four joints per SIMD batch, without
+// recursing through the child lists.
+//
+// The joints still own their transforms; results are written back to each
+// joint's LLXformMatrix, so existing readers (getWorldMatrix() etc.) keep
+// working. The skeleton rebuilds itself when its own joint tree changes.
+//-----------------------------------------------------------------------------
+class LLFlatSkeleton
+{
+public:
+	LLFlatSkeleton();
+	~LLFlatSkeleton();
+
+	// Flattens the tree rooted at root.
+	void build(LLJoint* root);
+	void clear();
+	BOOL isBuilt() const { return mRoot != NULL; }
+
+	// Brings every dirty, updatable joint's world transform up to date.
+	void updateWorldMatrices();
+
+	S32 getNumJoints() const { return (S32)mJoints.size(); }
+	S32 getNumLevels() const { return (S32)mLevelStarts.size() - 1; }
+	LLJoint* getJoint(S32 index) const { return mJoints[index]; }
+	// -1 for the root
+	S32 getParentIndex(S32 index) const { return mParents[index]; }
+
+	// World transform as of the last updateWorldMatrices(). Only meaningful
+	// for joints that were updatable at that time.
+	LLVector3 getWorldPosition(S32 index) const;
+	LLQuaternion getWorldRotation(S32 index) const;
+
+private:
+	enum
+	{
+		LOCAL_POS_X, LOCAL_POS_Y, LOCAL_POS_Z,
+		LOCAL_ROT_X, LOCAL_ROT_Y, LOCAL_ROT_Z, LOCAL_ROT_W,
+		WORLD_POS_X, WORLD_POS_Y, WORLD_POS_Z,
+		WORLD_ROT_X, WORLD_ROT_Y, WORLD_ROT_Z, WORLD_ROT_W,
+		NUM_CHANNELS
+	};
+
+	enum
+	{
+		JOINT_SKIP,		// not updatable, or already clean
+		JOINT_BATCH,	// recomputed from the flat arrays
+		JOINT_SCALAR	// transform parented outside the tree, use LLJoint
+	};
+
+	F32* getChannel(S32 channel) { return &mChannels[channel * mStride]; }
+	const F32* getChannel(S32 channel) const { return &mChannels[channel * mStride]; }
+
+	void gatherJoints();
+	void updateLevel(S32 start, S32 end);
+	void storeWorld(S32 index, const LLVector3& pos, const LLQuaternion& rot);
+
+	LLJoint*				mRoot;
+	S32						mHierarchyVersion;
+
+	std::vector<LLJoint*>	mJoints;
+	std::vector<S32>		mParents;
+	std::vector<S32>		mLevelStarts;
+	std::vector<U8>			mActive;
+	std::vector<U8>			mState;
+
+	// NUM_CHANNELS runs of mStride floats, padded so a batch of four
+	// starting at any joint stays in bounds
+	std::vector<F32>		mChannels;
+	S32						mStride;
+};
+
+#endif // LL_LLFLATSKELETON_H
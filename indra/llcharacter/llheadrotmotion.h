@@ -30,6 +30,8 @@
 //-----------------------------------------------------------------------------
 // Header files
 //-----------------------------------------------------------------------------
+#include <boost/random/linear_congruential.hpp>
+
 #include "llmotion.h"
 #include "llframetimer.h"
 
@@ -184,6 +186,11 @@ public:
 	// called when a motion is deactivated
 	virtual void onDeactivate();
 
+protected:
+	// random float in [0, val), drawn from this motion's own generator so
+	// that characters can be animated concurrently
+	F32 randomFloat(F32 val = 1.f);
+
 public:
 	//-------------------------------------------------------------------------
 	// joint states to be animated
@@ -206,6 +213,8 @@ public:
 	LLFrameTimer		mEyeBlinkTimer;
 	F32					mEyeBlinkTime;
 	BOOL				mEyesClosed;
+
+	boost::minstd_rand	mRandom;
 };
 
 #endif // LL_LLHEADROTMOTION_H
@@ -36,6 +36,42 @@
 S32 LLJoint::sNumUpdates = 0;
 S32 LLJoint::sNumTouches = 0;
 
+#if LL_WINDOWS
+#define LL_JOINT_THREAD_LOCAL __declspec(thread)
+#else
+#define LL_JOINT_THREAD_LOCAL __thread
+#endif
+
+// where the current thread counts, NULL for the statics
+static LL_JOINT_THREAD_LOCAL S32* sThreadNumTouches = NULL;
+static LL_JOINT_THREAD_LOCAL S32* sThreadNumUpdates = NULL;
+
+//-----------------------------------------------------------------------------
+// setThreadCounters()
+//-----------------------------------------------------------------------------
+// static
+void LLJoint::setThreadCounters(S32* num_touches, S32* num_updates)
+{
+	sThreadNumTouches = num_touches;
+	sThreadNumUpdates = num_updates;
+}
+
+//-----------------------------------------------------------------------------
+// addUpdates()
+//-----------------------------------------------------------------------------
+// static
+void LLJoint::addUpdates(S32 count)
+{
+	if (sThreadNumUpdates)
+	{
+		*sThreadNumUpdates += count;
+	}
+	else
+	{
+		sNumUpdates += count;
+	}
+}
+
 //-----------------------------------------------------------------------------
 // LLJoint()
 // Class Constructor
@@ -49,6 +85,7 @@ LLJoint::LLJoint()
 	mDirtyFlags = MATRIX_DIRTY | ROTATION_DIRTY | POSITION_DIRTY;
 	mUpdateXform = TRUE;
 	mJointNum = -1;
+	mNumHierarchyChanges = 0;
 	touch();
 }
 
@@ -66,6 +103,7 @@ LLJoint::LLJoint(const std::string &name, LLJoint *parent)
 	mDirtyFlags = MATRIX_DIRTY | ROTATION_DIRTY | POSITION_DIRTY;
 	mUpdateXform = FALSE;
 	mJointNum = 0;
+	mNumHierarchyChanges = 0;
 
 	setName(name);
 	if (parent)
@@ -109,7 +147,14 @@ void LLJoint::touch(U32 flags)
 {
 	if ((flags | mDirtyFlags) != mDirtyFlags)
 	{
-		sNumTouches++;
+		if (sThreadNumTouches)
+		{
+			(*sThreadNumTouches)++;
+		}
+		else
+		{
+			sNumTouches++;
+		}
 		mDirtyFlags |= flags;
 		U32 child_flags = flags;
 		if (flags & ROTATION_DIRTY)
@@ -174,6 +219,7 @@ void LLJoint::addChild(LLJoint* joint)
 	joint->mXform.setParent(&mXform);
 	joint->mParent = this;	
 	joint->touch();
+	hierarchyChanged();
 }
 
 
@@ -190,6 +236,7 @@ void LLJoint::removeChild(LLJoint* joint)
 		joint->mXform.setParent(NULL);
 		joint->mParent = NULL;
 		joint->touch();
+		hierarchyChanged();
 	}
 }
 
@@ -208,6 +255,19 @@ void LLJoint::removeAllChildren()
 		joint->mXform.setParent(NULL);
 		joint->mParent = NULL;
 		joint->touch();
+		hierarchyChanged();
+	}
+}
+
+
+//--------------------------------------------------------------------
+// hierarchyChanged()
+//--------------------------------------------------------------------
+void LLJoint::hierarchyChanged()
+{
+	for (LLJoint* joint = this; joint; joint = joint->mParent)
+	{
+		joint->mNumHierarchyChanges++;
 	}
 }
 
@@ -462,7 +522,7 @@ void LLJoint::updateWorldMatrix()
 {
 	if (mDirtyFlags & MATRIX_DIRTY)
 	{
-		sNumUpdates++;
+		addUpdates(1);
 		mXform.updateMatrix(FALSE);
 		mDirtyFlags = 0x0;
 	}
@@ -81,6 +81,11 @@ protected:
 	// explicit transformation members
 	LLXformMatrix		mXform;
 
+	S32				mNumHierarchyChanges;
+
+	// bumps mNumHierarchyChanges here and in every ancestor
+	void hierarchyChanged();
+
 public:
 	U32				mDirtyFlags;
 	BOOL			mUpdateXform;
@@ -94,7 +99,7 @@ public:
 	typedef std::list<LLJoint*> child_list_t;
 	child_list_t mChildren;
 
-	// debug statics
+	// debug statics, only written on the main thread; see setThreadCounters()
 	static S32		sNumTouches;
 	static S32		sNumUpdates;
 
@@ -104,6 +109,13 @@ public:
 
 	virtual ~LLJoint();
 
+	// While set, touches and updates made on the calling thread are
+	// counted here instead of in sNumTouches and sNumUpdates, for the
+	// main thread to add in later. Pass NULL to stop.
+	static void setThreadCounters(S32* num_touches, S32* num_updates);
+	// counts world matrix updates done outside updateWorldMatrix()
+	static void addUpdates(S32 count);
+
 	// set name and parent
 	void setup( const std::string &name, LLJoint *parent=NULL );
 
@@ -122,6 +134,10 @@ public:
 	// search for child joints by name
 	LLJoint *findJoint( const std::string &name );
 
+	// Bumped whenever this joint or one below it gains or loses a child,
+	// so flattened copies of a hierarchy (LLFlatSkeleton) know to rebuild.
+	S32 getNumHierarchyChanges() const { return mNumHierarchyChanges; }
+
 	// add/remove children
 	void addChild( LLJoint *joint );
 	void removeChild( LLJoint *joint );
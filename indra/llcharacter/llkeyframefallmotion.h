@@ -63,6 +63,8 @@ public:
 	virtual BOOL onActivate();
 	virtual F32 getEaseInDuration();
 	virtual BOOL onUpdate(F32 activeTime, U8* joint_mask);
+	// keeps per character state of its own, so it is not reused
+	virtual BOOL onRecycle() { return FALSE; }
 
 protected:
 	//-------------------------------------------------------------------------
@@ -62,6 +62,10 @@ static F32 MIN_ACCELERATION_SQUARED = 0.0005f * 0.0005f;
 
 static F32 MAX_CONSTRAINTS = 10;
 
+// animation data keys, kept around so applying keyframes does not build strings
+static const std::string HAND_POSE("Hand Pose");
+static const std::string HAND_POSE_PRIORITY("Hand Pose Priority");
+
 //-----------------------------------------------------------------------------
 // JointMotionList
 //-----------------------------------------------------------------------------
@@ -127,6 +131,59 @@ U32 LLKeyframeMotion::JointMotionList::dumpDiagInfo()
 //-----------------------------------------------------------------------------
 
 
+//-----------------------------------------------------------------------------
+// Key list helpers
+//-----------------------------------------------------------------------------
+template <class KEY>
+struct KeyTimeLess
+{
+	bool operator()(const KEY& a, const KEY& b) const { return a.mTime < b.mTime; }
+	bool operator()(const KEY& a, F32 time) const { return a.mTime < time; }
+	bool operator()(F32 time, const KEY& a) const { return time < a.mTime; }
+};
+
+// Sorts keys by time.  Of several keys at the same time the last one
+// added wins, as it did when keys were stored in a map.
+template <class KEY>
+static void sort_keys(std::vector<KEY>& keys)
+{
+	std::stable_sort(keys.begin(), keys.end(), KeyTimeLess<KEY>());
+	typename std::vector<KEY>::iterator out = keys.begin();
+	for (typename std::vector<KEY>::iterator in = keys.begin(); in != keys.end(); ++in)
+	{
+		if (out != keys.begin() && (out - 1)->mTime == in->mTime)
+		{
+			*(out - 1) = *in;
+		}
+		else
+		{
+			*out++ = *in;
+		}
+	}
+	keys.erase(out, keys.end());
+}
+
+// Returns the index of the first key at or after time, or the number of
+// keys if there is none.  Playback mostly moves forward a frame at a time,
+// so the answer from last time (or the key after it) usually still holds
+// and the binary search is only needed on loops and jumps.
+template <class KEY>
+static S32 find_key(const std::vector<KEY>& keys, F32 time, S32& cursor)
+{
+	const S32 num_keys = (S32)keys.size();
+	for (S32 right = llmax(cursor, 0); right <= cursor + 1 && right <= num_keys; ++right)
+	{
+		if ((right == num_keys || time <= keys[right].mTime)
+			&& (right == 0 || keys[right - 1].mTime < time))
+		{
+			cursor = right;
+			return right;
+		}
+	}
+	cursor = (S32)(std::lower_bound(keys.begin(), keys.end(), time, KeyTimeLess<KEY>()) - keys.begin());
+	return cursor;
+}
+
 //-----------------------------------------------------------------------------
 // ScaleCurve::ScaleCurve()
 //-----------------------------------------------------------------------------
@@ -139,16 +196,30 @@ LLKeyframeMotion::ScaleCurve::ScaleCurve()
 //-----------------------------------------------------------------------------
 // ScaleCurve::~ScaleCurve()
 //-----------------------------------------------------------------------------
-LLKeyframeMotion::ScaleCurve::~ScaleCurve() 
+LLKeyframeMotion::ScaleCurve::~ScaleCurve()
 {
 	mKeys.clear();
 	mNumKeys = 0;
 }
 
 //-----------------------------------------------------------------------------
-// getValue()
+// ScaleCurve::sortKeys()
+//-----------------------------------------------------------------------------
+void LLKeyframeMotion::ScaleCurve::sortKeys()
+{
+	sort_keys(mKeys);
+}
+
+//-----------------------------------------------------------------------------
+// ScaleCurve::getValue()
 //-----------------------------------------------------------------------------
 LLVector3 LLKeyframeMotion::ScaleCurve::getValue(F32 time, F32 duration)
+{
+	S32 cursor = 0;
+	return getValue(time, duration, cursor);
+}
+
+LLVector3 LLKeyframeMotion::ScaleCurve::getValue(F32 time, F32 duration, S32& cursor)
 {
 	LLVector3 value;
 
@@ -158,34 +229,24 @@ LLVector3 LLKeyframeMotion::ScaleCurve::getValue(F32 time, F32 duration)
 		return value;
 	}
 	
-	key_map_t::iterator right = mKeys.lower_bound(time);
-	if (right == mKeys.end())
+	S32 right = find_key(mKeys, time, cursor);
+	if (right == (S32)mKeys.size())
 	{
 		// Past last key
-		--right;
-		value = right->second.mScale;
+		value = mKeys.back().mScale;
 	}
-	else if (right == mKeys.begin() || right->first == time)
+	else if (right == 0 || mKeys[right].mTime == time)
 	{
 		// Before first key or exactly on a key
-		value = right->second.mScale;
+		value = mKeys[right].mScale;
 	}
 	else
 	{
 		// Between two keys
-		key_map_t::iterator left = right; --left;
-		F32 index_before = left->first;
-		F32 index_after = right->first;
-		ScaleKey& scale_before = left->second;
-		ScaleKey& scale_after = right->second;
-		if (right == mKeys.end())
-		{
-			scale_after = mLoopInKey;
-			index_after = duration;
-		}
-
-		F32 u = (time - index_before) / (index_after - index_before);
-		value = interp(u, scale_before, scale_after);
+		ScaleKey& key_before = mKeys[right - 1];
+		ScaleKey& key_after = mKeys[right];
+		F32 u = (time - key_before.mTime) / (key_after.mTime - key_before.mTime);
+		value = interp(u, key_before, key_after);
 	}
 	return value;
 }
@@ -225,10 +286,24 @@ LLKeyframeMotion::RotationCurve::~RotationCurve()
 	mNumKeys = 0;
 }
 
+//-----------------------------------------------------------------------------
+// RotationCurve::sortKeys()
+//-----------------------------------------------------------------------------
+void LLKeyframeMotion::RotationCurve::sortKeys()
+{
+	sort_keys(mKeys);
+}
+
 //-----------------------------------------------------------------------------
 // RotationCurve::getValue()
 //-----------------------------------------------------------------------------
 LLQuaternion LLKeyframeMotion::RotationCurve::getValue(F32 time, F32 duration)
+{
+	S32 cursor = 0;
+	return getValue(time, duration, cursor);
+}
+
+LLQuaternion LLKeyframeMotion::RotationCurve::getValue(F32 time, F32 duration, S32& cursor)
 {
 	LLQuaternion value;
 
@@ -238,34 +313,24 @@ LLQuaternion LLKeyframeMotion::RotationCurve::getValue(F32 time, F32 duration)
 		return value;
 	}
 	
-	key_map_t::iterator right = mKeys.lower_bound(time);
-	if (right == mKeys.end())
+	S32 right = find_key(mKeys, time, cursor);
+	if (right == (S32)mKeys.size())
 	{
 		// Past last key
-		--right;
-		value = right->second.mRotation;
+		value = mKeys.back().mRotation;
 	}
-	else if (right == mKeys.begin() || right->first == time)
+	else if (right == 0 || mKeys[right].mTime == time)
 	{
 		// Before first key or exactly on a key
-		value = right->second.mRotation;
+		value = mKeys[right].mRotation;
 	}
 	else
 	{
 		// Between two keys
-		key_map_t::iterator left = right; --left;
-		F32 index_before = left->first;
-		F32 index_after = right->first;
-		RotationKey& rot_before = left->second;
-		RotationKey& rot_after = right->second;
-		if (right == mKeys.end())
-		{
-			rot_after = mLoopInKey;
-			index_after = duration;
-		}
-
-		F32 u = (time - index_before) / (index_after - index_before);
-		value = interp(u, rot_before, rot_after);
+		RotationKey& key_before = mKeys[right - 1];
+		RotationKey& key_after = mKeys[right];
+		F32 u = (time - key_before.mTime) / (key_after.mTime - key_before.mTime);
+		value = interp(u, key_before, key_after);
 	}
 	return value;
 }
@@ -287,6 +352,37 @@ LLQuaternion LLKeyframeMotion::RotationCurve::interp(F32 u, RotationKey& before,
 	}
 }
 
+//-----------------------------------------------------------------------------
+// RotationCurve::getInterpolants()
+//-----------------------------------------------------------------------------
+void LLKeyframeMotion::RotationCurve::getInterpolants(F32 time, S32& cursor, LLQuaternion& before, LLQuaternion& after, F32& u)
+{
+	u = 0.f;
+	if (mKeys.empty())
+	{
+		before = after = LLQuaternion::DEFAULT;
+		return;
+	}
+
+	S32 right = find_key(mKeys, time, cursor);
+	if (right == (S32)mKeys.size())
+	{
+		before = after = mKeys.back().mRotation;
+	}
+	else if (right == 0 || mKeys[right].mTime == time)
+	{
+		before = after = mKeys[right].mRotation;
+	}
+	else
+	{
+		const RotationKey& key_before = mKeys[right - 1];
+		const RotationKey& key_after = mKeys[right];
+		before = key_before.mRotation;
+		after = mInterpolationType == IT_STEP ? key_before.mRotation : key_after.mRotation;
+		u = (time - key_before.mTime) / (key_after.mTime - key_before.mTime);
+	}
+}
+
 
 //-----------------------------------------------------------------------------
 // PositionCurve::PositionCurve()
@@ -306,10 +402,24 @@ LLKeyframeMotion::PositionCurve::~PositionCurve()
 	mNumKeys = 0;
 }
 
+//-----------------------------------------------------------------------------
+// PositionCurve::sortKeys()
+//-----------------------------------------------------------------------------
+void LLKeyframeMotion::PositionCurve::sortKeys()
+{
+	sort_keys(mKeys);
+}
+
 //-----------------------------------------------------------------------------
 // PositionCurve::getValue()
 //-----------------------------------------------------------------------------
 LLVector3 LLKeyframeMotion::PositionCurve::getValue(F32 time, F32 duration)
+{
+	S32 cursor = 0;
+	return getValue(time, duration, cursor);
+}
+
+LLVector3 LLKeyframeMotion::PositionCurve::getValue(F32 time, F32 duration, S32& cursor)
 {
 	LLVector3 value;
 
@@ -319,34 +429,24 @@ LLVector3 LLKeyframeMotion::PositionCurve::getValue(F32 time, F32 duration)
 		return value;
 	}
 	
-	key_map_t::iterator right = mKeys.lower_bound(time);
-	if (right == mKeys.end())
+	S32 right = find_key(mKeys, time, cursor);
+	if (right == (S32)mKeys.size())
 	{
 		// Past last key
-		--right;
-		value = right->second.mPosition;
+		value = mKeys.back().mPosition;
 	}
-	else if (right == mKeys.begin() || right->first == time)
+	else if (right == 0 || mKeys[right].mTime == time)
 	{
 		// Before first key or exactly on a key
-		value = right->second.mPosition;
+		value = mKeys[right].mPosition;
 	}
 	else
 	{
 		// Between two keys
-		key_map_t::iterator left = right; --left;
-		F32 index_before = left->first;
-		F32 index_after = right->first;
-		PositionKey& pos_before = left->second;
-		PositionKey& pos_after = right->second;
-		if (right == mKeys.end())
-		{
-			pos_after = mLoopInKey;
-			index_after = duration;
-		}
-
-		F32 u = (time - index_before) / (index_after - index_before);
-		value = interp(u, pos_before, pos_after);
+		PositionKey& key_before = mKeys[right - 1];
+		PositionKey& key_after = mKeys[right];
+		F32 u = (time - key_before.mTime) / (key_after.mTime - key_before.mTime);
+		value = interp(u, key_before, key_after);
 	}
 
 	llassert(value.isFinite());
@@ -371,52 +471,6 @@ LLVector3 LLKeyframeMotion::PositionCurve::interp(F32 u, PositionKey& before, Po
 }
 
 
-//-----------------------------------------------------------------------------
-//-----------------------------------------------------------------------------
-// JointMotion class
-//-----------------------------------------------------------------------------
-//-----------------------------------------------------------------------------
-
-//-----------------------------------------------------------------------------
-// JointMotion::update()
-//-----------------------------------------------------------------------------
-void LLKeyframeMotion::JointMotion::update(LLJointState* joint_state, F32 time, F32 duration)
-{
-	// this value being 0 is the cause of https://jira.lindenlab.com/browse/SL-22678 but I haven't 
-	// managed to get a stack to see how it got here. Testing for 0 here will stop the crash.
-	if ( joint_state == NULL )
-	{
-		return;
-	}
-
-	U32 usage = joint_state->getUsage();
-
-	//-------------------------------------------------------------------------
-	// update scale component of joint state
-	//-------------------------------------------------------------------------
-	if ((usage & LLJointState::SCALE) && mScaleCurve.mNumKeys)
-	{
-		joint_state->setScale( mScaleCurve.getValue( time, duration ) );
-	}
-
-	//-------------------------------------------------------------------------
-	// update rotation component of joint state
-	//-------------------------------------------------------------------------
-	if ((usage & LLJointState::ROT) && mRotationCurve.mNumKeys)
-	{
-		joint_state->setRotation( mRotationCurve.getValue( time, duration ) );
-	}
-
-	//-------------------------------------------------------------------------
-	// update position component of joint state
-	//-------------------------------------------------------------------------
-	if ((usage & LLJointState::POS) && mPositionCurve.mNumKeys)
-	{
-		joint_state->setPosition( mPositionCurve.getValue( time, duration ) );
-	}
-}
-
-
 //-----------------------------------------------------------------------------
 //-----------------------------------------------------------------------------
 // LLKeyframeMotion class
@@ -477,6 +531,111 @@ LLJoint* LLKeyframeMotion::getJoint(U32 index)
 	return joint;
 }
 
+//-----------------------------------------------------------------------------
+// bindJoint()
+// Finds the joint of mCharacter animated by a joint motion, through the
+// index cached in the shared joint motion list when it still fits.
+//-----------------------------------------------------------------------------
+LLJoint* LLKeyframeMotion::bindJoint(U32 index)
+{
+	const S32 UNRESOLVED = -2;
+	std::vector<S32>& joint_indices = mJointMotionList->mJointIndices;
+	if (joint_indices.size() != mJointMotionList->getNumJointMotions())
+	{
+		joint_indices.assign(mJointMotionList->getNumJointMotions(), UNRESOLVED);
+	}
+
+	const std::string& joint_name = mJointMotionList->getJointMotion(index)->mJointName;
+	S32 joint_num = joint_indices[index];
+	if (joint_num >= 0)
+	{
+		LLJoint* joint = mCharacter->getCharacterJoint(joint_num);
+		if (joint && joint->getName() == joint_name)
+		{
+			return joint;
+		}
+	}
+
+	LLJoint* joint = mCharacter->getJoint(joint_name);
+	if (joint_num == UNRESOLVED)
+	{
+		joint_indices[index] = -1;
+		for (U32 i = 0; joint && i < LL_CHARACTER_MAX_JOINTS; i++)
+		{
+			LLJoint* character_joint = mCharacter->getCharacterJoint(i);
+			if (!character_joint)
+			{
+				break;
+			}
+			if (character_joint == joint)
+			{
+				joint_indices[index] = i;
+				break;
+			}
+		}
+	}
+	return joint;
+}
+
+//-----------------------------------------------------------------------------
+// rebindPose()
+// Points the joint states and constraints of a recycled instance at the
+// joints of mCharacter. Nothing is allocated unless the new character is
+// missing joints the old one had, or the other way around.
+//-----------------------------------------------------------------------------
+void LLKeyframeMotion::rebindPose()
+{
+	BOOL same_joints = TRUE;
+	for (U32 i = 0; i < mJointStates.size(); i++)
+	{
+		LLJointState* joint_state = mJointStates[i];
+		LLJoint* joint = bindJoint(i);
+		if ((joint != NULL) != (joint_state->getJoint() != NULL))
+		{
+			same_joints = FALSE;
+		}
+		joint_state->setJoint(joint);
+		if (joint)
+		{
+			JointMotion* joint_motion = mJointMotionList->getJointMotion(i);
+			joint_state->setUsage(joint_motion->mUsage);
+			joint_state->setPriority(joint_motion->mPriority);
+		}
+	}
+
+	// the pose is keyed by joint name, so it can stay as it is as long as
+	// the same set of joints is animated
+	if (!same_joints)
+	{
+		mPose.removeAllJointStates();
+	}
+	for (S32 i = 0; i < 3; i++)
+	{
+		memset(&mJointSignature[i][0], 0, sizeof(U8) * LL_CHARACTER_MAX_JOINTS);
+	}
+	for (U32 i = 0; i < mJointStates.size(); i++)
+	{
+		if (mJointStates[i]->getJoint())
+		{
+			addJointState(mJointStates[i]);
+		}
+	}
+
+	for (constraint_list_t::iterator iter = mConstraints.begin();
+		 iter != mConstraints.end(); ++iter)
+	{
+		JointConstraint* constraintp = *iter;
+		constraintp->mActive = FALSE;
+		constraintp->mWeight = 0.f;
+		initializeConstraint(constraintp);
+	}
+
+	if (!mConstraints.empty())
+	{
+		mPelvisp = mCharacter->getJoint("mPelvis");
+	}
+}
+
 //-----------------------------------------------------------------------------
 // LLKeyframeMotion::onInitialize(LLCharacter *character)
 //-----------------------------------------------------------------------------
@@ -507,6 +666,11 @@ LLMotion::LLMotionInitStatus LLKeyframeMotion::onInitialize(LLCharacter *charact
 		return STATUS_FAILURE;
 	case ASSET_LOADED:
 		return STATUS_SUCCESS;
+	case ASSET_RECYCLED:
+		// an instance another character was done with
+		rebindPose();
+		mAssetStatus = ASSET_LOADED;
+		return STATUS_SUCCESS;
 	default:
 		// we don't know what state the asset is in yet, so keep going
 		// check keyframe cache first then static vfs then asset request
@@ -527,7 +691,7 @@ LLMotion::LLMotionInitStatus LLKeyframeMotion::onInitialize(LLCharacter *charact
 		for(U32 i = 0; i < mJointMotionList->getNumJointMotions(); i++)
 		{
 			JointMotion* joint_motion = mJointMotionList->getJointMotion(i);
-			if (LLJoint *joint = mCharacter->getJoint(joint_motion->mJointName))
+			if (LLJoint *joint = bindJoint(i))
 			{
 				LLPointer<LLJointState> joint_state = new LLJointState;
 				mJointStates.push_back(joint_state);
@@ -644,6 +808,43 @@ BOOL LLKeyframeMotion::setupPose()
 	return TRUE;
 }
 
+//-----------------------------------------------------------------------------
+// LLKeyframeMotion::onRecycle()
+//-----------------------------------------------------------------------------
+BOOL LLKeyframeMotion::onRecycle()
+{
+	// only instances bound to data in the keyframe cache can be reused,
+	// as the cache flushes them before that data goes away
+	if (mAssetStatus != ASSET_LOADED
+		|| !mJointMotionList
+		|| LLKeyframeDataCache::getKeyframeData(getID()) != mJointMotionList
+		|| mJointStates.size() != mJointMotionList->getNumJointMotions())
+	{
+		return FALSE;
+	}
+
+	// a joint state still held elsewhere, e.g. by the old character's pose
+	// blender, would go on moving whichever joint it gets bound to next
+	for (U32 i = 0; i < mJointStates.size(); i++)
+	{
+		LLJointState* joint_state = mJointStates[i];
+		S32 expected_refs = joint_state->getJoint() ? 2 : 1;	// ours and the pose's
+		if (joint_state->getNumRefs() > expected_refs)
+		{
+			return FALSE;
+		}
+	}
+
+	mCharacter = NULL;
+	mPelvisp = NULL;
+	mLastSkeletonSerialNum = 0;
+	mLastUpdateTime = 0.f;
+	mLastLoopedTime = 0.f;
+	mKeyCursors.clear();
+	mAssetStatus = ASSET_RECYCLED;
+	return TRUE;
+}
+
 //-----------------------------------------------------------------------------
 // LLKeyframeMotion::onActivate()
 //-----------------------------------------------------------------------------
@@ -720,27 +921,78 @@ BOOL LLKeyframeMotion::onUpdate(F32 time, U8* joint_mask)
 //-----------------------------------------------------------------------------
 void LLKeyframeMotion::applyKeyframes(F32 time)
 {
-	llassert_always (mJointMotionList->getNumJointMotions() <= mJointStates.size());
-	for (U32 i=0; i<mJointMotionList->getNumJointMotions(); i++)
+	const U32 num_joint_motions = mJointMotionList->getNumJointMotions();
+	const F32 duration = mJointMotionList->mDuration;
+	llassert_always (num_joint_motions <= mJointStates.size());
+	if (mKeyCursors.size() != num_joint_motions)
+	{
+		mKeyCursors.assign(num_joint_motions, KeyCursors());
+		mRotationStates.resize(num_joint_motions);
+		mRotationsBefore.resize(num_joint_motions);
+		mRotationsAfter.resize(num_joint_motions);
+		mRotationInterps.resize(num_joint_motions);
+		mRotations.resize(num_joint_motions);
+	}
+
+	// Positions and scales are set as we go.  Rotations are gathered and
+	// interpolated in one batch, which is where most of the time goes.
+	S32 num_rotations = 0;
+	for (U32 i = 0; i < num_joint_motions; i++)
+	{
+		LLJointState* joint_state = mJointStates[i];
+		// this value being 0 is the cause of https://jira.lindenlab.com/browse/SL-22678 but I haven't 
+		// managed to get a stack to see how it got here. Testing for 0 here will stop the crash.
+		if (joint_state == NULL)
+		{
+			continue;
+		}
+
+		JointMotion* joint_motion = mJointMotionList->getJointMotion(i);
+		KeyCursors& cursors = mKeyCursors[i];
+		U32 usage = joint_state->getUsage();
+
+		if ((usage & LLJointState::SCALE) && joint_motion->mScaleCurve.mNumKeys)
+		{
+			joint_state->setScale(joint_motion->mScaleCurve.getValue(time, duration, cursors.mScale));
+		}
+
+		if ((usage & LLJointState::ROT) && joint_motion->mRotationCurve.mNumKeys)
+		{
+			joint_motion->mRotationCurve.getInterpolants(time, cursors.mRotation,
+														 mRotationsBefore[num_rotations],
+														 mRotationsAfter[num_rotations],
+														 mRotationInterps[num_rotations]);
+			mRotationStates[num_rotations++] = joint_state;
+		}
+
+		if ((usage & LLJointState::POS) && joint_motion->mPositionCurve.mNumKeys)
+		{
+			joint_state->setPosition(joint_motion->mPositionCurve.getValue(time, duration, cursors.mPosition));
+		}
+	}
+
+	if (num_rotations)
 	{
-		mJointMotionList->getJointMotion(i)->update(mJointStates[i],
-													  time, 
-													  mJointMotionList->mDuration );
+		nlerp_batch(num_rotations, &mRotationInterps[0], &mRotationsBefore[0], &mRotationsAfter[0], &mRotations[0]);
+		for (S32 i = 0; i < num_rotations; i++)
+		{
+			mRotationStates[i]->setRotation(mRotations[i]);
+		}
 	}
 
-	LLJoint::JointPriority* pose_priority = (LLJoint::JointPriority* )mCharacter->getAnimationData("Hand Pose Priority");
+	LLJoint::JointPriority* pose_priority = (LLJoint::JointPriority* )mCharacter->getAnimationData(HAND_POSE_PRIORITY);
 	if (pose_priority)
 	{
 		if (mJointMotionList->mMaxPriority >= *pose_priority)
 		{
-			mCharacter->setAnimationData("Hand Pose", &mJointMotionList->mHandPose);
-			mCharacter->setAnimationData("Hand Pose Priority", &mJointMotionList->mMaxPriority);
+			mCharacter->setAnimationData(HAND_POSE, &mJointMotionList->mHandPose);
+			mCharacter->setAnimationData(HAND_POSE_PRIORITY, &mJointMotionList->mMaxPriority);
 		}
 	}
 	else
 	{
-		mCharacter->setAnimationData("Hand Pose", &mJointMotionList->mHandPose);
-		mCharacter->setAnimationData("Hand Pose Priority", &mJointMotionList->mMaxPriority);
+		mCharacter->setAnimationData(HAND_POSE, &mJointMotionList->mHandPose);
+		mCharacter->setAnimationData(HAND_POSE_PRIORITY, &mJointMotionList->mMaxPriority);
 	}
 }
 
@@ -1497,8 +1749,9 @@ BOOL LLKeyframeMotion::deserialize(LLDataPacker& dp)
 				return FALSE;
 			}
 
-			rCurve->mKeys[time] = rot_key;
+			rCurve->mKeys.push_back(rot_key);
 		}
+		rCurve->sortKeys();
 
 		//---------------------------------------------------------------------
 		// scan position curve header
@@ -1576,13 +1829,14 @@ BOOL LLKeyframeMotion::deserialize(LLDataPacker& dp)
 				return FALSE;
 			}
 			
-			pCurve->mKeys[pos_key.mTime] = pos_key;
+			pCurve->mKeys.push_back(pos_key);
 
 			if (is_pelvis)
 			{
 				mJointMotionList->mPelvisBBox.addPoint(pos_key.mPosition);
 			}
 		}
+		pCurve->sortKeys();
 
 		joint_motion->mUsage = joint_state->getUsage();
 	}
@@ -1827,10 +2081,10 @@ BOOL LLKeyframeMotion::serialize(LLDataPacker& dp) const
 		success &= dp.packS32(joint_motionp->mPriority, "joint_priority");
 		success &= dp.packS32(joint_motionp->mRotationCurve.mNumKeys, "num_rot_keys");
 
-		for (RotationCurve::key_map_t::iterator iter = joint_motionp->mRotationCurve.mKeys.begin();
+		for (RotationCurve::key_list_t::iterator iter = joint_motionp->mRotationCurve.mKeys.begin();
 			 iter != joint_motionp->mRotationCurve.mKeys.end(); ++iter)
 		{
-			RotationKey& rot_key = iter->second;
+			RotationKey& rot_key = *iter;
 			U16 time_short = F32_to_U16(rot_key.mTime, 0.f, mJointMotionList->mDuration);
 			success &= dp.packU16(time_short, "time");
 
@@ -1847,10 +2101,10 @@ BOOL LLKeyframeMotion::serialize(LLDataPacker& dp) const
 		}
 
 		success &= dp.packS32(joint_motionp->mPositionCurve.mNumKeys, "num_pos_keys");
-		for (PositionCurve::key_map_t::iterator iter = joint_motionp->mPositionCurve.mKeys.begin();
+		for (PositionCurve::key_list_t::iterator iter = joint_motionp->mPositionCurve.mKeys.begin();
 			 iter != joint_motionp->mPositionCurve.mKeys.end(); ++iter)
 		{
-			PositionKey& pos_key = iter->second;
+			PositionKey& pos_key = *iter;
 			U16 time_short = F32_to_U16(pos_key.mTime, 0.f, mJointMotionList->mDuration);
 			success &= dp.packU16(time_short, "time");
 
@@ -2184,6 +2438,7 @@ void LLKeyframeDataCache::removeKeyframeData(const LLUUID& id)
 	keyframe_data_map_t::iterator found_data = sKeyframeDataMap.find(id);
 	if (found_data != sKeyframeDataMap.end())
 	{
+		LLMotionController::flushRetiredMotions(id);
 		delete found_data->second;
 		sKeyframeDataMap.erase(found_data);
 	}
@@ -2215,6 +2470,7 @@ LLKeyframeDataCache::~LLKeyframeDataCache()
 //-----------------------------------------------------------------------------
 void LLKeyframeDataCache::clear()
 {
+	LLMotionController::flushRetiredMotions();
 	for_each(sKeyframeDataMap.begin(), sKeyframeDataMap.end(), DeletePairedPointer());
 	sKeyframeDataMap.clear();
 }
@@ -71,6 +71,8 @@ private:
 	// private helper functions to wrap some asserts
 	LLPointer<LLJointState>& getJointState(U32 index);
 	LLJoint* getJoint(U32 index);
+	LLJoint* bindJoint(U32 index);
+	void rebindPose();
 	
 public:
 	//-------------------------------------------------------------------------
@@ -139,6 +141,9 @@ public:
 	// called when a motion is deactivated
 	virtual void onDeactivate();
 
+	// called when the motion is handed to another character
+	virtual BOOL onRecycle();
+
 	virtual void setStopTime(F32 time);
 
 	static void setVFS(LLVFS* vfs) { sVFS = vfs; }
@@ -268,7 +273,8 @@ protected:
 	BOOL	setupPose();
 
 public:
-	enum AssetStatus { ASSET_LOADED, ASSET_FETCHED, ASSET_NEEDS_FETCH, ASSET_FETCH_FAILED, ASSET_UNDEFINED };
+	// ASSET_RECYCLED is loaded, with joint states still bound to the last character
+	enum AssetStatus { ASSET_LOADED, ASSET_FETCHED, ASSET_NEEDS_FETCH, ASSET_FETCH_FAILED, ASSET_UNDEFINED, ASSET_RECYCLED };
 
 	enum InterpolationType { IT_STEP, IT_LINEAR, IT_SPLINE };
 
@@ -320,12 +326,16 @@ public:
 		ScaleCurve();
 		~ScaleCurve();
 		LLVector3 getValue(F32 time, F32 duration);
+		// Same as above, starting the key search from the key found last time.
+		LLVector3 getValue(F32 time, F32 duration, S32& cursor);
 		LLVector3 interp(F32 u, ScaleKey& before, ScaleKey& after);
+		// Puts keys in time order once they have all been added.
+		void sortKeys();
 
 		InterpolationType	mInterpolationType;
 		S32					mNumKeys;
-		typedef std::map<F32, ScaleKey> key_map_t;
-		key_map_t 			mKeys;
+		typedef std::vector<ScaleKey> key_list_t;
+		key_list_t 			mKeys;
 		ScaleKey			mLoopInKey;
 		ScaleKey			mLoopOutKey;
 	};
@@ -339,12 +349,18 @@ public:
 		RotationCurve();
 		~RotationCurve();
 		LLQuaternion getValue(F32 time, F32 duration);
+		// Same as above, starting the key search from the key found last time.
+		LLQuaternion getValue(F32 time, F32 duration, S32& cursor);
 		LLQuaternion interp(F32 u, RotationKey& before, RotationKey& after);
+		// Finds the keys to nlerp between at time, for batching the interpolation.
+		void getInterpolants(F32 time, S32& cursor, LLQuaternion& before, LLQuaternion& after, F32& u);
+		// Puts keys in time order once they have all been added.
+		void sortKeys();
 
 		InterpolationType	mInterpolationType;
 		S32					mNumKeys;
-		typedef std::map<F32, RotationKey> key_map_t;
-		key_map_t		mKeys;
+		typedef std::vector<RotationKey> key_list_t;
+		key_list_t		mKeys;
 		RotationKey		mLoopInKey;
 		RotationKey		mLoopOutKey;
 	};
@@ -358,12 +374,16 @@ public:
 		PositionCurve();
 		~PositionCurve();
 		LLVector3 getValue(F32 time, F32 duration);
+		// Same as above, starting the key search from the key found last time.
+		LLVector3 getValue(F32 time, F32 duration, S32& cursor);
 		LLVector3 interp(F32 u, PositionKey& before, PositionKey& after);
+		// Puts keys in time order once they have all been added.
+		void sortKeys();
 
 		InterpolationType	mInterpolationType;
 		S32					mNumKeys;
-		typedef std::map<F32, PositionKey> key_map_t;
-		key_map_t		mKeys;
+		typedef std::vector<PositionKey> key_list_t;
+		key_list_t		mKeys;
 		PositionKey		mLoopInKey;
 		PositionKey		mLoopOutKey;
 	};
@@ -380,8 +400,19 @@ public:
 		std::string		mJointName;
 		U32				mUsage;
 		LLJoint::JointPriority	mPriority;
+	};
 
-		void update(LLJointState* joint_state, F32 time, F32 duration);
+	//-------------------------------------------------------------------------
+	// KeyCursors
+	// Where each curve of a joint motion was last evaluated.  Curves are
+	// shared between every instance of a motion, so these live per instance.
+	//-------------------------------------------------------------------------
+	struct KeyCursors
+	{
+		KeyCursors() : mPosition(0), mRotation(0), mScale(0) {}
+		S32 mPosition;
+		S32 mRotation;
+		S32 mScale;
 	};
 	
 	//-------------------------------------------------------------------------
@@ -407,6 +438,10 @@ public:
 		// TODO: LLKeyframeDataCache::getKeyframeData should probably return a class containing 
 		// JointMotionList and mEmoteName, see LLKeyframeMotion::onInitialize.
 		std::string				mEmoteName; 
+		// For each joint motion, the index of its joint in LLCharacter::getCharacterJoint()
+		// (-1 if it is none of those), resolved by the first character to play the motion.
+		// Every avatar is built from the same skeleton, so later ones only check the name.
+		std::vector<S32>		mJointIndices;
 	public:
 		JointMotionList();
 		~JointMotionList();
@@ -432,6 +467,14 @@ protected:
 	F32								mLastUpdateTime;
 	F32								mLastLoopedTime;
 	AssetStatus						mAssetStatus;
+
+	// per frame evaluation state, see applyKeyframes()
+	std::vector<KeyCursors>			mKeyCursors;
+	std::vector<LLJointState*>		mRotationStates;
+	std::vector<LLQuaternion>		mRotationsBefore;
+	std::vector<LLQuaternion>		mRotationsAfter;
+	std::vector<F32>				mRotationInterps;
+	std::vector<LLQuaternion>		mRotations;
 };
 
 class LLKeyframeDataCache
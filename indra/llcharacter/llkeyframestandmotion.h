@@ -64,6 +64,8 @@ public:
 	virtual BOOL onActivate();
 	void	onDeactivate();
 	virtual BOOL onUpdate(F32 time, U8* joint_mask);
+	// keeps per character state of its own, so it is not reused
+	virtual BOOL onRecycle() { return FALSE; }
 
 public:
 	//-------------------------------------------------------------------------
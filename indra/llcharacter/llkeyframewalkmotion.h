@@ -68,6 +68,8 @@ public:
 	virtual BOOL onActivate();
 	virtual void onDeactivate();
 	virtual BOOL onUpdate(F32 time, U8* joint_mask);
+	// keeps per character state of its own, so it is not reused
+	virtual BOOL onRecycle() { return FALSE; }
 
 public:
 	//-------------------------------------------------------------------------
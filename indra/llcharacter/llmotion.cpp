@@ -122,6 +122,29 @@ void LLMotion::setDeactivateCallback( void (*cb)(void *), void* userdata )
 	mDeactivateCallbackUserData = userdata;
 }
 
+//-----------------------------------------------------------------------------
+// recycle()
+//-----------------------------------------------------------------------------
+BOOL LLMotion::recycle()
+{
+	if (!onRecycle())
+	{
+		return FALSE;
+	}
+
+	mStopped = TRUE;
+	mActive = FALSE;
+	mActivationTimestamp = 0.f;
+	mStopTimestamp = 0.f;
+	mSendStopTimestamp = F32_MAX;
+	mResidualWeight = 0.f;
+	mFadeWeight = 1.f;
+	mDeactivateCallback = NULL;
+	mDeactivateCallbackUserData = NULL;
+	mPose.setWeight(0.f);
+	return TRUE;
+}
+
 //virtual
 void LLMotion::setStopTime(F32 time)
 {
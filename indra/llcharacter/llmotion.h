@@ -156,12 +156,23 @@ public:
 	// optional callback routine called when animation deactivated.
 	void	setDeactivateCallback( void (*cb)(void *), void* userdata );
 
+	// resets a motion that its controller is done with, so that the
+	// registry can hand it to another character instead of constructing
+	// a new one. returns FALSE if the motion can't be reused.
+	BOOL	recycle();
+
 protected:
 	// called when a motion is activated
 	// must return TRUE to indicate success, or else
 	// it will be deactivated
 	virtual BOOL onActivate() = 0;
 
+	// called when the motion is about to be reused, it may no longer touch
+	// its old character, whose joints may be gone already.
+	// must return TRUE once the next onInitialize() can bind it to a new
+	// character, the default is to never reuse the motion
+	virtual BOOL onRecycle() { return FALSE; }
+
 	void addJointState(const LLPointer<LLJointState>& jointState);
 
 protected:
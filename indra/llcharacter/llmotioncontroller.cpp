@@ -40,6 +40,7 @@
 
 const S32 NUM_JOINT_SIGNATURE_STRIDES = LL_CHARACTER_MAX_JOINTS / 4;
 const U32 MAX_MOTION_INSTANCES = 32;
+const S32 MAX_RETIRED_MOTIONS = 256;
 
 //-----------------------------------------------------------------------------
 // Constants and statics
@@ -57,6 +58,7 @@ LLMotionRegistry LLMotionController::sRegistry;
 // Class Constructor
 //-----------------------------------------------------------------------------
 LLMotionRegistry::LLMotionRegistry()
+	: mNumRetiredMotions(0)
 {
 	
 }
@@ -68,6 +70,7 @@ LLMotionRegistry::LLMotionRegistry()
 //-----------------------------------------------------------------------------
 LLMotionRegistry::~LLMotionRegistry()
 {
+	flushRetiredMotions();
 	mMotionTable.clear();
 }
 
@@ -93,13 +96,26 @@ BOOL LLMotionRegistry::registerMotion( const LLUUID& id, LLMotionConstructor con
 void LLMotionRegistry::markBad( const LLUUID& id )
 {
 	mMotionTable[id] = LLMotionConstructor(NULL);
+	flushRetiredMotions(id);
 }
 
 //-----------------------------------------------------------------------------
 // createMotion()
 //-----------------------------------------------------------------------------
-LLMotion *LLMotionRegistry::createMotion( const LLUUID &id )
+LLMotion *LLMotionRegistry::createMotion( const LLUUID &id, BOOL reuse )
 {
+	if (reuse)
+	{
+		retired_motion_map_t::iterator iter = mRetiredMotions.find(id);
+		if (iter != mRetiredMotions.end() && !iter->second.empty())
+		{
+			LLMotion* motion = iter->second.back();
+			iter->second.pop_back();
+			mNumRetiredMotions--;
+			return motion;
+		}
+	}
+
 	LLMotionConstructor constructor = get_if_there(mMotionTable, id, LLMotionConstructor(NULL));
 	LLMotion* motion = NULL;
 
@@ -116,6 +132,47 @@ LLMotion *LLMotionRegistry::createMotion( const LLUUID &id )
 	return motion;
 }
 
+//-----------------------------------------------------------------------------
+// retireMotion()
+//-----------------------------------------------------------------------------
+void LLMotionRegistry::retireMotion( LLMotion* motion )
+{
+	if (mNumRetiredMotions < MAX_RETIRED_MOTIONS && motion->recycle())
+	{
+		mRetiredMotions[motion->getID()].push_back(motion);
+		mNumRetiredMotions++;
+	}
+	else
+	{
+		delete motion;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// flushRetiredMotions()
+//-----------------------------------------------------------------------------
+void LLMotionRegistry::flushRetiredMotions( const LLUUID& id )
+{
+	retired_motion_map_t::iterator iter = mRetiredMotions.find(id);
+	if (iter != mRetiredMotions.end())
+	{
+		mNumRetiredMotions -= iter->second.size();
+		for_each(iter->second.begin(), iter->second.end(), DeletePointer());
+		mRetiredMotions.erase(iter);
+	}
+}
+
+void LLMotionRegistry::flushRetiredMotions()
+{
+	for (retired_motion_map_t::iterator iter = mRetiredMotions.begin();
+		 iter != mRetiredMotions.end(); ++iter)
+	{
+		for_each(iter->second.begin(), iter->second.end(), DeletePointer());
+	}
+	mRetiredMotions.clear();
+	mNumRetiredMotions = 0;
+}
+
 //-----------------------------------------------------------------------------
 //-----------------------------------------------------------------------------
 // LLMotionController class
@@ -138,7 +195,8 @@ LLMotionController::LLMotionController()
 	  mTimeStep(0.f),
 	  mTimeStepCount(0),
 	  mLastInterp(0.f),
-	  mIsSelf(FALSE)
+	  mIsSelf(FALSE),
+	  mUpdatingConcurrently(FALSE)
 {
 }
 
@@ -170,7 +228,16 @@ void LLMotionController::deleteAllMotions()
 	mLoadedMotions.clear();
 	mActiveMotions.clear();
 
-	for_each(mAllMotions.begin(), mAllMotions.end(), DeletePairedPointer());
+	// blenders may still reference the joint states of our motions,
+	// which would keep them from being reused
+	mPoseBlender.clearBlenders();
+
+	flushPendingRetiredMotions();
+	for (motion_map_t::iterator iter = mAllMotions.begin();
+		 iter != mAllMotions.end(); ++iter)
+	{
+		sRegistry.retireMotion(iter->second);
+	}
 	mAllMotions.clear();
 }
 
@@ -303,6 +370,21 @@ BOOL LLMotionController::registerMotion( const LLUUID& id, LLMotionConstructor c
 	return sRegistry.registerMotion(id, constructor);
 }
 
+//-----------------------------------------------------------------------------
+// flushRetiredMotions()
+//-----------------------------------------------------------------------------
+//static
+void LLMotionController::flushRetiredMotions( const LLUUID& id )
+{
+	sRegistry.flushRetiredMotions(id);
+}
+
+//static
+void LLMotionController::flushRetiredMotions()
+{
+	sRegistry.flushRetiredMotions();
+}
+
 //-----------------------------------------------------------------------------
 // removeMotion()
 //-----------------------------------------------------------------------------
@@ -326,8 +408,32 @@ void LLMotionController::removeMotionInstance(LLMotion* motionp)
 		mLoadingMotions.erase(motionp);
 		mLoadedMotions.erase(motionp);
 		mActiveMotions.remove(motionp);
-		delete motionp;
+		retireMotionInstance(motionp);
+	}
+}
+
+// hands a motion no longer on any of our lists back to the registry,
+// which is shared by all controllers and so only touched on the main thread
+void LLMotionController::retireMotionInstance(LLMotion* motionp)
+{
+	if (mUpdatingConcurrently)
+	{
+		mPendingRetiredMotions.push_back(motionp);
+	}
+	else
+	{
+		sRegistry.retireMotion(motionp);
+	}
+}
+
+void LLMotionController::flushPendingRetiredMotions()
+{
+	for (std::vector<LLMotion*>::iterator iter = mPendingRetiredMotions.begin();
+		 iter != mPendingRetiredMotions.end(); ++iter)
+	{
+		sRegistry.retireMotion(*iter);
 	}
+	mPendingRetiredMotions.clear();
 }
 
 //-----------------------------------------------------------------------------
@@ -342,8 +448,9 @@ LLMotion* LLMotionController::createMotion( const LLUUID &id )
 	// if not, we need to create one
 	if (!motion)
 	{
-		// look up constructor and create it
-		motion = sRegistry.createMotion(id);
+		// look up constructor and create it, or reuse an instance another
+		// character was done with
+		motion = sRegistry.createMotion(id, !mUpdatingConcurrently);
 		if (!motion)
 		{
 			return NULL;
@@ -753,6 +860,8 @@ void LLMotionController::updateMotionsByType(LLMotion::LLMotionBlendType anim_ty
 //-----------------------------------------------------------------------------
 void LLMotionController::updateLoadingMotions()
 {
+	flushPendingRetiredMotions();
+
 	// query pending motions for completion
 	for (motion_set_t::iterator iter = mLoadingMotions.begin();
 		 iter != mLoadingMotions.end(); )
@@ -799,6 +908,27 @@ void LLMotionController::updateLoadingMotions()
 // updateMotion()
 //-----------------------------------------------------------------------------
 void LLMotionController::updateMotions(bool force_update)
+{
+	updateMotionsInternal(force_update, true);
+}
+
+//-----------------------------------------------------------------------------
+// updateMotionsConcurrent()
+// Loading motions call into the asset system and the shared keyframe
+// cache, so they are left for the caller to pick up on the main thread
+// and start blending in on the following update.
+//-----------------------------------------------------------------------------
+void LLMotionController::updateMotionsConcurrent(bool force_update)
+{
+	mUpdatingConcurrently = TRUE;
+	updateMotionsInternal(force_update, false);
+	mUpdatingConcurrently = FALSE;
+}
+
+//-----------------------------------------------------------------------------
+// updateMotionsInternal()
+//-----------------------------------------------------------------------------
+void LLMotionController::updateMotionsInternal(bool force_update, bool update_loading)
 {
 	BOOL use_quantum = (mTimeStep != 0.f);
 
@@ -831,7 +961,10 @@ void LLMotionController::updateMotions(bool force_update)
 					mLastInterp = interp;
 				}
 
-				updateLoadingMotions();
+				if (update_loading)
+				{
+					updateLoadingMotions();
+				}
 				return;
 			}
 			
@@ -849,7 +982,10 @@ void LLMotionController::updateMotions(bool force_update)
 		}
 	}
 
-	updateLoadingMotions();
+	if (update_loading)
+	{
+		updateLoadingMotions();
+	}
 
 	resetJointSignatures();
 
@@ -33,6 +33,7 @@
 #include <string>
 #include <map>
 #include <deque>
+#include <vector>
 
 #include "lluuidhashmap.h"
 #include "llmotion.h"
@@ -67,7 +68,19 @@ public:
 
 	// creates a new instance of a named motion
 	// returns NULL motion is not registered
-	LLMotion *createMotion( const LLUUID &id );
+	// if reuse is TRUE, an instance retired by another controller is
+	// handed out instead when there is one
+	LLMotion *createMotion( const LLUUID &id, BOOL reuse = TRUE );
+
+	// takes a motion a controller is done with, keeping it for
+	// createMotion() if it can be reused and deleting it otherwise
+	void retireMotion( LLMotion* motion );
+
+	// deletes the retired instances of a motion, or of all motions
+	void flushRetiredMotions( const LLUUID& id );
+	void flushRetiredMotions();
+
+	S32 getNumRetiredMotions() const { return mNumRetiredMotions; }
 
 	// initialization of motion failed, don't try to create this motion again
 	void markBad( const LLUUID& id );
@@ -76,6 +89,10 @@ public:
 protected:
 	typedef std::map<LLUUID, LLMotionConstructor> motion_map_t;
 	motion_map_t mMotionTable;
+
+	typedef std::map<LLUUID, std::vector<LLMotion*> > retired_motion_map_t;
+	retired_motion_map_t mRetiredMotions;
+	S32 mNumRetiredMotions;
 };
 
 //-----------------------------------------------------------------------------
@@ -113,6 +130,12 @@ public:
 	// returns true if successfull
 	void removeMotion( const LLUUID& id );
 
+	// deletes the instances of a motion kept for reuse, for when the
+	// data they share is about to go away
+	static void flushRetiredMotions( const LLUUID& id );
+	static void flushRetiredMotions();
+	static S32 getNumRetiredMotions() { return sRegistry.getNumRetiredMotions(); }
+
 	// start motion
 	// begins playing the specified motion
 	// returns true if successful
@@ -133,6 +156,11 @@ public:
 	// deactivates terminated motions`
 	void updateMotions(bool force_update = false);
 
+	// update motions without touching motions which are still loading
+	// safe to call for several controllers at once from different threads,
+	// as long as updateLoadingMotions() is called afterwards on the main thread
+	void updateMotionsConcurrent(bool force_update = false);
+
 	// minimal update (e.g. while hidden)
 	void updateMotionsMinimal();
 
@@ -177,10 +205,13 @@ protected:
 	void deprecateMotionInstance(LLMotion* motion);
 	BOOL stopMotionInstance(LLMotion *motion, BOOL stop_imemdiate);
 	void removeMotionInstance(LLMotion* motion);
+	void retireMotionInstance(LLMotion* motion);
+	void flushPendingRetiredMotions();
 	void updateRegularMotions();
 	void updateAdditiveMotions();
 	void resetJointSignatures();
 	void updateMotionsByType(LLMotion::LLMotionBlendType motion_type);
+	void updateMotionsInternal(bool force_update, bool update_loading);
 	void updateIdleMotion(LLMotion* motionp);
 	void updateIdleActiveMotions();
 	void purgeExcessMotions();
@@ -208,6 +239,11 @@ protected:
 	motion_set_t		mLoadedMotions;
 	motion_list_t		mActiveMotions;
 	motion_set_t		mDeprecatedMotions;
+
+	// motions removed during a concurrent update, handed to the shared
+	// registry on the main thread by updateLoadingMotions()
+	BOOL				mUpdatingConcurrently;
+	std::vector<LLMotion*>	mPendingRetiredMotions;
 	
 	LLFrameTimer		mTimer;
 	F32					mPrevTimerElapsed;
@@ -0,0 +1,206 @@
+/**
+ * @file llflatskeleton_test.cpp
+ * @brief Checks LLFlatSkeleton against the recursive LLJoint update.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ * 
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ * 
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ * 
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "../llflatskeleton.h"
+
+#include "lljoint.h"
+#include "llstl.h"
+
+#include "../test/lltut.h"
+
+namespace
+{
+	const S32 NUM_JOINTS = 61;
+
+	// Deterministic values so two rigs can be posed identically.
+	class Sequence
+	{
+	public:
+		Sequence() : mState(12345) {}
+		F32 next()
+		{
+			mState = mState * 1664525 + 1013904223;
+			return (F32)(mState >> 8) / (F32)(1 << 24) * 2.f - 1.f;
+		}
+	private:
+		U32 mState;
+	};
+
+	// A bushy hierarchy: joint i hangs off joint (i - 1) / 3.
+	class Rig
+	{
+	public:
+		Rig()
+		{
+			for (S32 i = 0; i < NUM_JOINTS; i++)
+			{
+				LLJoint* joint = new LLJoint();
+				joint->mUpdateXform = TRUE;
+				if (i)
+				{
+					mJoints[(i - 1) / 3]->addChild(joint);
+				}
+				mJoints.push_back(joint);
+			}
+		}
+
+		~Rig()
+		{
+			for_each(mJoints.begin(), mJoints.end(), DeletePointer());
+		}
+
+		void pose(Sequence& seq, S32 first = 0, S32 step = 1)
+		{
+			for (S32 i = first; i < NUM_JOINTS; i += step)
+			{
+				LLJoint* joint = mJoints[i];
+				joint->setPosition(LLVector3(seq.next(), seq.next(), seq.next()));
+				LLQuaternion rot(seq.next(), seq.next(), seq.next(), seq.next());
+				rot.normalize();
+				joint->setRotation(rot);
+				joint->setScale(LLVector3(1.f + 0.5f * seq.next(), 1.f, 1.f - 0.25f * seq.next()));
+			}
+		}
+
+		std::vector<LLJoint*> mJoints;
+	};
+
+	// compare world transforms without going through the lazy getters; the
+	// flat skeleton does the same float operations, so they match exactly
+	void ensure_same_world(const Rig& expected, const Rig& actual)
+	{
+		for (S32 i = 0; i < NUM_JOINTS; i++)
+		{
+			LLXformMatrix* a = expected.mJoints[i]->getXform();
+			LLXformMatrix* b = actual.mJoints[i]->getXform();
+			for (S32 c = 0; c < 3; c++)
+			{
+				tut::ensure_equals("world position", b->getWorldPosition().mV[c], a->getWorldPosition().mV[c]);
+			}
+			for (S32 c = 0; c < 4; c++)
+			{
+				tut::ensure_equals("world rotation", b->getWorldRotation().mQ[c], a->getWorldRotation().mQ[c]);
+			}
+			for (S32 row = 0; row < 4; row++)
+			{
+				for (S32 col = 0; col < 4; col++)
+				{
+					tut::ensure_equals("world matrix", b->getWorldMatrix().mMatrix[row][col], a->getWorldMatrix().mMatrix[row][col]);
+				}
+			}
+			tut::ensure_equals("dirty flags", actual.mJoints[i]->mDirtyFlags, expected.mJoints[i]->mDirtyFlags);
+		}
+	}
+}
+
+namespace tut
+{
+	struct flatskeleton_data
+	{
+	};
+	typedef test_group<flatskeleton_data> flatskeleton_test;
+	typedef flatskeleton_test::object flatskeleton_object;
+	tut::flatskeleton_test flatskeleton_testcase("LLFlatSkeleton");
+
+	template<> template<>
+	void flatskeleton_object::test<1>()
+	{
+		set_test_name("breadth first layout");
+
+		Rig rig;
+		LLFlatSkeleton skeleton;
+		skeleton.build(rig.mJoints[0]);
+		ensure_equals("joint count", skeleton.getNumJoints(), NUM_JOINTS);
+		ensure_equals("root parent", skeleton.getParentIndex(0), -1);
+		for (S32 i = 1; i < skeleton.getNumJoints(); i++)
+		{
+			S32 parent = skeleton.getParentIndex(i);
+			ensure("parents come first", parent >= 0 && parent < i);
+			ensure("parent index", skeleton.getJoint(parent) == skeleton.getJoint(i)->getParent());
+		}
+	}
+
+	template<> template<>
+	void flatskeleton_object::test<2>()
+	{
+		set_test_name("matches updateWorldMatrixChildren");
+
+		Rig expected, actual;
+		Sequence seq_expected, seq_actual;
+		LLFlatSkeleton skeleton;
+		skeleton.build(actual.mJoints[0]);
+
+		// full pose, then a few partial ones so some joints stay clean
+		for (S32 frame = 0; frame < 4; frame++)
+		{
+			expected.pose(seq_expected, frame, frame + 1);
+			actual.pose(seq_actual, frame, frame + 1);
+
+			expected.mJoints[0]->updateWorldMatrixChildren();
+			skeleton.updateWorldMatrices();
+			ensure_same_world(expected, actual);
+		}
+	}
+
+	template<> template<>
+	void flatskeleton_object::test<3>()
+	{
+		set_test_name("frozen subtrees and hierarchy changes");
+
+		Rig expected, actual;
+		Sequence seq_expected, seq_actual;
+		LLFlatSkeleton skeleton;
+		skeleton.build(actual.mJoints[0]);
+
+		expected.pose(seq_expected);
+		actual.pose(seq_actual);
+		expected.mJoints[2]->mUpdateXform = FALSE;
+		actual.mJoints[2]->mUpdateXform = FALSE;
+		expected.mJoints[4]->getXform()->setScaleChildOffset(FALSE);
+		actual.mJoints[4]->getXform()->setScaleChildOffset(FALSE);
+
+		expected.mJoints[0]->updateWorldMatrixChildren();
+		skeleton.updateWorldMatrices();
+		ensure_same_world(expected, actual);
+
+		// move a leaf under another branch; the skeleton must notice, and
+		// only the changed tree counts it
+		S32 expected_changes = expected.mJoints[0]->getNumHierarchyChanges();
+		S32 actual_changes = actual.mJoints[0]->getNumHierarchyChanges();
+		expected.mJoints[3]->addChild(expected.mJoints[NUM_JOINTS - 1]);
+		ensure("changed tree counted", expected.mJoints[0]->getNumHierarchyChanges() != expected_changes);
+		ensure_equals("other tree untouched", actual.mJoints[0]->getNumHierarchyChanges(), actual_changes);
+		actual.mJoints[3]->addChild(actual.mJoints[NUM_JOINTS - 1]);
+		expected.pose(seq_expected, 1, 2);
+		actual.pose(seq_actual, 1, 2);
+
+		expected.mJoints[0]->updateWorldMatrixChildren();
+		skeleton.updateWorldMatrices();
+		ensure_same_world(expected, actual);
+	}
+}
@@ -0,0 +1,574 @@
+/**
+ * @file llkeyframemotion_test.cpp
+ * @date   2010-11
+ * @brief  Test and benchmark keyframe evaluation in LLKeyframeMotion.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ * 
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ * 
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ * 
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "../llkeyframemotion.h"
+
+#include "llcharacter.h"
+#include "lldatapacker.h"
+#include "lljobpool.h"
+#include "llquantize.h"
+#include "llstl.h"
+#include "lltimer.h"
+
+#include "../test/lltut.h"
+
+#include <new>
+
+namespace
+{
+	// heap allocations made while sCountAllocations is set
+	bool sCountAllocations = false;
+	S32 sAllocations = 0;
+}
+
+void* operator new(size_t size)
+{
+	if (sCountAllocations)
+	{
+		++sAllocations;
+	}
+	void* p = malloc(size ? size : 1);
+	if (!p)
+	{
+		throw std::bad_alloc();
+	}
+	return p;
+}
+
+void operator delete(void* p) throw()
+{
+	free(p);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) throw()
+{
+	if (sCountAllocations)
+	{
+		++sAllocations;
+	}
+	return malloc(size ? size : 1);
+}
+
+void operator delete(void* p, const std::nothrow_t&) throw()
+{
+	free(p);
+}
+
+void* operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void operator delete[](void* p) throw()
+{
+	operator delete(p);
+}
+
+void* operator new[](size_t size, const std::nothrow_t& nothrow) throw()
+{
+	return operator new(size, nothrow);
+}
+
+void operator delete[](void* p, const std::nothrow_t& nothrow) throw()
+{
+	operator delete(p, nothrow);
+}
+
+namespace
+{
+	const char* JOINT_NAMES[] =
+	{
+		"mPelvis", "mTorso", "mChest", "mNeck", "mHead",
+		"mCollarLeft", "mShoulderLeft", "mElbowLeft", "mWristLeft",
+		"mCollarRight", "mShoulderRight", "mElbowRight", "mWristRight",
+		"mHipLeft", "mKneeLeft", "mAnkleLeft",
+		"mHipRight", "mKneeRight", "mAnkleRight"
+	};
+	const S32 NUM_JOINTS = sizeof(JOINT_NAMES) / sizeof(JOINT_NAMES[0]);
+	const S32 MAX_ANIM_SIZE = 256 * 1024;
+
+	// A headless character with a bare skeleton, no meshes and no region.
+	class TestCharacter : public LLCharacter
+	{
+	public:
+		TestCharacter(const LLUUID& id)
+		:	mID(id)
+		{
+			mJoints.push_back(new LLJoint(JOINT_NAMES[0]));
+			for (S32 i = 1; i < NUM_JOINTS; i++)
+			{
+				// chain each limb off the one before it, close enough for timing
+				mJoints.push_back(new LLJoint(JOINT_NAMES[i], mJoints[i < 5 ? i - 1 : 0]));
+			}
+		}
+
+		~TestCharacter()
+		{
+			flushAllMotions();
+			for_each(mJoints.begin(), mJoints.end(), DeletePointer());
+		}
+
+		/*virtual*/ const char* getAnimationPrefix() { return "avatar"; }
+		/*virtual*/ LLJoint* getRootJoint() { return mJoints[0]; }
+		/*virtual*/ LLVector3 getCharacterPosition() { return LLVector3::zero; }
+		/*virtual*/ LLQuaternion getCharacterRotation() { return LLQuaternion::DEFAULT; }
+		/*virtual*/ LLVector3 getCharacterVelocity() { return LLVector3::zero; }
+		/*virtual*/ LLVector3 getCharacterAngularVelocity() { return LLVector3::zero; }
+		/*virtual*/ void getGround(const LLVector3& in_pos, LLVector3& out_pos, LLVector3& out_norm)
+		{
+			out_pos = in_pos;
+			out_pos.mV[VZ] = 0.f;
+			out_norm = LLVector3::z_axis;
+		}
+		/*virtual*/ BOOL allocateCharacterJoints(U32 num) { return FALSE; }
+		/*virtual*/ LLJoint* getCharacterJoint(U32 i) { return i < mJoints.size() ? mJoints[i] : NULL; }
+		/*virtual*/ F32 getTimeDilation() { return 1.f; }
+		/*virtual*/ F32 getPixelArea() const { return 10000.f; }
+		/*virtual*/ LLPolyMesh* getHeadMesh() { return NULL; }
+		/*virtual*/ LLPolyMesh* getUpperBodyMesh() { return NULL; }
+		/*virtual*/ LLVector3d getPosGlobalFromAgent(const LLVector3& position) { return LLVector3d(position); }
+		/*virtual*/ LLVector3 getPosAgentFromGlobal(const LLVector3d& position) { return LLVector3(position); }
+		/*virtual*/ void addDebugText(const std::string& text) {}
+		/*virtual*/ const LLUUID& getID() { return mID; }
+
+		LLJoint* getTestJoint(S32 i) { return mJoints[i]; }
+
+	private:
+		LLUUID mID;
+		std::vector<LLJoint*> mJoints;
+	};
+
+	// Loads animation data into the keyframe cache the way the asset
+	// callback does, so later instances of the motion skip the fetch.
+	class TestKeyframeMotion : public LLKeyframeMotion
+	{
+	public:
+		TestKeyframeMotion(const LLUUID& id) : LLKeyframeMotion(id) {}
+
+		BOOL load(LLCharacter* character, const U8* data, S32 size)
+		{
+			mCharacter = character;
+			LLDataPackerBinaryBuffer dp(const_cast<U8*>(data), size);
+			return deserialize(dp);
+		}
+	};
+
+	// Writes a looping dance: every joint swings through num_keys rotation
+	// keys and the pelvis bobs.
+	S32 makeAnim(U8* buffer, S32 num_keys, F32 duration, F32 phase)
+	{
+		LLDataPackerBinaryBuffer dp(buffer, MAX_ANIM_SIZE);
+		dp.packU16(KEYFRAME_MOTION_VERSION, "version");
+		dp.packU16(KEYFRAME_MOTION_SUBVERSION, "sub_version");
+		dp.packS32(LLJoint::MEDIUM_PRIORITY, "base_priority");
+		dp.packF32(duration, "duration");
+		dp.packString(std::string(), "emote_name");
+		dp.packF32(0.f, "loop_in_point");
+		dp.packF32(duration, "loop_out_point");
+		dp.packS32(TRUE, "loop");
+		dp.packF32(0.f, "ease_in_duration");
+		dp.packF32(0.f, "ease_out_duration");
+		dp.packU32(0, "hand_pose");
+		dp.packU32(NUM_JOINTS, "num_joints");
+		for (S32 j = 0; j < NUM_JOINTS; j++)
+		{
+			dp.packString(JOINT_NAMES[j], "joint_name");
+			dp.packS32(LLJoint::MEDIUM_PRIORITY, "joint_priority");
+			dp.packS32(num_keys, "num_rot_keys");
+			for (S32 k = 0; k < num_keys; k++)
+			{
+				F32 time = duration * (F32)k / (F32)(num_keys - 1);
+				F32 angle = 1.5f * sinf(phase + 0.7f * j + 6.f * time / duration);
+				LLQuaternion rot(angle, LLVector3(1.f, 0.3f * j, (F32)(k % 3)));
+				LLVector3 packed = rot.packToVector3();
+				dp.packU16(F32_to_U16(time, 0.f, duration), "time");
+				dp.packU16(F32_to_U16(packed.mV[VX], -1.f, 1.f), "rot_angle_x");
+				dp.packU16(F32_to_U16(packed.mV[VY], -1.f, 1.f), "rot_angle_y");
+				dp.packU16(F32_to_U16(packed.mV[VZ], -1.f, 1.f), "rot_angle_z");
+			}
+			S32 num_pos_keys = j == 0 ? num_keys : 0;
+			dp.packS32(num_pos_keys, "num_pos_keys");
+			for (S32 k = 0; k < num_pos_keys; k++)
+			{
+				F32 time = duration * (F32)k / (F32)(num_keys - 1);
+				dp.packU16(F32_to_U16(time, 0.f, duration), "time");
+				dp.packU16(F32_to_U16(0.f, -LL_MAX_PELVIS_OFFSET, LL_MAX_PELVIS_OFFSET), "pos_x");
+				dp.packU16(F32_to_U16(0.f, -LL_MAX_PELVIS_OFFSET, LL_MAX_PELVIS_OFFSET), "pos_y");
+				dp.packU16(F32_to_U16(0.1f * sinf(12.f * time / duration), -LL_MAX_PELVIS_OFFSET, LL_MAX_PELVIS_OFFSET), "pos_z");
+			}
+		}
+		dp.packS32(0, "num_constraints");
+		return dp.getCurrentSize();
+	}
+
+	// Updates one character per index, the way the viewer animates a crowd.
+	class UpdateJob : public LLJobPool::Job
+	{
+	public:
+		UpdateJob(std::vector<TestCharacter*>& characters) : mCharacters(characters) {}
+
+		/*virtual*/ void run(S32 index)
+		{
+			mCharacters[index]->updateMotionsConcurrent(LLCharacter::FORCE_UPDATE);
+			mCharacters[index]->getRootJoint()->updateWorldMatrixChildren();
+		}
+
+	private:
+		std::vector<TestCharacter*>& mCharacters;
+	};
+
+	// What the curve evaluated to before keys were flattened: a scan for
+	// the first key at or after time.
+	LLQuaternion referenceValue(const LLKeyframeMotion::RotationCurve& curve, F32 time)
+	{
+		const LLKeyframeMotion::RotationCurve::key_list_t& keys = curve.mKeys;
+		size_t right = 0;
+		while (right < keys.size() && keys[right].mTime < time)
+		{
+			++right;
+		}
+		if (right == keys.size())
+		{
+			return keys.back().mRotation;
+		}
+		if (right == 0 || keys[right].mTime == time)
+		{
+			return keys[right].mRotation;
+		}
+		const LLKeyframeMotion::RotationKey& before = keys[right - 1];
+		const LLKeyframeMotion::RotationKey& after = keys[right];
+		return nlerp((time - before.mTime) / (after.mTime - before.mTime), before.mRotation, after.mRotation);
+	}
+}
+
+namespace tut
+{
+	struct keyframemotion_data
+	{
+		keyframemotion_data()
+		:	mBuffer(new U8[MAX_ANIM_SIZE])
+		{
+		}
+
+		~keyframemotion_data()
+		{
+			LLKeyframeDataCache::clear();
+			delete [] mBuffer;
+		}
+
+		U8* mBuffer;
+	};
+	typedef test_group<keyframemotion_data> keyframemotion_test;
+	typedef keyframemotion_test::object keyframemotion_object;
+	tut::keyframemotion_test keyframemotion_testcase("LLKeyframeMotion");
+
+	template<> template<>
+	void keyframemotion_object::test<1>()
+	{
+		set_test_name("keys are sorted and the last of a time wins");
+		LLKeyframeMotion::RotationCurve curve;
+		curve.mKeys.push_back(LLKeyframeMotion::RotationKey(2.f, LLQuaternion(0.5f, LLVector3::x_axis)));
+		curve.mKeys.push_back(LLKeyframeMotion::RotationKey(1.f, LLQuaternion(0.1f, LLVector3::x_axis)));
+		curve.mKeys.push_back(LLKeyframeMotion::RotationKey(2.f, LLQuaternion(0.9f, LLVector3::x_axis)));
+		curve.mKeys.push_back(LLKeyframeMotion::RotationKey(0.f, LLQuaternion::DEFAULT));
+		curve.sortKeys();
+		ensure_equals("duplicate dropped", curve.mKeys.size(), 3U);
+		ensure_equals("first", curve.mKeys[0].mTime, 0.f);
+		ensure_equals("second", curve.mKeys[1].mTime, 1.f);
+		ensure_equals("third", curve.mKeys[2].mTime, 2.f);
+		ensure("later duplicate kept", curve.mKeys[2].mRotation == LLQuaternion(0.9f, LLVector3::x_axis));
+	}
+
+	template<> template<>
+	void keyframemotion_object::test<2>()
+	{
+		set_test_name("cursor matches a full search");
+		const F32 duration = 3.f;
+		const LLUUID anim = LLUUID::generateNewID();
+		TestCharacter character(LLUUID::generateNewID());
+		TestKeyframeMotion loader(anim);
+		S32 size = makeAnim(mBuffer, 40, duration, 0.f);
+		ensure("anim loads", loader.load(&character, mBuffer, size));
+
+		LLKeyframeMotion::JointMotionList* list = LLKeyframeDataCache::getKeyframeData(anim);
+		ensure("anim cached", list != NULL);
+		LLKeyframeMotion::RotationCurve& curve = list->getJointMotion(3)->mRotationCurve;
+		ensure_equals("keys loaded", (S32)curve.mKeys.size(), 40);
+
+		// Play forward in uneven steps, loop, then jump around.
+		S32 cursor = 0;
+		F32 time = -0.1f;
+		for (S32 i = 0; i < 2000; i++)
+		{
+			if (i < 1000)
+			{
+				time += 0.0137f;
+				if (time > duration + 0.1f)
+				{
+					time = 0.f;
+				}
+			}
+			else
+			{
+				time = duration * (F32)((i * 7919) % 1000) / 999.f;
+			}
+			LLQuaternion expected = referenceValue(curve, time);
+			LLQuaternion value = curve.getValue(time, duration, cursor);
+			ensure("cursor lookup", value == expected);
+			ensure("search lookup", curve.getValue(time, duration) == expected);
+		}
+
+		// exactly on keys
+		for (S32 k = (S32)curve.mKeys.size() - 1; k >= 0; k--)
+		{
+			ensure("on key", curve.getValue(curve.mKeys[k].mTime, duration, cursor) == curve.mKeys[k].mRotation);
+		}
+	}
+
+	template<> template<>
+	void keyframemotion_object::test<3>()
+	{
+		set_test_name("crowd benchmark");
+		if (!getenv("LL_RUN_BENCHMARKS"))
+		{
+			skip("benchmark, set LL_RUN_BENCHMARKS to run it");
+		}
+		// LL_KEYFRAME_BENCH_ANIMS can list recorded .anim files, separated
+		// by ':', to play instead of the generated dances.
+		S32 num_avatars = 60;
+		S32 num_frames = 300;
+		if (const char* env = getenv("LL_KEYFRAME_BENCH_AVATARS"))
+		{
+			num_avatars = llmax(1, atoi(env));
+		}
+		if (const char* env = getenv("LL_KEYFRAME_BENCH_FRAMES"))
+		{
+			num_frames = llmax(1, atoi(env));
+		}
+
+		std::vector<TestCharacter*> avatars;
+		for (S32 i = 0; i < num_avatars; i++)
+		{
+			avatars.push_back(new TestCharacter(LLUUID::generateNewID()));
+		}
+
+		std::vector<LLUUID> anims;
+		if (const char* env = getenv("LL_KEYFRAME_BENCH_ANIMS"))
+		{
+			std::string files(env);
+			size_t start = 0;
+			while (start < files.size())
+			{
+				size_t end = files.find(':', start);
+				std::string filename = files.substr(start, end == std::string::npos ? std::string::npos : end - start);
+				start = end == std::string::npos ? files.size() : end + 1;
+
+				llifstream file(filename, std::ios::binary);
+				file.read((char*)mBuffer, MAX_ANIM_SIZE);
+				LLUUID id = LLUUID::generateNewID();
+				TestKeyframeMotion loader(id);
+				if (file.gcount() > 0 && loader.load(avatars[0], mBuffer, (S32)file.gcount()))
+				{
+					anims.push_back(id);
+				}
+				else
+				{
+					llwarns << "Skipping unreadable animation " << filename << llendl;
+				}
+			}
+		}
+		if (anims.empty())
+		{
+			for (S32 i = 0; i < 8; i++)
+			{
+				LLUUID id = LLUUID::generateNewID();
+				TestKeyframeMotion loader(id);
+				S32 size = makeAnim(mBuffer, 30 + 5 * i, 2.f + 0.25f * i, (F32)i);
+				ensure("dance loads", loader.load(avatars[0], mBuffer, size));
+				anims.push_back(id);
+			}
+		}
+
+		for (S32 i = 0; i < num_avatars; i++)
+		{
+			const LLUUID& anim = anims[i % anims.size()];
+			avatars[i]->registerMotion(anim, LLKeyframeMotion::create);
+			ensure("motion starts", avatars[i]->startMotion(anim, 0.37f * i));
+		}
+
+		LLTimer timer;
+		for (S32 frame = 0; frame < num_frames; frame++)
+		{
+			for (S32 i = 0; i < num_avatars; i++)
+			{
+				avatars[i]->updateMotions(LLCharacter::FORCE_UPDATE);
+			}
+		}
+		F64 elapsed = timer.getElapsedTimeF64();
+		llinfos << num_avatars << " avatars, " << anims.size() << " animations, " << num_frames
+				<< " frames: " << elapsed * 1000.0 / num_frames << " ms per frame" << llendl;
+
+		for (S32 i = 0; i < num_avatars; i++)
+		{
+			ensure("motion still active", avatars[i]->isMotionActive(anims[i % anims.size()]));
+			ensure("joints animated", avatars[i]->getTestJoint(NUM_JOINTS - 1)->getRotation().isFinite());
+		}
+		for_each(avatars.begin(), avatars.end(), DeletePointer());
+	}
+
+	template<> template<>
+	void keyframemotion_object::test<4>()
+	{
+		set_test_name("concurrent crowd update");
+		const S32 num_avatars = 40;
+		std::vector<TestCharacter*> avatars;
+		for (S32 i = 0; i < num_avatars; i++)
+		{
+			avatars.push_back(new TestCharacter(LLUUID::generateNewID()));
+		}
+
+		std::vector<LLUUID> anims;
+		for (S32 i = 0; i < 4; i++)
+		{
+			LLUUID id = LLUUID::generateNewID();
+			TestKeyframeMotion loader(id);
+			S32 size = makeAnim(mBuffer, 20 + 5 * i, 1.5f + 0.5f * i, (F32)i);
+			ensure("dance loads", loader.load(avatars[0], mBuffer, size));
+			anims.push_back(id);
+		}
+		for (S32 i = 0; i < num_avatars; i++)
+		{
+			const LLUUID& anim = anims[i % anims.size()];
+			avatars[i]->registerMotion(anim, LLKeyframeMotion::create);
+			ensure("motion starts", avatars[i]->startMotion(anim, 0.29f * i));
+		}
+
+		LLJobPool pool("test animation", 3);
+		UpdateJob job(avatars);
+		for (S32 frame = 0; frame < 100; frame++)
+		{
+			pool.run(job, num_avatars);
+			for (S32 i = 0; i < num_avatars; i++)
+			{
+				avatars[i]->getMotionController().updateLoadingMotions();
+			}
+		}
+
+		for (S32 i = 0; i < num_avatars; i++)
+		{
+			ensure("motion still active", avatars[i]->isMotionActive(anims[i % anims.size()]));
+			LLJoint* joint = avatars[i]->getTestJoint(4);
+			ensure("joints animated", joint->getRotation().isFinite());
+			ensure("world matrix updated", joint->getWorldRotation().isFinite());
+		}
+		for_each(avatars.begin(), avatars.end(), DeletePointer());
+	}
+
+	template<> template<>
+	void keyframemotion_object::test<5>()
+	{
+		set_test_name("motion instances are reused across characters");
+		const S32 num_avatars = 50;
+		const LLUUID anim = LLUUID::generateNewID();
+		std::vector<TestCharacter*> avatars;
+		for (S32 i = 0; i < num_avatars; i++)
+		{
+			avatars.push_back(new TestCharacter(LLUUID::generateNewID()));
+			avatars[i]->registerMotion(anim, LLKeyframeMotion::create);
+		}
+		TestKeyframeMotion loader(anim);
+		S32 size = makeAnim(mBuffer, 20, 2.f, 0.f);
+		ensure("dance loads", loader.load(avatars[0], mBuffer, size));
+
+		sAllocations = 0;
+		sCountAllocations = true;
+		for (S32 i = 0; i < num_avatars; i++)
+		{
+			avatars[i]->startMotion(anim, 0.f);
+		}
+		sCountAllocations = false;
+		S32 first_allocations = sAllocations;
+
+		LLKeyframeMotion::JointMotionList* list = LLKeyframeDataCache::getKeyframeData(anim);
+		ensure_equals("joints bound", (S32)list->mJointIndices.size(), NUM_JOINTS);
+		for (S32 j = 0; j < NUM_JOINTS; j++)
+		{
+			ensure_equals("joint index", list->mJointIndices[j], j);
+		}
+
+		for (S32 frame = 0; frame < 10; frame++)
+		{
+			for (S32 i = 0; i < num_avatars; i++)
+			{
+				avatars[i]->updateMotions(LLCharacter::FORCE_UPDATE);
+			}
+		}
+		for_each(avatars.begin(), avatars.end(), DeletePointer());
+		avatars.clear();
+		ensure_equals("instances retired", LLMotionController::getNumRetiredMotions(), num_avatars);
+
+		// the same dance on a new crowd
+		for (S32 i = 0; i < num_avatars; i++)
+		{
+			avatars.push_back(new TestCharacter(LLUUID::generateNewID()));
+			avatars[i]->registerMotion(anim, LLKeyframeMotion::create);
+		}
+		sAllocations = 0;
+		sCountAllocations = true;
+		for (S32 i = 0; i < num_avatars; i++)
+		{
+			avatars[i]->startMotion(anim, 0.f);
+		}
+		sCountAllocations = false;
+		S32 second_allocations = sAllocations;
+		llinfos << "starting a dance on " << num_avatars << " avatars: " << first_allocations
+				<< " allocations, " << second_allocations << " with reused instances" << llendl;
+
+		ensure_equals("instances reused", LLMotionController::getNumRetiredMotions(), 0);
+		// only the controller's lists and the character's animation data are left
+		ensure("few allocations", second_allocations <= 8 * num_avatars);
+		ensure("fewer allocations", second_allocations * 4 < first_allocations);
+
+		for (S32 frame = 0; frame < 10; frame++)
+		{
+			for (S32 i = 0; i < num_avatars; i++)
+			{
+				avatars[i]->updateMotions(LLCharacter::FORCE_UPDATE);
+			}
+		}
+		for (S32 i = 0; i < num_avatars; i++)
+		{
+			ensure("motion active", avatars[i]->isMotionActive(anim));
+			LLMotion* motion = avatars[i]->findMotion(anim);
+			ensure("pose bound", motion->getPose()->findJointState(avatars[i]->getTestJoint(4)) != NULL);
+			ensure("joints animated", avatars[i]->getTestJoint(4)->getRotation() != LLQuaternion::DEFAULT);
+		}
+		for_each(avatars.begin(), avatars.end(), DeletePointer());
+	}
+}
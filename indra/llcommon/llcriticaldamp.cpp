@@ -34,6 +34,7 @@
 LLFrameTimer LLCriticalDamp::sInternalTimer;
 std::map<F32, F32> LLCriticalDamp::sInterpolants;
 F32 LLCriticalDamp::sTimeDelta;
+BOOL LLCriticalDamp::sCacheLocked = FALSE;
 
 //-----------------------------------------------------------------------------
 // LLCriticalDamp()
@@ -73,14 +74,18 @@ F32 LLCriticalDamp::getInterpolant(const F32 time_constant, BOOL use_cache)
 		return 1.f;
 	}
 
-	if (use_cache && sInterpolants.count(time_constant))
+	if (use_cache)
 	{
-		return sInterpolants[time_constant];
+		std::map<F32, F32>::const_iterator iter = sInterpolants.find(time_constant);
+		if (iter != sInterpolants.end())
+		{
+			return iter->second;
+		}
 	}
 	
 	F32 interpolant = 1.f - pow(2.f, -sTimeDelta / time_constant);
 	interpolant = llclamp(interpolant, 0.f, 1.f);
-	if (use_cache)
+	if (use_cache && !sCacheLocked)
 	{
 		sInterpolants[time_constant] = interpolant;
 	}
@@ -40,6 +40,11 @@ public:
 	// MANIPULATORS
 	static void updateInterpolants();
 
+	// While the cache is locked, getInterpolant() only reads it, which makes
+	// it safe to call from several threads. Time constants which are not yet
+	// cached are computed on the spot instead of being added.
+	static void lockCache(BOOL locked) { sCacheLocked = locked; }
+
 	// ACCESSORS
 	static F32 getInterpolant(const F32 time_constant, BOOL use_cache = TRUE);
 
@@ -48,6 +53,7 @@ protected:
 
 	static std::map<F32, F32> 	sInterpolants;
 	static F32					sTimeDelta;
+	static BOOL					sCacheLocked;
 };
 
 #endif  // LL_LLCRITICALDAMP_H
@@ -0,0 +1,262 @@
+/** 
+ * @file llflathashmap.h
+ * @brief An open addressed hash map for small keys looked up on hot paths.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLFLATHASHMAP_H
+#define LL_LLFLATHASHMAP_H
+
+#include <vector>
+
+#include "stdtypes.h"
+#include "lluuid.h"
+
+//
+// LLFlatHash
+//
+// Hash functors for LLFlatHashMap.  The map masks off the low bits of
+// the hash, so every key bit has to reach them.
+//
+template <class KEY>
+struct LLFlatHash;
+
+template <>
+struct LLFlatHash<U64>
+{
+	U32 operator()(U64 key) const
+	{
+		// 64 bit finalizer from MurmurHash3
+		key ^= key >> 33;
+		key *= 0xff51afd7ed558ccdULL;
+		key ^= key >> 33;
+		key *= 0xc4ceb9fe1a85ec53ULL;
+		key ^= key >> 33;
+		return (U32)key;
+	}
+};
+
+template <>
+struct LLFlatHash<U32>
+{
+	U32 operator()(U32 key) const
+	{
+		return LLFlatHash<U64>()(key);
+	}
+};
+
+template <>
+struct LLFlatHash<LLUUID>
+{
+	U32 operator()(const LLUUID& id) const
+	{
+		return LLFlatHash<U64>()(id.getCRC32());
+	}
+};
+
+//
+// LLFlatHashMap
+//
+// Maps keys to values in a single array of slots, probing linearly from
+// the slot the key hashes to.  Lookups touch one or two cache lines
+// instead of walking a tree of nodes, which is what std::map costs us
+// for tables searched on every object update.  The table doubles once
+// it is three quarters full, and erase shifts the rest of the probe run
+// back so no tombstones are left behind.
+//
+// KEY and VALUE must be default constructible and copyable.  Pointers
+// returned by find() and references returned by operator[] are only
+// good until the next insertion or erase.
+//
+template <class KEY, class VALUE, class HASH = LLFlatHash<KEY> >
+class LLFlatHashMap
+{
+public:
+	LLFlatHashMap();
+
+	// Returns the value for key, or NULL if there is none.
+	VALUE* find(const KEY& key);
+	const VALUE* find(const KEY& key) const;
+
+	// Returns the value for key, inserting a default one if there is none.
+	VALUE& operator[](const KEY& key);
+
+	// Returns true if key was in the map.
+	bool erase(const KEY& key);
+
+	void clear();
+
+	U32 size() const	{ return mSize; }
+	bool empty() const	{ return mSize == 0; }
+
+private:
+	struct Slot
+	{
+		Slot() : mUsed(false) {}
+
+		KEY mKey;
+		VALUE mValue;
+		bool mUsed;
+	};
+
+	// Returns the slot holding key, or -1.
+	S32 findSlot(const KEY& key) const;
+	void rehash(U32 capacity);
+
+private:
+	std::vector<Slot> mSlots;
+	U32 mMask;
+	U32 mSize;
+	HASH mHash;
+};
+
+const U32 LL_FLAT_HASH_MAP_MIN_CAPACITY = 16;
+
+//
+// LLFlatHashMap implementation
+//
+template <class KEY, class VALUE, class HASH>
+LLFlatHashMap<KEY, VALUE, HASH>::LLFlatHashMap()
+:	mMask(0),
+	mSize(0)
+{
+}
+
+template <class KEY, class VALUE, class HASH>
+S32 LLFlatHashMap<KEY, VALUE, HASH>::findSlot(const KEY& key) const
+{
+	if (mSlots.empty())
+	{
+		return -1;
+	}
+	U32 i = mHash(key) & mMask;
+	while (mSlots[i].mUsed)
+	{
+		if (mSlots[i].mKey == key)
+		{
+			return (S32)i;
+		}
+		i = (i + 1) & mMask;
+	}
+	return -1;
+}
+
+template <class KEY, class VALUE, class HASH>
+VALUE* LLFlatHashMap<KEY, VALUE, HASH>::find(const KEY& key)
+{
+	S32 i = findSlot(key);
+	return i < 0 ? NULL : &mSlots[i].mValue;
+}
+
+template <class KEY, class VALUE, class HASH>
+const VALUE* LLFlatHashMap<KEY, VALUE, HASH>::find(const KEY& key) const
+{
+	S32 i = findSlot(key);
+	return i < 0 ? NULL : &mSlots[i].mValue;
+}
+
+template <class KEY, class VALUE, class HASH>
+VALUE& LLFlatHashMap<KEY, VALUE, HASH>::operator[](const KEY& key)
+{
+	S32 found = findSlot(key);
+	if (found >= 0)
+	{
+		return mSlots[found].mValue;
+	}
+
+	if ((mSize + 1) * 4 > (U32)mSlots.size() * 3)
+	{
+		rehash(mSlots.empty() ? LL_FLAT_HASH_MAP_MIN_CAPACITY : (U32)mSlots.size() * 2);
+	}
+
+	U32 i = mHash(key) & mMask;
+	while (mSlots[i].mUsed)
+	{
+		i = (i + 1) & mMask;
+	}
+	mSlots[i].mKey = key;
+	mSlots[i].mUsed = true;
+	++mSize;
+	return mSlots[i].mValue;
+}
+
+template <class KEY, class VALUE, class HASH>
+bool LLFlatHashMap<KEY, VALUE, HASH>::erase(const KEY& key)
+{
+	S32 found = findSlot(key);
+	if (found < 0)
+	{
+		return false;
+	}
+
+	// Walk the rest of the probe run, moving back into the hole any
+	// entry whose home slot does not lie between the hole and itself.
+	U32 hole = (U32)found;
+	U32 i = (hole + 1) & mMask;
+	while (mSlots[i].mUsed)
+	{
+		U32 home = mHash(mSlots[i].mKey) & mMask;
+		if (((i - home) & mMask) >= ((i - hole) & mMask))
+		{
+			mSlots[hole] = mSlots[i];
+			hole = i;
+		}
+		i = (i + 1) & mMask;
+	}
+
+	// Release whatever the value holds on to
+	mSlots[hole] = Slot();
+	--mSize;
+	return true;
+}
+
+template <class KEY, class VALUE, class HASH>
+void LLFlatHashMap<KEY, VALUE, HASH>::clear()
+{
+	mSlots.clear();
+	mMask = 0;
+	mSize = 0;
+}
+
+template <class KEY, class VALUE, class HASH>
+void LLFlatHashMap<KEY, VALUE, HASH>::rehash(U32 capacity)
+{
+	std::vector<Slot> old_slots(capacity);
+	mSlots.swap(old_slots);
+	mMask = capacity - 1;
+	for (typename std::vector<Slot>::iterator iter = old_slots.begin();
+		 iter != old_slots.end(); ++iter)
+	{
+		if (iter->mUsed)
+		{
+			U32 i = mHash(iter->mKey) & mMask;
+			while (mSlots[i].mUsed)
+			{
+				i = (i + 1) & mMask;
+			}
+			mSlots[i] = *iter;
+		}
+	}
+}
+
+#endif // LL_LLFLATHASHMAP_H
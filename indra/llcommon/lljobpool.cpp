@@ -0,0 +1,166 @@
+/** 
+ * @file lljobpool.cpp
+ * @brief A small fork-join pool for running independent jobs across threads.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ * 
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ * 
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ * 
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "lljobpool.h"
+
+#include "llformat.h"
+
+LLJobPool::Worker::Worker(const std::string& name, LLJobPool* pool) :
+	LLThread(name),
+	mPool(pool)
+{
+}
+
+//virtual
+void LLJobPool::Worker::run()
+{
+	mPool->workerLoop();
+}
+
+LLJobPool::LLJobPool(const std::string& name, S32 num_threads) :
+	mJob(NULL),
+	mCount(0),
+	mBatch(0),
+	mBusy(0),
+	mQuitting(false),
+	mNext(0)
+{
+	mCondition = new LLCondition(NULL);
+
+	for (S32 i = 0; i < num_threads; ++i)
+	{
+		Worker* worker = new Worker(llformat("%s %d", name.c_str(), i), this);
+		mWorkers.push_back(worker);
+		worker->start();
+	}
+}
+
+LLJobPool::~LLJobPool()
+{
+	mCondition->lock();
+	mQuitting = true;
+	mCondition->broadcast();
+	mCondition->unlock();
+
+	for (std::vector<Worker*>::iterator iter = mWorkers.begin();
+		 iter != mWorkers.end(); ++iter)
+	{
+		// shutdown() polls for the thread to reach STOPPED, which it
+		// does as soon as it sees mQuitting.
+		(*iter)->shutdown();
+		delete *iter;
+	}
+	mWorkers.clear();
+
+	delete mCondition;
+	mCondition = NULL;
+}
+
+void LLJobPool::run(Job& job, S32 count)
+{
+	if (count <= 0)
+	{
+		return;
+	}
+
+	if (mWorkers.empty() || count == 1)
+	{
+		for (S32 i = 0; i < count; ++i)
+		{
+			job.run(i);
+		}
+		return;
+	}
+
+	mCondition->lock();
+	mJob = &job;
+	mCount = count;
+	mNext = 0;
+	++mBatch;
+	mCondition->broadcast();
+	mCondition->unlock();
+
+	work(&job, count);
+
+	// Every index has been claimed once we get here, but workers may
+	// still be running theirs. Clearing mJob stops a worker which only
+	// now wakes up from picking up a batch which is already done.
+	mCondition->lock();
+	while (mBusy > 0)
+	{
+		mCondition->wait();
+	}
+	mJob = NULL;
+	mCondition->unlock();
+}
+
+void LLJobPool::work(Job* job, S32 count)
+{
+	while (true)
+	{
+		S32 index = mNext++;
+		if (index >= count)
+		{
+			break;
+		}
+		job->run(index);
+	}
+}
+
+void LLJobPool::workerLoop()
+{
+	U32 last_batch = 0;
+
+	mCondition->lock();
+	while (true)
+	{
+		while (!mQuitting && (!mJob || mBatch == last_batch))
+		{
+			mCondition->wait();
+		}
+		if (mQuitting)
+		{
+			break;
+		}
+
+		last_batch = mBatch;
+		Job* job = mJob;
+		S32 count = mCount;
+		++mBusy;
+		mCondition->unlock();
+
+		work(job, count);
+
+		mCondition->lock();
+		if (--mBusy == 0)
+		{
+			mCondition->broadcast();
+		}
+	}
+	mCondition->unlock();
+}
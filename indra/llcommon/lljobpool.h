@@ -0,0 +1,119 @@
+/** 
+ * @file lljobpool.h
+ * @brief A small fork-join pool for running independent jobs across threads.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ * 
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ * 
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ * 
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLJOBPOOL_H
+#define LL_LLJOBPOOL_H
+
+#include <vector>
+
+#include "llthread.h"
+
+/** 
+ * @class LLJobPool
+ * @brief Runs a batch of independent work items on a set of threads.
+ *
+ * The caller hands <code>run()</code> a job and a count, and the
+ * job's <code>run(index)</code> is called once for every index in
+ * [0, count) by whichever thread claims it first. The calling thread
+ * takes part in the batch, and <code>run()</code> does not return
+ * until every index has finished, so jobs may safely refer to data
+ * on the caller's stack.
+ *
+ * Jobs run concurrently and must only touch state owned by their own
+ * index. In particular they must not use LLFastTimer or LLMemType,
+ * neither of which is thread safe.
+ */
+class LL_COMMON_API LLJobPool
+{
+public:
+	class LL_COMMON_API Job
+	{
+	public:
+		virtual ~Job() {}
+
+		// Called once for each index in the batch, from any thread.
+		virtual void run(S32 index) = 0;
+	};
+
+	/**
+	 * @brief Constructor. Starts the worker threads.
+	 *
+	 * @param name The name used for the worker threads.
+	 * @param num_threads The number of threads to start in addition
+	 * to the calling thread. Zero runs every job on the caller.
+	 */
+	LLJobPool(const std::string& name, S32 num_threads);
+
+	/**
+	 * @brief Destructor. Stops and deletes the worker threads.
+	 */
+	~LLJobPool();
+
+	/**
+	 * @brief Runs job for every index in [0, count) and waits for
+	 * them all to finish. Only one thread may call this at a time.
+	 */
+	void run(Job& job, S32 count);
+
+	S32 getNumThreads() const { return (S32)mWorkers.size(); }
+
+private:
+	class Worker : public LLThread
+	{
+	public:
+		Worker(const std::string& name, LLJobPool* pool);
+
+	protected:
+		/*virtual*/ void run();
+
+	private:
+		LLJobPool* mPool;
+	};
+	friend class Worker;
+
+	// Claims and runs indices of job until the batch is exhausted.
+	void work(Job* job, S32 count);
+
+	// Worker thread main loop.
+	void workerLoop();
+
+private:
+	// Guards the batch description below and wakes both the workers
+	// and the caller waiting for them.
+	LLCondition* mCondition;
+	Job* mJob;
+	S32 mCount;
+	U32 mBatch;
+	S32 mBusy;
+	bool mQuitting;
+
+	// Next index to hand out, claimed without the lock.
+	LLAtomicS32 mNext;
+
+	std::vector<Worker*> mWorkers;
+};
+
+#endif // LL_LLJOBPOOL_H
@@ -0,0 +1,146 @@
+/** 
+ * @file llmappedfile.cpp
+ * @brief Read only memory mapped files.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#if LL_WINDOWS
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "linden_common.h"
+#include "llmappedfile.h"
+#include "llstring.h"
+
+LLMappedFile::LLMappedFile()
+:	mData(NULL),
+	mSize(0)
+{
+}
+
+LLMappedFile::~LLMappedFile()
+{
+	close();
+}
+
+#if LL_WINDOWS
+
+bool LLMappedFile::open(const std::string& filename)
+{
+	close();
+
+	llutf16string utf16filename = utf8str_to_utf16str(filename);
+	HANDLE file = CreateFileW(utf16filename.c_str(), GENERIC_READ,
+							  FILE_SHARE_READ | FILE_SHARE_DELETE, NULL,
+							  OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size) || size.QuadPart <= 0 || size.HighPart != 0)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	HANDLE mapping = CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	CloseHandle(file);
+	if (!mapping)
+	{
+		return false;
+	}
+
+	// the view keeps the mapping object alive
+	void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	CloseHandle(mapping);
+	if (!data)
+	{
+		return false;
+	}
+
+	mData = (const U8*)data;
+	mSize = (size_t)size.LowPart;
+	return true;
+}
+
+void LLMappedFile::close()
+{
+	if (mData)
+	{
+		UnmapViewOfFile(mData);
+		mData = NULL;
+		mSize = 0;
+	}
+}
+
+#else // LL_WINDOWS
+
+bool LLMappedFile::open(const std::string& filename)
+{
+	close();
+
+	int fd = ::open(filename.c_str(), O_RDONLY);
+	if (fd < 0)
+	{
+		return false;
+	}
+
+	struct stat file_stat;
+	if (fstat(fd, &file_stat) != 0 || file_stat.st_size <= 0)
+	{
+		::close(fd);
+		return false;
+	}
+
+	// the mapping holds its own reference to the file
+	size_t size = (size_t)file_stat.st_size;
+	void* data = ::mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+	if (data == MAP_FAILED)
+	{
+		return false;
+	}
+
+	mData = (const U8*)data;
+	mSize = size;
+	return true;
+}
+
+void LLMappedFile::close()
+{
+	if (mData)
+	{
+		::munmap((void*)mData, mSize);
+		mData = NULL;
+		mSize = 0;
+	}
+}
+
+#endif // LL_WINDOWS
@@ -0,0 +1,70 @@
+/** 
+ * @file llmappedfile.h
+ * @brief Read only memory mapped files.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLMAPPEDFILE_H
+#define LL_LLMAPPEDFILE_H
+
+#include <string>
+
+#include <boost/noncopyable.hpp>
+
+/** 
+ * @class LLMappedFile
+ * @brief Maps a whole file into memory for reading.
+ *
+ * Pages are only read from disk when they are first touched, so a
+ * caller that follows an index in the file to the records it needs
+ * never reads the rest. The file itself is closed once mapped; the
+ * mapping stays valid until <code>close()</code> or destruction.
+ *
+ * On Windows a mapped file can't be replaced or deleted, so close
+ * the mapping before renaming another file over it.
+ */
+class LL_COMMON_API LLMappedFile : private boost::noncopyable
+{
+public:
+	LLMappedFile();
+	~LLMappedFile();
+
+	/**
+	 * @brief Maps filename, closing any previous mapping first.
+	 *
+	 * @return Returns false if the file can't be opened or mapped, or
+	 * is empty.
+	 */
+	bool open(const std::string& filename);
+	void close();
+
+	bool isOpen() const				{ return mData != NULL; }
+	const U8* getData() const		{ return mData; }
+	size_t getSize() const			{ return mSize; }
+
+private:
+	const U8* mData;
+	size_t mSize;
+};
+
+#endif // LL_LLMAPPEDFILE_H
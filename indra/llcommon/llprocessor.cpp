@@ -132,7 +132,10 @@ namespace
 		eMONTIOR_MWAIT=33,
 		eCPLDebugStore=34,
 		eThermalMonitor2=35,
-		eAltivec=36
+		eAltivec=36,
+		eAVX_Features=37,
+		eFMA3_Features=38,
+		eAVX2_Features=39
 	};
 
 	const char* cpu_feature_names[] =
@@ -175,7 +178,11 @@ namespace
 		"CPL Qualified Debug Store",
 		"Thermal Monitor 2",
 
-		"Altivec"
+		"Altivec",
+
+		"AVX Instructions", // 37, only set when the OS saves the YMM registers
+		"FMA3 Instructions",
+		"AVX2 Instructions"
 	};
 
 	std::string intel_CPUFamilyName(int composed_family) 
@@ -275,6 +282,13 @@ public:
 		return hasExtension("Altivec"); 
 	}
 
+	bool hasAVX2() const
+	{
+		return hasExtension(cpu_feature_names[eAVX_Features])
+			&& hasExtension(cpu_feature_names[eFMA3_Features])
+			&& hasExtension(cpu_feature_names[eAVX2_Features]);
+	}
+
 	std::string getCPUFamilyName() const { return getInfo(eFamilyName, "Unknown").asString(); }
 	std::string getCPUBrandName() const { return getInfo(eBrandName, "Unknown").asString(); }
 
@@ -536,6 +550,19 @@ private:
 				{
 					setExtension(cpu_feature_names[eThermalMonitor2]);
 				}
+
+#if _MSC_VER >= 1600
+				// AVX also needs the OS to save the YMM registers (OSXSAVE + XCR0)
+				if((cpu_info[2] & 0x18000000) == 0x18000000
+					&& (_xgetbv(0) & 0x6) == 0x6)
+				{
+					setExtension(cpu_feature_names[eAVX_Features]);
+					if(cpu_info[2] & 0x1000)
+					{
+						setExtension(cpu_feature_names[eFMA3_Features]);
+					}
+				}
+#endif
 						
 				unsigned int feature_info = (unsigned int) cpu_info[3];
 				for(unsigned int index = 0, bit = 1; index < eSSE3_Features; ++index, bit <<= 1)
@@ -546,6 +573,17 @@ private:
 					}
 				}
 			}
+#if _MSC_VER >= 1600
+			else if (i == 7)
+			{
+				// structured extended features, sub-leaf 0
+				__cpuidex(cpu_info, 7, 0);
+				if(cpu_info[1] & 0x20)
+				{
+					setExtension(cpu_feature_names[eAVX2_Features]);
+				}
+			}
+#endif
 		}
 
 		// Calling __cpuid with 0x80000000 as the InfoType argument
@@ -632,6 +670,16 @@ private:
 		return result == -1 ? 0 : value;
    	}
 	
+	std::string getSysctlString(const char* name)
+	{
+		char value[0x400];
+		size_t len = sizeof(value);
+		memset(value, 0, len);
+		int error = sysctlbyname(name, (void*)value, &len, NULL, 0);
+		value[sizeof(value) - 1] = 0;
+		return error == -1 ? std::string() : std::string(value);
+	}
+
 	void getCPUIDInfo()
 	{
 		size_t len = 0;
@@ -710,6 +758,22 @@ private:
 		uint64_t ext_feature_info = getSysctlInt64("machdep.cpu.extfeature_bits");
 		S32 *ext_feature_infos = (S32*)(&ext_feature_info);
 		setConfig(eExtFeatureBits, ext_feature_infos[0]);
+
+		// the kernel only lists AVX when it saves the YMM registers
+		std::string features = " " + getSysctlString("machdep.cpu.features") + " "
+			+ getSysctlString("machdep.cpu.leaf7_features") + " ";
+		if (features.find(" AVX1.0 ") != std::string::npos)
+		{
+			setExtension(cpu_feature_names[eAVX_Features]);
+		}
+		if (features.find(" FMA ") != std::string::npos)
+		{
+			setExtension(cpu_feature_names[eFMA3_Features]);
+		}
+		if (features.find(" AVX2 ") != std::string::npos)
+		{
+			setExtension(cpu_feature_names[eAVX2_Features]);
+		}
 	}
 };
 
@@ -733,9 +797,12 @@ private:
 		LLFILE* cpuinfo_fp = LLFile::fopen(CPUINFO_FILE, "rb");
 		if(cpuinfo_fp)
 		{
-			char line[MAX_STRING];
-			memset(line, 0, MAX_STRING);
-			while(fgets(line, MAX_STRING, cpuinfo_fp))
+			// the flags line runs past MAX_STRING on current CPUs, and the
+			// AVX flags come late in it
+			const S32 MAX_CPUINFO_LINE = 4096;
+			char line[MAX_CPUINFO_LINE];
+			memset(line, 0, MAX_CPUINFO_LINE);
+			while(fgets(line, MAX_CPUINFO_LINE, cpuinfo_fp))
 			{
 				// /proc/cpuinfo on Linux looks like:
 				// name\t*: value\n
@@ -820,6 +887,22 @@ private:
 		{
 			setExtension(cpu_feature_names[eSSE2_Ext]);
 		}
+
+		// the kernel only lists avx when it saves the YMM registers
+		if( flags.find( " avx " ) != std::string::npos )
+		{
+			setExtension(cpu_feature_names[eAVX_Features]);
+		}
+
+		if( flags.find( " fma " ) != std::string::npos )
+		{
+			setExtension(cpu_feature_names[eFMA3_Features]);
+		}
+
+		if( flags.find( " avx2 " ) != std::string::npos )
+		{
+			setExtension(cpu_feature_names[eAVX2_Features]);
+		}
 	
 # endif // LL_X86
 	}
@@ -881,6 +964,7 @@ F64 LLProcessorInfo::getCPUFrequency() const { return mImpl->getCPUFrequency();
 bool LLProcessorInfo::hasSSE() const { return mImpl->hasSSE(); }
 bool LLProcessorInfo::hasSSE2() const { return mImpl->hasSSE2(); }
 bool LLProcessorInfo::hasAltivec() const { return mImpl->hasAltivec(); }
+bool LLProcessorInfo::hasAVX2() const { return mImpl->hasAVX2(); }
 std::string LLProcessorInfo::getCPUFamilyName() const { return mImpl->getCPUFamilyName(); }
 std::string LLProcessorInfo::getCPUBrandName() const { return mImpl->getCPUBrandName(); }
 std::string LLProcessorInfo::getCPUFeatureDescription() const { return mImpl->getCPUFeatureDescription(); }
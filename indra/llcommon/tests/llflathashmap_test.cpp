@@ -0,0 +1,264 @@
+/** 
+ * @file llflathashmap_test.cpp
+ * @brief Tests for LLFlatHashMap.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include <cstdlib>
+#include <map>
+#include <vector>
+
+#include "linden_common.h"
+#include "lltimer.h"
+
+#include "../llflathashmap.h"
+
+#include "../test/lltut.h"
+
+namespace
+{
+	U32 nextRandom(U32& seed)
+	{
+		seed = seed * 1664525 + 1013904223;
+		return seed;
+	}
+
+	// Keys laid out like the viewer's (region index, local id) pairs
+	U64 makeKey(U32 region_index, U32 local_id)
+	{
+		return ((U64)region_index << 32) | local_id;
+	}
+}
+
+namespace tut
+{
+	struct flathashmap_data
+	{
+	};
+	typedef test_group<flathashmap_data> flathashmap_test;
+	typedef flathashmap_test::object flathashmap_object;
+	tut::flathashmap_test flathashmap_testcase("LLFlatHashMap");
+
+	template<> template<>
+	void flathashmap_object::test<1>()
+	{
+		LLFlatHashMap<U64, U32> map;
+		ensure("starts empty", map.empty());
+		ensure("nothing found", map.find(42) == NULL);
+		ensure("nothing erased", !map.erase(42));
+
+		map[42] = 7;
+		ensure_equals("size", map.size(), 1U);
+		ensure("found", map.find(42) != NULL);
+		ensure_equals("value", *map.find(42), 7U);
+
+		map[42] = 8;
+		ensure_equals("replaced in place", map.size(), 1U);
+		ensure_equals("new value", *map.find(42), 8U);
+
+		// operator[] inserts a default value, as std::map does
+		ensure_equals("default value", map[43], 0U);
+		ensure_equals("inserted", map.size(), 2U);
+
+		ensure("erased", map.erase(42));
+		ensure("gone", map.find(42) == NULL);
+		ensure("other kept", map.find(43) != NULL);
+		ensure_equals("size after erase", map.size(), 1U);
+
+		map.clear();
+		ensure("cleared", map.empty());
+		ensure("nothing after clear", map.find(43) == NULL);
+	}
+
+	template<> template<>
+	void flathashmap_object::test<2>()
+	{
+		// Random inserts and erases, checked against std::map as the
+		// table grows and erases shift probe runs about.
+		LLFlatHashMap<U64, U32> map;
+		std::map<U64, U32> reference;
+		U32 seed = 1;
+		for (S32 i = 0; i < 200000; ++i)
+		{
+			// few enough keys that erases hit and probe runs collide
+			U64 key = makeKey(nextRandom(seed) % 4, nextRandom(seed) % 5000);
+			U32 op = nextRandom(seed) % 3;
+			if (op == 0)
+			{
+				ensure_equals("erase", map.erase(key), reference.erase(key) > 0);
+			}
+			else if (op == 1)
+			{
+				U32 value = nextRandom(seed);
+				map[key] = value;
+				reference[key] = value;
+			}
+			else
+			{
+				std::map<U64, U32>::iterator iter = reference.find(key);
+				U32* found = map.find(key);
+				ensure_equals("found", found != NULL, iter != reference.end());
+				if (found)
+				{
+					ensure_equals("value", *found, iter->second);
+				}
+			}
+		}
+
+		ensure_equals("size", map.size(), (U32)reference.size());
+		for (std::map<U64, U32>::iterator iter = reference.begin(); iter != reference.end(); ++iter)
+		{
+			U32* found = map.find(iter->first);
+			ensure("all found", found != NULL);
+			ensure_equals("all values", *found, iter->second);
+		}
+	}
+
+	template<> template<>
+	void flathashmap_object::test<3>()
+	{
+		LLFlatHashMap<LLUUID, S32> map;
+		std::vector<LLUUID> ids(1000);
+		for (S32 i = 0; i < (S32)ids.size(); ++i)
+		{
+			ids[i].generate();
+			map[ids[i]] = i;
+		}
+		ensure_equals("size", map.size(), (U32)ids.size());
+		ensure("null not found", map.find(LLUUID::null) == NULL);
+
+		for (S32 i = 0; i < (S32)ids.size(); i += 2)
+		{
+			ensure("erased", map.erase(ids[i]));
+		}
+		for (S32 i = 0; i < (S32)ids.size(); ++i)
+		{
+			const S32* found = map.find(ids[i]);
+			if (i % 2)
+			{
+				ensure("odd kept", found != NULL);
+				ensure_equals("odd value", *found, i);
+			}
+			else
+			{
+				ensure("even erased", found == NULL);
+			}
+		}
+	}
+
+	template<> template<>
+	void flathashmap_object::test<4>()
+	{
+		if (!getenv("LL_RUN_BENCHMARKS"))
+		{
+			skip("benchmark, set LL_RUN_BENCHMARKS to run it");
+		}
+		// The lookups an object update makes in LLViewerObjectList, from
+		// (region index, local id) to the full id and from the full id
+		// to the object, with std::map against LLFlatHashMap.
+		// LL_FLATHASHMAP_BENCH_OBJECTS and LL_FLATHASHMAP_BENCH_LOOKUPS
+		// scale the run.
+		S32 num_objects = 50000;
+		S32 num_lookups = 2000000;
+		if (const char* env = getenv("LL_FLATHASHMAP_BENCH_OBJECTS"))
+		{
+			num_objects = llmax(1, atoi(env));
+		}
+		if (const char* env = getenv("LL_FLATHASHMAP_BENCH_LOOKUPS"))
+		{
+			num_lookups = llmax(1, atoi(env));
+		}
+
+		std::map<U64, LLUUID> tree_local;
+		std::map<LLUUID, S32> tree_objects;
+		LLFlatHashMap<U64, LLUUID> flat_local;
+		LLFlatHashMap<LLUUID, S32> flat_objects;
+		std::vector<U64> keys(num_objects);
+		U32 seed = 54321;
+		for (S32 i = 0; i < num_objects; ++i)
+		{
+			// spread over a handful of regions, local ids counting up
+			keys[i] = makeKey(i % 9, 1000 + i * 3 + nextRandom(seed) % 3);
+			LLUUID id;
+			id.generate();
+			tree_local[keys[i]] = id;
+			tree_objects[id] = i;
+			flat_local[keys[i]] = id;
+			flat_objects[id] = i;
+		}
+
+		// updates arrive in no particular order, an eighth of them for
+		// objects the viewer has not seen yet
+		std::vector<U64> updates(num_lookups);
+		for (S32 i = 0; i < num_lookups; ++i)
+		{
+			U32 r = nextRandom(seed);
+			if (r % 8 == 0)
+			{
+				updates[i] = makeKey(r % 9, 0x40000000 + r % 100000);
+			}
+			else
+			{
+				updates[i] = keys[nextRandom(seed) % num_objects];
+			}
+		}
+
+		S64 tree_sum = 0;
+		LLTimer timer;
+		for (S32 i = 0; i < num_lookups; ++i)
+		{
+			std::map<U64, LLUUID>::iterator local = tree_local.find(updates[i]);
+			if (local != tree_local.end())
+			{
+				std::map<LLUUID, S32>::iterator object = tree_objects.find(local->second);
+				if (object != tree_objects.end())
+				{
+					tree_sum += object->second;
+				}
+			}
+		}
+		F64 tree_elapsed = timer.getElapsedTimeF64();
+
+		S64 flat_sum = 0;
+		timer.reset();
+		for (S32 i = 0; i < num_lookups; ++i)
+		{
+			const LLUUID* id = flat_local.find(updates[i]);
+			if (id)
+			{
+				const S32* object = flat_objects.find(*id);
+				if (object)
+				{
+					flat_sum += *object;
+				}
+			}
+		}
+		F64 flat_elapsed = timer.getElapsedTimeF64();
+
+		llinfos << num_objects << " objects, " << num_lookups << " updates: "
+				<< tree_elapsed * 1.0e9 / num_lookups << " ns per update with std::map, "
+				<< flat_elapsed * 1.0e9 / num_lookups << " ns with LLFlatHashMap" << llendl;
+
+		ensure_equals("same objects", flat_sum, tree_sum);
+	}
+}
@@ -0,0 +1,123 @@
+/** 
+ * @file lljobpool_test.cpp
+ * @brief Tests for LLJobPool.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ * 
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ * 
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ * 
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "../lljobpool.h"
+
+#include <vector>
+
+#include "../test/lltut.h"
+
+namespace
+{
+	// Counts how many times each index was run. Each index only
+	// touches its own slot, as jobs are required to.
+	class CountJob : public LLJobPool::Job
+	{
+	public:
+		CountJob(S32 count) : mRuns(count, 0), mHashes(count, 0) {}
+
+		/*virtual*/ void run(S32 index)
+		{
+			// A little work so the batch is actually shared out.
+			U32 hash = (U32)index;
+			for (S32 i = 0; i < 200; ++i)
+			{
+				hash = hash * 1664525 + 1013904223;
+			}
+			mHashes[index] = hash;
+			mRuns[index]++;
+		}
+
+		std::vector<S32> mRuns;
+		std::vector<U32> mHashes;
+	};
+}
+
+namespace tut
+{
+	struct jobpool_data
+	{
+	};
+	typedef test_group<jobpool_data> jobpool_test;
+	typedef jobpool_test::object jobpool_object;
+	tut::jobpool_test jobpool_testcase("LLJobPool");
+
+	template<> template<>
+	void jobpool_object::test<1>()
+	{
+		// Without workers every job runs on the caller.
+		LLJobPool pool("test pool", 0);
+		ensure_equals("no threads", pool.getNumThreads(), 0);
+
+		CountJob job(10);
+		pool.run(job, 10);
+		for (S32 i = 0; i < 10; ++i)
+		{
+			ensure_equals("inline run count", job.mRuns[i], 1);
+		}
+
+		// Empty batches are a no-op.
+		pool.run(job, 0);
+		ensure_equals("empty batch", job.mRuns[0], 1);
+	}
+
+	template<> template<>
+	void jobpool_object::test<2>()
+	{
+		// Every index runs exactly once, and run() only returns once
+		// they have all finished.
+		LLJobPool pool("test pool", 3);
+		ensure_equals("thread count", pool.getNumThreads(), 3);
+
+		CountJob job(5000);
+		pool.run(job, 5000);
+		for (S32 i = 0; i < 5000; ++i)
+		{
+			ensure_equals("threaded run count", job.mRuns[i], 1);
+		}
+	}
+
+	template<> template<>
+	void jobpool_object::test<3>()
+	{
+		// Lots of small back to back batches, each with a job which
+		// goes out of scope as soon as run() returns. A worker that
+		// wakes up late must not run indices of a finished batch.
+		LLJobPool pool("test pool", 4);
+		for (S32 batch = 0; batch < 2000; ++batch)
+		{
+			S32 count = 1 + batch % 7;
+			CountJob job(count);
+			pool.run(job, count);
+			for (S32 i = 0; i < count; ++i)
+			{
+				ensure_equals("batch run count", job.mRuns[i], 1);
+			}
+		}
+	}
+}
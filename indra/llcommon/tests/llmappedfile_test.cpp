@@ -0,0 +1,275 @@
+/** 
+ * @file llmappedfile_test.cpp
+ * @brief Tests for LLMappedFile.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include <algorithm>
+#include <cstdlib>
+#include <map>
+#include <vector>
+
+#include "linden_common.h"
+#include "llfile.h"
+#include "lltimer.h"
+
+#include "../llmappedfile.h"
+
+#include "../test/lltut.h"
+
+namespace
+{
+	// Laid out like an object cache index record
+	struct Record
+	{
+		U32 mLocalID;
+		U32 mCRC;
+		S32 mHitCount;
+		S32 mDupeCount;
+		S32 mCRCChangeCount;
+		U32 mOffset;
+		S32 mSize;
+	};
+
+	struct record_less
+	{
+		bool operator()(const Record& lhs, U32 local_id) const
+		{
+			return lhs.mLocalID < local_id;
+		}
+	};
+
+	bool writeFile(const std::string& filename, const std::vector<U8>& data)
+	{
+		LLFILE* fp = LLFile::fopen(filename, "wb");
+		if (!fp)
+		{
+			return false;
+		}
+		size_t written = data.empty() ? 0 : fwrite(&data[0], 1, data.size(), fp);
+		fclose(fp);
+		return written == data.size();
+	}
+
+	// A region's worth of synthetic object updates, in both the old
+	// sequential cache layout and the indexed one.
+	void makeRegion(S32 num_entries, std::vector<U8>& sequential, std::vector<U8>& indexed)
+	{
+		U32 seed = 12345;
+		std::vector<Record> index(num_entries);
+		std::vector<std::vector<U8> > data(num_entries);
+		U32 local_id = 1000;
+		for (S32 i = 0; i < num_entries; ++i)
+		{
+			seed = seed * 1664525 + 1013904223;
+			local_id += 1 + (seed >> 28);
+			index[i].mLocalID = local_id;
+			index[i].mCRC = seed;
+			index[i].mHitCount = 0;
+			index[i].mDupeCount = 0;
+			index[i].mCRCChangeCount = 0;
+			// full object updates run from about 100 to 700 bytes
+			index[i].mSize = 100 + (S32)((seed >> 8) % 600);
+			data[i].resize(index[i].mSize);
+			for (S32 j = 0; j < index[i].mSize; ++j)
+			{
+				data[i][j] = (U8)(seed >> (j & 15));
+			}
+		}
+
+		sequential.clear();
+		sequential.insert(sequential.end(), (U8*)&num_entries, (U8*)&num_entries + sizeof(S32));
+		for (S32 i = 0; i < num_entries; ++i)
+		{
+			// local id through change count, then the size
+			sequential.insert(sequential.end(), (U8*)&index[i], (U8*)&index[i].mOffset);
+			sequential.insert(sequential.end(), (U8*)&index[i].mSize, (U8*)&index[i].mSize + sizeof(S32));
+			sequential.insert(sequential.end(), data[i].begin(), data[i].end());
+		}
+
+		U32 offset = sizeof(S32) + num_entries * sizeof(Record);
+		for (S32 i = 0; i < num_entries; ++i)
+		{
+			index[i].mOffset = offset;
+			offset += index[i].mSize;
+		}
+		indexed.clear();
+		indexed.insert(indexed.end(), (U8*)&num_entries, (U8*)&num_entries + sizeof(S32));
+		indexed.insert(indexed.end(), (U8*)&index[0], (U8*)&index[0] + num_entries * sizeof(Record));
+		for (S32 i = 0; i < num_entries; ++i)
+		{
+			indexed.insert(indexed.end(), data[i].begin(), data[i].end());
+		}
+	}
+}
+
+namespace tut
+{
+	struct mappedfile_data
+	{
+		mappedfile_data()
+		:	mFilename(std::string(LLFile::tmpdir()) + "llmappedfile_test.dat"),
+			mSequentialFilename(std::string(LLFile::tmpdir()) + "llmappedfile_test.seq")
+		{
+		}
+
+		~mappedfile_data()
+		{
+			LLFile::remove(mFilename);
+			LLFile::remove(mSequentialFilename);
+		}
+
+		std::string mFilename;
+		std::string mSequentialFilename;
+	};
+	typedef test_group<mappedfile_data> mappedfile_test;
+	typedef mappedfile_test::object mappedfile_object;
+	tut::mappedfile_test mappedfile_testcase("LLMappedFile");
+
+	template<> template<>
+	void mappedfile_object::test<1>()
+	{
+		std::vector<U8> data(10000);
+		for (size_t i = 0; i < data.size(); ++i)
+		{
+			data[i] = (U8)(i * 7);
+		}
+		ensure("write", writeFile(mFilename, data));
+
+		LLMappedFile file;
+		ensure("not open", !file.isOpen());
+		ensure("open", file.open(mFilename));
+		ensure_equals("size", file.getSize(), data.size());
+		ensure("contents", std::equal(data.begin(), data.end(), file.getData()));
+
+		file.close();
+		ensure("closed", !file.isOpen());
+		ensure_equals("closed size", file.getSize(), (size_t)0);
+
+		// empty and missing files can't be mapped
+		ensure("write empty", writeFile(mFilename, std::vector<U8>()));
+		ensure("empty", !file.open(mFilename));
+		LLFile::remove(mFilename);
+		ensure("missing", !file.open(mFilename));
+	}
+
+	template<> template<>
+	void mappedfile_object::test<2>()
+	{
+		set_test_name("synthetic region object cache benchmark");
+		if (!getenv("LL_RUN_BENCHMARKS"))
+		{
+			skip("benchmark, set LL_RUN_BENCHMARKS to run it");
+		}
+		// Loading the objects of one region from its cache file, all of
+		// them read up front as the cache used to, against looking up
+		// only the objects the simulator reports through the index of a
+		// mapped file. LL_MAPPEDFILE_BENCH_ENTRIES and
+		// LL_MAPPEDFILE_BENCH_PASSES scale the run.
+		S32 num_entries = 15000;
+		S32 passes = 10;
+		if (const char* env = getenv("LL_MAPPEDFILE_BENCH_ENTRIES"))
+		{
+			num_entries = llmax(1, atoi(env));
+		}
+		if (const char* env = getenv("LL_MAPPEDFILE_BENCH_PASSES"))
+		{
+			passes = llmax(1, atoi(env));
+		}
+
+		std::vector<U8> sequential;
+		std::vector<U8> indexed;
+		makeRegion(num_entries, sequential, indexed);
+		ensure("write sequential", writeFile(mSequentialFilename, sequential));
+		ensure("write indexed", writeFile(mFilename, indexed));
+
+		// every fourth object is reported, say after a teleport back
+		std::vector<U32> reported;
+		const Record* records = (const Record*)&indexed[sizeof(S32)];
+		for (S32 i = 0; i < num_entries; i += 4)
+		{
+			reported.push_back(records[i].mLocalID);
+		}
+
+		U32 full_sum = 0;
+		LLTimer timer;
+		for (S32 pass = 0; pass < passes; ++pass)
+		{
+			std::map<U32, U8*> entries;
+			LLFILE* fp = LLFile::fopen(mSequentialFilename, "rb");
+			ensure("open sequential", fp != NULL);
+			S32 count = 0;
+			fread(&count, sizeof(S32), 1, fp);
+			for (S32 i = 0; i < count; ++i)
+			{
+				Record record;
+				fread(&record.mLocalID, sizeof(U32), 1, fp);
+				fread(&record.mCRC, sizeof(U32), 1, fp);
+				fread(&record.mHitCount, sizeof(S32), 1, fp);
+				fread(&record.mDupeCount, sizeof(S32), 1, fp);
+				fread(&record.mCRCChangeCount, sizeof(S32), 1, fp);
+				fread(&record.mSize, sizeof(S32), 1, fp);
+				U8* buffer = new U8[record.mSize];
+				fread(buffer, 1, record.mSize, fp);
+				entries[record.mLocalID] = buffer;
+			}
+			fclose(fp);
+			for (size_t i = 0; i < reported.size(); ++i)
+			{
+				full_sum += entries[reported[i]][0];
+			}
+			for (std::map<U32, U8*>::iterator iter = entries.begin(); iter != entries.end(); ++iter)
+			{
+				delete[] iter->second;
+			}
+		}
+		F64 full_elapsed = timer.getElapsedTimeF64();
+
+		U32 mapped_sum = 0;
+		timer.reset();
+		for (S32 pass = 0; pass < passes; ++pass)
+		{
+			LLMappedFile file;
+			ensure("map indexed", file.open(mFilename));
+			S32 count = 0;
+			memcpy(&count, file.getData(), sizeof(S32));
+			const Record* index = (const Record*)(file.getData() + sizeof(S32));
+			for (size_t i = 0; i < reported.size(); ++i)
+			{
+				const Record* record = std::lower_bound(index, index + count, reported[i], record_less());
+				ensure("found", record != index + count && record->mLocalID == reported[i]);
+				U8* buffer = new U8[record->mSize];
+				memcpy(buffer, file.getData() + record->mOffset, record->mSize);
+				mapped_sum += buffer[0];
+				delete[] buffer;
+			}
+		}
+		F64 mapped_elapsed = timer.getElapsedTimeF64();
+
+		llinfos << num_entries << " cached objects, " << reported.size() << " reported: "
+				<< full_elapsed * 1000.0 / passes << " ms per region read in full, "
+				<< mapped_elapsed * 1000.0 / passes << " ms mapped and indexed" << llendl;
+
+		ensure_equals("same objects", mapped_sum, full_sum);
+	}
+}
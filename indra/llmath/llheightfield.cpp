@@ -0,0 +1,92 @@
+/**
+ * @file llheightfield.cpp
+ * @brief Batched operations on heightfield grids
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "llheightfield.h"
+
+#include "llmath.h"
+#include "v3math.h"
+#include "llv4math.h"	// for LL_VECTORIZE
+
+void ll_heightfield_normals(const F32* heights, S32 row_stride, S32 count,
+							S32 stride, F32 spacing, LLVector3* normals)
+{
+	// Diagonals (p11 - p00) and (p01 - p10), with p00 at (-spacing, -spacing)
+	const F32 diag = spacing - -spacing;
+	const F32 neg_diag = -spacing - spacing;
+	const F32 up = diag*diag - neg_diag*diag;
+
+	const F32* below = heights - stride*row_stride;
+	const F32* above = heights + stride*row_stride;
+
+	S32 i = 0;
+#if LL_VECTORIZE
+	const __m128 diag4 = _mm_set1_ps(diag);
+	const __m128 neg_diag4 = _mm_set1_ps(neg_diag);
+	const __m128 up4 = _mm_set1_ps(up);
+	const __m128 threshold4 = _mm_set1_ps(FP_MAG_THRESHOLD);
+	const __m128 one4 = _mm_set1_ps(1.f);
+	LL_LLV4MATH_ALIGN_PREFIX F32 x[4] LL_LLV4MATH_ALIGN_POSTFIX;
+	LL_LLV4MATH_ALIGN_PREFIX F32 y[4] LL_LLV4MATH_ALIGN_POSTFIX;
+	LL_LLV4MATH_ALIGN_PREFIX F32 z[4] LL_LLV4MATH_ALIGN_POSTFIX;
+	for ( ; i + 4 <= count; i += 4)
+	{
+		__m128 z00 = _mm_loadu_ps(below + i - stride);
+		__m128 z10 = _mm_loadu_ps(below + i + stride);
+		__m128 z01 = _mm_loadu_ps(above + i - stride);
+		__m128 z11 = _mm_loadu_ps(above + i + stride);
+		__m128 d1 = _mm_sub_ps(z11, z00);
+		__m128 d2 = _mm_sub_ps(z01, z10);
+
+		// Same operations, in the same order, as LLVector3 %= and normVec()
+		__m128 nx = _mm_sub_ps(_mm_mul_ps(diag4, d2), _mm_mul_ps(diag4, d1));
+		__m128 ny = _mm_sub_ps(_mm_mul_ps(d1, neg_diag4), _mm_mul_ps(d2, diag4));
+		__m128 nz = up4;
+		__m128 mag = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, nx), _mm_mul_ps(ny, ny)),
+											_mm_mul_ps(nz, nz)));
+		__m128 oomag = _mm_div_ps(one4, mag);
+		// Degenerate normals are zeroed
+		__m128 valid = _mm_cmpgt_ps(mag, threshold4);
+		_mm_store_ps(x, _mm_and_ps(valid, _mm_mul_ps(nx, oomag)));
+		_mm_store_ps(y, _mm_and_ps(valid, _mm_mul_ps(ny, oomag)));
+		_mm_store_ps(z, _mm_and_ps(valid, _mm_mul_ps(nz, oomag)));
+
+		for (S32 k = 0; k < 4; k++)
+		{
+			normals[i + k].setVec(x[k], y[k], z[k]);
+		}
+	}
+#endif
+	for ( ; i < count; i++)
+	{
+		F32 d1 = above[i + stride] - below[i - stride];
+		F32 d2 = above[i - stride] - below[i + stride];
+		LLVector3 normal(diag*d2 - diag*d1, d1*neg_diag - d2*diag, up);
+		normal.normVec();
+		normals[i] = normal;
+	}
+}
@@ -0,0 +1,43 @@
+/**
+ * @file llheightfield.h
+ * @brief Batched operations on heightfield grids
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLHEIGHTFIELD_H
+#define LL_LLHEIGHTFIELD_H
+
+class LLVector3;
+
+// Computes the normals of count consecutive points of one heightfield row.
+// Each normal is the cross product of the two diagonals through the point,
+// from the heights stride points away in both directions, with spacing
+// meters between the point and its diagonal neighbors along each axis.
+// heights and normals both point at the first point of the row and share
+// row_stride. Every height read must lie inside the heightfield.
+// The result is bit for bit what LLVector3 cross product and normVec()
+// give for the same points.
+void ll_heightfield_normals(const F32* heights, S32 row_stride, S32 count,
+							S32 stride, F32 spacing, LLVector3* normals);
+
+#endif // LL_LLHEIGHTFIELD_H
@@ -36,6 +36,7 @@
 #include "m4math.h"
 #include "m3math.h"
 #include "llquantize.h"
+#include "llv4math.h"	// for LL_VECTORIZE
 
 // WARNING: Don't use this for global const definitions!  using this
 // at the top of a *.cpp file might not give you what you think.
@@ -713,6 +714,84 @@ LLQuaternion nlerp(F32 t, const LLQuaternion &q)
 	}
 }
 
+// Same results as calling nlerp() for each pair. Pairs in opposite
+// hemispheres still go through slerp() one at a time.
+void nlerp_batch(S32 count, const F32 *t, const LLQuaternion *p,
+				 const LLQuaternion *q, LLQuaternion *result)
+{
+	S32 i = 0;
+#if LL_VECTORIZE
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.f);
+	const __m128 mag_threshold = _mm_set1_ps(FP_MAG_THRESHOLD);
+	const __m128 unity_threshold = _mm_set1_ps(ONE_PART_IN_A_MILLION);
+	for ( ; i + 4 <= count; i += 4)
+	{
+		// Transpose four quaternions so each register holds one component.
+		__m128 px = _mm_loadu_ps(p[i].mQ);
+		__m128 py = _mm_loadu_ps(p[i+1].mQ);
+		__m128 pz = _mm_loadu_ps(p[i+2].mQ);
+		__m128 pw = _mm_loadu_ps(p[i+3].mQ);
+		_MM_TRANSPOSE4_PS(px, py, pz, pw);
+		__m128 qx = _mm_loadu_ps(q[i].mQ);
+		__m128 qy = _mm_loadu_ps(q[i+1].mQ);
+		__m128 qz = _mm_loadu_ps(q[i+2].mQ);
+		__m128 qw = _mm_loadu_ps(q[i+3].mQ);
+		_MM_TRANSPOSE4_PS(qx, qy, qz, qw);
+
+		const __m128 tv = _mm_loadu_ps(t + i);
+		const __m128 inv_t = _mm_sub_ps(one, tv);
+
+		__m128 rx = _mm_add_ps(_mm_mul_ps(tv, qx), _mm_mul_ps(inv_t, px));
+		__m128 ry = _mm_add_ps(_mm_mul_ps(tv, qy), _mm_mul_ps(inv_t, py));
+		__m128 rz = _mm_add_ps(_mm_mul_ps(tv, qz), _mm_mul_ps(inv_t, pz));
+		__m128 rw = _mm_add_ps(_mm_mul_ps(tv, qw), _mm_mul_ps(inv_t, pw));
+
+		// Normalize the way LLQuaternion::normalize() does: leave nearly
+		// unit results alone, and turn degenerate ones into the identity.
+		__m128 mag = _mm_mul_ps(rx, rx);
+		mag = _mm_add_ps(mag, _mm_mul_ps(ry, ry));
+		mag = _mm_add_ps(mag, _mm_mul_ps(rz, rz));
+		mag = _mm_add_ps(mag, _mm_mul_ps(rw, rw));
+		mag = _mm_sqrt_ps(mag);
+
+		const __m128 valid = _mm_cmpgt_ps(mag, mag_threshold);
+		const __m128 off_unity = _mm_sub_ps(one, mag);
+		const __m128 rescale = _mm_and_ps(valid,
+			_mm_cmpgt_ps(_mm_max_ps(off_unity, _mm_sub_ps(zero, off_unity)), unity_threshold));
+		const __m128 scale = _mm_or_ps(_mm_and_ps(rescale, _mm_div_ps(one, mag)),
+									   _mm_andnot_ps(rescale, one));
+		rx = _mm_and_ps(valid, _mm_mul_ps(rx, scale));
+		ry = _mm_and_ps(valid, _mm_mul_ps(ry, scale));
+		rz = _mm_and_ps(valid, _mm_mul_ps(rz, scale));
+		rw = _mm_or_ps(_mm_and_ps(valid, _mm_mul_ps(rw, scale)), _mm_andnot_ps(valid, one));
+
+		_MM_TRANSPOSE4_PS(rx, ry, rz, rw);
+		_mm_storeu_ps(result[i].mQ, rx);
+		_mm_storeu_ps(result[i+1].mQ, ry);
+		_mm_storeu_ps(result[i+2].mQ, rz);
+		_mm_storeu_ps(result[i+3].mQ, rw);
+
+		__m128 d = _mm_mul_ps(px, qx);
+		d = _mm_add_ps(d, _mm_mul_ps(py, qy));
+		d = _mm_add_ps(d, _mm_mul_ps(pz, qz));
+		d = _mm_add_ps(d, _mm_mul_ps(pw, qw));
+		S32 flipped = _mm_movemask_ps(_mm_cmplt_ps(d, zero));
+		for (S32 k = 0; flipped; ++k, flipped >>= 1)
+		{
+			if (flipped & 1)
+			{
+				result[i+k] = slerp(t[i+k], p[i+k], q[i+k]);
+			}
+		}
+	}
+#endif
+	for ( ; i < count; ++i)
+	{
+		result[i] = nlerp(t[i], p[i], q[i]);
+	}
+}
+
 // slerp from identity quaternion to another quaternion
 LLQuaternion slerp(F32 t, const LLQuaternion &q)
 {
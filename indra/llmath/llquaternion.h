@@ -133,6 +133,8 @@ public:
 	friend LLQuaternion slerp(F32 t, const LLQuaternion &q);							// spherical linear interpolation from identity to q
 	friend LLQuaternion nlerp(F32 t, const LLQuaternion &p, const LLQuaternion &q); 	// normalized linear interpolation from p to q
 	friend LLQuaternion nlerp(F32 t, const LLQuaternion &q); 							// normalized linear interpolation from p to q
+	friend void nlerp_batch(S32 count, const F32 *t, const LLQuaternion *p,
+							const LLQuaternion *q, LLQuaternion *result);			// nlerp() of count pairs, four at a time with SSE
 
 	LLVector3	packToVector3() const;						// Saves space by using the fact that our quaternions are normalized
 	void		unpackFromVector3(const LLVector3& vec);	// Saves space by using the fact that our quaternions are normalized
@@ -0,0 +1,176 @@
+/**
+ * @file llheightfield_test.cpp
+ * @brief Tests for llheightfield.cpp.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include <cstdlib>
+
+#include "linden_common.h"
+#include "lltimer.h"
+#include "v3math.h"
+
+#include "../llheightfield.h"
+
+#include "../test/lltut.h"
+
+namespace
+{
+	// The per point normal LLSurfacePatch::calcNormal() computed before
+	// normals were batched.
+	LLVector3 refNormal(const F32* heights, S32 row_stride, S32 x, S32 y, S32 stride, F32 spacing)
+	{
+		LLVector3 p00(-spacing,-spacing, heights[(x - stride) + (y - stride)*row_stride]);
+		LLVector3 p01(-spacing,+spacing, heights[(x - stride) + (y + stride)*row_stride]);
+		LLVector3 p10(+spacing,-spacing, heights[(x + stride) + (y - stride)*row_stride]);
+		LLVector3 p11(+spacing,+spacing, heights[(x + stride) + (y + stride)*row_stride]);
+
+		LLVector3 c1 = p11 - p00;
+		LLVector3 c2 = p01 - p10;
+
+		LLVector3 normal = c1;
+		normal %= c2;
+		normal.normVec();
+		return normal;
+	}
+
+	// Rolling hills with some noise on top, like terrain after a few edits
+	void makeHeightfield(std::vector<F32>& heights, S32 width)
+	{
+		heights.resize(width * width);
+		U32 seed = 12345;
+		for (S32 y = 0; y < width; y++)
+		{
+			for (S32 x = 0; x < width; x++)
+			{
+				seed = seed * 1103515245 + 12345;
+				F32 noise = (F32)((seed >> 16) & 0xff) / 255.f;
+				heights[x + y*width] = 20.f + 10.f * sinf(x * 0.07f) * cosf(y * 0.05f) + noise;
+			}
+		}
+	}
+}
+
+namespace tut
+{
+	struct heightfield_test
+	{
+	};
+	typedef test_group<heightfield_test> heightfield_test_t;
+	typedef heightfield_test_t::object heightfield_test_object_t;
+	tut::heightfield_test_t tut_heightfield_test("LLHeightfield");
+
+	template<> template<>
+	void heightfield_test_object_t::test<1>()
+	{
+		set_test_name("batched normals match per point normals");
+		const S32 width = 37;
+		std::vector<F32> heights;
+		makeHeightfield(heights, width);
+		// a flat spot, where the normal points straight up
+		for (S32 i = 0; i < 8; i++)
+		{
+			heights[i + 10*width] = heights[i + 12*width] = 5.f;
+		}
+
+		for (S32 stride = 1; stride <= 2; stride++)
+		{
+			const F32 spacing = 1.f * stride;
+			std::vector<LLVector3> normals(width * width);
+			for (S32 y = stride; y < width - stride; y++)
+			{
+				// not a multiple of four, so both the SSE and scalar paths run
+				const S32 count = width - 2*stride;
+				ll_heightfield_normals(&heights[stride + y*width], width, count,
+									   stride, spacing, &normals[stride + y*width]);
+				for (S32 x = stride; x < width - stride; x++)
+				{
+					LLVector3 ref = refNormal(&heights[0], width, x, y, stride, spacing);
+					const LLVector3& normal = normals[x + y*width];
+					ensure("bit exact normal",
+						   normal.mV[VX] == ref.mV[VX] &&
+						   normal.mV[VY] == ref.mV[VY] &&
+						   normal.mV[VZ] == ref.mV[VZ]);
+				}
+			}
+		}
+	}
+
+	template<> template<>
+	void heightfield_test_object_t::test<2>()
+	{
+		set_test_name("synthetic heightfield normals benchmark");
+		if (!getenv("LL_RUN_BENCHMARKS"))
+		{
+			skip("benchmark, set LL_RUN_BENCHMARKS to run it");
+		}
+		// A var region sized heightfield, all normals recomputed as after a
+		// full terrain update. LL_HEIGHTFIELD_BENCH_WIDTH and
+		// LL_HEIGHTFIELD_BENCH_PASSES scale the run.
+		S32 width = 1025;
+		S32 passes = 20;
+		if (const char* env = getenv("LL_HEIGHTFIELD_BENCH_WIDTH"))
+		{
+			width = llmax(5, atoi(env));
+		}
+		if (const char* env = getenv("LL_HEIGHTFIELD_BENCH_PASSES"))
+		{
+			passes = llmax(1, atoi(env));
+		}
+		const S32 stride = 2;
+		const F32 spacing = 2.f;
+		std::vector<F32> heights;
+		makeHeightfield(heights, width);
+		std::vector<LLVector3> normals(width * width);
+		std::vector<LLVector3> ref_normals(width * width);
+
+		LLTimer timer;
+		for (S32 pass = 0; pass < passes; pass++)
+		{
+			for (S32 y = stride; y < width - stride; y++)
+			{
+				for (S32 x = stride; x < width - stride; x++)
+				{
+					ref_normals[x + y*width] = refNormal(&heights[0], width, x, y, stride, spacing);
+				}
+			}
+		}
+		F64 ref_elapsed = timer.getElapsedTimeF64();
+
+		timer.reset();
+		for (S32 pass = 0; pass < passes; pass++)
+		{
+			for (S32 y = stride; y < width - stride; y++)
+			{
+				ll_heightfield_normals(&heights[stride + y*width], width, width - 2*stride,
+									   stride, spacing, &normals[stride + y*width]);
+			}
+		}
+		F64 elapsed = timer.getElapsedTimeF64();
+
+		llinfos << width << "x" << width << " heightfield: " << ref_elapsed * 1000.0 / passes
+				<< " ms per pass point by point, " << elapsed * 1000.0 / passes << " ms batched" << llendl;
+
+		ensure("same normals", normals == ref_normals);
+	}
+}
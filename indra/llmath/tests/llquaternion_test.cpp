@@ -657,4 +657,36 @@ namespace tut
 			is_approx_equal(1.000f, llquat.mQ[3]));
 	}
 
+	template<> template<>
+	void llquat_test_object_t::test<23>()
+	{
+		//test case for void nlerp_batch(S32 count, const F32 *t, const LLQuaternion *p, const LLQuaternion *q, LLQuaternion *result) fn
+		const S32 count = 11;
+		F32 t[count];
+		LLQuaternion p[count];
+		LLQuaternion q[count];
+		for (S32 i = 0; i < count; i++)
+		{
+			t[i] = (F32)i / (F32)(count - 1);
+			p[i].setAngleAxis(0.3f * i, LLVector3(1.f, 0.5f * i, 2.f));
+			q[i].setAngleAxis(-0.2f * i, LLVector3(0.5f, 1.f, -0.1f * i));
+		}
+		// opposite hemispheres take the slerp path
+		q[2] = -p[2];
+		q[6].setQuat(-q[6].mQ[VX], -q[6].mQ[VY], -q[6].mQ[VZ], -q[6].mQ[VW]);
+		// degenerate pair falls back to the identity
+		p[5].mQ[VX] = p[5].mQ[VY] = p[5].mQ[VZ] = p[5].mQ[VW] = 0.f;
+		q[5] = p[5];
+
+		LLQuaternion result[count];
+		nlerp_batch(count, t, p, q, result);
+		for (S32 i = 0; i < count; i++)
+		{
+			LLQuaternion expected = nlerp(t[i], p[i], q[i]);
+			for (S32 j = 0; j < 4; j++)
+			{
+				ensure_equals("nlerp_batch() failed", result[i].mQ[j], expected.mQ[j]);
+			}
+		}
+	}
 }
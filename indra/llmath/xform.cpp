@@ -112,6 +112,14 @@ void LLXformMatrix::updateMatrix(BOOL update_bounds)
 	}
 }
 
+void LLXformMatrix::setWorldTransform(const LLVector3& pos, const LLQuaternion& rot)
+{
+	mWorldPosition = pos;
+	mWorldRotation = rot;
+
+	mWorldMatrix.initAll(mScale, mWorldRotation, mWorldPosition);
+}
+
 void LLXformMatrix::getMinMax(LLVector3& min, LLVector3& max) const
 {
 	min = mMin;
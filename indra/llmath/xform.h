@@ -150,6 +150,9 @@ public:
 
 	void update();
 	void updateMatrix(BOOL update_bounds = TRUE);
+	// Takes a world transform computed elsewhere (e.g. in a batch with
+	// its siblings) and rebuilds the world matrix, like updateMatrix(FALSE).
+	void setWorldTransform(const LLVector3& pos, const LLQuaternion& rot);
 	void getMinMax(LLVector3& min,LLVector3& max) const;
 
 protected:
@@ -0,0 +1,165 @@
+/** 
+ * @file llassetrequestqueue.cpp
+ * @brief Indexed table of pending asset downloads
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ * 
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ * 
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ * 
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "llassetrequestqueue.h"
+
+#include "llassetstorage.h"
+
+LLAssetRequestQueue::LLAssetRequestQueue(request_list_t& requests)
+:	mRequests(requests)
+{
+}
+
+// static
+LLAssetRequestQueue::asset_key_t LLAssetRequestQueue::keyOf(const LLAssetRequest* req)
+{
+	return asset_key_t(req->getUUID(), (S32)req->getType());
+}
+
+void LLAssetRequestQueue::add(LLAssetRequest* req, bool at_front)
+{
+	request_list_t::iterator iter;
+	if (at_front)
+	{
+		mRequests.push_front(req);
+		iter = mRequests.begin();
+	}
+	else
+	{
+		iter = mRequests.insert(mRequests.end(), req);
+	}
+	mIndex.insert(index_t::value_type(keyOf(req), iter));
+}
+
+bool LLAssetRequestQueue::remove(LLAssetRequest* req)
+{
+	std::pair<index_t::iterator, index_t::iterator> range = mIndex.equal_range(keyOf(req));
+	for (index_t::iterator iter = range.first; iter != range.second; ++iter)
+	{
+		if (*iter->second == req)
+		{
+			mRequests.erase(iter->second);
+			mIndex.erase(iter);
+			return true;
+		}
+	}
+	return false;
+}
+
+LLAssetRequestQueue::request_list_t::iterator LLAssetRequestQueue::erase(request_list_t::iterator list_iter)
+{
+	std::pair<index_t::iterator, index_t::iterator> range = mIndex.equal_range(keyOf(*list_iter));
+	for (index_t::iterator iter = range.first; iter != range.second; ++iter)
+	{
+		if (iter->second == list_iter)
+		{
+			mIndex.erase(iter);
+			break;
+		}
+	}
+	return mRequests.erase(list_iter);
+}
+
+bool LLAssetRequestQueue::contains(const LLUUID& id, LLAssetType::EType type, const LLAssetRequest* req) const
+{
+	std::pair<index_t::const_iterator, index_t::const_iterator> range = mIndex.equal_range(asset_key_t(id, (S32)type));
+	for (index_t::const_iterator iter = range.first; iter != range.second; ++iter)
+	{
+		if (*iter->second == req)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+bool LLAssetRequestQueue::hasRequests(const LLUUID& id, LLAssetType::EType type) const
+{
+	return mIndex.find(asset_key_t(id, (S32)type)) != mIndex.end();
+}
+
+void LLAssetRequestQueue::getRequests(const LLUUID& id, LLAssetType::EType type, request_vec_t& requests) const
+{
+	std::pair<index_t::const_iterator, index_t::const_iterator> range = mIndex.equal_range(asset_key_t(id, (S32)type));
+	for (index_t::const_iterator iter = range.first; iter != range.second; ++iter)
+	{
+		requests.push_back(*iter->second);
+	}
+}
+
+void LLAssetRequestQueue::queueDispatch(const LLAssetRequest* req, bool is_priority)
+{
+	asset_key_t key = keyOf(req);
+	if (!mQueued.insert(key).second)
+	{
+		return;
+	}
+	if (is_priority)
+	{
+		mPriorityDispatch.push_back(key);
+	}
+	else
+	{
+		mDispatch.push_back(key);
+	}
+}
+
+bool LLAssetRequestQueue::dispatchNext(dispatch_queue_t& queue, Dispatcher& dispatcher)
+{
+	while (!queue.empty())
+	{
+		asset_key_t key = queue.front();
+		queue.pop_front();
+		mQueued.erase(key);
+
+		// Requests that finished, timed out or were cancelled while
+		// queued need nothing sent.
+		index_t::iterator iter = mIndex.find(key);
+		if (iter != mIndex.end())
+		{
+			dispatcher.sendRequest(*iter->second);
+			return true;
+		}
+	}
+	return false;
+}
+
+S32 LLAssetRequestQueue::dispatch(Dispatcher& dispatcher, S32 max_count)
+{
+	S32 sent = 0;
+	while (max_count <= 0 || sent < max_count)
+	{
+		if (!dispatchNext(mPriorityDispatch, dispatcher)
+			&& !dispatchNext(mDispatch, dispatcher))
+		{
+			break;
+		}
+		++sent;
+	}
+	return sent;
+}
@@ -0,0 +1,110 @@
+/** 
+ * @file llassetrequestqueue.h
+ * @brief Indexed table of pending asset downloads
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ * 
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ * 
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ * 
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLASSETREQUESTQUEUE_H
+#define LL_LLASSETREQUESTQUEUE_H
+
+#include <deque>
+#include <list>
+#include <map>
+#include <set>
+#include <vector>
+
+#include "llassettype.h"
+#include "lluuid.h"
+
+class LLAssetRequest;
+
+/**
+ * @class LLAssetRequestQueue
+ * @brief Indexes a list of pending asset requests by asset.
+ *
+ * LLAssetStorage keeps its pending downloads in a list, in the order
+ * they are served. The queue adds an index from (asset id, type) to the
+ * list entries, so finding the requests for an asset, or removing one,
+ * does not scan the whole list. The list must only be changed through
+ * the queue while the queue is in use.
+ *
+ * It also batches network requests: the first request for an asset is
+ * queued for dispatch, and dispatch() later sends the queued ones,
+ * priority requests first, in a single pass.
+ */
+class LLAssetRequestQueue
+{
+public:
+	typedef std::list<LLAssetRequest*> request_list_t;
+	typedef std::vector<LLAssetRequest*> request_vec_t;
+
+	class Dispatcher
+	{
+	public:
+		virtual ~Dispatcher() {}
+		// Sends the network request for req's asset. Any other requests
+		// for the same asset wait on this one.
+		virtual void sendRequest(LLAssetRequest* req) = 0;
+	};
+
+	LLAssetRequestQueue(request_list_t& requests);
+
+	// Adds a request to the list, at the back or the front.
+	void add(LLAssetRequest* req, bool at_front = false);
+	// Removes a request; returns false if it was not there.
+	bool remove(LLAssetRequest* req);
+	request_list_t::iterator erase(request_list_t::iterator iter);
+
+	// Does not dereference req, so it may be a stale pointer.
+	bool contains(const LLUUID& id, LLAssetType::EType type, const LLAssetRequest* req) const;
+	bool hasRequests(const LLUUID& id, LLAssetType::EType type) const;
+	// Appends the requests for an asset, oldest first.
+	void getRequests(const LLUUID& id, LLAssetType::EType type, request_vec_t& requests) const;
+
+	// Marks req's asset as needing a network request, unless it already
+	// is.
+	void queueDispatch(const LLAssetRequest* req, bool is_priority);
+	// Sends up to max_count (0 for all) queued requests whose asset still
+	// has a request pending. Returns the number sent.
+	S32 dispatch(Dispatcher& dispatcher, S32 max_count = 0);
+	S32 getDispatchQueueSize() const { return (S32)(mPriorityDispatch.size() + mDispatch.size()); }
+
+	S32 size() const { return (S32)mIndex.size(); }
+
+private:
+	typedef std::pair<LLUUID, S32> asset_key_t;
+	typedef std::multimap<asset_key_t, request_list_t::iterator> index_t;
+	typedef std::deque<asset_key_t> dispatch_queue_t;
+
+	static asset_key_t keyOf(const LLAssetRequest* req);
+	bool dispatchNext(dispatch_queue_t& queue, Dispatcher& dispatcher);
+
+private:
+	request_list_t& mRequests;
+	index_t mIndex;
+	dispatch_queue_t mPriorityDispatch;
+	dispatch_queue_t mDispatch;
+	std::set<asset_key_t> mQueued;
+};
+
+#endif // LL_LLASSETREQUESTQUEUE_H
@@ -278,6 +278,7 @@ LLEstateAssetRequest::~LLEstateAssetRequest()
 
 
 LLAssetStorage::LLAssetStorage(LLMessageSystem *msg, LLXferManager *xfer, LLVFS *vfs, LLVFS *static_vfs, const LLHost &upstream_host)
+:	mDownloadQueue(mPendingDownloads)
 {
 	_init(msg, xfer, vfs, static_vfs, upstream_host);
 }
@@ -285,6 +286,7 @@ LLAssetStorage::LLAssetStorage(LLMessageSystem *msg, LLXferManager *xfer, LLVFS
 
 LLAssetStorage::LLAssetStorage(LLMessageSystem *msg, LLXferManager *xfer,
 							   LLVFS *vfs, LLVFS *static_vfs)
+:	mDownloadQueue(mPendingDownloads)
 {
 	_init(msg, xfer, vfs, static_vfs, LLHost::invalid);
 }
@@ -301,6 +303,7 @@ void LLAssetStorage::_init(LLMessageSystem *msg,
 	mXferManager = xfer;
 	mVFS = vfs;
 	mStaticVFS = static_vfs;
+	mMaxDispatchPerCheck = 64;
 
 	setUpstream(upstream_host);
 	msg->setHandlerFuncFast(_PREHASH_AssetUploadComplete, processUploadComplete, (void **)this);
@@ -332,6 +335,8 @@ void LLAssetStorage::setUpstream(const LLHost &upstream_host)
 
 void LLAssetStorage::checkForTimeouts()
 {
+	_checkDeferredRequests();
+	mDownloadQueue.dispatch(*this, mMaxDispatchPerCheck);
 	_cleanupRequests(FALSE, LL_ERR_TCP_TIMEOUT);
 }
 
@@ -362,7 +367,7 @@ void LLAssetStorage::_cleanupRequests(BOOL all, S32 error)
 						<< LLAssetType::lookup(tmp->getType()) << llendl;
 
 				timed_out.push_front(tmp);
-				iter = requests->erase(curiter);
+				iter = eraseRequest((ERequestType)rt, curiter);
 			}
 		}
 	}
@@ -388,6 +393,18 @@ void LLAssetStorage::_cleanupRequests(BOOL all, S32 error)
 		delete tmp;
 	}
 
+	if (all)
+	{
+		deferred_list_t deferred;
+		deferred.swap(mDeferredRequests);
+		for (deferred_list_t::iterator iter = deferred.begin(); iter != deferred.end(); ++iter)
+		{
+			if (iter->mCallback)
+			{
+				iter->mCallback(mVFS, iter->mUUID, iter->mType, iter->mUserData, error, LL_EXSTAT_NONE);
+			}
+		}
+	}
 }
 
 BOOL LLAssetStorage::hasLocalAsset(const LLUUID &uuid, const LLAssetType::EType type)
@@ -455,9 +472,28 @@ void LLAssetStorage::getAssetData(const LLUUID uuid, LLAssetType::EType type, LL
 		return;
 	}
 
+	_checkVFSAndQueue(uuid, type, callback, user_data, is_priority);
+}
+
+void LLAssetStorage::_checkVFSAndQueue(const LLUUID& uuid, LLAssetType::EType type,
+									   LLGetAssetCallback callback, void *user_data, BOOL is_priority)
+{
+	if (mVFS->isLocked(uuid, type, VFSLOCK_APPEND))
+	{
+		// The asset is still being written to the cache, and its size
+		// would block until the write is done. Look again next time.
+		DeferredRequest deferred;
+		deferred.mUUID = uuid;
+		deferred.mType = type;
+		deferred.mCallback = callback;
+		deferred.mUserData = user_data;
+		deferred.mIsPriority = is_priority;
+		mDeferredRequests.push_back(deferred);
+		return;
+	}
+
 	BOOL exists = mVFS->getExists(uuid, type);
-	LLVFile file(mVFS, uuid, type);
-	U32 size = exists ? file.getSize() : 0;
+	S32 size = exists ? mVFS->getSize(uuid, type) : 0;
 	
 	if (size > 0)
 	{
@@ -475,32 +511,29 @@ void LLAssetStorage::getAssetData(const LLUUID uuid, LLAssetType::EType type, LL
 	{
 		if (exists)
 		{
-			llwarns << "Asset vfile " << uuid << ":" << type << " found with bad size " << file.getSize() << ", removing" << llendl;
+			llwarns << "Asset vfile " << uuid << ":" << type << " found with bad size " << size << ", removing" << llendl;
+			LLVFile file(mVFS, uuid, type);
 			file.remove();
 		}
 		
-		BOOL duplicate = FALSE;
-		
 		// check to see if there's a pending download of this uuid already
-		for (request_list_t::iterator iter = mPendingDownloads.begin();
-			 iter != mPendingDownloads.end(); ++iter )
+		LLAssetRequestQueue::request_vec_t pending;
+		mDownloadQueue.getRequests(uuid, type, pending);
+		for (LLAssetRequestQueue::request_vec_t::iterator iter = pending.begin();
+			 iter != pending.end(); ++iter)
 		{
-			LLAssetRequest  *tmp = *iter;
-			if ((type == tmp->getType()) && (uuid == tmp->getUUID()))
+			LLAssetRequest *tmp = *iter;
+			if (callback == tmp->mDownCallback && user_data == tmp->mUserData)
 			{
-				if (callback == tmp->mDownCallback && user_data == tmp->mUserData)
-				{
-					// this is a duplicate from the same subsystem - throw it away
-					llwarns << "Discarding duplicate request for asset " << uuid
-							<< "." << LLAssetType::lookup(type) << llendl;
-					return;
-				}
-				
-				// this is a duplicate request
-				// queue the request, but don't actually ask for it again
-				duplicate = TRUE;
+				// this is a duplicate from the same subsystem - throw it away
+				llwarns << "Discarding duplicate request for asset " << uuid
+						<< "." << LLAssetType::lookup(type) << llendl;
+				return;
 			}
 		}
+
+		// if so, queue the request, but don't actually ask for it again
+		BOOL duplicate = !pending.empty();
 		if (duplicate)
 		{
 			llinfos << "Adding additional non-duplicate request for asset " << uuid 
@@ -510,7 +543,22 @@ void LLAssetStorage::getAssetData(const LLUUID uuid, LLAssetType::EType type, LL
 		// This can be overridden by subclasses
 		_queueDataRequest(uuid, type, callback, user_data, duplicate, is_priority);	
 	}
+}
 
+void LLAssetStorage::_checkDeferredRequests()
+{
+	if (mDeferredRequests.empty())
+	{
+		return;
+	}
+
+	// Callbacks may ask for more assets, work on a copy.
+	deferred_list_t deferred;
+	deferred.swap(mDeferredRequests);
+	for (deferred_list_t::iterator iter = deferred.begin(); iter != deferred.end(); ++iter)
+	{
+		_checkVFSAndQueue(iter->mUUID, iter->mType, iter->mCallback, iter->mUserData, iter->mIsPriority);
+	}
 }
 
 void LLAssetStorage::_queueDataRequest(const LLUUID& uuid, LLAssetType::EType atype,
@@ -526,23 +574,13 @@ void LLAssetStorage::_queueDataRequest(const LLUUID& uuid, LLAssetType::EType at
 		req->mUserData = user_data;
 		req->mIsPriority = is_priority;
 	
-		mPendingDownloads.push_back(req);
+		addRequest(RT_DOWNLOAD, req);
 	
 		if (!duplicate)
 		{
-			// send request message to our upstream data provider
-			// Create a new asset transfer.
-			LLTransferSourceParamsAsset spa;
-			spa.setAsset(uuid, atype);
-
-			// Set our destination file, and the completion callback.
-			LLTransferTargetParamsVFile tpvf;
-			tpvf.setAsset(uuid, atype);
-			tpvf.setCallback(downloadCompleteCallback, req);
-
-			llinfos << "Starting transfer for " << uuid << llendl;
-			LLTransferTargetChannel *ttcp = gTransferManager.getTargetChannel(mUpstreamHost, LLTCT_ASSET);
-			ttcp->requestTransfer(spa, tpvf, 100.f + (is_priority ? 1.f : 0.f));
+			// The request to our upstream data provider goes out with the
+			// next batch, from checkForTimeouts().
+			mDownloadQueue.queueDispatch(req, is_priority);
 		}
 	}
 	else
@@ -557,6 +595,23 @@ void LLAssetStorage::_queueDataRequest(const LLUUID& uuid, LLAssetType::EType at
 }
 
 
+void LLAssetStorage::sendRequest(LLAssetRequest* req)
+{
+	// send request message to our upstream data provider
+	// Create a new asset transfer.
+	LLTransferSourceParamsAsset spa;
+	spa.setAsset(req->getUUID(), req->getType());
+
+	// Set our destination file, and the completion callback.
+	LLTransferTargetParamsVFile tpvf;
+	tpvf.setAsset(req->getUUID(), req->getType());
+	tpvf.setCallback(downloadCompleteCallback, req);
+
+	llinfos << "Starting transfer for " << req->getUUID() << llendl;
+	LLTransferTargetChannel *ttcp = gTransferManager.getTargetChannel(mUpstreamHost, LLTCT_ASSET);
+	ttcp->requestTransfer(spa, tpvf, 100.f + (req->mIsPriority ? 1.f : 0.f));
+}
+
 void LLAssetStorage::downloadCompleteCallback(
 	S32 result,
 	const LLUUID& file_id,
@@ -580,14 +635,9 @@ void LLAssetStorage::downloadCompleteCallback(
 		return;
 	}
 
-	// Inefficient since we're doing a find through a list that may have thousands of elements.
-	// This is due for refactoring; we will probably change mPendingDownloads into a set.
-	request_list_t::iterator download_iter = std::find(gAssetStorage->mPendingDownloads.begin(), 
-													   gAssetStorage->mPendingDownloads.end(),
-													   req);
 	// If the LLAssetRequest doesn't exist in the downloads queue, then it either has already been deleted
 	// by _cleanupRequests, or it's a transfer.
-	if (download_iter != gAssetStorage->mPendingDownloads.end())
+	if (gAssetStorage->mDownloadQueue.contains(file_id, file_type, req))
 	{
 		req->setUUID(file_id);
 		req->setType(file_type);
@@ -609,23 +659,17 @@ void LLAssetStorage::downloadCompleteCallback(
 	// find and callback ALL pending requests for this UUID
 	// SJB: We process the callbacks in reverse order, I do not know if this is important,
 	//      but I didn't want to mess with it.
-	request_list_t requests;
-	for (request_list_t::iterator iter = gAssetStorage->mPendingDownloads.begin();
-		 iter != gAssetStorage->mPendingDownloads.end();  )
+	LLAssetRequestQueue::request_vec_t requests;
+	gAssetStorage->mDownloadQueue.getRequests(file_id, file_type, requests);
+	for (LLAssetRequestQueue::request_vec_t::iterator iter = requests.begin();
+		 iter != requests.end(); ++iter)
 	{
-		request_list_t::iterator curiter = iter++;
-		LLAssetRequest* tmp = *curiter;
-		if ((tmp->getUUID() == file_id) && (tmp->getType()== file_type))
-		{
-			requests.push_front(tmp);
-			iter = gAssetStorage->mPendingDownloads.erase(curiter);
-		}
+		gAssetStorage->mDownloadQueue.remove(*iter);
 	}
-	for (request_list_t::iterator iter = requests.begin();
-		 iter != requests.end();  )
+	for (LLAssetRequestQueue::request_vec_t::reverse_iterator iter = requests.rbegin();
+		 iter != requests.rend(); ++iter)
 	{
-		request_list_t::iterator curiter = iter++;
-		LLAssetRequest* tmp = *curiter;
+		LLAssetRequest* tmp = *iter;
 		if (tmp->mDownCallback)
 		{
 			tmp->mDownCallback(gAssetStorage->mVFS, req->getUUID(), req->getType(), tmp->mUserData, result, ext_status);
@@ -1044,6 +1088,44 @@ std::string LLAssetStorage::getRequestName(LLAssetStorage::ERequestType rt)
 	}
 }
 
+void LLAssetStorage::addRequest(LLAssetStorage::ERequestType rt, LLAssetRequest* req, bool at_front)
+{
+	if (RT_DOWNLOAD == rt)
+	{
+		mDownloadQueue.add(req, at_front);
+	}
+	else if (at_front)
+	{
+		getRequestList(rt)->push_front(req);
+	}
+	else
+	{
+		getRequestList(rt)->push_back(req);
+	}
+}
+
+void LLAssetStorage::removeRequest(LLAssetStorage::ERequestType rt, LLAssetRequest* req)
+{
+	if (RT_DOWNLOAD == rt)
+	{
+		mDownloadQueue.remove(req);
+	}
+	else
+	{
+		getRequestList(rt)->remove(req);
+	}
+}
+
+LLAssetStorage::request_list_t::iterator LLAssetStorage::eraseRequest(LLAssetStorage::ERequestType rt,
+																	   LLAssetStorage::request_list_t::iterator iter)
+{
+	if (RT_DOWNLOAD == rt)
+	{
+		return mDownloadQueue.erase(iter);
+	}
+	return getRequestList(rt)->erase(iter);
+}
+
 S32 LLAssetStorage::getNumPending(LLAssetStorage::ERequestType rt) const
 {
 	const request_list_t* requests = getRequestList(rt);
@@ -1207,7 +1289,14 @@ bool LLAssetStorage::deletePendingRequestImpl(LLAssetStorage::request_list_t* re
 	if (req)
 	{
 		// Remove the request from this list.
-		requests->remove(req);
+		if (requests == &mPendingDownloads)
+		{
+			mDownloadQueue.remove(req);
+		}
+		else
+		{
+			requests->remove(req);
+		}
 		S32 error = LL_ERR_TCP_TIMEOUT;
 		// Run callbacks.
 		if (req->mUpCallback)
@@ -1275,13 +1364,13 @@ const char* LLAssetStorage::getErrorString(S32 status)
 void LLAssetStorage::getAssetData(const LLUUID uuid, LLAssetType::EType type, void (*callback)(const char*, const LLUUID&, void *, S32, LLExtStat), void *user_data, BOOL is_priority)
 {
 	// check for duplicates here, since we're about to fool the normal duplicate checker
-	for (request_list_t::iterator iter = mPendingDownloads.begin();
-		 iter != mPendingDownloads.end();  )
+	LLAssetRequestQueue::request_vec_t pending;
+	mDownloadQueue.getRequests(uuid, type, pending);
+	for (LLAssetRequestQueue::request_vec_t::iterator iter = pending.begin();
+		 iter != pending.end(); ++iter)
 	{
-		LLAssetRequest* tmp = *iter++;
-		if (type == tmp->getType() && 
-			uuid == tmp->getUUID() &&
-			legacyGetDataCallback == tmp->mDownCallback &&
+		LLAssetRequest* tmp = *iter;
+		if (legacyGetDataCallback == tmp->mDownCallback &&
 			callback == ((LLLegacyAssetRequest *)tmp->mUserData)->mDownCallback &&
 			user_data == ((LLLegacyAssetRequest *)tmp->mUserData)->mUserData)
 		{
@@ -30,6 +30,7 @@
 
 #include <string>
 
+#include "llassetrequestqueue.h"
 #include "lluuid.h"
 #include "lltimer.h"
 #include "llnamevalue.h"
@@ -207,7 +208,7 @@ public:
 								  const std::string& host_name) = 0;
 };
 
-class LLAssetStorage : public LLTempAssetStorage
+class LLAssetStorage : public LLTempAssetStorage, public LLAssetRequestQueue::Dispatcher
 {
 public:
 	// VFS member is public because static child methods need it :(
@@ -236,6 +237,25 @@ protected:
 	request_list_t mPendingDownloads;
 	request_list_t mPendingUploads;
 	request_list_t mPendingLocalUploads;
+
+	// Indexes mPendingDownloads by asset and batches the network requests
+	// for it. Change mPendingDownloads through addRequest(),
+	// removeRequest() and eraseRequest() only.
+	LLAssetRequestQueue mDownloadQueue;
+	S32 mMaxDispatchPerCheck;
+
+	// Requests for assets that were still being written to the VFS when
+	// asked for, looked at again in checkForTimeouts().
+	struct DeferredRequest
+	{
+		LLUUID mUUID;
+		LLAssetType::EType mType;
+		LLGetAssetCallback mCallback;
+		void* mUserData;
+		BOOL mIsPriority;
+	};
+	typedef std::vector<DeferredRequest> deferred_list_t;
+	deferred_list_t mDeferredRequests;
 	
 	// Map of toxic assets - these caused problems when recently rezzed, so avoid them
 	toxic_asset_map_t	mToxicAssetMap;		// Objects in this list are known to cause problems and are not loaded
@@ -290,6 +310,10 @@ public:
 
 	virtual void checkForTimeouts();
 
+	// At most this many new asset downloads are started per
+	// checkForTimeouts(), priority requests first. 0 for no limit.
+	void setMaxDispatchPerCheck(S32 max_count) { mMaxDispatchPerCheck = max_count; }
+
 	void getEstateAsset(const LLHost &object_sim, const LLUUID &agent_id, const LLUUID &session_id,
 									const LLUUID &asset_id, LLAssetType::EType atype, EstateAssetType etype,
 									 LLGetAssetCallback callback, void *user_data, BOOL is_priority);
@@ -335,6 +359,9 @@ public:
 
 	request_list_t* getRequestList(ERequestType rt);
 	const request_list_t* getRequestList(ERequestType rt) const;
+	void addRequest(ERequestType rt, LLAssetRequest* req, bool at_front = false);
+	void removeRequest(ERequestType rt, LLAssetRequest* req);
+	request_list_t::iterator eraseRequest(ERequestType rt, request_list_t::iterator iter);
 	static std::string getRequestName(ERequestType rt);
 
 	S32 getNumPendingDownloads() const;
@@ -436,6 +463,14 @@ protected:
 								   void *user_data, BOOL duplicate,
 								   BOOL is_priority);
 
+	// Sends the upstream request for a download queued by _queueDataRequest().
+	virtual void sendRequest(LLAssetRequest* req);
+
+	// Answers from the VFS if the asset is there, otherwise queues it.
+	void _checkVFSAndQueue(const LLUUID& uuid, LLAssetType::EType type,
+						   LLGetAssetCallback callback, void *user_data, BOOL is_priority);
+	void _checkDeferredRequests();
+
 private:
 	void _init(LLMessageSystem *msg,
 			   LLXferManager *xfer,
@@ -61,8 +61,6 @@ const S32 PING_START_BLOCK = 3;		// How many pings behind we have to be to consi
 const S32 PING_RELEASE_BLOCK = 2;	// How many pings behind we have to be to consider ourself unblocked.
 
 const F32 TARGET_PERIOD_LENGTH = 5.f;	// seconds
-const F32 LL_DUPLICATE_SUPPRESSION_TIMEOUT = 60.f; //seconds - this can be long, as time-based cleanup is
-													// only done when wrapping packetids, now...
 
 LLCircuitData::LLCircuitData(const LLHost &host, TPACKETID in_id, 
 							 const F32 circuit_heartbeat_interval, const F32 circuit_timeout)
@@ -103,6 +101,11 @@ LLCircuitData::LLCircuitData(const LLHost &host, TPACKETID in_id,
 	mPeriodTime(0.0),
 	mExistenceTimer(),
 	mCurrentResendCount(0),
+	mResentPackets(0),
+	mCongestionPacketsOut(0),
+	mCongestionPacketsIn(0),
+	mCongestionResentPackets(0),
+	mCongestionPacketsLost(0),
 	mLastPacketGap(0),
 	mHeartbeatInterval(circuit_heartbeat_interval), 
 	mHeartbeatTimeout(circuit_timeout)
@@ -274,16 +277,23 @@ S32 LLCircuitData::resendUnackedPackets(const F64 now)
 
 
 	//
-	// Theoretically we should search through the list for the packet with the oldest
-	// packet ID, as otherwise when we WRAP we will resend reliable packets out of order.
-	// Since resends are ALREADY out of order, and wrapping is highly rare (16+million packets),
-	// I'm not going to worry about this for now - djs
+	// Packets are resent in the order they expire rather than by packet ID, so
+	// wrapping IDs don't change anything here.
 	//
 
-	reliable_iter iter;
+	mResendWheel.advance(now, mDueResends);
+
 	BOOL have_resend_overflow = FALSE;
-	for (iter = mUnackedPackets.begin(); iter != mUnackedPackets.end();)
+	LLTimerWheel::entry_list_t::iterator due_iter;
+	for (due_iter = mDueResends.begin(); due_iter != mDueResends.end(); ++due_iter)
 	{
+		reliable_iter iter = mUnackedPackets.find(due_iter->mID);
+		if ((iter == mUnackedPackets.end())
+			|| (iter->second->mExpirationTime != due_iter->mWhen))
+		{
+			// Acked or rescheduled since, nothing to do.
+			continue;
+		}
 		packetp = iter->second;
 
 		// Only check overflow if we haven't had one yet.
@@ -300,19 +310,13 @@ S32 LLCircuitData::resendUnackedPackets(const F64 now)
 			// If we have too many unacked packets, we need to start dropping expired ones.
 			if (mUnackedPacketBytes > 512000)
 			{
-				if (now > packetp->mExpirationTime)
-				{
-					// This circuit has overflowed.  Do not retry.  Do not pass go.
-					packetp->mRetries = 0;
-					// Remove it from this list and add it to the final list.
-					mUnackedPackets.erase(iter++);
-					mFinalRetryPackets[packetp->mPacketID] = packetp;
-				}
-				else
-				{
-					++iter;
-				}
-				// Move on to the next unacked packet.
+				// This circuit has overflowed.  Do not retry.  Do not pass go.
+				packetp->mRetries = 0;
+				// Remove it from this list and add it to the final list.
+				mUnackedPackets.erase(iter);
+				mFinalRetryPackets[packetp->mPacketID] = packetp;
+				mFinalRetryWheel.schedule(packetp->mPacketID, packetp->mExpirationTime);
+				// Move on to the next expired packet.
 				continue;
 			}
 			
@@ -326,101 +330,101 @@ S32 LLCircuitData::resendUnackedPackets(const F64 now)
 			break;
 		}
 
-		if (now > packetp->mExpirationTime)
-		{
-			packetp->mRetries--;
-			
-			// retry		
-			mCurrentResendCount++;
+		packetp->mRetries--;
+		
+		// retry		
+		mCurrentResendCount++;
+		mResentPackets++;
 
-			gMessageSystem->mResentPackets++;
+		gMessageSystem->mResentPackets++;
 
-			if(gMessageSystem->mVerboseLog)
-			{
-				std::ostringstream str;
-				str << "MSG: -> " << packetp->mHost
-					<< "\tRESENDING RELIABLE:\t" << packetp->mPacketID;
-				llinfos << str.str() << llendl;
-			}
+		if(gMessageSystem->mVerboseLog)
+		{
+			std::ostringstream str;
+			str << "MSG: -> " << packetp->mHost
+				<< "\tRESENDING RELIABLE:\t" << packetp->mPacketID;
+			llinfos << str.str() << llendl;
+		}
 
-			packetp->mBuffer[0] |= LL_RESENT_FLAG;  // tag packet id as being a resend	
+		packetp->mBuffer[0] |= LL_RESENT_FLAG;  // tag packet id as being a resend	
 
-			gMessageSystem->mPacketRing.sendPacket(packetp->mSocket, 
-											   (char *)packetp->mBuffer, packetp->mBufferLength, 
-											   packetp->mHost);
+		gMessageSystem->mPacketRing.sendPacket(packetp->mSocket, 
+										   (char *)packetp->mBuffer, packetp->mBufferLength, 
+										   packetp->mHost);
 
-			mThrottles.throttleOverflow(TC_RESEND, packetp->mBufferLength * 8.f);
+		mThrottles.throttleOverflow(TC_RESEND, packetp->mBufferLength * 8.f);
 
-			// The new method, retry time based on ping
-			if (packetp->mPingBasedRetry)
-			{
-				packetp->mExpirationTime = now + llmax(LL_MINIMUM_RELIABLE_TIMEOUT_SECONDS, (LL_RELIABLE_TIMEOUT_FACTOR * getPingDelayAveraged()));
-			}
-			else
-			{
-				// custom, constant retry time
-				packetp->mExpirationTime = now + packetp->mTimeout;
-			}
+		// The new method, retry time based on ping
+		if (packetp->mPingBasedRetry)
+		{
+			packetp->mExpirationTime = now + llmax(LL_MINIMUM_RELIABLE_TIMEOUT_SECONDS, (LL_RELIABLE_TIMEOUT_FACTOR * getPingDelayAveraged()));
+		}
+		else
+		{
+			// custom, constant retry time
+			packetp->mExpirationTime = now + packetp->mTimeout;
+		}
 
-			if (!packetp->mRetries)
-			{
-				// Last resend, remove it from this list and add it to the final list.
-				mUnackedPackets.erase(iter++);
-				mFinalRetryPackets[packetp->mPacketID] = packetp;
-			}
-			else
-			{
-				// Don't remove it yet, it still gets to try to resend at least once.
-				++iter;
-			}
-			resent_packets++;
+		if (!packetp->mRetries)
+		{
+			// Last resend, remove it from this list and add it to the final list.
+			mUnackedPackets.erase(iter);
+			mFinalRetryPackets[packetp->mPacketID] = packetp;
+			mFinalRetryWheel.schedule(packetp->mPacketID, packetp->mExpirationTime);
 		}
 		else
 		{
-			// Don't need to do anything with this packet, keep iterating.
-			++iter;
+			// Don't remove it yet, it still gets to try to resend at least once.
+			mResendWheel.schedule(packetp->mPacketID, packetp->mExpirationTime);
 		}
+		resent_packets++;
 	}
 
+	// Whatever the throttle held back goes first next time.
+	mDueResends.erase(mDueResends.begin(), due_iter);
 
-	for (iter = mFinalRetryPackets.begin(); iter != mFinalRetryPackets.end();)
-	{
-		packetp = iter->second;
-		if (now > packetp->mExpirationTime)
-		{
-			// fail (too many retries)
-			//llinfos << "Packet " << packetp->mPacketID << " removed from the pending list: exceeded retry limit" << llendl;
-			//if (packetp->mMessageName)
-			//{
-			//	llinfos << "Packet name " << packetp->mMessageName << llendl;
-			//}
-			gMessageSystem->mFailedResendPackets++;
 
-			if(gMessageSystem->mVerboseLog)
-			{
-				std::ostringstream str;
-				str << "MSG: -> " << packetp->mHost << "\tABORTING RELIABLE:\t"
-					<< packetp->mPacketID;
-				llinfos << str.str() << llendl;
-			}
+	mFinalRetryWheel.advance(now, mDueFinalRetries);
 
-			if (packetp->mCallback)
-			{
-				packetp->mCallback(packetp->mCallbackData,LL_ERR_TCP_TIMEOUT);
-			}
+	for (due_iter = mDueFinalRetries.begin(); due_iter != mDueFinalRetries.end(); ++due_iter)
+	{
+		reliable_iter iter = mFinalRetryPackets.find(due_iter->mID);
+		if ((iter == mFinalRetryPackets.end())
+			|| (iter->second->mExpirationTime != due_iter->mWhen))
+		{
+			continue;
+		}
+		packetp = iter->second;
 
-			// Update stats
-			mUnackedPacketCount--;
-			mUnackedPacketBytes -= packetp->mBufferLength;
+		// fail (too many retries)
+		//llinfos << "Packet " << packetp->mPacketID << " removed from the pending list: exceeded retry limit" << llendl;
+		//if (packetp->mMessageName)
+		//{
+		//	llinfos << "Packet name " << packetp->mMessageName << llendl;
+		//}
+		gMessageSystem->mFailedResendPackets++;
 
-			mFinalRetryPackets.erase(iter++);
-			delete packetp;
+		if(gMessageSystem->mVerboseLog)
+		{
+			std::ostringstream str;
+			str << "MSG: -> " << packetp->mHost << "\tABORTING RELIABLE:\t"
+				<< packetp->mPacketID;
+			llinfos << str.str() << llendl;
 		}
-		else
+
+		if (packetp->mCallback)
 		{
-			++iter;
+			packetp->mCallback(packetp->mCallbackData,LL_ERR_TCP_TIMEOUT);
 		}
+
+		// Update stats
+		mUnackedPacketCount--;
+		mUnackedPacketBytes -= packetp->mBufferLength;
+
+		mFinalRetryPackets.erase(iter);
+		delete packetp;
 	}
+	mDueFinalRetries.clear();
 
 	return mUnackedPacketCount;
 }
@@ -573,10 +577,12 @@ void LLCircuitData::addReliablePacket(S32 mSocket, U8 *buf_ptr, S32 buf_len, LLR
 	if (params && params->mRetries)
 	{
 		mUnackedPackets[packet_info->mPacketID] = packet_info;
+		mResendWheel.schedule(packet_info->mPacketID, packet_info->mExpirationTime);
 	}
 	else
 	{
 		mFinalRetryPackets[packet_info->mPacketID] = packet_info;
+		mFinalRetryWheel.schedule(packet_info->mPacketID, packet_info->mExpirationTime);
 	}
 }
 
@@ -600,7 +606,7 @@ void LLCircuit::resendUnackedPackets(S32& unacked_list_length, S32& unacked_list
 
 BOOL LLCircuitData::isDuplicateResend(TPACKETID packetnum)
 {
-	return (mRecentlyReceivedReliablePackets.find(packetnum) != mRecentlyReceivedReliablePackets.end());
+	return mRecentlyReceivedReliablePackets.contains(packetnum);
 }
 
 
@@ -826,6 +832,7 @@ void LLCircuit::updateWatchDogTimers(LLMessageSystem *msgsys)
 				mPingSet.insert(cdp);
     
 			    // Update our throttles
+			    cdp->updateCongestionControl();
 			    cdp->mThrottles.dynamicAdjust();
     
 			    // Update some stats, this is not terribly important
@@ -992,52 +999,38 @@ BOOL LLCircuitData::updateWatchDogTimers(LLMessageSystem *msgsys)
 }
 
 
-void LLCircuitData::clearDuplicateList(TPACKETID oldest_id)
+void LLCircuitData::updateCongestionControl()
 {
-	// purge old data from the duplicate suppression queue
-
-	// we want to KEEP all x where oldest_id <= x <= last incoming packet, and delete everything else.
-
-	//llinfos << mHost << ": clearing before oldest " << oldest_id << llendl;
-	//llinfos << "Recent list before: " << mRecentlyReceivedReliablePackets.size() << llendl;
-	if (oldest_id < mHighestPacketID)
+	U32 packets_out = mPacketsOut - mCongestionPacketsOut;
+	U32 packets_in = mPacketsIn - mCongestionPacketsIn;
+	U32 resent = mResentPackets - mCongestionResentPackets;
+	S32 lost = mPacketsLost - mCongestionPacketsLost;
+	mCongestionPacketsOut = mPacketsOut;
+	mCongestionPacketsIn = mPacketsIn;
+	mCongestionResentPackets = mResentPackets;
+	mCongestionPacketsLost = mPacketsLost;
+
+	if (!mThrottles.getCongestionControl())
 	{
-		// Clean up everything with a packet ID less than oldest_id.
-		packet_time_map::iterator pit_start;
-		packet_time_map::iterator pit_end;
-		pit_start = mRecentlyReceivedReliablePackets.begin();
-		pit_end = mRecentlyReceivedReliablePackets.lower_bound(oldest_id);
-		mRecentlyReceivedReliablePackets.erase(pit_start, pit_end);
+		return;
 	}
 
-	// Do timeout checks on everything with an ID > mHighestPacketID.
-	// This should be empty except for wrapping IDs.  Thus, this should be
-	// highly rare.
-	U64 mt_usec = LLMessageSystem::getMessageTimeUsecs();
+	// Resends stand in for loss on the way out, gaps in the incoming
+	// sequence for loss on the way in.  Either one means the link is full.
+	F32 loss_out = packets_out ? (F32)resent / (F32)packets_out : 0.f;
+	F32 loss_in = (packets_in + lost > 0) ? (F32)lost / (F32)(packets_in + lost) : 0.f;
+	mThrottles.updateCongestion((F32)mPingDelay, llclamp(llmax(loss_out, loss_in), 0.f, 1.f));
+}
 
-	packet_time_map::iterator pit;
-	for(pit = mRecentlyReceivedReliablePackets.upper_bound(mHighestPacketID);
-		pit != mRecentlyReceivedReliablePackets.end(); )
-	{
-		// Validate that the packet ID seems far enough away
-		if ((pit->first - mHighestPacketID) < 100)
-		{
-			llwarns << "Probably incorrectly timing out non-wrapped packets!" << llendl;
-		}
-		U64 delta_t_usec = mt_usec - (*pit).second;
-		F64 delta_t_sec = delta_t_usec * SEC_PER_USEC;
-		if (delta_t_sec > LL_DUPLICATE_SUPPRESSION_TIMEOUT)
-		{
-			// enough time has elapsed we're not likely to get a duplicate on this one
-			llinfos << "Clearing " << pit->first << " from recent list" << llendl;
-			mRecentlyReceivedReliablePackets.erase(pit++);
-		}
-		else
-		{
-			++pit;
-		}
-	}
-	//llinfos << "Recent list after: " << mRecentlyReceivedReliablePackets.size() << llendl;
+
+void LLCircuitData::clearDuplicateList(TPACKETID oldest_id)
+{
+	// purge old data from the duplicate suppression window
+
+	// The sender has given up on or had acked everything before oldest_id,
+	// so those can't come in again as resends.  The window deals with
+	// wrapping packet IDs on its own.
+	mRecentlyReceivedReliablePackets.forgetBefore(oldest_id);
 }
 
 BOOL LLCircuitData::checkCircuitTimeout()
@@ -38,6 +38,8 @@
 #include "net.h"
 #include "llhost.h"
 #include "llpacketack.h"
+#include "llpacketidwindow.h"
+#include "lltimerwheel.h"
 #include "lluuid.h"
 #include "llthrottle.h"
 #include "llstat.h"
@@ -174,6 +176,7 @@ protected:
 	U8				nextPingID()			{ mLastPingID++; return mLastPingID; }
 
 	BOOL			updateWatchDogTimers(LLMessageSystem *msgsys);	// Return FALSE if the circuit is dead and should be cleaned up
+	void			updateCongestionControl();	// Feeds ping and loss since the last call to the throttles
 
 	void			addReliablePacket(S32 mSocket, U8 *buf_ptr, S32 buf_len, LLReliablePacketParams *params);
 	BOOL			isDuplicateResend(TPACKETID packetnum);
@@ -236,7 +239,7 @@ protected:
 	typedef std::map<TPACKETID, U64> packet_time_map;
 
 	packet_time_map							mPotentialLostPackets;
-	packet_time_map							mRecentlyReceivedReliablePackets;
+	LLPacketIDWindow						mRecentlyReceivedReliablePackets;
 	std::vector<TPACKETID> mAcks;
 
 	typedef std::map<TPACKETID, LLReliablePacket *> reliable_map;
@@ -245,6 +248,14 @@ protected:
 	reliable_map							mUnackedPackets;
 	reliable_map							mFinalRetryPackets;
 
+	// Expiration times of the packets above, so resendUnackedPackets()
+	// only has to look at the packets that are due. Entries left
+	// behind by acks and resends are skipped when they come due.
+	LLTimerWheel							mResendWheel;
+	LLTimerWheel							mFinalRetryWheel;
+	LLTimerWheel::entry_list_t				mDueResends;	// due, but held back by the resend throttle
+	LLTimerWheel::entry_list_t				mDueFinalRetries;
+
 	S32										mUnackedPacketCount;
 	S32										mUnackedPacketBytes;
 
@@ -273,6 +284,13 @@ protected:
 	LLTimer	mExistenceTimer;	    // initialized when circuit created, used to track bandwidth numbers
 
 	S32		mCurrentResendCount;	// Number of resent packets since last spam
+	U32		mResentPackets;			// Number of resent packets, ever
+
+	// Counters as of the last congestion control sample.
+	U32		mCongestionPacketsOut;
+	U32		mCongestionPacketsIn;
+	U32		mCongestionResentPackets;
+	S32		mCongestionPacketsLost;
     LLStatRate  mOutOfOrderRate;    // Rate of out of order packets coming in.
     U32     mLastPacketGap;         // Gap in sequence number of last packet.
 
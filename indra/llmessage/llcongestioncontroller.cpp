@@ -0,0 +1,107 @@
+/** 
+ * @file llcongestioncontroller.cpp
+ * @brief Delay and loss based bandwidth scaling for throttles.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ * 
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ * 
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ * 
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "llcongestioncontroller.h"
+
+#include "llmath.h"
+
+const F32 DEFAULT_TARGET_DELAY_MS = 100.f;	// queueing delay we are happy to add to the link
+const F32 DEFAULT_LOSS_THRESHOLD = 0.02f;	// fraction of packets lost before backing off
+const F32 DELAY_GAIN = 0.1f;				// largest change per sample, as a fraction of the scale
+const F32 LOSS_BACKOFF = 0.7f;				// smallest multiplier applied on loss
+const S32 SAMPLES_PER_BUCKET = 6;			// with 5 second pings, 30 seconds per bucket
+
+LLCongestionController::LLCongestionController(F32 min_scale, F32 max_scale)
+:	mMinScale(min_scale),
+	mMaxScale(max_scale),
+	mTargetDelay(DEFAULT_TARGET_DELAY_MS),
+	mLossThreshold(DEFAULT_LOSS_THRESHOLD)
+{
+	reset();
+}
+
+void LLCongestionController::reset()
+{
+	// Start wide open, like the fixed throttles did.
+	mScale = mMaxScale;
+	mBaseHistoryCount = 0;
+	mSamplesInBucket = 0;
+	mBaseDelay = 0.f;
+	mQueueingDelay = 0.f;
+}
+
+void LLCongestionController::updateBaseDelay(F32 rtt_ms)
+{
+	if (!mBaseHistoryCount || mSamplesInBucket >= SAMPLES_PER_BUCKET)
+	{
+		// Start a new bucket, dropping the oldest if full.
+		if (mBaseHistoryCount == BASE_HISTORY_SIZE)
+		{
+			for (S32 i = 1; i < BASE_HISTORY_SIZE; i++)
+			{
+				mBaseHistory[i - 1] = mBaseHistory[i];
+			}
+			mBaseHistoryCount--;
+		}
+		mBaseHistory[mBaseHistoryCount++] = rtt_ms;
+		mSamplesInBucket = 0;
+	}
+	mSamplesInBucket++;
+
+	F32& current = mBaseHistory[mBaseHistoryCount - 1];
+	current = llmin(current, rtt_ms);
+
+	mBaseDelay = mBaseHistory[0];
+	for (S32 i = 1; i < mBaseHistoryCount; i++)
+	{
+		mBaseDelay = llmin(mBaseDelay, mBaseHistory[i]);
+	}
+}
+
+F32 LLCongestionController::update(F32 rtt_ms, F32 loss_fraction)
+{
+	updateBaseDelay(rtt_ms);
+	mQueueingDelay = rtt_ms - mBaseDelay;
+
+	if (loss_fraction > mLossThreshold)
+	{
+		// What got through is roughly what the link can carry, so back
+		// off at least that far.
+		mScale *= llmin(LOSS_BACKOFF, 1.f - loss_fraction);
+	}
+	else
+	{
+		F32 off_target = llclamp((mTargetDelay - mQueueingDelay) / mTargetDelay, -1.f, 1.f);
+		// Proportional to the scale, so low rates don't overshoot the link
+		// by a large fraction each step.
+		mScale += DELAY_GAIN * off_target * mScale;
+	}
+
+	mScale = llclamp(mScale, mMinScale, mMaxScale);
+	return mScale;
+}
@@ -0,0 +1,87 @@
+/** 
+ * @file llcongestioncontroller.h
+ * @brief Delay and loss based bandwidth scaling for throttles.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ * 
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ * 
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ * 
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLCONGESTIONCONTROLLER_H
+#define LL_LLCONGESTIONCONTROLLER_H
+
+/**
+ * @class LLCongestionController
+ * @brief Scales a bandwidth budget to what the link is taking.
+ *
+ * Fed one sample at a time with the round trip time and the fraction of
+ * packets lost since the previous sample, in the style of LEDBAT: the
+ * lowest round trip seen over the last few minutes is taken as the base
+ * delay of the link, anything above it as time spent in queues. While
+ * the queueing delay is under the target the scale grows, above it the
+ * scale shrinks in proportion. Loss over the threshold backs the scale
+ * off multiplicatively.
+ *
+ * The controller has no clock of its own, so it behaves the same under
+ * a simulator as on a live circuit.
+ */
+class LLCongestionController
+{
+public:
+	LLCongestionController(F32 min_scale = 0.1f, F32 max_scale = 1.f);
+
+	void reset();
+
+	/**
+	 * @brief Takes a sample and returns the new scale.
+	 *
+	 * @param rtt_ms Measured round trip time, in milliseconds.
+	 * @param loss_fraction 0 to 1, packets lost since the last sample.
+	 */
+	F32 update(F32 rtt_ms, F32 loss_fraction);
+
+	F32 getScale() const				{ return mScale; }
+	F32 getBaseDelay() const			{ return mBaseDelay; }
+	F32 getQueueingDelay() const		{ return mQueueingDelay; }
+
+	void setTargetDelay(F32 ms)			{ mTargetDelay = ms; }
+	void setLossThreshold(F32 fraction)	{ mLossThreshold = fraction; }
+
+private:
+	enum { BASE_HISTORY_SIZE = 10 };
+
+	void updateBaseDelay(F32 rtt_ms);
+
+private:
+	F32 mMinScale;
+	F32 mMaxScale;
+	F32 mScale;
+	F32 mTargetDelay;
+	F32 mLossThreshold;
+
+	// Minimum round trip per bucket of samples, oldest first.
+	F32 mBaseHistory[BASE_HISTORY_SIZE];
+	S32 mBaseHistoryCount;
+	S32 mSamplesInBucket;
+	F32 mBaseDelay;
+	F32 mQueueingDelay;
+};
+
+#endif // LL_LLCONGESTIONCONTROLLER_H
@@ -39,7 +39,9 @@
 #include "llcurl.h"
 
 #include <algorithm>
+#include <deque>
 #include <iomanip>
+#include <set>
 #include <curl/curl.h>
 #if SAFE_SSL
 #include <openssl/crypto.h>
@@ -49,6 +51,7 @@
 #include "llstl.h"
 #include "llsdserialize.h"
 #include "llthread.h"
+#include "lltimer.h"
 
 //////////////////////////////////////////////////////////////////////////////
 /*
@@ -62,8 +65,17 @@
 
 	Furthermore, it would behoove us to keep track of which
 	hosts an easy handle was used for and pick an easy handle
-	that matches the next request.  This code does not current
-	do this.
+	that matches the next request.  LLCurlRequest does not do
+	this.
+
+	LLCurlEasyRequest does it differently: easy handles added to
+	a multi handle use the multi's connection cache, so each
+	thread keeps one LLCurlHostPool (a multi handle) per host,
+	and every request to that host goes through it.  Finished
+	transfers leave their connection in the cache for the next
+	request, the number of concurrent transfers per host is
+	capped, and pipelining can be turned on where libcurl
+	supports it.
  */
 
 //////////////////////////////////////////////////////////////////////////////
@@ -72,6 +84,13 @@ static const U32 EASY_HANDLE_POOL_SIZE		= 5;
 static const S32 MULTI_PERFORM_CALL_REPEAT	= 5;
 static const S32 CURL_REQUEST_TIMEOUT = 30; // seconds
 static const S32 MAX_ACTIVE_REQUEST_COUNT = 100;
+static const U32 DEFAULT_MAX_CONNECTIONS_PER_HOST = 8;
+// How long to wait for a transfer which has no socket yet, such as
+// one still resolving its host name.
+static const S32 NO_SOCKET_WAIT_MS = 10;
+// How long a host pool with no requests keeps its connections before
+// it is freed.
+static const F32 IDLE_HOST_POOL_TIMEOUT = 60.f;
 
 // DEBUG //
 S32 gCurlEasyCount = 0;
@@ -83,6 +102,8 @@ S32 gCurlMultiCount = 0;
 std::vector<LLMutex*> LLCurl::sSSLMutex;
 std::string LLCurl::sCAPath;
 std::string LLCurl::sCAFile;
+U32 LLCurl::sMaxConnectionsPerHost = DEFAULT_MAX_CONNECTIONS_PER_HOST;
+bool LLCurl::sPipelining = false;
 
 //static
 void LLCurl::setCAPath(const std::string& path)
@@ -102,6 +123,18 @@ std::string LLCurl::getVersionString()
 	return std::string(curl_version());
 }
 
+//static
+void LLCurl::setMaxConnectionsPerHost(U32 max)
+{
+	sMaxConnectionsPerHost = llmax(max, (U32)1);
+}
+
+//static
+void LLCurl::setPipelining(bool enable)
+{
+	sPipelining = enable;
+}
+
 //////////////////////////////////////////////////////////////////////////////
 
 LLCurl::Responder::Responder()
@@ -178,12 +211,12 @@ namespace boost
 {
 	void intrusive_ptr_add_ref(LLCurl::Responder* p)
 	{
-		++p->mReferenceCount;
+		p->mReferenceCount++;
 	}
 	
 	void intrusive_ptr_release(LLCurl::Responder* p)
 	{
-		if(p && 0 == --p->mReferenceCount)
+		if(p && 0 == p->mReferenceCount--)
 		{
 			delete p;
 		}
@@ -821,16 +854,542 @@ S32 LLCurlRequest::getQueued()
 	return queued;
 }
 
+////////////////////////////////////////////////////////////////////////////
+// A multi handle shared by all LLCurlEasyRequests to one host from one
+// thread, so that connections are reused between requests.
+
+class LLCurlHostPool
+{
+	LOG_CLASS(LLCurlHostPool);
+public:
+	LLCurlHostPool(const std::string& host);
+	~LLCurlHostPool();
+
+	// Starts the transfer, or queues it if the host is at its limit.
+	void addEasy(LLCurl::Easy* easy);
+	// Cancels a queued or running transfer and drops any result.
+	void removeEasy(LLCurl::Easy* easy);
+	// Drives all transfers, collects results and starts queued ones.
+	S32 perform();
+	// True while the transfer is queued or running.
+	bool isRunning(LLCurl::Easy* easy) const;
+	// Takes the result of a finished transfer, once.
+	bool getResult(LLCurl::Easy* easy, CURLcode* result);
+
+	LLSD getStats();
+	const std::string& getHost() const { return mHost; }
+
+	// Returns the pool for the host of url on the calling thread, with
+	// a reference held for the caller. Frees the thread's pools which
+	// have had no requests for a while.
+	static LLCurlHostPool* getPool(const std::string& url);
+	// Drops a reference taken by getPool().
+	static void releasePool(LLCurlHostPool* pool);
+	// Frees the calling thread's pools, or lets the last request of
+	// each free it.
+	static void cleanupThread();
+	static LLSD getAllStats();
+	// Adds the sockets of the calling thread's transfers to the sets
+	// and lowers timeout_ms to when libcurl next wants to be called.
+	static void fdsetForThread(fd_set* read_fds, fd_set* write_fds, fd_set* exc_fds,
+							   S32* max_fd, S32* timeout_ms);
+	static void initClass();
+	static void cleanupClass();
+
+private:
+	void startPending();
+	void updateCounts();
+
+	static std::string hostKey(const std::string& url);
+	// Keeps the counters of a pool which is going away. sPoolsMutex
+	// must be locked.
+	static void retirePool(LLCurlHostPool* pool);
+	static void addStats(LLSD& total, const LLSD& stats);
+
+private:
+	CURLM* mCurlMultiHandle;
+	std::string mHost;
+
+	typedef std::set<CURL*> active_set_t;
+	active_set_t mActive;
+	typedef std::deque<CURL*> pending_queue_t;
+	pending_queue_t mPending;
+	typedef std::map<CURL*, CURLcode> result_map_t;
+	result_map_t mResults;
+
+	// Statistics. Written by the owning thread and read by
+	// getAllStats() from any thread, hence atomic. mActiveCount and
+	// mQueuedCount mirror the sizes of mActive and mPending.
+	LLAtomicU32 mRequestCount;
+	LLAtomicU32 mCompletedCount;
+	LLAtomicU32 mNewConnections;
+	LLAtomicU32 mReusedConnections;
+	LLAtomicU32 mPeakActive;
+	LLAtomicU32 mPeakQueued;
+	LLAtomicU32 mActiveCount;
+	LLAtomicU32 mQueuedCount;
+
+	// Guarded by sPoolsMutex. The number of LLCurlEasyRequests holding
+	// the pool, how long it has had none, and whether it has left
+	// sPools and belongs to its last request.
+	U32 mRequests;
+	LLTimer mIdleTimer;
+	bool mOrphaned;
+
+	// Pools are only ever touched by the thread that created them, so
+	// curl callbacks always run on the thread which owns the request.
+	typedef std::pair<U32, std::string> pool_key_t;
+	typedef std::map<pool_key_t, LLCurlHostPool*> pool_map_t;
+	static pool_map_t sPools;
+	static LLSD sRetiredStats;
+	static LLMutex* sPoolsMutex;
+};
+
+//static
+LLCurlHostPool::pool_map_t LLCurlHostPool::sPools;
+LLSD LLCurlHostPool::sRetiredStats;
+LLMutex* LLCurlHostPool::sPoolsMutex = NULL;
+
+LLCurlHostPool::LLCurlHostPool(const std::string& host)
+	: mHost(host),
+	  mRequestCount(0),
+	  mCompletedCount(0),
+	  mNewConnections(0),
+	  mReusedConnections(0),
+	  mPeakActive(0),
+	  mPeakQueued(0),
+	  mActiveCount(0),
+	  mQueuedCount(0),
+	  mRequests(0),
+	  mOrphaned(false)
+{
+	mCurlMultiHandle = curl_multi_init();
+	if (!mCurlMultiHandle)
+	{
+		llwarns << "curl_multi_init() returned NULL! Easy handles: " << gCurlEasyCount << " Multi handles: " << gCurlMultiCount << llendl;
+		mCurlMultiHandle = curl_multi_init();
+	}
+	llassert_always(mCurlMultiHandle);
+	++gCurlMultiCount;
+
+#if LIBCURL_VERSION_NUM >= 0x071003
+	// Keep enough idle connections around for a full set of transfers.
+	curl_multi_setopt(mCurlMultiHandle, CURLMOPT_MAXCONNECTS, (long)LLCurl::getMaxConnectionsPerHost());
+#endif
+#if LIBCURL_VERSION_NUM >= 0x071000
+	curl_multi_setopt(mCurlMultiHandle, CURLMOPT_PIPELINING, LLCurl::getPipelining() ? 1L : 0L);
+#endif
+}
+
+LLCurlHostPool::~LLCurlHostPool()
+{
+	for (active_set_t::iterator iter = mActive.begin();
+		 iter != mActive.end(); ++iter)
+	{
+		curl_multi_remove_handle(mCurlMultiHandle, *iter);
+	}
+	curl_multi_cleanup(mCurlMultiHandle);
+	--gCurlMultiCount;
+}
+
+void LLCurlHostPool::addEasy(LLCurl::Easy* easy)
+{
+	mRequestCount++;
+	mPending.push_back(easy->getCurlHandle());
+	if ((U32)mPending.size() > mPeakQueued)
+	{
+		mPeakQueued = (U32)mPending.size();
+	}
+	startPending();
+}
+
+void LLCurlHostPool::removeEasy(LLCurl::Easy* easy)
+{
+	CURL* handle = easy->getCurlHandle();
+	active_set_t::iterator active = mActive.find(handle);
+	if (active != mActive.end())
+	{
+		curl_multi_remove_handle(mCurlMultiHandle, handle);
+		mActive.erase(active);
+	}
+	else
+	{
+		pending_queue_t::iterator pending = std::find(mPending.begin(), mPending.end(), handle);
+		if (pending != mPending.end())
+		{
+			mPending.erase(pending);
+		}
+	}
+	mResults.erase(handle);
+	startPending();
+}
+
+void LLCurlHostPool::startPending()
+{
+	const U32 max_active = LLCurl::getMaxConnectionsPerHost();
+	while (!mPending.empty() && mActive.size() < max_active)
+	{
+		CURL* handle = mPending.front();
+		mPending.pop_front();
+		CURLMcode mcode = curl_multi_add_handle(mCurlMultiHandle, handle);
+		if (mcode != CURLM_OK)
+		{
+			llwarns << "Curl Error: " << curl_multi_strerror(mcode) << llendl;
+			mResults[handle] = CURLE_FAILED_INIT;
+			continue;
+		}
+		mActive.insert(handle);
+	}
+	if ((U32)mActive.size() > mPeakActive)
+	{
+		mPeakActive = (U32)mActive.size();
+	}
+	updateCounts();
+}
+
+void LLCurlHostPool::updateCounts()
+{
+	mActiveCount = (U32)mActive.size();
+	mQueuedCount = (U32)mPending.size();
+}
+
+S32 LLCurlHostPool::perform()
+{
+	S32 q = 0;
+	for (S32 call_count = 0;
+		 call_count < MULTI_PERFORM_CALL_REPEAT;
+		 call_count += 1)
+	{
+		CURLMcode code = curl_multi_perform(mCurlMultiHandle, &q);
+		if (CURLM_CALL_MULTI_PERFORM != code || q == 0)
+		{
+			break;
+		}
+	}
+
+	CURLMsg* msg;
+	int msgs_in_queue;
+	while ((msg = curl_multi_info_read(mCurlMultiHandle, &msgs_in_queue)))
+	{
+		if (msg->msg != CURLMSG_DONE)
+		{
+			continue;
+		}
+		// msg does not survive curl_multi_remove_handle()
+		CURL* handle = msg->easy_handle;
+		CURLcode result = msg->data.result;
+
+		long connects = 0;
+		curl_easy_getinfo(handle, CURLINFO_NUM_CONNECTS, &connects);
+		mNewConnections += (U32)connects;
+		if (0 == connects && CURLE_OK == result)
+		{
+			mReusedConnections++;
+		}
+		mCompletedCount++;
+
+		// Finished transfers leave the multi right away so their slot
+		// goes to the next queued request. The connection stays in
+		// the multi's cache.
+		curl_multi_remove_handle(mCurlMultiHandle, handle);
+		mActive.erase(handle);
+		mResults[handle] = result;
+	}
+
+	startPending();
+	return q;
+}
+
+bool LLCurlHostPool::isRunning(LLCurl::Easy* easy) const
+{
+	CURL* handle = easy->getCurlHandle();
+	if (mActive.find(handle) != mActive.end())
+	{
+		return true;
+	}
+	return std::find(mPending.begin(), mPending.end(), handle) != mPending.end();
+}
+
+bool LLCurlHostPool::getResult(LLCurl::Easy* easy, CURLcode* result)
+{
+	result_map_t::iterator iter = mResults.find(easy->getCurlHandle());
+	if (iter == mResults.end())
+	{
+		return false;
+	}
+	*result = iter->second;
+	mResults.erase(iter);
+	return true;
+}
+
+LLSD LLCurlHostPool::getStats()
+{
+	LLSD stats;
+	stats["requests"] = (S32)mRequestCount;
+	stats["completed"] = (S32)mCompletedCount;
+	stats["new_connections"] = (S32)mNewConnections;
+	stats["reused_connections"] = (S32)mReusedConnections;
+	stats["peak_active"] = (S32)mPeakActive;
+	stats["peak_queued"] = (S32)mPeakQueued;
+	stats["active"] = (S32)mActiveCount;
+	stats["queued"] = (S32)mQueuedCount;
+	return stats;
+}
+
+//static
+std::string LLCurlHostPool::hostKey(const std::string& url)
+{
+	LLURI uri(url);
+	return llformat("%s://%s:%d", uri.scheme().c_str(), uri.hostName().c_str(), (S32)uri.hostPort());
+}
+
+//static
+LLCurlHostPool* LLCurlHostPool::getPool(const std::string& url)
+{
+	pool_key_t key(LLThread::currentID(), hostKey(url));
+	std::vector<LLCurlHostPool*> idle_pools;
+	if (sPoolsMutex) sPoolsMutex->lock();
+	LLCurlHostPool* pool = NULL;
+	pool_map_t::iterator iter = sPools.find(key);
+	if (iter == sPools.end())
+	{
+		pool = new LLCurlHostPool(key.second);
+		sPools[key] = pool;
+	}
+	else
+	{
+		pool = iter->second;
+	}
+	++pool->mRequests;
+
+	iter = sPools.lower_bound(pool_key_t(key.first, std::string()));
+	while (iter != sPools.end() && iter->first.first == key.first)
+	{
+		LLCurlHostPool* other = iter->second;
+		if (0 == other->mRequests
+			&& other->mIdleTimer.getElapsedTimeF32() > IDLE_HOST_POOL_TIMEOUT)
+		{
+			retirePool(other);
+			idle_pools.push_back(other);
+			sPools.erase(iter++);
+		}
+		else
+		{
+			++iter;
+		}
+	}
+	if (sPoolsMutex) sPoolsMutex->unlock();
+
+	// Deleted outside the lock, they are ours and nobody else's
+	for_each(idle_pools.begin(), idle_pools.end(), DeletePointer());
+	return pool;
+}
+
+//static
+void LLCurlHostPool::releasePool(LLCurlHostPool* pool)
+{
+	bool orphaned = false;
+	if (sPoolsMutex) sPoolsMutex->lock();
+	if (0 == --pool->mRequests)
+	{
+		pool->mIdleTimer.reset();
+		orphaned = pool->mOrphaned;
+	}
+	if (sPoolsMutex) sPoolsMutex->unlock();
+	if (orphaned)
+	{
+		delete pool;
+	}
+}
+
+//static
+void LLCurlHostPool::cleanupThread()
+{
+	U32 thread_id = LLThread::currentID();
+	std::vector<LLCurlHostPool*> idle_pools;
+	if (sPoolsMutex) sPoolsMutex->lock();
+	pool_map_t::iterator iter = sPools.lower_bound(pool_key_t(thread_id, std::string()));
+	while (iter != sPools.end() && iter->first.first == thread_id)
+	{
+		LLCurlHostPool* pool = iter->second;
+		retirePool(pool);
+		if (0 == pool->mRequests)
+		{
+			idle_pools.push_back(pool);
+		}
+		else
+		{
+			// Requests still in chains or responders outlive the
+			// thread, the last one to go frees the pool.
+			pool->mOrphaned = true;
+		}
+		sPools.erase(iter++);
+	}
+	if (sPoolsMutex) sPoolsMutex->unlock();
+	for_each(idle_pools.begin(), idle_pools.end(), DeletePointer());
+}
+
+//static
+void LLCurlHostPool::retirePool(LLCurlHostPool* pool)
+{
+	LLSD stats = pool->getStats();
+	stats.erase("active");
+	stats.erase("queued");
+	addStats(sRetiredStats[pool->getHost()], stats);
+}
+
+//static
+void LLCurlHostPool::addStats(LLSD& total, const LLSD& stats)
+{
+	// Same host used from several threads, sum them up.
+	for (LLSD::map_const_iterator stat = stats.beginMap();
+		 stat != stats.endMap(); ++stat)
+	{
+		total[stat->first] = total[stat->first].asInteger() + stat->second.asInteger();
+	}
+}
+
+//static
+LLSD LLCurlHostPool::getAllStats()
+{
+	// Counters of pools owned by other threads may be slightly stale,
+	// but each of them is read atomically.
+	LLSD all = LLSD::emptyMap();
+	if (sPoolsMutex) sPoolsMutex->lock();
+	for (LLSD::map_const_iterator iter = sRetiredStats.beginMap();
+		 iter != sRetiredStats.endMap(); ++iter)
+	{
+		addStats(all[iter->first], iter->second);
+	}
+	for (pool_map_t::const_iterator iter = sPools.begin();
+		 iter != sPools.end(); ++iter)
+	{
+		LLCurlHostPool* pool = iter->second;
+		addStats(all[pool->getHost()], pool->getStats());
+	}
+	if (sPoolsMutex) sPoolsMutex->unlock();
+	return all;
+}
+
+//static
+void LLCurlHostPool::fdsetForThread(fd_set* read_fds, fd_set* write_fds, fd_set* exc_fds,
+									S32* max_fd, S32* timeout_ms)
+{
+	U32 thread_id = LLThread::currentID();
+	if (sPoolsMutex) sPoolsMutex->lock();
+	// Pools of one thread sort together, and only this thread touches
+	// their multi handles.
+	for (pool_map_t::iterator iter = sPools.lower_bound(pool_key_t(thread_id, std::string()));
+		 iter != sPools.end() && iter->first.first == thread_id; ++iter)
+	{
+		LLCurlHostPool* pool = iter->second;
+		if (!pool->mResults.empty())
+		{
+			// a result is waiting for its request to pick it up
+			*timeout_ms = 0;
+		}
+		if (pool->mActive.empty())
+		{
+			continue;
+		}
+
+		int pool_max_fd = -1;
+		curl_multi_fdset(pool->mCurlMultiHandle, read_fds, write_fds, exc_fds, &pool_max_fd);
+		long curl_timeout = -1;
+		curl_multi_timeout(pool->mCurlMultiHandle, &curl_timeout);
+		if (pool_max_fd < 0)
+		{
+			curl_timeout = (curl_timeout < 0) ? NO_SOCKET_WAIT_MS : llmin(curl_timeout, (long)NO_SOCKET_WAIT_MS);
+		}
+		if (curl_timeout >= 0)
+		{
+			*timeout_ms = llmin(*timeout_ms, (S32)curl_timeout);
+		}
+		*max_fd = llmax(*max_fd, (S32)pool_max_fd);
+	}
+	if (sPoolsMutex) sPoolsMutex->unlock();
+}
+
+//static
+void LLCurlHostPool::initClass()
+{
+	sPoolsMutex = new LLMutex(NULL);
+}
+
+//static
+void LLCurlHostPool::cleanupClass()
+{
+	cleanupThread();
+
+	// Other threads clean up their own pools before they stop. Any
+	// left belong to a thread which may still be running, so deleting
+	// them here could pull a multi handle out from under it.
+	if (!sPools.empty())
+	{
+		llwarns << sPools.size() << " curl host pools of other threads were not cleaned up, leaking them" << llendl;
+		sPools.clear();
+	}
+	sRetiredStats.clear();
+	delete sPoolsMutex;
+	sPoolsMutex = NULL;
+}
+
+//static
+LLSD LLCurl::getHostStats()
+{
+	return LLCurlHostPool::getAllStats();
+}
+
+//static
+void LLCurl::cleanupThread()
+{
+	LLCurlHostPool::cleanupThread();
+}
+
+//static
+void LLCurl::waitForTransfers(S32 max_wait_ms, curl_socket_t wake_socket)
+{
+	fd_set read_fds;
+	fd_set write_fds;
+	fd_set exc_fds;
+	FD_ZERO(&read_fds);
+	FD_ZERO(&write_fds);
+	FD_ZERO(&exc_fds);
+	S32 max_fd = -1;
+	S32 timeout_ms = max_wait_ms;
+	LLCurlHostPool::fdsetForThread(&read_fds, &write_fds, &exc_fds, &max_fd, &timeout_ms);
+	if (timeout_ms <= 0)
+	{
+		return;
+	}
+
+	if (wake_socket != CURL_SOCKET_BAD)
+	{
+		FD_SET(wake_socket, &read_fds);
+		max_fd = llmax(max_fd, (S32)wake_socket);
+	}
+	if (max_fd < 0)
+	{
+		ms_sleep(timeout_ms);
+		return;
+	}
+
+	struct timeval timeout;
+	timeout.tv_sec = timeout_ms / 1000;
+	timeout.tv_usec = (timeout_ms % 1000) * 1000;
+	select(max_fd + 1, &read_fds, &write_fds, &exc_fds, &timeout);
+}
+
 ////////////////////////////////////////////////////////////////////////////
 // For generating one easy request
-// associated with a single multi request
+// through the host pool of its URL
 
 LLCurlEasyRequest::LLCurlEasyRequest()
-	: mRequestSent(false),
+	: mHostPool(NULL),
+	  mRequestSent(false),
 	  mResultReturned(false)
 {
-	mMulti = new LLCurl::Multi();
-	mEasy = mMulti->allocEasy();
+	mEasy = LLCurl::Easy::getEasy();
 	if (mEasy)
 	{
 		mEasy->setErrorBuffer();
@@ -840,7 +1399,15 @@ LLCurlEasyRequest::LLCurlEasyRequest()
 
 LLCurlEasyRequest::~LLCurlEasyRequest()
 {
-	delete mMulti;
+	if (mEasy && mHostPool)
+	{
+		mHostPool->removeEasy(mEasy);
+	}
+	delete mEasy;
+	if (mHostPool)
+	{
+		LLCurlHostPool::releasePool(mHostPool);
+	}
 }
 	
 void LLCurlEasyRequest::setopt(CURLoption option, S32 value)
@@ -922,7 +1489,13 @@ void LLCurlEasyRequest::sendRequest(const std::string& url)
 	{
 		mEasy->setHeaders();
 		mEasy->setoptString(CURLOPT_URL, url);
-		mMulti->addEasy(mEasy);
+		LLCurlHostPool* previous_pool = mHostPool;
+		mHostPool = LLCurlHostPool::getPool(url);
+		if (previous_pool)
+		{
+			LLCurlHostPool::releasePool(previous_pool);
+		}
+		mHostPool->addEasy(mEasy);
 	}
 }
 
@@ -930,15 +1503,20 @@ void LLCurlEasyRequest::requestComplete()
 {
 	llassert_always(mRequestSent);
 	mRequestSent = false;
-	if (mEasy)
+	if (mEasy && mHostPool)
 	{
-		mMulti->removeEasy(mEasy);
+		mHostPool->removeEasy(mEasy);
 	}
 }
 
 S32 LLCurlEasyRequest::perform()
 {
-	return mMulti->perform();
+	if (!mHostPool)
+	{
+		return 0;
+	}
+	mHostPool->perform();
+	return (mEasy && mHostPool->isRunning(mEasy)) ? 1 : 0;
 }
 
 // Usage: Call getRestult until it returns false (no more messages)
@@ -959,45 +1537,17 @@ bool LLCurlEasyRequest::getResult(CURLcode* result, LLCurl::TransferInfo* info)
 			return true;
 		}
 	}
-	// In theory, info_read might return a message with a status other than CURLMSG_DONE
-	// In practice for all messages returned, msg == CURLMSG_DONE
-	// Ignore other messages just in case
-	while(1)
+	// The host pool collects results for every request to the host,
+	// only pick up ours.
+	if (!mHostPool || !mHostPool->getResult(mEasy, result))
 	{
-		S32 q;
-		CURLMsg* curlmsg = info_read(&q, info);
-		if (curlmsg)
-		{
-			if (curlmsg->msg == CURLMSG_DONE)
-			{
-				*result = curlmsg->data.result;			
-				return true;
-			}
-			// else continue
-		}
-		else
-		{
-			return false;
-		}
+		return false;
 	}
-}
-
-// private
-CURLMsg* LLCurlEasyRequest::info_read(S32* q, LLCurl::TransferInfo* info)
-{
-	if (mEasy)
+	if (info)
 	{
-		CURLMsg* curlmsg = mMulti->info_read(q);
-		if (curlmsg && curlmsg->msg == CURLMSG_DONE)
-		{
-			if (info)
-			{
-				mEasy->getTransferInfo(info);
-			}
-		}
-		return curlmsg;
+		mEasy->getTransferInfo(info);
 	}
-	return NULL;
+	return true;
 }
 
 std::string LLCurlEasyRequest::getErrorString()
@@ -1034,6 +1584,8 @@ void LLCurl::initClass()
 	// internal operations of libcurl"
 	// - http://curl.haxx.se/libcurl/c/curl_global_init.html
 	curl_global_init(CURL_GLOBAL_ALL);
+
+	LLCurlHostPool::initClass();
 	
 #if SAFE_SSL
 	S32 mutex_count = CRYPTO_num_locks();
@@ -1048,6 +1600,7 @@ void LLCurl::initClass()
 
 void LLCurl::cleanupClass()
 {
+	LLCurlHostPool::cleanupClass();
 #if SAFE_SSL
 	CRYPTO_set_locking_callback(NULL);
 	for_each(sSSLMutex.begin(), sSSLMutex.end(), DeletePointer());
@@ -43,6 +43,7 @@
 #include "llsd.h"
 
 class LLMutex;
+class LLCurlHostPool;
 
 // For whatever reason, this is not typedef'd in curl.h
 typedef size_t (*curl_header_callback)(void *ptr, size_t size, size_t nmemb, void *stream);
@@ -123,7 +124,9 @@ public:
 			}
 
 	public: /* but not really -- don't touch this */
-		U32 mReferenceCount;
+		// Atomic since responders complete on whichever thread drains
+		// the pump callback queue.
+		LLAtomicU32 mReferenceCount;
 
 	private:
 		std::string mURL;
@@ -156,6 +159,60 @@ public:
 	 */
 	static const std::string& getCAPath() { return sCAPath; }
 
+	/**
+	 * @ brief Limit the number of concurrent transfers to one host.
+	 *
+	 * Applies to LLCurlEasyRequest (and so LLURLRequest and
+	 * LLHTTPClient). Requests over the limit wait in a per host
+	 * queue, and finished transfers leave their connection in the
+	 * host's cache for the next request to reuse.
+	 */
+	static void setMaxConnectionsPerHost(U32 max);
+	static U32 getMaxConnectionsPerHost() { return sMaxConnectionsPerHost; }
+
+	/**
+	 * @ brief Enable HTTP/1.1 pipelining on host connections.
+	 *
+	 * Only takes effect for hosts contacted after the call, and only
+	 * where libcurl supports it.
+	 */
+	static void setPipelining(bool enable);
+	static bool getPipelining() { return sPipelining; }
+
+	/**
+	 * @ brief Connection reuse statistics.
+	 *
+	 * Returns a map of "scheme://host:port" to a map with the
+	 * request, completion, new and reused connection counts and the
+	 * peak active and queued request counts for that host.
+	 */
+	static LLSD getHostStats();
+
+	/**
+	 * @ brief Block until a transfer started through LLCurlEasyRequest
+	 * on the calling thread needs attention.
+	 *
+	 * Waits in select() on the sockets of the calling thread's host
+	 * pools and on wake_socket, for at most max_wait_ms and never
+	 * longer than libcurl asks to be called back after. Returns
+	 * straight away if a finished transfer is still waiting to be
+	 * collected.
+	 * @param max_wait_ms Upper bound on the wait in milliseconds.
+	 * @param wake_socket Another thread makes this readable to end
+	 * the wait early, or CURL_SOCKET_BAD.
+	 */
+	static void waitForTransfers(S32 max_wait_ms, curl_socket_t wake_socket);
+
+	/**
+	 * @ brief Free the host pools of the calling thread.
+	 *
+	 * Threads other than the one calling cleanupClass() which make
+	 * LLCurlEasyRequests must call this before they stop. Pools
+	 * still used by outstanding requests are freed with the last of
+	 * them.
+	 */
+	static void cleanupThread();
+
 	/**
 	 * @ brief Initialize LLCurl class
 	 */
@@ -163,6 +220,9 @@ public:
 
 	/**
 	 * @ brief Cleanup LLCurl class
+	 *
+	 * Threads which made LLCurlEasyRequests must have called
+	 * cleanupThread() and stopped by now.
 	 */
 	static void cleanupClass();
 
@@ -182,6 +242,8 @@ private:
 	static std::string sCAPath;
 	static std::string sCAFile;
 	static const unsigned int MAX_REDIRECTS;
+	static U32 sMaxConnectionsPerHost;
+	static bool sPipelining;
 };
 
 namespace boost
@@ -233,15 +295,14 @@ public:
 	void slist_append(const char* str);
 	void sendRequest(const std::string& url);
 	void requestComplete();
+	// Drives all transfers to this request's host. Returns 1 while
+	// this request is queued or transferring, 0 once it is done.
 	S32 perform();
 	bool getResult(CURLcode* result, LLCurl::TransferInfo* info = NULL);
 	std::string getErrorString();
 
 private:
-	CURLMsg* info_read(S32* queue, LLCurl::TransferInfo* info);
-	
-private:
-	LLCurl::Multi* mMulti;
+	LLCurlHostPool* mHostPool; // set by sendRequest()
 	LLCurl::Easy* mEasy;
 	bool mRequestSent;
 	bool mResultReturned;
@@ -166,8 +166,11 @@ public:
 	/*virtual*/ BOOL		packUUID(const LLUUID &value, const char *name);
 	/*virtual*/ BOOL		unpackUUID(LLUUID &value, const char *name);
 
+				const U8*	getBuffer() const		{ return mBufferp; }
 				S32			getCurrentSize() const	{ return (S32)(mCurBufferp - mBufferp); }
 				S32			getBufferSize() const	{ return mBufferSize; }
+				// Moves past data that was read from getBuffer() directly.
+				BOOL		skip(S32 size, const char *name);
 				void		reset()				{ mCurBufferp = mBufferp; mWriteEnabled = (mCurBufferp != NULL); }
 				void		freeBuffer()		{ delete [] mBufferp; mBufferp = mCurBufferp = NULL; mBufferSize = 0; mWriteEnabled = FALSE; }
 				void		assignBuffer(U8 *bufferp, S32 size)
@@ -202,6 +205,16 @@ inline BOOL LLDataPackerBinaryBuffer::verifyLength(const S32 data_size, const ch
 	return TRUE;
 }
 
+inline BOOL LLDataPackerBinaryBuffer::skip(S32 size, const char *name)
+{
+	if (!verifyLength(size, name))
+	{
+		return FALSE;
+	}
+	mCurBufferp += size;
+	return TRUE;
+}
+
 class LLDataPackerAsciiBuffer : public LLDataPacker
 {
 public:
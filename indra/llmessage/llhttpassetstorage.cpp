@@ -33,6 +33,7 @@
 
 #include "indra_constants.h"
 #include "message.h"
+#include "llhttpscheduler.h"
 #include "llvfile.h"
 #include "llvfs.h"
 
@@ -273,6 +274,14 @@ void LLHTTPAssetRequest::setupCurlHandle()
 
 void LLHTTPAssetRequest::cleanupCurlHandle()
 {
+	double size_upload = 0.0;
+	double size_download = 0.0;
+	curl_easy_getinfo(mCurlHandle, CURLINFO_SIZE_UPLOAD, &size_upload);
+	curl_easy_getinfo(mCurlHandle, CURLINFO_SIZE_DOWNLOAD, &size_download);
+	LLHTTPScheduler::getInstance()->release(LLHTTPScheduler::RC_ASSET,
+										   LLHTTPAssetStorage::getSchedulerID(getUUID(), mRequestType),
+										   (S32)(size_upload + size_download));
+
 	curl_easy_cleanup(mCurlHandle);
 	if (mAssetStoragep)
 	{
@@ -663,11 +672,11 @@ bool LLHTTPAssetStorage::deletePendingRequest(LLAssetStorage::ERequestType rt,
 				{
 					// This request was found in the pending list.  Move it to the end!
 					LLAssetRequest* pending_req = *result;
-					pending->remove(pending_req);
+					removeRequest(rt, pending_req);
 
 					if (!pending_req->mIsUserWaiting)				//A user is waiting on this request.  Toss it.
 					{
-						pending->push_back(pending_req);
+						addRequest(rt, pending_req);
 					}
 					else
 					{
@@ -718,14 +727,27 @@ void LLHTTPAssetStorage::_queueDataRequest(const LLUUID& uuid, LLAssetType::ETyp
 	// that we always want them first, even if they're out of order.
 	//
 	
-	if (req->getType() == LLAssetType::AT_TEXTURE)
-	{
-		mPendingDownloads.push_back(req);
-	}
-	else
+	addRequest(RT_DOWNLOAD, req, req->getType() != LLAssetType::AT_TEXTURE);
+}
+
+// static
+F32 LLHTTPAssetStorage::getRequestPriority(const LLAssetRequest* req)
+{
+	// Same order as _queueDataRequest() puts them in.
+	if (req->mIsPriority || req->mIsUserWaiting)
 	{
-		mPendingDownloads.push_front(req);
+		return 1.f;
 	}
+	return (req->getType() == LLAssetType::AT_TEXTURE) ? 0.f : 0.5f;
+}
+
+// static
+LLUUID LLHTTPAssetStorage::getSchedulerID(const LLUUID& asset_id, ERequestType rt)
+{
+	// An upload and a download of the same asset need separate slots.
+	LLUUID type_id;
+	type_id.generate(getRequestName(rt));
+	return asset_id.combine(type_id);
 }
 
 LLAssetRequest* LLHTTPAssetStorage::findNextRequest(LLAssetStorage::request_list_t& pending, 
@@ -772,6 +794,13 @@ void LLHTTPAssetStorage::checkForTimeouts()
 		std::string base_url = getBaseURL(req->getUUID(), req->getType());
 		tmp_url = llformat("%s/%36s.%s", base_url.c_str() , uuid_str.c_str(), LLAssetType::lookup(req->getType()));
 
+		if (!LLHTTPScheduler::getInstance()->acquire(LLHTTPScheduler::RC_ASSET, getSchedulerID(req->getUUID(), RT_DOWNLOAD),
+													 tmp_url, getRequestPriority(req)))
+		{
+			// Try again on the next pass.
+			break;
+		}
+
 		LLHTTPAssetRequest *new_req = new LLHTTPAssetRequest(this, req->getUUID(), 
 										req->getType(), RT_DOWNLOAD, tmp_url, mCurlMultiHandle);
 		new_req->mTmpUUID.generate();
@@ -809,6 +838,13 @@ void LLHTTPAssetStorage::checkForTimeouts()
 		tmp_url = mBaseURL + "/" + uuid_str + "." + LLAssetType::lookup(req->getType());
 		if (do_compress) tmp_url += ".gz";
 
+		if (!LLHTTPScheduler::getInstance()->acquire(LLHTTPScheduler::RC_ASSET, getSchedulerID(req->getUUID(), RT_UPLOAD),
+													 tmp_url, getRequestPriority(req)))
+		{
+			// Try again on the next pass.
+			break;
+		}
+
 		LLHTTPAssetRequest *new_req = new LLHTTPAssetRequest(this, req->getUUID(), 
 									req->getType(), RT_UPLOAD, tmp_url, mCurlMultiHandle);
 
@@ -880,6 +916,13 @@ void LLHTTPAssetStorage::checkForTimeouts()
 		// KLW - All temporary uploads are saved locally "http://localhost:12041/asset"
 		tmp_url = llformat("%s/%36s.%s", mLocalBaseURL.c_str(), uuid_str.c_str(), LLAssetType::lookup(req->getType()));
 
+		if (!LLHTTPScheduler::getInstance()->acquire(LLHTTPScheduler::RC_ASSET, getSchedulerID(req->getUUID(), RT_LOCALUPLOAD),
+													 tmp_url, getRequestPriority(req)))
+		{
+			// Try again on the next pass.
+			break;
+		}
+
 		LLHTTPAssetRequest *new_req = new LLHTTPAssetRequest(this, req->getUUID(), 
 										req->getType(), RT_LOCALUPLOAD, tmp_url, mCurlMultiHandle);
 		new_req->mRequestingAgentID = req->mRequestingAgentID;
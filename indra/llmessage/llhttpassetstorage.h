@@ -100,6 +100,9 @@ public:
 	S32 getURLToFile(const LLUUID& uuid, LLAssetType::EType asset_type, const std::string &url, const std::string& filename, progress_callback callback, void *userdata);
 	
 	LLAssetRequest* findNextRequest(request_list_t& pending, request_list_t& running);
+	// Priority and key of a request in the HTTP scheduler.
+	static F32 getRequestPriority(const LLAssetRequest* req);
+	static LLUUID getSchedulerID(const LLUUID& asset_id, ERequestType rt);
 
 	void checkForTimeouts();
 	
@@ -0,0 +1,445 @@
+/**
+ * @file llhttpscheduler.cpp
+ * @brief Shared admission control for HTTP fetches
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "llhttpscheduler.h"
+
+#include "llthread.h"
+#include "lltimer.h"
+#include "lluri.h"
+
+// A waiting request which has not asked again for this long is
+// assumed to be abandoned, so it stops holding up the others.
+static const F64 WAITING_TIMEOUT = 2.0;
+static const F64 EXPIRE_INTERVAL = 1.0;
+// A waiting request which has not asked again for this long no longer
+// goes ahead of the others. Fetchers poll every frame, this allows for
+// a few slow ones.
+static const F64 STALE_WAITING_TIME = 0.5;
+
+// Defaults match the limits the fetchers used on their own.
+static const U32 DEFAULT_MAX_REQUESTS = 48;
+static const U32 DEFAULT_MAX_REQUESTS_PER_HOST = 40;
+static const U32 DEFAULT_MAX_TEXTURE_REQUESTS = 32;
+static const U32 DEFAULT_MAX_INVENTORY_REQUESTS = 8;
+static const U32 DEFAULT_MAX_ASSET_REQUESTS = 3;
+
+static const char* CLASS_NAMES[LLHTTPScheduler::RC_COUNT] =
+{
+	"texture",
+	"inventory",
+	"asset"
+};
+
+LLHTTPScheduler::LLHTTPScheduler()
+	: mMutex(new LLMutex(NULL)),
+	  mMaxRequests(DEFAULT_MAX_REQUESTS),
+	  mMaxRequestsPerHost(DEFAULT_MAX_REQUESTS_PER_HOST),
+	  mMaxBytesPerSec(0.0),
+	  mMaxBytesPerSecPerHost(0.0),
+	  mLastRefill(LLTimer::getTotalSeconds()),
+	  mLastExpire(mLastRefill),
+	  mSequence(0),
+	  mBytesReceived(0),
+	  mAdmittedCount(0),
+	  mForcedCount(0),
+	  mExpiredCount(0)
+{
+	for (S32 i = 0; i < RC_COUNT; ++i)
+	{
+		mClassActive[i] = 0;
+		mClassWaiting[i] = 0;
+	}
+	mMaxClassRequests[RC_TEXTURE] = DEFAULT_MAX_TEXTURE_REQUESTS;
+	mMaxClassRequests[RC_INVENTORY] = DEFAULT_MAX_INVENTORY_REQUESTS;
+	mMaxClassRequests[RC_ASSET] = DEFAULT_MAX_ASSET_REQUESTS;
+
+	// Inventory and non-texture assets block the UI, textures only
+	// sharpen what is already on screen.
+	mClassWeight[RC_TEXTURE] = 0.f;
+	mClassWeight[RC_INVENTORY] = 2.f;
+	mClassWeight[RC_ASSET] = 1.f;
+}
+
+LLHTTPScheduler::~LLHTTPScheduler()
+{
+	delete mMutex;
+	mMutex = NULL;
+}
+
+//static
+const char* LLHTTPScheduler::lookupClassName(ERequestClass req_class)
+{
+	if (req_class < 0 || req_class >= RC_COUNT)
+	{
+		return "unknown";
+	}
+	return CLASS_NAMES[req_class];
+}
+
+//static
+std::string LLHTTPScheduler::hostOf(const std::string& url)
+{
+	LLURI uri(url);
+	return llformat("%s:%d", uri.hostName().c_str(), (S32)uri.hostPort());
+}
+
+bool LLHTTPScheduler::acquire(ERequestClass req_class, const LLUUID& id, const std::string& url, F32 priority)
+{
+	llassert(req_class >= 0 && req_class < RC_COUNT);
+	LLMutexLock lock(mMutex);
+
+	F64 now = LLTimer::getTotalSeconds();
+	refill(now);
+	expireWaiting(now);
+
+	Request& request = findOrAddRequest(req_class, id, url);
+	if (request.mActive)
+	{
+		// Admitted on an earlier call.
+		return true;
+	}
+	setPriority(request, mClassWeight[req_class] + llclamp(priority, 0.f, 1.f));
+	request.mLastPolled = now;
+
+	// Only go if nothing more important could use the slot.
+	if (canAdmit(request) && isFirstInLine(request, now))
+	{
+		admit(request);
+		return true;
+	}
+	return false;
+}
+
+void LLHTTPScheduler::forceAcquire(ERequestClass req_class, const LLUUID& id, const std::string& url)
+{
+	llassert(req_class >= 0 && req_class < RC_COUNT);
+	LLMutexLock lock(mMutex);
+
+	Request& request = findOrAddRequest(req_class, id, url);
+	if (!request.mActive)
+	{
+		admit(request);
+		++mForcedCount;
+	}
+}
+
+void LLHTTPScheduler::reprioritize(ERequestClass req_class, const LLUUID& id, F32 priority)
+{
+	LLMutexLock lock(mMutex);
+	request_map_t::iterator iter = mRequests.find(request_key_t(req_class, id));
+	if (iter != mRequests.end() && !iter->second.mActive)
+	{
+		setPriority(iter->second, mClassWeight[req_class] + llclamp(priority, 0.f, 1.f));
+	}
+}
+
+void LLHTTPScheduler::release(ERequestClass req_class, const LLUUID& id, S32 bytes)
+{
+	LLMutexLock lock(mMutex);
+	mBytesReceived += (U32)llmax(bytes, 0);
+
+	request_map_t::iterator iter = mRequests.find(request_key_t(req_class, id));
+	if (iter == mRequests.end())
+	{
+		return;
+	}
+	const Request& request = iter->second;
+	if (request.mActive)
+	{
+		--mClassActive[req_class];
+		--mGlobal.mActive;
+		mGlobal.mTokens -= bytes;
+		host_map_t::iterator host = mHosts.find(request.mHost);
+		if (host != mHosts.end())
+		{
+			--host->second.mActive;
+			host->second.mTokens -= bytes;
+		}
+	}
+	else
+	{
+		--mClassWaiting[req_class];
+		mWaiting.erase(request.mWaiting);
+	}
+	mRequests.erase(iter);
+}
+
+void LLHTTPScheduler::setMaxRequests(U32 max_requests)
+{
+	LLMutexLock lock(mMutex);
+	mMaxRequests = max_requests;
+}
+
+void LLHTTPScheduler::setMaxRequestsPerHost(U32 max_requests)
+{
+	LLMutexLock lock(mMutex);
+	mMaxRequestsPerHost = max_requests;
+}
+
+void LLHTTPScheduler::setMaxClassRequests(ERequestClass req_class, U32 max_requests)
+{
+	llassert(req_class >= 0 && req_class < RC_COUNT);
+	LLMutexLock lock(mMutex);
+	mMaxClassRequests[req_class] = max_requests;
+}
+
+void LLHTTPScheduler::setMaxKbps(F32 kbps)
+{
+	LLMutexLock lock(mMutex);
+	mMaxBytesPerSec = llmax(kbps, 0.f) * 1024.0 / 8.0;
+	mGlobal.mTokens = mMaxBytesPerSec;
+}
+
+void LLHTTPScheduler::setMaxKbpsPerHost(F32 kbps)
+{
+	LLMutexLock lock(mMutex);
+	mMaxBytesPerSecPerHost = llmax(kbps, 0.f) * 1024.0 / 8.0;
+	for (host_map_t::iterator iter = mHosts.begin(); iter != mHosts.end(); ++iter)
+	{
+		iter->second.mTokens = mMaxBytesPerSecPerHost;
+	}
+}
+
+void LLHTTPScheduler::setClassWeight(ERequestClass req_class, F32 weight)
+{
+	llassert(req_class >= 0 && req_class < RC_COUNT);
+	LLMutexLock lock(mMutex);
+	mClassWeight[req_class] = weight;
+}
+
+S32 LLHTTPScheduler::getWaitingCount(ERequestClass req_class) const
+{
+	LLMutexLock lock(mMutex);
+	if (req_class < RC_COUNT)
+	{
+		return (S32)mClassWaiting[req_class];
+	}
+	S32 count = 0;
+	for (S32 i = 0; i < RC_COUNT; ++i)
+	{
+		count += mClassWaiting[i];
+	}
+	return count;
+}
+
+S32 LLHTTPScheduler::getActiveCount(ERequestClass req_class) const
+{
+	LLMutexLock lock(mMutex);
+	if (req_class < RC_COUNT)
+	{
+		return (S32)mClassActive[req_class];
+	}
+	return (S32)mGlobal.mActive;
+}
+
+U32 LLHTTPScheduler::getAndResetBytesReceived()
+{
+	LLMutexLock lock(mMutex);
+	U32 bytes = mBytesReceived;
+	mBytesReceived = 0;
+	return bytes;
+}
+
+LLSD LLHTTPScheduler::getStats() const
+{
+	LLMutexLock lock(mMutex);
+	LLSD stats;
+	for (S32 i = 0; i < RC_COUNT; ++i)
+	{
+		LLSD& class_stats = stats[CLASS_NAMES[i]];
+		class_stats["active"] = (S32)mClassActive[i];
+		class_stats["waiting"] = (S32)mClassWaiting[i];
+		class_stats["max"] = (S32)mMaxClassRequests[i];
+	}
+	stats["active"] = (S32)mGlobal.mActive;
+	stats["hosts"] = (S32)mHosts.size();
+	stats["admitted"] = (S32)mAdmittedCount;
+	stats["forced"] = (S32)mForcedCount;
+	stats["expired"] = (S32)mExpiredCount;
+	return stats;
+}
+
+LLHTTPScheduler::Request& LLHTTPScheduler::findOrAddRequest(ERequestClass req_class, const LLUUID& id, const std::string& url)
+{
+	request_key_t key(req_class, id);
+	request_map_t::iterator iter = mRequests.find(key);
+	if (iter == mRequests.end())
+	{
+		iter = mRequests.insert(std::make_pair(key, Request())).first;
+		Request& request = iter->second;
+		request.mClass = req_class;
+		request.mHost = hostOf(url);
+		request.mSequence = mSequence++;
+		request.mWaiting = mWaiting.insert(std::make_pair(WaitingKey(request.mPriority, request.mSequence), &request)).first;
+		++mClassWaiting[req_class];
+	}
+	return iter->second;
+}
+
+void LLHTTPScheduler::setPriority(Request& request, F32 priority)
+{
+	if (request.mPriority == priority)
+	{
+		return;
+	}
+	request.mPriority = priority;
+	if (!request.mActive)
+	{
+		mWaiting.erase(request.mWaiting);
+		request.mWaiting = mWaiting.insert(std::make_pair(WaitingKey(request.mPriority, request.mSequence), &request)).first;
+	}
+}
+
+bool LLHTTPScheduler::canAdmit(const Request& request) const
+{
+	if (mMaxRequests && mGlobal.mActive >= mMaxRequests)
+	{
+		return false;
+	}
+	if (mMaxBytesPerSec > 0.0 && mGlobal.mTokens <= 0.0)
+	{
+		return false;
+	}
+	U32 max_class = mMaxClassRequests[request.mClass];
+	if (max_class && mClassActive[request.mClass] >= max_class)
+	{
+		return false;
+	}
+	host_map_t::const_iterator host = mHosts.find(request.mHost);
+	if (host != mHosts.end())
+	{
+		if (mMaxRequestsPerHost && host->second.mActive >= mMaxRequestsPerHost)
+		{
+			return false;
+		}
+		if (mMaxBytesPerSecPerHost > 0.0 && host->second.mTokens <= 0.0)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+bool LLHTTPScheduler::isFirstInLine(const Request& request, F64 now) const
+{
+	// Only the waiters ahead of this one are looked at. Those which
+	// could not be admitted anyway (their host or class is full) or
+	// have stopped asking do not hold it up.
+	for (waiting_map_t::const_iterator iter = mWaiting.begin();
+		 iter != request.mWaiting; ++iter)
+	{
+		const Request& ahead = *iter->second;
+		if (now - ahead.mLastPolled > STALE_WAITING_TIME)
+		{
+			continue;
+		}
+		if (canAdmit(ahead))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+void LLHTTPScheduler::admit(Request& request)
+{
+	request.mActive = true;
+	mWaiting.erase(request.mWaiting);
+	--mClassWaiting[request.mClass];
+	++mClassActive[request.mClass];
+	++mGlobal.mActive;
+	host_map_t::iterator host = mHosts.find(request.mHost);
+	if (host == mHosts.end())
+	{
+		Budget budget;
+		budget.mTokens = mMaxBytesPerSecPerHost;
+		host = mHosts.insert(std::make_pair(request.mHost, budget)).first;
+	}
+	++host->second.mActive;
+	++mAdmittedCount;
+}
+
+void LLHTTPScheduler::refill(F64 now)
+{
+	F64 elapsed = llmax(now - mLastRefill, 0.0);
+	mLastRefill = now;
+
+	// Allow at most one second of burst. Without a limit the tokens
+	// are not looked at, keep them at 0.
+	mGlobal.mTokens = llmin(mGlobal.mTokens + elapsed * mMaxBytesPerSec, mMaxBytesPerSec);
+	if (mMaxBytesPerSec <= 0.0)
+	{
+		mGlobal.mTokens = 0.0;
+	}
+
+	host_map_t::iterator iter = mHosts.begin();
+	while (iter != mHosts.end())
+	{
+		Budget& budget = iter->second;
+		budget.mTokens = llmin(budget.mTokens + elapsed * mMaxBytesPerSecPerHost, mMaxBytesPerSecPerHost);
+		if (mMaxBytesPerSecPerHost <= 0.0)
+		{
+			budget.mTokens = 0.0;
+		}
+		if (0 == budget.mActive && budget.mTokens >= mMaxBytesPerSecPerHost)
+		{
+			// Idle and fully refilled, same as a host never seen.
+			mHosts.erase(iter++);
+		}
+		else
+		{
+			++iter;
+		}
+	}
+}
+
+void LLHTTPScheduler::expireWaiting(F64 now)
+{
+	if (now - mLastExpire < EXPIRE_INTERVAL)
+	{
+		return;
+	}
+	mLastExpire = now;
+
+	request_map_t::iterator iter = mRequests.begin();
+	while (iter != mRequests.end())
+	{
+		const Request& request = iter->second;
+		if (!request.mActive && now - request.mLastPolled > WAITING_TIMEOUT)
+		{
+			--mClassWaiting[request.mClass];
+			mWaiting.erase(request.mWaiting);
+			++mExpiredCount;
+			mRequests.erase(iter++);
+		}
+		else
+		{
+			++iter;
+		}
+	}
+}
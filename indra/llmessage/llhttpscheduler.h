@@ -0,0 +1,196 @@
+/**
+ * @file llhttpscheduler.h
+ * @brief Shared admission control for HTTP fetches
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLHTTPSCHEDULER_H
+#define LL_LLHTTPSCHEDULER_H
+
+#include <map>
+#include <string>
+
+#include "llsd.h"
+#include "llsingleton.h"
+#include "lluuid.h"
+
+class LLMutex;
+
+/**
+ * @class LLHTTPScheduler
+ * @brief Decides which HTTP requests may go out, across all fetchers.
+ *
+ * Texture, inventory and asset fetches all poll for work, so the
+ * scheduler is polled too: a fetcher calls acquire() with the request
+ * it would like to send. If the request fits in the global, per-host
+ * and per-class budgets and nothing more important is waiting, it is
+ * admitted and the call returns true. Otherwise it waits at the given
+ * priority and the fetcher asks again on its next pass. Asking again
+ * with a new priority reprioritizes the request. A waiter which has
+ * not asked again for a while no longer goes ahead of the others.
+ *
+ * Admitted requests hold their slot until release(), which also
+ * charges the bytes transferred against the bandwidth budgets.
+ *
+ * The scheduler is thread safe; the texture fetcher calls it from its
+ * own thread.
+ */
+class LLHTTPScheduler : public LLSingleton<LLHTTPScheduler>
+{
+	LOG_CLASS(LLHTTPScheduler);
+public:
+	enum ERequestClass
+	{
+		RC_TEXTURE = 0,
+		RC_INVENTORY,
+		RC_ASSET,
+		RC_COUNT
+	};
+
+	LLHTTPScheduler();
+	~LLHTTPScheduler();
+
+	/**
+	 * @brief Asks to send a request.
+	 *
+	 * @param req_class The kind of fetch.
+	 * @param id Identifies the request within its class.
+	 * @param url Where the request goes, only the host part is used.
+	 * @param priority 0 to 1, higher goes first within the class.
+	 * @return true if the request is admitted and must be sent and
+	 * released; false if it has to wait.
+	 */
+	bool acquire(ERequestClass req_class, const LLUUID& id, const std::string& url, F32 priority);
+
+	/**
+	 * @brief Admits a request regardless of budgets.
+	 *
+	 * For requests that go out as part of one already admitted. The
+	 * request still counts against the budgets until released.
+	 */
+	void forceAcquire(ERequestClass req_class, const LLUUID& id, const std::string& url);
+
+	// Changes the priority of a waiting request.
+	void reprioritize(ERequestClass req_class, const LLUUID& id, F32 priority);
+
+	// Frees the slot of an admitted request, or drops a waiting one.
+	void release(ERequestClass req_class, const LLUUID& id, S32 bytes = 0);
+
+	// Budgets. 0 means unlimited.
+	void setMaxRequests(U32 max_requests);
+	void setMaxRequestsPerHost(U32 max_requests);
+	void setMaxClassRequests(ERequestClass req_class, U32 max_requests);
+	void setMaxKbps(F32 kbps);
+	void setMaxKbpsPerHost(F32 kbps);
+
+	// Classes with a higher weight are served first. Priorities within
+	// a class only break ties between requests of the same weight.
+	void setClassWeight(ERequestClass req_class, F32 weight);
+
+	S32 getWaitingCount(ERequestClass req_class = RC_COUNT) const;
+	S32 getActiveCount(ERequestClass req_class = RC_COUNT) const;
+	// Returns the bytes released since the last call, for bandwidth stats.
+	U32 getAndResetBytesReceived();
+	LLSD getStats() const;
+
+	static const char* lookupClassName(ERequestClass req_class);
+
+private:
+	struct Request;
+
+	// Orders waiting requests most important first: highest priority,
+	// then oldest.
+	struct WaitingKey
+	{
+		WaitingKey(F32 priority, U32 sequence)
+			: mPriority(priority), mSequence(sequence)
+		{}
+		bool operator<(const WaitingKey& rhs) const
+		{
+			return mPriority > rhs.mPriority
+				|| (mPriority == rhs.mPriority && mSequence < rhs.mSequence);
+		}
+		F32 mPriority;
+		U32 mSequence;
+	};
+	typedef std::map<WaitingKey, Request*> waiting_map_t;
+
+	struct Request
+	{
+		Request()
+			: mClass(RC_TEXTURE), mPriority(0.f), mSequence(0), mLastPolled(0.0), mActive(false)
+		{}
+		ERequestClass mClass;
+		std::string mHost;
+		F32 mPriority;		// including class weight
+		U32 mSequence;		// FIFO order between equal priorities
+		F64 mLastPolled;
+		bool mActive;
+		waiting_map_t::iterator mWaiting;	// valid while not active
+	};
+
+	struct Budget
+	{
+		Budget() : mActive(0), mTokens(0.0) {}
+		U32 mActive;
+		F64 mTokens;		// bytes that may still be fetched, < 0 when over
+	};
+
+	typedef std::pair<S32, LLUUID> request_key_t;
+	typedef std::map<request_key_t, Request> request_map_t;
+	typedef std::map<std::string, Budget> host_map_t;
+
+	Request& findOrAddRequest(ERequestClass req_class, const LLUUID& id, const std::string& url);
+	void setPriority(Request& request, F32 priority);
+	bool canAdmit(const Request& request) const;
+	bool isFirstInLine(const Request& request, F64 now) const;
+	void admit(Request& request);
+	void refill(F64 now);
+	void expireWaiting(F64 now);
+
+	static std::string hostOf(const std::string& url);
+
+private:
+	LLMutex* mMutex;
+	request_map_t mRequests;
+	waiting_map_t mWaiting;
+	host_map_t mHosts;
+	Budget mGlobal;
+	U32 mClassActive[RC_COUNT];
+	U32 mClassWaiting[RC_COUNT];
+	U32 mMaxClassRequests[RC_COUNT];
+	F32 mClassWeight[RC_COUNT];
+	U32 mMaxRequests;
+	U32 mMaxRequestsPerHost;
+	F64 mMaxBytesPerSec;
+	F64 mMaxBytesPerSecPerHost;
+	F64 mLastRefill;
+	F64 mLastExpire;
+	U32 mSequence;
+	U32 mBytesReceived;
+	U32 mAdmittedCount;
+	U32 mForcedCount;
+	U32 mExpiredCount;
+};
+
+#endif // LL_LLHTTPSCHEDULER_H
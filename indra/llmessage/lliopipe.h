@@ -33,6 +33,7 @@
 #include <boost/shared_ptr.hpp>
 #include "apr_poll.h"
 
+#include "llapr.h"
 #include "llsd.h"
 
 class LLIOPipe;
@@ -250,18 +251,23 @@ protected:
 private:
 	friend void boost::intrusive_ptr_add_ref(LLIOPipe* p);
 	friend void boost::intrusive_ptr_release(LLIOPipe* p);
-	U32 mReferenceCount;
+
+	// Pipes may be shared between a pump running on an i/o thread
+	// and the callback queue drained on the main thread, so the
+	// count has to be atomic.
+	LLAtomicU32 mReferenceCount;
 };
 
 namespace boost
 {
 	inline void intrusive_ptr_add_ref(LLIOPipe* p)
 	{
-		++p->mReferenceCount;
+		p->mReferenceCount++;
 	}
 	inline void intrusive_ptr_release(LLIOPipe* p)
 	{
-		if(p && 0 == --p->mReferenceCount)
+		// apr_atomic_dec32() returns zero only when the count hits zero.
+		if(p && 0 == p->mReferenceCount--)
 		{
 			delete p;
 		}
@@ -52,6 +52,9 @@ class LLMessageReader
 
 	/** All get* methods expect pointers to canonical strings. */
 	virtual void getBinaryData(const char *blockname, const char *varname, void *datap, S32 size, S32 blocknum = 0, S32 max_size = S32_MAX) = 0;
+	/** Returns the variable's data where it is held, valid until the next message, 
+		or NULL if the reader can't do that without a copy. */
+	virtual const U8* getBinaryDataPointer(const char *blockname, const char *varname, S32 &size, S32 blocknum = 0) = 0;
 	virtual void getBOOL(const char *block, const char *var, BOOL &data, S32 blocknum = 0) = 0;
 	virtual void getS8(const char *block, const char *var, S8 &data, S32 blocknum = 0) = 0;
 	virtual void getU8(const char *block, const char *var, U8 &data, S32 blocknum = 0) = 0;
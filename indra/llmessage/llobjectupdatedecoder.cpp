@@ -0,0 +1,190 @@
+/** 
+ * @file llobjectupdatedecoder.cpp
+ * @brief Decoders for the fixed layout parts of object update blocks.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "llobjectupdatedecoder.h"
+
+#include "llmath.h"
+#include "llquantize.h"
+
+// Ranges the simulator quantizes terse update motion to
+const F32 TERSE_VELOCITY_RANGE = 128.f;
+const F32 TERSE_ACCELERATION_RANGE = 64.f;
+const F32 TERSE_ANGULAR_VELOCITY_RANGE = 64.f;
+
+// Sizes of the fixed parts of the blocks
+const S32 TERSE_UPDATE_SIZE = 44;		// without the foot plane
+const S32 FOOT_PLANE_SIZE = 16;
+const S32 COMPRESSED_UPDATE_SIZE = 84;	// without the angular velocity and parent id
+
+// Object updates are little endian. Reading them a byte at a time works on
+// any host, and compiles to plain loads on little endian ones.
+static inline U16 read_u16(const U8* data)
+{
+	return (U16)(data[0] | (data[1] << 8));
+}
+
+static inline U32 read_u32(const U8* data)
+{
+	return (U32)data[0] | ((U32)data[1] << 8) | ((U32)data[2] << 16) | ((U32)data[3] << 24);
+}
+
+static inline F32 read_f32(const U8* data)
+{
+	U32 bits = read_u32(data);
+	F32 value;
+	memcpy(&value, &bits, sizeof(F32));
+	return value;
+}
+
+static inline void read_vector3(const U8* data, LLVector3& vec)
+{
+	vec.mV[VX] = read_f32(data);
+	vec.mV[VY] = read_f32(data + 4);
+	vec.mV[VZ] = read_f32(data + 8);
+}
+
+static inline void read_quantized_vector3(const U8* data, F32 range, LLVector3& vec)
+{
+	vec.mV[VX] = U16_to_F32(read_u16(data), -range, range);
+	vec.mV[VY] = U16_to_F32(read_u16(data + 2), -range, range);
+	vec.mV[VZ] = U16_to_F32(read_u16(data + 4), -range, range);
+}
+
+S32 decode_terse_object_update(const U8* data, S32 size, LLTerseObjectUpdate& update)
+{
+	if (size < TERSE_UPDATE_SIZE)
+	{
+		return 0;
+	}
+
+	const U8* cur = data;
+	update.mLocalID = read_u32(cur);
+	update.mState = cur[4];
+	update.mHasFootPlane = cur[5] != 0;
+	cur += 6;
+
+	if (update.mHasFootPlane)
+	{
+		if (size < TERSE_UPDATE_SIZE + FOOT_PLANE_SIZE)
+		{
+			return 0;
+		}
+		update.mFootPlane.mV[VX] = read_f32(cur);
+		update.mFootPlane.mV[VY] = read_f32(cur + 4);
+		update.mFootPlane.mV[VZ] = read_f32(cur + 8);
+		update.mFootPlane.mV[VW] = read_f32(cur + 12);
+		cur += FOOT_PLANE_SIZE;
+	}
+
+	read_vector3(cur, update.mPosition);
+	cur += 12;
+	read_quantized_vector3(cur, TERSE_VELOCITY_RANGE, update.mVelocity);
+	cur += 6;
+	read_quantized_vector3(cur, TERSE_ACCELERATION_RANGE, update.mAcceleration);
+	cur += 6;
+	update.mRotation.mQ[VX] = U16_to_F32(read_u16(cur), -1.f, 1.f);
+	update.mRotation.mQ[VY] = U16_to_F32(read_u16(cur + 2), -1.f, 1.f);
+	update.mRotation.mQ[VZ] = U16_to_F32(read_u16(cur + 4), -1.f, 1.f);
+	update.mRotation.mQ[VS] = U16_to_F32(read_u16(cur + 6), -1.f, 1.f);
+	cur += 8;
+	read_quantized_vector3(cur, TERSE_ANGULAR_VELOCITY_RANGE, update.mAngularVelocity);
+	cur += 6;
+
+	return (S32)(cur - data);
+}
+
+S32 decode_compressed_object_update(const U8* data, S32 size, LLCompressedObjectUpdate& update)
+{
+	if (size < COMPRESSED_UPDATE_SIZE)
+	{
+		return 0;
+	}
+
+	const U8* cur = data;
+	memcpy(update.mFullID.mData, cur, UUID_BYTES);
+	update.mLocalID = read_u32(cur + 16);
+	update.mPCode = cur[20];
+	update.mState = cur[21];
+	update.mCRC = read_u32(cur + 22);
+	update.mMaterial = cur[26];
+	update.mClickAction = cur[27];
+	read_vector3(cur + 28, update.mScale);
+	read_vector3(cur + 40, update.mPosition);
+	LLVector3 rot;
+	read_vector3(cur + 52, rot);
+	update.mRotation.unpackFromVector3(rot);
+	update.mSpecialCode = read_u32(cur + 64);
+	memcpy(update.mOwnerID.mData, cur + 68, UUID_BYTES);
+	cur += COMPRESSED_UPDATE_SIZE;
+
+	update.mHasAngularVelocity = (update.mSpecialCode & 0x80) != 0;
+	if (update.mHasAngularVelocity)
+	{
+		if (cur + 12 > data + size)
+		{
+			return 0;
+		}
+		read_vector3(cur, update.mAngularVelocity);
+		cur += 12;
+	}
+
+	update.mParentID = 0;
+	if (update.mSpecialCode & 0x20)
+	{
+		if (cur + 4 > data + size)
+		{
+			return 0;
+		}
+		update.mParentID = read_u32(cur);
+		cur += 4;
+	}
+
+	return (S32)(cur - data);
+}
+
+BOOL decode_terse_object_update_id(const U8* data, S32 size, U32& local_id)
+{
+	if (size < 4)
+	{
+		return FALSE;
+	}
+	local_id = read_u32(data);
+	return TRUE;
+}
+
+BOOL decode_compressed_object_update_ids(const U8* data, S32 size, LLUUID& full_id, U32& local_id, U8& pcode)
+{
+	if (size < UUID_BYTES + 5)
+	{
+		return FALSE;
+	}
+	memcpy(full_id.mData, data, UUID_BYTES);
+	local_id = read_u32(data + UUID_BYTES);
+	pcode = data[UUID_BYTES + 4];
+	return TRUE;
+}
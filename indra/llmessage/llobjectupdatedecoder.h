@@ -0,0 +1,80 @@
+/** 
+ * @file llobjectupdatedecoder.h
+ * @brief Decoders for the fixed layout parts of object update blocks.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLOBJECTUPDATEDECODER_H
+#define LL_LLOBJECTUPDATEDECODER_H
+
+#include "lluuid.h"
+#include "v3math.h"
+#include "v4math.h"
+#include "llquaternion.h"
+
+// The Data of an ImprovedTerseObjectUpdate block
+struct LLTerseObjectUpdate
+{
+	U32				mLocalID;
+	U8				mState;
+	BOOL			mHasFootPlane;		// only sent for avatars
+	LLVector4		mFootPlane;
+	LLVector3		mPosition;
+	LLVector3		mVelocity;
+	LLVector3		mAcceleration;
+	LLQuaternion	mRotation;
+	LLVector3		mAngularVelocity;
+};
+
+// The fields at the start of an ObjectUpdateCompressed block, up to the
+// variable length ones that follow the parent id
+struct LLCompressedObjectUpdate
+{
+	LLUUID			mFullID;
+	U32				mLocalID;
+	U8				mPCode;
+	U8				mState;
+	U32				mCRC;
+	U8				mMaterial;
+	U8				mClickAction;
+	LLVector3		mScale;
+	LLVector3		mPosition;
+	LLQuaternion	mRotation;
+	U32				mSpecialCode;		// flags for the optional fields
+	LLUUID			mOwnerID;
+	BOOL			mHasAngularVelocity;
+	LLVector3		mAngularVelocity;
+	U32				mParentID;
+};
+
+// These read straight from the block in one pass, without a data packer,
+// and return the number of bytes they used, or 0 if the block is too short.
+S32 decode_terse_object_update(const U8* data, S32 size, LLTerseObjectUpdate& update);
+S32 decode_compressed_object_update(const U8* data, S32 size, LLCompressedObjectUpdate& update);
+
+// Read only the ids at the start of a block, so the object can be looked
+// up before the rest is decoded.
+BOOL decode_terse_object_update_id(const U8* data, S32 size, U32& local_id);
+BOOL decode_compressed_object_update_ids(const U8* data, S32 size, LLUUID& full_id, U32& local_id, U8& pcode);
+
+#endif // LL_LLOBJECTUPDATEDECODER_H
@@ -0,0 +1,115 @@
+/** 
+ * @file llpacketidwindow.cpp
+ * @brief Sliding bitmap of recently received packet IDs.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ * 
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ * 
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ * 
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "llpacketidwindow.h"
+
+#include <algorithm>
+
+// Circuit packet IDs wrap at LL_MAX_OUT_PACKET_ID.
+static const U32 PACKET_ID_MASK = 0x00FFFFFF;
+static const U32 PACKET_ID_HALF_RANGE = 0x00800000;
+
+LLPacketIDWindow::LLPacketIDWindow(U32 size) :
+	mSize((llclamp(size, 32U, PACKET_ID_MASK + 1) + 31) & ~31U),
+	mHighest(0),
+	mSpan(0)
+{
+	// The ID range has to divide evenly into the window, or the bits
+	// would shift when IDs wrap.
+	while ((PACKET_ID_MASK + 1) % mSize)
+	{
+		mSize += 32;
+	}
+	mBits.resize(mSize / 32, 0);
+}
+
+void LLPacketIDWindow::add(TPACKETID id)
+{
+	id &= PACKET_ID_MASK;
+	if (!mSpan)
+	{
+		mHighest = id;
+		clearBit(id);
+		mSpan = 1;
+	}
+
+	U32 ahead = (id - mHighest) & PACKET_ID_MASK;
+	if (ahead && ahead < PACKET_ID_HALF_RANGE)
+	{
+		// Slide the window forward, clearing the IDs that come into it.
+		if (ahead >= mSize)
+		{
+			std::fill(mBits.begin(), mBits.end(), 0);
+		}
+		else
+		{
+			for (U32 i = 1; i <= ahead; ++i)
+			{
+				clearBit(mHighest + i);
+			}
+		}
+		mHighest = id;
+		mSpan = llmin(mSpan + ahead, mSize);
+	}
+	else if (ahead)
+	{
+		U32 age = (mHighest - id) & PACKET_ID_MASK;
+		if (age >= mSize)
+		{
+			// Too old to track.
+			return;
+		}
+		// Stretch the window back over IDs forgotten earlier.
+		for (U32 i = mSpan; i < age; ++i)
+		{
+			clearBit(mHighest - i);
+		}
+		mSpan = llmax(mSpan, age + 1);
+	}
+	setBit(id);
+}
+
+bool LLPacketIDWindow::contains(TPACKETID id) const
+{
+	U32 age = (mHighest - id) & PACKET_ID_MASK;
+	return (age < mSpan) && testBit(id & PACKET_ID_MASK);
+}
+
+void LLPacketIDWindow::forgetBefore(TPACKETID oldest_id)
+{
+	U32 age = (mHighest - oldest_id) & PACKET_ID_MASK;
+	if (age < PACKET_ID_HALF_RANGE)
+	{
+		mSpan = llmin(mSpan, age + 1);
+	}
+	else
+	{
+		// Everything we have seen is older.
+		mSpan = 0;
+	}
+}
@@ -0,0 +1,70 @@
+/** 
+ * @file llpacketidwindow.h
+ * @brief Sliding bitmap of recently received packet IDs.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ * 
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ * 
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ * 
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLPACKETIDWINDOW_H
+#define LL_LLPACKETIDWINDOW_H
+
+#include <vector>
+
+/**
+ * @class LLPacketIDWindow
+ * @brief Remembers which of the most recent packet IDs were received.
+ *
+ * One bit per ID for a fixed size window ending at the highest ID
+ * added so far, with the 24 bit wrap of circuit packet IDs handled.
+ * IDs older than the window, or forgotten with forgetBefore(), read as
+ * not received.
+ */
+class LLPacketIDWindow
+{
+public:
+	// size is rounded up to a multiple of 32.
+	LLPacketIDWindow(U32 size = 65536);
+
+	void add(TPACKETID id);
+	bool contains(TPACKETID id) const;
+
+	// Stops tracking the IDs before oldest_id.
+	void forgetBefore(TPACKETID oldest_id);
+
+	void clear()				{ mSpan = 0; }
+	bool empty() const			{ return mSpan == 0; }
+	// Number of IDs currently tracked, received or not.
+	U32 getSpan() const			{ return mSpan; }
+
+private:
+	void setBit(TPACKETID id)		{ mBits[(id % mSize) >> 5] |= (1U << (id & 31)); }
+	void clearBit(TPACKETID id)		{ mBits[(id % mSize) >> 5] &= ~(1U << (id & 31)); }
+	bool testBit(TPACKETID id) const	{ return (mBits[(id % mSize) >> 5] & (1U << (id & 31))) != 0; }
+
+private:
+	std::vector<U32> mBits;
+	U32 mSize;
+	TPACKETID mHighest;
+	U32 mSpan;		// IDs tracked, counting back from mHighest
+};
+
+#endif // LL_LLPACKETIDWINDOW_H
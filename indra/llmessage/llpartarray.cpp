@@ -0,0 +1,275 @@
+/**
+ * @file llpartarray.cpp
+ * @brief Particle state stored one array per component for batch updates.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "llpartarray.h"
+
+#include "llv4math.h"	// for LL_VECTORIZE
+
+LLPartArray::LLPartArray()
+:	mSize(0)
+{
+}
+
+S32 LLPartArray::add(const LLPartData& data,
+					 const LLVector3& pos, const LLVector3& velocity, const LLVector3& accel,
+					 const LLColor4& color, const LLVector2& scale,
+					 F32 age, F32 skip_offset)
+{
+	mData[POS_X].push_back(pos.mV[VX]);
+	mData[POS_Y].push_back(pos.mV[VY]);
+	mData[POS_Z].push_back(pos.mV[VZ]);
+	mData[VEL_X].push_back(velocity.mV[VX]);
+	mData[VEL_Y].push_back(velocity.mV[VY]);
+	mData[VEL_Z].push_back(velocity.mV[VZ]);
+	mData[ACCEL_X].push_back(accel.mV[VX]);
+	mData[ACCEL_Y].push_back(accel.mV[VY]);
+	mData[ACCEL_Z].push_back(accel.mV[VZ]);
+	mData[COLOR_R].push_back(color.mV[VRED]);
+	mData[COLOR_G].push_back(color.mV[VGREEN]);
+	mData[COLOR_B].push_back(color.mV[VBLUE]);
+	mData[COLOR_A].push_back(color.mV[VALPHA]);
+	mData[START_COLOR_R].push_back(data.mStartColor.mV[VRED]);
+	mData[START_COLOR_G].push_back(data.mStartColor.mV[VGREEN]);
+	mData[START_COLOR_B].push_back(data.mStartColor.mV[VBLUE]);
+	mData[START_COLOR_A].push_back(data.mStartColor.mV[VALPHA]);
+	mData[END_COLOR_R].push_back(data.mEndColor.mV[VRED]);
+	mData[END_COLOR_G].push_back(data.mEndColor.mV[VGREEN]);
+	mData[END_COLOR_B].push_back(data.mEndColor.mV[VBLUE]);
+	mData[END_COLOR_A].push_back(data.mEndColor.mV[VALPHA]);
+	mData[SCALE_X].push_back(scale.mV[VX]);
+	mData[SCALE_Y].push_back(scale.mV[VY]);
+	mData[START_SCALE_X].push_back(data.mStartScale.mV[VX]);
+	mData[START_SCALE_Y].push_back(data.mStartScale.mV[VY]);
+	mData[END_SCALE_X].push_back(data.mEndScale.mV[VX]);
+	mData[END_SCALE_Y].push_back(data.mEndScale.mV[VY]);
+	mData[AGE].push_back(age);
+	mData[MAX_AGE].push_back(data.mMaxAge);
+	mData[STEP].push_back(0.f);
+	mData[SKIP_OFFSET].push_back(skip_offset);
+	mData[MOVES].push_back(0.f);
+	mData[INTERP_COLOR].push_back(0.f);
+	mData[INTERP_SCALE].push_back(0.f);
+	mFlags.push_back(data.mFlags);
+
+	S32 index = mSize++;
+	updateMasks(index);
+	return index;
+}
+
+void LLPartArray::remove(S32 index)
+{
+	llassert(index >= 0 && index < mSize);
+	for (S32 c = 0; c < NUM_COMPONENTS; c++)
+	{
+		mData[c][index] = mData[c].back();
+		mData[c].pop_back();
+	}
+	mFlags[index] = mFlags.back();
+	mFlags.pop_back();
+	mSize--;
+}
+
+void LLPartArray::clear()
+{
+	for (S32 c = 0; c < NUM_COMPONENTS; c++)
+	{
+		mData[c].clear();
+	}
+	mFlags.clear();
+	mSize = 0;
+}
+
+void LLPartArray::reserve(S32 count)
+{
+	for (S32 c = 0; c < NUM_COMPONENTS; c++)
+	{
+		mData[c].reserve(count);
+	}
+	mFlags.reserve(count);
+}
+
+void LLPartArray::shift(const LLVector3& offset)
+{
+	for (S32 axis = 0; axis < 3; axis++)
+	{
+		std::vector<F32>& pos = mData[POS_X + axis];
+		for (S32 i = 0; i < mSize; i++)
+		{
+			pos[i] += offset.mV[axis];
+		}
+	}
+}
+
+void LLPartArray::beginStep(F32 dt)
+{
+	for (S32 i = 0; i < mSize; i++)
+	{
+		mData[STEP][i] = dt - mData[SKIP_OFFSET][i];
+		mData[SKIP_OFFSET][i] = 0.f;
+	}
+}
+
+void LLPartArray::setPosition(S32 i, const LLVector3& pos)
+{
+	mData[POS_X][i] = pos.mV[VX];
+	mData[POS_Y][i] = pos.mV[VY];
+	mData[POS_Z][i] = pos.mV[VZ];
+}
+
+void LLPartArray::setVelocity(S32 i, const LLVector3& velocity)
+{
+	mData[VEL_X][i] = velocity.mV[VX];
+	mData[VEL_Y][i] = velocity.mV[VY];
+	mData[VEL_Z][i] = velocity.mV[VZ];
+}
+
+void LLPartArray::setFlags(S32 i, U32 flags)
+{
+	mFlags[i] = flags;
+	updateMasks(i);
+}
+
+void LLPartArray::updateMasks(S32 i)
+{
+	const U32 flags = mFlags[i];
+	mData[MOVES][i] = (flags & LLPartData::LL_PART_TARGET_LINEAR_MASK) ? 0.f : 1.f;
+	mData[INTERP_COLOR][i] = (flags & LLPartData::LL_PART_INTERP_COLOR_MASK) ? 1.f : 0.f;
+	mData[INTERP_SCALE][i] = (flags & LLPartData::LL_PART_INTERP_SCALE_MASK) ? 1.f : 0.f;
+}
+
+// The same arithmetic as the SSE pass below, in the same order, so a
+// particle ends up in the same place whichever way it was updated.
+void LLPartArray::integrateScalar(S32 begin, S32 end)
+{
+	for (S32 i = begin; i < end; i++)
+	{
+		const F32 dt = mData[STEP][i];
+		const F32 cur_time = mData[AGE][i] + dt;
+		const F32 frac = cur_time / mData[MAX_AGE][i];
+		mData[AGE][i] = cur_time;
+
+		if (mData[MOVES][i] != 0.f)
+		{
+			const F32 half_dt_sq = 0.5f * dt * dt;
+			for (S32 axis = 0; axis < 3; axis++)
+			{
+				F32& pos = mData[POS_X + axis][i];
+				F32& vel = mData[VEL_X + axis][i];
+				const F32 accel = mData[ACCEL_X + axis][i];
+				pos = pos + dt * vel + half_dt_sq * accel;
+				vel = vel + accel * dt;
+			}
+		}
+
+		const F32 inv_frac = 1.f - frac;
+		if (mData[INTERP_COLOR][i] != 0.f)
+		{
+			for (S32 c = 0; c < 4; c++)
+			{
+				mData[COLOR_R + c][i] = mData[START_COLOR_R + c][i] * inv_frac + mData[END_COLOR_R + c][i] * frac;
+			}
+		}
+		if (mData[INTERP_SCALE][i] != 0.f)
+		{
+			for (S32 c = 0; c < 2; c++)
+			{
+				mData[SCALE_X + c][i] = mData[START_SCALE_X + c][i] * inv_frac + mData[END_SCALE_X + c][i] * frac;
+			}
+		}
+	}
+}
+
+#if LL_VECTORIZE
+
+// mask ? a : b
+static inline __m128 select_ps(const __m128 mask, const __m128 a, const __m128 b)
+{
+	return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+#endif
+
+void LLPartArray::integrate()
+{
+	S32 i = 0;
+#if LL_VECTORIZE
+	F32* data[NUM_COMPONENTS];
+	for (S32 c = 0; c < NUM_COMPONENTS; c++)
+	{
+		data[c] = mSize ? &mData[c][0] : NULL;
+	}
+
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.f);
+	const __m128 half = _mm_set1_ps(0.5f);
+	for (; i + 4 <= mSize; i += 4)
+	{
+		const __m128 dt = _mm_loadu_ps(data[STEP] + i);
+		const __m128 cur_time = _mm_add_ps(_mm_loadu_ps(data[AGE] + i), dt);
+		const __m128 frac = _mm_div_ps(cur_time, _mm_loadu_ps(data[MAX_AGE] + i));
+		_mm_storeu_ps(data[AGE] + i, cur_time);
+
+		const __m128 moves = _mm_cmpneq_ps(_mm_loadu_ps(data[MOVES] + i), zero);
+		const __m128 half_dt_sq = _mm_mul_ps(_mm_mul_ps(half, dt), dt);
+		for (S32 axis = 0; axis < 3; axis++)
+		{
+			F32* pos = data[POS_X + axis] + i;
+			F32* vel = data[VEL_X + axis] + i;
+			const __m128 p = _mm_loadu_ps(pos);
+			const __m128 v = _mm_loadu_ps(vel);
+			const __m128 a = _mm_loadu_ps(data[ACCEL_X + axis] + i);
+			const __m128 new_p = _mm_add_ps(_mm_add_ps(p, _mm_mul_ps(dt, v)), _mm_mul_ps(half_dt_sq, a));
+			const __m128 new_v = _mm_add_ps(v, _mm_mul_ps(a, dt));
+			_mm_storeu_ps(pos, select_ps(moves, new_p, p));
+			_mm_storeu_ps(vel, select_ps(moves, new_v, v));
+		}
+
+		const __m128 inv_frac = _mm_sub_ps(one, frac);
+		const __m128 interp_color = _mm_cmpneq_ps(_mm_loadu_ps(data[INTERP_COLOR] + i), zero);
+		for (S32 c = 0; c < 4; c++)
+		{
+			F32* color = data[COLOR_R + c] + i;
+			const __m128 start = _mm_loadu_ps(data[START_COLOR_R + c] + i);
+			const __m128 end = _mm_loadu_ps(data[END_COLOR_R + c] + i);
+			const __m128 lerped = _mm_add_ps(_mm_mul_ps(start, inv_frac), _mm_mul_ps(end, frac));
+			_mm_storeu_ps(color, select_ps(interp_color, lerped, _mm_loadu_ps(color)));
+		}
+
+		const __m128 interp_scale = _mm_cmpneq_ps(_mm_loadu_ps(data[INTERP_SCALE] + i), zero);
+		for (S32 c = 0; c < 2; c++)
+		{
+			F32* scale = data[SCALE_X + c] + i;
+			const __m128 start = _mm_loadu_ps(data[START_SCALE_X + c] + i);
+			const __m128 end = _mm_loadu_ps(data[END_SCALE_X + c] + i);
+			const __m128 lerped = _mm_add_ps(_mm_mul_ps(start, inv_frac), _mm_mul_ps(end, frac));
+			_mm_storeu_ps(scale, select_ps(interp_scale, lerped, _mm_loadu_ps(scale)));
+		}
+	}
+#endif
+	integrateScalar(i, mSize);
+}
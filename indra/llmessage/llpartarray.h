@@ -0,0 +1,132 @@
+/**
+ * @file llpartarray.h
+ * @brief Particle state stored one array per component for batch updates.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLPARTARRAY_H
+#define LL_LLPARTARRAY_H
+
+#include <vector>
+
+#include "llpartdata.h"
+#include "v2math.h"
+#include "v3math.h"
+#include "v4color.h"
+
+/**
+ * @class LLPartArray
+ * @brief The moving state of a group of particles, structure of arrays.
+ *
+ * Position, velocity, color, scale and age of each particle live in
+ * separate arrays, so integrate() can move, age and interpolate four
+ * particles per SSE pass. Anything that needs per particle logic, like
+ * wind or following a source, is done by the owner through the
+ * accessors before or after the batch step.
+ *
+ * Particles are removed by moving the last one into their slot, and
+ * the arrays are never shrunk, so a group that keeps emitting and
+ * killing particles stops allocating once it has reached its peak count.
+ */
+class LLPartArray
+{
+public:
+	LLPartArray();
+
+	// Appends a particle and returns its index. Flags, max age and the
+	// interpolation end points come from data.
+	S32 add(const LLPartData& data,
+			const LLVector3& pos, const LLVector3& velocity, const LLVector3& accel,
+			const LLColor4& color, const LLVector2& scale,
+			F32 age, F32 skip_offset);
+
+	// Moves the last particle into index, which changes its index.
+	void remove(S32 index);
+	void clear();
+	void reserve(S32 count);
+
+	S32 size() const					{ return mSize; }
+	bool empty() const					{ return mSize == 0; }
+
+	// Adds offset to every particle position.
+	void shift(const LLVector3& offset);
+
+	// Sets each particle's time step for the next integrate() to dt less
+	// its skip offset, and clears the offset. The offset is the part of
+	// dt that went by before the particle was added.
+	void beginStep(F32 dt);
+
+	// Advances every particle by its time step: applies velocity and
+	// acceleration (unless it is flagged LL_PART_TARGET_LINEAR_MASK, which
+	// is placed by its owner), interpolates color and scale when flagged
+	// and adds the step to its age.
+	void integrate();
+
+	LLVector3 getPosition(S32 i) const		{ return LLVector3(mData[POS_X][i], mData[POS_Y][i], mData[POS_Z][i]); }
+	void setPosition(S32 i, const LLVector3& pos);
+	LLVector3 getVelocity(S32 i) const		{ return LLVector3(mData[VEL_X][i], mData[VEL_Y][i], mData[VEL_Z][i]); }
+	void setVelocity(S32 i, const LLVector3& velocity);
+	LLVector3 getAccel(S32 i) const			{ return LLVector3(mData[ACCEL_X][i], mData[ACCEL_Y][i], mData[ACCEL_Z][i]); }
+	LLColor4 getColor(S32 i) const			{ return LLColor4(mData[COLOR_R][i], mData[COLOR_G][i], mData[COLOR_B][i], mData[COLOR_A][i]); }
+	LLVector2 getScale(S32 i) const			{ return LLVector2(mData[SCALE_X][i], mData[SCALE_Y][i]); }
+	F32 getAge(S32 i) const					{ return mData[AGE][i]; }
+	F32 getMaxAge(S32 i) const				{ return mData[MAX_AGE][i]; }
+	F32 getStep(S32 i) const				{ return mData[STEP][i]; }
+	void setSkipOffset(S32 i, F32 offset)	{ mData[SKIP_OFFSET][i] = offset; }
+	U32 getFlags(S32 i) const				{ return mFlags[i]; }
+	void setFlags(S32 i, U32 flags);
+
+private:
+	enum
+	{
+		POS_X, POS_Y, POS_Z,
+		VEL_X, VEL_Y, VEL_Z,
+		ACCEL_X, ACCEL_Y, ACCEL_Z,
+		COLOR_R, COLOR_G, COLOR_B, COLOR_A,
+		START_COLOR_R, START_COLOR_G, START_COLOR_B, START_COLOR_A,
+		END_COLOR_R, END_COLOR_G, END_COLOR_B, END_COLOR_A,
+		SCALE_X, SCALE_Y,
+		START_SCALE_X, START_SCALE_Y,
+		END_SCALE_X, END_SCALE_Y,
+		AGE,
+		MAX_AGE,
+		STEP,
+		SKIP_OFFSET,
+		// 1 where the flags ask for that part of the step and 0 where
+		// not, so the SSE pass can blend with compare masks
+		MOVES,
+		INTERP_COLOR,
+		INTERP_SCALE,
+		NUM_COMPONENTS
+	};
+
+	void updateMasks(S32 i);
+	void integrateScalar(S32 begin, S32 end);
+
+private:
+	S32 mSize;
+	std::vector<F32> mData[NUM_COMPONENTS];
+	std::vector<U32> mFlags;
+};
+
+#endif // LL_LLPARTARRAY_H
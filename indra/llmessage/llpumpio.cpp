@@ -37,6 +37,8 @@
 #include "llmemtype.h"
 #include "llstl.h"
 #include "llstat.h"
+#include "llpumpiothread.h"
+#include "llthread.h"
 
 // These should not be enabled in production, but they can be
 // intensely useful during development for finding certain kinds of
@@ -53,13 +55,9 @@
 #include <typeinfo>
 #endif
 
-// constants for poll timeout. if we are threading, we want to have a
-// longer poll timeout.
-#if LL_THREADS_APR
-static const S32 DEFAULT_POLL_TIMEOUT = 1000;
-#else
+// constant for poll timeout. The main loop must never block in the
+// poll, a dedicated i/o thread passes its own timeout to pump().
 static const S32 DEFAULT_POLL_TIMEOUT = 0;
-#endif
 
 // The default (and fallback) expiration time for chains
 const F32 DEFAULT_CHAIN_EXPIRY_SECS = 30.0f;
@@ -173,11 +171,15 @@ LLPumpIO::LLPumpIO(apr_pool_t* pool) :
 	mCurrentPoolReallocCount(0),
 	mChainsMutex(NULL),
 	mCallbackMutex(NULL),
+	mIOThread(NULL),
 	mCurrentChain(mRunningChains.end())
 {
 	mCurrentChain = mRunningChains.end();
 
 	LLMemType m1(LLMemType::MTYPE_IO_PUMP);
+	// The mutexes get their own pools so they outlive prime().
+	mChainsMutex = new LLMutex(NULL);
+	mCallbackMutex = new LLMutex(NULL);
 	initialize(pool);
 }
 
@@ -185,6 +187,10 @@ LLPumpIO::~LLPumpIO()
 {
 	LLMemType m1(LLMemType::MTYPE_IO_PUMP);
 	cleanup();
+	delete mChainsMutex;
+	mChainsMutex = NULL;
+	delete mCallbackMutex;
+	mCallbackMutex = NULL;
 }
 
 bool LLPumpIO::prime(apr_pool_t* pool)
@@ -195,14 +201,23 @@ bool LLPumpIO::prime(apr_pool_t* pool)
 	return ((pool == NULL) ? false : true);
 }
 
+void LLPumpIO::setIOThread(LLPumpIOThread* thread)
+{
+	LLMutexLock lock(mChainsMutex);
+	mIOThread = thread;
+}
+
+bool LLPumpIO::hasPendingChains() const
+{
+	LLMutexLock lock(mChainsMutex);
+	return !mPendingChains.empty();
+}
+
 bool LLPumpIO::addChain(const chain_t& chain, F32 timeout)
 {
 	LLMemType m1(LLMemType::MTYPE_IO_PUMP);
 	if(chain.empty()) return false;
 
-#if LL_THREADS_APR
-	LLScopedLock lock(mChainsMutex);
-#endif
 	LLChainInfo info;
 	info.setTimeoutSeconds(timeout);
 	info.mData = LLIOPipe::buffer_ptr_t(new LLBufferArray);
@@ -221,7 +236,16 @@ bool LLPumpIO::addChain(const chain_t& chain, F32 timeout)
 		link.mChannels = info.mData->nextChannel();
 		info.mChainLinks.push_back(link);
 	}
-	mPendingChains.push_back(info);
+	LLPumpIOThread* io_thread = NULL;
+	{
+		LLMutexLock lock(mChainsMutex);
+		mPendingChains.push_back(info);
+		io_thread = mIOThread;
+	}
+	if(io_thread)
+	{
+		io_thread->wakeIO();
+	}
 	return true;
 }
 
@@ -239,9 +263,6 @@ bool LLPumpIO::addChain(
 	if(!data) return false;
 	if(links.empty()) return false;
 
-#if LL_THREADS_APR
-	LLScopedLock lock(mChainsMutex);
-#endif
 #if LL_DEBUG_PIPE_TYPE_IN_PUMP
 	lldebugs << "LLPumpIO::addChain() " << links[0].mPipe << " '"
 		<< typeid(*(links[0].mPipe)).name() << "'" << llendl;
@@ -253,7 +274,16 @@ bool LLPumpIO::addChain(
 	info.mChainLinks = links;
 	info.mData = data;
 	info.mContext = context;
-	mPendingChains.push_back(info);
+	LLPumpIOThread* io_thread = NULL;
+	{
+		LLMutexLock lock(mChainsMutex);
+		mPendingChains.push_back(info);
+		io_thread = mIOThread;
+	}
+	if(io_thread)
+	{
+		io_thread->wakeIO();
+	}
 	return true;
 }
 
@@ -397,10 +427,16 @@ void LLPumpIO::clearLock(S32 key)
 	// therefore won't be treading into deleted memory. I think we can
 	// also clear the lock on the chain safely since the pump only
 	// reads that value.
-#if LL_THREADS_APR
-	LLScopedLock lock(mChainsMutex);
-#endif
-	mClearLocks.insert(key);
+	LLPumpIOThread* io_thread = NULL;
+	{
+		LLMutexLock lock(mChainsMutex);
+		mClearLocks.insert(key);
+		io_thread = mIOThread;
+	}
+	if(io_thread)
+	{
+		io_thread->wakeIO();
+	}
 }
 
 bool LLPumpIO::sleepChain(F64 seconds)
@@ -444,7 +480,20 @@ static LLFastTimer::DeclareTimer FTM_PUMP_IO("Pump IO");
 void LLPumpIO::pump(const S32& poll_timeout)
 {
 	LLMemType m1(LLMemType::MTYPE_IO_PUMP);
-	LLFastTimer t1(FTM_PUMP_IO);
+	if(isThreaded())
+	{
+		// Fast timers are main thread only.
+		pumpChains(poll_timeout);
+	}
+	else
+	{
+		LLFastTimer t1(FTM_PUMP_IO);
+		pumpChains(poll_timeout);
+	}
+}
+
+void LLPumpIO::pumpChains(const S32& poll_timeout)
+{
 	//llinfos << "LLPumpIO::pump()" << llendl;
 
 	// Run any pending runners.
@@ -455,9 +504,7 @@ void LLPumpIO::pump(const S32& poll_timeout)
 	PUMP_DEBUG;
 	if(true)
 	{
-#if LL_THREADS_APR
-		LLScopedLock lock(mChainsMutex);
-#endif
+		LLMutexLock lock(mChainsMutex);
 		// bail if this pump is paused.
 		if(PAUSING == mState)
 		{
@@ -524,6 +571,11 @@ void LLPumpIO::pump(const S32& poll_timeout)
 		//llinfos << "polling" << llendl;
 		S32 count = 0;
 		S32 client_id = 0;
+		if(isThreaded())
+		{
+			apr_pollset_poll(mPollset, poll_timeout, &count, &poll_fd);
+		}
+		else
         {
             LLPerfBlock polltime("pump_poll");
             apr_pollset_poll(mPollset, poll_timeout, &count, &poll_fd);
@@ -722,9 +774,7 @@ void LLPumpIO::pump(const S32& poll_timeout)
 
 //bool LLPumpIO::respond(const chain_t& pipes)
 //{
-//#if LL_THREADS_APR
-//	LLScopedLock lock(mCallbackMutex);
-//#endif
+//	LLMutexLock lock(mCallbackMutex);
 //	LLChainInfo info;
 //	links_t links;
 //	
@@ -737,13 +787,11 @@ bool LLPumpIO::respond(LLIOPipe* pipe)
 	LLMemType m1(LLMemType::MTYPE_IO_PUMP);
 	if(NULL == pipe) return false;
 
-#if LL_THREADS_APR
-	LLScopedLock lock(mCallbackMutex);
-#endif
 	LLChainInfo info;
 	LLLinkInfo link;
 	link.mPipe = pipe;
 	info.mChainLinks.push_back(link);
+	LLMutexLock lock(mCallbackMutex);
 	mPendingCallbacks.push_back(info);
 	return true;
 }
@@ -759,15 +807,12 @@ bool LLPumpIO::respond(
 	if(!data) return false;
 	if(links.empty()) return false;
 
-#if LL_THREADS_APR
-	LLScopedLock lock(mCallbackMutex);
-#endif
-
 	// Add the callback response
 	LLChainInfo info;
 	info.mChainLinks = links;
 	info.mData = data;
 	info.mContext = context;
+	LLMutexLock lock(mCallbackMutex);
 	mPendingCallbacks.push_back(info);
 	return true;
 }
@@ -780,9 +825,7 @@ void LLPumpIO::callback()
 	//llinfos << "LLPumpIO::callback()" << llendl;
 	if(true)
 	{
-#if LL_THREADS_APR
-		LLScopedLock lock(mCallbackMutex);
-#endif
+		LLMutexLock lock(mCallbackMutex);
 		std::copy(
 			mPendingCallbacks.begin(),
 			mPendingCallbacks.end(),
@@ -808,9 +851,7 @@ void LLPumpIO::callback()
 
 void LLPumpIO::control(LLPumpIO::EControl op)
 {
-#if LL_THREADS_APR
-	LLScopedLock lock(mChainsMutex);
-#endif
+	LLMutexLock lock(mChainsMutex);
 	switch(op)
 	{
 	case PAUSE:
@@ -829,23 +870,12 @@ void LLPumpIO::initialize(apr_pool_t* pool)
 {
 	LLMemType m1(LLMemType::MTYPE_IO_PUMP);
 	if(!pool) return;
-#if LL_THREADS_APR
-	// SJB: Windows defaults to NESTED and OSX defaults to UNNESTED, so use UNNESTED explicitly.
-	apr_thread_mutex_create(&mChainsMutex, APR_THREAD_MUTEX_UNNESTED, pool);
-	apr_thread_mutex_create(&mCallbackMutex, APR_THREAD_MUTEX_UNNESTED, pool);
-#endif
 	mPool = pool;
 }
 
 void LLPumpIO::cleanup()
 {
 	LLMemType m1(LLMemType::MTYPE_IO_PUMP);
-#if LL_THREADS_APR
-	if(mChainsMutex) apr_thread_mutex_destroy(mChainsMutex);
-	if(mCallbackMutex) apr_thread_mutex_destroy(mCallbackMutex);
-#endif
-	mChainsMutex = NULL;
-	mCallbackMutex = NULL;
 	if(mPollset)
 	{
 //		lldebugs << "cleaning up pollset" << llendl;
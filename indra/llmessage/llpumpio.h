@@ -40,8 +40,8 @@
 #include "lliopipe.h"
 #include "llrun.h"
 
-// Define this to enable use with the APR thread library.
-//#define LL_THREADS_APR 1
+class LLMutex;
+class LLPumpIOThread;
 
 // some simple constants to help with timeouts
 extern const F32 DEFAULT_CHAIN_EXPIRY_SECS;
@@ -97,6 +97,25 @@ public:
 	 */
 	bool prime(apr_pool_t* pool);
 
+	/**
+	 * @brief Hand this pump over to a dedicated i/o thread.
+	 * @see LLPumpIOThread
+	 *
+	 * Once bound, <code>pump()</code> must only be called from that
+	 * thread and <code>callback()</code> only from the thread which
+	 * should see completions, normally the main thread. The pump
+	 * skips the main thread fast timers and wakes the i/o thread
+	 * whenever a chain is added or a lock is cleared. Pass NULL to
+	 * go back to being driven from the main loop.
+	 * @param thread The thread which will call <code>pump()</code>.
+	 */
+	void setIOThread(LLPumpIOThread* thread);
+
+	/**
+	 * @brief Returns true if the pump is driven by an i/o thread.
+	 */
+	bool isThreaded() const { return (mIOThread != NULL); }
+
 	/**
 	 * @brief Typedef for having a chain of pipes.
 	 */
@@ -386,23 +405,31 @@ protected:
 	callbacks_t mPendingCallbacks;
 	callbacks_t mCallbacks;
 
-	// memory allocator for pollsets & mutexes.
+	// memory allocator for pollsets.
 	apr_pool_t* mPool;
 	apr_pool_t* mCurrentPool;
 	S32 mCurrentPoolReallocCount;
 
-#if LL_THREADS_APR
-	apr_thread_mutex_t* mChainsMutex;
-	apr_thread_mutex_t* mCallbackMutex;
-#else
-	int* mChainsMutex;
-	int* mCallbackMutex;
-#endif
+	// Guards mPendingChains, mClearLocks and mState against
+	// addChain()/clearLock()/control() from other threads.
+	LLMutex* mChainsMutex;
+
+	// Guards mPendingCallbacks against respond() from the i/o thread.
+	LLMutex* mCallbackMutex;
+
+	// The thread calling pump(), or NULL when driven from the main loop.
+	LLPumpIOThread* mIOThread;
 
 protected:
 	void initialize(apr_pool_t* pool);
 	void cleanup();
 
+	/** 
+	 * @brief Implementation of <code>pump()</code> without the
+	 * main thread instrumentation.
+	 */
+	void pumpChains(const S32& poll_timeout);
+
 	/** 
 	 * @brief Given the internal state of the chains, rebuild the pollset
 	 * @see setConditional()
@@ -441,6 +468,33 @@ public:
 		return mRunningChains.size();
 	}
 
+	/** 
+	 * @brief Returns true if any chain is running.
+	 *
+	 * Only meaningful on the thread calling <code>pump()</code>.
+	 */
+	bool hasRunningChains() const
+	{
+		return !mRunningChains.empty();
+	}
+
+	/** 
+	 * @brief Returns true if any chain is waiting to be picked up
+	 * by the next <code>pump()</code>.
+	 *
+	 * Safe to call from any thread.
+	 */
+	bool hasPendingChains() const;
+
+	/** 
+	 * @brief Returns true if the last <code>pump()</code> had file
+	 * descriptors to block on.
+	 */
+	bool hasPollset() const
+	{
+		return (mPollset != NULL);
+	}
+
 
 };
 
@@ -0,0 +1,212 @@
+/** 
+ * @file llpumpiothread.cpp
+ * @brief Implementation of a thread which drives an LLPumpIO.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ * 
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ * 
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ * 
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+#include "llpumpiothread.h"
+
+#if LL_WINDOWS
+	#define WIN32_LEAN_AND_MEAN
+	#include <winsock2.h>
+	#include <windows.h>
+	typedef int socklen_t;
+#else
+	#include <sys/types.h>
+	#include <sys/socket.h>
+	#include <netinet/in.h>
+	#include <arpa/inet.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+#endif
+
+#include "llcurl.h"
+#include "llpumpio.h"
+
+// Longest wait on the curl sockets between pumps when chains are
+// running but none of them have a file descriptor in the pollset.
+// Bounds how late chain timeouts and sleeping chains are noticed.
+static const S32 IO_THREAD_MAX_WAIT_MS = 50;
+
+LLPumpIOThread::LLPumpIOThread(const std::string& name, S32 poll_timeout) :
+	LLThread(name),
+	mPumpPool(NULL),
+	mPump(NULL),
+	mPollTimeout(poll_timeout),
+	mIdleThread(true),
+	mWakeSocket(CURL_SOCKET_BAD),
+	mWakePort(0),
+	mWakePending(0)
+{
+	// The pump gets a pool of its own since apr pools are not thread
+	// safe and the pump allocates pollsets from it on this thread.
+	apr_pool_create(&mPumpPool, NULL);
+	mPump = new LLPumpIO(mPumpPool);
+	mPump->setIOThread(this);
+	openWakeSocket();
+}
+
+LLPumpIOThread::~LLPumpIOThread()
+{
+	shutdown();
+	delete mPump;
+	mPump = NULL;
+	if(mPumpPool)
+	{
+		apr_pool_destroy(mPumpPool);
+		mPumpPool = NULL;
+	}
+	closeWakeSocket();
+}
+
+void LLPumpIOThread::callback()
+{
+	mPump->callback();
+}
+
+void LLPumpIOThread::wakeIO()
+{
+	wake();
+	// Only the first wake since the thread last drained the socket
+	// needs a datagram.
+	if(mWakeSocket != CURL_SOCKET_BAD && mWakePending++ == 0)
+	{
+		struct sockaddr_in addr;
+		memset(&addr, 0, sizeof(addr));
+		addr.sin_family = AF_INET;
+		addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		addr.sin_port = htons(mWakePort);
+		char byte = 0;
+		sendto(mWakeSocket, &byte, 1, 0, (struct sockaddr*)&addr, sizeof(addr));
+	}
+}
+
+void LLPumpIOThread::openWakeSocket()
+{
+	mWakeSocket = socket(AF_INET, SOCK_DGRAM, 0);
+	if(mWakeSocket == CURL_SOCKET_BAD)
+	{
+		llwarns << "LLPumpIOThread " << mName << " could not create its wake socket, "
+				<< "new requests may wait up to " << IO_THREAD_MAX_WAIT_MS << "ms" << llendl;
+		return;
+	}
+
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = 0;
+	socklen_t addr_len = sizeof(addr);
+	if(bind(mWakeSocket, (struct sockaddr*)&addr, sizeof(addr)) != 0
+	   || getsockname(mWakeSocket, (struct sockaddr*)&addr, &addr_len) != 0)
+	{
+		llwarns << "LLPumpIOThread " << mName << " could not bind its wake socket, "
+				<< "new requests may wait up to " << IO_THREAD_MAX_WAIT_MS << "ms" << llendl;
+		closeWakeSocket();
+		return;
+	}
+	mWakePort = ntohs(addr.sin_port);
+
+	// drainWakeSocket() reads until there is nothing left
+#if LL_WINDOWS
+	u_long non_blocking = 1;
+	ioctlsocket(mWakeSocket, FIONBIO, &non_blocking);
+#else
+	fcntl(mWakeSocket, F_SETFL, fcntl(mWakeSocket, F_GETFL) | O_NONBLOCK);
+#endif
+}
+
+void LLPumpIOThread::closeWakeSocket()
+{
+	if(mWakeSocket != CURL_SOCKET_BAD)
+	{
+#if LL_WINDOWS
+		closesocket(mWakeSocket);
+#else
+		close(mWakeSocket);
+#endif
+		mWakeSocket = CURL_SOCKET_BAD;
+	}
+}
+
+void LLPumpIOThread::drainWakeSocket()
+{
+	if(mWakeSocket == CURL_SOCKET_BAD)
+	{
+		return;
+	}
+	char buffer[16];
+	while(recv(mWakeSocket, buffer, sizeof(buffer), 0) > 0)
+	{
+	}
+	// Cleared after reading, so a wakeIO() racing with us either
+	// left its datagram for the next wait or queued its work before
+	// the pump we are about to run.
+	mWakePending = 0;
+}
+
+// virtual
+bool LLPumpIOThread::runCondition()
+{
+	// mRunCondition must be locked here
+	return !mIdleThread || mPump->hasPendingChains();
+}
+
+// virtual
+void LLPumpIOThread::run()
+{
+	// call checkPause() immediately so we don't try to do anything before the class is fully constructed
+	checkPause();
+
+	while(1)
+	{
+		// this will block on the condition until there is a chain to run,
+		// the thread is unpaused, or the thread leaves the RUNNING state.
+		checkPause();
+
+		if(isQuitting())
+		{
+			break;
+		}
+
+		mPump->pump(mPollTimeout);
+
+		bool idle = !mPump->hasRunningChains();
+		lockData();
+		mIdleThread = idle;
+		unlockData();
+
+		if(!idle && !mPump->hasPollset())
+		{
+			// Chains are waiting on curl transfers, so block on their
+			// sockets until one needs attention or wakeIO() is called.
+			LLCurl::waitForTransfers(IO_THREAD_MAX_WAIT_MS, mWakeSocket);
+			drainWakeSocket();
+		}
+	}
+	// Our curl host pools must not outlive us, the requests still in
+	// chains free the ones they hold when the pump is deleted.
+	LLCurl::cleanupThread();
+	llinfos << "LLPumpIOThread " << mName << " EXITING." << llendl;
+}
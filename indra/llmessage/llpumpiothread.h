@@ -0,0 +1,106 @@
+/** 
+ * @file llpumpiothread.h
+ * @brief Declaration of a thread which drives an LLPumpIO.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ * 
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ * 
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ * 
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLPUMPIOTHREAD_H
+#define LL_LLPUMPIOTHREAD_H
+
+#include <curl/curl.h>
+
+#include "llapr.h"
+#include "llthread.h"
+
+class LLPumpIO;
+
+/** 
+ * @class LLPumpIOThread
+ * @brief Runs an LLPumpIO on a dedicated thread.
+ *
+ * The thread owns a pump and calls <code>pump()</code> on it as fast
+ * as there is work to do, blocking in the pollset (epoll on linux)
+ * when chains are waiting on file descriptors, in select() on the
+ * sockets of its curl transfers when chains are waiting on those,
+ * and on its run condition when there are no chains at all. Chains may be added from
+ * any thread. Pipes which finish call <code>respond()</code> on the
+ * pump, and those responses are only processed when the owner calls
+ * <code>callback()</code>, so completion handlers such as
+ * LLHTTPClient responders still run on the main thread.
+ */
+class LLPumpIOThread : public LLThread
+{
+public:
+	/**
+	 * @brief Constructor.
+	 *
+	 * @param name The thread name, used for logging.
+	 * @param poll_timeout Microseconds to block in the pollset.
+	 */
+	LLPumpIOThread(const std::string& name, S32 poll_timeout = 1000);
+
+	/**
+	 * @brief Destructor. Stops the thread before deleting the pump.
+	 */
+	virtual ~LLPumpIOThread();
+
+	/**
+	 * @brief The pump driven by this thread.
+	 */
+	LLPumpIO* getPump() { return mPump; }
+
+	/**
+	 * @brief Process completed responses. Call from the main loop.
+	 */
+	void callback();
+
+	/**
+	 * @brief Wake the thread because there is new work for the pump.
+	 *
+	 * Ends a wait on the run condition or on the curl sockets. Safe
+	 * to call from any thread.
+	 */
+	void wakeIO();
+
+protected:
+	/*virtual*/ void run(void);
+	/*virtual*/ bool runCondition(void);
+
+	void openWakeSocket();
+	void closeWakeSocket();
+	void drainWakeSocket();
+
+protected:
+	apr_pool_t* mPumpPool;
+	LLPumpIO* mPump;
+	S32 mPollTimeout;
+	bool mIdleThread;
+
+	// A loopback datagram socket which wakeIO() sends to itself so
+	// it turns up readable in the select() on the curl sockets.
+	curl_socket_t mWakeSocket;
+	U16 mWakePort;
+	LLAtomicU32 mWakePending;
+};
+
+#endif // LL_LLPUMPIOTHREAD_H
@@ -112,6 +112,15 @@ void LLSDMessageReader::getBinaryData(const char *block, const char *var,
 	memcpy(datap, &(data[0]), data_size);
 }
 
+//virtual
+const U8* LLSDMessageReader::getBinaryDataPointer(const char *block, const char *var, 
+												  S32 &size, S32 blocknum)
+{
+	// binary LLSD values are only handed out as copies
+	size = 0;
+	return NULL;
+}
+
 //virtual 
 void LLSDMessageReader::getBOOL(const char *block, const char *var, 
 								BOOL &data, 
@@ -46,6 +46,8 @@ public:
 	virtual void getBinaryData(const char *block, const char *var, 
 							   void *datap, S32 size, S32 blocknum = 0, 
 							   S32 max_size = S32_MAX);
+	virtual const U8* getBinaryDataPointer(const char *block, const char *var, 
+										   S32 &size, S32 blocknum = 0);
 	virtual void getBOOL(const char *block, const char *var, BOOL &data, 
 						 S32 blocknum = 0);
 	virtual void getS8(const char *block, const char *var, S8 &data, 
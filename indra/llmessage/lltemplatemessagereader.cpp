@@ -145,6 +145,49 @@ void LLTemplateMessageReader::getData(const char *blockname, const char *varname
 	}
 }
 
+const U8* LLTemplateMessageReader::getBinaryDataPointer(const char *blockname, const char *varname, S32 &size, S32 blocknum)
+{
+	size = 0;
+
+	// is there a message ready to go?
+	if (mReceiveSize == -1)
+	{
+		llerrs << "No message waiting for decode 2!" << llendl;
+		return NULL;
+	}
+
+	if (!mCurrentRMessageData)
+	{
+		llerrs << "Invalid mCurrentMessageData in getBinaryDataPointer!" << llendl;
+		return NULL;
+	}
+
+	char *bnamep = (char *)blockname + blocknum; // this works because it's just a hash.  The bnamep is never derefference
+	char *vnamep = (char *)varname; 
+
+	LLMsgData::msg_blk_data_map_t::const_iterator iter = mCurrentRMessageData->mMemberBlocks.find(bnamep);
+
+	if (iter == mCurrentRMessageData->mMemberBlocks.end())
+	{
+		llerrs << "Block " << blockname << " #" << blocknum
+			<< " not in message " << mCurrentRMessageData->mName << llendl;
+		return NULL;
+	}
+
+	LLMsgBlkData *msg_block_data = iter->second;
+	LLMsgVarData& vardata = msg_block_data->mMemberVarData[vnamep];
+
+	if (!vardata.getName())
+	{
+		llerrs << "Variable "<< vnamep << " not in message "
+			<< mCurrentRMessageData->mName<< " block " << bnamep << llendl;
+		return NULL;
+	}
+
+	size = vardata.getSize();
+	return (const U8*)vardata.getData();
+}
+
 S32 LLTemplateMessageReader::getNumberOfBlocks(const char *blockname)
 {
 	// is there a message ready to go?
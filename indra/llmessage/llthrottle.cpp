@@ -180,7 +180,12 @@ const char* THROTTLE_NAMES[TC_EOF] =
 	"Asset  "
 };
 
+// static
+BOOL LLThrottleGroup::sCongestionControlDefault = FALSE;
+
 LLThrottleGroup::LLThrottleGroup()
+:	mCongestionControl(sCongestionControlDefault),
+	mCongestionScale(1.f)
 {
 	S32 i;
 	for (i = 0; i < TC_EOF; i++)
@@ -259,12 +264,27 @@ BOOL LLThrottleGroup::setNominalBPS(F32* throttle_vec)
 	return changed;
 }
 
+void LLThrottleGroup::setCongestionControl(BOOL enable)
+{
+	mCongestionControl = enable;
+	mCongestion.reset();
+	mCongestionScale = enable ? mCongestion.getScale() : 1.f;
+}
+
+void LLThrottleGroup::updateCongestion(F32 rtt_ms, F32 loss_fraction)
+{
+	if (mCongestionControl)
+	{
+		mCongestionScale = mCongestion.update(rtt_ms, loss_fraction);
+	}
+}
+
 // Return bits available in the channel
 S32		LLThrottleGroup::getAvailable(S32 throttle_cat)
 {
 	S32 retval = 0;
 
-	F32 category_bps = mCurrentBPS[throttle_cat];
+	F32 category_bps = getCategoryBPS(throttle_cat);
 	F32 lookahead_bits = category_bps * THROTTLE_LOOKAHEAD_TIME;
 
 	// use a temporary bits_available
@@ -289,7 +309,7 @@ BOOL LLThrottleGroup::checkOverflow(S32 throttle_cat, F32 bits)
 {
 	BOOL retval = TRUE;
 
-	F32 category_bps = mCurrentBPS[throttle_cat];
+	F32 category_bps = getCategoryBPS(throttle_cat);
 	F32 lookahead_bits = category_bps * THROTTLE_LOOKAHEAD_TIME;
 
 	// use a temporary bits_available
@@ -320,7 +340,7 @@ BOOL LLThrottleGroup::throttleOverflow(S32 throttle_cat, F32 bits)
 	F32 lookahead_bits;
 	BOOL retval = TRUE;
 
-	category_bps = mCurrentBPS[throttle_cat];
+	category_bps = getCategoryBPS(throttle_cat);
 	lookahead_bits = category_bps * THROTTLE_LOOKAHEAD_TIME;
 
 	F64 mt_sec = LLMessageSystem::getMessageTimeSeconds();
@@ -405,7 +425,9 @@ BOOL LLThrottleGroup::dynamicAdjust()
 	for (i = 0; i < TC_EOF; i++)
 	{
 		// Is this a busy channel?
-		if (mBitsSentHistory[i] >= BUSY_PERCENT * DYNAMIC_ADJUST_TIME * mCurrentBPS[i])
+		// Compare against the congestion scaled rate, which is all a channel
+		// could have used.
+		if (mBitsSentHistory[i] >= BUSY_PERCENT * DYNAMIC_ADJUST_TIME * getCategoryBPS(i))
 		{
 			// this channel is busy
 			channels_busy = TRUE;
@@ -418,7 +440,7 @@ BOOL LLThrottleGroup::dynamicAdjust()
 		}
 
 		// Is this an idle channel?
-		if ((mBitsSentHistory[i] < IDLE_PERCENT * DYNAMIC_ADJUST_TIME * mCurrentBPS[i]) &&
+		if ((mBitsSentHistory[i] < IDLE_PERCENT * DYNAMIC_ADJUST_TIME * getCategoryBPS(i)) &&
 			(mBitsAvailable[i] > 0))
 		{
 			channel_idle[i] = TRUE;
@@ -462,7 +484,8 @@ BOOL LLThrottleGroup::dynamicAdjust()
 				// Therefore it's a candidate to give up some bandwidth.
 				// Figure out how much bandwidth it has been using, and how
 				// much is available to steal.
-				used_bps = mBitsSentHistory[i] / DYNAMIC_ADJUST_TIME;
+				// In unscaled terms, like mCurrentBPS.
+				used_bps = mBitsSentHistory[i] / DYNAMIC_ADJUST_TIME / mCongestionScale;
 
 				// CRO make sure to keep a minimum amount of throttle available
 				// CRO NB: channels set to < MINIMUM_BPS will never give up bps, 
@@ -28,6 +28,7 @@
 #define LL_LLTHROTTLE_H
 
 #include "lltimer.h"
+#include "llcongestioncontroller.h"
 
 const S32 MAX_THROTTLE_SIZE = 32;
 
@@ -80,12 +81,23 @@ public:
 
 	S32		getAvailable(S32 throttle_cat);					// Return bits available in the channel
 
+	// Congestion control scales all channels down to what the link is
+	// taking, based on round trip and loss samples from the circuit.
+	void	setCongestionControl(BOOL enable);
+	BOOL	getCongestionControl() const					{ return mCongestionControl; }
+	void	updateCongestion(F32 rtt_ms, F32 loss_fraction);
+	F32		getCongestionScale() const						{ return mCongestionScale; }
+	// Whether new throttle groups start with congestion control on.
+	static void setCongestionControlDefault(BOOL enable)	{ sCongestionControlDefault = enable; }
+
 	void packThrottle(LLDataPacker &dp) const;
 	void unpackThrottle(LLDataPacker &dp);
 public:
 	F32		mThrottleTotal[TC_EOF];	// BPS available, sent by viewer, sum for all simulators
 
 protected:
+	F32		getCategoryBPS(S32 throttle_cat) const			{ return mCurrentBPS[throttle_cat] * mCongestionScale; }
+
 	F32		mNominalBPS[TC_EOF];	// BPS available, adjusted to be just this simulator
 	F32		mCurrentBPS[TC_EOF];	// BPS available, dynamically adjusted
 
@@ -96,6 +108,12 @@ protected:
 	F64		mLastSendTime[TC_EOF];		// Time since last send on this channel
 	F64		mDynamicAdjustTime;	// Only dynamic adjust every 2 seconds or so.
 
+	BOOL	mCongestionControl;
+	F32		mCongestionScale;		// 1 unless congestion control is on
+	LLCongestionController mCongestion;
+
+	static BOOL sCongestionControlDefault;
+
 };
 
 #endif
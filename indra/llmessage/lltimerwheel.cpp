@@ -0,0 +1,99 @@
+/** 
+ * @file lltimerwheel.cpp
+ * @brief Coarse timer wheel for scheduling packet resends.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ * 
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ * 
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ * 
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "lltimerwheel.h"
+
+LLTimerWheel::LLTimerWheel(F64 tick_seconds, U32 slot_count) :
+	mSlots(llmax(slot_count, 1U)),
+	mTickSeconds(tick_seconds),
+	mCurrentTick(0),
+	mSize(0)
+{
+	llassert(tick_seconds > 0.0);
+}
+
+U64 LLTimerWheel::tickOf(F64 when) const
+{
+	return (when > 0.0) ? (U64)(when / mTickSeconds) : 0;
+}
+
+void LLTimerWheel::schedule(U32 id, F64 when)
+{
+	// Anything already in the past goes in the current slot, which is
+	// the first one the next advance() looks at.
+	U64 tick = llmax(tickOf(when), mCurrentTick);
+	mSlots[tick % mSlots.size()].push_back(Entry(id, when));
+	mSize++;
+}
+
+void LLTimerWheel::advance(F64 now, entry_list_t& due)
+{
+	U64 now_tick = tickOf(now);
+	if (now_tick < mCurrentTick)
+	{
+		// Clock went backwards, wait for it to catch up.
+		return;
+	}
+
+	if (mSize)
+	{
+		// Look at every tick since the last call, including the last
+		// one again: it may hold entries that were not due then.
+		U64 ticks = llmin(now_tick - mCurrentTick + 1, (U64)mSlots.size());
+		for (U64 i = 0; i < ticks && mSize; ++i)
+		{
+			entry_list_t& slot = mSlots[(mCurrentTick + i) % mSlots.size()];
+			entry_list_t::iterator keep = slot.begin();
+			for (entry_list_t::iterator it = slot.begin(); it != slot.end(); ++it)
+			{
+				if (it->mWhen < now)
+				{
+					due.push_back(*it);
+					mSize--;
+				}
+				else
+				{
+					// Later in this tick, or a later turn of the wheel.
+					*keep++ = *it;
+				}
+			}
+			slot.erase(keep, slot.end());
+		}
+	}
+
+	mCurrentTick = now_tick;
+}
+
+void LLTimerWheel::clear()
+{
+	for (std::vector<entry_list_t>::iterator it = mSlots.begin(); it != mSlots.end(); ++it)
+	{
+		it->clear();
+	}
+	mSize = 0;
+}
@@ -0,0 +1,80 @@
+/** 
+ * @file lltimerwheel.h
+ * @brief Coarse timer wheel for scheduling packet resends.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ * 
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ * 
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ * 
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLTIMERWHEEL_H
+#define LL_LLTIMERWHEEL_H
+
+#include <vector>
+
+/**
+ * @class LLTimerWheel
+ * @brief Buckets IDs by the time they fall due.
+ *
+ * Each slot covers one tick of time and the wheel wraps after
+ * slot_count ticks. advance() only looks at the slots for the ticks
+ * that went by since the last call, so checking for expired entries
+ * costs nothing for entries that are not due yet. Entries further out
+ * than one turn of the wheel stay in their slot until their time comes.
+ *
+ * There is no way to cancel an entry. Owners keep their own index of
+ * live IDs and ignore entries that are stale when they come due, e.g.
+ * because the packet was acked or rescheduled in the meantime.
+ */
+class LLTimerWheel
+{
+public:
+	struct Entry
+	{
+		Entry(U32 id, F64 when) : mID(id), mWhen(when) {}
+		U32 mID;
+		F64 mWhen;
+	};
+	typedef std::vector<Entry> entry_list_t;
+
+	LLTimerWheel(F64 tick_seconds = 0.01, U32 slot_count = 512);
+
+	// Adds an entry due at time when, in seconds.
+	void schedule(U32 id, F64 when);
+
+	// Appends the entries due before now to due, removing them from the
+	// wheel. Entries come out roughly in the order they expire.
+	void advance(F64 now, entry_list_t& due);
+
+	void clear();
+	bool empty() const		{ return mSize == 0; }
+	U32 size() const		{ return mSize; }
+
+private:
+	U64 tickOf(F64 when) const;
+
+private:
+	std::vector<entry_list_t> mSlots;
+	F64 mTickSeconds;
+	U64 mCurrentTick;
+	U32 mSize;
+};
+
+#endif // LL_LLTIMERWHEEL_H
@@ -740,7 +740,7 @@ BOOL LLMessageSystem::checkMessages( S64 frame_count )
 				if (cdp && recv_reliable)
 				{
 					// Add to the recently received list for duplicate suppression
-					cdp->mRecentlyReceivedReliablePackets[mCurrentRecvPacketID] = getMessageTimeUsecs();
+					cdp->mRecentlyReceivedReliablePackets.add(mCurrentRecvPacketID);
 
 					// Put it onto the list of packets to be acked
 					cdp->collectRAck(mCurrentRecvPacketID);
@@ -3797,6 +3797,13 @@ void LLMessageSystem::getBinaryDataFast(const char *blockname,
 								  max_size);
 }
 
+const U8* LLMessageSystem::getBinaryDataPointerFast(const char *blockname, 
+												   const char *varname, 
+												   S32 &size, S32 blocknum)
+{
+	return mMessageReader->getBinaryDataPointer(blockname, varname, size, blocknum);
+}
+
 void LLMessageSystem::getBinaryData(const char *blockname, 
 									const char *varname, 
 									void *datap, S32 size, 
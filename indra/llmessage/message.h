@@ -521,6 +521,14 @@ public:
 	*/
 	void	getBinaryDataFast(const char *blockname, const char *varname, void *datap, S32 size, S32 blocknum = 0, S32 max_size = S32_MAX);
 	void	getBinaryData(const char *blockname, const char *varname, void *datap, S32 size, S32 blocknum = 0, S32 max_size = S32_MAX);
+	/**
+	Returns the variable's data without copying it, or NULL if the
+	message can't give it out in place. The data is valid until the
+	next message is read.
+
+	@param size set to the size of the data
+	*/
+	const U8* getBinaryDataPointerFast(const char *blockname, const char *varname, S32 &size, S32 blocknum = 0);
 	void	getBOOLFast(	const char *block, const char *var, BOOL &data, S32 blocknum = 0);
 	void	getBOOL(	const char *block, const char *var, BOOL &data, S32 blocknum = 0);
 	void	getS8Fast(		const char *block, const char *var, S8 &data, S32 blocknum = 0);
@@ -406,3 +406,20 @@ void	decode_patch(LLBitPack &bitpack, S32 *patches)
 #endif
 }
 
+
+S32	decode_patches(LLBitPack &bitpack, LLPatchHeader *headers, S32 *patches, S32 max_patches)
+{
+	S32 patch_area = gPatchSize*gPatchSize;
+	S32 count = 0;
+	while (count < max_patches)
+	{
+		decode_patch_header(bitpack, headers + count);
+		if (END_OF_PATCHES == headers[count].quant_wbits)
+		{
+			break;
+		}
+		decode_patch(bitpack, patches + count*patch_area);
+		count++;
+	}
+	return count;
+}
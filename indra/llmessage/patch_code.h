@@ -42,5 +42,9 @@ void	init_patch_decoding(LLBitPack &bitpack);
 void	decode_patch_group_header(LLBitPack &bitpack, LLGroupHeader *gopp);
 void	decode_patch_header(LLBitPack &bitpack, LLPatchHeader *ph);
 void	decode_patch(LLBitPack &bitpack, S32 *patches);
+// Decodes the headers and coefficients of every patch up to the end of the
+// group, or the first max_patches of them, and returns how many it read.
+// patches needs room for max_patches patches of the group's patch size.
+S32		decode_patches(LLBitPack &bitpack, LLPatchHeader *headers, S32 *patches, S32 max_patches);
 
 #endif
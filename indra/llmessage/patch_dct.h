@@ -87,5 +87,10 @@ void set_group_of_patch_header(LLGroupHeader *gopp);
 void init_patch_decompressor(S32 size);
 void decompress_patch(F32 *patch, S32 *cpatch, LLPatchHeader *ph);
 void decompress_patchv(LLVector3 *v, S32 *cpatch, LLPatchHeader *ph);
+// Decompresses count patches, as read by decode_patches(), into patches[0..count).
+void decompress_patches(F32 **patches, S32 *cpatches, LLPatchHeader *headers, S32 count);
+// Scalar inverse DCT of a 16x16 and a 32x32 block, in place.
+void idct_patch(F32 *block);
+void idct_patch_large(F32 *block);
 
 #endif
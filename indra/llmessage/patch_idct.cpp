@@ -28,6 +28,7 @@
 
 #include "llmath.h"
 //#include "vmath.h"
+#include "llv4math.h"
 #include "v3math.h"
 #include "patch_dct.h"
 
@@ -53,7 +54,9 @@ void build_patch_dequantize_table(S32 size)
 
 S32	gCurrentDeSize = 0;
 
-F32	gPatchICosines[LARGE_PATCH_SIZE*LARGE_PATCH_SIZE];
+// Row u holds the cosines for coefficient u, so four neighbouring outputs
+// read four neighbouring, aligned, entries.
+LL_LLV4MATH_ALIGN_PREFIX F32 gPatchICosines[LARGE_PATCH_SIZE*LARGE_PATCH_SIZE] LL_LLV4MATH_ALIGN_POSTFIX;
 
 void setup_patch_icosines(S32 size)
 {
@@ -443,7 +446,9 @@ void idct_column_large(F32 *linein, F32 *lineout, S32 column)
 	}
 }
 
-inline void idct_patch(F32 *block)
+// The scalar inverse DCTs. Builds with LL_VECTORIZE use idct_patch_simd()
+// instead, these stay as the reference it is tested against.
+void idct_patch(F32 *block)
 {
 	F32 temp[LARGE_PATCH_SIZE*LARGE_PATCH_SIZE];
 
@@ -501,7 +506,7 @@ inline void idct_patch(F32 *block)
 #endif
 }
 
-inline void idct_patch_large(F32 *block)
+void idct_patch_large(F32 *block)
 {
 	F32 temp[LARGE_PATCH_SIZE*LARGE_PATCH_SIZE];
 
@@ -586,35 +591,86 @@ inline void idct_patch_large(F32 *block)
 	idct_line_large_slow(temp, block, 31);	
 }
 
-S32	gDitherNoise = 128;
+#if LL_VECTORIZE
 
-void decompress_patch(F32 *patch, S32 *cpatch, LLPatchHeader *ph)
+// SSE versions of the column and line passes above. Each works on four
+// neighbouring outputs at once and adds up the terms in the same order as
+// the scalar code, so the results match it bit for bit. block and temp
+// must be 16 byte aligned.
+inline void idct_patch_simd(F32 *block, F32 *temp, S32 size)
 {
-	S32		i, j;
+	const S32 chunks = size >> 2;
+	const __m128 oo_sqrt2 = _mm_set1_ps(OO_SQRT2);
+	__m128 total[LARGE_PATCH_SIZE/4];
+	S32 n, u, k;
 
-	F32		block[LARGE_PATCH_SIZE*LARGE_PATCH_SIZE], *tblock = block;
-	F32		*tpatch;
+	// Columns: temp[n][c] = OO_SQRT2*block[0][c] + sum over u of block[u][c]*cos[u][n]
+	for (n = 0; n < size; n++)
+	{
+		for (k = 0; k < chunks; k++)
+		{
+			total[k] = _mm_mul_ps(oo_sqrt2, _mm_load_ps(block + 4*k));
+		}
+		for (u = 1; u < size; u++)
+		{
+			const F32 *linein = block + u*size;
+			const __m128 cosine = _mm_set1_ps(gPatchICosines[u*size + n]);
+			for (k = 0; k < chunks; k++)
+			{
+				total[k] = _mm_add_ps(total[k], _mm_mul_ps(_mm_load_ps(linein + 4*k), cosine));
+			}
+		}
+		for (k = 0; k < chunks; k++)
+		{
+			_mm_store_ps(temp + n*size + 4*k, total[k]);
+		}
+	}
 
-	LLGroupHeader	*gopp = gGOPP;
-	S32		size = gopp->patch_size;
-	F32		range = ph->range;
-	S32		prequant = (ph->quant_wbits >> 4) + 2;
-	S32		quantize = 1<<prequant;
-	F32		hmin = ph->dc_offset;
-	S32		stride = gopp->stride;
+	// Lines: block[l][n] = (OO_SQRT2*temp[l][0] + sum over u of temp[l][u]*cos[u][n])*2/size
+	const __m128 oosob = _mm_set1_ps(2.f/size);
+	for (n = 0; n < size; n++)
+	{
+		const F32 *linein = temp + n*size;
+		const __m128 first = _mm_set1_ps(OO_SQRT2*linein[0]);
+		for (k = 0; k < chunks; k++)
+		{
+			total[k] = first;
+		}
+		for (u = 1; u < size; u++)
+		{
+			const F32 *pcp = gPatchICosines + u*size;
+			const __m128 coefficient = _mm_set1_ps(linein[u]);
+			for (k = 0; k < chunks; k++)
+			{
+				total[k] = _mm_add_ps(total[k], _mm_mul_ps(coefficient, _mm_load_ps(pcp + 4*k)));
+			}
+		}
+		for (k = 0; k < chunks; k++)
+		{
+			_mm_store_ps(block + n*size + 4*k, _mm_mul_ps(total[k], oosob));
+		}
+	}
+}
 
-	F32		ooq = 1.f/(F32)quantize;
+#endif
+
+// Dequantizes and unzigzags cpatch into block, and runs the inverse DCT on it.
+inline void dequantize_idct_patch(F32 *block, S32 *cpatch, S32 size)
+{
+	S32		i;
+	F32		*tblock = block;
 	F32     *dq = gPatchDequantizeTable;
 	S32		*decopy_matrix = gDeCopyMatrix;
 
-	F32		mult = ooq*range;
-	F32		addval = mult*(F32)(1<<(prequant - 1))+hmin;
-
 	for (i = 0; i < size*size; i++)
 	{
 		*(tblock++) = *(cpatch + *(decopy_matrix++))*(*dq++);
 	}
 
+#if LL_VECTORIZE
+	LL_LLV4MATH_ALIGN_PREFIX F32 temp[LARGE_PATCH_SIZE*LARGE_PATCH_SIZE] LL_LLV4MATH_ALIGN_POSTFIX;
+	idct_patch_simd(block, temp, size);
+#else
 	if (size == 16)
 	{
 		idct_patch(block);
@@ -623,24 +679,70 @@ void decompress_patch(F32 *patch, S32 *cpatch, LLPatchHeader *ph)
 	{
 		idct_patch_large(block);
 	}
+#endif
+}
+
+S32	gDitherNoise = 128;
+
+void decompress_patch(F32 *patch, S32 *cpatch, LLPatchHeader *ph)
+{
+	S32		i, j;
+
+	LL_LLV4MATH_ALIGN_PREFIX F32 block[LARGE_PATCH_SIZE*LARGE_PATCH_SIZE] LL_LLV4MATH_ALIGN_POSTFIX;
+	F32		*tblock;
+	F32		*tpatch;
+
+	LLGroupHeader	*gopp = gGOPP;
+	S32		size = gopp->patch_size;
+	F32		range = ph->range;
+	S32		prequant = (ph->quant_wbits >> 4) + 2;
+	S32		quantize = 1<<prequant;
+	F32		hmin = ph->dc_offset;
+	S32		stride = gopp->stride;
+
+	F32		ooq = 1.f/(F32)quantize;
+
+	F32		mult = ooq*range;
+	F32		addval = mult*(F32)(1<<(prequant - 1))+hmin;
+
+	dequantize_idct_patch(block, cpatch, size);
 
 	for (j = 0; j < size; j++)
 	{
 		tpatch = patch + j*stride;
 		tblock = block + j*size;
-		for (i = 0; i < size; i++)
+		i = 0;
+#if LL_VECTORIZE
+		const __m128 multv = _mm_set1_ps(mult);
+		const __m128 addv = _mm_set1_ps(addval);
+		for (; i + 4 <= size; i += 4)
+		{
+			_mm_storeu_ps(tpatch + i, _mm_add_ps(_mm_mul_ps(_mm_load_ps(tblock + i), multv), addv));
+		}
+#endif
+		for (; i < size; i++)
 		{
-			*(tpatch++) = *(tblock++)*mult+addval;
+			tpatch[i] = tblock[i]*mult+addval;
 		}
 	}
 }
 
+void decompress_patches(F32 **patches, S32 *cpatches, LLPatchHeader *headers, S32 count)
+{
+	S32 patch_area = gGOPP->patch_size*gGOPP->patch_size;
+	for (S32 i = 0; i < count; i++)
+	{
+		decompress_patch(patches[i], cpatches + i*patch_area, headers + i);
+	}
+}
+
 
 void decompress_patchv(LLVector3 *v, S32 *cpatch, LLPatchHeader *ph)
 {
 	S32		i, j;
 
-	F32			block[LARGE_PATCH_SIZE*LARGE_PATCH_SIZE], *tblock = block;
+	LL_LLV4MATH_ALIGN_PREFIX F32 block[LARGE_PATCH_SIZE*LARGE_PATCH_SIZE] LL_LLV4MATH_ALIGN_POSTFIX;
+	F32			*tblock;
 	LLVector3	*tvec;
 
 	LLGroupHeader	*gopp = gGOPP;
@@ -652,8 +754,6 @@ void decompress_patchv(LLVector3 *v, S32 *cpatch, LLPatchHeader *ph)
 	S32		stride = gopp->stride;
 
 	F32		ooq = 1.f/(F32)quantize;
-	F32     *dq = gPatchDequantizeTable;
-	S32		*decopy_matrix = gDeCopyMatrix;
 
 	F32		mult = ooq*range;
 	F32		addval = mult*(F32)(1<<(prequant - 1))+hmin;
@@ -661,15 +761,7 @@ void decompress_patchv(LLVector3 *v, S32 *cpatch, LLPatchHeader *ph)
 //	BOOL	b_diag = FALSE;
 //	BOOL	b_right = TRUE;
 
-	for (i = 0; i < size*size; i++)
-	{
-		*(tblock++) = *(cpatch + *(decopy_matrix++))*(*dq++);
-	}
-
-	if (size == 16)
-		idct_patch(block);
-	else
-		idct_patch_large(block);
+	dequantize_idct_patch(block, cpatch, size);
 
 	for (j = 0; j < size; j++)
 	{
@@ -0,0 +1,263 @@
+/**
+ * @file llassetrequestqueue_test.cpp
+ * @date   2010-11
+ * @brief  Test the pending asset request index and batched dispatch.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ * 
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ * 
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ * 
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "../llassetrequestqueue.h"
+#include "../llassetstorage.h"
+
+#include "lltimer.h"
+
+#include "../test/lltut.h"
+
+// The queue only needs the request's id and type; stub out the rest of
+// the asset system.
+LLAssetRequest::LLAssetRequest(const LLUUID &uuid, const LLAssetType::EType type)
+:	mUUID(uuid),
+	mType(type),
+	mDownCallback(NULL),
+	mUpCallback(NULL),
+	mInfoCallback(NULL),
+	mUserData(NULL),
+	mIsPriority(FALSE)
+{
+}
+
+LLAssetRequest::~LLAssetRequest()
+{
+}
+
+LLSD LLAssetRequest::getTerseDetails() const
+{
+	return LLSD();
+}
+
+LLSD LLAssetRequest::getFullDetails() const
+{
+	return LLSD();
+}
+
+namespace
+{
+	// Records what would have gone out upstream.
+	class FakeTransfers : public LLAssetRequestQueue::Dispatcher
+	{
+	public:
+		void sendRequest(LLAssetRequest* req)
+		{
+			mSent.push_back(req->getUUID());
+			mSentCount[req->getUUID()]++;
+		}
+
+		std::vector<LLUUID> mSent;
+		std::map<LLUUID, S32> mSentCount;
+	};
+}
+
+namespace tut
+{
+	struct assetrequestqueue_data
+	{
+		assetrequestqueue_data()
+			: mIDs(8), mQueue(mRequests)
+		{
+			for (size_t i = 0; i < mIDs.size(); ++i)
+			{
+				mIDs[i].generate();
+			}
+		}
+		~assetrequestqueue_data()
+		{
+			for (LLAssetRequestQueue::request_list_t::iterator iter = mRequests.begin();
+				 iter != mRequests.end(); ++iter)
+			{
+				delete *iter;
+			}
+		}
+
+		LLAssetRequest* add(U32 n, LLAssetType::EType type = LLAssetType::AT_SOUND, bool at_front = false)
+		{
+			LLAssetRequest* req = new LLAssetRequest(mIDs[n], type);
+			mQueue.add(req, at_front);
+			return req;
+		}
+
+		std::vector<LLUUID> mIDs;
+		LLAssetRequestQueue::request_list_t mRequests;
+		LLAssetRequestQueue mQueue;
+	};
+	typedef test_group<assetrequestqueue_data> assetrequestqueue_test;
+	typedef assetrequestqueue_test::object assetrequestqueue_object;
+	tut::assetrequestqueue_test assetrequestqueue_testcase("LLAssetRequestQueue");
+
+	template<> template<>
+	void assetrequestqueue_object::test<1>()
+	{
+		set_test_name("index");
+		LLAssetRequest* a1 = add(1);
+		LLAssetRequest* b = add(2);
+		LLAssetRequest* a2 = add(1, LLAssetType::AT_SOUND, true);
+		add(1, LLAssetType::AT_ANIMATION);
+
+		ensure_equals("list holds all", mRequests.size(), (size_t)4);
+		ensure_equals("front", mRequests.front(), a2);
+		ensure("has 1", mQueue.hasRequests(mIDs[1], LLAssetType::AT_SOUND));
+		ensure("types are apart", !mQueue.hasRequests(mIDs[2], LLAssetType::AT_ANIMATION));
+
+		LLAssetRequestQueue::request_vec_t found;
+		mQueue.getRequests(mIDs[1], LLAssetType::AT_SOUND, found);
+		ensure_equals("two for 1", found.size(), (size_t)2);
+		ensure("contains", mQueue.contains(mIDs[1], LLAssetType::AT_SOUND, a1));
+		ensure("not under another asset", !mQueue.contains(mIDs[2], LLAssetType::AT_SOUND, a1));
+
+		ensure("remove", mQueue.remove(a1));
+		ensure("removed once", !mQueue.remove(a1));
+		delete a1;
+		ensure("still has 1", mQueue.hasRequests(mIDs[1], LLAssetType::AT_SOUND));
+
+		// Erasing while walking the list keeps the index in step.
+		for (LLAssetRequestQueue::request_list_t::iterator iter = mRequests.begin();
+			 iter != mRequests.end(); )
+		{
+			LLAssetRequest* req = *iter;
+			if (req->getUUID() == mIDs[1])
+			{
+				iter = mQueue.erase(iter);
+				delete req;
+			}
+			else
+			{
+				++iter;
+			}
+		}
+		ensure("1 gone", !mQueue.hasRequests(mIDs[1], LLAssetType::AT_SOUND));
+		ensure_equals("index size", mQueue.size(), 1);
+		ensure_equals("list size", mRequests.size(), (size_t)1);
+		ensure_equals("b left", mRequests.front(), b);
+	}
+
+	template<> template<>
+	void assetrequestqueue_object::test<2>()
+	{
+		set_test_name("batched dispatch");
+		mQueue.queueDispatch(add(1), false);
+		mQueue.queueDispatch(add(2), false);
+		mQueue.queueDispatch(add(3), true);
+		LLAssetRequest* gone = add(4);
+		mQueue.queueDispatch(gone, false);
+		mQueue.queueDispatch(gone, false);
+		ensure_equals("queued once", mQueue.getDispatchQueueSize(), 4);
+
+		// Asset 4 is no longer wanted by the time the batch goes out.
+		mQueue.remove(gone);
+		delete gone;
+
+		FakeTransfers transfers;
+		ensure_equals("first batch", mQueue.dispatch(transfers, 2), 2);
+		ensure_equals("priority first", transfers.mSent[0], mIDs[3]);
+		ensure_equals("then in order", transfers.mSent[1], mIDs[1]);
+		ensure_equals("rest", mQueue.dispatch(transfers), 1);
+		ensure_equals("cancelled request skipped", transfers.mSent.size(), (size_t)3);
+		ensure_equals("nothing left", mQueue.dispatch(transfers), 0);
+		ensure_equals("queue empty", mQueue.getDispatchQueueSize(), 0);
+	}
+
+	template<> template<>
+	void assetrequestqueue_object::test<3>()
+	{
+		set_test_name("thousands of requests");
+		// Arriving in a busy region: many objects ask for the same sounds,
+		// animations and gestures. Requests come in over a few frames, each
+		// frame sends a batch, and the fake upstream answers a while later.
+		const S32 ASSETS = 2000;
+		const S32 REQUESTS = 20000;
+		const S32 BATCH = 64;
+		const S32 LATENCY_FRAMES = 5;
+
+		std::vector<LLUUID> assets(ASSETS);
+		for (S32 i = 0; i < ASSETS; ++i)
+		{
+			assets[i].generate();
+		}
+		FakeTransfers transfers;
+		std::vector<std::vector<LLUUID> > in_flight(LATENCY_FRAMES);
+		U32 state = 12345;
+		S32 requested = 0;
+		S32 completed = 0;
+		S32 frames = 0;
+		LLTimer timer;
+		while (completed < REQUESTS)
+		{
+			// New requests for this frame.
+			for (S32 i = 0; i < 1000 && requested < REQUESTS; ++i, ++requested)
+			{
+				state = state * 1664525 + 1013904223;
+				U32 asset = (state >> 8) % ASSETS;
+				LLAssetRequest* req = new LLAssetRequest(assets[asset], LLAssetType::AT_SOUND);
+				bool first = !mQueue.hasRequests(req->getUUID(), req->getType());
+				mQueue.add(req);
+				if (first)
+				{
+					mQueue.queueDispatch(req, (asset % 10) == 0);
+				}
+			}
+
+			// Answers to the batch sent LATENCY_FRAMES ago.
+			std::vector<LLUUID>& done = in_flight[frames % LATENCY_FRAMES];
+			for (std::vector<LLUUID>::iterator iter = done.begin(); iter != done.end(); ++iter)
+			{
+				LLAssetRequestQueue::request_vec_t waiting;
+				mQueue.getRequests(*iter, LLAssetType::AT_SOUND, waiting);
+				for (LLAssetRequestQueue::request_vec_t::iterator req = waiting.begin(); req != waiting.end(); ++req)
+				{
+					mQueue.remove(*req);
+					delete *req;
+					++completed;
+				}
+			}
+			done.clear();
+
+			size_t before = transfers.mSent.size();
+			mQueue.dispatch(transfers, BATCH);
+			done.insert(done.end(), transfers.mSent.begin() + before, transfers.mSent.end());
+			++frames;
+			ensure("makes progress", frames < 10000);
+		}
+		F32 elapsed = timer.getElapsedTimeF32();
+		llinfos << REQUESTS << " requests for " << transfers.mSentCount.size() << " assets in "
+				<< frames << " frames, " << elapsed * 1000.f << " ms" << llendl;
+
+		ensure_equals("all answered", completed, REQUESTS);
+		ensure_equals("nothing pending", mQueue.size(), 0);
+		ensure("every asset asked for", (S32)transfers.mSentCount.size() <= ASSETS);
+		// An asset is only asked for again if a new request arrives after
+		// the last answer for it.
+		S32 resent = (S32)transfers.mSent.size() - (S32)transfers.mSentCount.size();
+		ensure("duplicates coalesced", (S32)transfers.mSent.size() < REQUESTS / 4);
+		ensure("few re-requests", resent < ASSETS);
+	}
+}
@@ -0,0 +1,192 @@
+/**
+ * @file llcongestioncontroller_test.cpp
+ * @date   2010-11
+ * @brief  Drive LLCongestionController through a simulated bottleneck link.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ * 
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ * 
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ * 
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "../llcongestioncontroller.h"
+
+#include "../test/lltut.h"
+
+namespace
+{
+	// A sender pushing demand_bps * scale into a drop-tail bottleneck.
+	// Capacity changes over time, the queue adds to the round trip and
+	// overflows into loss. Everything is deterministic.
+	struct LinkResult
+	{
+		F64 mDelivered;		// bits
+		F64 mOffered;
+		F64 mLost;
+		F64 mCapacity;		// bits the link could have carried
+		F32 mMaxQueueMs;
+	};
+
+	F32 capacityAt(F64 t)
+	{
+		if (t < 120.0) return 1000000.f;
+		if (t < 240.0) return 300000.f;
+		return 800000.f;
+	}
+
+	LinkResult runLink(LLCongestionController* controller, F32 demand_bps)
+	{
+		const F64 DURATION = 360.0;
+		const F64 STEP = 0.01;
+		const F64 SAMPLE_PERIOD = 5.0;		// circuit ping interval
+		const F32 PROPAGATION_MS = 60.f;
+		const F64 BUFFER_BITS = 300000.0;
+
+		LinkResult result = { 0.0, 0.0, 0.0, 0.0, 0.f };
+		F64 queue = 0.0;
+		F64 sample_offered = 0.0;
+		F64 sample_lost = 0.0;
+		F64 next_sample = SAMPLE_PERIOD;
+		F32 scale = controller ? controller->getScale() : 1.f;
+
+		for (F64 t = 0.0; t < DURATION; t += STEP)
+		{
+			F64 capacity = capacityAt(t);
+			F64 offered = demand_bps * scale * STEP;
+			queue += offered;
+			F64 sent = llmin(queue, capacity * STEP);
+			queue -= sent;
+			F64 lost = llmax(0.0, queue - BUFFER_BITS);
+			queue -= lost;
+
+			result.mOffered += offered;
+			result.mDelivered += sent;
+			result.mLost += lost;
+			result.mCapacity += capacity * STEP;
+			sample_offered += offered;
+			sample_lost += lost;
+
+			F32 queue_ms = (F32)(queue / capacity * 1000.0);
+			result.mMaxQueueMs = llmax(result.mMaxQueueMs, queue_ms);
+
+			if (controller && t >= next_sample)
+			{
+				F32 loss = sample_offered > 0.0 ? (F32)(sample_lost / sample_offered) : 0.f;
+				scale = controller->update(PROPAGATION_MS + queue_ms, loss);
+				sample_offered = 0.0;
+				sample_lost = 0.0;
+				next_sample += SAMPLE_PERIOD;
+			}
+		}
+		return result;
+	}
+}
+
+namespace tut
+{
+	struct congestioncontroller_data
+	{
+	};
+	typedef test_group<congestioncontroller_data> congestioncontroller_test;
+	typedef congestioncontroller_test::object congestioncontroller_object;
+	tut::congestioncontroller_test congestioncontroller_testcase("LLCongestionController");
+
+	template<> template<>
+	void congestioncontroller_object::test<1>()
+	{
+		set_test_name("delay and loss response");
+		LLCongestionController controller(0.2f, 1.5f);
+		ensure_equals("starts open", controller.getScale(), 1.5f);
+
+		// Queues well past the target pull the scale down.
+		controller.update(50.f, 0.f);
+		ensure_equals("base delay", controller.getBaseDelay(), 50.f);
+		controller.update(400.f, 0.f);
+		ensure("backs off on delay", controller.getScale() < 1.5f);
+		ensure_equals("queueing delay", controller.getQueueingDelay(), 350.f);
+
+		// Loss backs off harder.
+		F32 before = controller.getScale();
+		controller.update(50.f, 0.1f);
+		ensure("backs off on loss", controller.getScale() < before * 0.8f);
+
+		// An empty queue lets it grow again, up to the max.
+		for (S32 i = 0; i < 100; i++)
+		{
+			controller.update(50.f, 0.f);
+		}
+		ensure_equals("recovers", controller.getScale(), 1.5f);
+
+		// And sustained trouble bottoms out at the min.
+		for (S32 i = 0; i < 100; i++)
+		{
+			controller.update(50.f, 0.5f);
+		}
+		ensure_equals("floor", controller.getScale(), 0.2f);
+	}
+
+	template<> template<>
+	void congestioncontroller_object::test<2>()
+	{
+		set_test_name("base delay history");
+		LLCongestionController controller;
+		controller.update(80.f, 0.f);
+		controller.update(60.f, 0.f);
+		ensure_equals("lowest so far", controller.getBaseDelay(), 60.f);
+
+		// A route change to a longer path eventually becomes the new base,
+		// once the old minimum ages out of the history.
+		for (S32 i = 0; i < 200; i++)
+		{
+			controller.update(150.f, 0.f);
+		}
+		ensure_equals("route change", controller.getBaseDelay(), 150.f);
+		ensure_equals("no queueing", controller.getQueueingDelay(), 0.f);
+	}
+
+	template<> template<>
+	void congestioncontroller_object::test<3>()
+	{
+		set_test_name("simulated bottleneck");
+		// Asking for 1.2 Mbps over a link that drops from 1 Mbps to 300 kbps
+		// and comes back to 800 kbps.
+		const F32 DEMAND_BPS = 1200000.f;
+		LinkResult fixed = runLink(NULL, DEMAND_BPS);
+		LLCongestionController controller(0.1f, 1.f);
+		LinkResult adaptive = runLink(&controller, DEMAND_BPS);
+
+		F64 fixed_loss = fixed.mLost / fixed.mOffered;
+		F64 adaptive_loss = adaptive.mLost / adaptive.mOffered;
+		F64 fixed_use = fixed.mDelivered / fixed.mCapacity;
+		F64 adaptive_use = adaptive.mDelivered / adaptive.mCapacity;
+
+		llinfos << "fixed throttle: " << fixed_loss * 100.0 << "% loss, "
+				<< fixed_use * 100.0 << "% of capacity, queue up to " << fixed.mMaxQueueMs << " ms" << llendl;
+		llinfos << "adaptive throttle: " << adaptive_loss * 100.0 << "% loss, "
+				<< adaptive_use * 100.0 << "% of capacity, queue up to " << adaptive.mMaxQueueMs << " ms" << llendl;
+
+		ensure("fixed throttle overruns the link", fixed_loss > 0.2);
+		// What loss there is comes from the samples right after the drop.
+		ensure("adaptive loss is low", adaptive_loss < 0.03);
+		ensure("adaptive loss is a fraction of fixed", adaptive_loss < fixed_loss / 10.0);
+		ensure("adaptive keeps the link busy", adaptive_use > 0.8);
+	}
+}
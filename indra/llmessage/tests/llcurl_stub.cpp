@@ -81,12 +81,12 @@ namespace boost
 {
 	void intrusive_ptr_add_ref(LLCurl::Responder* p)
 	{
-		++p->mReferenceCount;
+		p->mReferenceCount++;
 	}
 
 	void intrusive_ptr_release(LLCurl::Responder* p)
 	{
-		if(p && 0 == --p->mReferenceCount)
+		if(p && 0 == p->mReferenceCount--)
 		{
 			delete p;
 		}
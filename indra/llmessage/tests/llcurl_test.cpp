@@ -0,0 +1,208 @@
+/**
+ * @file llcurl_test.cpp
+ * @date   2010-11
+ * @brief  Test connection reuse and per-host limits of LLCurlEasyRequest
+ *         against a keep-alive server run by test_llcurl_peer.py.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ * 
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ * 
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ * 
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "../llcurl.h"
+
+#include <vector>
+
+#include "lltimer.h"
+
+#include "../test/lltut.h"
+
+namespace
+{
+	const std::string PEER_URL("http://127.0.0.1:8001/");
+	const std::string PEER_KEY("http://127.0.0.1:8001");
+	const S32 REQUEST_COUNT = 16;
+	const F32 REQUEST_TIMEOUT = 10.f;
+
+	size_t discardData(char* data, size_t size, size_t nmemb, void* user)
+	{
+		return size * nmemb;
+	}
+}
+
+namespace tut
+{
+	struct llcurl_data
+	{
+		llcurl_data()
+		{
+			mSavedMaxConnections = LLCurl::getMaxConnectionsPerHost();
+			LLCurl::initClass();
+		}
+
+		~llcurl_data()
+		{
+			LLCurl::cleanupClass();
+			LLCurl::setMaxConnectionsPerHost(mSavedMaxConnections);
+		}
+
+		// Issues count requests to the peer at once and drives them to
+		// completion. Returns the number that completed with CURLE_OK.
+		S32 fetch(S32 count, const std::string& path)
+		{
+			std::vector<LLCurlEasyRequest*> requests;
+			for (S32 i = 0; i < count; ++i)
+			{
+				LLCurlEasyRequest* request = new LLCurlEasyRequest();
+				request->setopt(CURLOPT_NOSIGNAL, 1);
+				request->setopt(CURLOPT_HTTPGET, 1);
+				request->setWriteCallback(&discardData, NULL);
+				request->sendRequest(PEER_URL + path);
+				requests.push_back(request);
+			}
+
+			S32 succeeded = 0;
+			S32 remaining = count;
+			LLTimer timer;
+			while (remaining > 0 && timer.getElapsedTimeF32() < REQUEST_TIMEOUT)
+			{
+				for (S32 i = 0; i < count; ++i)
+				{
+					if (!requests[i])
+					{
+						continue;
+					}
+					requests[i]->perform();
+					CURLcode result;
+					if (requests[i]->getResult(&result))
+					{
+						if (CURLE_OK == result)
+						{
+							++succeeded;
+						}
+						requests[i]->requestComplete();
+						delete requests[i];
+						requests[i] = NULL;
+						--remaining;
+					}
+				}
+				ms_sleep(1);
+			}
+
+			for (S32 i = 0; i < count; ++i)
+			{
+				delete requests[i];
+			}
+			return succeeded;
+		}
+
+		U32 mSavedMaxConnections;
+	};
+	typedef test_group<llcurl_data> llcurl_group;
+	typedef llcurl_group::object llcurl_object;
+	tut::llcurl_group llcurl("LLCurl");
+
+	template<> template<>
+	void llcurl_object::test<1>()
+	{
+		set_test_name("per-host limit and connection reuse");
+		LLCurl::setMaxConnectionsPerHost(2);
+
+		ensure_equals("all requests completed", fetch(REQUEST_COUNT, "keepalive"), REQUEST_COUNT);
+
+		LLSD stats = LLCurl::getHostStats()[PEER_KEY];
+		ensure("host has stats", stats.isMap());
+		ensure_equals("requests counted", stats["requests"].asInteger(), REQUEST_COUNT);
+		ensure_equals("completions counted", stats["completed"].asInteger(), REQUEST_COUNT);
+		ensure("never more than the limit in flight", stats["peak_active"].asInteger() <= 2);
+		ensure("excess requests were queued", stats["peak_queued"].asInteger() > 0);
+		ensure("connections opened within the limit", stats["new_connections"].asInteger() <= 2);
+		ensure_equals("everything else reused a connection",
+					  stats["reused_connections"].asInteger(),
+					  REQUEST_COUNT - stats["new_connections"].asInteger());
+	}
+
+	template<> template<>
+	void llcurl_object::test<2>()
+	{
+		set_test_name("connection survives across batches");
+		LLCurl::setMaxConnectionsPerHost(1);
+
+		ensure_equals("first batch completed", fetch(1, "keepalive"), 1);
+		ensure_equals("second batch completed", fetch(4, "keepalive"), 4);
+
+		LLSD stats = LLCurl::getHostStats()[PEER_KEY];
+		ensure_equals("one connection for both batches", stats["new_connections"].asInteger(), 1);
+		ensure_equals("reused by later requests", stats["reused_connections"].asInteger(), 4);
+	}
+
+	template<> template<>
+	void llcurl_object::test<3>()
+	{
+		set_test_name("closed connections are replaced");
+		LLCurl::setMaxConnectionsPerHost(2);
+
+		// The peer closes the connection after each of these responses.
+		ensure_equals("all requests completed", fetch(4, "close"), 4);
+
+		LLSD stats = LLCurl::getHostStats()[PEER_KEY];
+		ensure_equals("a new connection per request", stats["new_connections"].asInteger(), 4);
+		ensure_equals("nothing reused", stats["reused_connections"].asInteger(), 0);
+	}
+
+	template<> template<>
+	void llcurl_object::test<4>()
+	{
+		set_test_name("pools freed by their thread");
+		LLCurl::setMaxConnectionsPerHost(2);
+
+		ensure_equals("first batch completed", fetch(2, "keepalive"), 2);
+
+		// A request still holding its pool when the thread cleans up
+		// keeps it alive until the request goes away.
+		LLCurlEasyRequest* request = new LLCurlEasyRequest();
+		request->setopt(CURLOPT_NOSIGNAL, 1);
+		request->setopt(CURLOPT_HTTPGET, 1);
+		request->setWriteCallback(&discardData, NULL);
+		request->sendRequest(PEER_URL + "keepalive");
+		LLCurl::cleanupThread();
+
+		CURLcode result = CURLE_FAILED_INIT;
+		LLTimer timer;
+		while (!request->getResult(&result) && timer.getElapsedTimeF32() < REQUEST_TIMEOUT)
+		{
+			request->perform();
+			ms_sleep(1);
+		}
+		ensure_equals("orphaned pool still drives its request", result, CURLE_OK);
+		request->requestComplete();
+		delete request;
+
+		LLSD stats = LLCurl::getHostStats()[PEER_KEY];
+		ensure_equals("counts kept after the pool is freed", stats["requests"].asInteger(), 3);
+		ensure_equals("nothing left in flight", stats["active"].asInteger(), 0);
+
+		ensure_equals("a new pool serves later requests", fetch(2, "keepalive"), 2);
+		stats = LLCurl::getHostStats()[PEER_KEY];
+		ensure_equals("old and new pools summed", stats["requests"].asInteger(), 5);
+	}
+}
@@ -0,0 +1,213 @@
+/**
+ * @file llhttpscheduler_test.cpp
+ * @date   2010-11
+ * @brief  Test the budgets and ordering of LLHTTPScheduler.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "../llhttpscheduler.h"
+
+#include "lltimer.h"
+
+#include "../test/lltut.h"
+
+namespace
+{
+	const std::string HOST_A("http://sim-a.example.com:12046/cap/a");
+	const std::string HOST_B("http://sim-b.example.com:12046/cap/b");
+}
+
+namespace tut
+{
+	struct httpscheduler_data
+	{
+		httpscheduler_data()
+			: mIDs(8)
+		{
+			for (size_t i = 0; i < mIDs.size(); ++i)
+			{
+				mIDs[i].generate();
+			}
+		}
+
+		LLHTTPScheduler mScheduler;
+		std::vector<LLUUID> mIDs;
+	};
+	typedef test_group<httpscheduler_data> httpscheduler_test;
+	typedef httpscheduler_test::object httpscheduler_object;
+	tut::httpscheduler_test httpscheduler_testcase("LLHTTPScheduler");
+
+	template<> template<>
+	void httpscheduler_object::test<1>()
+	{
+		set_test_name("global limit");
+		mScheduler.setMaxRequests(2);
+		ensure("first admitted", mScheduler.acquire(LLHTTPScheduler::RC_TEXTURE, mIDs[1], HOST_A, 0.5f));
+		ensure("second admitted", mScheduler.acquire(LLHTTPScheduler::RC_TEXTURE, mIDs[2], HOST_B, 0.5f));
+		ensure("third waits", !mScheduler.acquire(LLHTTPScheduler::RC_TEXTURE, mIDs[3], HOST_A, 0.5f));
+		ensure_equals("active", mScheduler.getActiveCount(), 2);
+		ensure_equals("waiting", mScheduler.getWaitingCount(), 1);
+		ensure("asking again is idempotent", mScheduler.acquire(LLHTTPScheduler::RC_TEXTURE, mIDs[1], HOST_A, 0.5f));
+
+		mScheduler.release(LLHTTPScheduler::RC_TEXTURE, mIDs[1], 1000);
+		ensure("third admitted after release", mScheduler.acquire(LLHTTPScheduler::RC_TEXTURE, mIDs[3], HOST_A, 0.5f));
+		ensure_equals("nothing waiting", mScheduler.getWaitingCount(), 0);
+		ensure_equals("bytes counted", mScheduler.getAndResetBytesReceived(), 1000U);
+		ensure_equals("bytes reset", mScheduler.getAndResetBytesReceived(), 0U);
+	}
+
+	template<> template<>
+	void httpscheduler_object::test<2>()
+	{
+		set_test_name("per-host and per-class limits");
+		mScheduler.setMaxRequestsPerHost(1);
+		mScheduler.setMaxClassRequests(LLHTTPScheduler::RC_INVENTORY, 1);
+		ensure("host A", mScheduler.acquire(LLHTTPScheduler::RC_TEXTURE, mIDs[1], HOST_A, 0.5f));
+		ensure("host A is full", !mScheduler.acquire(LLHTTPScheduler::RC_TEXTURE, mIDs[2], HOST_A, 1.f));
+		// The waiter for A must not hold up a request to an idle host.
+		ensure("host B", mScheduler.acquire(LLHTTPScheduler::RC_TEXTURE, mIDs[3], HOST_B, 0.f));
+
+		mScheduler.setMaxRequestsPerHost(0);
+		ensure("inventory", mScheduler.acquire(LLHTTPScheduler::RC_INVENTORY, mIDs[4], HOST_A, 0.f));
+		ensure("inventory class is full", !mScheduler.acquire(LLHTTPScheduler::RC_INVENTORY, mIDs[5], HOST_A, 1.f));
+		ensure_equals("inventory waiting", mScheduler.getWaitingCount(LLHTTPScheduler::RC_INVENTORY), 1);
+		ensure_equals("inventory active", mScheduler.getActiveCount(LLHTTPScheduler::RC_INVENTORY), 1);
+	}
+
+	template<> template<>
+	void httpscheduler_object::test<3>()
+	{
+		set_test_name("priority and class order");
+		mScheduler.setMaxRequests(1);
+		ensure("fill the slot", mScheduler.acquire(LLHTTPScheduler::RC_TEXTURE, mIDs[1], HOST_A, 0.f));
+		ensure("low waits", !mScheduler.acquire(LLHTTPScheduler::RC_TEXTURE, mIDs[2], HOST_A, 0.1f));
+		ensure("high waits", !mScheduler.acquire(LLHTTPScheduler::RC_TEXTURE, mIDs[3], HOST_A, 0.9f));
+		mScheduler.release(LLHTTPScheduler::RC_TEXTURE, mIDs[1]);
+
+		ensure("low is passed over", !mScheduler.acquire(LLHTTPScheduler::RC_TEXTURE, mIDs[2], HOST_A, 0.1f));
+		// Raising the priority on the next pass moves it ahead.
+		ensure("low raised", mScheduler.acquire(LLHTTPScheduler::RC_TEXTURE, mIDs[2], HOST_A, 1.f));
+		mScheduler.release(LLHTTPScheduler::RC_TEXTURE, mIDs[2]);
+
+		// Lowering a waiter without asking again works too.
+		mScheduler.reprioritize(LLHTTPScheduler::RC_TEXTURE, mIDs[3], 0.f);
+		ensure("lowered waiter is passed over", mScheduler.acquire(LLHTTPScheduler::RC_TEXTURE, mIDs[4], HOST_A, 0.5f));
+		mScheduler.release(LLHTTPScheduler::RC_TEXTURE, mIDs[4]);
+
+		// Inventory outranks any texture.
+		ensure("fill again", mScheduler.acquire(LLHTTPScheduler::RC_TEXTURE, mIDs[3], HOST_A, 0.9f));
+		ensure("inventory queued", !mScheduler.acquire(LLHTTPScheduler::RC_INVENTORY, mIDs[5], HOST_A, 0.f));
+		ensure("texture queued", !mScheduler.acquire(LLHTTPScheduler::RC_TEXTURE, mIDs[6], HOST_A, 1.f));
+		mScheduler.release(LLHTTPScheduler::RC_TEXTURE, mIDs[3]);
+		ensure("texture passed over", !mScheduler.acquire(LLHTTPScheduler::RC_TEXTURE, mIDs[6], HOST_A, 1.f));
+		ensure("inventory first", mScheduler.acquire(LLHTTPScheduler::RC_INVENTORY, mIDs[5], HOST_A, 0.f));
+	}
+
+	template<> template<>
+	void httpscheduler_object::test<4>()
+	{
+		set_test_name("forced and released waiters");
+		mScheduler.setMaxRequests(1);
+		ensure("fill the slot", mScheduler.acquire(LLHTTPScheduler::RC_ASSET, mIDs[1], HOST_A, 0.f));
+		mScheduler.forceAcquire(LLHTTPScheduler::RC_INVENTORY, mIDs[2], HOST_A);
+		ensure_equals("forced over the limit", mScheduler.getActiveCount(), 2);
+		ensure("forced request reads as admitted", mScheduler.acquire(LLHTTPScheduler::RC_INVENTORY, mIDs[2], HOST_A, 0.f));
+
+		ensure("waits", !mScheduler.acquire(LLHTTPScheduler::RC_TEXTURE, mIDs[3], HOST_A, 1.f));
+		// Dropping a waiter is the same call as finishing a request.
+		mScheduler.release(LLHTTPScheduler::RC_TEXTURE, mIDs[3]);
+		ensure_equals("waiter dropped", mScheduler.getWaitingCount(), 0);
+		// Releasing an unknown request is harmless.
+		mScheduler.release(LLHTTPScheduler::RC_TEXTURE, mIDs[3]);
+		mScheduler.release(LLHTTPScheduler::RC_ASSET, mIDs[1]);
+		mScheduler.release(LLHTTPScheduler::RC_INVENTORY, mIDs[2]);
+		ensure_equals("all released", mScheduler.getActiveCount(), 0);
+
+		LLSD stats = mScheduler.getStats();
+		ensure_equals("admitted", stats["admitted"].asInteger(), 2);
+		ensure_equals("forced", stats["forced"].asInteger(), 1);
+	}
+
+	template<> template<>
+	void httpscheduler_object::test<5>()
+	{
+		set_test_name("bandwidth budget");
+		// 800 kbps is 102400 bytes/sec, with up to a second of burst.
+		mScheduler.setMaxKbps(800.f);
+		ensure("first", mScheduler.acquire(LLHTTPScheduler::RC_TEXTURE, mIDs[1], HOST_A, 0.5f));
+		mScheduler.release(LLHTTPScheduler::RC_TEXTURE, mIDs[1], 102400 + 10240);
+		ensure("over budget", !mScheduler.acquire(LLHTTPScheduler::RC_TEXTURE, mIDs[2], HOST_A, 0.5f));
+		// About 0.1 seconds pays the debt back.
+		ms_sleep(300);
+		ensure("budget refilled", mScheduler.acquire(LLHTTPScheduler::RC_TEXTURE, mIDs[2], HOST_A, 0.5f));
+		mScheduler.release(LLHTTPScheduler::RC_TEXTURE, mIDs[2]);
+
+		mScheduler.setMaxKbps(0.f);
+		mScheduler.setMaxKbpsPerHost(800.f);
+		ensure("host A", mScheduler.acquire(LLHTTPScheduler::RC_TEXTURE, mIDs[3], HOST_A, 0.5f));
+		mScheduler.release(LLHTTPScheduler::RC_TEXTURE, mIDs[3], 102400 + 10240);
+		ensure("host A over budget", !mScheduler.acquire(LLHTTPScheduler::RC_TEXTURE, mIDs[4], HOST_A, 0.5f));
+		ensure("host B unaffected", mScheduler.acquire(LLHTTPScheduler::RC_TEXTURE, mIDs[5], HOST_B, 0.5f));
+	}
+
+	template<> template<>
+	void httpscheduler_object::test<6>()
+	{
+		set_test_name("stale and many waiters");
+		mScheduler.setMaxRequests(1);
+		ensure("fill the slot", mScheduler.acquire(LLHTTPScheduler::RC_TEXTURE, mIDs[0], HOST_A, 0.f));
+		// An inventory fetch that stops asking must not hold textures up
+		// until it times out.
+		ensure("inventory queued", !mScheduler.acquire(LLHTTPScheduler::RC_INVENTORY, mIDs[1], HOST_A, 1.f));
+		ms_sleep(600);
+		mScheduler.release(LLHTTPScheduler::RC_TEXTURE, mIDs[0]);
+		ensure("texture passes the stale waiter", mScheduler.acquire(LLHTTPScheduler::RC_TEXTURE, mIDs[2], HOST_A, 0.f));
+		ensure_equals("stale waiter still queued", mScheduler.getWaitingCount(LLHTTPScheduler::RC_INVENTORY), 1);
+		mScheduler.release(LLHTTPScheduler::RC_TEXTURE, mIDs[2]);
+		ensure("asking again puts it back in line", mScheduler.acquire(LLHTTPScheduler::RC_INVENTORY, mIDs[1], HOST_A, 1.f));
+		mScheduler.release(LLHTTPScheduler::RC_INVENTORY, mIDs[1]);
+
+		// Many waiters come out in priority order.
+		const S32 COUNT = 1000;
+		std::vector<LLUUID> ids(COUNT);
+		ensure("fill again", mScheduler.acquire(LLHTTPScheduler::RC_TEXTURE, mIDs[3], HOST_A, 0.f));
+		for (S32 i = 0; i < COUNT; ++i)
+		{
+			ids[i].generate();
+			ensure("waiter queued", !mScheduler.acquire(LLHTTPScheduler::RC_TEXTURE, ids[i], HOST_A, (F32)i / COUNT));
+		}
+		mScheduler.release(LLHTTPScheduler::RC_TEXTURE, mIDs[3]);
+		for (S32 i = COUNT - 1; i >= 0; --i)
+		{
+			if (i > 0)
+			{
+				ensure("lower waiter passed over", !mScheduler.acquire(LLHTTPScheduler::RC_TEXTURE, ids[i - 1], HOST_A, (F32)(i - 1) / COUNT));
+			}
+			ensure("highest waiter admitted", mScheduler.acquire(LLHTTPScheduler::RC_TEXTURE, ids[i], HOST_A, (F32)i / COUNT));
+			mScheduler.release(LLHTTPScheduler::RC_TEXTURE, ids[i]);
+		}
+		ensure_equals("all served", mScheduler.getWaitingCount(), 0);
+	}
+}
@@ -0,0 +1,391 @@
+/**
+ * @file llobjectupdatedecoder_test.cpp
+ * @brief Object update decoder tests
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include <cstdlib>
+#include <vector>
+
+#include "linden_common.h"
+#include "lldatapacker.h"
+#include "llmath.h"
+#include "llquantize.h"
+#include "lltimer.h"
+
+#include "../llobjectupdatedecoder.h"
+
+#include "../test/lltut.h"
+
+namespace
+{
+	U32 next_random(U32& seed)
+	{
+		seed = seed * 1664525 + 1013904223;
+		return seed;
+	}
+
+	U16 random_u16(U32& seed)
+	{
+		return (U16)(next_random(seed) >> 16);
+	}
+
+	F32 random_f32(U32& seed, F32 range)
+	{
+		return ((F32)(next_random(seed) >> 8) / (F32)(1 << 24) - 0.5f) * 2.f * range;
+	}
+
+	LLVector3 random_vector3(U32& seed, F32 range)
+	{
+		return LLVector3(random_f32(seed, range), random_f32(seed, range), random_f32(seed, range));
+	}
+
+	// Packs a block the way the simulator sends an ImprovedTerseObjectUpdate
+	S32 pack_terse(U8* buffer, S32 size, U32& seed, U32 local_id, bool avatar)
+	{
+		LLDataPackerBinaryBuffer dp(buffer, size);
+		dp.packU32(local_id, "LocalID");
+		dp.packU8((U8)next_random(seed), "State");
+		dp.packU8(avatar ? 1 : 0, "agent");
+		if (avatar)
+		{
+			dp.packVector4(LLVector4(0.f, 0.f, 1.f, random_f32(seed, 20.f)), "Plane");
+		}
+		dp.packVector3(random_vector3(seed, 256.f), "Pos");
+		for (S32 i = 0; i < 13; ++i)
+		{
+			// velocity, acceleration, rotation and angular velocity
+			dp.packU16(random_u16(seed), "Motion");
+		}
+		return dp.getCurrentSize();
+	}
+
+	// Packs the fixed part of an ObjectUpdateCompressed block
+	S32 pack_compressed(U8* buffer, S32 size, U32& seed, U32 local_id, U32 special_code)
+	{
+		LLDataPackerBinaryBuffer dp(buffer, size);
+		LLUUID id;
+		id.generate();
+		dp.packUUID(id, "ID");
+		dp.packU32(local_id, "LocalID");
+		dp.packU8(9, "PCode");
+		dp.packU8((U8)next_random(seed), "State");
+		dp.packU32(next_random(seed), "CRC");
+		dp.packU8(3, "Material");
+		dp.packU8(1, "ClickAction");
+		dp.packVector3(random_vector3(seed, 10.f), "Scale");
+		dp.packVector3(random_vector3(seed, 256.f), "Pos");
+		dp.packVector3(random_vector3(seed, 0.5f), "Rot");
+		dp.packU32(special_code, "SpecialCode");
+		id.generate();
+		dp.packUUID(id, "Owner");
+		if (special_code & 0x80)
+		{
+			dp.packVector3(random_vector3(seed, 4.f), "Omega");
+		}
+		if (special_code & 0x20)
+		{
+			dp.packU32(next_random(seed), "ParentID");
+		}
+		return dp.getCurrentSize();
+	}
+
+	// The terse block as LLViewerObject::processUpdateMessage unpacked it
+	// before the decoder, field by field through the data packer.
+	void unpack_terse(LLDataPacker* dp, LLTerseObjectUpdate& update)
+	{
+		U16 val[4];
+		U8 value;
+		dp->unpackU32(update.mLocalID, "LocalID");
+		dp->unpackU8(update.mState, "State");
+		dp->unpackU8(value, "agent");
+		update.mHasFootPlane = value != 0;
+		if (value)
+		{
+			dp->unpackVector4(update.mFootPlane, "Plane");
+		}
+		dp->unpackVector3(update.mPosition, "Pos");
+		dp->unpackU16(val[VX], "VelX");
+		dp->unpackU16(val[VY], "VelY");
+		dp->unpackU16(val[VZ], "VelZ");
+		update.mVelocity.setVec(U16_to_F32(val[VX], -128.f, 128.f),
+								U16_to_F32(val[VY], -128.f, 128.f),
+								U16_to_F32(val[VZ], -128.f, 128.f));
+		dp->unpackU16(val[VX], "AccX");
+		dp->unpackU16(val[VY], "AccY");
+		dp->unpackU16(val[VZ], "AccZ");
+		update.mAcceleration.setVec(U16_to_F32(val[VX], -64.f, 64.f),
+									U16_to_F32(val[VY], -64.f, 64.f),
+									U16_to_F32(val[VZ], -64.f, 64.f));
+		dp->unpackU16(val[VX], "ThetaX");
+		dp->unpackU16(val[VY], "ThetaY");
+		dp->unpackU16(val[VZ], "ThetaZ");
+		dp->unpackU16(val[VS], "ThetaS");
+		update.mRotation.mQ[VX] = U16_to_F32(val[VX], -1.f, 1.f);
+		update.mRotation.mQ[VY] = U16_to_F32(val[VY], -1.f, 1.f);
+		update.mRotation.mQ[VZ] = U16_to_F32(val[VZ], -1.f, 1.f);
+		update.mRotation.mQ[VS] = U16_to_F32(val[VS], -1.f, 1.f);
+		dp->unpackU16(val[VX], "AccX");
+		dp->unpackU16(val[VY], "AccY");
+		dp->unpackU16(val[VZ], "AccZ");
+		update.mAngularVelocity.setVec(U16_to_F32(val[VX], -64.f, 64.f),
+									   U16_to_F32(val[VY], -64.f, 64.f),
+									   U16_to_F32(val[VZ], -64.f, 64.f));
+	}
+
+	void unpack_compressed(LLDataPacker* dp, LLCompressedObjectUpdate& update)
+	{
+		dp->unpackUUID(update.mFullID, "ID");
+		dp->unpackU32(update.mLocalID, "LocalID");
+		dp->unpackU8(update.mPCode, "PCode");
+		dp->unpackU8(update.mState, "State");
+		dp->unpackU32(update.mCRC, "CRC");
+		dp->unpackU8(update.mMaterial, "Material");
+		dp->unpackU8(update.mClickAction, "ClickAction");
+		dp->unpackVector3(update.mScale, "Scale");
+		dp->unpackVector3(update.mPosition, "Pos");
+		LLVector3 vec;
+		dp->unpackVector3(vec, "Rot");
+		update.mRotation.unpackFromVector3(vec);
+		dp->unpackU32(update.mSpecialCode, "SpecialCode");
+		dp->unpackUUID(update.mOwnerID, "Owner");
+		update.mHasAngularVelocity = (update.mSpecialCode & 0x80) != 0;
+		if (update.mHasAngularVelocity)
+		{
+			dp->unpackVector3(update.mAngularVelocity, "Omega");
+		}
+		update.mParentID = 0;
+		if (update.mSpecialCode & 0x20)
+		{
+			dp->unpackU32(update.mParentID, "ParentID");
+		}
+	}
+}
+
+namespace tut
+{
+	struct objectupdatedecoder_data
+	{
+		void ensureSameTerse(const LLTerseObjectUpdate& expected, const LLTerseObjectUpdate& update)
+		{
+			ensure_equals("local id", update.mLocalID, expected.mLocalID);
+			ensure_equals("state", update.mState, expected.mState);
+			ensure_equals("foot plane", update.mHasFootPlane, expected.mHasFootPlane);
+			if (expected.mHasFootPlane)
+			{
+				ensure("plane", update.mFootPlane == expected.mFootPlane);
+			}
+			ensure("position", update.mPosition == expected.mPosition);
+			ensure("velocity", update.mVelocity == expected.mVelocity);
+			ensure("acceleration", update.mAcceleration == expected.mAcceleration);
+			ensure("rotation", update.mRotation == expected.mRotation);
+			ensure("angular velocity", update.mAngularVelocity == expected.mAngularVelocity);
+		}
+
+		void ensureSameCompressed(const LLCompressedObjectUpdate& expected, const LLCompressedObjectUpdate& update)
+		{
+			ensure_equals("id", update.mFullID, expected.mFullID);
+			ensure_equals("local id", update.mLocalID, expected.mLocalID);
+			ensure_equals("pcode", update.mPCode, expected.mPCode);
+			ensure_equals("state", update.mState, expected.mState);
+			ensure_equals("crc", update.mCRC, expected.mCRC);
+			ensure_equals("material", update.mMaterial, expected.mMaterial);
+			ensure_equals("click action", update.mClickAction, expected.mClickAction);
+			ensure("scale", update.mScale == expected.mScale);
+			ensure("position", update.mPosition == expected.mPosition);
+			ensure("rotation", update.mRotation == expected.mRotation);
+			ensure_equals("special code", update.mSpecialCode, expected.mSpecialCode);
+			ensure_equals("owner", update.mOwnerID, expected.mOwnerID);
+			ensure_equals("omega", update.mHasAngularVelocity, expected.mHasAngularVelocity);
+			if (expected.mHasAngularVelocity)
+			{
+				ensure("angular velocity", update.mAngularVelocity == expected.mAngularVelocity);
+			}
+			ensure_equals("parent", update.mParentID, expected.mParentID);
+		}
+	};
+	typedef test_group<objectupdatedecoder_data> objectupdatedecoder_test;
+	typedef objectupdatedecoder_test::object objectupdatedecoder_object;
+	tut::objectupdatedecoder_test tut_objectupdatedecoder_test("LLObjectUpdateDecoder");
+
+	template<> template<>
+	void objectupdatedecoder_object::test<1>()
+	{
+		set_test_name("terse updates");
+		U32 seed = 1;
+		U8 buffer[256];
+		for (S32 i = 0; i < 100; ++i)
+		{
+			bool avatar = (i & 1) != 0;
+			S32 size = pack_terse(buffer, sizeof(buffer), seed, 1000 + i, avatar);
+			ensure_equals("packed size", size, avatar ? 60 : 44);
+
+			LLTerseObjectUpdate expected;
+			LLDataPackerBinaryBuffer dp(buffer, size);
+			unpack_terse(&dp, expected);
+
+			LLTerseObjectUpdate update;
+			ensure_equals("used", decode_terse_object_update(buffer, size, update), size);
+			ensureSameTerse(expected, update);
+
+			U32 local_id = 0;
+			ensure("id", decode_terse_object_update_id(buffer, size, local_id));
+			ensure_equals("local id", local_id, (U32)(1000 + i));
+
+			ensure_equals("short", decode_terse_object_update(buffer, size - 1, update), 0);
+		}
+	}
+
+	template<> template<>
+	void objectupdatedecoder_object::test<2>()
+	{
+		set_test_name("compressed updates");
+		U32 seed = 2;
+		U8 buffer[256];
+		const U32 special_codes[] = { 0x0, 0x80, 0x20, 0xa5 };
+		for (S32 i = 0; i < 100; ++i)
+		{
+			U32 special_code = special_codes[i % 4];
+			S32 size = pack_compressed(buffer, sizeof(buffer), seed, 2000 + i, special_code);
+			// a tail the decoder leaves alone
+			buffer[size] = 0xff;
+
+			LLCompressedObjectUpdate expected;
+			LLDataPackerBinaryBuffer dp(buffer, size + 1);
+			unpack_compressed(&dp, expected);
+
+			LLCompressedObjectUpdate update;
+			ensure_equals("used", decode_compressed_object_update(buffer, size + 1, update), size);
+			ensureSameCompressed(expected, update);
+
+			LLUUID full_id;
+			U32 local_id = 0;
+			U8 pcode = 0;
+			ensure("ids", decode_compressed_object_update_ids(buffer, size, full_id, local_id, pcode));
+			ensure_equals("full id", full_id, expected.mFullID);
+			ensure_equals("local id", local_id, (U32)(2000 + i));
+			ensure_equals("pcode", pcode, (U8)9);
+
+			ensure_equals("short", decode_compressed_object_update(buffer, size - 1, update), 0);
+		}
+	}
+
+	template<> template<>
+	void objectupdatedecoder_object::test<3>()
+	{
+		set_test_name("update replay benchmark");
+		if (!getenv("LL_RUN_BENCHMARKS"))
+		{
+			skip("benchmark, set LL_RUN_BENCHMARKS to run it");
+		}
+		// Replays a stream of terse and compressed blocks, one in eight an
+		// avatar or a full update, through the data packer as the viewer
+		// used to, copying each block out of the message first, against the
+		// decoders reading the blocks in place.
+		// LL_OBJECTUPDATE_BENCH_UPDATES and LL_OBJECTUPDATE_BENCH_PASSES
+		// scale the run.
+		S32 num_updates = 20000;
+		S32 passes = 20;
+		if (const char* env = getenv("LL_OBJECTUPDATE_BENCH_UPDATES"))
+		{
+			num_updates = llmax(1, atoi(env));
+		}
+		if (const char* env = getenv("LL_OBJECTUPDATE_BENCH_PASSES"))
+		{
+			passes = llmax(1, atoi(env));
+		}
+
+		U32 seed = 3;
+		std::vector<U8> stream;
+		std::vector<S32> offsets;
+		std::vector<bool> full;
+		U8 block[256];
+		for (S32 i = 0; i < num_updates; ++i)
+		{
+			bool full_update = (i & 7) == 7;
+			S32 size = full_update ? pack_compressed(block, sizeof(block), seed, i, 0xa0)
+								   : pack_terse(block, sizeof(block), seed, i, (i & 7) == 3);
+			offsets.push_back(stream.size());
+			full.push_back(full_update);
+			stream.insert(stream.end(), block, block + size);
+		}
+		offsets.push_back(stream.size());
+
+		F32 packer_sum = 0.f;
+		LLTimer timer;
+		for (S32 pass = 0; pass < passes; ++pass)
+		{
+			for (S32 i = 0; i < num_updates; ++i)
+			{
+				S32 size = offsets[i + 1] - offsets[i];
+				U8 dpbuffer[2048];
+				memcpy(dpbuffer, &stream[offsets[i]], size);
+				LLDataPackerBinaryBuffer dp(dpbuffer, size);
+				if (full[i])
+				{
+					LLCompressedObjectUpdate update;
+					unpack_compressed(&dp, update);
+					packer_sum += update.mPosition.mV[VX];
+				}
+				else
+				{
+					LLTerseObjectUpdate update;
+					unpack_terse(&dp, update);
+					packer_sum += update.mPosition.mV[VX];
+				}
+			}
+		}
+		F64 packer_elapsed = timer.getElapsedTimeF64();
+
+		F32 decoder_sum = 0.f;
+		timer.reset();
+		for (S32 pass = 0; pass < passes; ++pass)
+		{
+			for (S32 i = 0; i < num_updates; ++i)
+			{
+				const U8* data = &stream[offsets[i]];
+				S32 size = offsets[i + 1] - offsets[i];
+				if (full[i])
+				{
+					LLCompressedObjectUpdate update;
+					ensure("decoded", decode_compressed_object_update(data, size, update) != 0);
+					decoder_sum += update.mPosition.mV[VX];
+				}
+				else
+				{
+					LLTerseObjectUpdate update;
+					ensure("decoded", decode_terse_object_update(data, size, update) != 0);
+					decoder_sum += update.mPosition.mV[VX];
+				}
+			}
+		}
+		F64 decoder_elapsed = timer.getElapsedTimeF64();
+
+		F64 total = (F64)num_updates * passes;
+		llinfos << num_updates << " updates replayed " << passes << " times: "
+				<< total / llmax(packer_elapsed, 1.0e-6) << " updates/sec through the data packer, "
+				<< total / llmax(decoder_elapsed, 1.0e-6) << " updates/sec decoded in place" << llendl;
+
+		ensure_equals("same updates", decoder_sum, packer_sum);
+	}
+}
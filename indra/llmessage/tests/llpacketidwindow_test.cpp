@@ -0,0 +1,122 @@
+/**
+ * @file llpacketidwindow_test.cpp
+ * @date   2010-11
+ * @brief  Test the received packet ID window.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ * 
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ * 
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ * 
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "../llpacketidwindow.h"
+
+#include "../test/lltut.h"
+
+namespace tut
+{
+	struct packetidwindow_data
+	{
+	};
+	typedef test_group<packetidwindow_data> packetidwindow_test;
+	typedef packetidwindow_test::object packetidwindow_object;
+	tut::packetidwindow_test packetidwindow_testcase("LLPacketIDWindow");
+
+	template<> template<>
+	void packetidwindow_object::test<1>()
+	{
+		set_test_name("add and contains");
+		LLPacketIDWindow window(64);
+		ensure("starts empty", window.empty());
+		ensure("nothing received", !window.contains(0));
+
+		window.add(10);
+		window.add(12);
+		ensure("10", window.contains(10));
+		ensure("11 missing", !window.contains(11));
+		ensure("12", window.contains(12));
+		ensure("ahead of the window", !window.contains(13));
+		ensure_equals("span", window.getSpan(), 3U);
+
+		// Late arrival inside the window.
+		window.add(11);
+		ensure("11 late", window.contains(11));
+
+		// Sliding forward drops the old IDs and clears the new ones.
+		window.add(100);
+		ensure("10 slid out", !window.contains(10));
+		ensure("99 not received", !window.contains(99));
+		ensure("100", window.contains(100));
+		ensure_equals("span is the window", window.getSpan(), 64U);
+
+		// Too old to track.
+		window.add(20);
+		ensure("20 too old", !window.contains(20));
+	}
+
+	template<> template<>
+	void packetidwindow_object::test<2>()
+	{
+		set_test_name("wrapping IDs");
+		LLPacketIDWindow window(64);
+		window.add(0x00FFFFFE);
+		window.add(0x00FFFFFF);
+		window.add(1);
+		ensure("before the wrap", window.contains(0x00FFFFFE));
+		ensure("at the wrap", window.contains(0x00FFFFFF));
+		ensure("0 missing", !window.contains(0));
+		ensure("after the wrap", window.contains(1));
+		ensure_equals("span", window.getSpan(), 4U);
+
+		window.add(0);
+		ensure("0 late", window.contains(0));
+	}
+
+	template<> template<>
+	void packetidwindow_object::test<3>()
+	{
+		set_test_name("forgetBefore");
+		LLPacketIDWindow window(64);
+		for (TPACKETID id = 1; id <= 10; ++id)
+		{
+			window.add(id);
+		}
+		window.forgetBefore(6);
+		ensure("5 forgotten", !window.contains(5));
+		ensure("6 kept", window.contains(6));
+		ensure_equals("span", window.getSpan(), 5U);
+
+		// A resend from before the oldest stretches the window back,
+		// without bringing the forgotten IDs in between back.
+		window.add(3);
+		ensure("3", window.contains(3));
+		ensure("4 still forgotten", !window.contains(4));
+		ensure("5 still forgotten", !window.contains(5));
+		ensure("6 still kept", window.contains(6));
+
+		// Oldest unacked ahead of everything forgets it all.
+		window.forgetBefore(20);
+		ensure("all forgotten", window.empty());
+		ensure("10 forgotten", !window.contains(10));
+		window.add(21);
+		ensure("restarts", window.contains(21));
+	}
+}
@@ -0,0 +1,267 @@
+/**
+ * @file llpartarray_test.cpp
+ * @brief LLPartArray tests
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include <cstdlib>
+
+#include "linden_common.h"
+#include "lltimer.h"
+
+#include "../llpartarray.h"
+
+#include "../test/lltut.h"
+
+namespace
+{
+	// The per particle update LLViewerPartGroup did before particles were
+	// stored in arrays.
+	struct RefPart
+	{
+		LLPartData mData;
+		LLVector3 mPos;
+		LLVector3 mVelocity;
+		LLVector3 mAccel;
+		LLColor4 mColor;
+		LLVector2 mScale;
+		F32 mAge;
+
+		void update(F32 dt)
+		{
+			const F32 cur_time = mAge + dt;
+			const F32 frac = cur_time / mData.mMaxAge;
+			if (!(mData.mFlags & LLPartData::LL_PART_TARGET_LINEAR_MASK))
+			{
+				mPos += dt*mVelocity;
+				mPos += 0.5f*dt*dt*mAccel;
+				mVelocity += mAccel*dt;
+			}
+			if (mData.mFlags & LLPartData::LL_PART_INTERP_COLOR_MASK)
+			{
+				mColor.setVec(mData.mStartColor);
+				mColor *= 1.f - frac;
+				mColor %= 1.f - frac;
+				mColor += frac%(frac*mData.mEndColor);
+			}
+			if (mData.mFlags & LLPartData::LL_PART_INTERP_SCALE_MASK)
+			{
+				mScale.setVec(mData.mStartScale);
+				mScale *= 1.f - frac;
+				mScale += frac*mData.mEndScale;
+			}
+			mAge = cur_time;
+		}
+	};
+
+	RefPart makePart(S32 i)
+	{
+		RefPart part;
+		part.mData.mFlags = 0;
+		if (i % 2)
+		{
+			part.mData.mFlags |= LLPartData::LL_PART_INTERP_COLOR_MASK;
+		}
+		if (i % 3)
+		{
+			part.mData.mFlags |= LLPartData::LL_PART_INTERP_SCALE_MASK;
+		}
+		if (i % 5 == 0)
+		{
+			part.mData.mFlags |= LLPartData::LL_PART_TARGET_LINEAR_MASK;
+		}
+		part.mData.mMaxAge = 2.f + 0.1f * i;
+		part.mData.mStartColor.setVec(1.f, 0.5f, 0.25f, 1.f);
+		part.mData.mEndColor.setVec(0.f, 0.25f, 1.f, 0.f);
+		part.mData.mStartScale.setVec(0.5f, 1.f);
+		part.mData.mEndScale.setVec(2.f, 0.25f);
+		part.mPos.setVec(10.f + i, 20.f - i, 30.f + 0.5f * i);
+		part.mVelocity.setVec(0.1f * i, -0.2f * i, 1.f);
+		part.mAccel.setVec(0.f, 0.05f * i, -9.8f);
+		part.mColor.setVec(0.3f, 0.3f, 0.3f, 0.3f);
+		part.mScale.setVec(1.f, 1.f);
+		part.mAge = 0.01f * i;
+		return part;
+	}
+}
+
+namespace tut
+{
+	struct partarray_test
+	{
+	};
+	typedef test_group<partarray_test> partarray_test_t;
+	typedef partarray_test_t::object partarray_test_object_t;
+	tut::partarray_test_t tut_partarray_test("LLPartArray");
+
+	template<> template<>
+	void partarray_test_object_t::test<1>()
+	{
+		set_test_name("batch step matches per particle update");
+		// not a multiple of four, so both the SSE and scalar paths run
+		const S32 count = 23;
+		std::vector<RefPart> ref;
+		LLPartArray parts;
+		for (S32 i = 0; i < count; i++)
+		{
+			ref.push_back(makePart(i));
+			const RefPart& p = ref.back();
+			parts.add(p.mData, p.mPos, p.mVelocity, p.mAccel, p.mColor, p.mScale, p.mAge, 0.f);
+		}
+		parts.setSkipOffset(7, 0.01f);
+
+		for (S32 step = 0; step < 10; step++)
+		{
+			const F32 dt = 0.033f;
+			parts.beginStep(dt);
+			parts.integrate();
+			for (S32 i = 0; i < count; i++)
+			{
+				ref[i].update(dt - (step == 0 && i == 7 ? 0.01f : 0.f));
+			}
+		}
+
+		for (S32 i = 0; i < count; i++)
+		{
+			for (S32 c = 0; c < 3; c++)
+			{
+				ensure_approximately_equals("position", parts.getPosition(i).mV[c], ref[i].mPos.mV[c], 16);
+				ensure_approximately_equals("velocity", parts.getVelocity(i).mV[c], ref[i].mVelocity.mV[c], 16);
+			}
+			for (S32 c = 0; c < 4; c++)
+			{
+				ensure_approximately_equals("color", parts.getColor(i).mV[c], ref[i].mColor.mV[c], 16);
+			}
+			for (S32 c = 0; c < 2; c++)
+			{
+				ensure_approximately_equals("scale", parts.getScale(i).mV[c], ref[i].mScale.mV[c], 16);
+			}
+			ensure_approximately_equals("age", parts.getAge(i), ref[i].mAge, 16);
+		}
+	}
+
+	template<> template<>
+	void partarray_test_object_t::test<2>()
+	{
+		set_test_name("remove moves the last particle into the slot");
+		LLPartArray parts;
+		for (S32 i = 0; i < 5; i++)
+		{
+			RefPart p = makePart(i);
+			parts.add(p.mData, p.mPos, p.mVelocity, p.mAccel, p.mColor, p.mScale, p.mAge, 0.f);
+		}
+		const LLVector3 last_pos = parts.getPosition(4);
+		const U32 last_flags = parts.getFlags(4);
+		parts.remove(1);
+		ensure_equals("size", parts.size(), 4);
+		ensure("position moved", parts.getPosition(1) == last_pos);
+		ensure_equals("flags moved", parts.getFlags(1), last_flags);
+
+		// a linear target particle is placed by its owner, not integrated
+		parts.setFlags(1, LLPartData::LL_PART_TARGET_LINEAR_MASK);
+		parts.beginStep(0.1f);
+		parts.integrate();
+		ensure("linear target not moved", parts.getPosition(1) == last_pos);
+
+		parts.shift(LLVector3(1.f, 2.f, 3.f));
+		ensure("shifted", parts.getPosition(1) == last_pos + LLVector3(1.f, 2.f, 3.f));
+
+		parts.clear();
+		ensure("cleared", parts.empty());
+	}
+
+	template<> template<>
+	void partarray_test_object_t::test<3>()
+	{
+		set_test_name("synthetic particle sources benchmark");
+		if (!getenv("LL_RUN_BENCHMARKS"))
+		{
+			skip("benchmark, set LL_RUN_BENCHMARKS to run it");
+		}
+		// A headless stand in for a region full of particle systems: every
+		// source emits a burst each frame and expired particles are removed.
+		// LL_PART_BENCH_PARTS and LL_PART_BENCH_FRAMES scale the run.
+		S32 num_parts = 4096;
+		S32 num_frames = 200;
+		if (const char* env = getenv("LL_PART_BENCH_PARTS"))
+		{
+			num_parts = llmax(1, atoi(env));
+		}
+		if (const char* env = getenv("LL_PART_BENCH_FRAMES"))
+		{
+			num_frames = llmax(1, atoi(env));
+		}
+
+		const S32 num_sources = 16;
+		const F32 dt = 1.f / 60.f;
+		std::vector<RefPart> sources;
+		for (S32 i = 0; i < num_sources; i++)
+		{
+			sources.push_back(makePart(i));
+			sources.back().mData.mFlags &= ~LLPartData::LL_PART_TARGET_LINEAR_MASK;
+			sources.back().mData.mMaxAge = 1.f + 0.25f * (i % 4);
+		}
+		// emit so the population settles around num_parts
+		const S32 burst = llmax(1, (S32)(num_parts * dt / 1.5f / num_sources));
+
+		LLPartArray parts;
+		LLTimer timer;
+		S32 peak = 0;
+		for (S32 frame = 0; frame < num_frames; frame++)
+		{
+			for (S32 s = 0; s < num_sources; s++)
+			{
+				const RefPart& src = sources[s];
+				for (S32 b = 0; b < burst; b++)
+				{
+					LLVector3 velocity(src.mVelocity);
+					velocity.mV[VX] += 0.01f * b;
+					parts.add(src.mData, src.mPos, velocity, src.mAccel, src.mColor, src.mScale, 0.f, 0.f);
+				}
+			}
+			parts.beginStep(dt);
+			parts.integrate();
+			for (S32 i = 0; i < parts.size();)
+			{
+				if (parts.getAge(i) > parts.getMaxAge(i))
+				{
+					parts.remove(i);
+				}
+				else
+				{
+					i++;
+				}
+			}
+			peak = llmax(peak, parts.size());
+		}
+		F64 elapsed = timer.getElapsedTimeF64();
+		llinfos << num_sources << " sources, " << peak << " peak particles, " << num_frames
+				<< " frames: " << elapsed * 1000.0 / num_frames << " ms per frame" << llendl;
+
+		ensure("particles alive", parts.size() > 0);
+		for (S32 i = 0; i < parts.size(); i++)
+		{
+			ensure("position finite", parts.getPosition(i).isFinite());
+		}
+	}
+}
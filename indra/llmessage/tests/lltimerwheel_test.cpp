@@ -0,0 +1,251 @@
+/**
+ * @file lltimerwheel_test.cpp
+ * @date   2010-11
+ * @brief  Test the resend timer wheel, on its own and driving a lossy loopback.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ * 
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ * 
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ * 
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "../lltimerwheel.h"
+#include "../llpacketidwindow.h"
+
+#include <deque>
+#include <map>
+
+#include "lltimer.h"
+
+#include "../test/lltut.h"
+
+namespace
+{
+	bool dueContains(const LLTimerWheel::entry_list_t& due, U32 id)
+	{
+		for (LLTimerWheel::entry_list_t::const_iterator it = due.begin(); it != due.end(); ++it)
+		{
+			if (it->mID == id)
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// Deterministic packet loss for the loopback test.
+	class LossyLink
+	{
+	public:
+		LossyLink(U32 seed, U32 loss_percent) : mState(seed), mLossPercent(loss_percent) {}
+		bool drop()
+		{
+			mState = mState * 1664525 + 1013904223;
+			return ((mState >> 16) % 100) < mLossPercent;
+		}
+	private:
+		U32 mState;
+		U32 mLossPercent;
+	};
+
+	struct InFlight
+	{
+		InFlight(F64 arrival, TPACKETID id) : mArrival(arrival), mID(id) {}
+		F64 mArrival;
+		TPACKETID mID;
+	};
+	typedef std::deque<InFlight> in_flight_t;
+}
+
+namespace tut
+{
+	struct timerwheel_data
+	{
+	};
+	typedef test_group<timerwheel_data> timerwheel_test;
+	typedef timerwheel_test::object timerwheel_object;
+	tut::timerwheel_test timerwheel_testcase("LLTimerWheel");
+
+	template<> template<>
+	void timerwheel_object::test<1>()
+	{
+		set_test_name("entries come due in time");
+		LLTimerWheel wheel(0.01, 16);
+		LLTimerWheel::entry_list_t due;
+		wheel.advance(100.0, due);
+		wheel.schedule(1, 100.5);
+		wheel.schedule(2, 100.05);
+		wheel.schedule(3, 99.0);		// already late
+		ensure_equals("size", wheel.size(), 3U);
+
+		wheel.advance(100.001, due);
+		ensure_equals("only the late one", due.size(), size_t(1));
+		ensure_equals("late id", due[0].mID, 3U);
+		due.clear();
+
+		wheel.advance(100.1, due);
+		ensure_equals("second", due.size(), size_t(1));
+		ensure_equals("second id", due[0].mID, 2U);
+		due.clear();
+
+		// 100.5 is three turns of the wheel away from 100.05.
+		wheel.advance(100.3, due);
+		ensure("not yet", due.empty());
+		wheel.advance(100.6, due);
+		ensure("beyond the horizon", dueContains(due, 1));
+		ensure("empty", wheel.empty());
+	}
+
+	template<> template<>
+	void timerwheel_object::test<2>()
+	{
+		set_test_name("long gaps and clear");
+		LLTimerWheel wheel(0.01, 16);
+		LLTimerWheel::entry_list_t due;
+		for (U32 i = 0; i < 100; ++i)
+		{
+			wheel.schedule(i, 10.0 + i * 0.013);
+		}
+		// Long after all of them, one pass gets everything.
+		wheel.advance(60.0, due);
+		ensure_equals("all due", due.size(), size_t(100));
+		ensure("empty", wheel.empty());
+
+		due.clear();
+		wheel.schedule(1, 61.0);
+		wheel.clear();
+		wheel.advance(70.0, due);
+		ensure("cleared", due.empty());
+
+		// A clock going backwards holds everything back.
+		wheel.schedule(2, 70.5);
+		wheel.advance(69.0, due);
+		wheel.advance(70.4, due);
+		ensure("backwards", due.empty());
+		wheel.advance(70.6, due);
+		ensure("caught up", dueContains(due, 2));
+	}
+
+	template<> template<>
+	void timerwheel_object::test<3>()
+	{
+		set_test_name("lossy loopback");
+		// Reliable packets over a link that drops 10% of the packets and
+		// 10% of the acks each way with a 50 ms one way delay, resent
+		// 200 ms after going out. The sender keeps its unacked packets in
+		// a map for acks and a wheel for resends, the receiver suppresses
+		// duplicates with a window, like LLCircuitData.
+		const U32 PACKET_COUNT = 20000;
+		const F64 STEP = 0.001;
+		const F64 DELAY = 0.05;
+		const F64 RESEND_TIMEOUT = 0.2;
+
+		LossyLink data_link(1, 10);
+		LossyLink ack_link(2, 10);
+		in_flight_t data_in_flight;
+		in_flight_t acks_in_flight;
+
+		typedef std::map<TPACKETID, F64> unacked_map_t;
+		unacked_map_t unacked;
+		LLTimerWheel resend_wheel;
+		LLTimerWheel::entry_list_t due;
+		LLPacketIDWindow received;
+
+		U32 delivered = 0;
+		U32 duplicates = 0;
+		U32 sends = 0;
+		TPACKETID next_id = 0x00FFFF00;	// wraps part way through
+		F64 now = 1000.0;
+
+		U64 start = totalTime();
+		while (delivered < PACKET_COUNT || !unacked.empty())
+		{
+			now += STEP;
+
+			// Sender: one new packet per step, and the resends that are due.
+			if (sends < PACKET_COUNT)
+			{
+				TPACKETID id = next_id;
+				next_id = (next_id + 1) & 0x00FFFFFF;
+				unacked[id] = now + RESEND_TIMEOUT;
+				resend_wheel.schedule(id, now + RESEND_TIMEOUT);
+				if (!data_link.drop())
+				{
+					data_in_flight.push_back(InFlight(now + DELAY, id));
+				}
+				sends++;
+			}
+			resend_wheel.advance(now, due);
+			for (LLTimerWheel::entry_list_t::iterator it = due.begin(); it != due.end(); ++it)
+			{
+				unacked_map_t::iterator packet = unacked.find(it->mID);
+				if (packet == unacked.end() || packet->second != it->mWhen)
+				{
+					continue;
+				}
+				packet->second = now + RESEND_TIMEOUT;
+				resend_wheel.schedule(it->mID, packet->second);
+				if (!data_link.drop())
+				{
+					data_in_flight.push_back(InFlight(now + DELAY, it->mID));
+				}
+			}
+			due.clear();
+
+			// Receiver: ack everything, deliver what it hasn't seen.
+			while (!data_in_flight.empty() && data_in_flight.front().mArrival <= now)
+			{
+				TPACKETID id = data_in_flight.front().mID;
+				data_in_flight.pop_front();
+				if (received.contains(id))
+				{
+					duplicates++;
+				}
+				else
+				{
+					received.add(id);
+					delivered++;
+				}
+				if (!ack_link.drop())
+				{
+					acks_in_flight.push_back(InFlight(now + DELAY, id));
+				}
+			}
+
+			// Sender: acks.
+			while (!acks_in_flight.empty() && acks_in_flight.front().mArrival <= now)
+			{
+				unacked.erase(acks_in_flight.front().mID);
+				acks_in_flight.pop_front();
+			}
+
+			ensure("link stalled", now < 1000.0 + 10.0 * PACKET_COUNT * STEP);
+		}
+		U64 elapsed_usec = totalTime() - start;
+
+		ensure_equals("each packet delivered once", delivered, PACKET_COUNT);
+		ensure("lost acks caused duplicate resends", duplicates > 0);
+		ensure("everything acked", unacked.empty());
+		llinfos << "lossy loopback: " << PACKET_COUNT << " packets, "
+				<< duplicates << " duplicates suppressed, "
+				<< (F64)elapsed_usec / PACKET_COUNT << " usec of CPU per packet" << llendl;
+	}
+}
@@ -0,0 +1,155 @@
+/**
+ * @file patch_idct_test.cpp
+ * @brief Terrain patch decompression tests
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include <cstring>
+
+#include "linden_common.h"
+#include "llmath.h"
+#include "llrand.h"
+
+#include "../patch_dct.h"
+
+#include "../test/lltut.h"
+
+extern F32 gPatchDequantizeTable[];
+extern S32 gDeCopyMatrix[];
+
+namespace
+{
+	// The decompression as it is without LL_VECTORIZE, around the scalar
+	// inverse DCT.
+	void reference_decompress_patch(F32 *patch, const S32 *cpatch, const LLPatchHeader& ph, S32 size, S32 stride)
+	{
+		F32 block[LARGE_PATCH_SIZE*LARGE_PATCH_SIZE];
+		S32 i, j;
+
+		for (i = 0; i < size*size; i++)
+		{
+			block[i] = cpatch[gDeCopyMatrix[i]]*gPatchDequantizeTable[i];
+		}
+
+		if (size == NORMAL_PATCH_SIZE)
+		{
+			idct_patch(block);
+		}
+		else
+		{
+			idct_patch_large(block);
+		}
+
+		S32 prequant = (ph.quant_wbits >> 4) + 2;
+		F32 mult = (1.f/(F32)(1<<prequant))*ph.range;
+		F32 addval = mult*(F32)(1<<(prequant - 1))+ph.dc_offset;
+		for (j = 0; j < size; j++)
+		{
+			for (i = 0; i < size; i++)
+			{
+				patch[j*stride + i] = block[j*size + i]*mult+addval;
+			}
+		}
+	}
+
+	void make_patch(S32 *cpatch, LLPatchHeader& ph, S32 size)
+	{
+		// Mostly low frequencies, like real terrain
+		for (S32 i = 0; i < size*size; i++)
+		{
+			cpatch[i] = (i < 40 || ll_rand(8) == 0) ? ll_rand(400) - 200 : 0;
+		}
+		ph.dc_offset = ll_frand(100.f) - 10.f;
+		ph.range = 1 + ll_rand(200);
+		ph.quant_wbits = (U8)((ll_rand(4) << 4) | 6);
+		ph.patchids = 0;
+	}
+}
+
+namespace tut
+{
+	struct patch_idct_test
+	{
+	};
+	typedef test_group<patch_idct_test> patch_idct_test_t;
+	typedef patch_idct_test_t::object patch_idct_test_object_t;
+	tut::patch_idct_test_t tut_patch_idct_test("PatchIDCT");
+
+	void check_patch_size(S32 size)
+	{
+		// A stride wider than the patch, like a surface's grid
+		const S32 stride = size*2 + 1;
+		LLGroupHeader gh;
+		gh.stride = stride;
+		gh.patch_size = size;
+		gh.layer_type = 0;
+		init_patch_decompressor(size);
+		set_group_of_patch_header(&gh);
+
+		const S32 num_patches = 8;
+		std::vector<S32> cpatches(num_patches*size*size);
+		std::vector<LLPatchHeader> headers(num_patches);
+		std::vector<F32> result(num_patches*size*stride);
+		std::vector<F32> batch_result(num_patches*size*stride);
+		std::vector<F32> expected(num_patches*size*stride);
+		std::vector<F32*> outputs(num_patches);
+		for (S32 p = 0; p < num_patches; p++)
+		{
+			make_patch(&cpatches[p*size*size], headers[p], size);
+			outputs[p] = &batch_result[p*size*stride];
+		}
+
+		for (S32 p = 0; p < num_patches; p++)
+		{
+			reference_decompress_patch(&expected[p*size*stride], &cpatches[p*size*size], headers[p], size, stride);
+			decompress_patch(&result[p*size*stride], &cpatches[p*size*size], &headers[p]);
+		}
+		decompress_patches(&outputs[0], &cpatches[0], &headers[0], num_patches);
+
+		for (S32 p = 0; p < num_patches; p++)
+		{
+			for (S32 j = 0; j < size; j++)
+			{
+				S32 row = p*size*stride + j*stride;
+				ensure("decompress_patch matches bit for bit",
+					   memcmp(&result[row], &expected[row], size*sizeof(F32)) == 0);
+				ensure("decompress_patches matches bit for bit",
+					   memcmp(&batch_result[row], &expected[row], size*sizeof(F32)) == 0);
+			}
+		}
+	}
+
+	template<> template<>
+	void patch_idct_test_object_t::test<1>()
+	{
+		set_test_name("16x16 patches");
+		check_patch_size(NORMAL_PATCH_SIZE);
+	}
+
+	template<> template<>
+	void patch_idct_test_object_t::test<2>()
+	{
+		set_test_name("32x32 patches");
+		check_patch_size(LARGE_PATCH_SIZE);
+	}
+}
@@ -0,0 +1,83 @@
+#!/usr/bin/python
+"""\
+@file   test_llcurl_peer.py
+@date   2010-11
+@brief  This script asynchronously runs the executable (with args) specified on
+        the command line, returning its result code. While that executable is
+        running, we provide an HTTP/1.1 keep-alive server for llcurl_test.cpp.
+
+$LicenseInfo:firstyear=2010&license=viewerlgpl$
+Second Life Viewer Source Code
+Copyright (C) 2010, Linden Research, Inc.
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation;
+version 2.1 of the License only.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+$/LicenseInfo$
+"""
+
+import os
+import sys
+import time
+from threading import Thread
+from BaseHTTPServer import HTTPServer, BaseHTTPRequestHandler
+from SocketServer import ThreadingMixIn
+
+mydir = os.path.dirname(__file__)       # expected to be .../indra/llmessage/tests/
+sys.path.insert(0, os.path.join(mydir, os.pardir, os.pardir, "lib", "python"))
+from testrunner import run, debug
+
+class KeepAliveRequestHandler(BaseHTTPRequestHandler):
+    """Answers every GET with a small body. Connections are kept open
+    unless the path asks for them to be closed.
+    """
+    protocol_version = "HTTP/1.1"
+
+    def do_GET(self):
+        # Hold each response briefly so requests overlap and the client's
+        # per-host limit comes into play.
+        time.sleep(0.02)
+        body = "ok"
+        self.send_response(200)
+        self.send_header("Content-type", "text/plain")
+        self.send_header("Content-Length", str(len(body)))
+        if "close" in self.path:
+            self.send_header("Connection", "close")
+            self.close_connection = 1
+        self.end_headers()
+        self.wfile.write(body)
+
+    def log_request(self, code, size=None):
+        # For present purposes, we don't want the request splattered onto
+        # stderr, as it would upset devs watching the test run
+        pass
+
+    def log_error(self, format, *args):
+        # Suppress error output as well
+        pass
+
+class ThreadingHTTPServer(ThreadingMixIn, HTTPServer):
+    # one thread per connection, so kept-alive connections don't block
+    # each other
+    daemon_threads = True
+
+class TestHTTPServer(Thread):
+    def run(self):
+        httpd = ThreadingHTTPServer(('127.0.0.1', 8001), KeepAliveRequestHandler)
+        debug("Starting HTTP server...\n")
+        httpd.serve_forever()
+
+if __name__ == "__main__":
+    sys.exit(run(server=TestHTTPServer(name="httpd"), *sys.argv[1:]))
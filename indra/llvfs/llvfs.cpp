@@ -37,6 +37,7 @@
 #include <fcntl.h>
 #else
 #include <sys/file.h>
+#include <unistd.h>
 #endif
     
 #include "llvfs.h"
@@ -102,6 +103,13 @@ bool LLVFSFileSpecifier::operator==(const LLVFSFileSpecifier &rhs) const
 	return (mFileID == rhs.mFileID && 
 			mFileType == rhs.mFileType);
 }
+
+size_t LLVFSFileSpecifierHash::operator()(const LLVFSFileSpecifier &spec) const
+{
+	// Asset IDs are random enough that folding the words together spreads
+	// them; the type keeps the several files of one asset apart.
+	return (size_t)(spec.mFileID.getCRC32() ^ ((U32)spec.mFileType * 0x9E3779B1U));
+}
     
     
 class LLVFSFileBlock : public LLVFSBlock, public LLVFSFileSpecifier
@@ -123,6 +131,7 @@ public:
 		mSize = 0;
 		mIndexLocation = -1;
 		mAccessTime = (U32)time(NULL);
+		mReaders = 0;
 
 		for (S32 i = 0; i < (S32)VFSLOCK_COUNT; i++)
 		{
@@ -212,6 +221,7 @@ public:
 	S32  mIndexLocation; // location of index entry
 	U32  mAccessTime;
 	BOOL mLocks[VFSLOCK_COUNT]; // number of outstanding locks of each type
+	S32  mReaders;		// getData() calls reading outside mDataMutex
     
 	static const S32 SERIAL_SIZE;
 };
@@ -234,7 +244,8 @@ LLVFS::LLVFS(const std::string& index_filename, const std::string& data_filename
 	mDataFP(NULL),
 	mIndexFP(NULL)
 {
-	mDataMutex = new LLMutex(0);
+	mDataMutex = new LLCondition(0);
+	mDataFileMutex = new LLMutex(0);
 
 	S32 i;
 	for (i = 0; i < VFSLOCK_COUNT; i++)
@@ -315,6 +326,8 @@ LLVFS::LLVFS(const std::string& index_filename, const std::string& data_filename
 	}
 
 	// determine the real file size
+	// This also flushes the presize write. From here on the data file is
+	// only used through readDataFile() and writeDataFile().
 	fseek(mDataFP, 0, SEEK_END);
 	U32 data_size = ftell(mDataFP);
 
@@ -411,7 +424,7 @@ LLVFS::LLVFS(const std::string& index_filename, const std::string& data_filename
 			if (last_file_block->mLocation > 0)
 			{
 				// If so, create a free block.
-				addFreeBlock(new LLVFSBlock(0, last_file_block->mLocation));
+				mFreeExtents.add(0, last_file_block->mLocation);
 			}
 
 			// Walk through the 2nd+ block.  If there is a free space
@@ -440,10 +453,7 @@ LLVFS::LLVFS(const std::string& index_filename, const std::string& data_filename
 					if (cur_file_block->mLength > 0)
 					{
 						// convert to hole
-						addFreeBlock(
-							new LLVFSBlock(
-								cur_file_block->mLocation,
-								cur_file_block->mLength));
+						mFreeExtents.add(cur_file_block->mLocation, cur_file_block->mLength);
 					}
 					lockData();						// needed for sync()
 					sync(cur_file_block, TRUE);		// remove first on disk
@@ -494,7 +504,7 @@ LLVFS::LLVFS(const std::string& index_filename, const std::string& data_filename
 				// we don't want to add empty blocks to the list...
 				if (length > 0)
 				{
-					addFreeBlock(new LLVFSBlock(loc, length));
+					mFreeExtents.add(loc, length);
 				}
 				last_file_block = cur_file_block;
 				++cur;
@@ -504,12 +514,12 @@ LLVFS::LLVFS(const std::string& index_filename, const std::string& data_filename
 			U32 loc = last_file_block->mLocation + last_file_block->mLength;
 			if (loc < data_size)
 			{
-				addFreeBlock(new LLVFSBlock(loc, data_size - loc));
+				mFreeExtents.add(loc, data_size - loc);
 			}
 		}
 		else // There where no blocks in the file.
 		{
-			addFreeBlock(new LLVFSBlock(0, data_size));
+			mFreeExtents.add(0, data_size);
 		}
 	}
 	else	// Pre-existing index file wasn't opened
@@ -536,8 +546,7 @@ LLVFS::LLVFS(const std::string& index_filename, const std::string& data_filename
 		}
 	
 		// no index file, start from scratch w/ 1GB allocation
-		LLVFSBlock *first_block = new LLVFSBlock(0, data_size ? data_size : 0x40000000);
-		addFreeBlock(first_block);
+		mFreeExtents.add(0, data_size ? data_size : 0x40000000);
 	}
 
 	// Open marker file to look for bad shutdowns
@@ -575,9 +584,7 @@ LLVFS::~LLVFS()
 	}
 	mFileBlocks.clear();
 	
-	mFreeBlocksByLength.clear();
-
-	for_each(mFreeBlocksByLocation.begin(), mFreeBlocksByLocation.end(), DeletePairedPointer());
+	mFreeExtents.clear();
     
 	unlockAndClose(mDataFP);
 	mDataFP = NULL;
@@ -590,6 +597,7 @@ LLVFS::~LLVFS()
 	}
 
 	delete mDataMutex;
+	delete mDataFileMutex;
 }
 
 
@@ -743,8 +751,7 @@ BOOL LLVFS::checkAvailable(S32 max_size)
 {
 	lockData();
 	
-	blocks_length_map_t::iterator iter = mFreeBlocksByLength.lower_bound(max_size); // first entry >= size
-	const BOOL res(iter == mFreeBlocksByLength.end() ? FALSE : TRUE);
+	const BOOL res = mFreeExtents.hasFit(max_size);
 
 	unlockData();
 	
@@ -769,13 +776,10 @@ BOOL LLVFS::setMaxSize(const LLUUID &file_id, const LLAssetType::EType file_type
 
 	lockData();
 	
+	// The file's space may move or shrink, don't pull it out from under
+	// a read.
 	LLVFSFileSpecifier spec(file_id, file_type);
-	LLVFSFileBlock *block = NULL;
-	fileblock_map::iterator it = mFileBlocks.find(spec);
-	if (it != mFileBlocks.end())
-	{
-		block = (*it).second;
-	}
+	LLVFSFileBlock *block = waitForReaders(spec);
     
 	// round all sizes upward to KB increments
 	// SJB: Need to not round for the new texture-pipeline code so we know the correct
@@ -801,9 +805,7 @@ BOOL LLVFS::setMaxSize(const LLUUID &file_id, const LLAssetType::EType file_type
 		else if (max_size < block->mLength)
 		{
 			// this file is shrinking
-			LLVFSBlock *free_block = new LLVFSBlock(block->mLocation + max_size, block->mLength - max_size);
-
-			addFreeBlock(free_block);
+			mFreeExtents.add(block->mLocation + max_size, block->mLength - max_size);
     
 			block->mLength = max_size;
     
@@ -826,57 +828,40 @@ BOOL LLVFS::setMaxSize(const LLUUID &file_id, const LLAssetType::EType file_type
 			// first check for an adjacent free block to grow into
 			S32 size_increase = max_size - block->mLength;
 
-			// Find the first free block with and addres > block->mLocation
-			LLVFSBlock *free_block;
-			blocks_location_map_t::iterator iter = mFreeBlocksByLocation.upper_bound(block->mLocation);
-			if (iter != mFreeBlocksByLocation.end())
+			// is the free extent right after the file large enough?
+			U32 file_end = block->mLocation + block->mLength;
+			if (mFreeExtents.getLengthAt(file_end) >= size_increase)
 			{
-				free_block = iter->second;
-			
-				if (free_block->mLocation == block->mLocation + block->mLength &&
-					free_block->mLength >= size_increase)
-				{
-					// this free block is at the end of the file and is large enough
-
-					// Must call useFreeSpace before sync(), as sync()
-					// unlocks data structures.
-					useFreeSpace(free_block, size_increase);
-					block->mLength += size_increase;
-					sync(block);
+				// Must use the free space before sync(), as sync()
+				// unlocks data structures.
+				mFreeExtents.use(file_end, size_increase);
+				block->mLength += size_increase;
+				sync(block);
 
-					unlockData();
-					return TRUE;
-				}
+				unlockData();
+				return TRUE;
 			}
 			
 			// no adjecent free block, find one in the list
-			free_block = findFreeBlock(max_size, block);
-    
-			if (free_block)
+			U32 new_data_location = 0;
+			if (findFreeBlock(max_size, new_data_location, block))
 			{
-				// Save location where data is going, useFreeSpace will move free_block->mLocation;
-				U32 new_data_location = free_block->mLocation;
-
-				//mark the free block as used so it does not
-				//interfere with other operations such as addFreeBlock
-				useFreeSpace(free_block, max_size);		// useFreeSpace takes ownership (and may delete) free_block
+				//mark the free space as used so it does not
+				//interfere with other operations such as freeing
+				mFreeExtents.use(new_data_location, max_size);
 
 				if (block->mLength > 0)
 				{
 					// create a new free block where this file used to be
-					LLVFSBlock *new_free_block = new LLVFSBlock(block->mLocation, block->mLength);
-
-					addFreeBlock(new_free_block);
+					mFreeExtents.add(block->mLocation, block->mLength);
 					
 					if (block->mSize > 0)
 					{
 						// move the file into the new block
 						std::vector<U8> buffer(block->mSize);
-						fseek(mDataFP, block->mLocation, SEEK_SET);
-						if (fread(&buffer[0], block->mSize, 1, mDataFP) == 1)
+						if (readDataFile(block->mLocation, &buffer[0], block->mSize) == block->mSize)
 						{
-							fseek(mDataFP, new_data_location, SEEK_SET);
-							if (fwrite(&buffer[0], block->mSize, 1, mDataFP) != 1)
+							if (writeDataFile(new_data_location, &buffer[0], block->mSize) != block->mSize)
 							{
 								llwarns << "Short write" << llendl;
 							}
@@ -909,25 +894,24 @@ BOOL LLVFS::setMaxSize(const LLUUID &file_id, const LLAssetType::EType file_type
 	else
 	{
 		// find a free block in the list
-		LLVFSBlock *free_block = findFreeBlock(max_size);
-    
-		if (free_block)
+		U32 free_location = 0;
+		if (findFreeBlock(max_size, free_location))
 		{        
 			if (block)
 			{
-				block->mLocation = free_block->mLocation;
+				block->mLocation = free_location;
 				block->mLength = max_size;
 			}
 			else
 			{
 				// this file doesn't exist, create it
-				block = new LLVFSFileBlock(file_id, file_type, free_block->mLocation, max_size);
+				block = new LLVFSFileBlock(file_id, file_type, free_location, max_size);
 				mFileBlocks.insert(fileblock_map::value_type(spec, block));
 			}
 
-			// Must call useFreeSpace before sync(), as sync()
+			// Must use the free space before sync(), as sync()
 			// unlocks data structures.
-			useFreeSpace(free_block, max_size);
+			mFreeExtents.use(free_location, max_size);
 			block->mAccessTime = (U32)time(NULL);
 
 			sync(block);
@@ -964,6 +948,10 @@ void LLVFS::renameFile(const LLUUID &file_id, const LLAssetType::EType file_type
 	
 	LLVFSFileSpecifier new_spec(new_id, new_type);
 	LLVFSFileSpecifier old_spec(file_id, file_type);
+
+	// The target's data is about to be freed. The source keeps its space,
+	// so reads of it can carry on.
+	waitForReaders(new_spec);
 	
 	fileblock_map::iterator it = mFileBlocks.find(old_spec);
 	if (it != mFileBlocks.end())
@@ -1024,9 +1012,8 @@ void LLVFS::removeFileBlock(LLVFSFileBlock *fileblock)
 	if (fileblock->mLength > 0)
 	{
 		// turn this file into an empty block
-		LLVFSBlock *free_block = new LLVFSBlock(fileblock->mLocation, fileblock->mLength);
-		
-		addFreeBlock(free_block);
+		llassert(fileblock->mReaders == 0);
+		mFreeExtents.add(fileblock->mLocation, fileblock->mLength);
 	}
 	
 	fileblock->mLocation = 0;
@@ -1051,10 +1038,9 @@ void LLVFS::removeFile(const LLUUID &file_id, const LLAssetType::EType file_type
     lockData();
 	
 	LLVFSFileSpecifier spec(file_id, file_type);
-	fileblock_map::iterator it = mFileBlocks.find(spec);
-	if (it != mFileBlocks.end())
+	LLVFSFileBlock *block = waitForReaders(spec);
+	if (block)
 	{
-		LLVFSFileBlock *block = (*it).second;
 		removeFileBlock(block);
 	}
 	else
@@ -1077,7 +1063,7 @@ S32 LLVFS::getData(const LLUUID &file_id, const LLAssetType::EType file_type, U8
 	llassert(location >= 0);
 	llassert(length >= 0);
 
-	BOOL do_read = FALSE;
+	LLVFSFileBlock *read_block = NULL;
 	
     lockData();
 	
@@ -1100,17 +1086,25 @@ S32 LLVFS::getData(const LLUUID &file_id, const LLAssetType::EType file_type, U8
 				length = block->mSize - location;
 			}
 			location += block->mLocation;
-			do_read = TRUE;
+			// Hold the file's space in place while we read without the lock.
+			block->mReaders++;
+			read_block = block;
 		}
 	}
+	
+	unlockData();
 
-	if (do_read)
+	if (read_block)
 	{
-		fseek(mDataFP, location, SEEK_SET);
-		bytesread = (S32)fread(buffer, 1, length, mDataFP);
+		bytesread = readDataFile(location, buffer, length);
+
+		lockData();
+		if (--read_block->mReaders == 0)
+		{
+			mDataMutex->broadcast();
+		}
+		unlockData();
 	}
-	
-	unlockData();
 
 	return bytesread;
 }
@@ -1131,11 +1125,11 @@ S32 LLVFS::storeData(const LLUUID &file_id, const LLAssetType::EType file_type,
     lockData();
     
 	LLVFSFileSpecifier spec(file_id, file_type);
-	fileblock_map::iterator it = mFileBlocks.find(spec);
-	if (it != mFileBlocks.end())
+	// A getData() reading this file without the lock must not see a
+	// half written block.
+	LLVFSFileBlock *block = waitForReaders(spec);
+	if (block)
 	{
-		LLVFSFileBlock *block = (*it).second;
-
 		S32 in_loc = location;
 		if (location == -1)
 		{
@@ -1176,8 +1170,7 @@ S32 LLVFS::storeData(const LLUUID &file_id, const LLAssetType::EType file_type,
 			}
 			U32 file_location = location + block->mLocation;
 			
-			fseek(mDataFP, file_location, SEEK_SET);
-			S32 write_len = (S32)fwrite(buffer, 1, length, mDataFP);
+			S32 write_len = writeDataFile(file_location, buffer, length);
 			if (write_len != length)
 			{
 				llwarns << llformat("VFS Write Error: %d != %d",write_len,length) << llendl;
@@ -1274,181 +1267,69 @@ BOOL LLVFS::isLocked(const LLUUID &file_id, const LLAssetType::EType file_type,
 // protected
 //============================================================================
 
-void LLVFS::eraseBlockLength(LLVFSBlock *block)
+// mDataMutex must be LOCKED before calling this
+LLVFSFileBlock *LLVFS::waitForReaders(const LLVFSFileSpecifier &spec)
 {
-	// find the corresponding map entry in the length map and erase it
-	S32 length = block->mLength;
-	blocks_length_map_t::iterator iter = mFreeBlocksByLength.lower_bound(length);
-	blocks_length_map_t::iterator end = mFreeBlocksByLength.end();
-	bool found_block = false;
-	while(iter != end)
-	{
-		LLVFSBlock *tblock = iter->second;
-		llassert(tblock->mLength == length); // there had -better- be an entry with our length!
-		if (tblock == block)
+	while (true)
+	{
+		fileblock_map::iterator it = mFileBlocks.find(spec);
+		if (it == mFileBlocks.end())
 		{
-			mFreeBlocksByLength.erase(iter);
-			found_block = true;
-			break;
+			return NULL;
 		}
-		++iter;
-	}
-	if(!found_block)
-	{
-		llerrs << "eraseBlock could not find block" << llendl;
+		LLVFSFileBlock *block = (*it).second;
+		if (block->mReaders == 0)
+		{
+			return block;
+		}
+		// Releases mDataMutex until a reader lets go; anything may have
+		// changed by the time we get it back.
+		mDataMutex->wait();
 	}
 }
 
-
-// Remove block from both free lists (by location and by length).
-void LLVFS::eraseBlock(LLVFSBlock *block)
-{
-	eraseBlockLength(block);
-	// find the corresponding map entry in the location map and erase it	
-	U32 location = block->mLocation;
-	llverify(mFreeBlocksByLocation.erase(location) == 1); // we should only have one entry per location.
-}
-
-
-// Add the region specified by block location and length to the free lists.
-// Also incrementally defragment by merging with previous and next free blocks.
-void LLVFS::addFreeBlock(LLVFSBlock *block)
+// All data file I/O after the constructor goes through these two, so the
+// stdio buffer of mDataFP is never used and cannot go stale.
+S32 LLVFS::readDataFile(U32 location, U8 *buffer, S32 length)
 {
-#if LL_DEBUG
-	size_t dbgcount = mFreeBlocksByLocation.count(block->mLocation);
-	if(dbgcount > 0)
+#if LL_WINDOWS
+	LLMutexLock lock(mDataFileMutex);
+	fseek(mDataFP, location, SEEK_SET);
+	return (S32)fread(buffer, 1, length, mDataFP);
+#else
+	S32 total = 0;
+	while (total < length)
 	{
-		llerrs << "addFreeBlock called with block already in list" << llendl;
+		ssize_t nread = pread(fileno(mDataFP), buffer + total, length - total, (off_t)location + total);
+		if (nread <= 0)
+		{
+			break;
+		}
+		total += (S32)nread;
 	}
+	return total;
 #endif
-
-	// Get a pointer to the next free block (by location).
-	blocks_location_map_t::iterator next_free_it = mFreeBlocksByLocation.lower_bound(block->mLocation);
-
-	// We can merge with previous if it ends at our requested location.
-	LLVFSBlock* prev_block = NULL;
-	bool merge_prev = false;
-	if (next_free_it != mFreeBlocksByLocation.begin())
-	{
-		blocks_location_map_t::iterator prev_free_it = next_free_it;
-		--prev_free_it;
-		prev_block = prev_free_it->second;
-		merge_prev = (prev_block->mLocation + prev_block->mLength == block->mLocation);
-	}
-
-	// We can merge with next if our block ends at the next block's location.
-	LLVFSBlock* next_block = NULL;
-	bool merge_next = false;
-	if (next_free_it != mFreeBlocksByLocation.end())
-	{
-		next_block = next_free_it->second;
-		merge_next = (block->mLocation + block->mLength == next_block->mLocation);
-	}
-
-	if (merge_prev && merge_next)
-	{
-		// llinfos << "VFS merge BOTH" << llendl;
-		// Previous block is changing length (a lot), so only need to update length map.
-		// Next block is going away completely. JC
-		eraseBlockLength(prev_block);
-		eraseBlock(next_block);
-		prev_block->mLength += block->mLength + next_block->mLength;
-		mFreeBlocksByLength.insert(blocks_length_map_t::value_type(prev_block->mLength, prev_block));
-		delete block;
-		block = NULL;
-		delete next_block;
-		next_block = NULL;
-	}
-	else if (merge_prev)
-	{
-		// llinfos << "VFS merge previous" << llendl;
-		// Previous block is maintaining location, only changing length,
-		// therefore only need to update the length map. JC
-		eraseBlockLength(prev_block);
-		prev_block->mLength += block->mLength;
-		mFreeBlocksByLength.insert(blocks_length_map_t::value_type(prev_block->mLength, prev_block)); // multimap insert
-		delete block;
-		block = NULL;
-	}
-	else if (merge_next)
-	{
-		// llinfos << "VFS merge next" << llendl;
-		// Next block is changing both location and length,
-		// so both free lists must update. JC
-		eraseBlock(next_block);
-		next_block->mLocation = block->mLocation;
-		next_block->mLength += block->mLength;
-		// Don't hint here, next_free_it iterator may be invalid.
-		mFreeBlocksByLocation.insert(blocks_location_map_t::value_type(next_block->mLocation, next_block)); // multimap insert
-		mFreeBlocksByLength.insert(blocks_length_map_t::value_type(next_block->mLength, next_block)); // multimap insert			
-		delete block;
-		block = NULL;
-	}
-	else
-	{
-		// Can't merge with other free blocks.
-		// Hint that insert should go near next_free_it.
- 		mFreeBlocksByLocation.insert(next_free_it, blocks_location_map_t::value_type(block->mLocation, block)); // multimap insert
- 		mFreeBlocksByLength.insert(blocks_length_map_t::value_type(block->mLength, block)); // multimap insert
-	}
 }
 
-// Superceeded by new addFreeBlock which does incremental free space merging.
-// Incremental is faster overall.
-//void LLVFS::mergeFreeBlocks()
-//{
-// 	if (!isValid())
-// 	{
-// 		llerrs << "Attempting to use invalid VFS!" << llendl;
-// 	}
-// 	// TODO: could we optimize this with hints from the calling code?
-// 	blocks_location_map_t::iterator iter = mFreeBlocksByLocation.begin();	
-// 	blocks_location_map_t::iterator end = mFreeBlocksByLocation.end();	
-// 	LLVFSBlock *first_block = iter->second;
-// 	while(iter != end)
-// 	{
-// 		blocks_location_map_t::iterator first_iter = iter; // save for if we do a merge
-// 		if (++iter == end)
-// 			break;
-// 		LLVFSBlock *second_block = iter->second;
-// 		if (first_block->mLocation + first_block->mLength == second_block->mLocation)
-// 		{
-// 			// remove the first block from the length map
-// 			eraseBlockLength(first_block);
-// 			// merge first_block with second_block, since they're adjacent
-// 			first_block->mLength += second_block->mLength;
-// 			// add the first block to the length map (with the new size)
-// 			mFreeBlocksByLength.insert(blocks_length_map_t::value_type(first_block->mLength, first_block)); // multimap insert
-//
-// 			// erase and delete the second block
-// 			eraseBlock(second_block);
-// 			delete second_block;
-//
-// 			// reset iterator
-// 			iter = first_iter; // haven't changed first_block, so corresponding iterator is still valid
-// 			end = mFreeBlocksByLocation.end();
-// 		}
-// 		first_block = second_block;
-// 	}
-//}
-	
-// length bytes from free_block are going to be used (so they are no longer free)
-void LLVFS::useFreeSpace(LLVFSBlock *free_block, S32 length)
+S32 LLVFS::writeDataFile(U32 location, const U8 *buffer, S32 length)
 {
-	if (free_block->mLength == length)
-	{
-		eraseBlock(free_block);
-		delete free_block;
-	}
-	else
+#if LL_WINDOWS
+	LLMutexLock lock(mDataFileMutex);
+	fseek(mDataFP, location, SEEK_SET);
+	return (S32)fwrite(buffer, 1, length, mDataFP);
+#else
+	S32 total = 0;
+	while (total < length)
 	{
-		eraseBlock(free_block);
-  		
-		free_block->mLocation += length;
-		free_block->mLength -= length;
-
-		addFreeBlock(free_block);
+		ssize_t nwritten = pwrite(fileno(mDataFP), buffer + total, length - total, (off_t)location + total);
+		if (nwritten <= 0)
+		{
+			break;
+		}
+		total += (S32)nwritten;
 	}
+	return total;
+#endif
 }
 
 // NOTE! mDataMutex must be LOCKED before calling this
@@ -1536,14 +1417,14 @@ void LLVFS::sync(LLVFSFileBlock *block, BOOL remove)
 // mDataMutex must be LOCKED before calling this
 // Can initiate LRU-based file removal to make space.
 // The immune file block will not be removed.
-LLVFSBlock *LLVFS::findFreeBlock(S32 size, LLVFSFileBlock *immune)
+BOOL LLVFS::findFreeBlock(S32 size, U32 &location, LLVFSFileBlock *immune)
 {
 	if (!isValid())
 	{
 		llerrs << "Attempting to use invalid VFS!" << llendl;
 	}
 
-	LLVFSBlock *block = NULL;
+	BOOL found = FALSE;
 	BOOL have_lru_list = FALSE;
 	
 	typedef std::set<LLVFSFileBlock*, LLVFSFileBlock_less> lru_set;
@@ -1551,15 +1432,13 @@ LLVFSBlock *LLVFS::findFreeBlock(S32 size, LLVFSFileBlock *immune)
     
 	LLTimer timer;
 
-	while (! block)
+	while (! found)
 	{
 		// look for a suitable free block
-		blocks_length_map_t::iterator iter = mFreeBlocksByLength.lower_bound(size); // first entry >= size
-		if (iter != mFreeBlocksByLength.end())
-			block = iter->second;
+		found = mFreeExtents.findFit(size, location);
     	
 		// no large enough free blocks, time to clean out some junk
-		if (! block)
+		if (! found)
 		{
 			// create a list of files sorted by usage time
 			// this is far faster than sorting a linked list
@@ -1571,6 +1450,7 @@ LLVFSBlock *LLVFS::findFreeBlock(S32 size, LLVFSFileBlock *immune)
 
 					if (tmp != immune &&
 						tmp->mLength > 0 &&
+						! tmp->mReaders &&
 						! tmp->mLocks[VFSLOCK_READ] &&
 						! tmp->mLocks[VFSLOCK_APPEND] &&
 						! tmp->mLocks[VFSLOCK_OPEN])
@@ -1636,7 +1516,7 @@ LLVFSBlock *LLVFS::findFreeBlock(S32 size, LLVFSFileBlock *immune)
 		llwarns << "VFS: Spent " << time << " seconds in findFreeBlock!" << llendl;
 	}
 
-	return block;
+	return found;
 }
 
 //============================================================================
@@ -1653,15 +1533,12 @@ void LLVFS::pokeFiles()
 	
 	// only write data if we actually read 4 bytes
 	// otherwise we're writing garbage and screwing up the file
-	fseek(mDataFP, 0, SEEK_SET);
-	if (fread(&word, sizeof(word), 1, mDataFP) == 1)
+	if (readDataFile(0, (U8*)&word, sizeof(word)) == sizeof(word))
 	{
-		fseek(mDataFP, 0, SEEK_SET);
-		if (fwrite(&word, sizeof(word), 1, mDataFP) != 1)
+		if (writeDataFile(0, (U8*)&word, sizeof(word)) != sizeof(word))
 		{
 			llwarns << "Could not write to data file" << llendl;
 		}
-		fflush(mDataFP);
 	}
 
 	fseek(mIndexFP, 0, SEEK_SET);
@@ -1687,12 +1564,11 @@ void LLVFS::dumpMap()
 	}
     
 	llinfos << "Free Blocks:" << llendl;
-	for (blocks_location_map_t::iterator iter = mFreeBlocksByLocation.begin(),
-			 end = mFreeBlocksByLocation.end();
-		 iter != end; iter++)
+	const LLVFSExtentMap::extent_map_t& extents = mFreeExtents.getExtents();
+	for (LLVFSExtentMap::extent_map_t::const_iterator iter = extents.begin(), end = extents.end();
+		 iter != end; ++iter)
 	{
-		LLVFSBlock *free_block = iter->second;
-		llinfos << "Location: " << free_block->mLocation << "\tLength: " << free_block->mLength << llendl;
+		llinfos << "Location: " << iter->first << "\tLength: " << iter->second << llendl;
 	}
 }
     
@@ -1931,30 +1807,31 @@ void LLVFS::dumpStatistics()
 	S32 max_free_size = 0;
 	S32 total_free_size = 0;
 	std::map<S32, S32> free_length_counts;
-	for (blocks_location_map_t::iterator iter = mFreeBlocksByLocation.begin(),
-			 end = mFreeBlocksByLocation.end();
-		 iter != end; iter++)
+	const LLVFSExtentMap::extent_map_t& extents = mFreeExtents.getExtents();
+	for (LLVFSExtentMap::extent_map_t::const_iterator iter = extents.begin(), end = extents.end();
+		 iter != end; ++iter)
 	{
-		LLVFSBlock *free_block = iter->second;
-		if (free_block->mLength <= 0)
+		U32 free_location = iter->first;
+		S32 free_length = iter->second;
+		if (free_length <= 0)
 		{
-			llinfos << "Bad free block at: " << free_block->mLocation << "\tLength: " << free_block->mLength << llendl;
+			llinfos << "Bad free block at: " << free_location << "\tLength: " << free_length << llendl;
 		}
 		else
 		{
-			llinfos << "Block: " << free_block->mLocation
-					<< "\tLength: " << free_block->mLength
-					<< "\tEnd: " << free_block->mLocation + free_block->mLength
+			llinfos << "Block: " << free_location
+					<< "\tLength: " << free_length
+					<< "\tEnd: " << free_location + free_length
 					<< llendl;
-			total_free_size += free_block->mLength;
+			total_free_size += free_length;
 		}
 
-		if (free_block->mLength > max_free_size)
+		if (free_length > max_free_size)
 		{
-			max_free_size = free_block->mLength;
+			max_free_size = free_length;
 		}
 
-		free_length_counts[free_block->mLength]++;
+		free_length_counts[free_length]++;
 	}
 
 	// Dump histogram of free block sizes
@@ -1966,18 +1843,13 @@ void LLVFS::dumpStatistics()
 	llinfos << "Invalid blocks: " << invalid_file_count << llendl;
 	llinfos << "File blocks:    " << mFileBlocks.size() << llendl;
 
-	S32 length_list_count = (S32)mFreeBlocksByLength.size();
-	S32 location_list_count = (S32)mFreeBlocksByLocation.size();
-	if (length_list_count == location_list_count)
+	llinfos << "Free blocks:    " << mFreeExtents.getCount() << llendl;
+	if (total_free_size != mFreeExtents.getTotalFree())
 	{
-		llinfos << "Free list lengths match, free blocks: " << location_list_count << llendl;
-	}
-	else
-	{
-		llwarns << "Free list lengths do not match!" << llendl;
-		llwarns << "By length: " << length_list_count << llendl;
-		llwarns << "By location: " << location_list_count << llendl;
+		llwarns << "Free space total " << mFreeExtents.getTotalFree()
+				<< " does not match free blocks " << total_free_size << llendl;
 	}
+	llinfos << llformat("Fragmentation:  %.0f%%", mFreeExtents.getFragmentation() * 100.f) << llendl;
 	llinfos << "Max file: " << max_file_size/1024 << "K" << llendl;
 	llinfos << "Max free: " << max_free_size/1024 << "K" << llendl;
 	llinfos << "Total file size: " << total_file_size/1024 << "K" << llendl;
@@ -1994,26 +1866,23 @@ void LLVFS::dumpStatistics()
 				<< " Bytes: " << (iter->second.second>>20) << " MB" << llendl;
 	}
 	
-	// Look for potential merges 
-	{
- 		blocks_location_map_t::iterator iter = mFreeBlocksByLocation.begin();	
- 		blocks_location_map_t::iterator end = mFreeBlocksByLocation.end();	
- 		LLVFSBlock *first_block = iter->second;
- 		while(iter != end)
- 		{
- 			if (++iter == end)
- 				break;
- 			LLVFSBlock *second_block = iter->second;
- 			if (first_block->mLocation + first_block->mLength == second_block->mLocation)
- 			{
-				llinfos << "Potential merge at " << first_block->mLocation << llendl;
- 			}
- 			first_block = second_block;
- 		}
-	}
 	unlockData();
 }
 
+void LLVFS::getFreeSpaceStats(S32& free_bytes, S32& largest_extent, S32& extent_count)
+{
+	LLMutexLock lock(mDataMutex);
+	free_bytes = mFreeExtents.getTotalFree();
+	largest_extent = mFreeExtents.getLargest();
+	extent_count = mFreeExtents.getCount();
+}
+
+F32 LLVFS::getFragmentation()
+{
+	LLMutexLock lock(mDataMutex);
+	return mFreeExtents.getFragmentation();
+}
+
 // Debug Only!
 std::string get_extension(LLAssetType::EType type)
 {
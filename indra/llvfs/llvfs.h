@@ -28,10 +28,12 @@
 #define LL_LLVFS_H
 
 #include <deque>
+#include <boost/unordered_map.hpp>
 #include "lluuid.h"
 #include "linked_lists.h"
 #include "llassettype.h"
 #include "llthread.h"
+#include "llvfsextentmap.h"
 
 enum EVFSValid 
 {
@@ -69,6 +71,11 @@ public:
 	LLAssetType::EType mFileType;
 };
 
+struct LLVFSFileSpecifierHash
+{
+	size_t operator()(const LLVFSFileSpecifier &spec) const;
+};
+
 class LLVFS
 {
 private:
@@ -94,6 +101,8 @@ public:
 	EVFSValid getValidState() const	{ return mValid; }
 
 	// ---------- The following fucntions lock/unlock mDataMutex ----------
+	// getData() only holds it to look the file up; the read itself runs
+	// unlocked, so readers of different files do not wait on each other.
 	BOOL getExists(const LLUUID &file_id, const LLAssetType::EType file_type);
 	S32	 getSize(const LLUUID &file_id, const LLAssetType::EType file_type);
 
@@ -129,38 +138,47 @@ public:
 	void listFiles();
 	void dumpFiles();
 
+	// Free space, for stats. Fragmentation is 0 when all free space is
+	// one extent and approaches 1 as it splits up.
+	void getFreeSpaceStats(S32& free_bytes, S32& largest_extent, S32& extent_count);
+	F32 getFragmentation();
+
 protected:
 	void removeFileBlock(LLVFSFileBlock *fileblock);
+	// Waits until no getData() is reading the file, so its space can be
+	// moved or freed. Releases mDataMutex while waiting, so returns the
+	// file block looked up again (NULL if it went away).
+	LLVFSFileBlock *waitForReaders(const LLVFSFileSpecifier &spec);
 	
-	void eraseBlockLength(LLVFSBlock *block);
-	void eraseBlock(LLVFSBlock *block);
-	void addFreeBlock(LLVFSBlock *block);
-	//void mergeFreeBlocks();
-	void useFreeSpace(LLVFSBlock *free_block, S32 length);
 	void sync(LLVFSFileBlock *block, BOOL remove = FALSE);
 	void presizeDataFile(const U32 size);
 
+	// Positioned data file I/O, safe to call without mDataMutex.
+	S32 readDataFile(U32 location, U8 *buffer, S32 length);
+	S32 writeDataFile(U32 location, const U8 *buffer, S32 length);
+
 	static LLFILE *openAndLock(const std::string& filename, const char* mode, BOOL read_lock);
 	static void unlockAndClose(FILE *fp);
 	
 	// Can initiate LRU-based file removal to make space.
 	// The immune file block will not be removed.
-	LLVFSBlock *findFreeBlock(S32 size, LLVFSFileBlock *immune = NULL);
+	BOOL findFreeBlock(S32 size, U32 &location, LLVFSFileBlock *immune = NULL);
 
 	// lock/unlock data mutex (mDataMutex)
 	void lockData() { mDataMutex->lock(); }
 	void unlockData() { mDataMutex->unlock(); }	
 	
 protected:
-	LLMutex* mDataMutex;
+	// Guards the file table, free space and index file. Signalled when
+	// the last reader of a file lets go of it.
+	LLCondition* mDataMutex;
+	// Serializes seek + read/write where there is no positioned I/O.
+	LLMutex* mDataFileMutex;
 	
-	typedef std::map<LLVFSFileSpecifier, LLVFSFileBlock*> fileblock_map;
+	typedef boost::unordered_map<LLVFSFileSpecifier, LLVFSFileBlock*, LLVFSFileSpecifierHash> fileblock_map;
 	fileblock_map mFileBlocks;
 
-	typedef std::multimap<S32, LLVFSBlock*>	blocks_length_map_t;
-	blocks_length_map_t 	mFreeBlocksByLength;
-	typedef std::multimap<U32, LLVFSBlock*>	blocks_location_map_t;
-	blocks_location_map_t 	mFreeBlocksByLocation;
+	LLVFSExtentMap mFreeExtents;
 
 	LLFILE *mDataFP;
 	LLFILE *mIndexFP;
@@ -0,0 +1,160 @@
+/** 
+ * @file llvfsextentmap.cpp
+ * @brief Free space bookkeeping for LLVFS
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ * 
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ * 
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ * 
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "llvfsextentmap.h"
+
+LLVFSExtentMap::LLVFSExtentMap()
+:	mTotalFree(0)
+{
+}
+
+void LLVFSExtentMap::clear()
+{
+	mByLocation.clear();
+	mByLength.clear();
+	mTotalFree = 0;
+}
+
+void LLVFSExtentMap::insert(U32 location, S32 length)
+{
+	mByLocation[location] = length;
+	mByLength.insert(std::make_pair(length, location));
+	mTotalFree += length;
+}
+
+void LLVFSExtentMap::erase(extent_map_t::iterator iter)
+{
+	mByLength.erase(std::make_pair(iter->second, iter->first));
+	mTotalFree -= iter->second;
+	mByLocation.erase(iter);
+}
+
+void LLVFSExtentMap::add(U32 location, S32 length)
+{
+	if (length <= 0)
+	{
+		return;
+	}
+
+	extent_map_t::iterator next = mByLocation.lower_bound(location);
+	if (next != mByLocation.end() && next->first == location)
+	{
+		llerrs << "VFS: freeing extent at " << location << " twice" << llendl;
+		return;
+	}
+
+	// Merge with the extent ending at our location.
+	if (next != mByLocation.begin())
+	{
+		extent_map_t::iterator prev = next;
+		--prev;
+		if (prev->first + (U32)prev->second == location)
+		{
+			location = prev->first;
+			length += prev->second;
+			erase(prev);
+		}
+	}
+
+	// Merge with the extent starting at our end.
+	if (next != mByLocation.end() && location + (U32)length == next->first)
+	{
+		length += next->second;
+		erase(next);
+	}
+
+	insert(location, length);
+}
+
+void LLVFSExtentMap::use(U32 location, S32 length)
+{
+	extent_map_t::iterator iter = mByLocation.upper_bound(location);
+	if (iter == mByLocation.begin())
+	{
+		llerrs << "VFS: using space at " << location << " that is not free" << llendl;
+		return;
+	}
+	--iter;
+
+	U32 start = iter->first;
+	S32 extent_length = iter->second;
+	if (location + (U32)length > start + (U32)extent_length)
+	{
+		llerrs << "VFS: using " << length << " bytes at " << location
+			<< " overruns free extent " << start << "+" << extent_length << llendl;
+		return;
+	}
+
+	erase(iter);
+	if (location > start)
+	{
+		insert(start, (S32)(location - start));
+	}
+	U32 end = location + (U32)length;
+	U32 extent_end = start + (U32)extent_length;
+	if (extent_end > end)
+	{
+		insert(end, (S32)(extent_end - end));
+	}
+}
+
+BOOL LLVFSExtentMap::findFit(S32 length, U32& location) const
+{
+	length_set_t::const_iterator iter = mByLength.lower_bound(std::make_pair(length, (U32)0));
+	if (iter == mByLength.end())
+	{
+		return FALSE;
+	}
+	location = iter->second;
+	return TRUE;
+}
+
+BOOL LLVFSExtentMap::hasFit(S32 length) const
+{
+	return getLargest() >= length;
+}
+
+S32 LLVFSExtentMap::getLengthAt(U32 location) const
+{
+	extent_map_t::const_iterator iter = mByLocation.find(location);
+	return iter == mByLocation.end() ? 0 : iter->second;
+}
+
+S32 LLVFSExtentMap::getLargest() const
+{
+	return mByLength.empty() ? 0 : mByLength.rbegin()->first;
+}
+
+F32 LLVFSExtentMap::getFragmentation() const
+{
+	if (mTotalFree <= 0)
+	{
+		return 0.f;
+	}
+	return 1.f - (F32)getLargest() / (F32)mTotalFree;
+}
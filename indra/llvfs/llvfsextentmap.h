@@ -0,0 +1,89 @@
+/** 
+ * @file llvfsextentmap.h
+ * @brief Free space bookkeeping for LLVFS
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ * 
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ * 
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ * 
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLVFSEXTENTMAP_H
+#define LL_LLVFSEXTENTMAP_H
+
+#include <map>
+#include <set>
+
+/**
+ * @class LLVFSExtentMap
+ * @brief The free extents of a VFS data file.
+ *
+ * Extents are kept in a tree by location, so neighbours merge as they
+ * are freed, and in a tree by (length, location) so allocation is a
+ * best fit lookup. Both are O(log n), including removal of an extent
+ * of a common length.
+ *
+ * Not thread safe, LLVFS guards it with its data mutex.
+ */
+class LLVFSExtentMap
+{
+public:
+	typedef std::map<U32, S32> extent_map_t;
+
+	LLVFSExtentMap();
+
+	void clear();
+
+	// Frees [location, location + length), merging with neighbours.
+	void add(U32 location, S32 length);
+
+	// Marks [location, location + length) as used. The range must lie
+	// inside a single free extent.
+	void use(U32 location, S32 length);
+
+	// Finds the smallest extent that holds length bytes, lowest location
+	// first among equals. Returns FALSE if there is none.
+	BOOL findFit(S32 length, U32& location) const;
+	BOOL hasFit(S32 length) const;
+
+	// Length of the free extent starting exactly at location, or 0.
+	S32 getLengthAt(U32 location) const;
+
+	const extent_map_t& getExtents() const { return mByLocation; }
+	S32 getCount() const { return (S32)mByLocation.size(); }
+	S32 getTotalFree() const { return mTotalFree; }
+	S32 getLargest() const;
+
+	// 0 when all free space is one extent, approaching 1 as it is
+	// split into many small ones.
+	F32 getFragmentation() const;
+
+private:
+	void insert(U32 location, S32 length);
+	void erase(extent_map_t::iterator iter);
+
+private:
+	typedef std::set<std::pair<S32, U32> > length_set_t;
+
+	extent_map_t mByLocation;
+	length_set_t mByLength;
+	S32 mTotalFree;
+};
+
+#endif // LL_LLVFSEXTENTMAP_H
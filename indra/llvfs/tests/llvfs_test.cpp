@@ -0,0 +1,388 @@
+/**
+ * @file llvfs_test.cpp
+ * @date   2010-11
+ * @brief  Test the LLVFS file table, free space and concurrent access.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ * 
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ * 
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ * 
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "../llvfs.h"
+#include "../llvfsextentmap.h"
+
+#include "llfile.h"
+#include "llformat.h"
+#include "llthread.h"
+#include "lltimer.h"
+
+#include "../test/lltut.h"
+
+namespace
+{
+	const U32 VFS_SIZE = 2 * 1024 * 1024;
+	const S32 WRITER_FILES = 400;
+	const S32 READER_READS = 3000;
+
+	U32 seedOf(const LLUUID& id)
+	{
+		U32 n;
+		memcpy(&n, id.mData, sizeof(n));
+		return n;
+	}
+
+	// Every file's contents follow from its ID, so a reader can tell
+	// when it got another file's bytes.
+	U8 patternByte(U32 seed, S32 offset)
+	{
+		return (U8)(seed * 31 + offset * 7 + (offset >> 8));
+	}
+
+	U32 nextRandom(U32& state)
+	{
+		state = state * 1664525 + 1013904223;
+		return state >> 8;
+	}
+
+	// The IDs written so far, shared between the test threads.
+	class FileList
+	{
+	public:
+		FileList() : mMutex(new LLMutex(NULL)) {}
+		~FileList() { delete mMutex; }
+
+		void add(const LLUUID& id)
+		{
+			LLMutexLock lock(mMutex);
+			mIDs.push_back(id);
+		}
+		// Picks one of the newest files, which are the likeliest to
+		// still be there.
+		bool pick(U32& state, LLUUID& id)
+		{
+			LLMutexLock lock(mMutex);
+			if (mIDs.empty())
+			{
+				return false;
+			}
+			size_t recent = llmin(mIDs.size(), (size_t)32);
+			id = mIDs[mIDs.size() - 1 - nextRandom(state) % recent];
+			return true;
+		}
+		std::vector<LLUUID> get()
+		{
+			LLMutexLock lock(mMutex);
+			return mIDs;
+		}
+
+	private:
+		LLMutex* mMutex;
+		std::vector<LLUUID> mIDs;
+	};
+
+	// Writes new files, grows some (which moves them), removes some, and
+	// overfills the VFS so older files get evicted.
+	class WriterThread : public LLThread
+	{
+	public:
+		WriterThread(LLVFS* vfs, FileList* files, U32 first_seed)
+			: LLThread("vfs test writer"), mVFS(vfs), mFiles(files), mSeed(first_seed), mWritten(0)
+		{}
+
+		S32 mWritten;
+
+	protected:
+		void run()
+		{
+			U32 state = mSeed;
+			std::vector<U8> buffer;
+			for (S32 i = 0; i < WRITER_FILES; ++i)
+			{
+				// Named rather than generated, LLUUID::generate() is not
+				// safe to call from several threads.
+				LLUUID id;
+				id.generate(llformat("llvfs_test %u", mSeed + i));
+				S32 size = 4096 + (S32)(nextRandom(state) % 60000);
+				buffer.resize(size);
+				for (S32 j = 0; j < size; ++j)
+				{
+					buffer[j] = patternByte(seedOf(id), j);
+				}
+				if (!mVFS->setMaxSize(id, LLAssetType::AT_SOUND, size))
+				{
+					continue;
+				}
+				if (mVFS->storeData(id, LLAssetType::AT_SOUND, &buffer[0], 0, size) == size)
+				{
+					++mWritten;
+				}
+				mFiles->add(id);
+
+				U32 action = nextRandom(state) % 8;
+				LLUUID other;
+				if (action == 0 && mFiles->pick(state, other))
+				{
+					if (mVFS->getExists(other, LLAssetType::AT_SOUND))
+					{
+						mVFS->removeFile(other, LLAssetType::AT_SOUND);
+					}
+				}
+				else if (action == 1 && mFiles->pick(state, other))
+				{
+					S32 max_size = mVFS->getMaxSize(other, LLAssetType::AT_SOUND);
+					if (max_size > 0)
+					{
+						mVFS->setMaxSize(other, LLAssetType::AT_SOUND, max_size + 70000);
+					}
+				}
+			}
+		}
+
+	private:
+		LLVFS* mVFS;
+		FileList* mFiles;
+		U32 mSeed;
+	};
+
+	class ReaderThread : public LLThread
+	{
+	public:
+		ReaderThread(LLVFS* vfs, FileList* files, U32 seed)
+			: LLThread("vfs test reader"), mVFS(vfs), mFiles(files), mSeed(seed),
+			  mVerified(0), mCorrupt(0)
+		{}
+
+		S32 mVerified;
+		S32 mCorrupt;
+
+	protected:
+		void run()
+		{
+			U32 state = mSeed;
+			std::vector<U8> buffer(70000);
+			for (S32 i = 0; i < READER_READS; ++i)
+			{
+				LLUUID id;
+				if (!mFiles->pick(state, id))
+				{
+					ms_sleep(1);
+					continue;
+				}
+				if (mVFS->getSize(id, LLAssetType::AT_SOUND) <= 0)
+				{
+					// Evicted or removed.
+					continue;
+				}
+				S32 offset = (S32)(nextRandom(state) % 4096);
+				S32 length = mVFS->getData(id, LLAssetType::AT_SOUND, &buffer[0], offset, (S32)buffer.size());
+				bool good = true;
+				for (S32 j = 0; j < length; ++j)
+				{
+					if (buffer[j] != patternByte(seedOf(id), offset + j))
+					{
+						good = false;
+						break;
+					}
+				}
+				if (!good)
+				{
+					++mCorrupt;
+				}
+				else if (length > 0)
+				{
+					++mVerified;
+				}
+			}
+		}
+
+	private:
+		LLVFS* mVFS;
+		FileList* mFiles;
+		U32 mSeed;
+	};
+
+	void waitForThread(LLThread* thread)
+	{
+		while (!thread->isStopped())
+		{
+			ms_sleep(10);
+		}
+	}
+}
+
+namespace tut
+{
+	struct vfs_data
+	{
+		vfs_data()
+		{
+			mIndexFilename = std::string(LLFile::tmpdir()) + "llvfs_test.index";
+			mDataFilename = std::string(LLFile::tmpdir()) + "llvfs_test.data";
+			LLFile::remove(mIndexFilename);
+			LLFile::remove(mDataFilename);
+			mVFS = LLVFS::createLLVFS(mIndexFilename, mDataFilename, FALSE, VFS_SIZE, FALSE);
+		}
+		~vfs_data()
+		{
+			delete mVFS;
+			LLFile::remove(mIndexFilename);
+			LLFile::remove(mDataFilename);
+		}
+
+		std::string mIndexFilename;
+		std::string mDataFilename;
+		LLVFS* mVFS;
+	};
+	typedef test_group<vfs_data> vfs_test;
+	typedef vfs_test::object vfs_object;
+	tut::vfs_test vfs_testcase("LLVFS");
+
+	template<> template<>
+	void vfs_object::test<1>()
+	{
+		set_test_name("extent map");
+		LLVFSExtentMap extents;
+		extents.add(0, 1000);
+		ensure_equals("one extent", extents.getCount(), 1);
+		ensure_equals("not fragmented", extents.getFragmentation(), 0.f);
+
+		extents.use(100, 100);
+		extents.use(500, 100);
+		ensure_equals("split in three", extents.getCount(), 3);
+		ensure_equals("free", extents.getTotalFree(), 800);
+		ensure_equals("largest", extents.getLargest(), 400);
+		ensure("fragmented", extents.getFragmentation() > 0.4f);
+
+		U32 location = 0;
+		ensure("best fit", extents.findFit(150, location));
+		ensure_equals("smallest extent that fits", location, 200U);
+		ensure("too large", !extents.findFit(401, location));
+		ensure_equals("length at", extents.getLengthAt(600), 400);
+		ensure_equals("no extent there", extents.getLengthAt(601), 0);
+
+		// Freeing the holes merges everything back.
+		extents.add(500, 100);
+		extents.add(100, 100);
+		ensure_equals("merged", extents.getCount(), 1);
+		ensure_equals("all free", extents.getLargest(), 1000);
+	}
+
+	template<> template<>
+	void vfs_object::test<2>()
+	{
+		set_test_name("files and free space");
+		ensure("valid", mVFS && mVFS->isValid());
+		LLUUID a;
+		LLUUID b;
+		a.generate();
+		b.generate();
+		const U8 data[] = "some asset data";
+
+		ensure("create a", mVFS->setMaxSize(a, LLAssetType::AT_SOUND, 3000));
+		ensure("create b", mVFS->setMaxSize(b, LLAssetType::AT_SOUND, 1024));
+		ensure_equals("rounded to blocks", mVFS->getMaxSize(a, LLAssetType::AT_SOUND), 3072);
+		ensure_equals("store", mVFS->storeData(a, LLAssetType::AT_SOUND, data, 0, sizeof(data)), (S32)sizeof(data));
+		ensure("types are separate files", !mVFS->getExists(a, LLAssetType::AT_TEXTURE));
+
+		S32 free_bytes, largest, count;
+		mVFS->getFreeSpaceStats(free_bytes, largest, count);
+		ensure_equals("free space", free_bytes, (S32)VFS_SIZE - 3072 - 1024);
+
+		// Removing a leaves a hole in front of b.
+		mVFS->removeFile(a, LLAssetType::AT_SOUND);
+		mVFS->getFreeSpaceStats(free_bytes, largest, count);
+		ensure_equals("two extents", count, 2);
+		ensure("fragmented", mVFS->getFragmentation() > 0.f);
+
+		// Growing b in place takes the free space right after it.
+		ensure("grow", mVFS->setMaxSize(b, LLAssetType::AT_SOUND, 4096));
+		ensure("a is gone", !mVFS->getExists(a, LLAssetType::AT_SOUND));
+		mVFS->renameFile(b, LLAssetType::AT_SOUND, a, LLAssetType::AT_SOUND);
+		ensure("renamed", mVFS->getExists(a, LLAssetType::AT_SOUND));
+		ensure("old name gone", !mVFS->getExists(b, LLAssetType::AT_SOUND));
+		mVFS->removeFile(a, LLAssetType::AT_SOUND);
+		ensure_equals("all free", mVFS->getFragmentation(), 0.f);
+	}
+
+	template<> template<>
+	void vfs_object::test<3>()
+	{
+		set_test_name("concurrent read, write and eviction");
+		ensure("valid", mVFS && mVFS->isValid());
+		FileList files;
+
+		const S32 WRITERS = 2;
+		const S32 READERS = 4;
+		WriterThread* writers[WRITERS];
+		ReaderThread* readers[READERS];
+		for (S32 i = 0; i < WRITERS; ++i)
+		{
+			writers[i] = new WriterThread(mVFS, &files, 1000 + i * 100000);
+			writers[i]->start();
+		}
+		for (S32 i = 0; i < READERS; ++i)
+		{
+			readers[i] = new ReaderThread(mVFS, &files, 7 + i);
+			readers[i]->start();
+		}
+
+		S32 written = 0;
+		S32 verified = 0;
+		S32 corrupt = 0;
+		for (S32 i = 0; i < WRITERS; ++i)
+		{
+			waitForThread(writers[i]);
+			written += writers[i]->mWritten;
+			delete writers[i];
+		}
+		for (S32 i = 0; i < READERS; ++i)
+		{
+			waitForThread(readers[i]);
+			verified += readers[i]->mVerified;
+			corrupt += readers[i]->mCorrupt;
+			delete readers[i];
+		}
+
+		ensure_equals("no reads saw another file's data", corrupt, 0);
+		ensure("reads were checked", verified > 0);
+		ensure("files were written", written > 0);
+
+		// Far more was written than fits, so the rest was evicted, and
+		// every byte is either free or in exactly one file.
+		std::vector<LLUUID> ids = files.get();
+		S32 used = 0;
+		S32 live = 0;
+		for (size_t i = 0; i < ids.size(); ++i)
+		{
+			S32 max_size = mVFS->getMaxSize(ids[i], LLAssetType::AT_SOUND);
+			if (max_size > 0)
+			{
+				used += max_size;
+				++live;
+			}
+		}
+		ensure("files were evicted", live < (S32)ids.size());
+		S32 free_bytes, largest, count;
+		mVFS->getFreeSpaceStats(free_bytes, largest, count);
+		ensure_equals("space adds up", used + free_bytes, (S32)VFS_SIZE);
+	}
+}
@@ -45,6 +45,8 @@
 #include "llviewerstats.h"
 #include "llmd5.h"
 #include "llpumpio.h"
+#include "llpumpiothread.h"
+#include "llhttpscheduler.h"
 #include "llmimetypes.h"
 #include "llslurl.h"
 #include "llstartup.h"
@@ -53,6 +55,7 @@
 #include "llallocator.h"
 #include "llares.h" 
 #include "llcurl.h"
+#include "llthrottle.h"
 #include "lltexturestats.h"
 #include "lltexturestats.h"
 #include "llviewerwindow.h"
@@ -164,12 +167,14 @@
 #include "llsurface.h"
 #include "llvosky.h"
 #include "llvotree.h"
+#include "llvlcomposition.h"
 #include "llvoavatar.h"
 #include "llfolderview.h"
 #include "llagentpilot.h"
 #include "llvovolume.h"
 #include "llflexibleobject.h" 
 #include "llvosurfacepatch.h"
+#include "llviewerjointmesh_avx2.h"
 #include "llviewerfloaterreg.h"
 #include "llcommandlineparser.h"
 #include "llfloatermemleak.h"
@@ -255,6 +260,7 @@ LLSD gDebugInfo;
 U32	gFrameCount = 0;
 U32 gForegroundFrameCount = 0; // number of frames that app window was in foreground
 LLPumpIO* gServicePump = NULL;
+LLPumpIOThread* gHTTPPumpThread = NULL;
 
 U64 gFrameTime = 0;
 F32 gFrameTimeSeconds = 0.f;
@@ -481,6 +487,12 @@ static void settings_modify()
 		gSavedSettings.setU32("VectorizeProcessor", 0 );
 	}
 	else
+	if (gSysCPU.hasAVX2() && ll_has_skin_vertices_avx2())
+	{
+		gSavedSettings.setBOOL("VectorizeEnable", TRUE );
+		gSavedSettings.setU32("VectorizeProcessor", 3 );
+	}
+	else
 	if (gSysCPU.hasSSE2())
 	{
 		gSavedSettings.setBOOL("VectorizeEnable", TRUE );
@@ -959,6 +971,7 @@ static LLFastTimer::DeclareTimer FTM_TEXTURE_CACHE("Texture Cache");
 static LLFastTimer::DeclareTimer FTM_DECODE("Image Decode");
 static LLFastTimer::DeclareTimer FTM_VFS("VFS Thread");
 static LLFastTimer::DeclareTimer FTM_LFS("LFS Thread");
+static LLFastTimer::DeclareTimer FTM_TERRAIN_COMPOSITION("Terrain Composition");
 static LLFastTimer::DeclareTimer FTM_PAUSE_THREADS("Pause Threads");
 static LLFastTimer::DeclareTimer FTM_IDLE("Idle");
 static LLFastTimer::DeclareTimer FTM_PUMP("Pump");
@@ -979,8 +992,22 @@ bool LLAppViewer::mainLoop()
 
 	// Create IO Pump to use for HTTP Requests.
 	gServicePump = new LLPumpIO(gAPRPoolp);
-	LLHTTPClient::setPump(*gServicePump);
+	if (gSavedSettings.getBOOL("HTTPPumpThread"))
+	{
+		// Capability traffic runs on its own thread so it is not bound
+		// to the frame rate. Responders still complete in the main loop.
+		gHTTPPumpThread = new LLPumpIOThread("HTTP pump");
+		gHTTPPumpThread->start();
+		LLHTTPClient::setPump(*gHTTPPumpThread->getPump());
+	}
+	else
+	{
+		LLHTTPClient::setPump(*gServicePump);
+	}
 	LLCurl::setCAFile(gDirUtilp->getCAFile());
+	LLCurl::setMaxConnectionsPerHost(gSavedSettings.getU32("HTTPMaxConnectionsPerHost"));
+	LLCurl::setPipelining(gSavedSettings.getBOOL("HTTPPipelining"));
+	LLThrottleGroup::setCongestionControlDefault(gSavedSettings.getBOOL("ThrottleCongestionControl"));
 	
 	// Note: this is where gLocalSpeakerMgr and gActiveSpeakerMgr used to be instantiated.
 
@@ -1111,6 +1138,10 @@ bool LLAppViewer::mainLoop()
 							{
 								LLFastTimer t(FTM_SERVICE_CALLBACK);
 								gServicePump->callback();
+								if (gHTTPPumpThread)
+								{
+									gHTTPPumpThread->callback();
+								}
 							}
 						}
 					}
@@ -1190,6 +1221,10 @@ bool LLAppViewer::mainLoop()
 				bool is_slow = (frameTimer.getElapsedTimeF64() > FRAME_SLOW_THRESHOLD) ;
 				S32 total_work_pending = 0;
 				S32 total_io_pending = 0;				
+				{
+					LLFastTimer ftm(FTM_TERRAIN_COMPOSITION);
+					LLVLComposition::updateClass(1); // composites on this thread when threads are disabled
+				}
 				while(!is_slow)//do not unpause threads if the frame rates are very low.
 				{
 					S32 work_pending = 0;
@@ -1307,6 +1342,8 @@ bool LLAppViewer::mainLoop()
 		}
 	}
 	
+	delete gHTTPPumpThread;
+	gHTTPPumpThread = NULL;
 	delete gServicePump;
 
 	destroyMainloopTimeout();
@@ -1653,6 +1690,7 @@ bool LLAppViewer::cleanup()
     sTextureFetch = NULL;
 	delete sImageDecodeThread;
     sImageDecodeThread = NULL;
+	LLVLComposition::cleanupClass();
 	delete mFastTimerLogThread;
 	mFastTimerLogThread = NULL;
 	
@@ -1772,11 +1810,16 @@ bool LLAppViewer::initThreads()
 	LLVFSThread::initClass(enable_threads && false);
 	LLLFSThread::initClass(enable_threads && false);
 
+	// The texture fetcher uses the HTTP scheduler from its own thread,
+	// create it here first. Its limits are set up with the other settings.
+	LLHTTPScheduler::getInstance();
+
 	// Image decoding
 	LLAppViewer::sImageDecodeThread = new LLImageDecodeThread(enable_threads && true);
 	LLAppViewer::sTextureCache = new LLTextureCache(enable_threads && true);
 	LLAppViewer::sTextureFetch = new LLTextureFetch(LLAppViewer::getTextureCache(), sImageDecodeThread, enable_threads && true);
 	LLImage::initClass();
+	LLVLComposition::initClass(enable_threads && true);
 
 	if (LLFastTimer::sLog || LLFastTimer::sMetricLog)
 	{
@@ -3203,7 +3246,7 @@ U32 LLAppViewer::getObjectCacheVersion()
 {
 	// Viewer object cache version, change if object update
 	// format changes. JC
-	const U32 INDRA_OBJECT_CACHE_VERSION = 14;
+	const U32 INDRA_OBJECT_CACHE_VERSION = 15;
 
 	return INDRA_OBJECT_CACHE_VERSION;
 }
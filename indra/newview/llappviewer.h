@@ -35,6 +35,7 @@
 class LLCommandLineParser;
 class LLFrameTimer;
 class LLPumpIO;
+class LLPumpIOThread;
 class LLTextureCache;
 class LLImageDecodeThread;
 class LLTextureFetch;
@@ -311,6 +312,7 @@ extern U32 gFrameCount;
 extern U32 gForegroundFrameCount;
 
 extern LLPumpIO* gServicePump;
+extern LLPumpIOThread* gHTTPPumpThread; // NULL unless HTTPPumpThread is set
 
 extern U64      gFrameTime;					// The timestamp of the most-recently-processed frame
 extern F32		gFrameTimeSeconds;			// Loses msec precision after ~4.5 hours...
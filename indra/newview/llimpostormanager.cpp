@@ -0,0 +1,229 @@
+/**
+ * @file llimpostormanager.cpp
+ * @brief Memory budget for avatar impostors
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "llviewerprecompiledheaders.h"
+
+#include "llimpostormanager.h"
+
+#include "llrendertarget.h"
+#include "llviewercontrol.h"
+#include "lldrawable.h"
+#include "pipeline.h"
+
+namespace
+{
+	U32 impostor_target_bytes(U32 width, U32 height)
+	{
+		// colour and depth/stencil, plus the two deferred attachments
+		U32 buffers = LLPipeline::sRenderDeferred ? 4 : 2;
+		return width * height * 4 * buffers;
+	}
+}
+
+LLImpostorManager::LLImpostorManager()
+:	mMemoryUsage(0),
+	mNumEvictions(0)
+{
+}
+
+LLImpostorManager::~LLImpostorManager()
+{
+	releaseAll();
+}
+
+LLRenderTarget* LLImpostorManager::allocateTarget(LLImpostorOwner* avatar, U32 width, U32 height)
+{
+	U32 frame = (U32) LLDrawable::getCurrentFrame();
+	S32 index = findTarget(avatar);
+	if (index >= 0)
+	{
+		ImpostorTarget& target = mTargets[index];
+		if (target.mWidth == width && target.mHeight == height)
+		{
+			target.mLastAllocated = frame;
+			return target.mTarget;
+		}
+		// wrong size, hand it back and look for a better fit
+		unassign(target);
+	}
+
+	U32 bytes = impostor_target_bytes(width, height);
+	S32 reuse = -1;
+	if (!makeRoom(bytes, width, height, avatar, reuse))
+	{
+		return NULL;
+	}
+
+	if (reuse < 0)
+	{
+		ImpostorTarget target;
+		target.mTarget = new LLRenderTarget();
+		target.mOwner = NULL;
+		target.mWidth = width;
+		target.mHeight = height;
+		target.mBytes = bytes;
+		target.mLastAllocated = frame;
+		mTargets.push_back(target);
+		mMemoryUsage += bytes;
+		reuse = (S32) mTargets.size() - 1;
+	}
+
+	ImpostorTarget& target = mTargets[reuse];
+	target.mOwner = avatar;
+	target.mLastAllocated = frame;
+	avatar->mImpostor = target.mTarget;
+	return target.mTarget;
+}
+
+void LLImpostorManager::releaseTarget(LLImpostorOwner* avatar)
+{
+	S32 index = findTarget(avatar);
+	if (index >= 0)
+	{
+		unassign(mTargets[index]);
+	}
+}
+
+void LLImpostorManager::releaseAll()
+{
+	while (!mTargets.empty())
+	{
+		deleteTarget((S32) mTargets.size() - 1);
+	}
+	llassert(mMemoryUsage == 0);
+	mMemoryUsage = 0;
+}
+
+U32 LLImpostorManager::getAndResetEvictions()
+{
+	U32 evictions = mNumEvictions;
+	mNumEvictions = 0;
+	return evictions;
+}
+
+S32 LLImpostorManager::findTarget(LLImpostorOwner* avatar) const
+{
+	for (S32 i = 0; i < (S32) mTargets.size(); i++)
+	{
+		if (mTargets[i].mOwner == avatar)
+		{
+			return i;
+		}
+	}
+	return -1;
+}
+
+void LLImpostorManager::unassign(ImpostorTarget& target)
+{
+	if (target.mOwner)
+	{
+		target.mOwner->mImpostor = NULL;
+		target.mOwner->mNeedsImpostorUpdate = TRUE;
+		target.mOwner = NULL;
+	}
+}
+
+void LLImpostorManager::deleteTarget(S32 index)
+{
+	ImpostorTarget& target = mTargets[index];
+	unassign(target);
+	mMemoryUsage -= target.mBytes;
+	delete target.mTarget;
+
+	mTargets[index] = mTargets.back();
+	mTargets.pop_back();
+}
+
+// Finds space for a target of the given size, returning FALSE if only
+// impostors that are still on screen could give it up. A free target of the
+// right size is returned in reuse, -1 means a new one has to be made.
+BOOL LLImpostorManager::makeRoom(U32 bytes, U32 width, U32 height, LLImpostorOwner* avatar, S32& reuse)
+{
+	static LLCachedControl<U32> max_memory(gSavedSettings, "RenderImpostorMemory");
+	const U64 budget = (U64) max_memory * 1024 * 1024;
+
+	reuse = -1;
+	for (S32 i = 0; i < (S32) mTargets.size(); i++)
+	{
+		const ImpostorTarget& target = mTargets[i];
+		if (!target.mOwner && target.mWidth == width && target.mHeight == height)
+		{
+			reuse = i;
+			return TRUE;
+		}
+	}
+
+	// free targets of other sizes go first
+	for (S32 i = (S32) mTargets.size() - 1; i >= 0 && mMemoryUsage + bytes > budget; i--)
+	{
+		if (!mTargets[i].mOwner)
+		{
+			deleteTarget(i);
+		}
+	}
+
+	// then the impostors that have gone longest without being drawn. Those
+	// drawn last frame are still on screen, and those handed out this frame
+	// or last have not been drawn yet.
+	U32 frame = (U32) LLDrawable::getCurrentFrame();
+	U32 visible_frame = frame > 0 ? frame - 1 : 0;
+	while (mMemoryUsage + bytes > budget && !mTargets.empty())
+	{
+		S32 oldest = -1;
+		U32 oldest_frame = visible_frame;
+		for (S32 i = 0; i < (S32) mTargets.size(); i++)
+		{
+			const ImpostorTarget& target = mTargets[i];
+			if (!target.mOwner || target.mOwner == avatar)
+			{
+				continue;
+			}
+			U32 last_used = llmax(target.mOwner->getImpostorLastDrawn(), target.mLastAllocated);
+			if (last_used < oldest_frame)
+			{
+				oldest = i;
+				oldest_frame = last_used;
+			}
+		}
+
+		if (oldest < 0)
+		{
+			// only visible impostors left
+			return FALSE;
+		}
+
+		mNumEvictions++;
+		if (mTargets[oldest].mWidth == width && mTargets[oldest].mHeight == height)
+		{
+			unassign(mTargets[oldest]);
+			reuse = oldest;
+			return TRUE;
+		}
+		deleteTarget(oldest);
+	}
+
+	return TRUE;
+}
@@ -0,0 +1,119 @@
+/**
+ * @file llimpostormanager.h
+ * @brief Memory budget for avatar impostors
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLIMPOSTORMANAGER_H
+#define LL_LLIMPOSTORMANAGER_H
+
+#include <vector>
+
+#include "llsingleton.h"
+
+class LLRenderTarget;
+
+/**
+ * @class LLImpostorOwner
+ * @brief The part of an avatar that LLImpostorManager looks after.
+ */
+class LLImpostorOwner
+{
+public:
+	LLImpostorOwner() : mImpostor(NULL), mNeedsImpostorUpdate(TRUE), mImpostorLastDrawn(0) {}
+
+	U32			getImpostorLastDrawn() const { return mImpostorLastDrawn; }
+
+	LLRenderTarget* mImpostor;	// owned by LLImpostorManager, NULL when it has none to spare
+	BOOL		mNeedsImpostorUpdate;
+protected:
+	U32			mImpostorLastDrawn;	// frame the impostor was last drawn
+};
+
+/**
+ * @class LLImpostorManager
+ * @brief Owns the render targets of avatar impostors.
+ *
+ * Targets count against RenderImpostorMemory. A target that no longer
+ * fits the size an avatar needs goes back to a free list for reuse.
+ * When the budget is used up, the free list is trimmed first, then the
+ * impostor drawn least recently gives up its target. Targets drawn last
+ * frame or handed out this frame are never taken. An avatar whose
+ * impostor is not ready is drawn in full, see LLVOAvatar::isImpostor().
+ *
+ * Which impostors get regenerated each frame is up to
+ * LLVOAvatar::updateImpostors().
+ *
+ * Main thread only, like the rest of the render pipeline.
+ */
+class LLImpostorManager : public LLSingleton<LLImpostorManager>
+{
+	LOG_CLASS(LLImpostorManager);
+public:
+	LLImpostorManager();
+	~LLImpostorManager();
+
+	/**
+	 * @brief Gets a render target for an avatar's impostor.
+	 *
+	 * Allocates one if needed, which also makes it the avatar's
+	 * impostor target.
+	 *
+	 * @return NULL if the memory budget is taken by impostors drawn this
+	 * frame.
+	 */
+	LLRenderTarget* allocateTarget(LLImpostorOwner* avatar, U32 width, U32 height);
+
+	/// Takes back an avatar's target, the avatar is drawn in full again.
+	void releaseTarget(LLImpostorOwner* avatar);
+
+	/// Deletes every target, e.g. when the GL context goes away.
+	void releaseAll();
+
+	S32 getNumTargets() const { return (S32)mTargets.size(); }
+	U64 getMemoryUsage() const { return mMemoryUsage; }
+	U32 getAndResetEvictions();
+
+private:
+	struct ImpostorTarget
+	{
+		LLRenderTarget*	mTarget;
+		LLImpostorOwner* mOwner;	// NULL while on the free list
+		U32				mWidth;
+		U32				mHeight;
+		U32				mBytes;
+		U32				mLastAllocated;	// frame it was last handed out
+	};
+	typedef std::vector<ImpostorTarget> target_list_t;
+
+	S32 findTarget(LLImpostorOwner* avatar) const;
+	void unassign(ImpostorTarget& target);
+	void deleteTarget(S32 index);
+	BOOL makeRoom(U32 bytes, U32 width, U32 height, LLImpostorOwner* avatar, S32& reuse);
+
+	target_list_t	mTargets;
+	U64				mMemoryUsage;	// bytes, estimated from the formats
+	U32				mNumEvictions;	// taken from drawn impostors
+};
+
+#endif // LL_LLIMPOSTORMANAGER_H
@@ -30,6 +30,7 @@
 #include "llagent.h"
 #include "llappviewer.h"
 #include "llcallbacklist.h"
+#include "llhttpscheduler.h"
 #include "llinventorypanel.h"
 #include "llviewercontrol.h"
 #include "llviewermessage.h"
@@ -324,9 +325,10 @@ void LLInventoryModelBackgroundFetch::incrBulkFetch(S16 fetching)
 class LLInventoryModelFetchDescendentsResponder: public LLHTTPClient::Responder
 {
 public:
-	LLInventoryModelFetchDescendentsResponder(const LLSD& request_sd, uuid_vec_t recursive_cats) : 
+	LLInventoryModelFetchDescendentsResponder(const LLSD& request_sd, uuid_vec_t recursive_cats, const LLUUID& scheduler_id) : 
 		mRequestSD(request_sd),
-		mRecursiveCatUUIDs(recursive_cats)
+		mRecursiveCatUUIDs(recursive_cats),
+		mSchedulerID(scheduler_id)
 	{};
 	//LLInventoryModelFetchDescendentsResponder() {};
 	void result(const LLSD& content);
@@ -336,6 +338,7 @@ protected:
 private:
 	LLSD mRequestSD;
 	uuid_vec_t mRecursiveCatUUIDs; // hack for storing away which cat fetches are recursive
+	LLUUID mSchedulerID; // our slot in the HTTP scheduler
 };
 
 // If we get back a normal response, handle it here.
@@ -457,6 +460,7 @@ void LLInventoryModelFetchDescendentsResponder::result(const LLSD& content)
 	}
 
 	fetcher->incrBulkFetch(-1);
+	LLHTTPScheduler::getInstance()->release(LLHTTPScheduler::RC_INVENTORY, mSchedulerID);
 	
 	if (fetcher->isBulkFetchProcessingComplete())
 	{
@@ -476,6 +480,7 @@ void LLInventoryModelFetchDescendentsResponder::error(U32 status, const std::str
 		<< status << ": " << reason << llendl;
 						
 	fetcher->incrBulkFetch(-1);
+	LLHTTPScheduler::getInstance()->release(LLHTTPScheduler::RC_INVENTORY, mSchedulerID);
 
 	if (status==499) // timed out
 	{
@@ -513,7 +518,6 @@ void LLInventoryModelBackgroundFetch::bulkFetch(std::string url)
 	//sent.  If it exceeds our retry time, go ahead and fire off another batch.  
 	//Stopbackgroundfetch will be run from the Responder instead of here.  
 
-	S16 max_concurrent_fetches=8;
 	F32 new_min_time = 0.5f;			//HACK!  Clean this up when old code goes away entirely.
 	if (mMinTimeBetweenFetches < new_min_time) 
 	{
@@ -521,12 +525,28 @@ void LLInventoryModelBackgroundFetch::bulkFetch(std::string url)
 	}
 	
 	if (gDisconnected ||
-		(mBulkFetchCount > max_concurrent_fetches) ||
 		(mFetchTimer.getElapsedTimeF32() < mMinTimeBetweenFetches))
 	{
 		return; // just bail if we are disconnected
 	}	
 
+	// The number of concurrent fetches is up to the HTTP scheduler.
+	// Folders the user is waiting on go ahead of background ones.
+	if (mBulkFetchID.isNull())
+	{
+		mBulkFetchID.generate();
+	}
+	bool have_slot = false;
+	if (!mFetchQueue.empty())
+	{
+		F32 priority = mTimelyFetchPending ? 1.f : 0.5f;
+		if (!LLHTTPScheduler::getInstance()->acquire(LLHTTPScheduler::RC_INVENTORY, mBulkFetchID, url, priority))
+		{
+			return;
+		}
+		have_slot = true;
+	}
+
 	U32 folder_count=0;
 	U32 max_batch_size=5;
 
@@ -597,23 +617,36 @@ void LLInventoryModelBackgroundFetch::bulkFetch(std::string url)
 	if (folder_count > 0)
 	{
 		mBulkFetchCount++;
+		LLUUID scheduler_id = mBulkFetchID;
+		mBulkFetchID.setNull();
 		if (body["folders"].size())
 		{
-			LLInventoryModelFetchDescendentsResponder *fetcher = new LLInventoryModelFetchDescendentsResponder(body, recursive_cats);
+			LLInventoryModelFetchDescendentsResponder *fetcher = new LLInventoryModelFetchDescendentsResponder(body, recursive_cats, scheduler_id);
 			LLHTTPClient::post(url, body, fetcher, 300.0);
+			scheduler_id.generate();
 		}
 		if (body_lib["folders"].size())
 		{
 			std::string url_lib = gAgent.getRegion()->getCapability("FetchLibDescendents");
-			
-			LLInventoryModelFetchDescendentsResponder *fetcher = new LLInventoryModelFetchDescendentsResponder(body_lib, recursive_cats);
+
+			// Goes out with the batch the slot was acquired for.
+			LLHTTPScheduler::getInstance()->forceAcquire(LLHTTPScheduler::RC_INVENTORY, scheduler_id, url_lib);
+			LLInventoryModelFetchDescendentsResponder *fetcher = new LLInventoryModelFetchDescendentsResponder(body_lib, recursive_cats, scheduler_id);
 			LLHTTPClient::post(url_lib, body_lib, fetcher, 300.0);
 		}
 		mFetchTimer.reset();
 	}
-	else if (isBulkFetchProcessingComplete())
+	else
 	{
-		setAllFoldersFetched();
+		if (have_slot)
+		{
+			// Nothing needed fetching after all.
+			LLHTTPScheduler::getInstance()->release(LLHTTPScheduler::RC_INVENTORY, mBulkFetchID);
+		}
+		if (isBulkFetchProcessingComplete())
+		{
+			setAllFoldersFetched();
+		}
 	}
 }
 
@@ -78,6 +78,7 @@ private:
 
 	BOOL mBackgroundFetchActive;
 	S16 mBulkFetchCount;
+	LLUUID mBulkFetchID; // HTTP scheduler slot of the next batch
 	BOOL mTimelyFetchPending;
 	S32 mNumFetchRetries;
 
@@ -40,6 +40,7 @@
 #include "llendianswizzle.h"
 
 #include "llfasttimer.h"
+#include "llv4math.h"	// for LL_VECTORIZE
 
 #define HEADER_ASCII "Linden Mesh 1.0"
 #define HEADER_BINARY "Linden Binary Mesh 1.0"
@@ -51,6 +52,40 @@ extern LLControlGroup gSavedSettings;				// read only
 //-----------------------------------------------------------------------------
 LLPolyMesh::LLPolyMeshSharedDataTable LLPolyMesh::sGlobalSharedMeshList;
 
+//-----------------------------------------------------------------------------
+// Cache of morphed vertex data shared by all avatars
+//-----------------------------------------------------------------------------
+LLPolyMesh::morph_cache_t LLPolyMesh::sMorphCache;
+U32 LLPolyMesh::sMorphCacheSize = 0;
+U32 LLPolyMesh::sMorphCacheClock = 0;
+
+//-----------------------------------------------------------------------------
+// LLPolyVertexData()
+//-----------------------------------------------------------------------------
+LLPolyVertexData::LLPolyVertexData(S32 num_vertices)
+:	mNumVertices(num_vertices)
+{
+	// Allocate memory without initializing every vector
+	mData = new F32[getNumFloats(num_vertices)];
+}
+
+LLPolyVertexData::LLPolyVertexData(const LLPolyVertexData& other)
+:	LLRefCount(),
+	mNumVertices(other.mNumVertices)
+{
+	S32 num_floats = getNumFloats(mNumVertices);
+	mData = new F32[num_floats];
+	memcpy(mData, other.mData, sizeof(F32) * num_floats);		/*Flawfinder: ignore*/
+}
+
+//-----------------------------------------------------------------------------
+// ~LLPolyVertexData()
+//-----------------------------------------------------------------------------
+LLPolyVertexData::~LLPolyVertexData()
+{
+	delete [] mData;
+}
+
 //-----------------------------------------------------------------------------
 // LLPolyMeshSharedData()
 //-----------------------------------------------------------------------------
@@ -683,7 +718,8 @@ LLPolyMesh::LLPolyMesh(LLPolyMeshSharedData *shared_data, LLPolyMesh *reference_
 	mSharedData = shared_data;
 	mReferenceMesh = reference_mesh;
 	mAvatarp = NULL;
-	mVertexData = NULL;
+	mMorphBatching = FALSE;
+	mCachedMorphs = FALSE;
 
 	mCurVertexCount = 0;
 	mFaceIndexCount = 0;
@@ -693,29 +729,20 @@ LLPolyMesh::LLPolyMesh(LLPolyMeshSharedData *shared_data, LLPolyMesh *reference_
 
 	if (shared_data->isLOD() && reference_mesh)
 	{
-		mCoords = reference_mesh->mCoords;
-		mNormals = reference_mesh->mNormals;
-		mScaledNormals = reference_mesh->mScaledNormals;
-		mBinormals = reference_mesh->mBinormals;
-		mScaledBinormals = reference_mesh->mScaledBinormals;
-		mTexCoords = reference_mesh->mTexCoords;
-		mClothingWeights = reference_mesh->mClothingWeights;
+		// the accessors read the reference mesh's vertices, which can be
+		// replaced by a shared copy at any time (see getVertexMesh())
+		mCoords = NULL;
+		mNormals = NULL;
+		mScaledNormals = NULL;
+		mBinormals = NULL;
+		mScaledBinormals = NULL;
+		mTexCoords = NULL;
+		mClothingWeights = NULL;
 	}
 	else
 	{
 #if 1	// Allocate memory without initializing every vector
-		// NOTE: This makes asusmptions about the size of LLVector[234]
-		int nverts = mSharedData->mNumVertices;
-		int nfloats = nverts * (3*5 + 2 + 4);
-		mVertexData = new F32[nfloats];
-		int offset = 0;
-		mCoords = 				(LLVector3*)(mVertexData + offset); offset += 3*nverts;
-		mNormals = 				(LLVector3*)(mVertexData + offset); offset += 3*nverts;
-		mScaledNormals = 		(LLVector3*)(mVertexData + offset); offset += 3*nverts;
-		mBinormals = 			(LLVector3*)(mVertexData + offset); offset += 3*nverts;
-		mScaledBinormals = 		(LLVector3*)(mVertexData + offset); offset += 3*nverts;
-		mTexCoords = 			(LLVector2*)(mVertexData + offset); offset += 2*nverts;
-		mClothingWeights = 	(LLVector4*)(mVertexData + offset); offset += 4*nverts;
+		setVertexData(new LLPolyVertexData(mSharedData->mNumVertices));
 #else
 		mCoords = new LLVector3[mSharedData->mNumVertices];
 		mNormals = new LLVector3[mSharedData->mNumVertices];
@@ -750,9 +777,8 @@ LLPolyMesh::~LLPolyMesh()
 	delete [] mScaledBinormals;
 	delete [] mClothingWeights;
 	delete [] mTexCoords;
-#else
-	delete [] mVertexData;
 #endif
+	// mVertexData is released with its last user
 }
 
 
@@ -805,6 +831,9 @@ void LLPolyMesh::freeAllMeshes()
 	// delete each item in the global lists
 	for_each(sGlobalSharedMeshList.begin(), sGlobalSharedMeshList.end(), DeletePairedPointer());
 	sGlobalSharedMeshList.clear();
+
+	// entries are keyed by the shared data we just deleted
+	freeMorphCache();
 }
 
 LLPolyMeshSharedData *LLPolyMesh::getSharedData() const
@@ -860,6 +889,7 @@ void LLPolyMesh::dumpDiagInfo()
 //-----------------------------------------------------------------------------
 LLVector3 *LLPolyMesh::getWritableCoords()
 {
+	makeVertexDataUnique();
 	return mCoords;
 }
 
@@ -868,6 +898,7 @@ LLVector3 *LLPolyMesh::getWritableCoords()
 //-----------------------------------------------------------------------------
 LLVector3 *LLPolyMesh::getWritableNormals()
 {
+	makeVertexDataUnique();
 	return mNormals;
 }
 
@@ -876,6 +907,7 @@ LLVector3 *LLPolyMesh::getWritableNormals()
 //-----------------------------------------------------------------------------
 LLVector3 *LLPolyMesh::getWritableBinormals()
 {
+	makeVertexDataUnique();
 	return mBinormals;
 }
 
@@ -885,6 +917,7 @@ LLVector3 *LLPolyMesh::getWritableBinormals()
 //-----------------------------------------------------------------------------
 LLVector4	*LLPolyMesh::getWritableClothingWeights()
 {
+	makeVertexDataUnique();
 	return mClothingWeights;
 }
 
@@ -893,6 +926,7 @@ LLVector4	*LLPolyMesh::getWritableClothingWeights()
 //-----------------------------------------------------------------------------
 LLVector2	*LLPolyMesh::getWritableTexCoords()
 {
+	makeVertexDataUnique();
 	return mTexCoords;
 }
 
@@ -901,6 +935,7 @@ LLVector2	*LLPolyMesh::getWritableTexCoords()
 //-----------------------------------------------------------------------------
 LLVector3 *LLPolyMesh::getScaledNormals()
 {
+	makeVertexDataUnique();
 	return mScaledNormals;
 }
 
@@ -909,6 +944,7 @@ LLVector3 *LLPolyMesh::getScaledNormals()
 //-----------------------------------------------------------------------------
 LLVector3 *LLPolyMesh::getScaledBinormals()
 {
+	makeVertexDataUnique();
 	return mScaledBinormals;
 }
 
@@ -930,6 +966,254 @@ void LLPolyMesh::initializeForMorph()
 	memset(mClothingWeights, 0, sizeof(LLVector4) * mSharedData->mNumVertices);
 }
 
+//-----------------------------------------------------------------------------
+// setVertexData()
+//-----------------------------------------------------------------------------
+void LLPolyMesh::setVertexData(LLPolyVertexData* vertex_data)
+{
+	llassert(vertex_data->getNumVertices() == mSharedData->mNumVertices);
+	mVertexData = vertex_data;
+
+	// NOTE: This makes asusmptions about the size of LLVector[234]
+	F32* data = mVertexData->getData();
+	int nverts = mVertexData->getNumVertices();
+	int offset = 0;
+	mCoords = 				(LLVector3*)(data + offset); offset += 3*nverts;
+	mNormals = 				(LLVector3*)(data + offset); offset += 3*nverts;
+	mScaledNormals = 		(LLVector3*)(data + offset); offset += 3*nverts;
+	mBinormals = 			(LLVector3*)(data + offset); offset += 3*nverts;
+	mScaledBinormals = 		(LLVector3*)(data + offset); offset += 3*nverts;
+	mTexCoords = 			(LLVector2*)(data + offset); offset += 2*nverts;
+	mClothingWeights = 	(LLVector4*)(data + offset); offset += 4*nverts;
+}
+
+//-----------------------------------------------------------------------------
+// makeVertexDataUnique()
+// Copy on write for vertices shared with the morph cache or other avatars.
+//-----------------------------------------------------------------------------
+void LLPolyMesh::makeVertexDataUnique()
+{
+	if (mVertexData.notNull() && mVertexData->getNumRefs() > 1)
+	{
+		setVertexData(new LLPolyVertexData(*mVertexData));
+	}
+}
+
+//-----------------------------------------------------------------------------
+// beginMorphBatch()
+//-----------------------------------------------------------------------------
+void LLPolyMesh::beginMorphBatch()
+{
+	llassert(!mMorphBatching);
+	if (mVertexData.isNull())
+	{
+		// LODs share the reference mesh's vertices and are never morphed
+		return;
+	}
+
+	mMorphedVertexFlags.resize(mSharedData->mNumVertices, FALSE);
+	mMorphBatching = TRUE;
+	mCachedMorphs = FALSE;
+}
+
+//-----------------------------------------------------------------------------
+// endMorphBatch()
+//-----------------------------------------------------------------------------
+void LLPolyMesh::endMorphBatch()
+{
+	if (!mMorphBatching)
+	{
+		return;
+	}
+
+	updateMorphedNormals();
+
+	for (std::vector<U32>::iterator iter = mMorphedVertices.begin();
+		 iter != mMorphedVertices.end(); ++iter)
+	{
+		mMorphedVertexFlags[*iter] = FALSE;
+	}
+	mMorphedVertices.clear();
+	mMorphBatching = FALSE;
+	mCachedMorphs = FALSE;
+}
+
+//-----------------------------------------------------------------------------
+// updateMorphedNormals()
+// Output normals and binormals are derived from the accumulated (scaled)
+// ones, exactly as LLPolyMorphTarget::apply() does per morph.
+//-----------------------------------------------------------------------------
+void LLPolyMesh::updateMorphedNormals()
+{
+	if (mMorphedVertices.empty())
+	{
+		return;
+	}
+	makeVertexDataUnique();
+
+	const U32* verts = &mMorphedVertices[0];
+	S32 count = (S32)mMorphedVertices.size();
+	S32 i = 0;
+
+#if LL_VECTORIZE
+	// four vertices at a time, transposed into x/y/z registers
+	const __m128 threshold = _mm_set1_ps(FP_MAG_THRESHOLD);
+	const __m128 one = _mm_set1_ps(1.f);
+	for ( ; i + 4 <= count; i += 4)
+	{
+		F32 sn[3][4];
+		F32 sb[3][4];
+		for (S32 lane = 0; lane < 4; lane++)
+		{
+			const LLVector3& scaled_normal = mScaledNormals[verts[i + lane]];
+			const LLVector3& scaled_binormal = mScaledBinormals[verts[i + lane]];
+			for (S32 c = 0; c < 3; c++)
+			{
+				sn[c][lane] = scaled_normal.mV[c];
+				sb[c][lane] = scaled_binormal.mV[c];
+			}
+		}
+
+		// normal = normalize(scaled normal)
+		__m128 nx = _mm_loadu_ps(sn[VX]);
+		__m128 ny = _mm_loadu_ps(sn[VY]);
+		__m128 nz = _mm_loadu_ps(sn[VZ]);
+		__m128 mag = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, nx), _mm_mul_ps(ny, ny)), _mm_mul_ps(nz, nz)));
+		__m128 valid = _mm_cmpgt_ps(mag, threshold);
+		__m128 oomag = _mm_div_ps(one, mag);
+		nx = _mm_and_ps(_mm_mul_ps(nx, oomag), valid);
+		ny = _mm_and_ps(_mm_mul_ps(ny, oomag), valid);
+		nz = _mm_and_ps(_mm_mul_ps(nz, oomag), valid);
+
+		// tangent = scaled binormal % normal
+		const __m128 bx = _mm_loadu_ps(sb[VX]);
+		const __m128 by = _mm_loadu_ps(sb[VY]);
+		const __m128 bz = _mm_loadu_ps(sb[VZ]);
+		const __m128 tx = _mm_sub_ps(_mm_mul_ps(by, nz), _mm_mul_ps(ny, bz));
+		const __m128 ty = _mm_sub_ps(_mm_mul_ps(bz, nx), _mm_mul_ps(nz, bx));
+		const __m128 tz = _mm_sub_ps(_mm_mul_ps(bx, ny), _mm_mul_ps(nx, by));
+
+		// binormal = normalize(normal % tangent)
+		__m128 ox = _mm_sub_ps(_mm_mul_ps(ny, tz), _mm_mul_ps(ty, nz));
+		__m128 oy = _mm_sub_ps(_mm_mul_ps(nz, tx), _mm_mul_ps(tz, nx));
+		__m128 oz = _mm_sub_ps(_mm_mul_ps(nx, ty), _mm_mul_ps(tx, ny));
+		mag = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(ox, ox), _mm_mul_ps(oy, oy)), _mm_mul_ps(oz, oz)));
+		valid = _mm_cmpgt_ps(mag, threshold);
+		oomag = _mm_div_ps(one, mag);
+		ox = _mm_and_ps(_mm_mul_ps(ox, oomag), valid);
+		oy = _mm_and_ps(_mm_mul_ps(oy, oomag), valid);
+		oz = _mm_and_ps(_mm_mul_ps(oz, oomag), valid);
+
+		_mm_storeu_ps(sn[VX], nx);
+		_mm_storeu_ps(sn[VY], ny);
+		_mm_storeu_ps(sn[VZ], nz);
+		_mm_storeu_ps(sb[VX], ox);
+		_mm_storeu_ps(sb[VY], oy);
+		_mm_storeu_ps(sb[VZ], oz);
+		for (S32 lane = 0; lane < 4; lane++)
+		{
+			mNormals[verts[i + lane]].setVec(sn[VX][lane], sn[VY][lane], sn[VZ][lane]);
+			mBinormals[verts[i + lane]].setVec(sb[VX][lane], sb[VY][lane], sb[VZ][lane]);
+		}
+	}
+#endif
+
+	for ( ; i < count; i++)
+	{
+		U32 vert = verts[i];
+		LLVector3 normalized_normal = mScaledNormals[vert];
+		normalized_normal.normVec();
+		mNormals[vert] = normalized_normal;
+
+		LLVector3 tangent = mScaledBinormals[vert] % normalized_normal;
+		LLVector3 normalized_binormal = normalized_normal % tangent;
+		normalized_binormal.normVec();
+		mBinormals[vert] = normalized_binormal;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// loadMorphCache()
+//-----------------------------------------------------------------------------
+BOOL LLPolyMesh::loadMorphCache(const LLUUID& shape_id)
+{
+	if (!mMorphBatching)
+	{
+		return FALSE;
+	}
+
+	morph_cache_t::iterator iter = sMorphCache.find(morph_cache_key_t(mSharedData, shape_id));
+	if (iter == sMorphCache.end())
+	{
+		return FALSE;
+	}
+
+	// nothing is pending yet, the previous shape can simply be dropped
+	llassert(mMorphedVertices.empty());
+	setVertexData(iter->second.mVertexData);
+	iter->second.mLastUsed = ++sMorphCacheClock;
+	mCachedMorphs = TRUE;
+	return TRUE;
+}
+
+//-----------------------------------------------------------------------------
+// saveMorphCache()
+//-----------------------------------------------------------------------------
+void LLPolyMesh::saveMorphCache(const LLUUID& shape_id)
+{
+	llassert(!mMorphBatching);
+	if (!sMorphCacheSize || mVertexData.isNull())
+	{
+		return;
+	}
+
+	morph_cache_key_t key(mSharedData, shape_id);
+	if (sMorphCache.find(key) == sMorphCache.end())
+	{
+		while (sMorphCache.size() >= sMorphCacheSize)
+		{
+			// evict the least recently used shape, avatars using it keep theirs
+			morph_cache_t::iterator oldest = sMorphCache.begin();
+			for (morph_cache_t::iterator iter = sMorphCache.begin(); iter != sMorphCache.end(); ++iter)
+			{
+				if (iter->second.mLastUsed < oldest->second.mLastUsed)
+				{
+					oldest = iter;
+				}
+			}
+			sMorphCache.erase(oldest);
+		}
+	}
+
+	// no copy, we share our vertices until one of us changes shape
+	MorphCacheEntry& entry = sMorphCache[key];
+	entry.mVertexData = mVertexData;
+	entry.mLastUsed = ++sMorphCacheClock;
+}
+
+//-----------------------------------------------------------------------------
+// setMorphCacheSize()
+//-----------------------------------------------------------------------------
+// static
+void LLPolyMesh::setMorphCacheSize(U32 entries)
+{
+	if (sMorphCacheSize != entries)
+	{
+		// rarely changed, start over rather than pick entries to evict
+		sMorphCacheSize = entries;
+		sMorphCache.clear();
+	}
+}
+
+//-----------------------------------------------------------------------------
+// freeMorphCache()
+//-----------------------------------------------------------------------------
+// static
+void LLPolyMesh::freeMorphCache()
+{
+	sMorphCache.clear();
+}
+
 //-----------------------------------------------------------------------------
 // getMorphData()
 //-----------------------------------------------------------------------------
@@ -29,7 +29,11 @@
 
 #include <string>
 #include <map>
+#include <vector>
 #include "llstl.h"
+#include "llpointer.h"
+#include "llrefcount.h"
+#include "lluuid.h"
 
 #include "v3math.h"
 #include "v2math.h"
@@ -54,6 +58,35 @@ typedef S32 LLPolyFace[3];
 
 //struct PrimitiveGroup;
 
+//-----------------------------------------------------------------------------
+// LLPolyVertexData
+// The morphed vertices of an LLPolyMesh, in one allocation. Meshes morphed
+// to the same shape share one instance through the morph cache, and take a
+// private copy before writing to it.
+//-----------------------------------------------------------------------------
+class LLPolyVertexData : public LLRefCount
+{
+public:
+	LLPolyVertexData(S32 num_vertices);
+	LLPolyVertexData(const LLPolyVertexData& other);
+
+	S32 getNumVertices() const { return mNumVertices; }
+	F32* getData() { return mData; }
+
+	// coords, normals, scaled normals, binormals, scaled binormals,
+	// texture coords and clothing weights
+	static S32 getNumFloats(S32 num_vertices) { return num_vertices * (3*5 + 2 + 4); }
+
+protected:
+	~LLPolyVertexData();
+
+private:
+	LLPolyVertexData& operator=(const LLPolyVertexData&);
+
+	S32		mNumVertices;
+	F32*	mData;
+};
+
 //-----------------------------------------------------------------------------
 // LLPolyMesh
 // A polyhedra consisting of any number of triangles and quads.
@@ -218,7 +251,7 @@ public:
 
 	// Get coords
 	const LLVector3	*getCoords() const{
-		return mCoords;
+		return getVertexMesh()->mCoords;
 	}
 
 	// non const version
@@ -226,12 +259,12 @@ public:
 
 	// Get normals
 	const LLVector3	*getNormals() const{ 
-		return mNormals; 
+		return getVertexMesh()->mNormals; 
 	}
 
 	// Get normals
 	const LLVector3	*getBinormals() const{ 
-		return mBinormals; 
+		return getVertexMesh()->mBinormals; 
 	}
 
 	// Get base mesh normals
@@ -255,7 +288,7 @@ public:
 
 	// Get texCoords
 	const LLVector2	*getTexCoords() const { 
-		return mTexCoords; 
+		return getVertexMesh()->mTexCoords; 
 	}
 
 	// non const version
@@ -279,7 +312,7 @@ public:
 
 	const LLVector4		*getClothingWeights()
 	{
-		return mClothingWeights;	
+		return getVertexMesh()->mClothingWeights;	
 	}
 
 	//--------------------------------------------------------------------
@@ -322,6 +355,37 @@ public:
 	void setAvatar(LLVOAvatar* avatarp) { mAvatarp = avatarp; }
 	LLVOAvatar* getAvatar() { return mAvatarp; }
 
+	//--------------------------------------------------------------------
+	// Batched morphing
+	//--------------------------------------------------------------------
+	// Between beginMorphBatch() and endMorphBatch(), morph targets only
+	// accumulate their deltas and mark the vertices they move. The output
+	// normals and binormals of those vertices are rebuilt once, at the end,
+	// instead of after every morph.
+	void beginMorphBatch();
+	void endMorphBatch();
+	BOOL isMorphBatching() const { return mMorphBatching; }
+	void markMorphedVertex(U32 index)
+	{
+		if (!mMorphedVertexFlags[index])
+		{
+			mMorphedVertexFlags[index] = TRUE;
+			mMorphedVertices.push_back(index);
+		}
+	}
+
+	// Morphed vertex data is shared across avatars, addressed by the mesh
+	// and a digest of everything its shape depends on (see LLVOAvatar).
+	// Inside a batch, loadMorphCache() adopts the cached vertices, after
+	// which the morph targets skip their vertex deltas until endMorphBatch().
+	// saveMorphCache() shares the finished vertices, outside a batch.
+	BOOL loadMorphCache(const LLUUID& shape_id);
+	void saveMorphCache(const LLUUID& shape_id);
+	BOOL hasCachedMorphs() const { return mCachedMorphs; }
+
+	static void setMorphCacheSize(U32 entries);
+	static void freeMorphCache();
+
 	LLDynamicArray<LLJointRenderData*>	mJointRenderData;
 
 	U32				mFaceVertexOffset;
@@ -331,6 +395,12 @@ public:
 	U32				mCurVertexCount;
 private:
 	void initializeForMorph();
+	void updateMorphedNormals();
+	void setVertexData(LLPolyVertexData* vertex_data);
+	void makeVertexDataUnique();
+
+	// LODs read the vertices of their reference mesh
+	const LLPolyMesh* getVertexMesh() const { return mVertexData.notNull() ? this : mReferenceMesh; }
 
 	// Dumps diagnostic information about the global mesh table
 	static void dumpDiagInfo();
@@ -338,8 +408,8 @@ private:
 protected:
 	// mesh data shared across all instances of a given mesh
 	LLPolyMeshSharedData	*mSharedData;
-	// Single array of floats for allocation / deletion
-	F32						*mVertexData;
+	// Single array of floats for allocation / deletion, possibly shared
+	LLPointer<LLPolyVertexData>	mVertexData;
 	// deformed vertices (resulting from application of morph targets)
 	LLVector3				*mCoords;
 	// deformed normals (resulting from application of morph targets)
@@ -357,6 +427,23 @@ protected:
 	
 	LLPolyMesh				*mReferenceMesh;
 
+	// batched morph state
+	BOOL					mMorphBatching;
+	BOOL					mCachedMorphs;
+	std::vector<U8>			mMorphedVertexFlags;
+	std::vector<U32>		mMorphedVertices;
+
+	struct MorphCacheEntry
+	{
+		LLPointer<LLPolyVertexData>	mVertexData;
+		U32							mLastUsed;
+	};
+	typedef std::pair<LLPolyMeshSharedData*, LLUUID> morph_cache_key_t;
+	typedef std::map<morph_cache_key_t, MorphCacheEntry> morph_cache_t;
+	static morph_cache_t	sMorphCache;
+	static U32				sMorphCacheSize;
+	static U32				sMorphCacheClock;
+
 	// global mesh list
 	typedef std::map<std::string, LLPolyMeshSharedData*> LLPolyMeshSharedDataTable; 
 	static LLPolyMeshSharedDataTable sGlobalSharedMeshList;
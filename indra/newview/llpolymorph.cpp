@@ -455,71 +455,95 @@ void LLPolyMorphTarget::apply( ESex avatar_sex )
 	if (delta_weight != 0.f)
 	{
 		llassert(!mMesh->isLOD());
-		LLVector3 *coords = mMesh->getWritableCoords();
+		// a mesh restored from the morph cache already holds every morph
+		// at its new weight, masked ones included
+		if (!mMesh->hasCachedMorphs())
+		{
+			applyVertexDeltas(delta_weight);
+		}
 
-		LLVector3 *scaled_normals = mMesh->getScaledNormals();
-		LLVector3 *normals = mMesh->getWritableNormals();
+		// now apply volume changes
+		for( volume_list_t::iterator iter = mVolumeMorphs.begin(); iter != mVolumeMorphs.end(); iter++ )
+		{
+			LLPolyVolumeMorph* volume_morph = &(*iter);
+			LLVector3 scale_delta = volume_morph->mScale * delta_weight;
+			LLVector3 pos_delta = volume_morph->mPos * delta_weight;
+			
+			volume_morph->mVolume->setScale(volume_morph->mVolume->getScale() + scale_delta);
+			volume_morph->mVolume->setPosition(volume_morph->mVolume->getPosition() + pos_delta);
+		}
+	}
 
-		LLVector3 *scaled_binormals = mMesh->getScaledBinormals();
-		LLVector3 *binormals = mMesh->getWritableBinormals();
+	if (mNext)
+	{
+		mNext->apply(avatar_sex);
+	}
+}
 
-		LLVector4 *clothing_weights = mMesh->getWritableClothingWeights();
-		LLVector2 *tex_coords = mMesh->getWritableTexCoords();
+//-----------------------------------------------------------------------------
+// applyVertexDeltas()
+//-----------------------------------------------------------------------------
+void LLPolyMorphTarget::applyVertexDeltas(F32 delta_weight)
+{
+	LLVector3 *coords = mMesh->getWritableCoords();
 
-		F32 *maskWeightArray = (mVertMask) ? mVertMask->getMorphMaskWeights() : NULL;
+	LLVector3 *scaled_normals = mMesh->getScaledNormals();
+	LLVector3 *normals = mMesh->getWritableNormals();
+
+	LLVector3 *scaled_binormals = mMesh->getScaledBinormals();
+	LLVector3 *binormals = mMesh->getWritableBinormals();
+
+	LLVector4 *clothing_weights = mMesh->getWritableClothingWeights();
+	LLVector2 *tex_coords = mMesh->getWritableTexCoords();
+
+	F32 *maskWeightArray = (mVertMask) ? mVertMask->getMorphMaskWeights() : NULL;
+
+	// when batching, the mesh renormalizes each touched vertex once at the end
+	BOOL batching = mMesh->isMorphBatching();
+
+	for(U32 vert_index_morph = 0; vert_index_morph < mMorphData->mNumIndices; vert_index_morph++)
+	{
+		S32 vert_index_mesh = mMorphData->mVertexIndices[vert_index_morph];
 
-		for(U32 vert_index_morph = 0; vert_index_morph < mMorphData->mNumIndices; vert_index_morph++)
+		F32 maskWeight = 1.f;
+		if (maskWeightArray)
 		{
-			S32 vert_index_mesh = mMorphData->mVertexIndices[vert_index_morph];
+			maskWeight = maskWeightArray[vert_index_morph];
+		}
 
-			F32 maskWeight = 1.f;
-			if (maskWeightArray)
-			{
-				maskWeight = maskWeightArray[vert_index_morph];
-			}
+		coords[vert_index_mesh] += mMorphData->mCoords[vert_index_morph] * delta_weight * maskWeight;
+		if (getInfo()->mIsClothingMorph && clothing_weights)
+		{
+			LLVector3 clothing_offset = mMorphData->mCoords[vert_index_morph] * delta_weight * maskWeight;
+			LLVector4* clothing_weight = &clothing_weights[vert_index_mesh];
+			clothing_weight->mV[VX] += clothing_offset.mV[VX];
+			clothing_weight->mV[VY] += clothing_offset.mV[VY];
+			clothing_weight->mV[VZ] += clothing_offset.mV[VZ];
+			clothing_weight->mV[VW] = maskWeight;
+		}
 
-			coords[vert_index_mesh] += mMorphData->mCoords[vert_index_morph] * delta_weight * maskWeight;
-			if (getInfo()->mIsClothingMorph && clothing_weights)
-			{
-				LLVector3 clothing_offset = mMorphData->mCoords[vert_index_morph] * delta_weight * maskWeight;
-				LLVector4* clothing_weight = &clothing_weights[vert_index_mesh];
-				clothing_weight->mV[VX] += clothing_offset.mV[VX];
-				clothing_weight->mV[VY] += clothing_offset.mV[VY];
-				clothing_weight->mV[VZ] += clothing_offset.mV[VZ];
-				clothing_weight->mV[VW] = maskWeight;
-			}
+		scaled_normals[vert_index_mesh] += mMorphData->mNormals[vert_index_morph] * delta_weight * maskWeight * NORMAL_SOFTEN_FACTOR;
+		scaled_binormals[vert_index_mesh] += mMorphData->mBinormals[vert_index_morph] * delta_weight * maskWeight * NORMAL_SOFTEN_FACTOR;
 
+		if (batching)
+		{
+			mMesh->markMorphedVertex(vert_index_mesh);
+		}
+		else
+		{
 			// calculate new normals based on half angles
-			scaled_normals[vert_index_mesh] += mMorphData->mNormals[vert_index_morph] * delta_weight * maskWeight * NORMAL_SOFTEN_FACTOR;
 			LLVector3 normalized_normal = scaled_normals[vert_index_mesh];
 			normalized_normal.normVec();
 			normals[vert_index_mesh] = normalized_normal;
 
 			// calculate new binormals
-			scaled_binormals[vert_index_mesh] += mMorphData->mBinormals[vert_index_morph] * delta_weight * maskWeight * NORMAL_SOFTEN_FACTOR;
 			LLVector3 tangent = scaled_binormals[vert_index_mesh] % normalized_normal;
 			LLVector3 normalized_binormal = normalized_normal % tangent; 
 			normalized_binormal.normVec();
 			binormals[vert_index_mesh] = normalized_binormal;
-
-			tex_coords[vert_index_mesh] += mMorphData->mTexCoords[vert_index_morph] * delta_weight * maskWeight;
 		}
 
-		// now apply volume changes
-		for( volume_list_t::iterator iter = mVolumeMorphs.begin(); iter != mVolumeMorphs.end(); iter++ )
-		{
-			LLPolyVolumeMorph* volume_morph = &(*iter);
-			LLVector3 scale_delta = volume_morph->mScale * delta_weight;
-			LLVector3 pos_delta = volume_morph->mPos * delta_weight;
-			
-			volume_morph->mVolume->setScale(volume_morph->mVolume->getScale() + scale_delta);
-			volume_morph->mVolume->setPosition(volume_morph->mVolume->getPosition() + pos_delta);
-		}
-	}
-
-	if (mNext)
-	{
-		mNext->apply(avatar_sex);
+		tex_coords[vert_index_mesh] += mMorphData->mTexCoords[vert_index_morph] * delta_weight * maskWeight;
 	}
 }
 
@@ -165,7 +165,17 @@ public:
 	void	applyMask(U8 *maskData, S32 width, S32 height, S32 num_components, BOOL invert);
 	void	addPendingMorphMask() { mNumMorphMasksPending++; }
 
+	LLPolyMesh*	getMesh() const { return mMesh; }
+	// Masked morphs are weighted per vertex by the avatar's own baked
+	// textures, so their effect on the mesh also depends on those textures.
+	BOOL	isMasked() const { return mVertMask != NULL || mNumMorphMasksPending > 0; }
+	BOOL	hasVertexMask() const { return mVertMask != NULL; }
+
 protected:
+	// Adds delta_weight worth of this morph to the mesh vertices, without
+	// touching the weight bookkeeping or the collision volumes.
+	void	applyVertexDeltas(F32 delta_weight);
+
 	LLPolyMorphData*				mMorphData;
 	LLPolyMesh*						mMesh;
 	LLPolyVertexMask *				mVertMask;
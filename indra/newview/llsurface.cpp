@@ -664,24 +664,28 @@ BOOL LLSurface::idleUpdate(F32 max_update_time)
 
 void LLSurface::decompressDCTPatch(LLBitPack &bitpack, LLGroupHeader *gopp, BOOL b_large_patch) 
 {
+	// Kept between packets so a busy region does not allocate per packet
+	static std::vector<LLPatchHeader> headers;
+	static std::vector<S32> coefficients;
+	static std::vector<F32*> outputs;
 
-	LLPatchHeader  ph;
-	S32 j, i;
-	S32 patch[LARGE_PATCH_SIZE*LARGE_PATCH_SIZE];
+	S32 j, i, k;
 	LLSurfacePatch *patchp;
 
 	init_patch_decompressor(gopp->patch_size);
 	gopp->stride = mGridsPerEdge;
 	set_group_of_patch_header(gopp);
 
-	while (1)
-	{
-		decode_patch_header(bitpack, &ph);
-		if (ph.quant_wbits == END_OF_PATCHES)
-		{
-			break;
-		}
+	// Read every patch in the packet first, then decompress them in one go
+	const S32 max_patches = mPatchesPerEdge*mPatchesPerEdge;
+	headers.resize(max_patches);
+	coefficients.resize(max_patches*gopp->patch_size*gopp->patch_size);
+	S32 count = decode_patches(bitpack, &headers[0], &coefficients[0], max_patches);
 
+	outputs.resize(count);
+	for (k = 0; k < count; k++)
+	{
+		const LLPatchHeader& ph = headers[k];
 		i = ph.patchids >> 5;
 		j = ph.patchids & 0x1F;
 
@@ -700,11 +704,19 @@ void LLSurface::decompressDCTPatch(LLBitPack &bitpack, LLGroupHeader *gopp, BOOL
 			return;
 		}
 
-		patchp = &mPatchList[j*mPatchesPerEdge + i];
+		outputs[k] = mPatchList[j*mPatchesPerEdge + i].getDataZ();
+	}
 
+	if (count)
+	{
+		decompress_patches(&outputs[0], &coefficients[0], &headers[0], count);
+	}
 
-		decode_patch(bitpack, patch);
-		decompress_patch(patchp->getDataZ(), patch, &ph);
+	for (k = 0; k < count; k++)
+	{
+		i = headers[k].patchids >> 5;
+		j = headers[k].patchids & 0x1F;
+		patchp = &mPatchList[j*mPatchesPerEdge + i];
 
 		// Update edges for neighbors.  Need to guarantee that this gets done before we generate vertical stats.
 		patchp->updateNorthEdge();
@@ -41,6 +41,7 @@
 #include "llviewerregion.h"
 #include "llvlcomposition.h"
 #include "lldrawpool.h"
+#include "llheightfield.h"
 #include "noise.h"
 
 extern U64 gFrameTime;
@@ -52,9 +53,11 @@ LLSurfacePatch::LLSurfacePatch() :
 	mDirty(FALSE),
 	mDirtyZStats(TRUE),
 	mHeightsGenerated(FALSE),
+	mCompositionHandle(LLQueuedThread::nullHandle()),
 	mDataOffset(0),
 	mDataZ(NULL),
 	mDataNorm(NULL),
+	mGeometryVersion(0),
 	mVObjp(NULL),
 	mOriginRegion(0.f, 0.f, 0.f),
 	mCenterRegion(0.f, 0.f, 0.f),
@@ -85,6 +88,7 @@ LLSurfacePatch::LLSurfacePatch() :
 
 LLSurfacePatch::~LLSurfacePatch()
 {
+	LLVLComposition::abortTexture(mCompositionHandle);
 	mVObjp = NULL;
 }
 
@@ -104,6 +108,9 @@ void LLSurfacePatch::dirty()
 
 	mDirtyZStats = TRUE;
 	mHeightsGenerated = FALSE;
+	mGeometryVersion++;
+	// The composition values are about to change
+	LLVLComposition::abortTexture(mCompositionHandle);
 	
 	if (!mDirty)
 	{
@@ -224,6 +231,25 @@ void LLSurfacePatch::eval(const U32 x, const U32 y, const U32 stride, LLVector3
 	LLVector3 tex_pos = rel_pos * (1.f/surface_stride);
 	tex0->mV[0]  = tex_pos.mV[0];
 	tex0->mV[1]  = tex_pos.mV[1];
+
+	// The detail coordinates only change with the composition, and every
+	// rebuild of the patch geometry asks for them again
+	U32 cache_width = mSurfacep->getGridsPerPatchEdge() + 1;
+	if (mDetailTexCoords.empty())
+	{
+		mDetailTexCoords.resize(cache_width*cache_width, LLVector2(0.f, -1.f));
+	}
+	LLVector2* cached = NULL;
+	if (x < cache_width && y < cache_width)
+	{
+		cached = &mDetailTexCoords[x + y*cache_width];
+		if (cached->mV[1] >= 0.f)
+		{
+			*tex1 = *cached;
+			return;
+		}
+	}
+
 	tex1->mV[0] = mSurfacep->getRegion()->getCompositionXY(llfloor(mOriginRegion.mV[0])+x, llfloor(mOriginRegion.mV[1])+y);
 
 	const F32 xyScale = 4.9215f*7.f; //0.93284f;
@@ -237,7 +263,16 @@ void LLSurfacePatch::eval(const U32 x, const U32 y, const U32 stride, LLVector3
 	F32 rand_val = llclamp(noise2(vec)* 0.75f + 0.5f, 0.f, 1.f);
 	tex1->mV[1] = rand_val;
 
+	if (cached)
+	{
+		*cached = *tex1;
+	}
+}
 
+void LLSurfacePatch::dirtyDetailTexCoords()
+{
+	std::fill(mDetailTexCoords.begin(), mDetailTexCoords.end(), LLVector2(0.f, -1.f));
+	mGeometryVersion++;
 }
 
 
@@ -354,6 +389,50 @@ void LLSurfacePatch::calcNormal(const U32 x, const U32 y, const U32 stride)
 	*(mDataNorm + surface_stride * y + x) = normal;
 }
 
+void LLSurfacePatch::calcNormalRow(const U32 x_begin, const U32 x_end, const U32 y, const U32 stride)
+{
+	if (x_end <= x_begin)
+	{
+		return;
+	}
+	U32 patch_width = mSurfacep->mPVArray.mPatchWidth;
+	U32 surface_stride = mSurfacep->getGridsPerEdge();
+
+	// Heights past our edges come from the neighbors. Neighbors in the
+	// same surface keep theirs in the same array as ours, at the same
+	// offsets calcNormal() ends up reading, so the row can be done in one
+	// batch. Otherwise go point by point.
+	const U32 dirs[4] = { WEST, EAST, SOUTH, NORTH };
+	const BOOL needed[4] = { x_begin < stride,
+							 x_end - 1 + stride >= patch_width,
+							 y < stride,
+							 y + stride >= patch_width };
+	BOOL batch = TRUE;
+	for (U32 i = 0; i < 4; i++)
+	{
+		if (needed[i] && (!getNeighborPatch(dirs[i]) || getNeighborPatch(dirs[i])->mSurfacep != mSurfacep))
+		{
+			batch = FALSE;
+			break;
+		}
+	}
+
+	if (batch)
+	{
+		llassert(mDataNorm);
+		U32 offset = x_begin + y*surface_stride;
+		ll_heightfield_normals(mDataZ + offset, surface_stride, x_end - x_begin, stride,
+							   mSurfacep->getMetersPerGrid() * stride, mDataNorm + offset);
+	}
+	else
+	{
+		for (U32 x = x_begin; x < x_end; x++)
+		{
+			calcNormal(x, y, stride);
+		}
+	}
+}
+
 const LLVector3 &LLSurfacePatch::getNormal(const U32 x, const U32 y) const
 {
 	U32 surface_stride = mSurfacep->getGridsPerEdge();
@@ -465,9 +544,7 @@ void LLSurfacePatch::updateNormals()
 	{
 		for (j = 0; j <= grids_per_patch_edge; j++)
 		{
-			calcNormal(grids_per_patch_edge, j, 2);
-			calcNormal(grids_per_patch_edge - 1, j, 2);
-			calcNormal(grids_per_patch_edge - 2, j, 2);
+			calcNormalRow(grids_per_patch_edge - 2, grids_per_patch_edge + 1, j, 2);
 		}
 
 		dirty_patch = TRUE;
@@ -476,11 +553,9 @@ void LLSurfacePatch::updateNormals()
 	// update the north edge
 	if (mNormalsInvalid[NORTHEAST] || mNormalsInvalid[NORTH] || mNormalsInvalid[NORTHWEST])
 	{
-		for (i = 0; i <= grids_per_patch_edge; i++)
+		for (j = grids_per_patch_edge - 2; j <= grids_per_patch_edge; j++)
 		{
-			calcNormal(i, grids_per_patch_edge, 2);
-			calcNormal(i, grids_per_patch_edge - 1, 2);
-			calcNormal(i, grids_per_patch_edge - 2, 2);
+			calcNormalRow(0, grids_per_patch_edge + 1, j, 2);
 		}
 
 		dirty_patch = TRUE;
@@ -491,8 +566,7 @@ void LLSurfacePatch::updateNormals()
 	{
 		for (j = 0; j < grids_per_patch_edge; j++)
 		{
-			calcNormal(0, j, 2);
-			calcNormal(1, j, 2);
+			calcNormalRow(0, 2, j, 2);
 		}
 		dirty_patch = TRUE;
 	}
@@ -500,11 +574,8 @@ void LLSurfacePatch::updateNormals()
 	// update the south edge
 	if (mNormalsInvalid[SOUTHWEST] || mNormalsInvalid[SOUTH] || mNormalsInvalid[SOUTHEAST])
 	{
-		for (i = 0; i < grids_per_patch_edge; i++)
-		{
-			calcNormal(i, 0, 2);
-			calcNormal(i, 1, 2);
-		}
+		calcNormalRow(0, grids_per_patch_edge, 0, 2);
+		calcNormalRow(0, grids_per_patch_edge, 1, 2);
 		dirty_patch = TRUE;
 	}
 
@@ -591,16 +662,14 @@ void LLSurfacePatch::updateNormals()
 	{
 		for (j=2; j < grids_per_patch_edge - 2; j++)
 		{
-			for (i=2; i < grids_per_patch_edge - 2; i++)
-			{
-				calcNormal(i, j, 2);
-			}
+			calcNormalRow(2, grids_per_patch_edge - 2, j, 2);
 		}
 		dirty_patch = TRUE;
 	}
 
 	if (dirty_patch)
 	{
+		mGeometryVersion++;
 		mSurfacep->dirtySurfacePatch(this);
 	}
 
@@ -640,6 +709,7 @@ void LLSurfacePatch::updateEastEdge()
 		k = j * grids_per_edge;
 		*(west_surface + k) = *(east_surface + k);	// update buffer Z
 	}
+	mGeometryVersion++;
 }
 
 
@@ -671,6 +741,7 @@ void LLSurfacePatch::updateNorthEdge()
 	{
 		*(south_surface + i) = *(north_surface + i);	// update buffer Z
 	}
+	mGeometryVersion++;
 }
 
 
@@ -698,6 +769,17 @@ BOOL LLSurfacePatch::updateTexture()
 										  patch_size, patch_size))
 				{
 					mHeightsGenerated = TRUE;
+
+					// Our composition values include the edges we share
+					// with the neighbors
+					dirtyDetailTexCoords();
+					for (U32 i = 0; i < 8; i++)
+					{
+						if (getNeighborPatch(i))
+						{
+							getNeighborPatch(i)->dirtyDetailTexCoords();
+						}
+					}
 				}
 				else
 				{
@@ -707,7 +789,11 @@ BOOL LLSurfacePatch::updateTexture()
 			
 			if (comp->generateComposition())
 			{
-				if (mVObjp)
+				// Stay dirty until the texture has been composited
+				F32 tex_patch_size = meters_per_grid*grids_per_patch_edge;
+				if (mVObjp &&
+					comp->requestTexture(mCompositionHandle, (F32)origin_region[VX], (F32)origin_region[VY],
+										 tex_patch_size, tex_patch_size, getDistance()))
 				{
 					mVObjp->dirtyGeom();
 					gPipeline.markGLRebuild(mVObjp);
@@ -735,8 +821,7 @@ void LLSurfacePatch::updateGL()
 	
 	updateCompositionStats();
 	F32 tex_patch_size = meters_per_grid*grids_per_patch_edge;
-	if (comp->generateTexture((F32)origin_region[VX], (F32)origin_region[VY],
-							  tex_patch_size, tex_patch_size))
+	if (comp->generateTexture(mCompositionHandle))
 	{
 		mSTexUpdate = FALSE;
 
@@ -744,6 +829,12 @@ void LLSurfacePatch::updateGL()
 		mSurfacep->generateWaterTexture((F32)origin_region.mdV[VX], (F32)origin_region.mdV[VY],
 										tex_patch_size, tex_patch_size);
 	}
+	else if (mSTexUpdate && !mDirty)
+	{
+		// The composited texture went away, queue it again
+		mDirty = TRUE;
+		mSurfacep->dirtySurfacePatch(this);
+	}
 }
 
 void LLSurfacePatch::dirtyZ()
@@ -803,6 +894,8 @@ void LLSurfacePatch::setOriginGlobal(const LLVector3d &origin_global)
 	mCenterRegion.mV[VX] = origin_region.mV[VX] + 0.5f*mSurfacep->getGridsPerPatchEdge()*mSurfacep->getMetersPerGrid();
 	mCenterRegion.mV[VY] = origin_region.mV[VY] + 0.5f*mSurfacep->getGridsPerPatchEdge()*mSurfacep->getMetersPerGrid();
 
+	dirtyDetailTexCoords();
+
 	mVisInfo.mbIsVisible = FALSE;
 	mVisInfo.mDistance = 512.0f;
 	mVisInfo.mRenderLevel = 0;
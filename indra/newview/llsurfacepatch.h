@@ -27,13 +27,14 @@
 #ifndef LL_LLSURFACEPATCH_H
 #define LL_LLSURFACEPATCH_H
 
+#include "v2math.h"
 #include "v3math.h"
 #include "v3dmath.h"
 #include "llpointer.h"
+#include "llqueuedthread.h"
 
 class LLSurface;
 class LLVOSurfacePatch;
-class LLVector2;
 class LLColor4U;
 class LLAgent;
 
@@ -87,6 +88,7 @@ public:
 	void updateGL();
 
 	void dirtyZ(); // Dirty the z values of this patch
+	void dirtyDetailTexCoords(); // The composition values changed
 	void setHasReceivedData();
 	BOOL getHasReceivedData() const;
 
@@ -103,10 +105,15 @@ public:
 	LLVector2 getTexCoords(const U32 x, const U32 y) const;
 
 	void calcNormal(const U32 x, const U32 y, const U32 stride);
+	// calcNormal() for points x_begin to x_end - 1 of row y
+	void calcNormalRow(const U32 x_begin, const U32 x_end, const U32 y, const U32 stride);
 	const LLVector3 &getNormal(const U32 x, const U32 y) const;
 
 	void eval(const U32 x, const U32 y, const U32 stride,
 				LLVector3 *vertex, LLVector3 *normal, LLVector2 *tex0, LLVector2 *tex1);
+	// Changes whenever what eval() returns may have changed, apart from
+	// the agent origin moving
+	U32 getGeometryVersion() const				{ return mGeometryVersion; }
 	
 	
 
@@ -149,11 +156,18 @@ protected:
 	BOOL mDirty;
 	BOOL mDirtyZStats;
 	BOOL mHeightsGenerated;
+	LLQueuedThread::handle_t mCompositionHandle; // Surface texture being composited
 
 	U32 mDataOffset;
 	F32 *mDataZ;
 	LLVector3 *mDataNorm;
 
+	// Detail texture coordinates eval() returns for each grid point,
+	// mV[1] is negative for points not computed yet
+	std::vector<LLVector2> mDetailTexCoords;
+
+	U32 mGeometryVersion;
+
 	// Pointer to the LLVOSurfacePatch object which is used in the new renderer.
 	LLPointer<LLVOSurfacePatch> mVObjp;
 
@@ -35,6 +35,7 @@
 #include "llcurl.h"
 #include "lldir.h"
 #include "llhttpclient.h"
+#include "llhttpscheduler.h"
 #include "llhttpstatuscodes.h"
 #include "llimage.h"
 #include "llimagej2c.h"
@@ -857,17 +858,6 @@ bool LLTextureFetchWorker::doWork(S32 param)
 	{
 		if(mCanUseHTTP)
 		{
-			//NOTE:
-			//control the number of the http requests issued for:
-			//1, not openning too many file descriptors at the same time;
-			//2, control the traffic of http so udp gets bandwidth.
-			//
-			static const S32 MAX_NUM_OF_HTTP_REQUESTS_IN_QUEUE = 32 ;
-			if(mFetcher->getNumHTTPRequests() > MAX_NUM_OF_HTTP_REQUESTS_IN_QUEUE)
-			{
-				return false ; //wait.
-			}
-
 			mFetcher->removeFromNetworkQueue(this, false);
 			
 			S32 cur_size = 0;
@@ -898,6 +888,18 @@ bool LLTextureFetchWorker::doWork(S32 param)
 			bool res = false;
 			if (!mUrl.empty())
 			{
+				//NOTE:
+				//the shared HTTP scheduler limits the number of http requests issued for:
+				//1, not openning too many file descriptors at the same time;
+				//2, control the traffic of http so udp gets bandwidth.
+				//It also lets inventory and asset fetches go ahead of textures.
+				//
+				F32 priority = mImagePriority / LLViewerFetchedTexture::maxDecodePriority();
+				if (!LLHTTPScheduler::getInstance()->acquire(LLHTTPScheduler::RC_TEXTURE, mID, mUrl, priority))
+				{
+					return false ; //wait.
+				}
+
 				mLoaded = FALSE;
 				mGetStatus = 0;
 				mGetReason.clear();
@@ -918,6 +920,8 @@ bool LLTextureFetchWorker::doWork(S32 param)
 			if (!res)
 			{
 				LL_DEBUGS("TextureFetchWorker") << "HTTP GET request failed for " << mID << llendl;
+				// The responder never runs, give back the scheduler slot here
+				mFetcher->removeFromHTTPQueue(mID);
 				resetFormattedData();
 				++mHTTPFailCount;
 				return true; // failed
@@ -1685,6 +1689,8 @@ void LLTextureFetch::removeFromHTTPQueue(const LLUUID& id, S32 received_size)
 	LLMutexLock lock(&mNetworkQueueMutex);
 	mHTTPTextureQueue.erase(id);
 	mHTTPTextureBits += received_size * 8; // Approximate - does not include header bits	
+	// Also drops the request if it is still waiting for a slot
+	LLHTTPScheduler::getInstance()->release(LLHTTPScheduler::RC_TEXTURE, id, received_size);
 }
 
 void LLTextureFetch::deleteRequest(const LLUUID& id, bool cancel)
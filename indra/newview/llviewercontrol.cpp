@@ -40,6 +40,7 @@
 #include "lldrawpoolbump.h"
 #include "lldrawpoolterrain.h"
 #include "llflexibleobject.h"
+#include "llhttpscheduler.h"
 #include "llfeaturemanager.h"
 #include "llviewershadermgr.h"
 
@@ -239,6 +240,19 @@ static bool handleBandwidthChanged(const LLSD& newvalue)
 	return true;
 }
 
+static bool handleHTTPSchedulerChanged(const LLSD& newvalue)
+{
+	LLHTTPScheduler* scheduler = LLHTTPScheduler::getInstance();
+	scheduler->setMaxRequests(gSavedSettings.getU32("HTTPMaxRequests"));
+	scheduler->setMaxRequestsPerHost(gSavedSettings.getU32("HTTPMaxRequestsPerHost"));
+	scheduler->setMaxClassRequests(LLHTTPScheduler::RC_TEXTURE, gSavedSettings.getU32("HTTPMaxTextureRequests"));
+	scheduler->setMaxClassRequests(LLHTTPScheduler::RC_INVENTORY, gSavedSettings.getU32("HTTPMaxInventoryRequests"));
+	scheduler->setMaxClassRequests(LLHTTPScheduler::RC_ASSET, gSavedSettings.getU32("HTTPMaxAssetRequests"));
+	scheduler->setMaxKbps(gSavedSettings.getF32("HTTPMaxKbps"));
+	scheduler->setMaxKbpsPerHost(gSavedSettings.getF32("HTTPMaxKbpsPerHost"));
+	return true;
+}
+
 static bool handleChatFontSizeChanged(const LLSD& newvalue)
 {
 	if(gConsole)
@@ -546,6 +560,14 @@ void settings_setup_listeners()
 	gSavedSettings.getControl("RenderTreeLODFactor")->getSignal()->connect(boost::bind(&handleTreeLODChanged, _2));
 	gSavedSettings.getControl("RenderFlexTimeFactor")->getSignal()->connect(boost::bind(&handleFlexLODChanged, _2));
 	gSavedSettings.getControl("ThrottleBandwidthKBPS")->getSignal()->connect(boost::bind(&handleBandwidthChanged, _2));
+	gSavedSettings.getControl("HTTPMaxRequests")->getSignal()->connect(boost::bind(&handleHTTPSchedulerChanged, _2));
+	gSavedSettings.getControl("HTTPMaxRequestsPerHost")->getSignal()->connect(boost::bind(&handleHTTPSchedulerChanged, _2));
+	gSavedSettings.getControl("HTTPMaxTextureRequests")->getSignal()->connect(boost::bind(&handleHTTPSchedulerChanged, _2));
+	gSavedSettings.getControl("HTTPMaxInventoryRequests")->getSignal()->connect(boost::bind(&handleHTTPSchedulerChanged, _2));
+	gSavedSettings.getControl("HTTPMaxAssetRequests")->getSignal()->connect(boost::bind(&handleHTTPSchedulerChanged, _2));
+	gSavedSettings.getControl("HTTPMaxKbps")->getSignal()->connect(boost::bind(&handleHTTPSchedulerChanged, _2));
+	gSavedSettings.getControl("HTTPMaxKbpsPerHost")->getSignal()->connect(boost::bind(&handleHTTPSchedulerChanged, _2));
+	handleHTTPSchedulerChanged(LLSD());
 	gSavedSettings.getControl("RenderGamma")->getSignal()->connect(boost::bind(&handleGammaChanged, _2));
 	gSavedSettings.getControl("RenderFogRatio")->getSignal()->connect(boost::bind(&handleFogRatioChanged, _2));
 	gSavedSettings.getControl("RenderMaxPartCount")->getSignal()->connect(boost::bind(&handleMaxPartCountChanged, _2));
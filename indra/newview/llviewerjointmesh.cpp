@@ -47,6 +47,7 @@
 #include "llviewercontrol.h"
 #include "llviewertexturelist.h"
 #include "llviewerjointmesh.h"
+#include "llviewerjointmesh_avx2.h"
 #include "llvoavatar.h"
 #include "llsky.h"
 #include "pipeline.h"
@@ -903,10 +904,17 @@ void LLViewerJointMesh::updateVectorize()
 	BOOL vectorizeEnable = gSavedSettings.getBOOL("VectorizeEnable");
 	BOOL vectorizeSkin = gSavedSettings.getBOOL("VectorizeSkin");
 
+	if (sVectorizeProcessor == 3 && !ll_has_skin_vertices_avx2())
+	{
+		// this build has no AVX2 kernel, report and run the SSE2 code
+		sVectorizeProcessor = 2;
+	}
+
 	std::string vp;
 	switch(sVectorizeProcessor)
 	{
-		case 2: vp = "SSE2"; break;					// *TODO: replace the magic #s
+		case 3: vp = "AVX2"; break;					// *TODO: replace the magic #s
+		case 2: vp = "SSE2"; break;
 		case 1: vp = "SSE"; break;
 		default: vp = "COMPILER DEFAULT"; break;
 	}
@@ -917,6 +925,9 @@ void LLViewerJointMesh::updateVectorize()
 	{
 		switch(sVectorizeProcessor)
 		{
+			case 3:
+				sUpdateGeometryFunc = &updateGeometryAVX2;
+				break;
 			case 2:
 				sUpdateGeometryFunc = &updateGeometrySSE2;
 				break;
@@ -150,13 +150,16 @@ private:
 	// with avatar vertex programs turned off (for example, most Macs).  We
 	// therefore have custom versions that use SIMD instructions.
 	//
-	// These functions require compiler options for SSE2, SSE, or neither, and
-	// hence are contained in separate individual .cpp files.  JC
+	// These functions require compiler options for SSE2, SSE, or neither,
+	// and hence are contained in separate individual .cpp files.  JC
+	// updateGeometryAVX2() runs the kernel in llviewerjointmesh_avx2.cpp,
+	// built for AVX2, and finishes with the SSE2 code.
 	static void updateGeometryOriginal(LLFace* face, LLPolyMesh* mesh);
 	// generic vector code, used for Altivec
 	static void updateGeometryVectorized(LLFace* face, LLPolyMesh* mesh);
 	static void updateGeometrySSE(LLFace* face, LLPolyMesh* mesh);
 	static void updateGeometrySSE2(LLFace* face, LLPolyMesh* mesh);
+	static void updateGeometryAVX2(LLFace* face, LLPolyMesh* mesh);
 
 	// Use a fuction pointer to indicate which version we are running.
 	static void (*sUpdateGeometryFunc)(LLFace* face, LLPolyMesh* mesh);
@@ -0,0 +1,176 @@
+/** 
+ * @file llviewerjointmesh_avx2.cpp
+ * @brief AVX2/FMA vectorized joint skinning kernel, only used when video card
+ * does not support avatar vertex programs.
+ *
+ * *NOTE: Needs AVX2 code generation, see CMakeLists.txt. Other builds skin
+ * with the SSE2 version.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ * 
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ * 
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ * 
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+// Visual Studio required settings for this file:
+// Precompiled Headers OFF
+
+//-----------------------------------------------------------------------------
+// Header Files
+//-----------------------------------------------------------------------------
+
+// Everything compiled here may use AVX2, including inline functions from
+// headers, which the linker could then pick for callers on any CPU. Keep to
+// headers without code, the rest of the skinning is in
+// llviewerjointmesh_sse2.cpp.
+#include "stdtypes.h"
+#include "lldefs.h"
+
+#include "llviewerjointmesh_avx2.h"
+
+
+#if defined(__AVX2__) && defined(__FMA__)
+
+#include <immintrin.h>
+
+// One element of eight blend matrices, each lerped between a joint matrix
+// (at joint_offset, in floats) and the next one.
+static inline __m256 blend_element(const F32* joint_mats, const __m256i& joint_offset, S32 element, const __m256& w)
+{
+	__m256 a = _mm256_i32gather_ps(joint_mats + element, joint_offset, sizeof(F32));
+	__m256 b = _mm256_i32gather_ps(joint_mats + element + 16, joint_offset, sizeof(F32));
+	return _mm256_fmadd_ps(_mm256_sub_ps(b, a), w, a); // ( b - a ) * w + a
+}
+
+// Same, when all eight vertices blend the same two joint matrices.
+static inline __m256 blend_element(const F32* joint_mat, S32 element, const __m256& w)
+{
+	__m256 a = _mm256_broadcast_ss(joint_mat + element);
+	__m256 b = _mm256_broadcast_ss(joint_mat + element + 16);
+	return _mm256_fmadd_ps(_mm256_sub_ps(b, a), w, a);
+}
+
+// Eight LLVector3s, transposed into x, y and z registers. Each 128-bit half
+// holds four of them, see Intel's "3D Vector Normalization Using 256-Bit
+// Intel AVX".
+static inline void load_vectors(const F32* v, __m256& x, __m256& y, __m256& z)
+{
+	__m256 m03 = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(v)), _mm_loadu_ps(v + 12), 1);		// x0 y0 z0 x1
+	__m256 m14 = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(v + 4)), _mm_loadu_ps(v + 16), 1);	// y1 z1 x2 y2
+	__m256 m25 = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(v + 8)), _mm_loadu_ps(v + 20), 1);	// z2 x3 y3 z3
+
+	__m256 xy = _mm256_shuffle_ps(m14, m25, _MM_SHUFFLE(2, 1, 3, 2));	// x2 y2 x3 y3
+	__m256 yz = _mm256_shuffle_ps(m03, m14, _MM_SHUFFLE(1, 0, 2, 1));	// y0 z0 y1 z1
+	x = _mm256_shuffle_ps(m03, xy, _MM_SHUFFLE(2, 0, 3, 0));
+	y = _mm256_shuffle_ps(yz, xy, _MM_SHUFFLE(3, 1, 2, 0));
+	z = _mm256_shuffle_ps(yz, m25, _MM_SHUFFLE(3, 0, 3, 1));
+}
+
+BOOL ll_has_skin_vertices_avx2()
+{
+	return TRUE;
+}
+
+U32 ll_skin_vertices_avx2(const F32* joint_mats, const F32* weights,
+						  const F32* coords, const F32* normals, U32 num_vertices,
+						  U8* o_vertices, U32 vertex_stride,
+						  U8* o_normals, U32 normal_stride)
+{
+	// Eight vertices at a time, each with its own blend matrix. The order of
+	// operations follows the SSE2 version, with fused multiply-adds.
+	U32 index = 0;
+	for ( ; index + 8 <= num_vertices; index += 8)
+	{
+		const __m256 weight = _mm256_loadu_ps(weights + index);
+		const __m256 joint = _mm256_floor_ps(weight);
+		const __m256 w = _mm256_sub_ps(weight, joint);
+		const __m256i joint_offset = _mm256_slli_epi32(_mm256_cvttps_epi32(joint), 4); // 16 floats per matrix
+
+		// vertices are sorted by joint, so usually all eight share one pair
+		const __m256 first_joint = _mm256_permutevar8x32_ps(joint, _mm256_setzero_si256());
+		const BOOL same_joint = _mm256_movemask_ps(_mm256_cmp_ps(joint, first_joint, _CMP_EQ_OQ)) == 0xff;
+		const F32* joint_mat = joint_mats + _mm256_cvtsi256_si32(joint_offset);
+
+		__m256 cx, cy, cz;
+		load_vectors(coords + index * 3, cx, cy, cz);
+		__m256 nx, ny, nz;
+		load_vectors(normals + index * 3, nx, ny, nz);
+
+		F32 o_vertex[3][8];
+		F32 o_normal[3][8];
+		for (S32 col = VX; col <= VZ; ++col)
+		{
+			__m256 mx, my, mz, mw;
+			if (same_joint)
+			{
+				mx = blend_element(joint_mat, VX * 4 + col, w);
+				my = blend_element(joint_mat, VY * 4 + col, w);
+				mz = blend_element(joint_mat, VZ * 4 + col, w);
+				mw = blend_element(joint_mat, VW * 4 + col, w);
+			}
+			else
+			{
+				mx = blend_element(joint_mats, joint_offset, VX * 4 + col, w);
+				my = blend_element(joint_mats, joint_offset, VY * 4 + col, w);
+				mz = blend_element(joint_mats, joint_offset, VZ * 4 + col, w);
+				mw = blend_element(joint_mats, joint_offset, VW * 4 + col, w);
+			}
+
+			__m256 v = _mm256_fmadd_ps(cx, mx, mw); // ( ax * vx ) + vw
+			v = _mm256_fmadd_ps(cy, my, v);
+			v = _mm256_fmadd_ps(cz, mz, v);
+			_mm256_storeu_ps(o_vertex[col], v);
+
+			__m256 n = _mm256_mul_ps(nx, mx);
+			n = _mm256_fmadd_ps(ny, my, n);
+			n = _mm256_fmadd_ps(nz, mz, n);
+			_mm256_storeu_ps(o_normal[col], n);
+		}
+
+		for (S32 lane = 0; lane < 8; ++lane)
+		{
+			F32* o_vertex_lane = (F32*)(o_vertices + vertex_stride * (index + lane));
+			F32* o_normal_lane = (F32*)(o_normals + normal_stride * (index + lane));
+			for (S32 col = VX; col <= VZ; ++col)
+			{
+				o_vertex_lane[col] = o_vertex[col][lane];
+				o_normal_lane[col] = o_normal[col][lane];
+			}
+		}
+	}
+
+	return index;
+}
+
+#else
+
+BOOL ll_has_skin_vertices_avx2()
+{
+	return FALSE;
+}
+
+U32 ll_skin_vertices_avx2(const F32* joint_mats, const F32* weights,
+						  const F32* coords, const F32* normals, U32 num_vertices,
+						  U8* o_vertices, U32 vertex_stride,
+						  U8* o_normals, U32 normal_stride)
+{
+	return 0;
+}
+
+#endif
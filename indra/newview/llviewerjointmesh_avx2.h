@@ -0,0 +1,48 @@
+/**
+ * @file llviewerjointmesh_avx2.h
+ * @brief AVX2/FMA vectorized joint skinning kernel.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLVIEWERJOINTMESH_AVX2_H
+#define LL_LLVIEWERJOINTMESH_AVX2_H
+
+#include "stdtypes.h"
+
+// Whether this build has the AVX2 kernel. Without it ll_skin_vertices_avx2()
+// skins nothing.
+BOOL ll_has_skin_vertices_avx2();
+
+// Skins vertices eight at a time, from the start of the mesh, and returns how
+// many it skinned. The caller skins the rest.
+// joint_mats: one 4x4 matrix (16 floats) per joint, as LLV4Matrix4
+// weights: joint index plus blend weight toward the next joint, per vertex
+// coords, normals: three floats per vertex
+// o_vertices, o_normals: first output vector, vertex_stride and normal_stride
+// bytes apart
+U32 ll_skin_vertices_avx2(const F32* joint_mats, const F32* weights,
+						  const F32* coords, const F32* normals, U32 num_vertices,
+						  U8* o_vertices, U32 vertex_stride,
+						  U8* o_normals, U32 normal_stride);
+
+#endif // LL_LLVIEWERJOINTMESH_AVX2_H
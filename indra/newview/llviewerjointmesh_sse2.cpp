@@ -38,6 +38,7 @@
 #include "llviewerprecompiledheaders.h"
 
 #include "llviewerjointmesh.h"
+#include "llviewerjointmesh_avx2.h"
 
 // project includes
 #include "llface.h"
@@ -67,8 +68,8 @@ inline void matrix_translate(LLV4Matrix4& m, const LLMatrix4* w, const LLVector3
 	m.mV[VW] = _mm_add_ps(m.mV[VW], _mm_mul_ps(_mm_set1_ps(j.mV[VZ]), m.mV[VZ]));
 }
 
-// static
-void LLViewerJointMesh::updateGeometrySSE2(LLFace *face, LLPolyMesh *mesh)
+// Uploads the joint pivots/matrices and returns them.
+static const LLV4Matrix4* upload_joint_matrices(LLPolyMesh *mesh)
 {
 	// This cannot be a file-level static because it will be initialized
 	// before main() using SSE code, which will crash on non-SSE processors.
@@ -83,31 +84,67 @@ void LLViewerJointMesh::updateGeometrySSE2(LLFace *face, LLPolyMesh *mesh)
 				joint_data[j]->mSkinJoint->mRootToJointSkinOffset
 				: joint_data[j+1]->mSkinJoint->mRootToParentJointSkinOffset);
 	}
+	return sJointMat;
+}
 
+// Skins the mesh's vertices from index on.
+static void skin_vertices(const LLV4Matrix4* joint_mats, LLPolyMesh *mesh, U32 index,
+						  LLStrider<LLVector3>& o_vertices, LLStrider<LLVector3>& o_normals)
+{
 	F32					weight		= F32_MAX;
 	LLV4Matrix4			blend_mat;
 
-	LLStrider<LLVector3> o_vertices;
-	LLStrider<LLVector3> o_normals;
-
-	LLVertexBuffer *buffer = face->mVertexBuffer;
-	buffer->getVertexStrider(o_vertices,  mesh->mFaceVertexOffset);
-	buffer->getNormalStrider(o_normals,   mesh->mFaceVertexOffset);
-
 	const F32*			weights			= mesh->getWeights();
 	const LLVector3*	coords			= mesh->getCoords();
 	const LLVector3*	normals			= mesh->getNormals();
-	for (U32 index = 0, index_end = mesh->getNumVertices(); index < index_end; ++index)
+	for (U32 index_end = mesh->getNumVertices(); index < index_end; ++index)
 	{
 		if( weight != weights[index])
 		{
 			S32 joint = llfloor(weight = weights[index]);
-			blend_mat.lerp(sJointMat[joint], sJointMat[joint+1], weight - joint);
+			blend_mat.lerp(joint_mats[joint], joint_mats[joint+1], weight - joint);
 		}
 		blend_mat.multiply(coords[index], o_vertices[index]);
 		((LLV4Matrix3)blend_mat).multiply(normals[index], o_normals[index]);
 	}
-	
+}
+
+// static
+void LLViewerJointMesh::updateGeometrySSE2(LLFace *face, LLPolyMesh *mesh)
+{
+	const LLV4Matrix4* joint_mats = upload_joint_matrices(mesh);
+
+	LLStrider<LLVector3> o_vertices;
+	LLStrider<LLVector3> o_normals;
+
+	LLVertexBuffer *buffer = face->mVertexBuffer;
+	buffer->getVertexStrider(o_vertices,  mesh->mFaceVertexOffset);
+	buffer->getNormalStrider(o_normals,   mesh->mFaceVertexOffset);
+
+	skin_vertices(joint_mats, mesh, 0, o_vertices, o_normals);
+
+	//setBuffer(0) called in LLVOAvatar::renderSkinned
+}
+
+// static
+void LLViewerJointMesh::updateGeometryAVX2(LLFace *face, LLPolyMesh *mesh)
+{
+	const LLV4Matrix4* joint_mats = upload_joint_matrices(mesh);
+
+	LLStrider<LLVector3> o_vertices;
+	LLStrider<LLVector3> o_normals;
+
+	LLVertexBuffer *buffer = face->mVertexBuffer;
+	buffer->getVertexStrider(o_vertices,  mesh->mFaceVertexOffset);
+	buffer->getNormalStrider(o_normals,   mesh->mFaceVertexOffset);
+
+	// eight vertices at a time in llviewerjointmesh_avx2.cpp, the rest here
+	U32 index = ll_skin_vertices_avx2(&joint_mats[0].mMatrix[0][0], mesh->getWeights(),
+									  mesh->getCoords()->mV, mesh->getNormals()->mV, mesh->getNumVertices(),
+									  (U8*)o_vertices.get(), o_vertices.getSkip(),
+									  (U8*)o_normals.get(), o_normals.getSkip());
+	skin_vertices(joint_mats, mesh, index, o_vertices, o_normals);
+
 	//setBuffer(0) called in LLVOAvatar::renderSkinned
 }
 
@@ -118,4 +155,9 @@ void LLViewerJointMesh::updateGeometrySSE2(LLFace *face, LLPolyMesh *mesh)
 	LLViewerJointMesh::updateGeometryVectorized(face, mesh);
 }
 
+void LLViewerJointMesh::updateGeometryAVX2(LLFace *face, LLPolyMesh *mesh)
+{
+	LLViewerJointMesh::updateGeometryVectorized(face, mesh);
+}
+
 #endif
@@ -44,6 +44,7 @@
 #include "llmaterialtable.h"
 #include "llmutelist.h"
 #include "llnamevalue.h"
+#include "llobjectupdatedecoder.h"
 #include "llprimitive.h"
 #include "llquantize.h"
 #include "llregionhandle.h"
@@ -758,7 +759,7 @@ U32 LLViewerObject::processUpdateMessage(LLMessageSystem *mesgsys,
 					 void **user_data,
 					 U32 block_num,
 					 const EObjectUpdateType update_type,
-					 LLDataPacker *dp)
+					 LLDataPackerBinaryBuffer *dp)
 {
 	LLMemType mt(LLMemType::MTYPE_OBJECT);
 	U32 retval = 0x0;
@@ -1346,20 +1347,14 @@ U32 LLViewerObject::processUpdateMessage(LLMessageSystem *mesgsys,
 	}
 	else
 	{
-		// handle the compressed case
+		// handle the compressed case, the fixed fields are decoded straight
+		// from the block
 		LLUUID sound_uuid;
 		LLUUID	owner_id;
 		F32    gain = 0;
 		U8     sound_flags = 0;
 		F32		cutoff = 0;
 
-		U16 val[4];
-
-		U8		state;
-
-		dp->unpackU8(state, "State");
-		mState = state;
-
 		switch(update_type)
 		{
 			case OUT_TERSE_IMPROVED:
@@ -1367,43 +1362,23 @@ U32 LLViewerObject::processUpdateMessage(LLMessageSystem *mesgsys,
 #ifdef DEBUG_UPDATE_TYPE
 				llinfos << "CompTI:" << getID() << llendl;
 #endif
-				U8		value;
-				dp->unpackU8(value, "agent");
-				if (value)
+				LLTerseObjectUpdate update;
+				if (!decode_terse_object_update(dp->getBuffer(), dp->getBufferSize(), update))
 				{
-					LLVector4 collision_plane;
-					dp->unpackVector4(collision_plane, "Plane");
-					((LLVOAvatar*)this)->setFootPlane(collision_plane);
+					llwarns << "Truncated terse update for " << getID() << llendl;
+					return retval;
+				}
+				mState = update.mState;
+				if (update.mHasFootPlane)
+				{
+					((LLVOAvatar*)this)->setFootPlane(update.mFootPlane);
 				}
 				test_pos_parent = getPosition();
-				dp->unpackVector3(new_pos_parent, "Pos");
-				dp->unpackU16(val[VX], "VelX");
-				dp->unpackU16(val[VY], "VelY");
-				dp->unpackU16(val[VZ], "VelZ");
-				setVelocity(U16_to_F32(val[VX], -128.f, 128.f),
-							U16_to_F32(val[VY], -128.f, 128.f),
-							U16_to_F32(val[VZ], -128.f, 128.f));
-				dp->unpackU16(val[VX], "AccX");
-				dp->unpackU16(val[VY], "AccY");
-				dp->unpackU16(val[VZ], "AccZ");
-				setAcceleration(U16_to_F32(val[VX], -64.f, 64.f),
-								U16_to_F32(val[VY], -64.f, 64.f),
-								U16_to_F32(val[VZ], -64.f, 64.f));
-
-				dp->unpackU16(val[VX], "ThetaX");
-				dp->unpackU16(val[VY], "ThetaY");
-				dp->unpackU16(val[VZ], "ThetaZ");
-				dp->unpackU16(val[VS], "ThetaS");
-				new_rot.mQ[VX] = U16_to_F32(val[VX], -1.f, 1.f);
-				new_rot.mQ[VY] = U16_to_F32(val[VY], -1.f, 1.f);
-				new_rot.mQ[VZ] = U16_to_F32(val[VZ], -1.f, 1.f);
-				new_rot.mQ[VS] = U16_to_F32(val[VS], -1.f, 1.f);
-				dp->unpackU16(val[VX], "AccX");
-				dp->unpackU16(val[VY], "AccY");
-				dp->unpackU16(val[VZ], "AccZ");
-				setAngularVelocity(	U16_to_F32(val[VX], -64.f, 64.f),
-									U16_to_F32(val[VY], -64.f, 64.f),
-									U16_to_F32(val[VZ], -64.f, 64.f));
+				new_pos_parent = update.mPosition;
+				setVelocity(update.mVelocity);
+				setAcceleration(update.mAcceleration);
+				new_rot = update.mRotation;
+				setAngularVelocity(update.mAngularVelocity);
 			}
 			break;
 			case OUT_FULL_COMPRESSED:
@@ -1412,9 +1387,21 @@ U32 LLViewerObject::processUpdateMessage(LLMessageSystem *mesgsys,
 #ifdef DEBUG_UPDATE_TYPE
 				llinfos << "CompFull:" << getID() << llendl;
 #endif
-				dp->unpackU32(crc, "CRC");
+				LLCompressedObjectUpdate update;
+				S32 fixed_size = decode_compressed_object_update(dp->getBuffer(), dp->getBufferSize(), update);
+				if (!fixed_size)
+				{
+					llwarns << "Truncated compressed update for " << getID() << llendl;
+					return retval;
+				}
+				// the variable length fields that follow go through the packer
+				dp->reset();
+				dp->skip(fixed_size, "Fixed");
+
+				mState = update.mState;
+				crc = update.mCRC;
 				mTotalCRC = crc;
-				dp->unpackU8(material, "Material");
+				material = update.mMaterial;
 				U8 old_material = getMaterial();
 				if (old_material != material)
 				{
@@ -1424,34 +1411,23 @@ U32 LLViewerObject::processUpdateMessage(LLMessageSystem *mesgsys,
 						gPipeline.markMoved(mDrawable, FALSE); // undamped
 					}
 				}
-				dp->unpackU8(click_action, "ClickAction");
+				click_action = update.mClickAction;
 				setClickAction(click_action);
-				dp->unpackVector3(new_scale, "Scale");
-				dp->unpackVector3(new_pos_parent, "Pos");
-				LLVector3 vec;
-				dp->unpackVector3(vec, "Rot");
-				new_rot.unpackFromVector3(vec);
+				new_scale = update.mScale;
+				new_pos_parent = update.mPosition;
+				new_rot = update.mRotation;
 				setAcceleration(LLVector3::zero);
 
-				U32 value;
-				dp->unpackU32(value, "SpecialCode");
+				U32 value = update.mSpecialCode;
 				dp->setPassFlags(value);
-				dp->unpackUUID(owner_id, "Owner");
+				owner_id = update.mOwnerID;
 
-				if (value & 0x80)
+				if (update.mHasAngularVelocity)
 				{
-					dp->unpackVector3(vec, "Omega");
-					setAngularVelocity(vec);
+					setAngularVelocity(update.mAngularVelocity);
 				}
 
-				if (value & 0x20)
-				{
-					dp->unpackU32(parent_id, "ParentID");
-				}
-				else
-				{
-					parent_id = 0;
-				}
+				parent_id = update.mParentID;
 
 				S32 sp_size;
 				U32 size;
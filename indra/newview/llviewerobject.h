@@ -49,6 +49,7 @@ class LLAudioSource;
 class LLAudioSourceVO;
 class LLBBox;
 class LLDataPacker;
+class LLDataPackerBinaryBuffer;
 class LLColor4;
 class LLFrameTimer;
 class LLDrawable;
@@ -167,7 +168,7 @@ public:
 										void **user_data,
 										U32 block_num,
 										const EObjectUpdateType update_type,
-										LLDataPacker *dp);
+										LLDataPackerBinaryBuffer *dp);
 
 
 	virtual BOOL    isActive() const; // Whether this object needs to do an idleUpdate.
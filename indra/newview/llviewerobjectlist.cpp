@@ -63,6 +63,7 @@
 #include "u64.h"
 #include "llviewertexturelist.h"
 #include "lldatapacker.h"
+#include "llobjectupdatedecoder.h"
 #ifdef LL_STANDALONE
 #include <zlib.h>
 #else
@@ -88,8 +89,8 @@ extern LLPipeline	gPipeline;
 
 // Statics for object lookup tables.
 U32						LLViewerObjectList::sSimulatorMachineIndex = 1; // Not zero deliberately, to speed up index check.
-std::map<U64, U32>			LLViewerObjectList::sIPAndPortToIndex;
-std::map<U64, LLUUID>	LLViewerObjectList::sIndexAndLocalIDToUUID;
+LLFlatHashMap<U64, U32>		LLViewerObjectList::sIPAndPortToIndex;
+LLFlatHashMap<U64, LLUUID>	LLViewerObjectList::sIndexAndLocalIDToUUID;
 
 LLViewerObjectList::LLViewerObjectList()
 {
@@ -140,7 +141,8 @@ void LLViewerObjectList::getUUIDFromLocal(LLUUID &id,
 
 	U64	indexid = (((U64)index) << 32) | (U64)local_id;
 
-	id = get_if_there(sIndexAndLocalIDToUUID, indexid, LLUUID::null);
+	const LLUUID* found = sIndexAndLocalIDToUUID.find(indexid);
+	id = found ? *found : LLUUID::null;
 }
 
 U64 LLViewerObjectList::getIndex(const U32 local_id,
@@ -179,21 +181,21 @@ BOOL LLViewerObjectList::removeFromLocalIDTable(const LLViewerObject &object)
 		
 		U64	indexid = (((U64)index) << 32) | (U64)local_id;
 		
-		std::map<U64, LLUUID>::iterator iter = sIndexAndLocalIDToUUID.find(indexid);
-		if (iter == sIndexAndLocalIDToUUID.end())
+		const LLUUID* found = sIndexAndLocalIDToUUID.find(indexid);
+		if (!found)
 		{
 			return FALSE;
 		}
 		
 		// Found existing entry
-		if (iter->second == object.getID())
+		if (*found == object.getID())
 		{   // Full UUIDs match, so remove the entry
-			sIndexAndLocalIDToUUID.erase(iter);
+			sIndexAndLocalIDToUUID.erase(indexid);
 			return TRUE;
 		}
 		// UUIDs did not match - this would zap a valid entry, so don't erase it
 		//llinfos << "Tried to erase entry where id in table (" 
-		//		<< iter->second	<< ") did not match object " << object.getID() << llendl;
+		//		<< *found	<< ") did not match object " << object.getID() << llendl;
 	}
 	
 	return FALSE ;
@@ -229,7 +231,7 @@ void LLViewerObjectList::processUpdateCore(LLViewerObject* objectp,
 										   void** user_data, 
 										   U32 i, 
 										   const EObjectUpdateType update_type, 
-										   LLDataPacker* dpp, 
+										   LLDataPackerBinaryBuffer* dpp, 
 										   BOOL just_created)
 {
 	LLMemType mt(LLMemType::MTYPE_OBJECT_PROCESS_UPDATE_CORE);
@@ -344,7 +346,7 @@ void LLViewerObjectList::processObjectUpdate(LLMessageSystem *mesgsys,
 
 	U8 compressed_dpbuffer[2048];
 	LLDataPackerBinaryBuffer compressed_dp(compressed_dpbuffer, 2048);
-	LLDataPacker *cached_dpp = NULL;
+	LLDataPackerBinaryBuffer *cached_dpp = NULL;
 	
 	for (i = 0; i < num_objects; i++)
 	{
@@ -360,57 +362,66 @@ void LLViewerObjectList::processObjectUpdate(LLMessageSystem *mesgsys,
 		
 			// Lookup data packer and add this id to cache miss lists if necessary.
 			cached_dpp = regionp->getDP(id, crc);
-			if (cached_dpp)
+			if (!cached_dpp)
 			{
-				cached_dpp->reset();
-				cached_dpp->unpackUUID(fullid, "ID");
-				cached_dpp->unpackU32(local_id, "LocalID");
-				cached_dpp->unpackU8(pcode, "PCode");
+				continue; // no data packer, skip this object
 			}
-			else
+			if (!decode_compressed_object_update_ids(cached_dpp->getBuffer(), cached_dpp->getBufferSize(),
+													 fullid, local_id, pcode))
 			{
-				continue; // no data packer, skip this object
+				llwarns << "Truncated cached object " << id << llendl;
+				continue;
 			}
 		}
 		else if (compressed)
 		{
 			U8							compbuffer[2048];
-			S32							uncompressed_length = 2048;
-			S32							compressed_length;
-			compressed_dp.reset();
+			S32							data_length;
 
 			U32 flags = 0;
 			if (update_type != OUT_TERSE_IMPROVED)
 			{
 				mesgsys->getU32Fast(_PREHASH_ObjectData, _PREHASH_UpdateFlags, flags, i);
 			}
+
+			// Decode the block where the message keeps it, it is only
+			// copied if the message can't hand it out.
+			const U8* data = mesgsys->getBinaryDataPointerFast(_PREHASH_ObjectData, _PREHASH_Data, data_length, i);
+			if (!data)
+			{
+				data_length = llclamp(mesgsys->getSizeFast(_PREHASH_ObjectData, i, _PREHASH_Data), 0, 2048);
+				mesgsys->getBinaryDataFast(_PREHASH_ObjectData, _PREHASH_Data, compbuffer, 0, i, 2048);
+				data = compbuffer;
+			}
 			
 			if (flags & FLAGS_ZLIB_COMPRESSED)
 			{
-				compressed_length = mesgsys->getSizeFast(_PREHASH_ObjectData, i, _PREHASH_Data);
-				mesgsys->getBinaryDataFast(_PREHASH_ObjectData, _PREHASH_Data, compbuffer, 0, i);
-				uncompressed_length = 2048;
-				uncompress(compressed_dpbuffer, (unsigned long *)&uncompressed_length,
-						   compbuffer, compressed_length);
-				compressed_dp.assignBuffer(compressed_dpbuffer, uncompressed_length);
+				uLongf uncompressed_length = 2048;
+				uncompress(compressed_dpbuffer, &uncompressed_length, data, data_length);
+				compressed_dp.assignBuffer(compressed_dpbuffer, (S32)uncompressed_length);
 			}
 			else
 			{
-				uncompressed_length = mesgsys->getSizeFast(_PREHASH_ObjectData, i, _PREHASH_Data);
-				mesgsys->getBinaryDataFast(_PREHASH_ObjectData, _PREHASH_Data, compressed_dpbuffer, 0, i);
-				compressed_dp.assignBuffer(compressed_dpbuffer, uncompressed_length);
+				// only read from, as the data packer doesn't know const
+				compressed_dp.assignBuffer(const_cast<U8*>(data), data_length);
 			}
 
-
 			if (update_type != OUT_TERSE_IMPROVED)
 			{
-				compressed_dp.unpackUUID(fullid, "ID");
-				compressed_dp.unpackU32(local_id, "LocalID");
-				compressed_dp.unpackU8(pcode, "PCode");
+				if (!decode_compressed_object_update_ids(compressed_dp.getBuffer(), compressed_dp.getBufferSize(),
+														 fullid, local_id, pcode))
+				{
+					llwarns << "Truncated compressed object update from " << mesgsys->getSender() << llendl;
+					continue;
+				}
 			}
 			else
 			{
-				compressed_dp.unpackU32(local_id, "LocalID");
+				if (!decode_terse_object_update_id(compressed_dp.getBuffer(), compressed_dp.getBufferSize(), local_id))
+				{
+					llwarns << "Truncated terse object update from " << mesgsys->getSender() << llendl;
+					continue;
+				}
 				getUUIDFromLocal(fullid,
 								 local_id,
 								 gMessageSystem->getSenderIP(),
@@ -730,6 +741,9 @@ void LLViewerObjectList::update(LLAgent &agent, LLWorld &world)
 		}
 	}
 
+	// avatars queue their animation during the idle updates, to be run in parallel
+	LLVOAvatar::beginIdleUpdates();
+
 	if (gSavedSettings.getBOOL("FreezeTime"))
 	{
 		for (std::vector<LLViewerObject*>::iterator iter = idle_list.begin();
@@ -742,6 +756,7 @@ void LLViewerObjectList::update(LLAgent &agent, LLWorld &world)
 				objectp->idleUpdate(agent, world, frame_time);
 			}
 		}
+		LLVOAvatar::endIdleUpdates();
 	}
 	else
 	{
@@ -759,6 +774,8 @@ void LLViewerObjectList::update(LLAgent &agent, LLWorld &world)
 				num_active_objects++;
 			}
 		}
+		LLVOAvatar::endIdleUpdates();
+
 		for (std::vector<LLViewerObject*>::iterator kill_iter = kill_list.begin();
 			kill_iter != kill_list.end(); kill_iter++)
 		{
@@ -28,6 +28,7 @@
 
 #include "llviewerpartsim.h"
 
+#include "lljobpool.h"
 #include "llviewercontrol.h"
 
 #include "llagent.h"
@@ -52,9 +53,9 @@ S32 LLViewerPartSim::sParticleCount2 = 0;
 // This controls how greedy individual particle burst sources are allowed to be, and adapts according to how near the particle-count limit we are.
 F32 LLViewerPartSim::sParticleAdaptiveRate = 0.0625f;
 F32 LLViewerPartSim::sParticleBurstRate = 0.5f;
+S32 LLViewerPartSim::sPartCountLimit = 8192;
 
 //static
-const S32 LLViewerPartSim::MAX_PART_COUNT = 8192;
 const F32 LLViewerPartSim::PART_THROTTLE_THRESHOLD = 0.9f;
 const F32 LLViewerPartSim::PART_ADAPT_RATE_MULT = 2.0f;
 
@@ -75,22 +76,17 @@ F32 calc_desired_size(LLViewerCamera* camera, LLVector3 pos, LLVector2 scale)
 LLViewerPart::LLViewerPart() :
 	mPartID(0),
 	mLastUpdateTime(0.f),
-	mSkipOffset(0.f),
 	mVPCallback(NULL),
 	mImagep(NULL)
 {
 	LLMemType mt(LLMemType::MTYPE_PARTICLES);
 	mPartSourcep = NULL;
-
-	++LLViewerPartSim::sParticleCount2 ;
 }
 
 LLViewerPart::~LLViewerPart()
 {
 	LLMemType mt(LLMemType::MTYPE_PARTICLES);
 	mPartSourcep = NULL;
-
-	--LLViewerPartSim::sParticleCount2 ;
 }
 
 void LLViewerPart::init(LLPointer<LLViewerPartSource> sourcep, LLViewerTexture *imagep, LLVPCallback cb)
@@ -101,7 +97,6 @@ void LLViewerPart::init(LLPointer<LLViewerPartSource> sourcep, LLViewerTexture *
 	mFlags = 0x00f;
 	mLastUpdateTime = 0.f;
 	mMaxAge = 10.f;
-	mSkipOffset = 0.0f;
 
 	mVPCallback = cb;
 	mPartSourcep = sourcep;
@@ -183,9 +178,10 @@ LLViewerPartGroup::~LLViewerPartGroup()
 	S32 count = (S32) mParticles.size();
 	for(S32 i = 0 ; i < count ; i++)
 	{
-		delete mParticles[i] ;
+		LLViewerPartSim::getInstance()->releasePart(mParticles[i]);
 	}
 	mParticles.clear();
+	mPartArray.clear();
 	
 	LLViewerPartSim::decPartCount(count);
 }
@@ -203,9 +199,9 @@ void LLViewerPartGroup::cleanup()
 	}
 }
 
+// Called from simulate(), so no LLMemType
 BOOL LLViewerPartGroup::posInGroup(const LLVector3 &pos, const F32 desired_size)
 {
-	LLMemType mt(LLMemType::MTYPE_PARTICLES);
 	if ((pos.mV[VX] < mMinObjPos.mV[VX])
 		|| (pos.mV[VY] < mMinObjPos.mV[VY])
 		|| (pos.mV[VZ] < mMinObjPos.mV[VZ]))
@@ -253,150 +249,207 @@ BOOL LLViewerPartGroup::addPart(LLViewerPart* part, F32 desired_size)
 	gPipeline.markRebuild(mVOPartGroupp->mDrawable, LLDrawable::REBUILD_ALL, TRUE);
 	
 	mParticles.push_back(part);
-	part->mSkipOffset=mSkippedTime;
+	S32 i = mPartArray.add(*part, part->mPosAgent, part->mVelocity, part->mAccel,
+						   part->mColor, part->mScale, part->mLastUpdateTime, mSkippedTime);
+	if (part->mVPCallback)
+	{
+		mPartArray.setFlags(i, part->mFlags | LLPartData::LL_PART_CALLBACK_MASK);
+	}
 	LLViewerPartSim::incPartCount(1);
 	return TRUE;
 }
 
+void LLViewerPartGroup::loadPart(S32 i)
+{
+	LLViewerPart* part = mParticles[i];
+	part->mPosAgent = mPartArray.getPosition(i);
+	part->mVelocity = mPartArray.getVelocity(i);
+	part->mColor = mPartArray.getColor(i);
+	part->mScale = mPartArray.getScale(i);
+	part->mLastUpdateTime = mPartArray.getAge(i);
+	part->mFlags = mPartArray.getFlags(i) & ~LLPartData::LL_PART_CALLBACK_MASK;
+}
 
-void LLViewerPartGroup::updateParticles(const F32 lastdt)
+// Only position, velocity and flags are changed by the per particle passes.
+void LLViewerPartGroup::storePart(S32 i)
+{
+	const LLViewerPart* part = mParticles[i];
+	mPartArray.setPosition(i, part->mPosAgent);
+	mPartArray.setVelocity(i, part->mVelocity);
+
+	U32 flags = part->mFlags;
+	if (part->mVPCallback && flags != LLPartData::LL_PART_DEAD_MASK)
+	{
+		flags |= LLPartData::LL_PART_CALLBACK_MASK;
+	}
+	mPartArray.setFlags(i, flags);
+}
+
+void LLViewerPartGroup::removePart(S32 i)
+{
+	mParticles[i] = mParticles.back();
+	mParticles.pop_back();
+	mPartArray.remove(i);
+}
+
+
+// Following the source, wind, targets and callbacks need more than the
+// particle's own state, so those particles get a per particle pass before
+// the batch step.
+const U32 PRE_STEP_FLAGS = LLPartData::LL_PART_FOLLOW_SRC_MASK |
+						   LLPartData::LL_PART_WIND_MASK |
+						   LLPartData::LL_PART_TARGET_POS_MASK |
+						   LLPartData::LL_PART_TARGET_LINEAR_MASK |
+						   LLPartData::LL_PART_CALLBACK_MASK;
+
+void LLViewerPartGroup::beginUpdate(const F32 lastdt)
 {
 	LLMemType mt(LLMemType::MTYPE_PARTICLES);
-	F32 dt;
-	
-	LLVector3 gravity(0.f, 0.f, GRAVITY);
 
 	LLViewerPartSim::checkParticleCount(mParticles.size());
 
-	LLViewerCamera* camera = LLViewerCamera::getInstance();
-	LLViewerRegion *regionp = getRegion();
-	S32 end = (S32) mParticles.size();
-	for (S32 i = 0 ; i < (S32)mParticles.size();)
+	mPartArray.beginStep(lastdt + mSkippedTime);
+
+	// Callbacks are free to touch anything, so they run here rather than
+	// in simulate()
+	S32 count = mPartArray.size();
+	for (S32 i = 0; i < count; i++)
 	{
-		LLVector3 a(0.f, 0.f, 0.f);
-		LLViewerPart* part = mParticles[i] ;
+		if (mPartArray.getFlags(i) & LLPartData::LL_PART_CALLBACK_MASK)
+		{
+			preStep(i);
+		}
+	}
+}
 
-		dt = lastdt + mSkippedTime - part->mSkipOffset;
-		part->mSkipOffset = 0.f;
+void LLViewerPartGroup::preStep(S32 i)
+{
+	loadPart(i);
+	LLViewerPart* part = mParticles[i];
+	const F32 dt = mPartArray.getStep(i);
+	const F32 frac = (part->mLastUpdateTime + dt) / part->mMaxAge;
 
-		// Update current time
-		const F32 cur_time = part->mLastUpdateTime + dt;
-		const F32 frac = cur_time / part->mMaxAge;
+	// "Drift" the object based on the source object
+	if (part->mFlags & LLPartData::LL_PART_FOLLOW_SRC_MASK)
+	{
+		part->mPosAgent = part->mPartSourcep->mPosAgent;
+		part->mPosAgent += part->mPosOffset;
+	}
 
-		// "Drift" the object based on the source object
-		if (part->mFlags & LLPartData::LL_PART_FOLLOW_SRC_MASK)
-		{
-			part->mPosAgent = part->mPartSourcep->mPosAgent;
-			part->mPosAgent += part->mPosOffset;
-		}
+	// Do a custom callback if we have one...
+	if (part->mVPCallback)
+	{
+		(*part->mVPCallback)(*part, dt);
+	}
 
-		// Do a custom callback if we have one...
-		if (part->mVPCallback)
-		{
-			(*part->mVPCallback)(*part, dt);
-		}
+	if (part->mFlags & LLPartData::LL_PART_WIND_MASK)
+	{
+		LLViewerRegion *regionp = getRegion();
+		part->mVelocity *= 1.f - 0.1f*dt;
+		part->mVelocity += 0.1f*dt*regionp->mWind.getVelocity(regionp->getPosRegionFromAgent(part->mPosAgent));
+	}
 
-		if (part->mFlags & LLPartData::LL_PART_WIND_MASK)
-		{
-			LLVector3 tempVel(part->mVelocity);
-			part->mVelocity *= 1.f - 0.1f*dt;
-			part->mVelocity += 0.1f*dt*regionp->mWind.getVelocity(regionp->getPosRegionFromAgent(part->mPosAgent));
-		}
+	// Now do interpolation towards a target
+	if (part->mFlags & LLPartData::LL_PART_TARGET_POS_MASK)
+	{
+		F32 remaining = part->mMaxAge - part->mLastUpdateTime;
+		F32 step = dt / remaining;
 
-		// Now do interpolation towards a target
-		if (part->mFlags & LLPartData::LL_PART_TARGET_POS_MASK)
-		{
-			F32 remaining = part->mMaxAge - part->mLastUpdateTime;
-			F32 step = dt / remaining;
+		step = llclamp(step, 0.f, 0.1f);
+		step *= 5.f;
+		// we want a velocity that will result in reaching the target in the 
+		// Interpolate towards the target.
+		LLVector3 delta_pos = part->mPartSourcep->mTargetPosAgent - part->mPosAgent;
 
-			step = llclamp(step, 0.f, 0.1f);
-			step *= 5.f;
-			// we want a velocity that will result in reaching the target in the 
-			// Interpolate towards the target.
-			LLVector3 delta_pos = part->mPartSourcep->mTargetPosAgent - part->mPosAgent;
+		delta_pos /= remaining;
 
-			delta_pos /= remaining;
+		part->mVelocity *= (1.f - step);
+		part->mVelocity += step*delta_pos;
+	}
 
-			part->mVelocity *= (1.f - step);
-			part->mVelocity += step*delta_pos;
-		}
+	// Linear targets are placed here, everything else is moved by the
+	// batch step
+	if (part->mFlags & LLPartData::LL_PART_TARGET_LINEAR_MASK)
+	{
+		LLVector3 delta_pos = part->mPartSourcep->mTargetPosAgent - part->mPartSourcep->mPosAgent;			
+		part->mPosAgent = part->mPartSourcep->mPosAgent;
+		part->mPosAgent += frac*delta_pos;
+		part->mVelocity = delta_pos;
+	}
 
+	storePart(i);
+}
 
-		if (part->mFlags & LLPartData::LL_PART_TARGET_LINEAR_MASK)
+// No LLMemType or LLFastTimer in here, it runs on the particle job pool.
+void LLViewerPartGroup::simulate(LLViewerCamera* camera)
+{
+	S32 end = mPartArray.size();
+	for (S32 i = 0; i < end; i++)
+	{
+		const U32 flags = mPartArray.getFlags(i);
+		if ((flags & PRE_STEP_FLAGS) && !(flags & LLPartData::LL_PART_CALLBACK_MASK))
 		{
-			LLVector3 delta_pos = part->mPartSourcep->mTargetPosAgent - part->mPartSourcep->mPosAgent;			
-			part->mPosAgent = part->mPartSourcep->mPosAgent;
-			part->mPosAgent += frac*delta_pos;
-			part->mVelocity = delta_pos;
+			preStep(i);
 		}
-		else
+	}
+
+	// Velocity, color and scale interpolation and aging for the whole group
+	mPartArray.integrate();
+
+	for (S32 i = 0; i < end; i++)
+	{
+		const U32 flags = mPartArray.getFlags(i);
+		if (!(flags & (LLPartData::LL_PART_BOUNCE_MASK | LLPartData::LL_PART_FOLLOW_SRC_MASK)))
 		{
-			// Do velocity interpolation
-			part->mPosAgent += dt*part->mVelocity;
-			part->mPosAgent += 0.5f*dt*dt*part->mAccel;
-			part->mVelocity += part->mAccel*dt;
+			continue;
 		}
 
+		LLViewerPart* part = mParticles[i];
+		LLVector3 pos_agent = mPartArray.getPosition(i);
+
 		// Do a bounce test
-		if (part->mFlags & LLPartData::LL_PART_BOUNCE_MASK)
+		if (flags & LLPartData::LL_PART_BOUNCE_MASK)
 		{
 			// Need to do point vs. plane check...
 			// For now, just check relative to object height...
-			F32 dz = part->mPosAgent.mV[VZ] - part->mPartSourcep->mPosAgent.mV[VZ];
+			F32 dz = pos_agent.mV[VZ] - part->mPartSourcep->mPosAgent.mV[VZ];
 			if (dz < 0)
 			{
-				part->mPosAgent.mV[VZ] += -2.f*dz;
-				part->mVelocity.mV[VZ] *= -0.75f;
+				pos_agent.mV[VZ] += -2.f*dz;
+				mPartArray.setPosition(i, pos_agent);
+
+				LLVector3 velocity = mPartArray.getVelocity(i);
+				velocity.mV[VZ] *= -0.75f;
+				mPartArray.setVelocity(i, velocity);
 			}
 		}
 
-
 		// Reset the offset from the source position
-		if (part->mFlags & LLPartData::LL_PART_FOLLOW_SRC_MASK)
+		if (flags & LLPartData::LL_PART_FOLLOW_SRC_MASK)
 		{
-			part->mPosOffset = part->mPosAgent;
+			part->mPosOffset = pos_agent;
 			part->mPosOffset -= part->mPartSourcep->mPosAgent;
 		}
+	}
 
-		// Do color interpolation
-		if (part->mFlags & LLPartData::LL_PART_INTERP_COLOR_MASK)
-		{
-			part->mColor.setVec(part->mStartColor);
-			// note: LLColor4's v%k means multiply-alpha-only,
-			//       LLColor4's v*k means multiply-rgb-only
-			part->mColor *= 1.f - frac; // rgb*k
-			part->mColor %= 1.f - frac; // alpha*k
-			part->mColor += frac%(frac*part->mEndColor); // rgb,alpha
-		}
-
-		// Do scale interpolation
-		if (part->mFlags & LLPartData::LL_PART_INTERP_SCALE_MASK)
-		{
-			part->mScale.setVec(part->mStartScale);
-			part->mScale *= 1.f - frac;
-			part->mScale += frac*part->mEndScale;
-		}
-
-		// Set the last update time to now.
-		part->mLastUpdateTime = cur_time;
-
-
+	for (S32 i = 0 ; i < (S32)mParticles.size();)
+	{
 		// Kill dead particles (either flagged dead, or too old)
-		if ((part->mLastUpdateTime > part->mMaxAge) || (LLViewerPart::LL_PART_DEAD_MASK == part->mFlags))
+		if ((mPartArray.getAge(i) > mPartArray.getMaxAge(i)) || (LLViewerPart::LL_PART_DEAD_MASK == mPartArray.getFlags(i)))
 		{
-			mParticles[i] = mParticles.back() ;
-			mParticles.pop_back() ;
-			delete part ;
+			mDeadParts.push_back(mParticles[i]);
+			removePart(i);
 		}
 		else 
 		{
-			F32 desired_size = calc_desired_size(camera, part->mPosAgent, part->mScale);
-			if (!posInGroup(part->mPosAgent, desired_size))
+			LLVector3 pos_agent = mPartArray.getPosition(i);
+			F32 desired_size = calc_desired_size(camera, pos_agent, mPartArray.getScale(i));
+			if (!posInGroup(pos_agent, desired_size))
 			{
-				// Transfer particles between groups
-				LLViewerPartSim::getInstance()->put(part) ;
-				mParticles[i] = mParticles.back() ;
-				mParticles.pop_back() ;
+				// Transfer particles between groups, in finishUpdate()
+				loadPart(i);
+				mMovedParts.push_back(mParticles[i]);
+				removePart(i);
 			}
 			else
 			{
@@ -404,8 +457,13 @@ void LLViewerPartGroup::updateParticles(const F32 lastdt)
 			}
 		}
 	}
+}
 
-	S32 removed = end - (S32)mParticles.size();
+void LLViewerPartGroup::finishUpdate()
+{
+	LLMemType mt(LLMemType::MTYPE_PARTICLES);
+
+	S32 removed = (S32)(mDeadParts.size() + mMovedParts.size());
 	if (removed > 0)
 	{
 		// we removed one or more particles, so flag this group for update
@@ -415,18 +473,23 @@ void LLViewerPartGroup::updateParticles(const F32 lastdt)
 		}
 		LLViewerPartSim::decPartCount(removed);
 	}
-	
-	// Kill the viewer object if this particle group is empty
-	if (mParticles.empty())
+
+	LLViewerPartSim* part_sim = LLViewerPartSim::getInstance();
+	for (part_list_t::iterator iter = mDeadParts.begin(); iter != mDeadParts.end(); ++iter)
 	{
-		gObjectList.killObject(mVOPartGroupp);
-		mVOPartGroupp = NULL;
+		part_sim->releasePart(*iter);
 	}
+	mDeadParts.clear();
+
+	for (part_list_t::iterator iter = mMovedParts.begin(); iter != mMovedParts.end(); ++iter)
+	{
+		part_sim->put(*iter);
+	}
+	mMovedParts.clear();
 
 	LLViewerPartSim::checkParticleCount() ;
 }
 
-
 void LLViewerPartGroup::shift(const LLVector3 &offset)
 {
 	LLMemType mt(LLMemType::MTYPE_PARTICLES);
@@ -434,10 +497,7 @@ void LLViewerPartGroup::shift(const LLVector3 &offset)
 	mMinObjPos += offset;
 	mMaxObjPos += offset;
 
-	for (S32 i = 0 ; i < (S32)mParticles.size(); i++)
-	{
-		mParticles[i]->mPosAgent += offset;
-	}
+	mPartArray.shift(offset);
 }
 
 void LLViewerPartGroup::removeParticlesByID(const U32 source_id)
@@ -449,6 +509,7 @@ void LLViewerPartGroup::removeParticlesByID(const U32 source_id)
 		if(mParticles[i]->mPartSourcep->getID() == source_id)
 		{
 			mParticles[i]->mFlags = LLViewerPart::LL_PART_DEAD_MASK;
+			mPartArray.setFlags(i, LLViewerPart::LL_PART_DEAD_MASK);
 		}		
 	}
 }
@@ -474,9 +535,11 @@ void LLViewerPartSim::checkParticleCount(U32 size)
 }
 
 LLViewerPartSim::LLViewerPartSim()
+:	mJobPool(NULL)
 {
 	LLMemType mt(LLMemType::MTYPE_PARTICLES);
 	sMaxParticleCount = gSavedSettings.getS32("RenderMaxPartCount");
+	sPartCountLimit = llmax(gSavedSettings.getS32("RenderMaxPartCountLimit"), 1);
 	static U32 id_seed = 0;
 	mID = ++id_seed;
 }
@@ -498,6 +561,40 @@ void LLViewerPartSim::destroyClass()
 
 	// Kill all of the sources 
 	mViewerPartSources.clear();
+
+	// And the recycled particles
+	std::for_each(mFreeParts.begin(), mFreeParts.end(), DeletePointer());
+	mFreeParts.clear();
+
+	deleteAndClear(mJobPool);
+}
+
+LLViewerPart* LLViewerPartSim::createPart()
+{
+	LLMemType mt(LLMemType::MTYPE_PARTICLES);
+	++sParticleCount2;
+	if (mFreeParts.empty())
+	{
+		return new LLViewerPart();
+	}
+	LLViewerPart* part = mFreeParts.back();
+	mFreeParts.pop_back();
+	return part;
+}
+
+void LLViewerPartSim::releasePart(LLViewerPart* part)
+{
+	LLMemType mt(LLMemType::MTYPE_PARTICLES);
+	--sParticleCount2;
+	if ((S32)mFreeParts.size() >= sPartCountLimit)
+	{
+		delete part;
+		return;
+	}
+	// Drop the source and image references, and any state left from the
+	// last particle.
+	*part = LLViewerPart();
+	mFreeParts.push_back(part);
 }
 
 BOOL LLViewerPartSim::shouldAddPart()
@@ -515,7 +612,7 @@ BOOL LLViewerPartSim::shouldAddPart()
 			return FALSE;
 		}
 	}
-	if (sParticleCount >= MAX_PART_COUNT)
+	if (sParticleCount >= sPartCountLimit)
 	{
 		return FALSE;
 	}
@@ -526,14 +623,14 @@ BOOL LLViewerPartSim::shouldAddPart()
 void LLViewerPartSim::addPart(LLViewerPart* part)
 {
 	LLMemType mt(LLMemType::MTYPE_PARTICLES);
-	if (sParticleCount < MAX_PART_COUNT)
+	if (sParticleCount < sPartCountLimit)
 	{
 		put(part);
 	}
 	else
 	{
-		//delete the particle if can not add it in
-		delete part ;
+		//release the particle if can not add it in
+		releasePart(part);
 		part = NULL ;
 	}
 }
@@ -590,7 +687,7 @@ LLViewerPartGroup *LLViewerPartSim::put(LLViewerPart* part)
 
 	if(!return_group) //failed to insert the particle
 	{
-		delete part ;
+		releasePart(part);
 		part = NULL ;
 	}
 
@@ -629,6 +726,30 @@ void LLViewerPartSim::shift(const LLVector3 &offset)
 }
 
 static LLFastTimer::DeclareTimer FTM_SIMULATE_PARTICLES("Simulate Particles");
+static LLFastTimer::DeclareTimer FTM_SIMULATE_PARTICLE_GROUPS("Simulate Particle Groups");
+
+//------------------------------------------------------------------------
+// SimulateJob
+// steps the particles of one group per index
+//------------------------------------------------------------------------
+class LLViewerPartGroupSimulateJob : public LLJobPool::Job
+{
+public:
+	LLViewerPartGroupSimulateJob(const LLViewerPartSim::group_list_t& groups, LLViewerCamera* camera)
+	:	mGroups(groups),
+		mCamera(camera)
+	{
+	}
+
+	/*virtual*/ void run(S32 index)
+	{
+		mGroups[index]->simulate(mCamera);
+	}
+
+private:
+	const LLViewerPartSim::group_list_t& mGroups;
+	LLViewerCamera* mCamera;
+};
 
 void LLViewerPartSim::updateSimulation()
 {
@@ -708,6 +829,18 @@ void LLViewerPartSim::updateSimulation()
 		num_updates++;
 	}
 
+	static LLCachedControl<U32> simulation_threads(gSavedSettings, "ParticleSimulationThreads");
+	S32 num_threads = llmin((S32)simulation_threads, 16);
+	if (mJobPool && mJobPool->getNumThreads() != num_threads)
+	{
+		deleteAndClear(mJobPool);
+	}
+	if (!mJobPool && num_threads > 0)
+	{
+		mJobPool = new LLJobPool("Particle Simulation", num_threads);
+	}
+
+	mUpdateGroups.clear();
 	count = (S32) mViewerPartGroups.size();
 	for (i = 0; i < count; i++)
 	{
@@ -729,22 +862,59 @@ void LLViewerPartSim::updateSimulation()
 			{
 				gPipeline.markRebuild(vobj->mDrawable, LLDrawable::REBUILD_ALL, TRUE);
 			}
-			mViewerPartGroups[i]->updateParticles(dt * visirate);
+			mViewerPartGroups[i]->beginUpdate(dt * visirate);
 			mViewerPartGroups[i]->mSkippedTime=0.0f;
-			if (!mViewerPartGroups[i]->getCount())
-			{
-				delete mViewerPartGroups[i];
-				mViewerPartGroups.erase(mViewerPartGroups.begin() + i);
-				i--;
-				count--;
-			}
+			mUpdateGroups.push_back(mViewerPartGroups[i]);
 		}
 		else
 		{	
 			mViewerPartGroups[i]->mSkippedTime+=dt;
 		}
+	}
+
+	if (!mUpdateGroups.empty())
+	{
+		LLFastTimer t(FTM_SIMULATE_PARTICLE_GROUPS);
 
+		// Groups only change their own particles while they simulate
+		LLViewerCamera* camera = LLViewerCamera::getInstance();
+		if (mJobPool)
+		{
+			LLViewerPartGroupSimulateJob job(mUpdateGroups, camera);
+			mJobPool->run(job, (S32)mUpdateGroups.size());
+		}
+		else
+		{
+			for (group_list_t::iterator iter = mUpdateGroups.begin(); iter != mUpdateGroups.end(); ++iter)
+			{
+				(*iter)->simulate(camera);
+			}
+		}
+	}
+
+	// Particles that left their group are placed in group order, so the
+	// result does not depend on which thread finished first. Every group
+	// has stepped by now, so a particle is never stepped twice in a frame.
+	for (group_list_t::iterator iter = mUpdateGroups.begin(); iter != mUpdateGroups.end(); ++iter)
+	{
+		(*iter)->finishUpdate();
+	}
+	mUpdateGroups.clear();
+
+	// Groups are only emptied by their own update, and the particles they
+	// handed on may have come back, so check once everything is placed
+	count = (S32) mViewerPartGroups.size();
+	for (i = 0; i < count; i++)
+	{
+		if (!mViewerPartGroups[i]->getCount())
+		{
+			delete mViewerPartGroups[i];
+			mViewerPartGroups.erase(mViewerPartGroups.begin() + i);
+			i--;
+			count--;
+		}
 	}
+
 	if (LLDrawable::getCurrentFrame()%16==0)
 	{
 		if (sParticleCount > sMaxParticleCount * 0.875f
@@ -771,7 +941,7 @@ void LLViewerPartSim::updatePartBurstRate()
 {
 	if (!(LLDrawable::getCurrentFrame() & 0xf))
 	{
-		if (sParticleCount >= MAX_PART_COUNT) //set rate to zero
+		if (sParticleCount >= sPartCountLimit) //set rate to zero
 		{
 			sParticleBurstRate = 0.0f ;
 		}
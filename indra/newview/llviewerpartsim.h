@@ -30,9 +30,12 @@
 #include "lldarrayptr.h"
 #include "llframetimer.h"
 #include "llpointer.h"
+#include "llpartarray.h"
 #include "llpartdata.h"
 #include "llviewerpartsource.h"
 
+class LLJobPool;
+class LLViewerCamera;
 class LLViewerTexture;
 class LLViewerPart;
 class LLViewerRegion;
@@ -45,6 +48,10 @@ typedef void (*LLVPCallback)(LLViewerPart &part, const F32 dt);
 //
 // An individual particle
 //
+// While a particle is in a group, its position, velocity, color, scale,
+// age and flags live in the group's LLPartArray and the fields here are
+// only current while a per particle pass or a transfer is using them.
+//
 
 
 class LLViewerPart : public LLPartData
@@ -59,7 +66,6 @@ public:
 
 	U32					mPartID;					// Particle ID used primarily for moving between groups
 	F32					mLastUpdateTime;			// Last time the particle was updated
-	F32					mSkipOffset;				// Offset against current group mSkippedTime
 
 	LLVPCallback		mVPCallback;				// Callback function for more complicated behaviors
 	LLPointer<LLViewerPartSource> mPartSourcep;		// Particle source used for this object
@@ -90,7 +96,16 @@ public:
 
 	BOOL addPart(LLViewerPart* part, const F32 desired_size = -1.f);
 	
-	void updateParticles(const F32 lastdt);
+	// A group update is split in three so the middle can run on a worker
+	// thread. beginUpdate() and finishUpdate() run on the main thread, in
+	// group order. simulate() only changes this group's particles and only
+	// reads sources, the camera and the region's wind, none of which
+	// change while groups are simulated.
+	void beginUpdate(const F32 lastdt);
+	void simulate(LLViewerCamera* camera);
+	// Frees the particles that died and hands the ones that moved out of
+	// the group to LLViewerPartSim::put().
+	void finishUpdate();
 
 	BOOL posInGroup(const LLVector3 &pos, const F32 desired_size = -1.f);
 
@@ -98,6 +113,7 @@ public:
 
 	typedef std::vector<LLViewerPart*>  part_list_t;
 	part_list_t mParticles;
+	LLPartArray mPartArray;		// Moving state of mParticles, same indices
 
 	const LLVector3 &getCenterAgent() const		{ return mCenterAgent; }
 	S32 getCount() const					{ return (S32) mParticles.size(); }
@@ -114,12 +130,23 @@ public:
 	bool mHud;
 
 protected:
+	// Copy particle i's state between mPartArray and its LLViewerPart.
+	void loadPart(S32 i);
+	void storePart(S32 i);
+	void removePart(S32 i);
+	// Following the source, wind, targets and callbacks for particle i.
+	void preStep(S32 i);
+
 	LLVector3 mCenterAgent;
 	F32 mBoxRadius;
 	LLVector3 mMinObjPos;
 	LLVector3 mMaxObjPos;
 
 	LLViewerRegion *mRegionp;
+
+	// Particles simulate() took out of the group, for finishUpdate()
+	part_list_t mDeadParts;
+	part_list_t mMovedParts;
 };
 
 class LLViewerPartSim : public LLSingleton<LLViewerPartSim>
@@ -143,7 +170,7 @@ public:
 	BOOL shouldAddPart(); // Just decides whether this particle should be added or not (for particle count capping)
 	F32 maxRate() // Return maximum particle generation rate
 	{
-		if (sParticleCount >= MAX_PART_COUNT)
+		if (sParticleCount >= sPartCountLimit)
 		{
 			return 1.f;
 		}
@@ -156,6 +183,9 @@ public:
 	F32 getRefRate() { return sParticleAdaptiveRate; }
 	F32 getBurstRate() {return sParticleBurstRate; }
 	void addPart(LLViewerPart* part);
+	// Particles are recycled rather than freed, use these instead of new and delete.
+	LLViewerPart* createPart();
+	void releasePart(LLViewerPart* part);
 	void updatePartBurstRate() ;
 	void clearParticlesByID(const U32 system_id);
 	void clearParticlesByOwnerID(const LLUUID& task_id);
@@ -181,13 +211,15 @@ protected:
 	group_list_t mViewerPartGroups;
 	source_list_t mViewerPartSources;
 	LLFrameTimer mSimulationTimer;
+	std::vector<LLViewerPart*> mFreeParts;
+	group_list_t mUpdateGroups;
+	LLJobPool* mJobPool;
 
 	static S32 sMaxParticleCount;
 	static S32 sParticleCount;
 	static F32 sParticleAdaptiveRate;
 	static F32 sParticleBurstRate;
-
-	static const S32 MAX_PART_COUNT;
+	static S32 sPartCountLimit;	// Hard limit, whatever sMaxParticleCount is set to
 	static const F32 PART_THROTTLE_THRESHOLD;
 	static const F32 PART_THROTTLE_RESCALE;
 	static const F32 PART_ADAPT_RATE_MULT;
@@ -274,7 +274,7 @@ void LLViewerPartSourceScript::update(const F32 dt)
 				continue;
 			}
 
-			LLViewerPart* part = new LLViewerPart();
+			LLViewerPart* part = LLViewerPartSim::getInstance()->createPart();
 
 			part->init(this, mImagep, NULL);
 			part->mFlags = mPartSysData.mPartData.mFlags;
@@ -569,7 +569,7 @@ void LLViewerPartSourceSpiral::update(const F32 dt)
 		{
 			mPosAgent = mSourceObjectp->getRenderPosition();
 		}
-		LLViewerPart* part = new LLViewerPart();
+		LLViewerPart* part = LLViewerPartSim::getInstance()->createPart();
 		part->init(this, mImagep, updatePart);
 		part->mStartColor = mColor;
 		part->mEndColor = mColor;
@@ -717,7 +717,7 @@ void LLViewerPartSourceBeam::update(const F32 dt)
 			mImagep = LLViewerTextureManager::getFetchedTextureFromFile("pixiesmall.j2c");
 		}
 
-		LLViewerPart* part = new LLViewerPart();
+		LLViewerPart* part = LLViewerPartSim::getInstance()->createPart();
 		part->init(this, mImagep, NULL);
 
 		part->mFlags = LLPartData::LL_PART_INTERP_COLOR_MASK |
@@ -834,7 +834,7 @@ void LLViewerPartSourceChat::update(const F32 dt)
 		{
 			mPosAgent = mSourceObjectp->getRenderPosition();
 		}
-		LLViewerPart* part = new LLViewerPart();
+		LLViewerPart* part = LLViewerPartSim::getInstance()->createPart();
 		part->init(this, mImagep, updatePart);
 		part->mStartColor = mColor;
 		part->mEndColor = mColor;
@@ -212,6 +212,7 @@ LLViewerRegion::LLViewerRegion(const U64 &handle,
 	mHttpUrl(""),
 	mCacheLoaded(FALSE),
 	mCacheDirty(FALSE),
+	mCacheFile(NULL),
 	mCacheID(),
 	mEventPoll(NULL),
 	mReleaseNotesRequested(FALSE),
@@ -333,7 +334,7 @@ void LLViewerRegion::loadObjectCache()
 
 	if(LLVOCache::hasInstance())
 	{
-		LLVOCache::getInstance()->readFromCache(mHandle, mCacheID, mCacheMap) ;
+		mCacheFile = LLVOCache::getInstance()->readFromCache(mHandle, mCacheID) ;
 	}
 }
 
@@ -345,16 +346,18 @@ void LLViewerRegion::saveObjectCache()
 		return;
 	}
 
-	if (mCacheMap.empty())
-	{
-		return;
-	}
-
 	if(LLVOCache::hasInstance())
 	{
-		LLVOCache::getInstance()->writeToCache(mHandle, mCacheID, mCacheMap, mCacheDirty) ;
-		mCacheDirty = FALSE;
+		if (!mCacheMap.empty())
+		{
+			// A dirty cache is handed over to be written in the background,
+			// leaving mCacheMap empty and mCacheFile NULL.
+			LLVOCache::getInstance()->writeToCache(mHandle, mCacheID, mCacheMap, mCacheFile, mCacheDirty) ;
+			mCacheDirty = FALSE;
+		}
+		LLVOCache::getInstance()->releaseCacheFile(mHandle, mCacheFile) ;
 	}
+	deleteAndClear(mCacheFile);
 
 	for(LLVOCacheEntry::vocache_entry_map_t::iterator iter = mCacheMap.begin(); iter != mCacheMap.end(); ++iter)
 	{
@@ -1037,7 +1040,7 @@ void LLViewerRegion::cacheFullUpdate(LLViewerObject* objectp, LLDataPackerBinary
 	U32 local_id = objectp->getLocalID();
 	U32 crc = objectp->getCRC();
 
-	LLVOCacheEntry* entry = get_if_there(mCacheMap, local_id, (LLVOCacheEntry*)NULL);
+	LLVOCacheEntry* entry = getCacheEntry(local_id);
 
 	if (entry)
 	{
@@ -1063,6 +1066,7 @@ void LLViewerRegion::cacheFullUpdate(LLViewerObject* objectp, LLDataPackerBinary
 		// Create new entry and add to map
 		if (mCacheMap.size() > MAX_OBJECT_CACHE_ENTRIES)
 		{
+			delete mCacheMap.begin()->second;
 			mCacheMap.erase(mCacheMap.begin());
 		}
 		entry = new LLVOCacheEntry(local_id, crc, dp);
@@ -1072,13 +1076,29 @@ void LLViewerRegion::cacheFullUpdate(LLViewerObject* objectp, LLDataPackerBinary
 	return ;
 }
 
+// Returns the cache entry for local_id, loading it from the cache
+// file the first time the object is seen.
+LLVOCacheEntry* LLViewerRegion::getCacheEntry(U32 local_id)
+{
+	LLVOCacheEntry* entry = get_if_there(mCacheMap, local_id, (LLVOCacheEntry*)NULL);
+	if (!entry && mCacheFile)
+	{
+		entry = mCacheFile->loadEntry(local_id);
+		if (entry)
+		{
+			mCacheMap[local_id] = entry;
+		}
+	}
+	return entry;
+}
+
 // Get data packer for this object, if we have cached data
 // AND the CRC matches. JC
-LLDataPacker *LLViewerRegion::getDP(U32 local_id, U32 crc)
+LLDataPackerBinaryBuffer *LLViewerRegion::getDP(U32 local_id, U32 crc)
 {
 	llassert(mCacheLoaded);
 
-	LLVOCacheEntry* entry = get_if_there(mCacheMap, local_id, (LLVOCacheEntry*)NULL);
+	LLVOCacheEntry* entry = getCacheEntry(local_id);
 
 	if (entry)
 	{
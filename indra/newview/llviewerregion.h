@@ -50,7 +50,6 @@
 // Surface id's
 #define LAND  1
 #define WATER 2
-const U32	MAX_OBJECT_CACHE_ENTRIES = 10000;
 
 
 class LLEventPoll;
@@ -276,7 +275,8 @@ public:
 
 	// handle a full update message
 	void cacheFullUpdate(LLViewerObject* objectp, LLDataPackerBinaryBuffer &dp);
-	LLDataPacker *getDP(U32 local_id, U32 crc);
+	LLDataPackerBinaryBuffer *getDP(U32 local_id, U32 crc);
+	LLVOCacheEntry* getCacheEntry(U32 local_id);
 	void requestCacheMisses();
 	void addCacheMissFull(const U32 local_id);
 
@@ -392,6 +392,7 @@ private:
 	BOOL									mCacheLoaded;
 	BOOL                                    mCacheDirty;
 	LLVOCacheEntry::vocache_entry_map_t		mCacheMap;
+	LLVOCacheFile*							mCacheFile;		// entries not loaded into mCacheMap yet
 	LLDynamicArray<U32>						mCacheMissFull;
 	LLDynamicArray<U32>						mCacheMissCRC;
 	// time?
@@ -31,6 +31,7 @@
 
 #include "message.h"
 #include "llfloaterreg.h"
+#include "llhttpscheduler.h"
 #include "llmemory.h"
 #include "lltimer.h"
 #include "llvfile.h"
@@ -38,9 +39,11 @@
 #include "llappviewer.h"
 
 #include "pipeline.h" 
+#include "llimpostormanager.h"
 #include "lltexturefetch.h" 
 #include "llviewerobjectlist.h" 
 #include "llviewertexturelist.h" 
+#include "llvlcomposition.h"
 #include "lltexlayer.h"
 #include "lltexlayerparams.h"
 #include "llsurface.h"
@@ -206,6 +209,9 @@ LLViewerStats::LLViewerStats() :
 	mAssetKBitStat("assetkbitstat"),
 	mTextureKBitStat("texturekbitstat"),
 	mVFSPendingOperations("vfspendingoperations"),
+	mHTTPKBitStat("httpkbitstat"),
+	mHTTPActiveStat("httpactivestat"),
+	mHTTPQueuedStat("httpqueuedstat"),
 	mObjectsDrawnStat("objectsdrawnstat"),
 	mObjectsCulledStat("objectsculledstat"),
 	mObjectsTestedStat("objectstestedstat"),
@@ -220,6 +226,11 @@ LLViewerStats::LLViewerStats() :
 	mActualInKBitStat("actualinkbitstat"),
 	mActualOutKBitStat("actualoutkbitstat"),
 	mTrianglesDrawnStat("trianglesdrawnstat"),
+	mImpostorCountStat("impostorcountstat"),
+	mImpostorMemStat("impostormemstat"),
+	mImpostorUpdatesStat("impostorupdatesstat"),
+	mImpostorEvictionsStat("impostorevictionsstat"),
+	mTerrainCompositionsStat("terraincompositionsstat"),
 	mSimTimeDilation("simtimedilation"),
 	mSimFPS("simfps"),
 	mSimPhysicsFPS("simphysicsfps"),
@@ -290,6 +301,14 @@ void LLViewerStats::resetStats()
 	LLViewerStats::getInstance()->mObjectKBitStat.reset();
 	LLViewerStats::getInstance()->mTextureKBitStat.reset();
 	LLViewerStats::getInstance()->mVFSPendingOperations.reset();
+	LLViewerStats::getInstance()->mHTTPKBitStat.reset();
+	LLViewerStats::getInstance()->mHTTPActiveStat.reset();
+	LLViewerStats::getInstance()->mHTTPQueuedStat.reset();
+	LLViewerStats::getInstance()->mImpostorCountStat.reset();
+	LLViewerStats::getInstance()->mImpostorMemStat.reset();
+	LLViewerStats::getInstance()->mImpostorUpdatesStat.reset();
+	LLViewerStats::getInstance()->mImpostorEvictionsStat.reset();
+	LLViewerStats::getInstance()->mTerrainCompositionsStat.reset();
 	LLViewerStats::getInstance()->mAssetKBitStat.reset();
 	LLViewerStats::getInstance()->mPacketsInStat.reset();
 	LLViewerStats::getInstance()->mPacketsLostStat.reset();
@@ -629,6 +648,16 @@ void update_statistics(U32 frame_count)
 	LLViewerStats::getInstance()->mLayersKBitStat.addValue(layer_bits/1024.f);
 	LLViewerStats::getInstance()->mObjectKBitStat.addValue(gObjectBits/1024.f);
 	LLViewerStats::getInstance()->mVFSPendingOperations.addValue(LLVFile::getVFSThread()->getPending());
+	LLHTTPScheduler* http_scheduler = LLHTTPScheduler::getInstance();
+	LLViewerStats::getInstance()->mHTTPKBitStat.addValue(http_scheduler->getAndResetBytesReceived() * 8 / 1024.f);
+	LLViewerStats::getInstance()->mHTTPActiveStat.addValue(http_scheduler->getActiveCount());
+	LLViewerStats::getInstance()->mHTTPQueuedStat.addValue(http_scheduler->getWaitingCount());
+	LLImpostorManager* impostor_manager = LLImpostorManager::getInstance();
+	LLViewerStats::getInstance()->mImpostorCountStat.addValue(impostor_manager->getNumTargets());
+	LLViewerStats::getInstance()->mImpostorMemStat.addValue(impostor_manager->getMemoryUsage() / (1024.f * 1024.f));
+	LLViewerStats::getInstance()->mImpostorUpdatesStat.addValue(LLVOAvatar::sNumImpostorUpdates);
+	LLViewerStats::getInstance()->mImpostorEvictionsStat.addValue(impostor_manager->getAndResetEvictions());
+	LLViewerStats::getInstance()->mTerrainCompositionsStat.addValue(LLVLComposition::getPendingTextureCount());
 	LLViewerStats::getInstance()->mAssetKBitStat.addValue(gTransferManager.getTransferBitsIn(LLTCT_ASSET)/1024.f);
 	gTransferManager.resetTransferBitsIn(LLTCT_ASSET);
 
@@ -39,6 +39,9 @@ public:
 	LLStat mAssetKBitStat;
 	LLStat mTextureKBitStat;
 	LLStat mVFSPendingOperations;
+	LLStat mHTTPKBitStat;		// texture, inventory and asset fetches
+	LLStat mHTTPActiveStat;
+	LLStat mHTTPQueuedStat;
 	LLStat mObjectsDrawnStat;
 	LLStat mObjectsCulledStat;
 	LLStat mObjectsTestedStat;
@@ -53,6 +56,11 @@ public:
 	LLStat mActualInKBitStat;	// From the packet ring (when faking a bad connection)
 	LLStat mActualOutKBitStat;	// From the packet ring (when faking a bad connection)
 	LLStat mTrianglesDrawnStat;
+	LLStat mImpostorCountStat;
+	LLStat mImpostorMemStat;
+	LLStat mImpostorUpdatesStat;
+	LLStat mImpostorEvictionsStat;
+	LLStat mTerrainCompositionsStat;
 
 	// Simulator stats
 	LLStat mSimTimeDilation;
@@ -32,6 +32,7 @@
 #include "llagent.h"
 #include "llframetimer.h"
 #include "llviewerstats.h"
+#include "llviewerregion.h"
 #include "lldatapacker.h"
 
 using namespace LLOldEvents;
@@ -197,7 +198,8 @@ public:
 LLViewerThrottle::LLViewerThrottle() :
 	mMaxBandwidth(0.f),
 	mCurrentBandwidth(0.f),
-	mThrottleFrac(1.f)
+	mThrottleFrac(1.f),
+	mCongestion(MIN_FRACTIONAL, MAX_FRACTIONAL)
 {
 	// Need to be pushed on in bandwidth order
 	mPresets.push_back(LLViewerThrottleGroup(BW_PRESET_50));
@@ -291,6 +293,7 @@ LLViewerThrottleGroup LLViewerThrottle::getThrottleGroup(const F32 bandwidth_kbp
 void LLViewerThrottle::resetDynamicThrottle()
 {
 	mThrottleFrac = MAX_FRACTIONAL;
+	mCongestion.reset();
 
 	mCurrentBandwidth = mMaxBandwidth*MAX_FRACTIONAL;
 	mCurrent = getThrottleGroup(mCurrentBandwidth / 1024.0f);
@@ -304,6 +307,34 @@ void LLViewerThrottle::updateDynamicThrottle()
 	}
 	mUpdateTimer.reset();
 
+	if (gSavedSettings.getBOOL("ThrottleCongestionControl"))
+	{
+		LLViewerRegion* regionp = gAgent.getRegion();
+		LLCircuitData* cdp = regionp ? gMessageSystem->mCircuitInfo.findCircuit(regionp->getHost()) : NULL;
+		if (!cdp)
+		{
+			return;
+		}
+
+		F32 loss = LLViewerStats::getInstance()->mPacketsLostPercentStat.getMean() / 100.f;
+		F32 frac = mCongestion.update((F32)cdp->getPingDelay(), loss);
+		if (mCurrentBandwidth / 1024.0f <= MIN_BANDWIDTH && frac < mThrottleFrac)
+		{
+			return;
+		}
+		if (llabs(frac - mThrottleFrac) < 0.01f)
+		{
+			return;
+		}
+		mThrottleFrac = frac;
+		mCurrentBandwidth = mMaxBandwidth * mThrottleFrac;
+		mCurrent = getThrottleGroup(mCurrentBandwidth / 1024.0f);
+		mCurrent.sendToSim();
+		llinfos << "Congestion control set network throttle to " << mCurrentBandwidth
+				<< " (queueing " << mCongestion.getQueueingDelay() << " ms, loss " << loss * 100.f << "%)" << llendl;
+		return;
+	}
+
 	if (LLViewerStats::getInstance()->mPacketsLostPercentStat.getMean() > TIGHTEN_THROTTLE_THRESHOLD)
 	{
 		if (mThrottleFrac <= MIN_FRACTIONAL || mCurrentBandwidth / 1024.0f <= MIN_BANDWIDTH)
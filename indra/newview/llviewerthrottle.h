@@ -32,6 +32,7 @@
 #include "llstring.h"
 #include "llframetimer.h"
 #include "llthrottle.h"
+#include "llcongestioncontroller.h"
 
 class LLViewerThrottleGroup
 {
@@ -83,6 +84,9 @@ protected:
 	
 	LLFrameTimer mUpdateTimer;
 	F32 mThrottleFrac;
+
+	// Picks mThrottleFrac from ping and loss when ThrottleCongestionControl is set.
+	LLCongestionController mCongestion;
 };
 
 extern LLViewerThrottle gViewerThrottle;
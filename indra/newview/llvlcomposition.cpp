@@ -40,6 +40,10 @@
 #include "llregionhandle.h" // for from_region_handle
 #include "llviewercontrol.h"
 
+LLVLCompositionThread* LLVLComposition::sCompositionThread = NULL;
+S32 LLVLComposition::sPendingTextures = 0;
+U32 LLVLComposition::sUploadFrame = 0;
+S32 LLVLComposition::sTexelsUploaded = 0;
 
 
 F32 bilinear(const F32 v00, const F32 v01, const F32 v10, const F32 v11, const F32 x_frac, const F32 y_frac)
@@ -249,25 +253,9 @@ BOOL LLVLComposition::generateComposition()
 	return TRUE;
 }
 
-BOOL LLVLComposition::generateTexture(const F32 x, const F32 y,
-									  const F32 width, const F32 height)
+BOOL LLVLComposition::loadRawImages()
 {
-	llassert(mSurfacep);
-	llassert(x >= 0.f);
-	llassert(y >= 0.f);
-
-	LLTimer gen_timer;
-
-	///////////////////////////
-	//
-	// Generate raw data arrays for surface textures
-	//
-	//
-
 	// These have already been validated by generateComposition.
-	U8* st_data[4];
-	S32 st_data_size[4]; // for debugging
-
 	for (S32 i = 0; i < 4; i++)
 	{
 		if (mRawImages[i].isNull())
@@ -292,22 +280,69 @@ BOOL LLVLComposition::generateTexture(const F32 x, const F32 y,
 				return FALSE;
 			}
 
-			mRawImages[i] = mDetailTextures[i]->getRawImage() ;
+			// Always keep a copy of our own, the composition thread reads
+			// it while the texture may change its raw image.
+			LLPointer<LLImageRaw> newraw = new LLImageRaw(BASE_SIZE, BASE_SIZE, 3);
+			newraw->composite(mDetailTextures[i]->getRawImage());
+			mRawImages[i] = newraw;
 			if(delete_raw)
 			{
 				mDetailTextures[i]->destroyRawImage() ;
 			}
-			if (mDetailTextures[i]->getWidth(ddiscard) != BASE_SIZE ||
-				mDetailTextures[i]->getHeight(ddiscard) != BASE_SIZE ||
-				mDetailTextures[i]->getComponents() != 3)
+		}
+	}
+	return TRUE;
+}
+
+BOOL LLVLComposition::requestTexture(LLQueuedThread::handle_t& handle,
+									 const F32 x, const F32 y,
+									 const F32 width, const F32 height,
+									 const F32 distance)
+{
+	llassert(mSurfacep);
+	llassert(x >= 0.f);
+	llassert(y >= 0.f);
+
+	// Closer patches first
+	U32 priority = LLQueuedThread::PRIORITY_NORMAL | 
+		(LLQueuedThread::PRIORITY_LOWBITS - llmin((U32)llmax(distance, 0.f), (U32)LLQueuedThread::PRIORITY_LOWBITS));
+
+	if (handle != LLQueuedThread::nullHandle())
+	{
+		LLQueuedThread::status_t status = sCompositionThread->getRequestStatus(handle);
+		if (status != LLQueuedThread::STATUS_COMPLETE)
+		{
+			if (status == LLQueuedThread::STATUS_QUEUED || status == LLQueuedThread::STATUS_INPROGRESS)
+			{
+				sCompositionThread->setPriority(handle, priority);
+				return FALSE;
+			}
+			// Lost, queue it again below
+			abortTexture(handle);
+		}
+		else
+		{
+			// Spread uploads of finished textures over frames
+			static LLCachedControl<U32> texels_per_frame(gSavedSettings, "TerrainCompositionTexelsPerFrame");
+			if (sUploadFrame != LLFrameTimer::getFrameCount())
 			{
-				LLPointer<LLImageRaw> newraw = new LLImageRaw(BASE_SIZE, BASE_SIZE, 3);
-				newraw->composite(mRawImages[i]);
-				mRawImages[i] = newraw; // deletes old
+				sUploadFrame = LLFrameTimer::getFrameCount();
+				sTexelsUploaded = 0;
 			}
+			const U32 budget = texels_per_frame;
+			if (sTexelsUploaded > 0 && (U32)sTexelsUploaded >= budget)
+			{
+				return FALSE;
+			}
+			const LLVLCompositionThread::Params& params = sCompositionThread->getCompletedRequest(handle)->getParams();
+			sTexelsUploaded += (params.mTexXEnd - params.mTexXBegin) * (params.mTexYEnd - params.mTexYBegin);
+			return TRUE;
 		}
-		st_data[i] = mRawImages[i]->getData();
-		st_data_size[i] = mRawImages[i]->getDataSize();
+	}
+
+	if (!loadRawImages())
+	{
+		return FALSE;
 	}
 
 	///////////////////////////////////////
@@ -342,16 +377,12 @@ BOOL LLVLComposition::generateTexture(const F32 x, const F32 y,
 
 	LLViewerTexture *texturep;
 	U32 tex_width, tex_height, tex_comps;
-	U32 tex_stride;
 	F32 tex_x_scalef, tex_y_scalef;
-	S32 tex_x_begin, tex_y_begin, tex_x_end, tex_y_end;
-	F32 tex_x_ratiof, tex_y_ratiof;
 
 	texturep = mSurfacep->getSTexture();
 	tex_width = texturep->getWidth();
 	tex_height = texturep->getHeight();
 	tex_comps = texturep->getComponents();
-	tex_stride = tex_width * tex_comps;
 
 	U32 st_comps = 3;
 	U32 st_width = BASE_SIZE;
@@ -363,102 +394,117 @@ BOOL LLVLComposition::generateTexture(const F32 x, const F32 y,
 		return FALSE;
 	}
 
+	LLVLCompositionThread::Params params;
+	for (S32 i = 0; i < 4; i++)
+	{
+		params.mDetailImages[i] = mRawImages[i];
+	}
+	params.mDetailWidth = st_width;
+	params.mDetailHeight = st_height;
+
 	tex_x_scalef = (F32)tex_width / (F32)mWidth;
 	tex_y_scalef = (F32)tex_height / (F32)mWidth;
-	tex_x_begin = (S32)((F32)x_begin * tex_x_scalef);
-	tex_y_begin = (S32)((F32)y_begin * tex_y_scalef);
-	tex_x_end = (S32)((F32)x_end * tex_x_scalef);
-	tex_y_end = (S32)((F32)y_end * tex_y_scalef);
-
-	tex_x_ratiof = (F32)mWidth*mScale / (F32)tex_width;
-	tex_y_ratiof = (F32)mWidth*mScale / (F32)tex_height;
-
-	LLPointer<LLImageRaw> raw = new LLImageRaw(tex_width, tex_height, tex_comps);
-	U8 *rawp = raw->getData();
-
-	F32 tex_width_inv = 1.f/tex_width;
-	F32 tex_height_inv = 1.f/tex_height;
-
-	F32 st_x_stride, st_y_stride;
-	st_x_stride = ((F32)st_width / (F32)mTexScaleX)*((F32)mWidth / (F32)tex_width);
-	st_y_stride = ((F32)st_height / (F32)mTexScaleY)*((F32)mWidth / (F32)tex_height);
+	params.mTexXBegin = (S32)((F32)x_begin * tex_x_scalef);
+	params.mTexYBegin = (S32)((F32)y_begin * tex_y_scalef);
+	params.mTexXEnd = (S32)((F32)x_end * tex_x_scalef);
+	params.mTexYEnd = (S32)((F32)y_end * tex_y_scalef);
+
+	params.mTexXRatio = (F32)mWidth*mScale / (F32)tex_width;
+	params.mTexYRatio = (F32)mWidth*mScale / (F32)tex_height;
+
+	params.mSTXStride = ((F32)st_width / (F32)mTexScaleX)*((F32)mWidth / (F32)tex_width);
+	params.mSTYStride = ((F32)st_height / (F32)mTexScaleY)*((F32)mWidth / (F32)tex_height);
+
+	llassert(params.mSTXStride > 0.f);
+	llassert(params.mSTYStride > 0.f);
+
+	// Copy out the composition values the texels sample, the sample
+	// position only grows with the texel index.
+	const S32 last = mWidth - 1;
+	const S32 tex_x_last = llmax(params.mTexXBegin, params.mTexXEnd - 1);
+	const S32 tex_y_last = llmax(params.mTexYBegin, params.mTexYEnd - 1);
+	S32 values_x_begin = llclamp(llfloor(params.mTexXBegin*params.mTexXRatio*mScaleInv), 0, last);
+	S32 values_y_begin = llclamp(llfloor(params.mTexYBegin*params.mTexYRatio*mScaleInv), 0, last);
+	S32 values_x_end = llclamp(llfloor(tex_x_last*params.mTexXRatio*mScaleInv) + 1, 0, last) + 1;
+	S32 values_y_end = llclamp(llfloor(tex_y_last*params.mTexYRatio*mScaleInv) + 1, 0, last) + 1;
+
+	params.mValuesX = values_x_begin;
+	params.mValuesY = values_y_begin;
+	params.mValuesWidth = values_x_end - values_x_begin;
+	params.mLayerWidth = mWidth;
+	params.mScaleInv = mScaleInv;
+	params.mValues.resize(params.mValuesWidth * (values_y_end - values_y_begin));
+	for (S32 j = values_y_begin; j < values_y_end; j++)
+	{
+		memcpy(&params.mValues[(j - values_y_begin) * params.mValuesWidth],
+			   mDatap + j * mWidth + values_x_begin,
+			   params.mValuesWidth * sizeof(F32));
+	}
 
-	llassert(st_x_stride > 0.f);
-	llassert(st_y_stride > 0.f);
-	////////////////////////////////
-	//
-	// Iterate through the target texture, striding through the
-	// subtextures and interpolating appropriately.
-	//
-	//
+	handle = sCompositionThread->composite(params, priority);
+	sPendingTextures++;
+	return FALSE;
+}
 
-	F32 sti, stj;
-	S32 st_offset;
-	sti = (tex_x_begin * st_x_stride) - st_width*(llfloor((tex_x_begin * st_x_stride)/st_width));
-	stj = (tex_y_begin * st_y_stride) - st_height*(llfloor((tex_y_begin * st_y_stride)/st_height));
+BOOL LLVLComposition::generateTexture(LLQueuedThread::handle_t& handle)
+{
+	llassert(mSurfacep);
 
-	st_offset = (llfloor(stj * st_width) + llfloor(sti)) * st_comps;
-	for (S32 j = tex_y_begin; j < tex_y_end; j++)
+	LLVLCompositionThread::CompositionRequest* req = NULL;
+	if (handle != LLQueuedThread::nullHandle())
 	{
-		U32 offset = j * tex_stride + tex_x_begin * tex_comps;
-		sti = (tex_x_begin * st_x_stride) - st_width*((U32)(tex_x_begin * st_x_stride)/st_width);
-		for (S32 i = tex_x_begin; i < tex_x_end; i++)
-		{
-			S32 tex0, tex1;
-			F32 composition = getValueScaled(i*tex_x_ratiof, j*tex_y_ratiof);
+		req = sCompositionThread->getCompletedRequest(handle);
+	}
+	if (!req)
+	{
+		return FALSE;
+	}
 
-			tex0 = llfloor( composition );
-			tex0 = llclamp(tex0, 0, 3);
-			composition -= tex0;
-			tex1 = tex0 + 1;
-			tex1 = llclamp(tex1, 0, 3);
+	LLTimer gen_timer;
 
-			F32 xy_int_i, xy_int_j;
+	const LLVLCompositionThread::Params& params = req->getParams();
+	LLImageRaw* patch_raw = req->getImage();
 
-			xy_int_i = i * tex_width_inv;
-			xy_int_j = j * tex_height_inv;
+	LLViewerTexture *texturep = mSurfacep->getSTexture();
+	U32 tex_width = texturep->getWidth();
+	U32 tex_height = texturep->getHeight();
+	U32 tex_comps = texturep->getComponents();
 
-			st_offset = (lltrunc(sti) + lltrunc(stj)*st_width) * st_comps;
-			for (U32 k = 0; k < tex_comps; k++)
-			{
-				// Linearly interpolate based on composition.
-				if (st_offset >= st_data_size[tex0] || st_offset >= st_data_size[tex1])
-				{
-					// SJB: This shouldn't be happening, but does... Rounding error?
-					//llwarns << "offset 0 [" << tex0 << "] =" << st_offset << " >= size=" << st_data_size[tex0] << llendl;
-					//llwarns << "offset 1 [" << tex1 << "] =" << st_offset << " >= size=" << st_data_size[tex1] << llendl;
-				}
-				else
-				{
-					F32 a = *(st_data[tex0] + st_offset);
-					F32 b = *(st_data[tex1] + st_offset);
-					rawp[ offset ] = (U8)lltrunc( a + composition * (b - a) );
-				}
-				offset++;
-				st_offset++;
-			}
+	if (mCompositeImage.isNull() ||
+		mCompositeImage->getWidth() != tex_width ||
+		mCompositeImage->getHeight() != tex_height ||
+		mCompositeImage->getComponents() != tex_comps)
+	{
+		mCompositeImage = new LLImageRaw(tex_width, tex_height, tex_comps);
+	}
 
-			sti += st_x_stride;
-			if (sti >= st_width)
-			{
-				sti -= st_width;
-			}
+	S32 width = params.mTexXEnd - params.mTexXBegin;
+	S32 height = params.mTexYEnd - params.mTexYBegin;
+	if (patch_raw && patch_raw->getComponents() == tex_comps)
+	{
+		// Copy the patch into place, the upload reads it from the full image
+		const S32 row_size = width * tex_comps;
+		const U8* srcp = patch_raw->getData();
+		U8* dstp = mCompositeImage->getData() + (params.mTexYBegin * tex_width + params.mTexXBegin) * tex_comps;
+		for (S32 j = 0; j < height; j++)
+		{
+			memcpy(dstp, srcp, row_size);
+			srcp += row_size;
+			dstp += tex_width * tex_comps;
 		}
 
-		stj += st_y_stride;
-		if (stj >= st_height)
+		if (!texturep->hasGLTexture())
 		{
-			stj -= st_height;
+			texturep->createGLTexture(0, mCompositeImage);
 		}
+		texturep->setSubImage(mCompositeImage, params.mTexXBegin, params.mTexYBegin, width, height);
 	}
-
-	if (!texturep->hasGLTexture())
-	{
-		texturep->createGLTexture(0, raw);
-	}
-	texturep->setSubImage(raw, tex_x_begin, tex_y_begin, tex_x_end - tex_x_begin, tex_y_end - tex_y_begin);
 	LLSurface::sTextureUpdateTime += gen_timer.getElapsedTimeF32();
-	LLSurface::sTexelsUpdated += (tex_x_end - tex_x_begin) * (tex_y_end - tex_y_begin);
+	LLSurface::sTexelsUpdated += width * height;
+
+	sCompositionThread->completeRequest(handle);
+	handle = LLQueuedThread::nullHandle();
+	sPendingTextures--;
 
 	for (S32 i = 0; i < 4; i++)
 	{
@@ -470,6 +516,45 @@ BOOL LLVLComposition::generateTexture(const F32 x, const F32 y,
 	return TRUE;
 }
 
+// static
+void LLVLComposition::abortTexture(LLQueuedThread::handle_t& handle)
+{
+	if (handle == LLQueuedThread::nullHandle())
+	{
+		return;
+	}
+	if (sCompositionThread)
+	{
+		sCompositionThread->abortComposition(handle);
+		sPendingTextures--;
+	}
+	handle = LLQueuedThread::nullHandle();
+}
+
+// static
+void LLVLComposition::initClass(bool threaded)
+{
+	sCompositionThread = new LLVLCompositionThread(threaded);
+}
+
+// static
+void LLVLComposition::cleanupClass()
+{
+	if (sCompositionThread)
+	{
+		sCompositionThread->shutdown();
+		delete sCompositionThread;
+		sCompositionThread = NULL;
+	}
+	sPendingTextures = 0;
+}
+
+// static
+S32 LLVLComposition::updateClass(U32 max_time_ms)
+{
+	return sCompositionThread ? sCompositionThread->update(max_time_ms) : 0;
+}
+
 LLUUID LLVLComposition::getDetailTextureID(S32 corner)
 {
 	return mDetailTextures[corner]->getID();
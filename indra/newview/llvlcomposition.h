@@ -29,6 +29,7 @@
 
 #include "llviewerlayer.h"
 #include "llviewertexture.h"
+#include "llvlcompositionthread.h"
 
 class LLSurface;
 
@@ -43,8 +44,20 @@ public:
 	// Viewer side hack to generate composition values
 	BOOL generateHeights(const F32 x, const F32 y, const F32 width, const F32 height);
 	BOOL generateComposition();
-	// Generate texture from composition values.
-	BOOL generateTexture(const F32 x, const F32 y, const F32 width, const F32 height);		
+	// Queue generation of the texture from composition values, prioritized
+	// by distance. Returns TRUE once the queued texture is ready to be
+	// uploaded this frame; handle identifies the request between calls.
+	BOOL requestTexture(LLQueuedThread::handle_t& handle, const F32 x, const F32 y,
+						const F32 width, const F32 height, const F32 distance);
+	// Upload a texture queued by requestTexture() into the surface texture.
+	BOOL generateTexture(LLQueuedThread::handle_t& handle);
+	static void abortTexture(LLQueuedThread::handle_t& handle);
+
+	static void initClass(bool threaded);
+	static void cleanupClass();
+	static S32 updateClass(U32 max_time_ms);
+	// Textures queued and not uploaded yet
+	static S32 getPendingTextureCount()	{ return sPendingTextures; }
 
 	// Use these as indeces ito the get/setters below that use 'corner'
 	enum ECorner
@@ -68,6 +81,9 @@ public:
 	friend class LLDrawPoolTerrain;
 	void setParamsReady()		{ mParamsReady = TRUE; }
 	BOOL getParamsReady() const	{ return mParamsReady; }
+protected:
+	BOOL loadRawImages();
+
 protected:
 	BOOL mParamsReady;
 	LLSurface *mSurfacep;
@@ -75,12 +91,19 @@ protected:
 
 	LLPointer<LLViewerFetchedTexture> mDetailTextures[CORNER_COUNT];
 	LLPointer<LLImageRaw> mRawImages[CORNER_COUNT];
+	// Copy of the surface texture that finished patches are written to
+	LLPointer<LLImageRaw> mCompositeImage;
 
 	F32 mStartHeight[CORNER_COUNT];
 	F32 mHeightRange[CORNER_COUNT];
 
 	F32 mTexScaleX;
 	F32 mTexScaleY;
+
+	static LLVLCompositionThread* sCompositionThread;
+	static S32 sPendingTextures;
+	static U32 sUploadFrame;
+	static S32 sTexelsUploaded;
 };
 
 #endif //LL_LLVLCOMPOSITION_H
@@ -0,0 +1,238 @@
+/**
+ * @file llvlcompositionthread.cpp
+ * @brief Worker thread that blends terrain composition textures
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "llviewerprecompiledheaders.h"
+
+#include "llvlcompositionthread.h"
+
+#include "llv4math.h"	// for LL_VECTORIZE
+
+// Linear blend of one row of interleaved texel components,
+// out = a + weight * (b - a), truncated to bytes.
+static void blend_row(const F32* a, const F32* b, const F32* weight, U8* out, S32 count)
+{
+	S32 i = 0;
+#if LL_VECTORIZE
+	LL_LLV4MATH_ALIGN_PREFIX F32 blended[4] LL_LLV4MATH_ALIGN_POSTFIX;
+	for ( ; i + 4 <= count; i += 4)
+	{
+		__m128 va = _mm_loadu_ps(a + i);
+		__m128 vb = _mm_loadu_ps(b + i);
+		__m128 vw = _mm_loadu_ps(weight + i);
+		_mm_store_ps(blended, _mm_add_ps(va, _mm_mul_ps(vw, _mm_sub_ps(vb, va))));
+		out[i]     = (U8)lltrunc(blended[0]);
+		out[i + 1] = (U8)lltrunc(blended[1]);
+		out[i + 2] = (U8)lltrunc(blended[2]);
+		out[i + 3] = (U8)lltrunc(blended[3]);
+	}
+#endif
+	for ( ; i < count; i++)
+	{
+		out[i] = (U8)lltrunc(a[i] + weight[i] * (b[i] - a[i]));
+	}
+}
+
+//----------------------------------------------------------------------------
+
+LLVLCompositionThread::CompositionRequest::CompositionRequest(handle_t handle, U32 priority, const Params& params)
+	: LLQueuedThread::QueuedRequest(handle, priority),
+	  mParams(params)
+{
+}
+
+LLVLCompositionThread::CompositionRequest::~CompositionRequest()
+{
+}
+
+// Same sampling as LLViewerLayer::getValueScaled(), over the copied window
+F32 LLVLCompositionThread::CompositionRequest::getValue(const F32 x, const F32 y) const
+{
+	S32 x1, x2, y1, y2;
+	F32 x_frac, y_frac;
+	const S32 last = mParams.mLayerWidth - 1;
+
+	x_frac = x*mParams.mScaleInv;
+	x1 = llfloor(x_frac);
+	x2 = x1 + 1;
+	x_frac -= x1;
+
+	y_frac = y*mParams.mScaleInv;
+	y1 = llfloor(y_frac);
+	y2 = y1 + 1;
+	y_frac -= y1;
+
+	x1 = llclamp(x1, 0, last) - mParams.mValuesX;
+	x2 = llclamp(x2, 0, last) - mParams.mValuesX;
+	y1 = llclamp(y1, 0, last) - mParams.mValuesY;
+	y2 = llclamp(y2, 0, last) - mParams.mValuesY;
+
+	const F32* row1 = &mParams.mValues[y1 * mParams.mValuesWidth];
+	const F32* row2 = &mParams.mValues[y2 * mParams.mValuesWidth];
+
+	F32 row1_interp = row1[x1] - x_frac * (row1[x1] - row1[x2]);
+	F32 row2_interp = row2[x1] - x_frac * (row2[x1] - row2[x2]);
+
+	return row1_interp - y_frac * (row1_interp - row2_interp);
+}
+
+// WORKER THREAD
+bool LLVLCompositionThread::CompositionRequest::processRequest()
+{
+	const U32 tex_comps = 3;
+	const U32 st_comps = 3;
+	const U32 st_width = mParams.mDetailWidth;
+	const U32 st_height = mParams.mDetailHeight;
+	const S32 tex_x_begin = mParams.mTexXBegin;
+	const S32 tex_y_begin = mParams.mTexYBegin;
+	const S32 tex_x_end = mParams.mTexXEnd;
+	const S32 tex_y_end = mParams.mTexYEnd;
+	const F32 st_x_stride = mParams.mSTXStride;
+	const F32 st_y_stride = mParams.mSTYStride;
+
+	if (tex_x_end <= tex_x_begin || tex_y_end <= tex_y_begin)
+	{
+		return true;
+	}
+
+	const U8* st_data[DETAIL_COUNT];
+	S32 st_data_size[DETAIL_COUNT];
+	for (S32 i = 0; i < DETAIL_COUNT; i++)
+	{
+		st_data[i] = mParams.mDetailImages[i]->getData();
+		st_data_size[i] = mParams.mDetailImages[i]->getDataSize();
+	}
+
+	const S32 row_size = (tex_x_end - tex_x_begin) * tex_comps;
+	mImage = new LLImageRaw(tex_x_end - tex_x_begin, tex_y_end - tex_y_begin, tex_comps);
+	U8* rawp = mImage->getData();
+
+	// Gather the two detail texels and the weight of every component in
+	// a row, then blend the whole row at once.
+	std::vector<F32> row_a(row_size);
+	std::vector<F32> row_b(row_size);
+	std::vector<F32> row_weight(row_size);
+
+	F32 sti, stj;
+	stj = (tex_y_begin * st_y_stride) - st_height*(llfloor((tex_y_begin * st_y_stride)/st_height));
+
+	for (S32 j = tex_y_begin; j < tex_y_end; j++)
+	{
+		S32 n = 0;
+		sti = (tex_x_begin * st_x_stride) - st_width*((U32)(tex_x_begin * st_x_stride)/st_width);
+		for (S32 i = tex_x_begin; i < tex_x_end; i++)
+		{
+			S32 tex0, tex1;
+			F32 composition = getValue(i*mParams.mTexXRatio, j*mParams.mTexYRatio);
+
+			tex0 = llfloor( composition );
+			tex0 = llclamp(tex0, 0, 3);
+			composition -= tex0;
+			tex1 = tex0 + 1;
+			tex1 = llclamp(tex1, 0, 3);
+
+			S32 st_offset = (lltrunc(sti) + lltrunc(stj)*st_width) * st_comps;
+			for (U32 k = 0; k < tex_comps; k++)
+			{
+				if (st_offset >= st_data_size[tex0] || st_offset >= st_data_size[tex1])
+				{
+					// Rounding error at the edge of the detail image
+					row_a[n] = 0.f;
+					row_b[n] = 0.f;
+				}
+				else
+				{
+					row_a[n] = st_data[tex0][st_offset];
+					row_b[n] = st_data[tex1][st_offset];
+				}
+				row_weight[n] = composition;
+				n++;
+				st_offset++;
+			}
+
+			sti += st_x_stride;
+			if (sti >= st_width)
+			{
+				sti -= st_width;
+			}
+		}
+
+		blend_row(&row_a[0], &row_b[0], &row_weight[0], rawp, row_size);
+		rawp += row_size;
+
+		stj += st_y_stride;
+		if (stj >= st_height)
+		{
+			stj -= st_height;
+		}
+	}
+
+	return true;
+}
+
+//----------------------------------------------------------------------------
+
+// MAIN THREAD
+LLVLCompositionThread::LLVLCompositionThread(bool threaded)
+	: LLQueuedThread("vlcomposition", threaded)
+{
+}
+
+// MAIN THREAD
+LLVLCompositionThread::handle_t LLVLCompositionThread::composite(const Params& params, U32 priority)
+{
+	handle_t handle = generateHandle();
+	CompositionRequest* req = new CompositionRequest(handle, priority, params);
+	bool res = addRequest(req);
+	if (!res)
+	{
+		llerrs << "composition request added after LLVLCompositionThread::shutdown()" << llendl;
+	}
+	return handle;
+}
+
+// MAIN THREAD
+LLVLCompositionThread::CompositionRequest* LLVLCompositionThread::getCompletedRequest(handle_t handle)
+{
+	if (getRequestStatus(handle) != STATUS_COMPLETE)
+	{
+		return NULL;
+	}
+	// Nothing touches a completed request but the main thread
+	return (CompositionRequest*)getRequest(handle);
+}
+
+// MAIN THREAD
+void LLVLCompositionThread::abortComposition(handle_t handle)
+{
+	// A request that is queued or running deletes itself once the worker
+	// gets to it. One that already finished is waiting for us.
+	abortRequest(handle, true);
+	status_t status = getRequestStatus(handle);
+	if (status == STATUS_COMPLETE || status == STATUS_ABORTED)
+	{
+		completeRequest(handle);
+	}
+}
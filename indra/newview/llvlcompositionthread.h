@@ -0,0 +1,107 @@
+/**
+ * @file llvlcompositionthread.h
+ * @brief Worker thread that blends terrain composition textures
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLVLCOMPOSITIONTHREAD_H
+#define LL_LLVLCOMPOSITIONTHREAD_H
+
+#include "llimage.h"
+#include "llpointer.h"
+#include "llqueuedthread.h"
+
+// Blends the terrain detail textures into the composite surface texture
+// off the main thread. Requests are queued by LLVLComposition with a
+// snapshot of everything they read; the finished image is uploaded by the
+// main thread.
+class LLVLCompositionThread : public LLQueuedThread
+{
+public:
+	enum { DETAIL_COUNT = 4 };
+
+	struct Params
+	{
+		// Detail images, BASE_SIZE square with 3 components. They are
+		// never modified once queued.
+		LLPointer<LLImageRaw> mDetailImages[DETAIL_COUNT];
+		S32 mDetailWidth;
+		S32 mDetailHeight;
+
+		// Window of composition values read by the request, copied
+		// out of the layer so the region can keep changing it.
+		std::vector<F32> mValues;
+		S32 mValuesX;
+		S32 mValuesY;
+		S32 mValuesWidth;
+		S32 mLayerWidth;
+		F32 mScaleInv;
+
+		// Texel rectangle of the surface texture to generate
+		S32 mTexXBegin;
+		S32 mTexYBegin;
+		S32 mTexXEnd;
+		S32 mTexYEnd;
+		F32 mTexXRatio;
+		F32 mTexYRatio;
+		F32 mSTXStride;
+		F32 mSTYStride;
+	};
+
+	class CompositionRequest : public LLQueuedThread::QueuedRequest
+	{
+	protected:
+		virtual ~CompositionRequest(); // use deleteRequest()
+
+	public:
+		CompositionRequest(handle_t handle, U32 priority, const Params& params);
+
+		/*virtual*/ bool processRequest();
+
+		const Params& getParams() const		{ return mParams; }
+		LLImageRaw* getImage() const		{ return mImage; }
+
+	private:
+		F32 getValue(const F32 x, const F32 y) const;
+
+	private:
+		// input
+		Params mParams;
+		// output, (mTexXEnd - mTexXBegin) by (mTexYEnd - mTexYBegin) texels
+		LLPointer<LLImageRaw> mImage;
+	};
+
+public:
+	LLVLCompositionThread(bool threaded = true);
+
+	handle_t composite(const Params& params, U32 priority);
+
+	// Returns the request once it has completed, NULL while it is still
+	// queued or running.
+	CompositionRequest* getCompletedRequest(handle_t handle);
+
+	// Drops a request in any state. The handle is invalid afterwards.
+	void abortComposition(handle_t handle);
+};
+
+#endif // LL_LLVLCOMPOSITIONTHREAD_H
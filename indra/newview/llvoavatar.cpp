@@ -50,6 +50,7 @@
 #include "llavatarpropertiesprocessor.h"
 #include "llviewercontrol.h"
 #include "llcallingcard.h"		// IDEVO for LLAvatarTracker
+#include "llcriticaldamp.h"
 #include "lldrawpoolavatar.h"
 #include "lldriverparam.h"
 #include "lleditingmotion.h"
@@ -60,9 +61,11 @@
 #include "llhudmanager.h"
 #include "llhudnametag.h"
 #include "llhudtext.h"				// for mText/mDebugText
+#include "llimpostormanager.h"
 #include "llkeyframefallmotion.h"
 #include "llkeyframestandmotion.h"
 #include "llkeyframewalkmotion.h"
+#include "lljobpool.h"
 #include "llmutelist.h"
 #include "llmoveview.h"
 #include "llnotificationsutil.h"
@@ -598,6 +601,7 @@ U32 LLVOAvatar::sMaxVisible = 12;
 F32 LLVOAvatar::sRenderDistance = 256.f;
 S32	LLVOAvatar::sNumVisibleAvatars = 0;
 S32	LLVOAvatar::sNumLODChangesThisFrame = 0;
+U32	LLVOAvatar::sNumImpostorUpdates = 0;
 
 const LLUUID LLVOAvatar::sStepSoundOnLand = LLUUID("e8af4a28-aa83-4310-a7c4-c047e15ea0df");
 const LLUUID LLVOAvatar::sStepSounds[LL_MCODE_END] =
@@ -621,7 +625,11 @@ BOOL LLVOAvatar::sShowFootPlane = FALSE;
 BOOL LLVOAvatar::sVisibleInFirstPerson = FALSE;
 F32 LLVOAvatar::sLODFactor = 1.f;
 BOOL LLVOAvatar::sUseImpostors = FALSE;
+BOOL LLVOAvatar::sUseFlatSkeleton = TRUE;
 BOOL LLVOAvatar::sJointDebug = FALSE;
+LLJobPool* LLVOAvatar::sAnimationPool = NULL;
+BOOL LLVOAvatar::sQueueIdleUpdates = FALSE;
+std::vector<LLPointer<LLVOAvatar> > LLVOAvatar::sQueuedIdleUpdates;
 
 F32 LLVOAvatar::sUnbakedTime = 0.f;
 F32 LLVOAvatar::sUnbakedUpdateTime = 0.f;
@@ -681,7 +689,12 @@ LLVOAvatar::LLVOAvatar(const LLUUID& id,
 	mPreviousFullyLoaded(FALSE),
 	mFullyLoadedInitialized(FALSE),
 	mSupportsAlphaLayers(FALSE),
-	mLoadedCallbacksPaused(FALSE)
+	mLoadedCallbacksPaused(FALSE),
+	mQueuedUpdateType(LLCharacter::NORMAL_UPDATE),
+	mQueuedJointTouches(0),
+	mQueuedJointUpdates(0),
+	mDeferVisualParams(FALSE),
+	mVisualParamsDeferred(FALSE)
 {
 	LLMemType mt(LLMemType::MTYPE_AVATAR);
 	//VTResume();  // VTune
@@ -702,6 +715,7 @@ LLVOAvatar::LLVOAvatar(const LLUUID& id,
 		mBakedTextureDatas[i].mIsLoaded = false;
 		mBakedTextureDatas[i].mIsUsed = false;
 		mBakedTextureDatas[i].mMaskTexName = 0;
+		mBakedTextureDatas[i].mMaskDiscardLevel = -1;
 		mBakedTextureDatas[i].mTextureIndex = LLVOAvatarDictionary::bakedToLocalTextureIndex((EBakedTextureIndex)i);
 	}
 
@@ -721,11 +735,11 @@ LLVOAvatar::LLVOAvatar(const LLUUID& id,
 	mSpeed = 0.f;
 	setAnimationData("Speed", &mSpeed);
 
-	mNeedsImpostorUpdate = TRUE;
 	mNeedsAnimUpdate = TRUE;
 
 	mImpostorDistance = 0;
 	mImpostorPixelArea = 0;
+	mImpostorError = 0.f;
 
 	setNumTEs(TEX_NUM_INDICES);
 
@@ -788,6 +802,11 @@ LLVOAvatar::~LLVOAvatar()
 
 	mRoot.removeAllChildren();
 
+	if (LLImpostorManager::instanceExists())
+	{
+		LLImpostorManager::getInstance()->releaseTarget(this);
+	}
+
 	deleteAndClearArray(mSkeleton);
 	deleteAndClearArray(mCollisionVolumes);
 
@@ -845,6 +864,10 @@ void LLVOAvatar::markDead()
 	}
 	mVoiceVisualizer->markDead();
 	LLLoadedCallbackEntry::cleanUpCallbackList(&mCallbackTextureList) ;
+	if (LLImpostorManager::instanceExists())
+	{
+		LLImpostorManager::getInstance()->releaseTarget(this);
+	}
 	LLViewerObject::markDead();
 }
 
@@ -1014,11 +1037,9 @@ void LLVOAvatar::destroyGL()
 //static
 void LLVOAvatar::resetImpostors()
 {
-	for (std::vector<LLCharacter*>::iterator iter = LLCharacter::sInstances.begin();
-		 iter != LLCharacter::sInstances.end(); ++iter)
+	if (LLImpostorManager::instanceExists())
 	{
-		LLVOAvatar* avatar = (LLVOAvatar*) *iter;
-		avatar->mImpostor.release();
+		LLImpostorManager::getInstance()->releaseAll();
 	}
 }
 
@@ -1161,6 +1182,7 @@ void LLVOAvatar::initClass()
 
 void LLVOAvatar::cleanupClass()
 {
+	deleteAndClear(sAnimationPool);
 	deleteAndClear(sAvatarXmlInfo);
 	sSkeletonXMLTree.cleanup();
 	sXMLTree.cleanup();
@@ -1749,6 +1771,7 @@ void LLVOAvatar::buildCharacter()
 	//-------------------------------------------------------------------------
 	// remove all of mRoot's children
 	//-------------------------------------------------------------------------
+	mFlatSkeleton.clear();
 	mRoot.removeAllChildren();
 	mIsBuilt = FALSE;
 
@@ -1882,6 +1905,7 @@ void LLVOAvatar::buildCharacter()
 	//-------------------------------------------------------------------------
 	processAnimationStateChanges();
 
+	mFlatSkeleton.build(&mRoot);
 	mIsBuilt = TRUE;
 	stop_glerror();
 
@@ -2167,7 +2191,7 @@ void LLVOAvatar::computeBodySize()
 U32 LLVOAvatar::processUpdateMessage(LLMessageSystem *mesgsys,
 									 void **user_data,
 									 U32 block_num, const EObjectUpdateType update_type,
-									 LLDataPacker *dp)
+									 LLDataPackerBinaryBuffer *dp)
 {
 	LLMemType mt(LLMemType::MTYPE_AVATAR);
 	
@@ -2223,6 +2247,8 @@ S32 LLVOAvatar::setTETexture(const U8 te, const LLUUID& uuid)
 
 static LLFastTimer::DeclareTimer FTM_AVATAR_UPDATE("Update Avatar");
 static LLFastTimer::DeclareTimer FTM_JOINT_UPDATE("Update Joints");
+static LLFastTimer::DeclareTimer FTM_PARALLEL_AVATAR_ANIMATION("Parallel Avatar Animation");
+static LLFastTimer::DeclareTimer FTM_AVATAR_ANIMATION_MERGE("Avatar Animation Merge");
 
 //------------------------------------------------------------------------
 // LLVOAvatar::dumpAnimationState()
@@ -2331,6 +2357,23 @@ BOOL LLVOAvatar::idleUpdate(LLAgent &agent, LLWorld &world, const F64 &time)
 	// animate the character
 	// store off last frame's root position to be consistent with camera position
 	LLVector3 root_pos_last = mRoot.getWorldPosition();
+	if (sQueueIdleUpdates && !isSelf() && !mIsDummy && !gNoRender)
+	{
+		LLCharacter::e_update_t update_type;
+		if (beginCharacterUpdate(agent, update_type))
+		{
+			// motions, joints and the rest of this update are done in endIdleUpdates()
+			mQueuedUpdateType = update_type;
+			mQueuedRootPosLast = root_pos_last;
+			sQueuedIdleUpdates.push_back(this);
+		}
+		else
+		{
+			idleUpdateFinish(FALSE, root_pos_last);
+		}
+		return TRUE;
+	}
+
 	BOOL detailed_update = updateCharacter(agent);
 
 	if (gNoRender)
@@ -2338,6 +2381,17 @@ BOOL LLVOAvatar::idleUpdate(LLAgent &agent, LLWorld &world, const F64 &time)
 		return TRUE;
 	}
 
+	idleUpdateFinish(detailed_update, root_pos_last);
+
+	return TRUE;
+}
+
+//------------------------------------------------------------------------
+// idleUpdateFinish()
+// the part of idleUpdate() which follows the character update
+//------------------------------------------------------------------------
+void LLVOAvatar::idleUpdateFinish(BOOL detailed_update, const LLVector3& root_pos_last)
+{
 	static LLUICachedControl<bool> visualizers_in_calls("ShowVoiceVisualizersInCalls", false);
 	bool voice_enabled = (visualizers_in_calls || LLVoiceClient::getInstance()->inProximalChannel()) &&
 						 LLVoiceClient::getInstance()->getVoiceEnabled(mID);
@@ -2355,8 +2409,134 @@ BOOL LLVOAvatar::idleUpdate(LLAgent &agent, LLWorld &world, const F64 &time)
 	
 	idleUpdateNameTag( root_pos_last );
 	idleUpdateRenderCost();
+}
 
-	return TRUE;
+//------------------------------------------------------------------------
+// AnimationJob
+// updates the motions and joints of one queued avatar per index
+//------------------------------------------------------------------------
+class LLVOAvatar::AnimationJob : public LLJobPool::Job
+{
+public:
+	AnimationJob(const std::vector<LLPointer<LLVOAvatar> >& avatars)
+	:	mAvatars(avatars)
+	{
+	}
+
+	/*virtual*/ void run(S32 index)
+	{
+		LLVOAvatar* avatar = mAvatars[index];
+		// the LLJoint counters belong to the main thread, which adds
+		// these in when it finishes the update
+		avatar->mQueuedJointTouches = 0;
+		avatar->mQueuedJointUpdates = 0;
+		LLJoint::setThreadCounters(&avatar->mQueuedJointTouches, &avatar->mQueuedJointUpdates);
+		avatar->updateMotionsConcurrent(avatar->mQueuedUpdateType);
+		avatar->updateJointTransforms();
+		LLJoint::setThreadCounters(NULL, NULL);
+	}
+
+private:
+	const std::vector<LLPointer<LLVOAvatar> >& mAvatars;
+};
+
+//------------------------------------------------------------------------
+// static
+// beginIdleUpdates()
+//------------------------------------------------------------------------
+void LLVOAvatar::beginIdleUpdates()
+{
+	static LLCachedControl<U32> animation_threads(gSavedSettings, "AvatarAnimationThreads");
+	static LLCachedControl<bool> flat_skeleton(gSavedSettings, "AvatarFlatSkeleton");
+
+	// read here, on the main thread, since the job pool updates joints too
+	sUseFlatSkeleton = flat_skeleton;
+
+	S32 num_threads = llmin((S32)animation_threads, 16);
+	if (sAnimationPool && sAnimationPool->getNumThreads() != num_threads)
+	{
+		deleteAndClear(sAnimationPool);
+	}
+	if (!sAnimationPool && num_threads > 0)
+	{
+		sAnimationPool = new LLJobPool("Avatar Animation", num_threads);
+	}
+
+	sQueueIdleUpdates = (sAnimationPool != NULL);
+}
+
+//------------------------------------------------------------------------
+// static
+// endIdleUpdates()
+//------------------------------------------------------------------------
+void LLVOAvatar::endIdleUpdates()
+{
+	sQueueIdleUpdates = FALSE;
+	if (sQueuedIdleUpdates.empty())
+	{
+		return;
+	}
+
+	{
+		LLFastTimer t(FTM_PARALLEL_AVATAR_ANIMATION);
+
+		// Motions may only touch their own avatar while they run. Anything
+		// shared is either read only for the duration or deferred until the
+		// merge below.
+		for (std::vector<LLPointer<LLVOAvatar> >::iterator iter = sQueuedIdleUpdates.begin();
+			 iter != sQueuedIdleUpdates.end(); ++iter)
+		{
+			(*iter)->mDeferVisualParams = TRUE;
+		}
+		LLCriticalDamp::lockCache(TRUE);
+
+		AnimationJob job(sQueuedIdleUpdates);
+		sAnimationPool->run(job, (S32)sQueuedIdleUpdates.size());
+
+		LLCriticalDamp::lockCache(FALSE);
+	}
+
+	{
+		LLFastTimer t(FTM_AVATAR_ANIMATION_MERGE);
+		LLMemType mt(LLMemType::MTYPE_AVATAR);
+
+		for (std::vector<LLPointer<LLVOAvatar> >::iterator iter = sQueuedIdleUpdates.begin();
+			 iter != sQueuedIdleUpdates.end(); ++iter)
+		{
+			LLVOAvatar* avatar = *iter;
+			avatar->mDeferVisualParams = FALSE;
+			if (!avatar->isDead())
+			{
+				avatar->finishQueuedIdleUpdate();
+			}
+		}
+	}
+
+	sQueuedIdleUpdates.clear();
+}
+
+//------------------------------------------------------------------------
+// finishQueuedIdleUpdate()
+// main thread remainder of an idle update queued by idleUpdate()
+//------------------------------------------------------------------------
+void LLVOAvatar::finishQueuedIdleUpdate()
+{
+	// motions which finished loading start blending in on the next update
+	mMotionController.updateLoadingMotions();
+
+	LLJoint::sNumTouches += mQueuedJointTouches;
+	LLJoint::sNumUpdates += mQueuedJointUpdates;
+
+	if (mVisualParamsDeferred)
+	{
+		mVisualParamsDeferred = FALSE;
+		updateVisualParams();
+	}
+
+	// the job already updated the joints, and updateVisualParams() does
+	// again if the skeleton changed
+	finishCharacterUpdate();
+	idleUpdateFinish(TRUE, mQueuedRootPosLast);
 }
 
 void LLVOAvatar::idleUpdateVoiceVisualizer(bool voice_enabled)
@@ -2513,37 +2693,48 @@ void LLVOAvatar::idleUpdateMisc(bool detailed_update)
 
 		getImpostorValues(ext, angle, distance);
 
-		for (U32 i = 0; i < 3 && !mNeedsImpostorUpdate; i++)
+		// how far past its threshold the worst change is, 0 while the impostor is good
+		F32 error = 0.f;
+
+		for (U32 i = 0; i < 3; i++)
 		{
 			F32 cur_angle = angle.mV[i];
 			F32 old_angle = mImpostorAngle.mV[i];
 			F32 angle_diff = fabsf(cur_angle-old_angle);
+			F32 max_angle_diff = F_PI/512.f*distance*mUpdatePeriod;
 		
-			if (angle_diff > F_PI/512.f*distance*mUpdatePeriod)
+			if (angle_diff > max_angle_diff)
 			{
-				mNeedsImpostorUpdate = TRUE;
+				error = llmax(error, angle_diff/llmax(max_angle_diff, F_APPROXIMATELY_ZERO));
 			}
 		}
 
-		if (detailed_update && !mNeedsImpostorUpdate)
+		if (detailed_update && error == 0.f)
 		{	//update impostor if view angle, distance, or bounding box change
 			//significantly
 			
 			F32 dist_diff = fabsf(distance-mImpostorDistance);
 			if (dist_diff/mImpostorDistance > 0.1f)
 			{
-				mNeedsImpostorUpdate = TRUE;
+				error = dist_diff/mImpostorDistance/0.1f;
 			}
 			else
 			{
 				getSpatialExtents(ext[0], ext[1]);
-				if ((ext[1]-mImpostorExtents[1]).length() > 0.05f ||
-					(ext[0]-mImpostorExtents[0]).length() > 0.05f)
+				F32 ext_diff = llmax((ext[1]-mImpostorExtents[1]).length(),
+									 (ext[0]-mImpostorExtents[0]).length());
+				if (ext_diff > 0.05f)
 				{
-					mNeedsImpostorUpdate = TRUE;
+					error = ext_diff/0.05f;
 				}
 			}
 		}
+
+		if (error > 0.f)
+		{	//big impostors show their errors the most
+			mNeedsImpostorUpdate = TRUE;
+			mImpostorError = error*sqrtf(mImpostorPixelArea);
+		}
 	}
 
 	mDrawable->movePartition();
@@ -3254,7 +3445,7 @@ void LLVOAvatar::slamPosition()
 	{
 		gPipeline.updateMoveNormalAsync(mDrawable);
 	}
-	mRoot.updateWorldMatrixChildren();
+	updateJointTransforms();
 }
 
 //------------------------------------------------------------------------
@@ -3265,6 +3456,28 @@ BOOL LLVOAvatar::updateCharacter(LLAgent &agent)
 {
 	LLMemType mt(LLMemType::MTYPE_AVATAR);
 
+	LLCharacter::e_update_t update_type;
+	if (!beginCharacterUpdate(agent, update_type))
+	{
+		return FALSE;
+	}
+
+	// update animations
+	updateMotions(update_type);
+	updateJointTransforms();
+
+	finishCharacterUpdate();
+
+	return TRUE;
+}
+
+//------------------------------------------------------------------------
+// beginCharacterUpdate()
+// everything in updateCharacter() before the motions are updated; returns
+// FALSE if the character needs no further update this frame
+//------------------------------------------------------------------------
+BOOL LLVOAvatar::beginCharacterUpdate(LLAgent &agent, LLCharacter::e_update_t& update_type)
+{
 	// clear debug text
 	mDebugText.clear();
 	if (LLVOAvatar::sShowAnimationDebug)
@@ -3634,11 +3847,21 @@ BOOL LLVOAvatar::updateCharacter(LLAgent &agent)
 	// store data relevant to motions
 	mSpeed = speed;
 
-	// update animations
 	if (mSpecialRenderMode == 1) // Animation Preview
-		updateMotions(LLCharacter::FORCE_UPDATE);
+		update_type = LLCharacter::FORCE_UPDATE;
 	else
-		updateMotions(LLCharacter::NORMAL_UPDATE);
+		update_type = LLCharacter::NORMAL_UPDATE;
+
+	return TRUE;
+}
+
+//------------------------------------------------------------------------
+// finishCharacterUpdate()
+// everything in updateCharacter() after the motions and joints are updated
+//------------------------------------------------------------------------
+void LLVOAvatar::finishCharacterUpdate()
+{
+	LLVector3 normal;
 
 	// update head position
 	updateHeadOffset();
@@ -3725,8 +3948,6 @@ BOOL LLVOAvatar::updateCharacter(LLAgent &agent)
 		}
 	}
 
-	mRoot.updateWorldMatrixChildren();
-
 	if (!mDebugText.size() && mText.notNull())
 	{
 		mText->markDead();
@@ -3739,8 +3960,21 @@ BOOL LLVOAvatar::updateCharacter(LLAgent &agent)
 
 	//mesh vertices need to be reskinned
 	mNeedsSkin = TRUE;
+}
 
-	return TRUE;
+//-----------------------------------------------------------------------------
+// updateJointTransforms()
+//-----------------------------------------------------------------------------
+void LLVOAvatar::updateJointTransforms()
+{
+	if (sUseFlatSkeleton && mFlatSkeleton.isBuilt())
+	{
+		mFlatSkeleton.updateWorldMatrices();
+	}
+	else
+	{
+		mRoot.updateWorldMatrixChildren();
+	}
 }
 
 //-----------------------------------------------------------------------------
@@ -4191,11 +4425,13 @@ U32 LLVOAvatar::renderRigid()
 
 U32 LLVOAvatar::renderImpostor(LLColor4U color, S32 diffuse_channel)
 {
-	if (!mImpostor.isComplete())
+	if (!mImpostor || !mImpostor->isComplete())
 	{
 		return 0;
 	}
 
+	mImpostorLastDrawn = (U32) LLDrawable::getCurrentFrame();
+
 	LLVector3 pos(getRenderPosition()+mImpostorOffset);
 	LLVector3 at = (pos - LLViewerCamera::getInstance()->getOrigin());
 	at.normalize();
@@ -4209,7 +4445,7 @@ U32 LLVOAvatar::renderImpostor(LLColor4U color, S32 diffuse_channel)
 	gGL.setAlphaRejectSettings(LLRender::CF_GREATER, 0.f);
 
 	gGL.color4ubv(color.mV);
-	gGL.getTexUnit(diffuse_channel)->bind(&mImpostor);
+	gGL.getTexUnit(diffuse_channel)->bind(mImpostor);
 	gGL.begin(LLRender::QUADS);
 	gGL.texCoord2f(0,0);
 	gGL.vertex3fv((pos+left-up).mV);
@@ -5482,21 +5718,144 @@ void LLVOAvatar::updateVisualParams()
 		return;
 	}
 
+	if (mDeferVisualParams)
+	{
+		// called from a motion running on the animation job pool
+		mVisualParamsDeferred = TRUE;
+		return;
+	}
+
 	setSex( (getVisualParamWeight( "male" ) > 0.5f) ? SEX_MALE : SEX_FEMALE );
 
+	mesh_morph_map_t morphs;
+	beginMeshMorphs(morphs);
 	LLCharacter::updateVisualParams();
+	endMeshMorphs(morphs);
 
 	if (mLastSkeletonSerialNum != mSkeletonSerialNum)
 	{
 		computeBodySize();
 		mLastSkeletonSerialNum = mSkeletonSerialNum;
-		mRoot.updateWorldMatrixChildren();
+		updateJointTransforms();
 	}
 
 	dirtyMesh();
 	updateHeadOffset();
 }
 
+//-----------------------------------------------------------------------------
+// beginMeshMorphs()
+// Starts a morph batch on every mesh, and shares the vertices of meshes whose
+// shape another avatar has already produced.
+//-----------------------------------------------------------------------------
+void LLVOAvatar::beginMeshMorphs(mesh_morph_map_t& morphs)
+{
+	static LLCachedControl<U32> morph_cache_size(gSavedSettings, "AvatarMorphCacheSize");
+	LLPolyMesh::setMorphCacheSize(morph_cache_size);
+
+	for (polymesh_map_t::iterator iter = mMeshes.begin(); iter != mMeshes.end(); ++iter)
+	{
+		iter->second->beginMorphBatch();
+	}
+
+	// our own shape changes continuously while editing and would only
+	// push other avatars' shapes out of the cache
+	if (!morph_cache_size || isSelf())
+	{
+		return;
+	}
+
+	// masks are generated from our baked textures, which other avatars wearing
+	// the same outfit share
+	std::map<LLPolyMorphTarget*, S32> mask_sources;
+	for (U32 i = 0; i < mBakedTextureDatas.size(); i++)
+	{
+		for (morph_list_t::const_iterator iter = mBakedTextureDatas[i].mMaskedMorphs.begin();
+			 iter != mBakedTextureDatas[i].mMaskedMorphs.end(); ++iter)
+		{
+			mask_sources[(*iter)->mMorphTarget] = i;
+		}
+	}
+
+	for (LLVisualParam* param = getFirstVisualParam(); param; param = getNextVisualParam())
+	{
+		for (LLVisualParam* shared = param; shared; shared = shared->getNextParam())
+		{
+			LLPolyMorphTarget* morph = dynamic_cast<LLPolyMorphTarget*>(shared);
+			if (!morph)
+			{
+				continue;
+			}
+
+			MeshMorphState& state = morphs[morph->getMesh()];
+
+			// same effective weight as LLCharacter::updateVisualParams()
+			F32 weight = (morph->getSex() & getSex()) ? morph->getWeight() : morph->getDefaultWeight();
+			state.mShapeHash.update((const unsigned char*)&weight, sizeof(F32));
+			if (morph->isAnimating())
+			{
+				// not applied by updateVisualParams(), the mesh may not match its weight
+				state.mCacheable = FALSE;
+			}
+			else if (morph->isMasked() && !morph->hasVertexMask())
+			{
+				// not applied until its mask arrives, whatever the weight
+				state.mShapeHash.update((const unsigned char*)LLUUID::null.mData, UUID_BYTES);
+				continue;
+			}
+			else if (weight != morph->getLastWeight())
+			{
+				state.mChanged = TRUE;
+			}
+
+			if (morph->isMasked())
+			{
+				std::map<LLPolyMorphTarget*, S32>::iterator source = mask_sources.find(morph);
+				if (source == mask_sources.end())
+				{
+					state.mCacheable = FALSE;
+					continue;
+				}
+				const BakedTextureData& baked = mBakedTextureDatas[source->second];
+				state.mShapeHash.update((const unsigned char*)baked.mMaskTexID.mData, UUID_BYTES);
+				state.mShapeHash.update((const unsigned char*)&baked.mMaskDiscardLevel, sizeof(S32));
+			}
+		}
+	}
+
+	for (mesh_morph_map_t::iterator iter = morphs.begin(); iter != morphs.end(); ++iter)
+	{
+		MeshMorphState& state = iter->second;
+		if (state.mChanged && state.mCacheable)
+		{
+			state.mShapeHash.finalize();
+			state.mShapeHash.raw_digest(state.mShapeID.mData);
+			state.mLoaded = iter->first->loadMorphCache(state.mShapeID);
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// endMeshMorphs()
+// Finishes every batch, then shares newly morphed meshes with other avatars.
+//-----------------------------------------------------------------------------
+void LLVOAvatar::endMeshMorphs(mesh_morph_map_t& morphs)
+{
+	for (polymesh_map_t::iterator iter = mMeshes.begin(); iter != mMeshes.end(); ++iter)
+	{
+		iter->second->endMorphBatch();
+	}
+
+	for (mesh_morph_map_t::iterator iter = morphs.begin(); iter != morphs.end(); ++iter)
+	{
+		const MeshMorphState& state = iter->second;
+		if (state.mChanged && state.mCacheable && !state.mLoaded)
+		{
+			iter->first->saveMorphCache(state.mShapeID);
+		}
+	}
+}
+
 //-----------------------------------------------------------------------------
 // isActive()
 //-----------------------------------------------------------------------------
@@ -5918,7 +6277,7 @@ void LLVOAvatar::sitOnObject(LLViewerObject *sit_object)
 	sitDown(TRUE);
 	mRoot.getXform()->setParent(&sit_object->mDrawable->mXform); // LLVOAvatar::sitOnObject
 	mRoot.setPosition(getPosition());
-	mRoot.updateWorldMatrixChildren();
+	updateJointTransforms();
 
 	stopMotion(ANIM_AGENT_BODY_NOISE);
 
@@ -7127,6 +7486,8 @@ void LLVOAvatar::onBakedTextureMasksLoaded( BOOL success, LLViewerFetchedTexture
 					if (baked_img && id == baked_img->getID())
 					{
 						const EBakedTextureIndex baked_index = texture_dict->mBakedTextureIndex;
+						self->mBakedTextureDatas[baked_index].mMaskTexID = id;
+						self->mBakedTextureDatas[baked_index].mMaskDiscardLevel = discard_level;
 						self->applyMorphMask(aux_src->getData(), aux_src->getWidth(), aux_src->getHeight(), 1, baked_index);
 						maskData->mLastDiscardLevel = discard_level;
 						if (self->mBakedTextureDatas[baked_index].mMaskTexName)
@@ -7992,21 +8353,63 @@ U32 LLVOAvatar::getPartitionType() const
 	return LLViewerRegion::PARTITION_BRIDGE;
 }
 
+// Orders stale impostors by how far they are off, worst first.
+// Avatars without an impostor are handled before these.
+struct CompareImpostorError
+{
+	bool operator()(const LLVOAvatar* lhs, const LLVOAvatar* rhs) const
+	{
+		return lhs->getImpostorError() > rhs->getImpostorError();
+	}
+};
+
+// Regenerates the stale impostors of visible avatars, missing ones first,
+// up to RenderImpostorUpdatesPerFrame of them.
 //static
 void LLVOAvatar::updateImpostors() 
 {
+	static LLCachedControl<U32> updates_per_frame(gSavedSettings, "RenderImpostorUpdatesPerFrame");
+
+	std::vector<LLVOAvatar*> queue;
+	std::vector<LLVOAvatar*> stale;
+
 	for (std::vector<LLCharacter*>::iterator iter = LLCharacter::sInstances.begin();
 		 iter != LLCharacter::sInstances.end(); ++iter)
 	{
 		LLVOAvatar* avatar = (LLVOAvatar*) *iter;
-		if (!avatar->isDead() && avatar->needsImpostorUpdate() && avatar->isVisible() && avatar->isImpostor())
+		if (!avatar->isDead() && avatar->needsImpostorUpdate() && avatar->isVisible() && avatar->shouldImpostor())
 		{
-			gPipeline.generateImpostor(avatar);
+			if (avatar->isImpostor())
+			{
+				stale.push_back(avatar);
+			}
+			else
+			{
+				queue.push_back(avatar);
+			}
 		}
 	}
+
+	std::sort(stale.begin(), stale.end(), CompareImpostorError());
+	queue.insert(queue.end(), stale.begin(), stale.end());
+
+	U32 budget = llmax((U32) updates_per_frame, (U32) 1);
+	sNumImpostorUpdates = 0;
+	for (std::vector<LLVOAvatar*>::iterator iter = queue.begin();
+		 iter != queue.end() && sNumImpostorUpdates < budget; ++iter)
+	{
+		gPipeline.generateImpostor(*iter);
+		sNumImpostorUpdates++;
+	}
 }
 
+// Avatars waiting for an impostor are drawn in full until they get one.
 BOOL LLVOAvatar::isImpostor() const
+{
+	return (shouldImpostor() && mImpostor && mImpostor->isComplete()) ? TRUE : FALSE;
+}
+
+BOOL LLVOAvatar::shouldImpostor() const
 {
 	return (sUseImpostors && mUpdatePeriod >= IMPOSTOR_PERIOD) ? TRUE : FALSE;
 }
@@ -8035,6 +8438,7 @@ void LLVOAvatar::setImpostorDim(const LLVector2& dim)
 void LLVOAvatar::cacheImpostorValues()
 {
 	getImpostorValues(mImpostorExtents, mImpostorAngle, mImpostorDistance);
+	mImpostorError = 0.f;
 }
 
 void LLVOAvatar::getImpostorValues(LLVector3* extents, LLVector3& angle, F32& distance) const
@@ -40,6 +40,9 @@
 #include "lldrawpoolalpha.h"
 #include "llviewerobject.h"
 #include "llcharacter.h"
+#include "llflatskeleton.h"
+#include "llimpostormanager.h"
+#include "llmd5.h"
 #include "llviewerjointmesh.h"
 #include "llviewerjointattachment.h"
 #include "llrendertarget.h"
@@ -63,6 +66,7 @@ class LLTexLayerSet;
 class LLVoiceVisualizer;
 class LLHUDNameTag;
 class LLHUDEffectSpiral;
+class LLJobPool;
 class LLTexGlobalColor;
 class LLVOAvatarBoneInfo;
 class LLVOAvatarSkeletonInfo;
@@ -74,6 +78,7 @@ class LLVOAvatarSkeletonInfo;
 class LLVOAvatar :
 	public LLViewerObject,
 	public LLCharacter,
+	public LLImpostorOwner,
 	public boost::signals2::trackable
 {
 public:
@@ -119,7 +124,7 @@ public:
 													 void **user_data,
 													 U32 block_num,
 													 const EObjectUpdateType update_type,
-													 LLDataPacker *dp);
+													 LLDataPackerBinaryBuffer *dp);
 	virtual BOOL   	 	 	idleUpdate(LLAgent &agent, LLWorld &world, const F64 &time);
 	virtual BOOL   	 	 	updateLOD();
 	BOOL  	 	 	 	 	updateJointLODs();
@@ -223,6 +228,36 @@ public:
 	void 			idleUpdateRenderCost();
 	void 			idleUpdateBelowWater();
 
+	// Other avatars are animated in parallel. Between beginIdleUpdates() and
+	// endIdleUpdates(), idleUpdate() only does the serial part of
+	// updateCharacter() for them and queues them. endIdleUpdates() then
+	// updates the motions and joints of every queued avatar on a job pool,
+	// and finishes their idle updates on the main thread in queue order.
+	// Attachments, name tags and the voice visualizer are placed in that
+	// finish, from this frame's joints. Only the idle updates of other
+	// objects which run before endIdleUpdates() see last frame's joints,
+	// as about half of them did before, depending on list order.
+	static void		beginIdleUpdates();
+	static void		endIdleUpdates();
+protected:
+	BOOL			beginCharacterUpdate(LLAgent &agent, LLCharacter::e_update_t& update_type);
+	void			finishCharacterUpdate();
+	void			idleUpdateFinish(BOOL detailed_update, const LLVector3& root_pos_last);
+private:
+	class AnimationJob;
+	void			finishQueuedIdleUpdate();
+
+	LLCharacter::e_update_t mQueuedUpdateType;
+	LLVector3		mQueuedRootPosLast;
+	S32				mQueuedJointTouches; // LLJoint debug counts of the job
+	S32				mQueuedJointUpdates;
+	BOOL			mDeferVisualParams; // set while motions run on the job pool
+	BOOL			mVisualParamsDeferred;
+
+	static LLJobPool* sAnimationPool;
+	static BOOL		sQueueIdleUpdates;
+	static std::vector<LLPointer<LLVOAvatar> > sQueuedIdleUpdates;
+
 	//--------------------------------------------------------------------
 	// Static preferences (controlled by user settings/menus)
 	//--------------------------------------------------------------------
@@ -233,6 +268,7 @@ public:
 	static F32		sRenderDistance; //distance at which avatars will render.
 	static BOOL		sShowAnimationDebug; // show animation debug info
 	static BOOL		sUseImpostors; //use impostors for far away avatars
+	static BOOL		sUseFlatSkeleton; // update joints through LLFlatSkeleton (control "AvatarFlatSkeleton")
 	static BOOL		sShowFootPlane;	// show foot collision plane reported by server
 	static BOOL		sShowCollisionVolumes;	// show skeletal collision volumes
 	static BOOL		sVisibleInFirstPerson;
@@ -288,6 +324,10 @@ public:
 
 	LLVector3			mHeadOffset; // current head position
 	LLViewerJoint		mRoot;
+
+	// Brings every joint's world transform up to date. Same result as
+	// mRoot.updateWorldMatrixChildren(), but walks the flattened skeleton.
+	void				updateJointTransforms();
 protected:
 	static BOOL			parseSkeletonFile(const std::string& filename);
 	void				buildCharacter();
@@ -299,6 +339,7 @@ private:
 	BOOL				mIsBuilt; // state of deferred character building
 	S32					mNumJoints;
 	LLViewerJoint*		mSkeleton;
+	LLFlatSkeleton		mFlatSkeleton; // breadth first copy of the mRoot hierarchy
 	
 	//--------------------------------------------------------------------
 	// Pelvis height adjustment members.
@@ -399,7 +440,9 @@ private:
 	//--------------------------------------------------------------------
 public:
 	BOOL 		isImpostor() const;
+	BOOL 		shouldImpostor() const;
 	BOOL 	    needsImpostorUpdate() const;
+	F32			getImpostorError() const { return mImpostorError; }
 	const LLVector3& getImpostorOffset() const;
 	const LLVector2& getImpostorDim() const;
 	void 		getImpostorValues(LLVector3* extents, LLVector3& angle, F32& distance) const;
@@ -407,8 +450,7 @@ public:
 	void 		setImpostorDim(const LLVector2& dim);
 	static void	resetImpostors();
 	static void updateImpostors();
-	LLRenderTarget mImpostor;
-	BOOL		mNeedsImpostorUpdate;
+	static U32	sNumImpostorUpdates;	// regenerated in the last updateImpostors()
 private:
 	LLVector3	mImpostorOffset;
 	LLVector2	mImpostorDim;
@@ -417,6 +459,7 @@ private:
 	LLVector3	mImpostorAngle;
 	F32			mImpostorDistance;
 	F32			mImpostorPixelArea;
+	F32			mImpostorError;		// how stale the impostor is, weighted by screen size
 	LLVector3	mLastAnimExtents[2];  
 
 	//--------------------------------------------------------------------
@@ -501,6 +544,9 @@ protected:
 		bool								mIsUsed;
 		LLVOAvatarDefines::ETextureIndex 	mTextureIndex;
 		U32									mMaskTexName;
+		// baked texture and discard level the morph masks were generated from
+		LLUUID								mMaskTexID;
+		S32									mMaskDiscardLevel;
 		// Stores pointers to the joint meshes that this baked texture deals with
 		std::vector< LLViewerJointMesh * > 	mMeshes;  // std::vector<LLViewerJointMesh> mJoints[i]->mMeshParts
 		morph_list_t						mMaskedMorphs;
@@ -593,6 +639,21 @@ private:
 	polymesh_map_t 									mMeshes;
 	std::vector<LLViewerJoint *> 					mMeshLOD;
 
+	// updateVisualParams() morphs each mesh in one batch, or shares the
+	// vertices of another avatar whose mesh has the same shape (see LLPolyMesh).
+	struct MeshMorphState
+	{
+		MeshMorphState() : mChanged(FALSE), mCacheable(TRUE), mLoaded(FALSE) {}
+		LLMD5							mShapeHash; // morph weights and mask sources
+		LLUUID							mShapeID;   // digest of mShapeHash, the cache key
+		BOOL							mChanged;
+		BOOL							mCacheable;
+		BOOL							mLoaded;
+	};
+	typedef std::map<LLPolyMesh*, MeshMorphState> mesh_morph_map_t;
+	void			beginMeshMorphs(mesh_morph_map_t& morphs);
+	void			endMeshMorphs(mesh_morph_map_t& morphs);
+
 	//--------------------------------------------------------------------
 	// Destroy invisible mesh
 	//--------------------------------------------------------------------
@@ -69,67 +69,17 @@ LLVOCacheEntry::LLVOCacheEntry()
 	mDP.assignBuffer(mBuffer, 0);
 }
 
-LLVOCacheEntry::LLVOCacheEntry(LLAPRFile* apr_file)
+LLVOCacheEntry::LLVOCacheEntry(const EntryInfo& info, const U8* data)
+	:
+	mLocalID(info.mLocalID),
+	mCRC(info.mCRC),
+	mHitCount(info.mHitCount),
+	mDupeCount(info.mDupeCount),
+	mCRCChangeCount(info.mCRCChangeCount)
 {
-	S32 size = -1;
-	BOOL success;
-
-	success = check_read(apr_file, &mLocalID, sizeof(U32));
-	if(success)
-	{
-		success = check_read(apr_file, &mCRC, sizeof(U32));
-	}
-	if(success)
-	{
-		success = check_read(apr_file, &mHitCount, sizeof(S32));
-	}
-	if(success)
-	{
-		success = check_read(apr_file, &mDupeCount, sizeof(S32));
-	}
-	if(success)
-	{
-		success = check_read(apr_file, &mCRCChangeCount, sizeof(S32));
-	}
-	if(success)
-	{
-		success = check_read(apr_file, &size, sizeof(S32));
-
-		// Corruption in the cache entries
-		if ((size > 10000) || (size < 1))
-		{
-			// We've got a bogus size, skip reading it.
-			// We won't bother seeking, because the rest of this file
-			// is likely bogus, and will be tossed anyway.
-			llwarns << "Bogus cache entry, size " << size << ", aborting!" << llendl;
-			success = FALSE;
-		}
-	}
-	if(success && size > 0)
-	{
-		mBuffer = new U8[size];
-		success = check_read(apr_file, mBuffer, size);
-
-		if(success)
-		{
-			mDP.assignBuffer(mBuffer, size);
-		}
-		else
-		{
-			delete[] mBuffer ;
-			mBuffer = NULL ;
-		}
-	}
-
-	if(!success)
-	{
-		mLocalID = 0;
-		mCRC = 0;
-		mHitCount = 0;
-		mDupeCount = 0;
-		mCRCChangeCount = 0;
-		mBuffer = NULL;
-	}
+	mBuffer = new U8[info.mSize];
+	memcpy(mBuffer, data, info.mSize);
+	mDP.assignBuffer(mBuffer, info.mSize);
 }
 
 LLVOCacheEntry::~LLVOCacheEntry()
@@ -184,38 +134,116 @@ void LLVOCacheEntry::dump() const
 		<< llendl;
 }
 
-BOOL LLVOCacheEntry::writeToFile(LLAPRFile* apr_file) const
+void LLVOCacheEntry::getEntryInfo(EntryInfo& info) const
 {
-	BOOL success;
-	success = check_write(apr_file, (void*)&mLocalID, sizeof(U32));
-	if(success)
+	info.mLocalID = mLocalID;
+	info.mCRC = mCRC;
+	info.mHitCount = mHitCount;
+	info.mDupeCount = mDupeCount;
+	info.mCRCChangeCount = mCRCChangeCount;
+	info.mOffset = 0;
+	info.mSize = mDP.getBufferSize();
+}
+
+//-------------------------------------------------------------------
+//LLVOCacheFile
+//-------------------------------------------------------------------
+// Entry sizes outside this range mean the file is corrupt
+const S32 MAX_CACHE_ENTRY_SIZE = 10000;
+
+// Region id followed by the entry count
+const S32 CACHE_FILE_HEADER_SIZE = UUID_BYTES + sizeof(S32);
+
+struct entry_info_less
+{
+	bool operator()(const LLVOCacheEntry::EntryInfo& lhs, U32 local_id) const
 	{
-		success = check_write(apr_file, (void*)&mCRC, sizeof(U32));
+		return lhs.mLocalID < local_id;
 	}
-	if(success)
+};
+
+LLVOCacheFile::LLVOCacheFile()
+:	mIndex(NULL),
+	mNumEntries(0)
+{
+}
+
+bool LLVOCacheFile::open(const std::string& filename, const LLUUID& id)
+{
+	close();
+
+	if (!mFile.open(filename))
 	{
-		success = check_write(apr_file, (void*)&mHitCount, sizeof(S32));
+		return false;
 	}
-	if(success)
+
+	const U8* data = mFile.getData();
+	size_t size = mFile.getSize();
+
+	S32 num_entries = -1;
+	if (size >= (size_t)CACHE_FILE_HEADER_SIZE)
 	{
-		success = check_write(apr_file, (void*)&mDupeCount, sizeof(S32));
+		memcpy(&num_entries, data + UUID_BYTES, sizeof(S32));
 	}
-	if(success)
+	if (!num_entries)
 	{
-		success = check_write(apr_file, (void*)&mCRCChangeCount, sizeof(S32));
+		mFile.close();
+		return false;
 	}
-	if(success)
+	if (num_entries < 0
+		|| (size - CACHE_FILE_HEADER_SIZE) / sizeof(LLVOCacheEntry::EntryInfo) < (size_t)num_entries)
 	{
-		S32 size = mDP.getBufferSize();
-		success = check_write(apr_file, (void*)&size, sizeof(S32));
-	
-		if(success)
-		{
-			success = check_write(apr_file, (void*)mBuffer, size);
+		llwarns << "Aborting cache file load for " << filename << ", cache file corruption!" << llendl;
+		mFile.close();
+		return false;
 	}
+
+	LLUUID cache_id;
+	memcpy(cache_id.mData, data, UUID_BYTES);
+	if (cache_id != id)
+	{
+		llinfos << "Cache ID doesn't match for this region, discarding"<< llendl;
+		mFile.close();
+		return false;
+	}
+
+	mIndex = (const LLVOCacheEntry::EntryInfo*)(data + CACHE_FILE_HEADER_SIZE);
+	mNumEntries = num_entries;
+	return true;
 }
 
-	return success ;
+const U8* LLVOCacheFile::getEntryData(const LLVOCacheEntry::EntryInfo& info) const
+{
+	if (info.mSize < 1 || info.mSize > MAX_CACHE_ENTRY_SIZE
+		|| (size_t)info.mSize > mFile.getSize()
+		|| (size_t)info.mOffset > mFile.getSize() - info.mSize)
+	{
+		llwarns << "Bogus cache entry, size " << info.mSize << ", skipping" << llendl;
+		return NULL;
+	}
+	return mFile.getData() + info.mOffset;
+}
+
+LLVOCacheEntry* LLVOCacheFile::loadEntry(U32 local_id) const
+{
+	if (!mNumEntries)
+	{
+		return NULL;
+	}
+
+	const LLVOCacheEntry::EntryInfo* end = mIndex + mNumEntries;
+	const LLVOCacheEntry::EntryInfo* info = std::lower_bound(mIndex, end, local_id, entry_info_less());
+	if (info == end || info->mLocalID != local_id)
+	{
+		return NULL;
+	}
+
+	const U8* data = getEntryData(*info);
+	if (!data)
+	{
+		return NULL;
+	}
+	return new LLVOCacheEntry(*info, data);
 }
 
 //-------------------------------------------------------------------
@@ -225,6 +253,9 @@ BOOL LLVOCacheEntry::writeToFile(LLAPRFile* apr_file) const
 static const char OBJECT_CACHE_FILENAME[] = "objects_%d_%d.slc";
 
 const U32 NUM_ENTRIES_TO_PURGE = 16 ;
+//regions whose entries can be held by queued writes at once, enough
+//for a teleport away from a region and all its neighbors.
+const U32 MAX_PENDING_WRITES = 16 ;
 const char* object_cache_dirname = "objectcache";
 const char* header_filename = "object.cache";
 
@@ -260,16 +291,26 @@ LLVOCache::LLVOCache():
 	mInitialized(FALSE),
 	mReadOnly(TRUE),
 	mNumEntries(0),
-	mCacheSize(1)
+	mCacheSize(1),
+	mWriteThread(NULL)
 {
 	mEnabled = gSavedSettings.getBOOL("ObjectCacheEnabled");
 	mLocalAPRFilePoolp = new LLVolatileAPRPool() ;
+	if(mEnabled)
+	{
+		mWriteThread = new LLVOCacheWriteThread() ;
+	}
 }
 
 LLVOCache::~LLVOCache()
 {
 	if(mEnabled)
 	{
+		//the thread aborts whatever is still queued when it shuts down
+		finishWrites();
+		mWriteThread->shutdown();
+		delete mWriteThread;
+
 		writeCacheHeader();
 		clearCacheInMemory();
 	}
@@ -324,6 +365,9 @@ void LLVOCache::removeCache(ELLPath location)
 		return ;
 	}
 
+	finishWrites();
+	closeMappedFiles();
+
 	std::string delem = gDirUtilp->getDirDelimiter();
 	std::string mask = delem + "*";
 	std::string cache_dir = gDirUtilp->getExpandedFilename(location, object_cache_dirname);
@@ -342,6 +386,9 @@ void LLVOCache::removeCache()
 		return ;
 	}
 
+	finishWrites();
+	closeMappedFiles();
+
 	std::string delem = gDirUtilp->getDirDelimiter();
 	std::string mask = delem + "*";
 	gDirUtilp->deleteFilesInDir(mObjectCacheDirName, mask); 
@@ -382,11 +429,34 @@ void LLVOCache::removeFromCache(U64 handle)
 		return ;
 	}
 
+	finishWrite(handle);
+	closeMappedFile(handle);
+
 	std::string filename;
 	getObjectCacheFilename(handle, filename);
 	LLAPRFile::remove(filename, mLocalAPRFilePoolp);	
 }
 
+void LLVOCache::closeMappedFile(U64 handle)
+{
+	std::map<U64, LLVOCacheFile*>::iterator iter = mMappedFiles.find(handle) ;
+	if(iter != mMappedFiles.end())
+	{
+		//the region keeps the closed file and finds no more entries in it
+		iter->second->close() ;
+		mMappedFiles.erase(iter) ;
+	}
+}
+
+void LLVOCache::closeMappedFiles()
+{
+	for(std::map<U64, LLVOCacheFile*>::iterator iter = mMappedFiles.begin() ; iter != mMappedFiles.end() ; ++iter)
+	{
+		iter->second->close() ;
+	}
+	mMappedFiles.clear() ;
+}
+
 BOOL LLVOCache::checkRead(LLAPRFile* apr_file, void* src, S32 n_bytes) 
 {
 	if(!check_read(apr_file, src, n_bytes))
@@ -467,7 +537,10 @@ void LLVOCache::writeCacheHeader()
 		return ;
 	}	
 
-	LLAPRFile* apr_file = new LLAPRFile(mHeaderFileName, APR_CREATE|APR_WRITE|APR_BINARY, mLocalAPRFilePoolp);
+	//write a new header and swap it in, so a crash while writing it
+	//does not lose the cache.
+	std::string temp_filename = mHeaderFileName + ".tmp" ;
+	LLAPRFile* apr_file = new LLAPRFile(temp_filename, APR_CREATE|APR_WRITE|APR_TRUNCATE|APR_BINARY, mLocalAPRFilePoolp);
 
 	//write the meta element
 	if(!checkWrite(apr_file, &mMetaInfo, sizeof(HeaderMetaInfo)))
@@ -494,6 +567,7 @@ void LLVOCache::writeCacheHeader()
 			//fill the cache with the default entry.
 			if(!checkWrite(apr_file, entry, sizeof(HeaderEntryInfo)))
 			{
+				delete entry ;
 				mReadOnly = TRUE ; //disable the cache.
 				return ;
 			}
@@ -501,6 +575,11 @@ void LLVOCache::writeCacheHeader()
 		delete entry ;
 	}
 	delete apr_file ;
+
+	if(!LLAPRFile::rename(temp_filename, mHeaderFileName, mLocalAPRFilePoolp))
+	{
+		LLAPRFile::remove(temp_filename, mLocalAPRFilePoolp) ;
+	}
 }
 
 BOOL LLVOCache::updateEntry(const HeaderEntryInfo* entry)
@@ -508,61 +587,52 @@ BOOL LLVOCache::updateEntry(const HeaderEntryInfo* entry)
 	LLAPRFile* apr_file = new LLAPRFile(mHeaderFileName, APR_WRITE|APR_BINARY, mLocalAPRFilePoolp);
 	apr_file->seek(APR_SET, entry->mIndex * sizeof(HeaderEntryInfo) + sizeof(HeaderMetaInfo)) ;
 
-	return checkWrite(apr_file, (void*)entry, sizeof(HeaderEntryInfo)) ;
+	if(!checkWrite(apr_file, (void*)entry, sizeof(HeaderEntryInfo)))
+	{
+		return FALSE ;
+	}
+	delete apr_file ;
+	return TRUE ;
 }
 
-void LLVOCache::readFromCache(U64 handle, const LLUUID& id, LLVOCacheEntry::vocache_entry_map_t& cache_entry_map) 
+LLVOCacheFile* LLVOCache::readFromCache(U64 handle, const LLUUID& id) 
 {
 	if(!mEnabled)
 	{
-		return ;
+		return NULL ;
 	}
 	llassert_always(mInitialized);
 
 	handle_entry_map_t::iterator iter = mHandleEntryMap.find(handle) ;
 	if(iter == mHandleEntryMap.end()) //no cache
 	{
-		return ;
+		return NULL ;
 	}
 
+	//the file of a region left a moment ago may still be being written
+	finishWrite(handle) ;
+
 	std::string filename;
 	getObjectCacheFilename(handle, filename);
-	LLAPRFile* apr_file = new LLAPRFile(filename, APR_READ|APR_BINARY, mLocalAPRFilePoolp);
-
-	LLUUID cache_id ;
-	if(!checkRead(apr_file, cache_id.mData, UUID_BYTES))
+	LLVOCacheFile* cache_file = new LLVOCacheFile() ;
+	if(!cache_file->open(filename, id))
 	{
-		return ;
-	}
-	if(cache_id != id)
-	{
-		llinfos << "Cache ID doesn't match for this region, discarding"<< llendl;
-
-		delete apr_file ;
-		return ;
+		delete cache_file ;
+		return NULL ;
 	}
+	mMappedFiles[handle] = cache_file ;
+	return cache_file ;
+}
 
-	S32 num_entries;
-	if(!checkRead(apr_file, &num_entries, sizeof(S32)))
-	{
-		return ;
-	}
-	
-	for (S32 i = 0; i < num_entries; i++)
+void LLVOCache::releaseCacheFile(U64 handle, LLVOCacheFile*& cache_file)
+{
+	std::map<U64, LLVOCacheFile*>::iterator iter = mMappedFiles.find(handle) ;
+	if(iter != mMappedFiles.end() && iter->second == cache_file)
 	{
-		LLVOCacheEntry* entry = new LLVOCacheEntry(apr_file);
-		if (!entry->getLocalID())
-		{
-			llwarns << "Aborting cache file load for " << filename << ", cache file corruption!" << llendl;
-			delete entry ;
-			break;
-		}
-		cache_entry_map[entry->getLocalID()] = entry;
+		mMappedFiles.erase(iter) ;
 	}
-	num_entries = cache_entry_map.size() ;
-
-	delete apr_file ;
-	return ;
+	delete cache_file ;
+	cache_file = NULL ;
 }
 	
 void LLVOCache::purgeEntries()
@@ -584,7 +654,9 @@ void LLVOCache::purgeEntries()
 	mNumEntries = mHandleEntryMap.size() ;
 }
 
-void LLVOCache::writeToCache(U64 handle, const LLUUID& id, const LLVOCacheEntry::vocache_entry_map_t& cache_entry_map, BOOL dirty_cache) 
+
+void LLVOCache::writeToCache(U64 handle, const LLUUID& id, LLVOCacheEntry::vocache_entry_map_t& cache_entry_map,
+							  LLVOCacheFile*& cache_file, BOOL dirty_cache) 
 {
 	if(!mEnabled)
 	{
@@ -612,9 +684,17 @@ void LLVOCache::writeToCache(U64 handle, const LLUUID& id, const LLVOCacheEntry:
 		entry->mIndex = mNumEntries++ ;
 		mHeaderEntryQueue.insert(entry) ;
 		mHandleEntryMap[handle] = entry ;
+
+		//add it to the cache header so the file can be found and purged
+		if(!updateEntry(entry))
+		{
+			return ; //update failed.
+		}
 	}
 	else
 	{
+		//the new time only matters for purging, so it is written out
+		//with the rest of the header on shutdown.
 		entry = iter->second ;
 		entry->mTime = time(NULL) ;
 
@@ -623,45 +703,260 @@ void LLVOCache::writeToCache(U64 handle, const LLUUID& id, const LLVOCacheEntry:
 		mHeaderEntryQueue.insert(entry) ;
 	}
 
-	//update cache header
-	if(!updateEntry(entry))
+	if(!dirty_cache)
 	{
-		return ; //update failed.
+		return ; //nothing changed, no need to update.
 	}
 
-	if(!dirty_cache)
+	//a region can be left and entered again before its last write is done
+	finishWrite(handle) ;
+
+	//bound the memory held by queued writes, finished ones are gone already
+	for(std::map<U64, LLQueuedThread::handle_t>::iterator write_iter = mPendingWrites.begin() ; write_iter != mPendingWrites.end() ; )
 	{
-		return ; //nothing changed, no need to update.
+		if(mWriteThread->getRequestStatus(write_iter->second) == LLQueuedThread::STATUS_EXPIRED)
+		{
+			mPendingWrites.erase(write_iter++) ;
+		}
+		else
+		{
+			++write_iter ;
+		}
+	}
+	while(mPendingWrites.size() >= MAX_PENDING_WRITES)
+	{
+		finishWrite(mPendingWrites.begin()->first) ;
+	}
+
+	//the writer owns the file now, finishWrite() waits until it is closed
+	std::map<U64, LLVOCacheFile*>::iterator mapped_iter = mMappedFiles.find(handle) ;
+	if(mapped_iter != mMappedFiles.end() && mapped_iter->second == cache_file)
+	{
+		mMappedFiles.erase(mapped_iter) ;
 	}
 
-	//write to cache file
 	std::string filename;
 	getObjectCacheFilename(handle, filename);
-	LLAPRFile* apr_file = new LLAPRFile(filename, APR_CREATE|APR_WRITE|APR_BINARY, mLocalAPRFilePoolp);
-	
-	if(!checkWrite(apr_file, (void*)id.mData, UUID_BYTES))
+	mPendingWrites[handle] = mWriteThread->write(handle, id, filename, cache_entry_map, cache_file) ;
+	cache_file = NULL ;
+}
+
+void LLVOCache::finishWrite(U64 handle)
+{
+	std::map<U64, LLQueuedThread::handle_t>::iterator iter = mPendingWrites.find(handle) ;
+	if(iter != mPendingWrites.end())
 	{
-		return ;
+		mWriteThread->waitForResult(iter->second) ;
+		mPendingWrites.erase(iter) ;
 	}
+}
 
-	S32 num_entries = cache_entry_map.size() ;
-	if(!checkWrite(apr_file, &num_entries, sizeof(S32)))
+void LLVOCache::finishWrites()
+{
+	for(std::map<U64, LLQueuedThread::handle_t>::iterator iter = mPendingWrites.begin() ; iter != mPendingWrites.end() ; ++iter)
 	{
-		return ;
+		mWriteThread->waitForResult(iter->second) ;
 	}
+	mPendingWrites.clear() ;
+}
 
-	for (LLVOCacheEntry::vocache_entry_map_t::const_iterator iter = cache_entry_map.begin(); iter != cache_entry_map.end(); ++iter)
+//-------------------------------------------------------------------
+//LLVOCacheWriteThread
+//-------------------------------------------------------------------
+class LLVOCacheWriteRequest : public LLQueuedThread::QueuedRequest
+{
+protected:
+	virtual ~LLVOCacheWriteRequest(); // use deleteRequest()
+
+public:
+	LLVOCacheWriteRequest(LLQueuedThread::handle_t handle, LLVolatileAPRPool* pool,
+						  U64 region_handle, const LLUUID& id, const std::string& filename,
+						  LLVOCacheEntry::vocache_entry_map_t& cache_entry_map, LLVOCacheFile* cache_file);
+
+	/*virtual*/ bool processRequest();
+
+private:
+	bool writeFile(S32& num_entries, U32& num_bytes);
+
+private:
+	LLVolatileAPRPool* mPool;
+	U64 mRegionHandle;
+	LLUUID mID;
+	std::string mFilename;
+	LLVOCacheEntry::vocache_entry_map_t mEntries;
+	LLVOCacheFile* mCacheFile;
+	LLTimer mTimer;
+};
+
+LLVOCacheWriteRequest::LLVOCacheWriteRequest(LLQueuedThread::handle_t handle, LLVolatileAPRPool* pool,
+											 U64 region_handle, const LLUUID& id, const std::string& filename,
+											 LLVOCacheEntry::vocache_entry_map_t& cache_entry_map, LLVOCacheFile* cache_file)
+	: LLQueuedThread::QueuedRequest(handle, LLQueuedThread::PRIORITY_NORMAL, LLQueuedThread::FLAG_AUTO_COMPLETE),
+	  mPool(pool),
+	  mRegionHandle(region_handle),
+	  mID(id),
+	  mFilename(filename),
+	  mCacheFile(cache_file ? cache_file : new LLVOCacheFile())
+{
+	//take the entries over instead of copying them, the region is
+	//done with them.
+	mEntries.swap(cache_entry_map) ;
+}
+
+LLVOCacheWriteRequest::~LLVOCacheWriteRequest()
+{
+	for(LLVOCacheEntry::vocache_entry_map_t::iterator iter = mEntries.begin() ; iter != mEntries.end() ; ++iter)
+	{
+		delete iter->second ;
+	}
+	delete mCacheFile ;
+}
+
+// WORKER THREAD
+bool LLVOCacheWriteRequest::processRequest()
+{
+	F64 queued_time = mTimer.getElapsedTimeF64() ;
+	mTimer.reset() ;
+
+	S32 num_entries = 0 ;
+	U32 num_bytes = 0 ;
+	bool success = writeFile(num_entries, num_bytes) ;
+
+	U32 region_x, region_y;
+	grid_from_region_handle(mRegionHandle, &region_x, &region_y);
+	if(success)
+	{
+		llinfos << "Wrote object cache of region " << region_x << ", " << region_y << ": "
+				<< num_entries << " entries, " << num_bytes << " bytes in "
+				<< mTimer.getElapsedTimeF64() * 1000.0 << " ms, queued for "
+				<< queued_time * 1000.0 << " ms" << llendl;
+	}
+	else
 	{
-		if(!iter->second->writeToFile(apr_file))
+		llwarns << "Failed to write object cache of region " << region_x << ", " << region_y << llendl;
+	}
+	return true ;
+}
+
+// WORKER THREAD
+// The file keeps the entries of cache_file that were never loaded, so
+// the region does not have to read the whole file in to save it.
+bool LLVOCacheWriteRequest::writeFile(S32& num_entries, U32& num_bytes)
+{
+	const LLVOCacheFile& cache_file = *mCacheFile ;
+
+	//merge the entries in memory with the ones never loaded from the file,
+	//both sorted by local id. Entries in memory win.
+	std::vector<LLVOCacheEntry::EntryInfo> index ;
+	std::vector<const U8*> data ;
+	index.reserve(mEntries.size() + cache_file.getNumEntries()) ;
+	data.reserve(index.capacity()) ;
+
+	LLVOCacheEntry::vocache_entry_map_t::const_iterator map_iter = mEntries.begin() ;
+	S32 file_index = 0 ;
+	S32 num_file_entries = cache_file.getNumEntries() ;
+	U32 max_file_entries = mEntries.size() < MAX_OBJECT_CACHE_ENTRIES ? 
+		MAX_OBJECT_CACHE_ENTRIES - mEntries.size() : 0 ;
+	U32 offset = CACHE_FILE_HEADER_SIZE ;
+	while(map_iter != mEntries.end() || file_index < num_file_entries)
+	{
+		LLVOCacheEntry::EntryInfo info ;
+		const U8* entry_data ;
+		if(file_index < num_file_entries &&
+		   (map_iter == mEntries.end() || cache_file.getEntryInfo(file_index).mLocalID < map_iter->first))
 		{
-			//failed
-			delete apr_file ;
-			removeCache() ;
-			return ;
+			info = cache_file.getEntryInfo(file_index++) ;
+			if(!max_file_entries)
+			{
+				continue ;
+			}
+			entry_data = cache_file.getEntryData(info) ;
+			if(!entry_data)
+			{
+				continue ;
+			}
+			max_file_entries-- ;
+		}
+		else
+		{
+			if(file_index < num_file_entries && cache_file.getEntryInfo(file_index).mLocalID == map_iter->first)
+			{
+				file_index++ ; //replaced by the entry in memory
+			}
+			map_iter->second->getEntryInfo(info) ;
+			entry_data = map_iter->second->getData() ;
+			++map_iter ;
+			if(!entry_data || info.mSize < 1)
+			{
+				continue ;
+			}
 		}
+		index.push_back(info) ;
+		data.push_back(entry_data) ;
+	}
+
+	num_entries = index.size() ;
+	offset += num_entries * sizeof(LLVOCacheEntry::EntryInfo) ;
+	for(S32 i = 0 ; i < num_entries ; i++)
+	{
+		index[i].mOffset = offset ;
+		offset += index[i].mSize ;
 	}
 
+	//build the whole file so it goes out in one write
+	std::vector<U8> buffer(offset) ;
+	memcpy(&buffer[0], mID.mData, UUID_BYTES) ;
+	memcpy(&buffer[UUID_BYTES], &num_entries, sizeof(S32)) ;
+	if(num_entries)
+	{
+		memcpy(&buffer[CACHE_FILE_HEADER_SIZE], &index[0], num_entries * sizeof(LLVOCacheEntry::EntryInfo)) ;
+	}
+	for(S32 i = 0 ; i < num_entries ; i++)
+	{
+		memcpy(&buffer[index[i].mOffset], data[i], index[i].mSize) ;
+	}
+	//everything is copied out, and the old file can't be replaced while
+	//it is mapped
+	mCacheFile->close() ;
+
+	//write a new file and swap it in, so a crash leaves either the old
+	//file or the new one, and the old one may still be mapped.
+	std::string temp_filename = mFilename + ".tmp" ;
+	LLAPRFile* apr_file = new LLAPRFile(temp_filename, APR_CREATE|APR_WRITE|APR_TRUNCATE|APR_BINARY, mPool);
+	bool written = apr_file->getFileHandle() && check_write(apr_file, &buffer[0], offset) ;
 	delete apr_file ;
-	return ;
+	if(!written)
+	{
+		LLAPRFile::remove(temp_filename, mPool) ;
+		return false ;
+	}
+
+	if(!LLAPRFile::rename(temp_filename, mFilename, mPool))
+	{
+		LLAPRFile::remove(temp_filename, mPool) ;
+		return false ;
+	}
+
+	num_bytes = offset ;
+	return true ;
 }
 
+LLVOCacheWriteThread::LLVOCacheWriteThread(bool threaded)
+	: LLQueuedThread("vocache", threaded)
+{
+}
+
+// MAIN THREAD
+LLVOCacheWriteThread::handle_t LLVOCacheWriteThread::write(U64 handle, const LLUUID& id, const std::string& filename,
+														   LLVOCacheEntry::vocache_entry_map_t& cache_entry_map, LLVOCacheFile* cache_file)
+{
+	handle_t req_handle = generateHandle();
+	LLVOCacheWriteRequest* req = new LLVOCacheWriteRequest(req_handle, getLocalAPRFilePool(), handle, id, filename,
+														   cache_entry_map, cache_file);
+	bool res = addRequest(req);
+	if (!res)
+	{
+		llerrs << "object cache write added after LLVOCacheWriteThread::shutdown()" << llendl;
+	}
+	return req_handle;
+}
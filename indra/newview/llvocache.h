@@ -31,6 +31,10 @@
 #include "lldatapacker.h"
 #include "lldlinked.h"
 #include "lldir.h"
+#include "llmappedfile.h"
+#include "llqueuedthread.h"
+
+const U32	MAX_OBJECT_CACHE_ENTRIES = 10000;
 
 
 //---------------------------------------------------------------------------
@@ -40,8 +44,20 @@ class LLVOCacheEntry;
 class LLVOCacheEntry
 {
 public:
+	// Index record of an entry in a region cache file, see LLVOCacheFile
+	struct EntryInfo
+	{
+		U32 mLocalID;
+		U32 mCRC;
+		S32 mHitCount;
+		S32 mDupeCount;
+		S32 mCRCChangeCount;
+		U32 mOffset;		// of the entry data from the start of the file
+		S32 mSize;
+	};
+
 	LLVOCacheEntry(U32 local_id, U32 crc, LLDataPackerBinaryBuffer &dp);
-	LLVOCacheEntry(LLAPRFile* apr_file);
+	LLVOCacheEntry(const EntryInfo& info, const U8* data);
 	LLVOCacheEntry();
 	~LLVOCacheEntry();
 
@@ -51,7 +67,10 @@ public:
 	S32 getCRCChangeCount() const	{ return mCRCChangeCount; }
 
 	void dump() const;
-	BOOL writeToFile(LLAPRFile* apr_file) const;
+	// Fills in everything but the offset.
+	void getEntryInfo(EntryInfo& info) const;
+	const U8* getData() const		{ return mBuffer; }
+	S32 getDataSize() const			{ return mDP.getBufferSize(); }
 	void assignCRC(U32 crc, LLDataPackerBinaryBuffer &dp);
 	LLDataPackerBinaryBuffer *getDP(U32 crc);
 	void recordHit();
@@ -71,7 +90,53 @@ protected:
 };
 
 //
-//Note: LLVOCache is not thread-safe
+// A region's object cache file, memory mapped. The file starts with the
+// region id, the entry count and an index of EntryInfo records sorted by
+// local id, followed by the entry data. Entries are only decoded when
+// the region asks for them, so objects the simulator never reports
+// are never read from disk.
+//
+class LLVOCacheFile
+{
+public:
+	LLVOCacheFile();
+
+	// Maps filename and checks it belongs to region id.
+	bool open(const std::string& filename, const LLUUID& id);
+	void close()								{ mFile.close(); mIndex = NULL; mNumEntries = 0; }
+	bool isOpen() const							{ return mFile.isOpen(); }
+
+	S32 getNumEntries() const					{ return mNumEntries; }
+	const LLVOCacheEntry::EntryInfo& getEntryInfo(S32 index) const	{ return mIndex[index]; }
+	// Returns NULL if the entry doesn't fit in the file.
+	const U8* getEntryData(const LLVOCacheEntry::EntryInfo& info) const;
+
+	// Creates a new entry for local_id, or returns NULL if there is none.
+	LLVOCacheEntry* loadEntry(U32 local_id) const;
+
+private:
+	LLMappedFile mFile;
+	const LLVOCacheEntry::EntryInfo* mIndex;
+	S32 mNumEntries;
+};
+
+//
+// Writes region cache files off the main thread. Each request owns the
+// entries and the mapped cache file of the region it writes, handed
+// over by LLVOCache::writeToCache().
+//
+class LLVOCacheWriteThread : public LLQueuedThread
+{
+public:
+	LLVOCacheWriteThread(bool threaded = true);
+
+	handle_t write(U64 handle, const LLUUID& id, const std::string& filename,
+				   LLVOCacheEntry::vocache_entry_map_t& cache_entry_map, LLVOCacheFile* cache_file);
+};
+
+//
+//Note: LLVOCache is not thread-safe, the cache files are written by
+//its LLVOCacheWriteThread
 //
 class LLVOCache
 {
@@ -109,8 +174,16 @@ public:
 	void initCache(ELLPath location, U32 size, U32 cache_version) ;
 	void removeCache(ELLPath location) ;
 
-	void readFromCache(U64 handle, const LLUUID& id, LLVOCacheEntry::vocache_entry_map_t& cache_entry_map) ;
-	void writeToCache(U64 handle, const LLUUID& id, const LLVOCacheEntry::vocache_entry_map_t& cache_entry_map, BOOL dirty_cache) ;
+	// Maps the region's cache file, or returns NULL if there is none.
+	LLVOCacheFile* readFromCache(U64 handle, const LLUUID& id) ;
+	// Queues cache_entry_map, plus the entries of cache_file that were
+	// never loaded, to be written out. A dirty cache hands both over to
+	// the writer, leaving cache_entry_map empty and cache_file NULL.
+	void writeToCache(U64 handle, const LLUUID& id, LLVOCacheEntry::vocache_entry_map_t& cache_entry_map,
+					  LLVOCacheFile*& cache_file, BOOL dirty_cache) ;
+	// Deletes a cache file from readFromCache() that writeToCache() did
+	// not hand over.
+	void releaseCacheFile(U64 handle, LLVOCacheFile*& cache_file) ;
 
 	void setReadOnly(BOOL read_only) {mReadOnly = read_only;} 
 
@@ -119,6 +192,10 @@ private:
 	// determine the cache filename for the region from the region handle	
 	void getObjectCacheFilename(U64 handle, std::string& filename);
 	void removeFromCache(U64 handle);
+	// Unmaps the cache files regions still hold, so they can be deleted.
+	// Windows can't delete or replace a mapped file.
+	void closeMappedFile(U64 handle);
+	void closeMappedFiles();
 	void readCacheHeader();
 	void writeCacheHeader();
 	void clearCacheInMemory();
@@ -127,6 +204,9 @@ private:
 	BOOL updateEntry(const HeaderEntryInfo* entry);
 	BOOL checkRead(LLAPRFile* apr_file, void* src, S32 n_bytes) ;
 	BOOL checkWrite(LLAPRFile* apr_file, void* src, S32 n_bytes) ;
+	// Waits for the pending write of a region, or all of them.
+	void finishWrite(U64 handle) ;
+	void finishWrites() ;
 	
 private:
 	BOOL                 mEnabled;
@@ -140,6 +220,9 @@ private:
 	LLVolatileAPRPool*   mLocalAPRFilePoolp ; 	
 	header_entry_queue_t mHeaderEntryQueue;
 	handle_entry_map_t   mHandleEntryMap;	
+	LLVOCacheWriteThread* mWriteThread ;
+	std::map<U64, LLQueuedThread::handle_t> mPendingWrites ;
+	std::map<U64, LLVOCacheFile*> mMappedFiles ;
 
 	static LLVOCache* sInstance ;
 public:
@@ -246,7 +246,7 @@ U32 LLVOGrass::processUpdateMessage(LLMessageSystem *mesgsys,
 										  void **user_data,
 										  U32 block_num,
 										  const EObjectUpdateType update_type,
-										  LLDataPacker *dp)
+										  LLDataPackerBinaryBuffer *dp)
 {
 	// Do base class updates...
 	U32 retval = LLViewerObject::processUpdateMessage(mesgsys, user_data, block_num, update_type, dp);
@@ -122,7 +122,7 @@ F32 LLVOPartGroup::getPartSize(S32 idx)
 {
 	if (idx < (S32) mViewerPartGroupp->mParticles.size())
 	{
-		return mViewerPartGroupp->mParticles[idx]->mScale.mV[0];
+		return mViewerPartGroupp->mPartArray.getScale(idx).mV[0];
 	}
 
 	return 0.f;
@@ -187,11 +187,13 @@ BOOL LLVOPartGroup::updateGeometry(LLDrawable *drawable)
 	mDepth = 0.f;
 	S32 i = 0 ;
 	LLVector3 camera_agent = getCameraPosition();
+	const LLPartArray& parts = mViewerPartGroupp->mPartArray;
 	for (i = 0 ; i < (S32)mViewerPartGroupp->mParticles.size(); i++)
 	{
 		const LLViewerPart *part = mViewerPartGroupp->mParticles[i];
 
-		LLVector3 part_pos_agent(part->mPosAgent);
+		LLVector3 part_pos_agent(parts.getPosition(i));
+		LLVector2 part_scale(parts.getScale(i));
 		LLVector3 at(part_pos_agent - camera_agent);
 
 		F32 camera_dist_squared = at.lengthSquared();
@@ -200,7 +202,7 @@ BOOL LLVOPartGroup::updateGeometry(LLDrawable *drawable)
 			inv_camera_dist_squared = 1.f / camera_dist_squared;
 		else
 			inv_camera_dist_squared = 1.f;
-		F32 area = part->mScale.mV[0] * part->mScale.mV[1] * inv_camera_dist_squared;
+		F32 area = part_scale.mV[0] * part_scale.mV[1] * inv_camera_dist_squared;
 		tot_area = llmax(tot_area, area);
  		
 		if (tot_area > max_area)
@@ -231,7 +233,7 @@ BOOL LLVOPartGroup::updateGeometry(LLDrawable *drawable)
 		
 		facep->setViewerObject(this);
 
-		if (part->mFlags & LLPartData::LL_PART_EMISSIVE_MASK)
+		if (parts.getFlags(i) & LLPartData::LL_PART_EMISSIVE_MASK)
 		{
 			facep->setState(LLFace::FULLBRIGHT);
 		}
@@ -240,8 +242,8 @@ BOOL LLVOPartGroup::updateGeometry(LLDrawable *drawable)
 			facep->clearState(LLFace::FULLBRIGHT);
 		}
 
-		facep->mCenterLocal = part->mPosAgent;
-		facep->setFaceColor(part->mColor);
+		facep->mCenterLocal = part_pos_agent;
+		facep->setFaceColor(parts.getColor(i));
 		facep->setTexture(part->mImagep);
 			
 		//check if this particle texture is replaced by a parcel media texture.
@@ -283,12 +285,13 @@ void LLVOPartGroup::getGeometry(S32 idx,
 		return;
 	}
 
-	const LLViewerPart &part = *((LLViewerPart*) (mViewerPartGroupp->mParticles[idx]));
+	const LLPartArray& parts = mViewerPartGroupp->mPartArray;
 
 	U32 vert_offset = mDrawable->getFace(idx)->getGeomIndex();
 
 	
-	LLVector3 part_pos_agent(part.mPosAgent);
+	LLVector3 part_pos_agent(parts.getPosition(idx));
+	LLVector2 part_scale(parts.getScale(idx));
 	LLVector3 camera_agent = getCameraPosition(); 
 	LLVector3 at = part_pos_agent - camera_agent;
 	LLVector3 up;
@@ -299,9 +302,9 @@ void LLVOPartGroup::getGeometry(S32 idx,
 	up = right % at;
 	up.normalize();
 
-	if (part.mFlags & LLPartData::LL_PART_FOLLOW_VELOCITY_MASK)
+	if (parts.getFlags(idx) & LLPartData::LL_PART_FOLLOW_VELOCITY_MASK)
 	{
-		LLVector3 normvel = part.mVelocity;
+		LLVector3 normvel = parts.getVelocity(idx);
 		normvel.normalize();
 		LLVector2 up_fracs;
 		up_fracs.mV[0] = normvel*right;
@@ -317,8 +320,8 @@ void LLVOPartGroup::getGeometry(S32 idx,
 		right.normalize();
 	}
 
-	right *= 0.5f*part.mScale.mV[0];
-	up *= 0.5f*part.mScale.mV[1];
+	right *= 0.5f*part_scale.mV[0];
+	up *= 0.5f*part_scale.mV[1];
 
 
 	LLVector3 normal = -LLViewerCamera::getInstance()->getXAxis();
@@ -328,10 +331,11 @@ void LLVOPartGroup::getGeometry(S32 idx,
 	*verticesp++ = part_pos_agent + up + right;
 	*verticesp++ = part_pos_agent - up + right;
 
-	*colorsp++ = part.mColor;
-	*colorsp++ = part.mColor;
-	*colorsp++ = part.mColor;
-	*colorsp++ = part.mColor;
+	LLColor4 part_color(parts.getColor(idx));
+	*colorsp++ = part_color;
+	*colorsp++ = part_color;
+	*colorsp++ = part_color;
+	*colorsp++ = part_color;
 
 	*texcoordsp++ = LLVector2(0.f, 1.f);
 	*texcoordsp++ = LLVector2(0.f, 0.f);
@@ -42,6 +42,7 @@
 #include "lldrawpoolsky.h"
 #include "lldrawpoolwater.h"
 #include "llglheaders.h"
+#include "lljobpool.h"
 #include "llsky.h"
 #include "llviewercamera.h"
 #include "llviewertexturelist.h"
@@ -195,15 +196,14 @@ S32 LLSkyTex::sCurrent = 0;
 
 
 LLSkyTex::LLSkyTex() :
-	mSkyData(NULL),
 	mSkyDirs(NULL)
 {
 }
 
 void LLSkyTex::init()
 {
-	mSkyData = new LLColor4[sResolution * sResolution];
 	mSkyDirs = new LLVector3[sResolution * sResolution];
+	mBackImageRaw = new LLImageRaw(sResolution, sResolution, sComponents);
 
 	for (S32 i = 0; i < 2; ++i)
 	{
@@ -232,9 +232,6 @@ void LLSkyTex::restoreGL()
 
 LLSkyTex::~LLSkyTex()
 {
-	delete[] mSkyData;
-	mSkyData = NULL;
-
 	delete[] mSkyDirs;
 	mSkyDirs = NULL;
 }
@@ -243,6 +240,7 @@ LLSkyTex::~LLSkyTex()
 void LLSkyTex::initEmpty(const S32 tex)
 {
 	U8* data = mImageRaw[tex]->getData();
+	U8* back_data = mBackImageRaw->getData();
 	for (S32 i = 0; i < sResolution; ++i)
 	{
 		for (S32 j = 0; j < sResolution; ++j)
@@ -254,7 +252,10 @@ void LLSkyTex::initEmpty(const S32 tex)
 			data[offset+2] = 0;
 			data[offset+3] = 255;
 
-			mSkyData[basic_offset].setToBlack();
+			back_data[offset] = 0;
+			back_data[offset+1] = 0;
+			back_data[offset+2] = 0;
+			back_data[offset+3] = 255;
 		}
 	}
 
@@ -264,18 +265,12 @@ void LLSkyTex::initEmpty(const S32 tex)
 void LLSkyTex::create(const F32 brightness)
 {
 	/// Brightness ignored for now.
-	U8* data = mImageRaw[sCurrent]->getData();
-	for (S32 i = 0; i < sResolution; ++i)
-	{
-		for (S32 j = 0; j < sResolution; ++j)
-		{
-			const S32 basic_offset = (i * sResolution + j);
-			S32 offset = basic_offset * sComponents;
-			U32* pix = (U32*)(data + offset);
-			LLColor4U temp = LLColor4U(mSkyData[basic_offset]);
-			*pix = temp.mAll;
-		}
-	}
+	// The back buffer holds a complete set of tiles by now. Swap it in
+	// as the current image, and reuse the image it replaces as the back
+	// buffer for the next cycle, which rewrites every tile.
+	LLPointer<LLImageRaw> front = mImageRaw[sCurrent];
+	mImageRaw[sCurrent] = mBackImageRaw;
+	mBackImageRaw = front;
 	createGLImage(sCurrent);
 }
 
@@ -383,6 +378,9 @@ LLVOSky::LLVOSky(const LLUUID &id, const LLPCode pcode, LLViewerRegion *regionp)
 	mDrawRefl = 0;
 	mHazeConcentration = 0.f;
 	mInterpVal = 0.f;
+
+	mTexturePool = NULL;
+	mCanUseWindLightShaders = FALSE;
 }
 
 
@@ -392,6 +390,8 @@ LLVOSky::~LLVOSky()
 	// This needs to be done for each texture
 
 	mCubeMap = NULL;
+
+	deleteAndClear(mTexturePool);
 }
 
 void LLVOSky::initClass()
@@ -409,14 +409,7 @@ void LLVOSky::init()
 	calcAtmospherics();
 
 	// Initialize the cached normalized direction vectors
-	for (S32 side = 0; side < 6; ++side)
-	{
-		for (S32 tile = 0; tile < NUM_TILES; ++tile)
-		{
-			initSkyTextureDirs(side, tile);
-			createSkyTexture(side, tile);
-		}
-	}
+	createSkyTextures(0, 6 * NUM_TILES, true);
 
 	for (S32 i = 0; i < 6; ++i)
 	{
@@ -545,13 +538,77 @@ void LLVOSky::createSkyTexture(const S32 side, const S32 tile)
 	S32 tile_x_pos = tile_x * sTileResX;
 	S32 tile_y_pos = tile_y * sTileResY;
 
+	LLColor4 sky_color;
+	LLColor4 shiny_color;
 	S32 x, y;
 	for (y = tile_y_pos; y < (tile_y_pos + sTileResY); ++y)
 	{
 		for (x = tile_x_pos; x < (tile_x_pos + sTileResX); ++x)
 		{
-			mSkyTex[side].setPixel(calcSkyColorInDir(mSkyTex[side].getDir(x, y)), x, y);
-			mShinyTex[side].setPixel(calcSkyColorInDir(mSkyTex[side].getDir(x, y), true), x, y);
+			calcSkyColorsInDir(mSkyTex[side].getDir(x, y), sky_color, shiny_color);
+			mSkyTex[side].setPixel(sky_color, x, y);
+			mShinyTex[side].setPixel(shiny_color, x, y);
+		}
+	}
+}
+
+//------------------------------------------------------------------------
+// LLSkyTextureJob
+// initializes and generates one tile of the sky textures per index
+//------------------------------------------------------------------------
+class LLSkyTextureJob : public LLJobPool::Job
+{
+public:
+	LLSkyTextureJob(LLVOSky* sky, S32 first_tile, bool init_dirs)
+	:	mSky(sky),
+		mFirstTile(first_tile),
+		mInitDirs(init_dirs)
+	{
+	}
+
+	/*virtual*/ void run(S32 index)
+	{
+		const S32 side = (mFirstTile + index) / NUM_TILES;
+		const S32 tile = (mFirstTile + index) % NUM_TILES;
+		if (mInitDirs)
+		{
+			mSky->initSkyTextureDirs(side, tile);
+		}
+		mSky->createSkyTexture(side, tile);
+	}
+
+private:
+	LLVOSky* mSky;
+	S32 mFirstTile;
+	bool mInitDirs;
+};
+
+void LLVOSky::createSkyTextures(const S32 first_tile, const S32 count, const bool init_dirs)
+{
+	static LLCachedControl<U32> texture_threads(gSavedSettings, "SkyTextureThreads");
+
+	S32 num_threads = llmin((S32)texture_threads, 16);
+	if (mTexturePool && mTexturePool->getNumThreads() != num_threads)
+	{
+		deleteAndClear(mTexturePool);
+	}
+	if (!mTexturePool && num_threads > 0)
+	{
+		mTexturePool = new LLJobPool("Sky Texture", num_threads);
+	}
+
+	// Tiles write disjoint texels of the back buffers and only read the
+	// atmospheric state, which doesn't change until the batch is done.
+	LLSkyTextureJob job(this, first_tile, init_dirs);
+	if (mTexturePool)
+	{
+		mTexturePool->run(job, count);
+	}
+	else
+	{
+		for (S32 i = 0; i < count; ++i)
+		{
+			job.run(i);
 		}
 	}
 }
@@ -669,42 +726,78 @@ void LLVOSky::initAtmospherics(void)
 	{
 		lightnorm.mV[1] = -0.1f;
 	}
-	
+
+	// read here, on the main thread, since the sky texture jobs need it
+	mCanUseWindLightShaders = gPipeline.canUseWindLightShaders();
+
+	// Sunlight attenuation effect (hue and brightness) due to atmosphere
+	// this is used later for sunlight modulation at various altitudes
+	mSkyLightAtten =
+		(blue_density * 1.0 + smear(haze_density * 0.25f)) * (density_multiplier * max_y);
+
+	// Calculate relative weights
+	mSkyDensity = blue_density + smear(haze_density);
+	mSkyBlueWeight = componentDiv(blue_density, mSkyDensity);
+	mSkyHazeWeight = componentDiv(smear(haze_density), mSkyDensity);
+
+	// Sunlight below the clouds
+	mSkyCloudSunlight = sunlight_color;
+	F32 inv_light_y = 1.f / llmax(0.f, lightnorm[1] * 2.f);
+	componentMultBy(mSkyCloudSunlight, componentExp((mSkyLightAtten * -1.f) * inv_light_y));
+
+	// Increase ambient when there are more clouds
+	mSkyCloudAmbient = ambient + (LLColor3::white - ambient) * cloud_shadow * 0.5f;
 }
 
 LLColor4 LLVOSky::calcSkyColorInDir(const LLVector3 &dir, bool isShiny)
+{
+	LLColor4 sky_color;
+	LLColor4 shiny_color;
+	calcSkyColorsInDir(dir, sky_color, shiny_color);
+	return isShiny ? shiny_color : sky_color;
+}
+
+static inline void attenuate_below_horizon(LLColor4& col, F32 x)
+{
+	col.mV[0] *= x*x;
+	col.mV[1] *= powf(x, 2.5f);
+	col.mV[2] *= x*x*x;
+}
+
+// Computes the sky and shiny colors together, since the shiny color is
+// a desaturated copy of the sky color and the scattering model is the
+// expensive part.
+void LLVOSky::calcSkyColorsInDir(const LLVector3& dir, LLColor4& sky_color, LLColor4& shiny_color)
 {
 	F32 saturation = 0.3f;
 	if (dir.mV[VZ] < -0.02f)
 	{
-		LLColor4 col = LLColor4(llmax(mFogColor[0],0.2f), llmax(mFogColor[1],0.2f), llmax(mFogColor[2],0.22f),0.f);
-		if (isShiny)
+		sky_color = LLColor4(llmax(mFogColor[0],0.2f), llmax(mFogColor[1],0.2f), llmax(mFogColor[2],0.22f),0.f);
+
+		LLColor3 desat_fog = LLColor3(mFogColor);
+		F32 brightness = desat_fog.brightness();
+		// So that shiny somewhat shows up at night.
+		if (brightness < 0.15f)
 		{
-			LLColor3 desat_fog = LLColor3(mFogColor);
-			F32 brightness = desat_fog.brightness();
-			// So that shiny somewhat shows up at night.
-			if (brightness < 0.15f)
-			{
-				brightness = 0.15f;
-				desat_fog = smear(0.15f);
-			}
-			LLColor3 greyscale = smear(brightness);
-			desat_fog = desat_fog * saturation + greyscale * (1.0f - saturation);
-			if (!gPipeline.canUseWindLightShaders())
-			{
-				col = LLColor4(desat_fog, 0.f);
-			}
-			else 
-			{
-				col = LLColor4(desat_fog * 0.5f, 0.f);
-			}
+			brightness = 0.15f;
+			desat_fog = smear(0.15f);
+		}
+		LLColor3 greyscale = smear(brightness);
+		desat_fog = desat_fog * saturation + greyscale * (1.0f - saturation);
+		if (!mCanUseWindLightShaders)
+		{
+			shiny_color = LLColor4(desat_fog, 0.f);
 		}
+		else 
+		{
+			shiny_color = LLColor4(desat_fog * 0.5f, 0.f);
+		}
+
 		float x = 1.0f-fabsf(-0.1f-dir.mV[VZ]);
 		x *= x;
-		col.mV[0] *= x*x;
-		col.mV[1] *= powf(x, 2.5f);
-		col.mV[2] *= x*x*x;
-		return col;
+		attenuate_below_horizon(sky_color, x);
+		attenuate_below_horizon(shiny_color, x);
+		return;
 	}
 
 	// undo OGL_TO_CFR_ROTATION and negate vertical direction.
@@ -721,16 +814,15 @@ LLColor4 LLVOSky::calcSkyColorInDir(const LLVector3 &dir, bool isShiny)
 	calcSkyColorWLVert(Pn, vary_HazeColor, vary_CloudColorSun, vary_CloudColorAmbient,
 						vary_CloudDensity, vary_HorizontalProjection);
 	
-	LLColor3 sky_color =  calcSkyColorWLFrag(Pn, vary_HazeColor, vary_CloudColorSun, vary_CloudColorAmbient, 
+	LLColor3 color =  calcSkyColorWLFrag(Pn, vary_HazeColor, vary_CloudColorSun, vary_CloudColorAmbient, 
 								vary_CloudDensity, vary_HorizontalProjection);
-	if (isShiny)
-	{
-		F32 brightness = sky_color.brightness();
-		LLColor3 greyscale = smear(brightness);
-		sky_color = sky_color * saturation + greyscale * (1.0f - saturation);
-		sky_color *= (0.5f + 0.5f * brightness);
-	}
-	return LLColor4(sky_color, 0.0f);
+	sky_color = LLColor4(color, 0.0f);
+
+	F32 brightness = color.brightness();
+	LLColor3 greyscale = smear(brightness);
+	color = color * saturation + greyscale * (1.0f - saturation);
+	color *= (0.5f + 0.5f * brightness);
+	shiny_color = LLColor4(color, 0.0f);
 }
 
 // turn on floating point precision
@@ -770,16 +862,13 @@ void LLVOSky::calcSkyColorWLVert(LLVector3 & Pn, LLColor3 & vary_HazeColor, LLCo
 	// Initialize temp variables
 	LLColor3 sunlight = sunlight_color;
 
-	// Sunlight attenuation effect (hue and brightness) due to atmosphere
-	// this is used later for sunlight modulation at various altitudes
-	LLColor3 light_atten =
-		(blue_density * 1.0 + smear(haze_density * 0.25f)) * (density_multiplier * max_y);
-
-	// Calculate relative weights
+	// The attenuation and relative weights don't depend on the
+	// direction, see initAtmospherics()
+	const LLColor3& light_atten = mSkyLightAtten;
+	const LLColor3& blue_weight = mSkyBlueWeight;
+	const LLColor3& haze_weight = mSkyHazeWeight;
 	LLColor3 temp2(0.f, 0.f, 0.f);
-	LLColor3 temp1 = blue_density + smear(haze_density);
-	LLColor3 blue_weight = componentDiv(blue_density, temp1);
-	LLColor3 haze_weight = componentDiv(smear(haze_density), temp1);
+	LLColor3 temp1 = mSkyDensity;
 
 	// Compute sunlight from P & lightnorm (for long rays like sky)
 	temp2.mV[1] = llmax(F_APPROXIMATELY_ZERO, llmax(0.f, Pn[1]) * 1.0f + lightnorm[1] );
@@ -816,7 +905,7 @@ void LLVOSky::calcSkyColorWLVert(LLVector3 & Pn, LLColor3 & vary_HazeColor, LLCo
 			 );	
 
 	// Increase ambient when there are more clouds
-	LLColor3 tmpAmbient = ambient + (LLColor3::white - ambient) * cloud_shadow * 0.5f;
+	const LLColor3& tmpAmbient = mSkyCloudAmbient;
 
 	// Dim sunlight by cloud shadow percentage
 	sunlight *= (1.f - cloud_shadow);
@@ -829,10 +918,7 @@ void LLVOSky::calcSkyColorWLVert(LLVector3 & Pn, LLColor3 & vary_HazeColor, LLCo
 	// Final atmosphere additive
 	componentMultBy(vary_HazeColor, LLColor3::white - temp1);
 
-	sunlight = sunlight_color;
-	temp2.mV[1] = llmax(0.f, lightnorm[1] * 2.f);
-	temp2.mV[1] = 1.f / temp2.mV[1];
-	componentMultBy(sunlight, componentExp((light_atten * -1.f) * temp2.mV[1]));
+	sunlight = mSkyCloudSunlight;
 
 	// Attenuate cloud color by atmosphere
 	temp1 = componentSqrt(temp1);	//less atmos opacity (more transparency) below clouds
@@ -874,7 +960,7 @@ LLColor3 LLVOSky::calcSkyColorWLFrag(LLVector3 & Pn, LLColor3 & vary_HazeColor,
 
 	LLColor3 color0 = vary_HazeColor;
 	
-	if (!gPipeline.canUseWindLightShaders())
+	if (!mCanUseWindLightShaders)
 	{
 		LLColor3 color1 = color0 * 2.0f;
 		color1 = smear(1.f) - componentSaturate(color1);
@@ -1061,6 +1147,8 @@ BOOL LLVOSky::updateSky()
 		return TRUE;
 	}
 
+	static LLCachedControl<U32> tiles_per_update(gSavedSettings, "SkyTextureTilesPerUpdate");
+
 	static S32 next_frame = 0;
 	const S32 total_no_tiles = 6 * NUM_TILES;
 	const S32 cycle_frame_no = total_no_tiles + 1;
@@ -1070,8 +1158,10 @@ BOOL LLVOSky::updateSky()
 		mUpdateTimer.reset();
 		const S32 frame = next_frame;
 
-		++next_frame;
-		next_frame = next_frame % cycle_frame_no;
+		// Each update generates up to the tile budget, and the update
+		// after the last tile swaps the finished textures in.
+		const S32 num_tiles = llclamp((S32)tiles_per_update, 1, total_no_tiles);
+		next_frame = (frame < total_no_tiles) ? llmin(frame + num_tiles, total_no_tiles) : 0;
 
 		mInterpVal = (!mInitialized) ? 1 : (F32)next_frame / cycle_frame_no;
 		// sInterpVal = (F32)next_frame / cycle_frame_no;
@@ -1081,6 +1171,7 @@ BOOL LLVOSky::updateSky()
 
 		if (mForceUpdate || total_no_tiles == frame)
 		{
+			BOOL sync_textures = FALSE;
 			LLSkyTex::stepCurrent();
 			
 			const static F32 LIGHT_DIRECTION_THRESHOLD = (F32) cos(DEG_TO_RAD * 1.f);
@@ -1110,33 +1201,24 @@ BOOL LLVOSky::updateSky()
                     if (mForceUpdate)
 					{
 						updateFog(LLViewerCamera::getInstance()->getFar());
-						for (int side = 0; side < 6; side++) 
-						{
-							for (int tile = 0; tile < NUM_TILES; tile++) 
-							{
-								createSkyTexture(side, tile);
-							}
-						}
+						createSkyTextures(0, total_no_tiles);
 
 						calcAtmospherics();
 
-						for (int side = 0; side < 6; side++) 
-						{
-							LLImageRaw* raw1 = mSkyTex[side].getImageRaw(TRUE);
-							LLImageRaw* raw2 = mSkyTex[side].getImageRaw(FALSE);
-							raw2->copy(raw1);
-							mSkyTex[side].createGLImage(mSkyTex[side].getWhich(FALSE));
-
-							raw1 = mShinyTex[side].getImageRaw(TRUE);
-							raw2 = mShinyTex[side].getImageRaw(FALSE);
-							raw2->copy(raw1);
-							mShinyTex[side].createGLImage(mShinyTex[side].getWhich(FALSE));
-						}
+						sync_textures = TRUE;
 						next_frame = 0;	
 					}
 				}
 			}
 
+			// a forced update can land mid-cycle, so finish the back buffers
+			// before swapping them in
+			if (!sync_textures && frame < total_no_tiles)
+			{
+				createSkyTextures(frame, total_no_tiles - frame);
+				next_frame = 0;
+			}
+
 			/// *TODO really, sky texture and env map should be shared on a single texture
 			/// I'll let Brad take this at some point
 
@@ -1146,6 +1228,23 @@ BOOL LLVOSky::updateSky()
 				mSkyTex[i].create(1.0f);
 				mShinyTex[i].create(1.0f);
 			}
+
+			// after a forced update there is nothing to interpolate from
+			if (sync_textures)
+			{
+				for (int side = 0; side < 6; side++) 
+				{
+					LLImageRaw* raw1 = mSkyTex[side].getImageRaw(TRUE);
+					LLImageRaw* raw2 = mSkyTex[side].getImageRaw(FALSE);
+					raw2->copy(raw1);
+					mSkyTex[side].createGLImage(mSkyTex[side].getWhich(FALSE));
+
+					raw1 = mShinyTex[side].getImageRaw(TRUE);
+					raw2 = mShinyTex[side].getImageRaw(FALSE);
+					raw2->copy(raw1);
+					mShinyTex[side].createGLImage(mShinyTex[side].getWhich(FALSE));
+				}
+			}
 			
 			// update the environment map
 			if (mCubeMap)
@@ -1168,9 +1267,7 @@ BOOL LLVOSky::updateSky()
 		}
 		else
 		{
-			const S32 side = frame / NUM_TILES;
-			const S32 tile = frame % NUM_TILES;
-			createSkyTexture(side, tile);
+			createSkyTextures(frame, next_frame - frame);
 		}
 	}
 
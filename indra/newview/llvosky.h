@@ -108,6 +108,7 @@ inline F32 color_min(const LLColor3 &col)
 
 class LLFace;
 class LLHaze;
+class LLJobPool;
 
 
 class LLSkyTex
@@ -118,7 +119,7 @@ private:
 	static S32		sComponents;
 	LLPointer<LLViewerTexture> mTexture[2];
 	LLPointer<LLImageRaw> mImageRaw[2];
-	LLColor4		*mSkyData;
+	LLPointer<LLImageRaw> mBackImageRaw;	// Filled tile by tile, swapped in by create()
 	LLVector3		*mSkyDirs;			// Cache of sky direction vectors
 	static S32		sCurrent;
 	static F32		sInterpVal;
@@ -161,10 +162,13 @@ protected:
 		return mSkyDirs[offset];
 	}
 
+	// Writes to the back buffer, so it is safe to call from a job
+	// while the current images are being drawn.
 	void setPixel(const LLColor4 &col, const S32 i, const S32 j)
 	{
-		S32 offset = i * sResolution + j;
-		mSkyData[offset] = col;
+		S32 offset = (i * sResolution + j) * sComponents;
+		U32* pix = (U32*) &(mBackImageRaw->getData()[offset]);
+		*pix = LLColor4U(col).mAll;
 	}
 
 	void setPixel(const LLColor4U &col, const S32 i, const S32 j)
@@ -493,7 +497,12 @@ public:
 	void initSkyTextureDirs(const S32 side, const S32 tile);
 	void createSkyTexture(const S32 side, const S32 tile);
 
+	// Generates count tiles starting at first_tile, numbered across all
+	// six sides, on the sky texture job pool.
+	void createSkyTextures(const S32 first_tile, const S32 count, const bool init_dirs = false);
+
 	LLColor4 calcSkyColorInDir(const LLVector3& dir, bool isShiny = false);
+	void calcSkyColorsInDir(const LLVector3& dir, LLColor4& sky_color, LLColor4& shiny_color);
 	
 	LLColor3 calcRadianceAtPoint(const LLVector3& pos) const
 	{
@@ -627,6 +636,18 @@ protected:
 
 	LLFrameTimer		mUpdateTimer;
 
+	// Sky texture generation. Direction independent terms of the
+	// scattering model are computed once per update by
+	// initAtmospherics() so the jobs only evaluate per-texel math.
+	LLJobPool*			mTexturePool;
+	BOOL				mCanUseWindLightShaders;
+	LLColor3			mSkyLightAtten;
+	LLColor3			mSkyDensity;
+	LLColor3			mSkyBlueWeight;
+	LLColor3			mSkyHazeWeight;
+	LLColor3			mSkyCloudSunlight;
+	LLColor3			mSkyCloudAmbient;
+
 public:
 	//by bao
 	//fake vertex buffer updating
@@ -45,6 +45,52 @@
 
 F32 LLVOSurfacePatch::sLODFactor = 1.f;
 
+// Triangle strip order of the main patch grid for vert_size points on a
+// side, relative to the patch's first vertex. There are only a handful of
+// LODs, so each list is built once and copied for every patch.
+static const std::vector<U16>& get_main_indices(S32 vert_size)
+{
+	static std::map<S32, std::vector<U16> > main_indices;
+
+	std::vector<U16>& indices = main_indices[vert_size];
+	if (!indices.empty() || vert_size < 2)
+	{
+		return indices;
+	}
+
+	indices.reserve((vert_size - 1)*(vert_size - 1)*6);
+	for (S32 j = 0; j < (vert_size - 1); j++)
+	{
+		if (j % 2)
+		{
+			for (S32 i = (vert_size - 1); i > 0; i--)
+			{
+				indices.push_back((i - 1) + j*vert_size);
+				indices.push_back(i + (j+1)*vert_size);
+				indices.push_back((i - 1) + (j+1)*vert_size);
+
+				indices.push_back((i - 1) + j*vert_size);
+				indices.push_back(i + j*vert_size);
+				indices.push_back(i + (j+1)*vert_size);
+			}
+		}
+		else
+		{
+			for (S32 i = 0; i < (vert_size - 1); i++)
+			{
+				indices.push_back(i + j*vert_size);
+				indices.push_back((i + 1) + (j+1)*vert_size);
+				indices.push_back(i + (j+1)*vert_size);
+
+				indices.push_back(i + j*vert_size);
+				indices.push_back((i + 1) + j*vert_size);
+				indices.push_back((i + 1) + (j + 1)*vert_size);
+			}
+		}
+	}
+	return indices;
+}
+
 //============================================================================
 
 class LLVertexBufferTerrain : public LLVertexBuffer
@@ -90,7 +136,8 @@ LLVOSurfacePatch::LLVOSurfacePatch(const LLUUID &id, const LLPCode pcode, LLView
 		mLastNorthStride(0),
 		mLastEastStride(0),
 		mLastStride(0),
-		mLastLength(0)
+		mLastLength(0),
+		mMainVerticesVersion(0)
 {
 	// Terrain must draw during selection passes so it can block objects behind it.
 	mbCanSelect = TRUE;
@@ -323,7 +370,6 @@ void LLVOSurfacePatch::updateMainGeometry(LLFace *facep,
 
 	U32 patch_size, render_stride;
 	S32 num_vertices, num_indices;
-	U32 index;
 
 	render_stride = mLastStride;
 	patch_size = mPatchp->getSurface()->getGridsPerPatchEdge();
@@ -344,70 +390,44 @@ void LLVOSurfacePatch::updateMainGeometry(LLFace *facep,
 	{
 		facep->mCenterAgent = mPatchp->getPointAgent(8, 8);
 
-		// Generate patch points first
-		for (j = 0; j < vert_size; j++)
+		LLVector3 origin_agent = mPatchp->getOriginAgent();
+		if (mMainVerticesVersion != mPatchp->getGeometryVersion() || mMainVerticesOrigin != origin_agent)
 		{
-			for (i = 0; i < vert_size; i++)
-			{
-				x = i * render_stride;
-				y = j * render_stride;
-				mPatchp->eval(x, y, render_stride, verticesp.get(), normalsp.get(), texCoords0p.get(), texCoords1p.get());
-				*colorsp++ = LLColor4U::white;
-				verticesp++;
-				normalsp++;
-				texCoords0p++;
-				texCoords1p++;
-			}
+			mMainVertices.clear();
+			mMainVerticesVersion = mPatchp->getGeometryVersion();
+			mMainVerticesOrigin = origin_agent;
 		}
 
-		for (j = 0; j < (vert_size - 1); j++)
+		// Generate patch points first
+		std::vector<LLTerrainVertex>& points = mMainVertices[render_stride];
+		if (points.empty())
 		{
-			if (j % 2)
+			points.resize(vert_size*vert_size);
+			for (j = 0; j < vert_size; j++)
 			{
-				for (i = (vert_size - 1); i > 0; i--)
+				for (i = 0; i < vert_size; i++)
 				{
-					index = (i - 1)+ j*vert_size;
-					*(indicesp++) = index_offset + index;
-
-					index = i + (j+1)*vert_size;
-					*(indicesp++) = index_offset + index;
-
-					index = (i - 1) + (j+1)*vert_size;
-					*(indicesp++) = index_offset + index;
-
-					index = (i - 1) + j*vert_size;
-					*(indicesp++) = index_offset + index;
-
-					index = i + j*vert_size;
-					*(indicesp++) = index_offset + index;
-
-					index = i + (j+1)*vert_size;
-					*(indicesp++) = index_offset + index;
+					x = i * render_stride;
+					y = j * render_stride;
+					LLTerrainVertex& point = points[i + j*vert_size];
+					mPatchp->eval(x, y, render_stride, &point.mPosition, &point.mNormal, &point.mTexCoord0, &point.mTexCoord1);
 				}
 			}
-			else
-			{
-				for (i = 0; i < (vert_size - 1); i++)
-				{
-					index = i + j*vert_size;
-					*(indicesp++) = index_offset + index;
-
-					index = (i + 1) + (j+1)*vert_size;
-					*(indicesp++) = index_offset + index;
-
-					index = i + (j+1)*vert_size;
-					*(indicesp++) = index_offset + index;
-
-					index = i + j*vert_size;
-					*(indicesp++) = index_offset + index;
+		}
 
-					index = (i + 1) + j*vert_size;
-					*(indicesp++) = index_offset + index;
+		for (U32 k = 0; k < points.size(); k++)
+		{
+			*verticesp++ = points[k].mPosition;
+			*normalsp++ = points[k].mNormal;
+			*texCoords0p++ = points[k].mTexCoord0;
+			*texCoords1p++ = points[k].mTexCoord1;
+			*colorsp++ = LLColor4U::white;
+		}
 
-					index = (i + 1) + (j + 1)*vert_size;
-					*(indicesp++) = index_offset + index;
-				}
-			}
+		const std::vector<U16>& indices = get_main_indices(vert_size);
+		for (U32 k = 0; k < indices.size(); k++)
+		{
+			*(indicesp++) = index_offset + indices[k];
 		}
 	}
 	index_offset += num_vertices;
@@ -816,6 +836,7 @@ void LLVOSurfacePatch::updateEastGeometry(LLFace *facep,
 void LLVOSurfacePatch::setPatch(LLSurfacePatch *patchp)
 {
 	mPatchp = patchp;
+	mMainVertices.clear();
 
 	dirtyPatch();
 };
@@ -29,6 +29,7 @@
 
 #include "llviewerobject.h"
 #include "llstrider.h"
+#include "v2math.h"
 
 class LLSurfacePatch;
 class LLDrawPool;
@@ -107,6 +108,22 @@ protected:
 	S32				mLastStride;
 	S32				mLastLength;
 
+	// A main grid point as LLSurfacePatch::eval() returns it
+	struct LLTerrainVertex
+	{
+		LLVector3	mPosition;
+		LLVector3	mNormal;
+		LLVector2	mTexCoord0;
+		LLVector2	mTexCoord1;
+	};
+
+	// Main grid points for each render stride drawn since the patch last
+	// changed. A spatial group rebuilds all its patches when one of them
+	// changes, and the rest are copied from here.
+	std::map<S32, std::vector<LLTerrainVertex> > mMainVertices;
+	U32				mMainVerticesVersion;
+	LLVector3		mMainVerticesOrigin;
+
 	void getGeomSizesMain(const S32 stride, S32 &num_vertices, S32 &num_indices);
 	void getGeomSizesNorth(const S32 stride, const S32 north_stride,
 								  S32 &num_vertices, S32 &num_indices);
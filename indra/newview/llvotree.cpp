@@ -272,7 +272,7 @@ void LLVOTree::cleanupClass()
 U32 LLVOTree::processUpdateMessage(LLMessageSystem *mesgsys,
 										  void **user_data,
 										  U32 block_num, EObjectUpdateType update_type,
-										  LLDataPacker *dp)
+										  LLDataPackerBinaryBuffer *dp)
 {
 	// Do base class updates...
 	U32 retval = LLViewerObject::processUpdateMessage(mesgsys, user_data, block_num, update_type, dp);
@@ -282,7 +282,7 @@ void LLVOVolume::cleanupClass()
 U32 LLVOVolume::processUpdateMessage(LLMessageSystem *mesgsys,
 										  void **user_data,
 										  U32 block_num, EObjectUpdateType update_type,
-										  LLDataPacker *dp)
+										  LLDataPackerBinaryBuffer *dp)
 {
 	LLColor4U color;
 	const S32 teDirtyBits = (TEM_CHANGE_TEXTURE|TEM_CHANGE_COLOR|TEM_CHANGE_MEDIA);
@@ -440,7 +440,16 @@ U32 LLVOVolume::processUpdateMessage(LLMessageSystem *mesgsys,
 			{
 				U8							tdpbuffer[1024];
 				LLDataPackerBinaryBuffer	tdp(tdpbuffer, 1024);
-				mesgsys->getBinaryDataFast(_PREHASH_ObjectData, _PREHASH_TextureEntry, tdpbuffer, 0, block_num);
+				// read the texture entry in place when the message allows it
+				const U8* te_data = mesgsys->getBinaryDataPointerFast(_PREHASH_ObjectData, _PREHASH_TextureEntry, texture_length, block_num);
+				if (te_data)
+				{
+					tdp.assignBuffer(const_cast<U8*>(te_data), texture_length);
+				}
+				else
+				{
+					mesgsys->getBinaryDataFast(_PREHASH_ObjectData, _PREHASH_TextureEntry, tdpbuffer, 0, block_num);
+				}
 				S32 result = unpackTEMessage(tdp);
 				if (result & teDirtyBits)
 				{
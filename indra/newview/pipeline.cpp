@@ -66,6 +66,7 @@
 #include "llhudmanager.h"
 #include "llhudnametag.h"
 #include "llhudtext.h"
+#include "llimpostormanager.h"
 #include "lllightconstants.h"
 #include "llresmgr.h"
 #include "llselectmgr.h"
@@ -8633,6 +8634,46 @@ void LLPipeline::generateImpostor(LLVOAvatar* avatar)
 
 	assertInitialized();
 
+	LLViewerCamera* viewer_camera = LLViewerCamera::getInstance();
+	const LLVector3* ext = avatar->mDrawable->getSpatialExtents();
+	LLVector3 pos(avatar->getRenderPosition()+avatar->getImpostorOffset());
+
+	LLCamera camera = *viewer_camera;
+
+	camera.lookAt(viewer_camera->getOrigin(), pos, viewer_camera->getUpAxis());
+	
+	LLVector2 tdim;
+
+	LLVector3 half_height = (ext[1]-ext[0])*0.5f;
+
+	LLVector3 left = camera.getLeftAxis();
+	left *= left;
+	left.normalize();
+
+	LLVector3 up = camera.getUpAxis();
+	up *= up;
+	up.normalize();
+
+	tdim.mV[0] = fabsf(half_height * left);
+	tdim.mV[1] = fabsf(half_height * up);
+
+	F32 distance = (pos-camera.getOrigin()).length();
+	F32 fov = atanf(tdim.mV[1]/distance)*2.f*RAD_TO_DEG;
+
+	// get the number of pixels per angle
+	F32 pa = gViewerWindow->getWindowHeightRaw() / (RAD_TO_DEG * viewer_camera->getView());
+
+	//get resolution based on angle width and height of impostor (double desired resolution to prevent aliasing)
+	U32 resY = llmin(nhpo2((U32) (fov*pa)), (U32) 512);
+	U32 resX = llmin(nhpo2((U32) (atanf(tdim.mV[0]/distance)*2.f*RAD_TO_DEG*pa)), (U32) 512);
+
+	// before any culling, which would be wasted without a target
+	LLRenderTarget* impostor = LLImpostorManager::getInstance()->allocateTarget(avatar, resX, resY);
+	if (!impostor)
+	{ //impostor memory is all in use, the avatar is drawn in full for now
+		return;
+	}
+
 	BOOL muted = LLMuteList::getInstance()->isMuted(avatar->getID());
 
 	pushRenderTypeMask();
@@ -8669,7 +8710,6 @@ void LLPipeline::generateImpostor(LLVOAvatar* avatar)
 	sShadowRender = TRUE;
 	sImpostorRender = TRUE;
 
-	LLViewerCamera* viewer_camera = LLViewerCamera::getInstance();
 	markVisible(avatar->mDrawable, *viewer_camera);
 	LLVOAvatar::sUseImpostors = FALSE;
 
@@ -8692,33 +8732,9 @@ void LLPipeline::generateImpostor(LLVOAvatar* avatar)
 
 	stateSort(*LLViewerCamera::getInstance(), result);
 	
-	const LLVector3* ext = avatar->mDrawable->getSpatialExtents();
-	LLVector3 pos(avatar->getRenderPosition()+avatar->getImpostorOffset());
-
-	LLCamera camera = *viewer_camera;
-
-	camera.lookAt(viewer_camera->getOrigin(), pos, viewer_camera->getUpAxis());
-	
-	LLVector2 tdim;
-
-	LLVector3 half_height = (ext[1]-ext[0])*0.5f;
-
-	LLVector3 left = camera.getLeftAxis();
-	left *= left;
-	left.normalize();
-
-	LLVector3 up = camera.getUpAxis();
-	up *= up;
-	up.normalize();
-
-	tdim.mV[0] = fabsf(half_height * left);
-	tdim.mV[1] = fabsf(half_height * up);
-
 	glMatrixMode(GL_PROJECTION);
 	glPushMatrix();
 	//glh::matrix4f ortho = gl_ortho(-tdim.mV[0], tdim.mV[0], -tdim.mV[1], tdim.mV[1], 1.0, 256.0);
-	F32 distance = (pos-camera.getOrigin()).length();
-	F32 fov = atanf(tdim.mV[1]/distance)*2.f*RAD_TO_DEG;
 	F32 aspect = tdim.mV[0]/tdim.mV[1]; //128.f/256.f;
 	glh::matrix4f persp = gl_perspective(fov, aspect, 1.f, 256.f);
 	glh_set_current_projection(persp);
@@ -8739,24 +8755,17 @@ void LLPipeline::generateImpostor(LLVOAvatar* avatar)
 	glStencilMask(0xFFFFFFFF);
 	glClearStencil(0);
 
-	// get the number of pixels per angle
-	F32 pa = gViewerWindow->getWindowHeightRaw() / (RAD_TO_DEG * viewer_camera->getView());
-
-	//get resolution based on angle width and height of impostor (double desired resolution to prevent aliasing)
-	U32 resY = llmin(nhpo2((U32) (fov*pa)), (U32) 512);
-	U32 resX = llmin(nhpo2((U32) (atanf(tdim.mV[0]/distance)*2.f*RAD_TO_DEG*pa)), (U32) 512);
-
-	if (!avatar->mImpostor.isComplete() || resX != avatar->mImpostor.getWidth() ||
-		resY != avatar->mImpostor.getHeight())
+	if (!impostor->isComplete() || resX != impostor->getWidth() ||
+		resY != impostor->getHeight())
 	{
-		avatar->mImpostor.allocate(resX,resY,GL_RGBA,TRUE,TRUE);
+		impostor->allocate(resX,resY,GL_RGBA,TRUE,TRUE);
 		
 		if (LLPipeline::sRenderDeferred)
 		{
-			addDeferredAttachments(avatar->mImpostor);
+			addDeferredAttachments(*impostor);
 		}
 		
-		gGL.getTexUnit(0)->bind(&avatar->mImpostor);
+		gGL.getTexUnit(0)->bind(impostor);
 		gGL.getTexUnit(0)->setTextureFilteringOption(LLTexUnit::TFO_POINT);
 		gGL.getTexUnit(0)->unbind(LLTexUnit::TT_TEXTURE);
 	}
@@ -8769,8 +8778,8 @@ void LLPipeline::generateImpostor(LLVOAvatar* avatar)
 	{
 		LLGLEnable scissor(GL_SCISSOR_TEST);
 		glScissor(0, 0, resX, resY);
-		avatar->mImpostor.bindTarget();
-		avatar->mImpostor.clear();
+		impostor->bindTarget();
+		impostor->clear();
 	}
 	
 	if (LLPipeline::sRenderDeferred)
@@ -8827,7 +8836,7 @@ void LLPipeline::generateImpostor(LLVOAvatar* avatar)
 	}
 
 
-	avatar->mImpostor.flush();
+	impostor->flush();
 
 	avatar->setImpostorDim(tdim);
 
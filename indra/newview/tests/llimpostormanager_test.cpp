@@ -0,0 +1,229 @@
+/** 
+ * @file llimpostormanager_test.cpp
+ * @brief LLImpostorManager tests
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ * 
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ * 
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ * 
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+// Precompiled header: almost always required for newview cpp files
+#include "../llviewerprecompiledheaders.h"
+// Class to test
+#include "../llimpostormanager.h"
+// Dependencies
+#include "../lldrawable.h"
+#include "../pipeline.h"
+#include "llcontrol.h"
+#include "llrendertarget.h"
+// Tut header
+#include "../test/lltut.h"
+
+// -------------------------------------------------------------------------------------------
+// Stubbing: Declarations required to link and run the class being tested
+// Notes:
+// * Add here stubbed implementation of the few classes and methods used in the class to be tested
+// * Add as little as possible (let the link errors guide you)
+// * Do not make any assumption as to how those classes or methods work (i.e. don't copy/paste code)
+// * A simulator for a class can be implemented here. Please comment and document thoroughly.
+
+LLRenderTarget::LLRenderTarget() {}
+LLRenderTarget::~LLRenderTarget() {}
+void LLRenderTarget::addColorAttachment(U32 color_fmt) {}
+void LLRenderTarget::allocateDepth() {}
+void LLRenderTarget::shareDepthBuffer(LLRenderTarget& target) {}
+void LLRenderTarget::bindTarget() {}
+
+// frames go by in the tests without the camera
+U32 LLDrawable::sCurVisible = 0;
+void LLDrawable::incrementVisible() { sCurVisible++; }
+BOOL LLPipeline::sRenderDeferred = FALSE;
+
+LLControlGroup gSavedSettings("Global");
+
+// An avatar as far as the manager is concerned, drawn when the test says so
+class LLTestImpostorOwner : public LLImpostorOwner
+{
+public:
+	void draw(U32 frame) { mImpostorLastDrawn = frame; }
+};
+
+// -------------------------------------------------------------------------------------------
+// TUT
+// -------------------------------------------------------------------------------------------
+namespace tut
+{
+	// 128x128 colour and depth targets, 8 of them fit in a megabyte
+	const U32 TARGET_SIZE = 128;
+	const S32 TARGETS_PER_MB = 8;
+
+	// Test wrapper declaration
+	struct impostormanager_test
+	{
+		LLTestImpostorOwner mFirst[TARGETS_PER_MB];
+		LLTestImpostorOwner mSecond[TARGETS_PER_MB];
+
+		impostormanager_test()
+		{
+			if (!gSavedSettings.controlExists("RenderImpostorMemory"))
+			{
+				gSavedSettings.declareU32("RenderImpostorMemory", 1, "test budget", FALSE);
+			}
+			gSavedSettings.setU32("RenderImpostorMemory", 1);
+
+			// well past frame 0, when avatars were last drawn as far as
+			// LLImpostorOwner knows
+			for (S32 i = 0; i < 10; i++)
+			{
+				nextFrame();
+			}
+		}
+		~impostormanager_test()
+		{
+			LLImpostorManager::getInstance()->releaseAll();
+			LLImpostorManager::getInstance()->getAndResetEvictions();
+		}
+
+		// returns the frame it moved on to
+		U32 nextFrame()
+		{
+			LLDrawable::incrementVisible();
+			return (U32) LLDrawable::getCurrentFrame();
+		}
+
+		// allocates a target for each owner, returns how many got one
+		S32 allocate(LLTestImpostorOwner* owners)
+		{
+			S32 allocated = 0;
+			for (S32 i = 0; i < TARGETS_PER_MB; i++)
+			{
+				if (LLImpostorManager::getInstance()->allocateTarget(&owners[i], TARGET_SIZE, TARGET_SIZE))
+				{
+					allocated++;
+				}
+			}
+			return allocated;
+		}
+
+		S32 countImpostors(LLTestImpostorOwner* owners)
+		{
+			S32 count = 0;
+			for (S32 i = 0; i < TARGETS_PER_MB; i++)
+			{
+				if (owners[i].mImpostor)
+				{
+					count++;
+				}
+			}
+			return count;
+		}
+	};
+
+	// Tut templating thingamagic: test group, object and test instance
+	typedef test_group<impostormanager_test> impostormanager_t;
+	typedef impostormanager_t::object impostormanager_object_t;
+	tut::impostormanager_t tut_impostormanager("LLImpostorManager");
+
+	// ---------------------------------------------------------------------------------------
+	// Test functions
+	// ---------------------------------------------------------------------------------------
+	template<> template<>
+	void impostormanager_object_t::test<1>()
+	{
+		set_test_name("second batch in the frame that filled the budget");
+
+		LLImpostorManager* manager = LLImpostorManager::getInstance();
+		ensure_equals("first batch", allocate(mFirst), TARGETS_PER_MB);
+		ensure_equals("budget used", manager->getMemoryUsage(), (U64) 1024 * 1024);
+
+		// nothing has been drawn yet, but the first batch is not up for grabs
+		ensure_equals("second batch", allocate(mSecond), 0);
+		ensure_equals("first batch kept", countImpostors(mFirst), TARGETS_PER_MB);
+		ensure_equals("no evictions", manager->getAndResetEvictions(), (U32) 0);
+
+		// asking again for a target of the same size is not an allocation
+		LLRenderTarget* target = mFirst[0].mImpostor;
+		ensure("same target", manager->allocateTarget(&mFirst[0], TARGET_SIZE, TARGET_SIZE) == target);
+		ensure_equals("one target each", manager->getNumTargets(), TARGETS_PER_MB);
+	}
+
+	template<> template<>
+	void impostormanager_object_t::test<2>()
+	{
+		set_test_name("impostors not drawn since give up their targets");
+
+		LLImpostorManager* manager = LLImpostorManager::getInstance();
+		ensure_equals("first batch", allocate(mFirst), TARGETS_PER_MB);
+
+		// two frames on, half of the first batch is still on screen
+		U32 drawn_frame = nextFrame();
+		nextFrame();
+		for (S32 i = 0; i < TARGETS_PER_MB / 2; i++)
+		{
+			mFirst[i].draw(drawn_frame);
+		}
+
+		ensure_equals("second batch", allocate(mSecond), TARGETS_PER_MB / 2);
+		ensure_equals("drawn kept", countImpostors(mFirst), TARGETS_PER_MB / 2);
+		for (S32 i = 0; i < TARGETS_PER_MB / 2; i++)
+		{
+			ensure("drawn impostor kept", mFirst[i].mImpostor != NULL);
+			ensure("evicted impostor", mFirst[TARGETS_PER_MB / 2 + i].mImpostor == NULL);
+			ensure("evicted impostor regenerated", mFirst[TARGETS_PER_MB / 2 + i].mNeedsImpostorUpdate);
+		}
+		ensure_equals("evictions", manager->getAndResetEvictions(), (U32) TARGETS_PER_MB / 2);
+
+		// the targets handed out this frame stay put too
+		ensure_equals("only the kept ones", allocate(mFirst), TARGETS_PER_MB / 2);
+		ensure_equals("second batch kept", countImpostors(mSecond), TARGETS_PER_MB / 2);
+		ensure_equals("no more evictions", manager->getAndResetEvictions(), (U32) 0);
+		ensure_equals("same memory", manager->getMemoryUsage(), (U64) 1024 * 1024);
+	}
+
+	template<> template<>
+	void impostormanager_object_t::test<3>()
+	{
+		set_test_name("released targets are reused");
+
+		LLImpostorManager* manager = LLImpostorManager::getInstance();
+		ensure_equals("first batch", allocate(mFirst), TARGETS_PER_MB);
+
+		manager->releaseTarget(&mFirst[0]);
+		ensure("released", mFirst[0].mImpostor == NULL);
+		ensure_equals("target kept", manager->getNumTargets(), TARGETS_PER_MB);
+
+		ensure("reused", manager->allocateTarget(&mSecond[0], TARGET_SIZE, TARGET_SIZE) != NULL);
+		ensure_equals("no new target", manager->getNumTargets(), TARGETS_PER_MB);
+		ensure_equals("no evictions", manager->getAndResetEvictions(), (U32) 0);
+	}
+
+	template<> template<>
+	void impostormanager_object_t::test<4>()
+	{
+		set_test_name("budgets of 4GB and more");
+
+		// in 32 bits these came out as no budget at all
+		gSavedSettings.setU32("RenderImpostorMemory", 4096);
+		ensure_equals("4GB", allocate(mFirst), TARGETS_PER_MB);
+
+		gSavedSettings.setU32("RenderImpostorMemory", 8192 + 1);
+		ensure_equals("8GB and a bit", allocate(mSecond), TARGETS_PER_MB);
+		ensure_equals("no evictions", LLImpostorManager::getInstance()->getAndResetEvictions(), (U32) 0);
+	}
+}
@@ -0,0 +1,283 @@
+/**
+ * @file llpolymesh_test.cpp
+ * @brief Test morphing of the avatar meshes
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+// Precompiled header: almost always required for newview cpp files
+#include "../llviewerprecompiledheaders.h"
+// Class to test
+#include "../llpolymesh.h"
+// Dependencies
+#include "../llpolymorph.h"
+#include "lldir.h"
+#include "llmd5.h"
+// Tut header
+#include "../test/lltut.h"
+
+// -------------------------------------------------------------------------------------------
+// Stubbing: Declarations required to link and run the class being tested
+// Notes:
+// * Add here stubbed implementation of the few classes and methods used in the class to be tested
+// * Add as little as possible (let the link errors guide you)
+// * Do not make any assumption as to how those classes or methods work (i.e. don't copy/paste code)
+// * A simulator for a class can be implemented here. Please comment and document thoroughly.
+
+// Morph target settings normally read from avatar_lad.xml. There is no
+// volume morph, so the morph targets never look at the (missing) avatar.
+class LLTestMorphTargetInfo : public LLPolyMorphTargetInfo
+{
+public:
+	LLTestMorphTargetInfo(S32 id, const std::string& name)
+	{
+		mID = id;
+		mName = name;
+		mMorphName = name;
+		mMinWeight = -1.f;
+		mMaxWeight = 1.f;
+		mDefaultWeight = 0.f;
+		mSex = SEX_BOTH;
+	}
+};
+
+// The morph cache key, a digest of the morph weights as in
+// LLVOAvatar::beginMeshMorphs()
+static LLUUID get_shape_id(const F32* weights, U32 count)
+{
+	LLMD5 shape_hash;
+	for (U32 i = 0; i < count; i++)
+	{
+		shape_hash.update((const unsigned char*)&weights[i], sizeof(F32));
+	}
+	shape_hash.finalize();
+	LLUUID shape_id;
+	shape_hash.raw_digest(shape_id.mData);
+	return shape_id;
+}
+
+// One avatar's upper body and its morph targets
+class LLTestBody
+{
+public:
+	LLTestBody(const std::vector<LLTestMorphTargetInfo*>& infos)
+	{
+		mMesh = LLPolyMesh::getMesh("avatar_upper_body.llm");
+		for (U32 i = 0; mMesh && i < infos.size(); i++)
+		{
+			LLPolyMorphTarget* morph = new LLPolyMorphTarget(mMesh);
+			morph->setInfo(infos[i]);
+			mMorphs.push_back(morph);
+		}
+	}
+	~LLTestBody()
+	{
+		for_each(mMorphs.begin(), mMorphs.end(), DeletePointer());
+		delete mMesh;
+	}
+
+	// what LLCharacter::updateVisualParams() does with the new weights
+	void apply(const F32* weights)
+	{
+		for (U32 i = 0; i < mMorphs.size(); i++)
+		{
+			mMorphs[i]->setWeight(weights[i], FALSE);
+			mMorphs[i]->apply(SEX_FEMALE);
+		}
+	}
+
+	// what LLVOAvatar::updateVisualParams() does: adopt the shape from the
+	// morph cache if another body has made it, otherwise morph and share it
+	BOOL applyCached(const F32* weights)
+	{
+		LLUUID shape_id = get_shape_id(weights, mMorphs.size());
+		mMesh->beginMorphBatch();
+		BOOL loaded = mMesh->loadMorphCache(shape_id);
+		apply(weights);
+		mMesh->endMorphBatch();
+		if (!loaded)
+		{
+			mMesh->saveMorphCache(shape_id);
+		}
+		return loaded;
+	}
+
+	LLPolyMesh* mMesh;
+	std::vector<LLPolyMorphTarget*> mMorphs;
+};
+
+// -------------------------------------------------------------------------------------------
+// TUT
+// -------------------------------------------------------------------------------------------
+namespace tut
+{
+	// Overlapping morphs of avatar_upper_body.llm
+	const char* MORPH_NAMES[] = { "Big_Belly_Torso", "Big_Chest", "Fat_Torso", "Muscular_Torso" };
+	const S32 NUM_MORPHS = sizeof(MORPH_NAMES) / sizeof(MORPH_NAMES[0]);
+
+	// Test wrapper declaration
+	struct polymesh_test
+	{
+		std::vector<LLTestMorphTargetInfo*> mInfos;
+
+		polymesh_test()
+		{
+			static bool dirs_initialized = false;
+			if (!dirs_initialized)
+			{
+				// meshes are read from newview/character
+				std::string newview_path = gDirUtilp->getDirName(gDirUtilp->getDirName(__FILE__));
+				gDirUtilp->initAppDirs("Kokua", newview_path);
+				dirs_initialized = true;
+			}
+
+			for (S32 i = 0; i < NUM_MORPHS; i++)
+			{
+				mInfos.push_back(new LLTestMorphTargetInfo(i, MORPH_NAMES[i]));
+			}
+		}
+		~polymesh_test()
+		{
+			LLPolyMesh::setMorphCacheSize(0);
+			LLPolyMesh::freeAllMeshes();
+			for_each(mInfos.begin(), mInfos.end(), DeletePointer());
+		}
+
+		void ensure_same_vertices(const std::string& msg, LLPolyMesh* mesh, LLPolyMesh* expected)
+		{
+			const F32 TOLERANCE = 1.e-6f;
+			for (U32 i = 0; i < mesh->getNumVertices(); i++)
+			{
+				ensure(msg + " coords", dist_vec(mesh->getCoords()[i], expected->getCoords()[i]) <= TOLERANCE);
+				ensure(msg + " normals", dist_vec(mesh->getNormals()[i], expected->getNormals()[i]) <= TOLERANCE);
+				ensure(msg + " binormals", dist_vec(mesh->getBinormals()[i], expected->getBinormals()[i]) <= TOLERANCE);
+				ensure(msg + " tex coords", dist_vec(mesh->getTexCoords()[i], expected->getTexCoords()[i]) <= TOLERANCE);
+			}
+		}
+	};
+
+	// Tut templating thingamagic: test group, object and test instance
+	typedef test_group<polymesh_test> polymesh_t;
+	typedef polymesh_t::object polymesh_object_t;
+	tut::polymesh_t tut_polymesh("LLPolyMesh");
+
+	// ---------------------------------------------------------------------------------------
+	// Test functions
+	// ---------------------------------------------------------------------------------------
+	// Batched morphs
+	template<> template<>
+	void polymesh_object_t::test<1>()
+	{
+		set_test_name("batched morphs match the per-morph path");
+
+		LLTestBody per_morph(mInfos);
+		LLTestBody batched(mInfos);
+		ensure("mesh loaded", per_morph.mMesh != NULL && batched.mMesh != NULL);
+		for (S32 i = 0; i < NUM_MORPHS; i++)
+		{
+			ensure(std::string("morph ") + MORPH_NAMES[i], per_morph.mMesh->getMorphData(MORPH_NAMES[i]) != NULL);
+		}
+
+		// a new shape, then a differential update that undoes one morph
+		const F32 shapes[2][NUM_MORPHS] = {
+			{ 0.8f, 0.5f, -0.3f, 1.f },
+			{ 0.2f, 0.f, 0.6f, -0.7f } };
+		for (S32 shape = 0; shape < 2; shape++)
+		{
+			per_morph.apply(shapes[shape]);
+
+			batched.mMesh->beginMorphBatch();
+			batched.apply(shapes[shape]);
+			batched.mMesh->endMorphBatch();
+
+			ensure_same_vertices(llformat("shape %d", shape), batched.mMesh, per_morph.mMesh);
+		}
+	}
+
+	// Morph cache
+	template<> template<>
+	void polymesh_object_t::test<2>()
+	{
+		set_test_name("bodies with the same shape share vertices until one changes");
+		LLPolyMesh::setMorphCacheSize(4);
+
+		const F32 shape[NUM_MORPHS] = { 0.8f, 0.5f, -0.3f, 1.f };
+		const F32 edited_shape[NUM_MORPHS] = { 0.8f, 0.6f, -0.3f, 1.f };
+
+		LLTestBody first(mInfos);
+		LLTestBody second(mInfos);
+		LLTestBody third(mInfos);
+		LLTestBody reference(mInfos);
+		reference.apply(shape);
+
+		ensure_not("first body morphs", first.applyCached(shape));
+		ensure("second body shares", second.applyCached(shape));
+		ensure("same vertices", second.mMesh->getCoords() == first.mMesh->getCoords());
+		ensure_same_vertices("shared", second.mMesh, reference.mMesh);
+
+		// editing copies the shared vertices, the first body keeps its shape
+		ensure_not("edited shape is new", second.applyCached(edited_shape));
+		ensure("edit copies", second.mMesh->getCoords() != first.mMesh->getCoords());
+		ensure_same_vertices("first after edit", first.mMesh, reference.mMesh);
+		reference.apply(edited_shape);
+		ensure_same_vertices("second after edit", second.mMesh, reference.mMesh);
+		ensure("third body shares the edit", third.applyCached(edited_shape));
+		ensure("same edited vertices", third.mMesh->getCoords() == second.mMesh->getCoords());
+
+		// shapes are only shared within a mesh
+		LLPolyMesh* lower_body = LLPolyMesh::getMesh("avatar_lower_body.llm");
+		ensure("lower body loaded", lower_body != NULL);
+		lower_body->beginMorphBatch();
+		ensure_not("other mesh", lower_body->loadMorphCache(get_shape_id(shape, NUM_MORPHS)));
+		lower_body->endMorphBatch();
+		delete lower_body;
+	}
+
+	template<> template<>
+	void polymesh_object_t::test<3>()
+	{
+		set_test_name("least recently used shapes are evicted");
+		LLPolyMesh::setMorphCacheSize(1);
+
+		const F32 shape[NUM_MORPHS] = { 0.8f, 0.5f, -0.3f, 1.f };
+		const F32 other_shape[NUM_MORPHS] = { 0.2f, 0.f, 0.6f, -0.7f };
+
+		LLTestBody first(mInfos);
+		LLTestBody second(mInfos);
+		LLTestBody third(mInfos);
+		LLTestBody fourth(mInfos);
+		LLTestBody reference(mInfos);
+		reference.apply(shape);
+
+		ensure_not("first shape", first.applyCached(shape));
+		ensure_not("second shape", second.applyCached(other_shape));
+		// the evicted shape lives on in the body using it
+		ensure_same_vertices("evicted", first.mMesh, reference.mMesh);
+		ensure_not("first shape was evicted", third.applyCached(shape));
+		ensure("first shape is back", fourth.applyCached(shape));
+		ensure_same_vertices("reloaded", fourth.mMesh, reference.mMesh);
+
+		// resizing the cache drops everything
+		LLPolyMesh::setMorphCacheSize(2);
+		ensure_not("cache resized", first.applyCached(other_shape));
+	}
+}
@@ -0,0 +1,216 @@
+/**
+ * @file llviewerjointmesh_avx2_test.cpp
+ * @brief Test the AVX2 skinning kernel against the SSE2 math
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+// Precompiled header: almost always required for newview cpp files
+#include "../llviewerprecompiledheaders.h"
+// Class to test
+#include "../llviewerjointmesh_avx2.h"
+// Dependencies
+#include "../llpolymesh.h"
+#include "lldir.h"
+#include "llprocessor.h"
+#include "llrand.h"
+#include "lltimer.h"
+#include "llv4matrix3.h"
+#include "llv4matrix4.h"
+// Tut header
+#include "../test/lltut.h"
+
+// -------------------------------------------------------------------------------------------
+// TUT
+// -------------------------------------------------------------------------------------------
+namespace tut
+{
+	// The skinned meshes of avatar_lad.xml
+	const char* MESH_NAMES[] = { "avatar_hair.llm", "avatar_head.llm", "avatar_eyelashes.llm",
+								 "avatar_upper_body.llm", "avatar_lower_body.llm", "avatar_skirt.llm" };
+	const S32 NUM_MESHES = sizeof(MESH_NAMES) / sizeof(MESH_NAMES[0]);
+	const S32 NUM_JOINTS = 32;
+
+	// Vertex buffer layout: position, normal, texture coordinates
+	const U32 VERTEX_STRIDE = 8;
+
+	// Test wrapper declaration
+	struct skinning_test
+	{
+		std::vector<LLPolyMesh*> mMeshes;
+		LLV4Matrix4* mJointMats;
+
+		skinning_test()
+		{
+			static bool dirs_initialized = false;
+			if (!dirs_initialized)
+			{
+				// meshes are read from newview/character
+				std::string newview_path = gDirUtilp->getDirName(gDirUtilp->getDirName(__FILE__));
+				gDirUtilp->initAppDirs("Kokua", newview_path);
+				dirs_initialized = true;
+			}
+
+			for (S32 i = 0; i < NUM_MESHES; i++)
+			{
+				LLPolyMesh* mesh = LLPolyMesh::getMesh(MESH_NAMES[i]);
+				if (mesh)
+				{
+					mMeshes.push_back(mesh);
+				}
+			}
+
+			// random bones, as skinning only ever lerps two neighbours
+			mJointMats = new LLV4Matrix4[NUM_JOINTS];
+			for (S32 j = 0; j < NUM_JOINTS; j++)
+			{
+				LLQuaternion rot(ll_frand(F_TWO_PI), LLVector3(ll_frand(), ll_frand(), ll_frand()) + LLVector3(0.1f, 0.1f, 0.1f));
+				LLVector4 pos(ll_frand(2.f) - 1.f, ll_frand(2.f) - 1.f, ll_frand(2.f) - 1.f);
+				mJointMats[j] = LLMatrix4(rot, pos);
+			}
+		}
+		~skinning_test()
+		{
+			delete [] mJointMats;
+			for_each(mMeshes.begin(), mMeshes.end(), DeletePointer());
+			LLPolyMesh::freeAllMeshes();
+		}
+
+		// The math of LLViewerJointMesh::updateGeometrySSE2()
+		void skinSSE2(LLPolyMesh* mesh, U32 index, F32* output)
+		{
+			F32					weight		= F32_MAX;
+			LLV4Matrix4			blend_mat;
+
+			const F32*			weights			= mesh->getWeights();
+			const LLVector3*	coords			= mesh->getCoords();
+			const LLVector3*	normals			= mesh->getNormals();
+			for (U32 index_end = mesh->getNumVertices(); index < index_end; ++index)
+			{
+				if( weight != weights[index])
+				{
+					S32 joint = llfloor(weight = weights[index]);
+					blend_mat.lerp(mJointMats[joint], mJointMats[joint+1], weight - joint);
+				}
+				LLVector3* vertex = (LLVector3*)(output + index * VERTEX_STRIDE);
+				blend_mat.multiply(coords[index], *vertex);
+				((LLV4Matrix3)blend_mat).multiply(normals[index], *(vertex + 1));
+			}
+		}
+
+		// As LLViewerJointMesh::updateGeometryAVX2() does
+		void skinAVX2(LLPolyMesh* mesh, F32* output)
+		{
+			U32 index = ll_skin_vertices_avx2(&mJointMats[0].mMatrix[0][0], mesh->getWeights(),
+											  mesh->getCoords()->mV, mesh->getNormals()->mV, mesh->getNumVertices(),
+											  (U8*)output, VERTEX_STRIDE * sizeof(F32),
+											  (U8*)(output + 3), VERTEX_STRIDE * sizeof(F32));
+			skinSSE2(mesh, index, output);
+		}
+
+		bool hasAVX2()
+		{
+			return ll_has_skin_vertices_avx2() && LLProcessorInfo().hasAVX2();
+		}
+	};
+
+	// Tut templating thingamagic: test group, object and test instance
+	typedef test_group<skinning_test> skinning_t;
+	typedef skinning_t::object skinning_object_t;
+	tut::skinning_t tut_skinning("LLViewerJointMeshAVX2");
+
+	// ---------------------------------------------------------------------------------------
+	// Test functions
+	// ---------------------------------------------------------------------------------------
+	template<> template<>
+	void skinning_object_t::test<1>()
+	{
+		set_test_name("AVX2 skinning matches SSE2 on the avatar meshes");
+		if (!hasAVX2())
+		{
+			skip("no AVX2 kernel in this build or CPU");
+		}
+		ensure_equals("meshes loaded", (S32)mMeshes.size(), NUM_MESHES);
+
+		for (U32 i = 0; i < mMeshes.size(); i++)
+		{
+			LLPolyMesh* mesh = mMeshes[i];
+			ensure(std::string(MESH_NAMES[i]) + " is skinned", mesh->hasWeights());
+			U32 num_floats = mesh->getNumVertices() * VERTEX_STRIDE;
+			std::vector<F32> expected(num_floats, 0.f);
+			std::vector<F32> actual(num_floats, 0.f);
+			skinSSE2(mesh, 0, &expected[0]);
+			skinAVX2(mesh, &actual[0]);
+
+			// fused multiply-adds round once instead of twice
+			for (U32 f = 0; f < num_floats; f++)
+			{
+				ensure_distance(MESH_NAMES[i], actual[f], expected[f], 1.e-5f);
+			}
+		}
+	}
+
+	template<> template<>
+	void skinning_object_t::test<2>()
+	{
+		set_test_name("AVX2 and SSE2 skinning benchmark");
+		if (!getenv("LL_RUN_BENCHMARKS"))
+		{
+			skip("benchmark, set LL_RUN_BENCHMARKS to run it");
+		}
+		if (!hasAVX2())
+		{
+			skip("no AVX2 kernel in this build or CPU");
+		}
+
+		const S32 PASSES = 2000;
+		U32 max_vertices = 0;
+		for (U32 i = 0; i < mMeshes.size(); i++)
+		{
+			max_vertices = llmax(max_vertices, mMeshes[i]->getNumVertices());
+		}
+		std::vector<F32> output(max_vertices * VERTEX_STRIDE);
+
+		LLTimer timer;
+		for (S32 pass = 0; pass < PASSES; pass++)
+		{
+			for (U32 i = 0; i < mMeshes.size(); i++)
+			{
+				skinSSE2(mMeshes[i], 0, &output[0]);
+			}
+		}
+		F64 sse2_time = timer.getElapsedTimeF64();
+
+		timer.reset();
+		for (S32 pass = 0; pass < PASSES; pass++)
+		{
+			for (U32 i = 0; i < mMeshes.size(); i++)
+			{
+				skinAVX2(mMeshes[i], &output[0]);
+			}
+		}
+		F64 avx2_time = timer.getElapsedTimeF64();
+
+		llinfos << "Skinning " << PASSES << " avatars: SSE2 " << sse2_time * 1000.0 << " ms, AVX2 "
+				<< avx2_time * 1000.0 << " ms" << llendl;
+	}
+}
@@ -0,0 +1,266 @@
+/** 
+ * @file llpumpiothread_tut.cpp
+ * @brief Testing LLPumpIOThread against a loopback HTTP server.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ * 
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ * 
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ * 
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+/**
+ *
+ * These tests issue a burst of concurrent loopback HTTP requests while
+ * the "main thread" is artificially slowed to a low frame rate, with
+ * the client pump driven by the main loop and by an LLPumpIOThread.
+ * The benchmark compares the frames each takes, and only runs with
+ * LL_RUN_BENCHMARKS set.
+ *
+ */
+
+#include <tut/tut.hpp>
+#include "linden_common.h"
+
+// These are too slow on Windows to actually include in the build. JC
+#if !LL_WINDOWS
+
+#include "lltut.h"
+#include "llformat.h"
+#include "llhttpclient.h"
+#include "llpumpio.h"
+#include "llpumpiothread.h"
+#include "llthread.h"
+#include "lltimer.h"
+
+#include "llsdhttpserver.h"
+#include "lliohttpserver.h"
+
+namespace tut
+{
+	class PumpThreadPingNode : public LLHTTPNode
+	{
+	public:
+		LLSD simpleGet() const { return LLSD("pong"); }
+	};
+
+	LLHTTPRegistration<PumpThreadPingNode> gPumpThreadPingNode("/test/pumpthread/ping");
+
+	// Each simulated main loop frame sleeps this long.
+	const U32 SLOW_FRAME_MS = 50;
+	const S32 CONCURRENT_REQUESTS = 32;
+	const U16 PUMP_THREAD_TEST_PORT = 8889;
+
+	struct PumpIOThreadTestData
+	{
+	public:
+		PumpIOThreadTestData() :
+			mCompleted(0),
+			mErrors(0),
+			mWrongThread(0),
+			mMainThreadID(0)
+		{
+			apr_pool_create(&mPool, NULL);
+
+			// The server always runs on its own thread so that only the
+			// client side is affected by the slow main loop.
+			mServerThread = new LLPumpIOThread("test http server");
+			LLHTTPNode& root = LLIOHTTPServer::create(
+				mPool, *mServerThread->getPump(), PUMP_THREAD_TEST_PORT);
+			LLHTTPStandardServices::useServices();
+			LLHTTPRegistrar::buildAllServices(root);
+			mServerThread->start();
+		}
+
+		~PumpIOThreadTestData()
+		{
+			delete mServerThread;
+			apr_pool_destroy(mPool);
+		}
+
+		class LatencyResponder : public LLHTTPClient::Responder
+		{
+		public:
+			LatencyResponder(PumpIOThreadTestData& data) :
+				mData(data)
+			{
+			}
+
+			virtual void completed(
+				U32 status,
+				const std::string& reason,
+				const LLSD& content)
+			{
+				++mData.mCompleted;
+				if(!isGoodStatus(status) || content.asString() != "pong")
+				{
+					++mData.mErrors;
+				}
+				if(LLThread::currentID() != mData.mMainThreadID)
+				{
+					++mData.mWrongThread;
+				}
+				mData.mLatencies.push_back(mData.mTimer.getElapsedTimeF32());
+			}
+
+		private:
+			PumpIOThreadTestData& mData;
+		};
+
+		// Issues the requests and then runs a slow main loop until they
+		// all completed. If io_thread is NULL the client pump is pumped
+		// from the slow main loop, as the viewer does by default.
+		// Returns the number of slow frames it took.
+		S32 runRequests(LLPumpIO* client_pump, LLPumpIOThread* io_thread)
+		{
+			mCompleted = 0;
+			mErrors = 0;
+			mWrongThread = 0;
+			mMainThreadID = LLThread::currentID();
+			mLatencies.clear();
+			LLHTTPClient::setPump(*client_pump);
+
+			std::string url = llformat(
+				"http://localhost:%d/test/pumpthread/ping",
+				PUMP_THREAD_TEST_PORT);
+			mTimer.reset();
+			for(S32 i = 0; i < CONCURRENT_REQUESTS; ++i)
+			{
+				LLHTTPClient::get(url,
+					LLHTTPClient::ResponderPtr(new LatencyResponder(*this)));
+			}
+
+			LLTimer timeout;
+			timeout.setTimerExpirySec(30.f);
+			S32 frames = 0;
+			while(mCompleted < CONCURRENT_REQUESTS && !timeout.hasExpired())
+			{
+				// the rest of the frame
+				ms_sleep(SLOW_FRAME_MS);
+				++frames;
+
+				if(io_thread)
+				{
+					io_thread->callback();
+				}
+				else
+				{
+					client_pump->pump();
+					client_pump->callback();
+				}
+			}
+			return frames;
+		}
+
+		F32 meanLatency() const
+		{
+			if(mLatencies.empty()) return 0.f;
+			F32 total = 0.f;
+			for(std::vector<F32>::const_iterator it = mLatencies.begin();
+				it != mLatencies.end(); ++it)
+			{
+				total += *it;
+			}
+			return total / (F32)mLatencies.size();
+		}
+
+		apr_pool_t* mPool;
+		LLPumpIOThread* mServerThread;
+		LLTimer mTimer;
+		S32 mCompleted;
+		S32 mErrors;
+		S32 mWrongThread;
+		U32 mMainThreadID;
+		std::vector<F32> mLatencies;
+	};
+
+	typedef test_group<PumpIOThreadTestData> PumpIOThreadTestGroup;
+	typedef PumpIOThreadTestGroup::object PumpIOThreadTestObject;
+	PumpIOThreadTestGroup pumpIOThreadTestGroup("pump_io_thread");
+
+	template<> template<>
+	void PumpIOThreadTestObject::test<1>()
+	{
+		set_test_name("threaded pump");
+		// The chains only run on the i/o thread, the main loop never
+		// pumps them, and responders run on the thread calling callback().
+		LLPumpIOThread client("test http client");
+		client.start();
+		runRequests(client.getPump(), &client);
+		ensure_equals("all requests completed", mCompleted, CONCURRENT_REQUESTS);
+		ensure_equals("no request failed", mErrors, 0);
+		ensure_equals("responders ran on the main thread", mWrongThread, 0);
+	}
+
+	template<> template<>
+	void PumpIOThreadTestObject::test<2>()
+	{
+		set_test_name("main loop pump");
+		// The old behaviour, the main loop pumps the client chains.
+		apr_pool_t* pool = NULL;
+		apr_pool_create(&pool, NULL);
+		LLPumpIO* main_pump = new LLPumpIO(pool);
+		runRequests(main_pump, NULL);
+		ensure_equals("all requests completed", mCompleted, CONCURRENT_REQUESTS);
+		ensure_equals("no request failed", mErrors, 0);
+		ensure_equals("responders ran on the main thread", mWrongThread, 0);
+		delete main_pump;
+		apr_pool_destroy(pool);
+	}
+
+	template<> template<>
+	void PumpIOThreadTestObject::test<3>()
+	{
+		set_test_name("slow main loop benchmark");
+		if (!getenv("LL_RUN_BENCHMARKS"))
+		{
+			skip("benchmark, set LL_RUN_BENCHMARKS to run it");
+		}
+
+		// Main loop driven client pump, the old behaviour.
+		apr_pool_t* pool = NULL;
+		apr_pool_create(&pool, NULL);
+		LLPumpIO* main_pump = new LLPumpIO(pool);
+		S32 main_frames = runRequests(main_pump, NULL);
+		F32 main_latency = meanLatency();
+		ensure_equals("main loop requests completed", mCompleted, CONCURRENT_REQUESTS);
+		delete main_pump;
+		apr_pool_destroy(pool);
+
+		// Same burst on the i/o thread.
+		LLPumpIOThread client("test http client");
+		client.start();
+		S32 thread_frames = runRequests(client.getPump(), &client);
+		F32 thread_latency = meanLatency();
+		ensure_equals("threaded requests completed", mCompleted, CONCURRENT_REQUESTS);
+
+		llinfos << CONCURRENT_REQUESTS << " concurrent requests at "
+				<< SLOW_FRAME_MS << "ms/frame: main loop pump "
+				<< main_frames << " frames, mean latency " << main_latency
+				<< "s; i/o thread " << thread_frames
+				<< " frames, mean latency " << thread_latency << "s" << llendl;
+
+		// The transfer itself no longer waits on the frame rate, so the
+		// main thread sees every response by the time its callbacks run.
+		ensure("i/o thread is not slower than the main loop",
+			   thread_frames <= main_frames);
+		ensure("i/o thread completes within two slow frames", thread_frames <= 2);
+	}
+}
+
+#endif	// !LL_WINDOWS